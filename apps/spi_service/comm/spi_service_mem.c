@@ -1,90 +1,159 @@
 #include "spi_service_mem.h"
 #include "spi_service_loop.h"
 #include "cli.h"
+#include <stdlib.h>
 
-#define SPI_SERVICE_MEM_NUM_RX 16
-#define SPI_SERVICE_MEM_NUM_TX 20
-#define SPI_SERVICE_MEM_NUM_MSG 8
+#ifndef CONFIG_SPI_SERVICE_MEM_DATA_NUM
+#define CONFIG_SPI_SERVICE_MEM_DATA_NUM 36
+#endif
+#ifndef CONFIG_SPI_SERVICE_MEM_RX_NUM
+#define CONFIG_SPI_SERVICE_MEM_RX_NUM 16
+#endif
+#ifndef CONFIG_SPI_SERVICE_MEM_MSG_NUM
+#define CONFIG_SPI_SERVICE_MEM_MSG_NUM 8
+#endif
+
+/* rx and tx pools share one arena of data slots, the split is set at runtime */
+#define SPI_SERVICE_MEM_NUM_DATA CONFIG_SPI_SERVICE_MEM_DATA_NUM
+#define SPI_SERVICE_MEM_NUM_MSG CONFIG_SPI_SERVICE_MEM_MSG_NUM
 #define SPI_SERVICE_MEM_RSV_SIZE SPI_SERVICE_ALIGN4(sizeof(spi_service_rsvhead_t))
-#define SPI_SERVICE_MEM_RX_TOTAL (SPI_SERVICE_MEM_NUM_RX*(SPI_SERVICE_MEM_DATA_SIZE+SPI_SERVICE_MEM_RSV_SIZE))
-#define SPI_SERVICE_MEM_TX_TOTAL (SPI_SERVICE_MEM_NUM_TX*(SPI_SERVICE_MEM_DATA_SIZE+SPI_SERVICE_MEM_RSV_SIZE))
+#define SPI_SERVICE_MEM_DATA_TOTAL (SPI_SERVICE_MEM_NUM_DATA*(SPI_SERVICE_MEM_DATA_SIZE+SPI_SERVICE_MEM_RSV_SIZE))
 #define SPI_SERVICE_MEM_MSG_TOTAL (SPI_SERVICE_MEM_NUM_MSG*(SPI_SERVICE_MEM_MSG_SIZE+SPI_SERVICE_MEM_RSV_SIZE))
-unsigned char g_spi_rxmem[SPI_SERVICE_MEM_RX_TOTAL] __attribute__ ((section("SHAREDRAM")));
-unsigned char g_spi_txmem[SPI_SERVICE_MEM_TX_TOTAL] __attribute__ ((section("SHAREDRAM")));
+unsigned char g_spi_datamem[SPI_SERVICE_MEM_DATA_TOTAL] __attribute__ ((section("SHAREDRAM")));
 unsigned char g_spi_msgmem[SPI_SERVICE_MEM_MSG_TOTAL] __attribute__ ((section("SHAREDRAM")));
 
+/* slots not lent to a pool wait on the spare list of their arena */
+#define SPI_SERVICE_POOL_DATA_SPARE SPI_SERVICE_POOL_MAX
+#define SPI_SERVICE_POOL_MSG_SPARE (SPI_SERVICE_POOL_MAX + 1)
+#define SPI_SERVICE_POOL_ALL (SPI_SERVICE_POOL_MAX + 2)
+
 typedef struct {
     unsigned char status;
-    unsigned char txnum;
-    unsigned char rxnum;
-    unsigned char msgnum;
-    platform_list_t rxlist;
-    platform_list_t txlist;
-    platform_list_t msglist;
-    spi_service_lnkhead_t rxlink[SPI_SERVICE_MEM_NUM_RX];
-    spi_service_lnkhead_t txlink[SPI_SERVICE_MEM_NUM_TX];
+    spi_service_pool_t pool[SPI_SERVICE_POOL_ALL];
+    spi_service_lnkhead_t datalink[SPI_SERVICE_MEM_NUM_DATA];
     spi_service_lnkhead_t msglink[SPI_SERVICE_MEM_NUM_MSG];
 } spi_server_mem_priv_t;
 
 spi_server_mem_priv_t g_spi_mlist;
 
+static const char *g_spi_pool_name[SPI_SERVICE_POOL_ALL] = {"RX", "TX", "MSG", "DATA_SPARE", "MSG_SPARE"};
+
 static spi_server_mem_priv_t *spi_service_mlist_priv_get(void)
 {
     return &g_spi_mlist;
 }
 
-int spi_service_mem_init(void)
+static int spi_service_mtype_pool(spi_service_mtype_e type)
 {
-    spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
-    unsigned int memaddr, flag;
-    int idx;
+    switch (type) {
+        case SPI_SERVICE_MEM_STARX:
+        case SPI_SERVICE_MEM_APRX:
+            return SPI_SERVICE_POOL_RX;
+        case SPI_SERVICE_MEM_STATX:
+        case SPI_SERVICE_MEM_APTX:
+            return SPI_SERVICE_POOL_TX;
+        case SPI_SERVICE_MEM_MSG:
+            return SPI_SERVICE_POOL_MSG;
+        default:
+            return -1;
+    }
+}
 
-    SPI_SERVICE_CHECK_RETURN(priv->status == (SPI_SERVICE_MEM_ALLOC&0xFF), -1, "spi mem already init");
-    flag = system_irq_save();
-    platform_list_init(&priv->rxlist);
-    memset(g_spi_rxmem, 0, sizeof(g_spi_rxmem));
-    memaddr = SPI_SERVICE_ALIGN4((unsigned int)g_spi_rxmem);
-    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_RX; idx++) {
-        spi_service_rsvhead_t *rsvhead = (spi_service_rsvhead_t *)memaddr;
-        rsvhead->addr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE;
-        rsvhead->idx = idx;
-        rsvhead->magic = SPI_SERVICE_MEM_FREE;
-        rsvhead->mtype = 0xFF;
-        priv->rxlink[idx].mhead = rsvhead;
-        platform_list_add_tail(&priv->rxlink[idx].list, &priv->rxlist);
-        priv->rxnum++;
-        memaddr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE + SPI_SERVICE_MEM_DATA_SIZE;
+static int spi_service_pool_spare(int pool)
+{
+    return (pool == SPI_SERVICE_POOL_MSG) ? SPI_SERVICE_POOL_MSG_SPARE : SPI_SERVICE_POOL_DATA_SPARE;
+}
+
+/* irq must be disabled */
+static void spi_service_pool_put(spi_server_mem_priv_t *priv, spi_service_lnkhead_t *lnkhead, int pool)
+{
+    spi_service_pool_t *mpool = &priv->pool[pool];
+
+    lnkhead->pool = pool;
+    platform_list_add(&lnkhead->list, &mpool->list);
+    mpool->freenum++;
+}
+
+/* irq must be disabled, move free slots between a pool and its spare list until it holds target slots */
+static void spi_service_pool_rebalance(spi_server_mem_priv_t *priv)
+{
+    spi_service_lnkhead_t *lnkhead = NULL;
+    spi_service_pool_t *mpool, *spare;
+    int pool;
+
+    for (pool = 0; pool < SPI_SERVICE_POOL_MAX; pool++) {
+        mpool = &priv->pool[pool];
+        spare = &priv->pool[spi_service_pool_spare(pool)];
+        while (mpool->total > mpool->target && mpool->freenum > 0) {
+            lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&mpool->list, spi_service_lnkhead_t, list);
+            platform_list_del(&lnkhead->list);
+            mpool->freenum--;
+            mpool->total--;
+            spi_service_pool_put(priv, lnkhead, spi_service_pool_spare(pool));
+            spare->total++;
+        }
+    }
+
+    for (pool = 0; pool < SPI_SERVICE_POOL_MAX; pool++) {
+        mpool = &priv->pool[pool];
+        spare = &priv->pool[spi_service_pool_spare(pool)];
+        while (mpool->total < mpool->target && spare->freenum > 0) {
+            lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&spare->list, spi_service_lnkhead_t, list);
+            platform_list_del(&lnkhead->list);
+            spare->freenum--;
+            spare->total--;
+            spi_service_pool_put(priv, lnkhead, pool);
+            mpool->total++;
+        }
+        if (mpool->lownum > mpool->freenum) {
+            mpool->lownum = mpool->freenum;
+        }
     }
+}
 
-    platform_list_init(&priv->txlist);
-    memset(g_spi_txmem, 0, sizeof(g_spi_txmem));
-    memaddr = SPI_SERVICE_ALIGN4((unsigned int)g_spi_txmem);
-    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_TX; idx++) {
+static void spi_service_arena_init(spi_server_mem_priv_t *priv, spi_service_lnkhead_t *link, unsigned char *arena, int num, int size, int spare)
+{
+    unsigned int memaddr = SPI_SERVICE_ALIGN4((unsigned int)arena);
+    int idx;
+
+    for (idx = 0; idx < num; idx++) {
         spi_service_rsvhead_t *rsvhead = (spi_service_rsvhead_t *)memaddr;
         rsvhead->addr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE;
         rsvhead->idx = idx;
         rsvhead->magic = SPI_SERVICE_MEM_FREE;
         rsvhead->mtype = 0xFF;
-        priv->txlink[idx].mhead = rsvhead;
-        platform_list_add_tail(&priv->txlink[idx].list, &priv->txlist);
-        priv->txnum++;
-        memaddr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE + SPI_SERVICE_MEM_DATA_SIZE;
+        link[idx].mhead = rsvhead;
+        spi_service_pool_put(priv, &link[idx], spare);
+        priv->pool[spare].total++;
+        memaddr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE + size;
     }
+}
+
+int spi_service_mem_init(void)
+{
+    spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
+    unsigned int flag;
+    int pool;
 
-    platform_list_init(&priv->msglist);
+    SPI_SERVICE_CHECK_RETURN(priv->status == (SPI_SERVICE_MEM_ALLOC&0xFF), -1, "spi mem already init");
+    flag = system_irq_save();
+    for (pool = 0; pool < SPI_SERVICE_POOL_ALL; pool++) {
+        platform_list_init(&priv->pool[pool].list);
+    }
+    memset(g_spi_datamem, 0, sizeof(g_spi_datamem));
     memset(g_spi_msgmem, 0, sizeof(g_spi_msgmem));
-    memaddr = SPI_SERVICE_ALIGN4((unsigned int)g_spi_msgmem);
-    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_MSG; idx++) {
-        spi_service_rsvhead_t *rsvhead = (spi_service_rsvhead_t *)memaddr;
-        rsvhead->addr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE;
-        rsvhead->idx = idx;
-        rsvhead->magic = SPI_SERVICE_MEM_FREE;
-        rsvhead->mtype = 0xFF;
-        priv->msglink[idx].mhead = rsvhead;
-        platform_list_add_tail(&priv->msglink[idx].list, &priv->msglist);
-        priv->msgnum++;
-        memaddr = (unsigned int)memaddr + SPI_SERVICE_MEM_RSV_SIZE + SPI_SERVICE_MEM_MSG_SIZE;
+    spi_service_arena_init(priv, priv->datalink, g_spi_datamem, SPI_SERVICE_MEM_NUM_DATA,
+                           SPI_SERVICE_MEM_DATA_SIZE, SPI_SERVICE_POOL_DATA_SPARE);
+    spi_service_arena_init(priv, priv->msglink, g_spi_msgmem, SPI_SERVICE_MEM_NUM_MSG,
+                           SPI_SERVICE_MEM_MSG_SIZE, SPI_SERVICE_POOL_MSG_SPARE);
+
+    priv->pool[SPI_SERVICE_POOL_RX].target = CONFIG_SPI_SERVICE_MEM_RX_NUM;
+    priv->pool[SPI_SERVICE_POOL_TX].target = SPI_SERVICE_MEM_NUM_DATA - CONFIG_SPI_SERVICE_MEM_RX_NUM;
+    priv->pool[SPI_SERVICE_POOL_MSG].target = SPI_SERVICE_MEM_NUM_MSG;
+    for (pool = 0; pool < SPI_SERVICE_POOL_MAX; pool++) {
+        priv->pool[pool].lownum = priv->pool[pool].target;
     }
+    spi_service_pool_rebalance(priv);
     system_irq_restore(flag);
     priv->status = SPI_SERVICE_MEM_ALLOC & 0xFF;
 
@@ -109,33 +178,67 @@ void spi_service_mem_deinit(void)
     spi_service_mem_init();
 }
 
+int spi_service_mem_resize(int rxnum, int txnum, int msgnum)
+{
+    spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
+    unsigned int flag;
+    int pending = 0;
+    int pool;
+
+    SPI_SERVICE_CHECK_RETURN(rxnum < 1 || txnum < 1 || rxnum + txnum > SPI_SERVICE_MEM_NUM_DATA, -1, "data slots out of range");
+    SPI_SERVICE_CHECK_RETURN(msgnum < 1 || msgnum > SPI_SERVICE_MEM_NUM_MSG, -1, "msg slots out of range");
+
+    flag = system_irq_save();
+    priv->pool[SPI_SERVICE_POOL_RX].target = rxnum;
+    priv->pool[SPI_SERVICE_POOL_TX].target = txnum;
+    priv->pool[SPI_SERVICE_POOL_MSG].target = msgnum;
+    spi_service_pool_rebalance(priv);
+    /* slots still in use when a pool shrinks move over as they are freed */
+    for (pool = 0; pool < SPI_SERVICE_POOL_MAX; pool++) {
+        priv->pool[pool].lownum = priv->pool[pool].freenum;
+        if (priv->pool[pool].total != priv->pool[pool].target) {
+            pending++;
+        }
+    }
+    system_irq_restore(flag);
+
+    return pending;
+}
+
+int spi_service_mem_stats(spi_service_mtype_e type, spi_service_pool_t *stats)
+{
+    spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
+    unsigned int flag;
+    int pool = spi_service_mtype_pool(type);
+
+    SPI_SERVICE_CHECK_RETURN(pool < 0 || stats == NULL, -1, "invalid pool");
+    flag = system_irq_save();
+    *stats = priv->pool[pool];
+    system_irq_restore(flag);
+
+    return 0;
+}
+
 static void *spi_service_mem_alloc(spi_service_mtype_e type)
 {
     spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
     spi_service_lnkhead_t *lnkhead = NULL;
-    unsigned int flag = system_irq_save();
+    spi_service_pool_t *mpool = NULL;
+    int pool = spi_service_mtype_pool(type);
+    unsigned int flag;
 
-    if (type == SPI_SERVICE_MEM_STARX || type == SPI_SERVICE_MEM_APRX) {
-        if (priv->rxnum > 0) {
-            lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&priv->rxlist, spi_service_lnkhead_t, list);
-            SPI_SERVICE_CHECK_RETURN(lnkhead == NULL, NULL, "mem rxlist error");
-            platform_list_del(&lnkhead->list);
-            priv->rxnum--;
-        }
-    } else if (type == SPI_SERVICE_MEM_STATX || type == SPI_SERVICE_MEM_APTX) {
-        if (priv->txnum > 0) {
-            lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&priv->txlist, spi_service_lnkhead_t, list);
-            SPI_SERVICE_CHECK_RETURN(lnkhead == NULL, NULL, "mem txlist error");
-            platform_list_del(&lnkhead->list);
-            priv->txnum--;
-        }
-    } else if (type == SPI_SERVICE_MEM_MSG) {
-        if (priv->msgnum > 0) {
-            lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&priv->msglist, spi_service_lnkhead_t, list);
-            SPI_SERVICE_CHECK_RETURN(lnkhead == NULL, NULL, "mem msglist error");
-            platform_list_del(&lnkhead->list);
-            priv->msgnum--;
+    SPI_SERVICE_CHECK_RETURN(pool < 0, NULL, "mem type error");
+    mpool = &priv->pool[pool];
+    flag = system_irq_save();
+    lnkhead = PLATFORM_LIST_FIRST_ENTRY_OR_NULL(&mpool->list, spi_service_lnkhead_t, list);
+    if (lnkhead != NULL) {
+        platform_list_del(&lnkhead->list);
+        mpool->freenum--;
+        if (mpool->lownum > mpool->freenum) {
+            mpool->lownum = mpool->freenum;
         }
+    } else {
+        mpool->failnum++;
     }
     system_irq_restore(flag);
 
@@ -149,56 +252,57 @@ static void *spi_service_mem_alloc(spi_service_mtype_e type)
     return NULL;
 }
 
-static void *spi_service_mem_free(void *maddr)
+static spi_service_lnkhead_t *spi_service_mem_lnkhead(void *maddr)
 {
     spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
     spi_service_rsvhead_t *rsvhead = (spi_service_rsvhead_t *)((unsigned int)maddr - SPI_SERVICE_MEM_RSV_SIZE);
+
+    if (((unsigned int)maddr > (unsigned int)g_spi_datamem) &&
+        ((unsigned int)maddr < (unsigned int)g_spi_datamem + SPI_SERVICE_MEM_DATA_TOTAL)) {
+        return &priv->datalink[rsvhead->idx];
+    }
+
+    if (((unsigned int)maddr > (unsigned int)g_spi_msgmem) &&
+        ((unsigned int)maddr < (unsigned int)g_spi_msgmem + SPI_SERVICE_MEM_MSG_TOTAL)) {
+        return &priv->msglink[rsvhead->idx];
+    }
+
+    return NULL;
+}
+
+static void *spi_service_mem_free(void *maddr)
+{
+    spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
+    spi_service_lnkhead_t *lnkhead = spi_service_mem_lnkhead(maddr);
+    spi_service_rsvhead_t *rsvhead = NULL;
     unsigned int flag;
 
-    flag = system_irq_save();
-    if (((unsigned int)maddr > (unsigned int)g_spi_rxmem) &&
-        ((unsigned int)maddr < (unsigned int)g_spi_rxmem + SPI_SERVICE_MEM_RX_TOTAL)) {
-        SPI_SERVICE_CHECK_RETURN(rsvhead->magic != SPI_SERVICE_MEM_ALLOC, maddr, "rxmem magic error");
-        rsvhead->magic = SPI_SERVICE_MEM_FREE;
-        rsvhead->mtype = 0xFF;
-        platform_list_add(&priv->rxlink[rsvhead->idx].list, &priv->rxlist);
-        priv->rxnum++;
-        system_irq_restore(flag);
-        return NULL;
+    if (lnkhead == NULL) {
+        return maddr;
     }
 
-    if (((unsigned int)maddr > (unsigned int)g_spi_txmem) &&
-        ((unsigned int)maddr < (unsigned int)g_spi_txmem + SPI_SERVICE_MEM_TX_TOTAL)) {
-        SPI_SERVICE_CHECK_RETURN(rsvhead->magic != SPI_SERVICE_MEM_ALLOC, maddr, "txmem magic error");
+    rsvhead = lnkhead->mhead;
+    flag = system_irq_save();
+    if (rsvhead->magic == SPI_SERVICE_MEM_ALLOC) {
         rsvhead->magic = SPI_SERVICE_MEM_FREE;
         rsvhead->mtype = 0xFF;
-        platform_list_add(&priv->txlink[rsvhead->idx].list, &priv->txlist);
-        priv->txnum++;
-        system_irq_restore(flag);
-        return NULL;
-    }
-
-    if (((unsigned int)maddr > (unsigned int)g_spi_msgmem) &&
-        ((unsigned int)maddr < (unsigned int)g_spi_msgmem + SPI_SERVICE_MEM_MSG_TOTAL)) {
-            SPI_SERVICE_CHECK_RETURN(rsvhead->magic != SPI_SERVICE_MEM_ALLOC, maddr, "msgmem magic error");
-            rsvhead->magic = SPI_SERVICE_MEM_FREE;
-            rsvhead->mtype = 0xFF;
-            platform_list_add(&priv->msglink[rsvhead->idx].list, &priv->msglist);
-            priv->msgnum++;
-            system_irq_restore(flag);
-            return NULL;
+        spi_service_pool_put(priv, lnkhead, lnkhead->pool);
+        /* a pool shrunk by spi_service_mem_resize() gives the slot back */
+        if (priv->pool[lnkhead->pool].total > priv->pool[lnkhead->pool].target) {
+            spi_service_pool_rebalance(priv);
+        }
+        maddr = NULL;
     }
     system_irq_restore(flag);
+    SPI_SERVICE_CHECK_RETURN(maddr != NULL, maddr, "mem magic error");
 
-    return maddr;
+    return NULL;
 }
 
 void *spi_service_mpool_check(void *maddr)
 {
-    if ((((unsigned int)maddr > (unsigned int)g_spi_rxmem) &&
-        ((unsigned int)maddr < (unsigned int)g_spi_rxmem + SPI_SERVICE_MEM_RX_TOTAL)) ||
-        (((unsigned int)maddr > (unsigned int)g_spi_txmem) &&
-        ((unsigned int)maddr < (unsigned int)g_spi_txmem + SPI_SERVICE_MEM_TX_TOTAL)) ||
+    if ((((unsigned int)maddr > (unsigned int)g_spi_datamem) &&
+        ((unsigned int)maddr < (unsigned int)g_spi_datamem + SPI_SERVICE_MEM_DATA_TOTAL)) ||
         (((unsigned int)maddr > (unsigned int)g_spi_msgmem) &&
         ((unsigned int)maddr < (unsigned int)g_spi_msgmem + SPI_SERVICE_MEM_MSG_TOTAL))) {
             return maddr;
@@ -237,20 +341,41 @@ void *spi_service_mpbuf_alloc(spi_service_mtype_e type, int size)
     return (void *)buf;
 }
 
+/* a pool pbuf may be held by the SPI transport and the lwip stack at once,
+ * each holder owns one reference and the last one gives the slot back */
+void spi_service_mpbuf_ref(struct pbuf *buf)
+{
+    unsigned int flag = system_irq_save();
+
+    buf->ref++;
+    system_irq_restore(flag);
+}
+
 void *spi_service_mpbuf_free(struct pbuf *buf)
 {
     if (spi_service_mpool_check(buf) != NULL) {
         unsigned int flag = system_irq_save();
+        unsigned int ref;
+
         if (buf->ref > 0) {
             buf->ref--;
         }
+        ref = buf->ref;
         system_irq_restore(flag);
 
-        if (buf->ref == 0) {
-            return spi_service_mpool_free(buf);
+        if (ref != 0) {
+            return NULL;
+        }
+
+        /* wifi rx buffers go back through the wifi driver */
+        if ((buf->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
+            struct pbuf_custom *pc = (struct pbuf_custom *)buf;
+            SPI_SERVICE_CHECK_RETURN(pc->custom_free_function == NULL, buf, "wifi buff not correct");
+            pc->custom_free_function(buf);
+            return NULL;
         }
 
-        return NULL;
+        return spi_service_mpool_free(buf);
     }
 
     return buf;
@@ -345,14 +470,13 @@ void *spi_service_smem_free(spi_service_mem_t *smem)
 
     switch (smem->memType) {
         case SPI_SERVICE_TYPE_STOH:
+            /* drops the transport reference, a frame lent to lwip stays until it is freed there too */
             buf = (struct pbuf *)smem->memAddr;
-            if ((buf->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
+            if (spi_service_mpbuf_free(buf) != NULL && (buf->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
                 struct pbuf_custom *pc = (struct pbuf_custom *)buf;
                 SPI_SERVICE_CHECK_RETURN(pc->custom_free_function == NULL, NULL, "wifi buff not correct");
                 pc->custom_free_function(buf);
-                break;
             }
-            spi_service_mpbuf_free((void *)smem->memAddr);
             break;
         case SPI_SERVICE_TYPE_HTOS:
             spi_service_mpbuf_free((void *)smem->memAddr);
@@ -374,23 +498,25 @@ static void spi_service_mlist_dump(void)
     spi_server_mem_priv_t *priv = spi_service_mlist_priv_get();
     unsigned int flag = system_irq_save();
     spi_service_rsvhead_t *rsvhead = NULL;
+    spi_service_pool_t *mpool = NULL;
     int idx;
 
-    os_printf(LM_APP, LL_INFO, "rxnum %d txnum %d msgnum %d\n", priv->rxnum, priv->txnum, priv->msgnum);
-    os_printf(LM_APP, LL_INFO, "###########################################\n");
-    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_RX; idx++) {
-        rsvhead = priv->rxlink[idx].mhead;
-        os_printf(LM_APP, LL_INFO, "RXLIST(%d) DATA ADDR:0x%08x TYPE:%d MAGIC:0x%x\n", rsvhead->idx, rsvhead->addr, rsvhead->mtype, rsvhead->magic);
+    for (idx = 0; idx < SPI_SERVICE_POOL_ALL; idx++) {
+        mpool = &priv->pool[idx];
+        os_printf(LM_APP, LL_INFO, "%-10s free %d total %d target %d low %d fail %u\n", g_spi_pool_name[idx],
+                  mpool->freenum, mpool->total, mpool->target, mpool->lownum, mpool->failnum);
     }
-
-    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_TX; idx++) {
-        rsvhead = priv->txlink[idx].mhead;
-        os_printf(LM_APP, LL_INFO, "TXLIST(%d) DATA ADDR:0x%08x TYPE:%d MAGIC:0x%x\n", rsvhead->idx, rsvhead->addr, rsvhead->mtype, rsvhead->magic);
+    os_printf(LM_APP, LL_INFO, "###########################################\n");
+    for (idx = 0; idx < SPI_SERVICE_MEM_NUM_DATA; idx++) {
+        rsvhead = priv->datalink[idx].mhead;
+        os_printf(LM_APP, LL_INFO, "%sLIST(%d) DATA ADDR:0x%08x TYPE:%d MAGIC:0x%x\n", g_spi_pool_name[priv->datalink[idx].pool],
+                  rsvhead->idx, rsvhead->addr, rsvhead->mtype, rsvhead->magic);
     }
 
     for (idx = 0; idx < SPI_SERVICE_MEM_NUM_MSG; idx++) {
         rsvhead = priv->msglink[idx].mhead;
-        os_printf(LM_APP, LL_INFO, "MSGLIST(%d) DATA ADDR:0x%08x TYPE:%d MAGIC:0x%x\n", rsvhead->idx, rsvhead->addr, rsvhead->mtype, rsvhead->magic);
+        os_printf(LM_APP, LL_INFO, "%sLIST(%d) DATA ADDR:0x%08x TYPE:%d MAGIC:0x%x\n", g_spi_pool_name[priv->msglink[idx].pool],
+                  rsvhead->idx, rsvhead->addr, rsvhead->mtype, rsvhead->magic);
     }
 
     system_irq_restore(flag);
@@ -403,4 +529,25 @@ static int spi_service_cmd_dump(cmd_tbl_t *t, int argc, char *argv[])
     return CMD_RET_SUCCESS;
 }
 
-CLI_CMD(spi_mem_dump, spi_service_cmd_dump, "spi service memory info", "spi service mem info");
\ No newline at end of file
+CLI_CMD(spi_mem_dump, spi_service_cmd_dump, "spi service memory info", "spi service mem info");
+
+static int spi_service_cmd_resize(cmd_tbl_t *t, int argc, char *argv[])
+{
+    int ret;
+
+    if (argc != 4) {
+        return CMD_RET_USAGE;
+    }
+
+    ret = spi_service_mem_resize(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]));
+    if (ret < 0) {
+        return CMD_RET_FAILURE;
+    }
+    if (ret > 0) {
+        os_printf(LM_APP, LL_INFO, "%d pools resize as their slots are freed\n", ret);
+    }
+
+    return CMD_RET_SUCCESS;
+}
+
+CLI_CMD(spi_mem_resize, spi_service_cmd_resize, "spi service memory pool resize", "spi_mem_resize rxnum txnum msgnum");
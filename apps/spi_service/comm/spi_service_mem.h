@@ -32,9 +32,31 @@ typedef struct {
 typedef struct {
     spi_service_rsvhead_t *mhead;
     platform_list_t list;
+    unsigned char pool;
 } spi_service_lnkhead_t;
 
+/* rx and tx pools share the data slots, msg pool has its own */
+typedef enum {
+    SPI_SERVICE_POOL_RX,
+    SPI_SERVICE_POOL_TX,
+    SPI_SERVICE_POOL_MSG,
+    SPI_SERVICE_POOL_MAX,
+} spi_service_pool_e;
+
+typedef struct {
+    platform_list_t list;
+    unsigned char freenum;
+    unsigned char total;
+    unsigned char target;
+    unsigned char lownum;
+    unsigned int failnum;
+} spi_service_pool_t;
+
 int spi_service_mem_init(void);
+/* set the slots of each pool, returns how many pools wait for busy slots to be freed, -1 on error */
+int spi_service_mem_resize(int rxnum, int txnum, int msgnum);
+int spi_service_mem_stats(spi_service_mtype_e type, spi_service_pool_t *stats);
+void spi_service_mpbuf_ref(struct pbuf *p);
 void *spi_service_mpbuf_alloc(spi_service_mtype_e type, int size);
 void *spi_service_mpbuf_free(struct pbuf *p);
 void *spi_service_mpool_check(void *memPtr);
@@ -13,6 +13,10 @@
 #ifdef CONFIG_SPI_SLAVE
 #include "vnet_filter.h"
 #include "vnet_int.h"
+#include "vnet_service.h"
+#include "spi_service_mem.h"
+#include "pit.h"
+#include "chip_clk_ctrl.h"
 
 #define VNET_MAX_PORT_RANGE 65535
 
@@ -219,6 +223,313 @@ static int spi_slave_filter_default_test(cmd_tbl_t *t, int argc, char *argv[])
 
 CLI_CMD(filter_default, spi_slave_filter_default_test, "filter default", "filter_default local_lwip(0)/host_controller(1)");
 
+#define VNET_BENCH_TICKS_PER_US (CHIP_CLOCK_APB / 1000000)
+
+static unsigned int vnet_bench_seed;
+
+static unsigned int vnet_bench_rand(void)
+{
+    vnet_bench_seed = vnet_bench_seed * 1103515245 + 12345;
+    return vnet_bench_seed >> 8;
+}
+
+/* the rule walk the classifier replaced, first match in priority order */
+static int vnet_bench_linear(const vnet_ipv4_filter *rules, unsigned int cnt, const unsigned char *pkt)
+{
+    unsigned int ip = (pkt[12] << 24) + (pkt[13] << 16) + (pkt[14] << 8) + pkt[15];
+    unsigned short sport = (pkt[20] << 8) + pkt[21];
+    unsigned short dport = (pkt[22] << 8) + pkt[23];
+    unsigned int i;
+
+    for (i = 0; i < cnt; i++) {
+        const vnet_ipv4_filter *ft = &rules[i];
+
+        if ((ft->mask & VNET_FILTER_MASK_IPADDR) && ip != ft->ipaddr) {
+            continue;
+        }
+        if ((ft->mask & VNET_FILTER_MASK_PROTOCOL) && pkt[9] != ft->packeType) {
+            continue;
+        }
+        if ((ft->mask & (VNET_FILTER_MASK_DST_PORT | VNET_FILTER_MASK_DST_PORT_RANGE)) &&
+            dport != ft->dstPort && (ft->dstPmin > dport || ft->dstPmax < dport)) {
+            continue;
+        }
+        if ((ft->mask & (VNET_FILTER_MASK_SRC_PORT | VNET_FILTER_MASK_SRC_PORT_RANGE)) &&
+            sport != ft->srcPort && (ft->srcPmin > sport || ft->srcPmax < sport)) {
+            continue;
+        }
+        return i;
+    }
+    return -1;
+}
+
+/* rules and traffic drawn from a small pool of hosts and ports so that a
+ * fair share of packets hits a rule */
+static void vnet_bench_rule(vnet_ipv4_filter *ft)
+{
+    unsigned int r = vnet_bench_rand();
+
+    memset(ft, 0, sizeof(*ft));
+    ft->dir = r % 3;
+    if (r & 0x10) {
+        ft->mask |= VNET_FILTER_MASK_IPADDR;
+        ft->ipaddr = 0xc0a80100 + vnet_bench_rand() % 16;
+    }
+    if (r & 0x20) {
+        ft->mask |= VNET_FILTER_MASK_PROTOCOL;
+        ft->packeType = (r & 0x40) ? IPPROTO_TCP : IPPROTO_UDP;
+    }
+    if (r & 0x80) {
+        ft->mask |= VNET_FILTER_MASK_DST_PORT_RANGE;
+        ft->dstPmin = 1000 + vnet_bench_rand() % 2000;
+        ft->dstPmax = ft->dstPmin + 1 + vnet_bench_rand() % 200;
+    } else {
+        ft->mask |= VNET_FILTER_MASK_DST_PORT;
+        ft->dstPort = 1000 + vnet_bench_rand() % 2000;
+    }
+    if ((r & 0x300) == 0x300) {
+        ft->mask |= VNET_FILTER_MASK_SRC_PORT;
+        ft->srcPort = 5000 + vnet_bench_rand() % 64;
+    }
+}
+
+static void vnet_bench_packet(unsigned char *pkt)
+{
+    unsigned int ip = 0xc0a80100 + vnet_bench_rand() % 16;
+    unsigned short sport = 5000 + vnet_bench_rand() % 64;
+    unsigned short dport = 1000 + vnet_bench_rand() % 2400;
+
+    memset(pkt, 0, 24);
+    pkt[0] = 0x45;
+    pkt[9] = (vnet_bench_rand() & 1) ? IPPROTO_TCP : IPPROTO_UDP;
+    pkt[12] = ip >> 24;
+    pkt[13] = ip >> 16;
+    pkt[14] = ip >> 8;
+    pkt[15] = ip;
+    pkt[20] = sport >> 8;
+    pkt[21] = sport;
+    pkt[22] = dport >> 8;
+    pkt[23] = dport;
+}
+
+static int spi_slave_filter_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+    vnet_ipv4_filter *rules = NULL;
+    vnet_filter_table_t *table = NULL;
+    unsigned char *pkts = NULL;
+    unsigned int cnt, num, i, hits = 0, begin, ticks[2];
+    volatile int sink = 0;
+    int ret = CMD_RET_FAILURE;
+
+    if (argc != 3) {
+        os_printf(LM_APP, LL_INFO, "filter_bench rules packets\n");
+        return CMD_RET_FAILURE;
+    }
+    cnt = strtoul(argv[1], NULL, 0);
+    num = strtoul(argv[2], NULL, 0);
+    if (cnt == 0 || num == 0) {
+        return CMD_RET_FAILURE;
+    }
+
+    vnet_bench_seed = cnt * 31 + num;
+    rules = os_malloc(cnt * sizeof(vnet_ipv4_filter));
+    pkts = os_malloc(num * 24);
+    if (rules == NULL || pkts == NULL) {
+        os_printf(LM_APP, LL_INFO, "no memory\n");
+        goto out;
+    }
+    for (i = 0; i < cnt; i++) {
+        vnet_bench_rule(&rules[i]);
+    }
+    for (i = 0; i < num; i++) {
+        vnet_bench_packet(&pkts[i * 24]);
+    }
+
+    begin = drv_pit_get_tick();
+    table = vnet_filter_compile(rules, cnt);
+    ticks[0] = drv_pit_get_tick() - begin;
+    if (table == NULL) {
+        os_printf(LM_APP, LL_INFO, "compile failed\n");
+        goto out;
+    }
+    os_printf(LM_APP, LL_INFO, "%u rules compiled in %uus\n", cnt, ticks[0] / VNET_BENCH_TICKS_PER_US);
+
+    for (i = 0; i < num; i++) {
+        int a = vnet_bench_linear(rules, cnt, &pkts[i * 24]);
+        int b = vnet_filter_classify(table, &pkts[i * 24]);
+        if (a != b) {
+            os_printf(LM_APP, LL_INFO, "packet %u: linear rule %d, compiled rule %d\n", i, a, b);
+            goto out;
+        }
+        hits += (a >= 0);
+    }
+
+    begin = drv_pit_get_tick();
+    for (i = 0; i < num; i++) {
+        sink += vnet_bench_linear(rules, cnt, &pkts[i * 24]);
+    }
+    ticks[0] = drv_pit_get_tick() - begin;
+    begin = drv_pit_get_tick();
+    for (i = 0; i < num; i++) {
+        sink += vnet_filter_classify(table, &pkts[i * 24]);
+    }
+    ticks[1] = drv_pit_get_tick() - begin;
+
+    os_printf(LM_APP, LL_INFO, "%u packets, %u matched\n", num, hits);
+    os_printf(LM_APP, LL_INFO, "linear   %u ns/packet\n", ticks[0] * 25 / num);
+    os_printf(LM_APP, LL_INFO, "compiled %u ns/packet\n", ticks[1] * 25 / num);
+    ret = CMD_RET_SUCCESS;
+
+out:
+    vnet_filter_table_free(table);
+    if (rules) {
+        os_free(rules);
+    }
+    if (pkts) {
+        os_free(pkts);
+    }
+    return ret;
+}
+
+CLI_CMD(filter_bench, spi_slave_filter_bench, "filter classify benchmark", "filter_bench rules packets");
+
+/* wifi rx to SPI host handoff over a loopback transport: the stand-in reads
+ * each frame like the SPI DMA would and completes it like spi_service_tx_done */
+#define VNET_BENCH_HDR_LEN 42
+#define VNET_BENCH_PORT 9
+
+static volatile unsigned int vnet_bench_sum;
+
+static void vnet_bench_loop_send(spi_service_mem_t *smem)
+{
+    unsigned int *data = (unsigned int *)(smem->memAddr + smem->memOffset);
+    unsigned int i, sum = 0;
+
+    for (i = 0; i < smem->memLen / 4; i++) {
+        sum += data[i];
+    }
+    vnet_bench_sum += sum;
+
+    spi_service_smem_free(smem);
+    spi_mqueue_put(smem);
+}
+
+static void vnet_bench_frame(unsigned char *hdr, unsigned int len)
+{
+    unsigned int iplen = len - 14;
+
+    memset(hdr, 0, VNET_BENCH_HDR_LEN);
+    memset(hdr, 0xff, 6);
+    hdr[12] = 0x08;
+    hdr[14] = 0x45;
+    hdr[16] = iplen >> 8;
+    hdr[17] = iplen;
+    hdr[22] = 64;
+    hdr[23] = IPPROTO_UDP;
+    hdr[26] = 192;
+    hdr[27] = 168;
+    hdr[28] = 1;
+    hdr[29] = 2;
+    hdr[30] = 0xff;
+    hdr[31] = 0xff;
+    hdr[32] = 0xff;
+    hdr[33] = 0xff;
+    hdr[35] = VNET_BENCH_PORT;
+    hdr[37] = VNET_BENCH_PORT;
+    hdr[38] = (iplen - 20) >> 8;
+    hdr[39] = iplen - 20;
+}
+
+static int spi_slave_vnet_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+    unsigned char hdr[VNET_BENCH_HDR_LEN];
+    vnet_service_stats_t before, after;
+    vnet_ipv4_filter rule = {0};
+    vnet_reg_t *vReg = vnet_reg_get_addr();
+    struct netif *inp = get_netif_by_index(STATION_IF);
+    unsigned int num, len, i, done = 0, status, begin, ticks;
+    int mode, ret;
+    struct pbuf *p;
+
+    if (argc != 4) {
+        os_printf(LM_APP, LL_INFO, "vnet_bench host/lend/copy frames len\n");
+        return CMD_RET_FAILURE;
+    }
+    if (strcmp(argv[1], "host") == 0) {
+        mode = 0;
+    } else if (strcmp(argv[1], "lend") == 0) {
+        mode = 1;
+    } else if (strcmp(argv[1], "copy") == 0) {
+        mode = 2;
+    } else {
+        return CMD_RET_FAILURE;
+    }
+    num = strtoul(argv[2], NULL, 0);
+    len = strtoul(argv[3], NULL, 0);
+    if (num == 0 || len < VNET_BENCH_HDR_LEN || len > SPI_SERVICE_MEM_DATA_MTU) {
+        return CMD_RET_FAILURE;
+    }
+
+    /* lend and copy send the frame to both sides, copy as a heap frame does */
+    if (mode != 0) {
+        rule.dir = VNET_PACKET_DICTION_BOTH;
+        rule.mask = VNET_FILTER_MASK_PROTOCOL | VNET_FILTER_MASK_DST_PORT;
+        rule.packeType = IPPROTO_UDP;
+        rule.dstPort = VNET_BENCH_PORT;
+        if (vnet_add_filter(&rule, sizeof(rule), VNET_FILTER_TYPE_IPV4) != 0) {
+            return CMD_RET_FAILURE;
+        }
+    }
+    vnet_bench_frame(hdr, len);
+    status = vReg->status;
+    vReg->status = VNET_WIFI_LINK_UP;
+    vnet_service_set_host_send(vnet_bench_loop_send);
+    vnet_service_get_stats(&before);
+
+    begin = drv_pit_get_tick();
+    for (i = 0; i < num; i++) {
+        if (mode == 2) {
+            p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+        } else {
+            p = spi_service_mpbuf_alloc(SPI_SERVICE_MEM_STARX, len);
+        }
+        if (p == NULL) {
+            continue;
+        }
+        memcpy(p->payload, hdr, VNET_BENCH_HDR_LEN);
+        ret = vnet_service_wifi_rx(p, inp);
+        if (ret == 0) {
+            /* lwip is done with the frame */
+            if (vnet_service_wifi_rx_free(p, NULL) == 0) {
+                pbuf_free(p);
+            }
+        }
+        done++;
+    }
+    ticks = drv_pit_get_tick() - begin;
+
+    vnet_service_get_stats(&after);
+    vnet_service_set_host_send(NULL);
+    vReg->status = status;
+    if (mode != 0) {
+        vnet_del_filter(&rule, sizeof(rule), VNET_FILTER_TYPE_IPV4);
+    }
+
+    if (done == 0 || ticks == 0) {
+        os_printf(LM_APP, LL_INFO, "no memory\n");
+        return CMD_RET_FAILURE;
+    }
+    os_printf(LM_APP, LL_INFO, "%u frames of %u bytes: zero copy %u lent %u copied %u dropped %u\n", done, len,
+              after.zcopynum - before.zcopynum, after.lendnum - before.lendnum,
+              after.copynum - before.copynum, after.dropnum - before.dropnum);
+    os_printf(LM_APP, LL_INFO, "%u ns/frame, %u Mbit/s\n", (unsigned int)((unsigned long long)ticks * 25 / done),
+              (unsigned int)((unsigned long long)done * len * 320 / ticks));
+
+    return CMD_RET_SUCCESS;
+}
+
+CLI_CMD(vnet_bench, spi_slave_vnet_bench, "vnet rx handoff benchmark", "vnet_bench host/lend/copy frames len");
+
 static int spi_slave_interrupt_init(cmd_tbl_t *t, int argc, char *argv[])
 {
     unsigned int num;
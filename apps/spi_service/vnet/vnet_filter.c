@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include "vnet_filter.h"
 #include "spi_service_main.h"
 #include "lwip/ip4.h"
@@ -5,81 +6,419 @@
 #include "lwip/etharp.h"
 #include "oshal.h"
 
-#define VNET_FILTER_RULE_MAX 20
+#ifndef CONFIG_VNET_FILTER_RULE_MAX
+#define CONFIG_VNET_FILTER_RULE_MAX 128
+#endif
+#define VNET_FILTER_RULE_MAX CONFIG_VNET_FILTER_RULE_MAX
+
+/* fields a hashed rule compares exactly, the others are wildcards */
+#define VNET_FILTER_KEY_IP     0x1
+#define VNET_FILTER_KEY_PROTO  0x2
+#define VNET_FILTER_KEY_DPORT  0x4
+#define VNET_FILTER_KEY_SHAPES 8
+
+typedef struct
+{
+    unsigned int ip;
+    unsigned short dport;
+    unsigned char proto;
+    unsigned char shape;
+    unsigned short rule;    /* index into the table rules */
+    unsigned short next;    /* next entry of the bucket + 1, 0 ends the chain */
+} vnet_filter_hent_t;
+
+/*
+ * compiled rule table, read only once published. rules are in priority
+ * order (index 0 wins), every rule has one hash entry keyed on the fields it
+ * compares exactly, rules with a dst port range are also listed in the
+ * interval table: the ranges cut the port space into segments, each segment
+ * lists the rules covering it. a lookup only checks these candidates, and
+ * only the ones that would beat the best match so far.
+ */
+struct vnet_filter_table
+{
+    unsigned short cnt;
+    unsigned short hash_mask;
+    unsigned short seg_cnt;
+    unsigned char shapes;           /* bit n set: some rule hashed with shape n */
+    vnet_ipv4_filter *rules;
+    vnet_filter_hent_t *hent;
+    unsigned int *seg_start;        /* seg_cnt + 1 sorted bounds */
+    unsigned int *seg_off;          /* segment i rules: seg_idx[seg_off[i]] .. seg_idx[seg_off[i + 1] - 1] */
+    unsigned short *seg_idx;
+    unsigned short *hash_head;      /* bucket -> first entry + 1 */
+};
 
-typedef struct _ip_filter
+typedef struct
 {
-    struct _ip_filter *next;
-    union {
-        vnet_ipv4_filter ipv4Filter;
-    } filter;
-} vnet_ip_filter_t;
+    unsigned int cnt;
+    vnet_ipv4_filter *rules;        /* in the order they were added */
+    vnet_filter_table_t *list;      /* rules for one side, newest first */
+    vnet_filter_table_t *blist;     /* rules for both sides, newest first */
+} vnet_filter_set_t;
 
 typedef struct
 {
-    vnet_ip_filter_t *ipv4List;
-    vnet_ip_filter_t *ipv4Blist;
+    vnet_filter_set_t *volatile set;
+    os_mutex_handle_t lock;
     unsigned char default_dir;
 } vnet_ipfilter_list;
 
 vnet_ipfilter_list g_ip_list;
 
-static unsigned int vnet_get_list_cnt(unsigned char ip_type)
+#define GET_IP(x) (((x)[12] << 24) + ((x)[13] << 16) + ((x)[14] << 8) + (x)[15])
+#define GET_PROTO(x) ((x)[9])
+#define GET_IPLEN(x) (((x)[0] & 0xF) * 4)
+#define GET_SPORT(x) ((((x)[GET_IPLEN(x) + 0]) << 8) + ((x)[GET_IPLEN(x) + 1]))
+#define GET_DPORT(x) ((((x)[GET_IPLEN(x) + 2]) << 8) + ((x)[GET_IPLEN(x) + 3]))
+
+static int vnet_filter_rule_match(const vnet_ipv4_filter *ft, unsigned int ip, unsigned char proctol,
+                                  unsigned short sport, unsigned short dport)
 {
-    unsigned int listcnt = 0;
-    vnet_ip_filter_t *list = NULL;
-    vnet_ip_filter_t *blist = NULL;
-    unsigned int flag = system_irq_save();
+    if ((ft->mask & VNET_FILTER_MASK_IPADDR) && ip != ft->ipaddr) {
+        return 0;
+    }
 
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        list = g_ip_list.ipv4List;
-        blist = g_ip_list.ipv4Blist;
+    if ((ft->mask & VNET_FILTER_MASK_PROTOCOL) && proctol != ft->packeType) {
+        return 0;
     }
 
-    while (list || blist) {
-        if (list != NULL) {
-            list = list->next;
-            listcnt++;
+    if (ft->mask & (VNET_FILTER_MASK_DST_PORT | VNET_FILTER_MASK_DST_PORT_RANGE)) {
+        if (dport != ft->dstPort && (ft->dstPmin > dport || ft->dstPmax < dport)) {
+            return 0;
         }
+    }
 
-        if (blist != NULL) {
-            blist = blist->next;
-            listcnt++;
+    if (ft->mask & (VNET_FILTER_MASK_SRC_PORT | VNET_FILTER_MASK_SRC_PORT_RANGE)) {
+        if (sport != ft->srcPort && (ft->srcPmin > sport || ft->srcPmax < sport)) {
+            return 0;
         }
     }
 
-    system_irq_restore(flag);
-    return listcnt;
+    return 1;
 }
 
-void vnet_ip_filter_clearall(unsigned char ip_type)
+static unsigned char vnet_filter_rule_shape(const vnet_ipv4_filter *ft)
 {
-    vnet_ip_filter_t *list = NULL;
-    vnet_ip_filter_t *blist = NULL;
-    vnet_ip_filter_t *dnode = NULL;
-    unsigned long flag = system_irq_save();
+    unsigned char shape = 0;
 
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        list = g_ip_list.ipv4List;
-        blist = g_ip_list.ipv4Blist;
+    if (ft->mask & VNET_FILTER_MASK_IPADDR) {
+        shape |= VNET_FILTER_KEY_IP;
+    }
+    if (ft->mask & VNET_FILTER_MASK_PROTOCOL) {
+        shape |= VNET_FILTER_KEY_PROTO;
+    }
+    if (ft->mask & (VNET_FILTER_MASK_DST_PORT | VNET_FILTER_MASK_DST_PORT_RANGE)) {
+        shape |= VNET_FILTER_KEY_DPORT;
+    }
+    return shape;
+}
+
+static inline unsigned int vnet_filter_hash(unsigned int ip, unsigned char proto, unsigned short dport,
+                                            unsigned char shape)
+{
+    unsigned int h = ip * 0x9e3779b1 ^ ((dport << 8 | proto) + shape) * 0x85ebca6b;
+
+    return h ^ (h >> 15);
+}
+
+static int vnet_filter_bound_cmp(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int vnet_filter_has_range(const vnet_ipv4_filter *ft)
+{
+    return (ft->mask & (VNET_FILTER_MASK_DST_PORT | VNET_FILTER_MASK_DST_PORT_RANGE)) &&
+           ft->dstPmin <= ft->dstPmax;
+}
+
+vnet_filter_table_t *vnet_filter_compile(const vnet_ipv4_filter *rules, unsigned int cnt)
+{
+    vnet_filter_table_t *table;
+    unsigned int *bounds = NULL;
+    unsigned int nb = 0, nseg = 0, members = 0, buckets = 4;
+    unsigned int i, j, k, size;
+    char *p;
+
+    if (cnt > 0xFFFF) {
+        return NULL;
     }
 
-    while (list || blist) {
-        if (list) {
-            dnode = list;
-            list = list->next;
-            os_free(dnode);
+    /* segment bounds: every range [min, max] starts a segment at min and
+     * ends it before max + 1 */
+    for (i = 0; i < cnt; i++) {
+        nb += vnet_filter_has_range(&rules[i]) ? 2 : 0;
+    }
+    if (nb) {
+        bounds = os_malloc(nb * sizeof(unsigned int));
+        if (bounds == NULL) {
+            return NULL;
         }
+        for (i = 0, j = 0; i < cnt; i++) {
+            if (vnet_filter_has_range(&rules[i])) {
+                bounds[j++] = rules[i].dstPmin;
+                bounds[j++] = rules[i].dstPmax + 1;
+            }
+        }
+        qsort(bounds, nb, sizeof(unsigned int), vnet_filter_bound_cmp);
+        for (i = 1, j = 1; i < nb; i++) {
+            if (bounds[i] != bounds[j - 1]) {
+                bounds[j++] = bounds[i];
+            }
+        }
+        nb = j;
+        nseg = nb - 1;
+
+        for (k = 0; k < nseg; k++) {
+            for (i = 0; i < cnt; i++) {
+                if (vnet_filter_has_range(&rules[i]) &&
+                    rules[i].dstPmin <= bounds[k] && bounds[k] <= rules[i].dstPmax) {
+                    members++;
+                }
+            }
+        }
+    }
 
-        if (blist) {
-            dnode = blist;
-            blist = blist->next;
-            os_free(dnode);
+    while (buckets < cnt * 2) {
+        buckets <<= 1;
+    }
+
+    /* one block: word aligned arrays first, halfwords after */
+    size = sizeof(*table) + cnt * sizeof(vnet_ipv4_filter) + cnt * sizeof(vnet_filter_hent_t) +
+           nb * sizeof(unsigned int) + (nb ? nseg + 1 : 0) * sizeof(unsigned int) +
+           members * sizeof(unsigned short) + buckets * sizeof(unsigned short);
+    table = os_zalloc(size);
+    if (table == NULL) {
+        if (bounds) {
+            os_free(bounds);
+        }
+        return NULL;
+    }
+    p = (char *)(table + 1);
+    table->rules = (vnet_ipv4_filter *)p;
+    p += cnt * sizeof(vnet_ipv4_filter);
+    table->hent = (vnet_filter_hent_t *)p;
+    p += cnt * sizeof(vnet_filter_hent_t);
+    table->seg_start = (unsigned int *)p;
+    p += nb * sizeof(unsigned int);
+    table->seg_off = (unsigned int *)p;
+    p += (nb ? nseg + 1 : 0) * sizeof(unsigned int);
+    table->seg_idx = (unsigned short *)p;
+    p += members * sizeof(unsigned short);
+    table->hash_head = (unsigned short *)p;
+
+    table->cnt = cnt;
+    table->hash_mask = buckets - 1;
+    table->seg_cnt = nseg;
+    memcpy(table->rules, rules, cnt * sizeof(vnet_ipv4_filter));
+
+    /* pushing the lowest priority first leaves every chain sorted by rule
+     * index, so a lookup stops at the first hit */
+    for (i = cnt; i-- > 0;) {
+        const vnet_ipv4_filter *ft = &rules[i];
+        vnet_filter_hent_t *e = &table->hent[i];
+        unsigned int h;
+
+        e->shape = vnet_filter_rule_shape(ft);
+        e->ip = (e->shape & VNET_FILTER_KEY_IP) ? ft->ipaddr : 0;
+        e->proto = (e->shape & VNET_FILTER_KEY_PROTO) ? ft->packeType : 0;
+        e->dport = (e->shape & VNET_FILTER_KEY_DPORT) ? ft->dstPort : 0;
+        e->rule = i;
+        h = vnet_filter_hash(e->ip, e->proto, e->dport, e->shape) & table->hash_mask;
+        e->next = table->hash_head[h];
+        table->hash_head[h] = i + 1;
+        table->shapes |= 1 << e->shape;
+    }
+
+    if (nb) {
+        memcpy(table->seg_start, bounds, nb * sizeof(unsigned int));
+        for (k = 0, j = 0; k < nseg; k++) {
+            table->seg_off[k] = j;
+            for (i = 0; i < cnt; i++) {
+                if (vnet_filter_has_range(&rules[i]) &&
+                    rules[i].dstPmin <= bounds[k] && bounds[k] <= rules[i].dstPmax) {
+                    table->seg_idx[j++] = i;
+                }
+            }
         }
+        table->seg_off[nseg] = j;
+        os_free(bounds);
+    }
+
+    return table;
+}
+
+void vnet_filter_table_free(vnet_filter_table_t *table)
+{
+    if (table) {
+        os_free(table);
+    }
+}
+
+int vnet_filter_classify(const vnet_filter_table_t *table, const unsigned char *packet)
+{
+    unsigned int ip = GET_IP(packet);
+    unsigned char proctol = GET_PROTO(packet);
+    unsigned short sport = 0;
+    unsigned short dport = 0;
+    unsigned int best, shape, n;
+
+    if (table == NULL || table->cnt == 0) {
+        return -1;
+    }
+
+    if (proctol == IPPROTO_TCP || proctol == IPPROTO_UDP) {
+        sport = GET_SPORT(packet);
+        dport = GET_DPORT(packet);
+    }
+    best = table->cnt;
+
+    for (shape = 0; shape < VNET_FILTER_KEY_SHAPES; shape++) {
+        unsigned int kip = (shape & VNET_FILTER_KEY_IP) ? ip : 0;
+        unsigned char kproto = (shape & VNET_FILTER_KEY_PROTO) ? proctol : 0;
+        unsigned short kdport = (shape & VNET_FILTER_KEY_DPORT) ? dport : 0;
+
+        if (!(table->shapes & (1 << shape))) {
+            continue;
+        }
+
+        n = table->hash_head[vnet_filter_hash(kip, kproto, kdport, shape) & table->hash_mask];
+        while (n && n - 1 < best) {
+            const vnet_filter_hent_t *e = &table->hent[n - 1];
+
+            if (e->shape == shape && e->ip == kip && e->proto == kproto && e->dport == kdport &&
+                vnet_filter_rule_match(&table->rules[e->rule], ip, proctol, sport, dport)) {
+                best = e->rule;
+                break;
+            }
+            n = e->next;
+        }
+    }
+
+    if (table->seg_cnt && dport >= table->seg_start[0] && dport < table->seg_start[table->seg_cnt]) {
+        unsigned int lo = 0, hi = table->seg_cnt;
+
+        /* last segment starting at or below dport */
+        while (hi - lo > 1) {
+            unsigned int mid = (lo + hi) / 2;
+            if (table->seg_start[mid] <= dport) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        for (n = table->seg_off[lo]; n < table->seg_off[lo + 1]; n++) {
+            unsigned int r = table->seg_idx[n];
+
+            if (r >= best) {
+                break;
+            }
+            if (vnet_filter_rule_match(&table->rules[r], ip, proctol, sport, dport)) {
+                best = r;
+                break;
+            }
+        }
+    }
+
+    return best < table->cnt ? (int)best : -1;
+}
+
+static void vnet_filter_set_free(vnet_filter_set_t *set)
+{
+    if (set) {
+        vnet_filter_table_free(set->list);
+        vnet_filter_table_free(set->blist);
+        os_free(set->rules);
+        os_free(set);
+    }
+}
+
+/* takes ownership of rules */
+static vnet_filter_set_t *vnet_filter_set_build(vnet_ipv4_filter *rules, unsigned int cnt)
+{
+    vnet_filter_set_t *set = os_zalloc(sizeof(vnet_filter_set_t));
+    vnet_ipv4_filter *order = os_malloc((cnt ? cnt : 1) * sizeof(vnet_ipv4_filter));
+    unsigned int i, n;
+
+    if (set == NULL || order == NULL) {
+        goto fail;
+    }
+    set->rules = rules;
+    set->cnt = cnt;
+
+    /* the newest rule has the highest priority */
+    for (i = cnt, n = 0; i-- > 0;) {
+        if (rules[i].dir != VNET_PACKET_DICTION_BOTH) {
+            order[n++] = rules[i];
+        }
+    }
+    set->list = vnet_filter_compile(order, n);
+
+    for (i = cnt, n = 0; i-- > 0;) {
+        if (rules[i].dir == VNET_PACKET_DICTION_BOTH) {
+            order[n++] = rules[i];
+        }
+    }
+    set->blist = vnet_filter_compile(order, n);
+
+    os_free(order);
+    if (set->list == NULL || set->blist == NULL) {
+        vnet_filter_set_free(set);
+        return NULL;
+    }
+    return set;
+
+fail:
+    if (order) {
+        os_free(order);
+    }
+    if (set) {
+        os_free(set);
+    }
+    os_free(rules);
+    return NULL;
+}
+
+/*
+ * rule updates are serialized by the mutex and never touch a published set.
+ * the rx path only reads the set pointer, with the scheduler locked rather
+ * than interrupts, so by the time an updater runs no reader is inside the
+ * old set and it can be freed right after the swap.
+ */
+static void vnet_filter_lock(void)
+{
+    if (g_ip_list.lock == NULL) {
+        g_ip_list.lock = os_mutex_create();
     }
-    g_ip_list.ipv4List = NULL;
-    g_ip_list.ipv4Blist = NULL;
-    system_irq_restore(flag);
+    os_mutex_lock(g_ip_list.lock, WAIT_FOREVER);
+}
+
+static void vnet_filter_unlock(void)
+{
+    os_mutex_unlock(g_ip_list.lock);
+}
+
+static void vnet_filter_publish(vnet_filter_set_t *set)
+{
+    vnet_filter_set_t *old = g_ip_list.set;
+
+    g_ip_list.set = set;
+    vnet_filter_set_free(old);
+}
+
+void vnet_ip_filter_clearall(unsigned char ip_type)
+{
+    if (ip_type != VNET_FILTER_TYPE_IPV4) {
+        return;
+    }
+
+    vnet_filter_lock();
+    vnet_filter_publish(NULL);
+    vnet_filter_unlock();
 }
 
 int vnet_get_default_filter(void)
@@ -89,7 +428,6 @@ int vnet_get_default_filter(void)
 
 int vnet_set_default_filter(unsigned char dir)
 {
-    unsigned long flag;
     vnet_ipv4_filter filter;
 
     if (dir != VNET_PACKET_DICTION_LWIP && dir != VNET_PACKET_DICTION_HOST) {
@@ -97,9 +435,7 @@ int vnet_set_default_filter(unsigned char dir)
         return -1;
     }
 
-    flag = system_irq_save();
     g_ip_list.default_dir = dir;
-    system_irq_restore(flag);
     memset(&filter, 0, sizeof(filter));
 
     filter.dir = VNET_PACKET_DICTION_LWIP;
@@ -115,41 +451,6 @@ int vnet_set_default_filter(unsigned char dir)
     return 0;
 }
 
-static int vnet_repeat_filter_check(void *filter, unsigned int len, unsigned char ip_type)
-{
-    vnet_ip_filter_t *list = NULL;
-    vnet_ip_filter_t *blist = NULL;
-    unsigned long flag = system_irq_save();
-
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        list = g_ip_list.ipv4List;
-        blist = g_ip_list.ipv4Blist;
-    }
-
-    while (list || blist) {
-        if (list) {
-            if (memcmp(filter, &(list->filter.ipv4Filter), sizeof(vnet_ipv4_filter)) == 0) {
-                system_irq_restore(flag);
-                os_printf(LM_APP, LL_INFO, "repeat rules error\n");
-                return -1;
-            }
-            list = list->next;
-        }
-
-        if (blist) {
-            if (memcmp(filter, &(blist->filter.ipv4Filter), sizeof(vnet_ipv4_filter)) == 0) {
-                system_irq_restore(flag);
-                os_printf(LM_APP, LL_INFO, "repeat rules error\n");
-                return -1;
-            }
-            blist = blist->next;
-        }
-    }
-    system_irq_restore(flag);
-
-    return 0;
-}
-
 static int vnet_filter_param_check(void *filter, unsigned char ip_type)
 {
     if (ip_type == VNET_FILTER_TYPE_IPV4) {
@@ -190,206 +491,178 @@ static int vnet_filter_param_check(void *filter, unsigned char ip_type)
     return 0;
 }
 
+static int vnet_filter_find(vnet_filter_set_t *set, vnet_ipv4_filter *ft)
+{
+    unsigned int i;
+
+    for (i = 0; set && i < set->cnt; i++) {
+        if (memcmp(ft, &set->rules[i], sizeof(vnet_ipv4_filter)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 int vnet_add_filter(void *filter, unsigned int len, unsigned char ip_type)
 {
-    vnet_ip_filter_t *inode = NULL;
-    unsigned long flag = 0;
+    vnet_ipv4_filter *ft = (vnet_ipv4_filter *)filter;
+    vnet_ipv4_filter *rules;
+    vnet_filter_set_t *set, *nset;
+    unsigned int cnt;
 
     if (vnet_filter_param_check(filter, ip_type) != 0) {
         return -1;
     }
 
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        vnet_ipv4_filter *ft = (vnet_ipv4_filter *)filter;
+    if (ip_type != VNET_FILTER_TYPE_IPV4) {
+        return 0;
+    }
 
-        if (vnet_repeat_filter_check(ft, len, ip_type) < 0) {
-            return -1;
-        }
+    vnet_filter_lock();
+    set = g_ip_list.set;
+    cnt = set ? set->cnt : 0;
 
-        if (vnet_get_list_cnt(VNET_FILTER_TYPE_IPV4) >= VNET_FILTER_RULE_MAX) {
-            os_printf(LM_APP, LL_INFO, "rules all ready 0x%x nums\n", vnet_get_list_cnt(VNET_FILTER_TYPE_IPV4));
-            return -1;
-        }
+    if (vnet_filter_find(set, ft) >= 0) {
+        vnet_filter_unlock();
+        os_printf(LM_APP, LL_INFO, "repeat rules error\n");
+        return -1;
+    }
 
-        inode = (vnet_ip_filter_t *)malloc(sizeof(vnet_ip_filter_t));
-        if (inode == NULL) {
-            os_printf(LM_APP, LL_INFO, "no buff left\n");
-            return -1;
-        }
-        memset(inode, 0, sizeof(vnet_ip_filter_t));
-        memcpy(&inode->filter.ipv4Filter, filter, sizeof(vnet_ipv4_filter));
-
-        flag = system_irq_save();
-        if (ft->dir == VNET_PACKET_DICTION_BOTH) {
-            inode->next = g_ip_list.ipv4Blist;
-            g_ip_list.ipv4Blist = inode;
-        } else {
-            inode->next = g_ip_list.ipv4List;
-            g_ip_list.ipv4List = inode;
-        }
+    if (cnt >= VNET_FILTER_RULE_MAX) {
+        vnet_filter_unlock();
+        os_printf(LM_APP, LL_INFO, "rules all ready 0x%x nums\n", cnt);
+        return -1;
+    }
+
+    rules = os_malloc((cnt + 1) * sizeof(vnet_ipv4_filter));
+    if (rules == NULL) {
+        vnet_filter_unlock();
+        os_printf(LM_APP, LL_INFO, "no buff left\n");
+        return -1;
+    }
+    if (cnt) {
+        memcpy(rules, set->rules, cnt * sizeof(vnet_ipv4_filter));
+    }
+    memcpy(&rules[cnt], ft, sizeof(vnet_ipv4_filter));
+
+    nset = vnet_filter_set_build(rules, cnt + 1);
+    if (nset == NULL) {
+        vnet_filter_unlock();
+        os_printf(LM_APP, LL_INFO, "no buff left\n");
+        return -1;
     }
-    system_irq_restore(flag);
+    vnet_filter_publish(nset);
+    vnet_filter_unlock();
 
     return 0;
 }
 
 int vnet_del_filter(void *filter, unsigned int len, unsigned char ip_type)
 {
-    vnet_ip_filter_t *list = NULL;
-    vnet_ip_filter_t *dnode = NULL;
-    unsigned long flag = system_irq_save();
+    vnet_ipv4_filter *rules;
+    vnet_filter_set_t *set, *nset = NULL;
+    int idx;
 
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        vnet_ipv4_filter *ft = (vnet_ipv4_filter *)filter;
-        if (ft->dir == VNET_PACKET_DICTION_BOTH) {
-            list = g_ip_list.ipv4Blist;
-            if (memcmp(&g_ip_list.ipv4Blist->filter.ipv4Filter, ft, sizeof(vnet_ipv4_filter)) == 0) {
-                dnode = g_ip_list.ipv4Blist;
-                g_ip_list.ipv4Blist = g_ip_list.ipv4Blist->next;
-                os_free(dnode);
-                system_irq_restore(flag);
-                return 0;
-            }
-        } else {
-            list = g_ip_list.ipv4List;
-            if (memcmp(&g_ip_list.ipv4List->filter.ipv4Filter, ft, sizeof(vnet_ipv4_filter)) == 0) {
-                dnode = g_ip_list.ipv4List;
-                g_ip_list.ipv4List = g_ip_list.ipv4List->next;
-                os_free(dnode);
-                system_irq_restore(flag);
-                return 0;
-            }
-        }
+    if (ip_type != VNET_FILTER_TYPE_IPV4) {
+        os_printf(LM_APP, LL_INFO, "No match rules to delete\n");
+        return -1;
+    }
 
-        while (list && list->next) {
-            if (memcmp(&list->next->filter.ipv4Filter, ft, sizeof(vnet_ipv4_filter)) == 0) {
-                dnode = list->next;
-                list->next = list->next->next;
-                os_free(dnode);
-                system_irq_restore(flag);
-                return 0;
-            }
+    vnet_filter_lock();
+    set = g_ip_list.set;
+    idx = vnet_filter_find(set, (vnet_ipv4_filter *)filter);
+    if (idx < 0) {
+        vnet_filter_unlock();
+        os_printf(LM_APP, LL_INFO, "No match rules to delete\n");
+        return -1;
+    }
 
-            list = list->next;
+    if (set->cnt > 1) {
+        rules = os_malloc((set->cnt - 1) * sizeof(vnet_ipv4_filter));
+        if (rules == NULL) {
+            vnet_filter_unlock();
+            os_printf(LM_APP, LL_INFO, "no buff left\n");
+            return -1;
+        }
+        memcpy(rules, set->rules, idx * sizeof(vnet_ipv4_filter));
+        memcpy(&rules[idx], &set->rules[idx + 1], (set->cnt - idx - 1) * sizeof(vnet_ipv4_filter));
+
+        nset = vnet_filter_set_build(rules, set->cnt - 1);
+        if (nset == NULL) {
+            vnet_filter_unlock();
+            os_printf(LM_APP, LL_INFO, "no buff left\n");
+            return -1;
         }
     }
+    vnet_filter_publish(nset);
+    vnet_filter_unlock();
 
-    system_irq_restore(flag);
-    os_printf(LM_APP, LL_INFO, "No match rules to delete\n");
-    return -1;
+    return 0;
 }
 
 int vnet_query_filter(void **filter, unsigned int *len, unsigned char ip_type)
 {
-    unsigned int cnt = vnet_get_list_cnt(ip_type);
-    vnet_ipv4_filter *ft = NULL;
-    vnet_ip_filter_t *list = NULL;
-    vnet_ip_filter_t *blist = NULL;
-
-    unsigned long flag = system_irq_save();
+    vnet_filter_set_t *set;
+    vnet_ipv4_filter *ft;
+    unsigned int i, cnt;
+
+    *filter = NULL;
+    *len = 0;
+    if (ip_type != VNET_FILTER_TYPE_IPV4) {
+        return 0;
+    }
 
-    if (ip_type == VNET_FILTER_TYPE_IPV4) {
-        list = g_ip_list.ipv4List;
-        blist = g_ip_list.ipv4Blist;
-        *filter = (vnet_ipv4_filter *)malloc(cnt * sizeof(vnet_ipv4_filter));
-        if (*filter == NULL) {
-            *len = 0;
-            system_irq_restore(flag);
+    vnet_filter_lock();
+    set = g_ip_list.set;
+    cnt = set ? set->cnt : 0;
+    if (cnt) {
+        ft = (vnet_ipv4_filter *)malloc(cnt * sizeof(vnet_ipv4_filter));
+        if (ft == NULL) {
+            vnet_filter_unlock();
             os_printf(LM_APP, LL_INFO, "no buff left to query\n");
             return -1;
         }
-        ft = *filter;
-    }
-
-    while (list || blist) {
-        if (list != NULL) {
-            memcpy(ft, &list->filter.ipv4Filter, sizeof(vnet_ipv4_filter));
-            ft++;
-            list = list->next;
-        }
-
-        if (blist != NULL) {
-            memcpy(ft, &blist->filter.ipv4Filter, sizeof(vnet_ipv4_filter));
-            ft++;
-            blist = blist->next;
+        /* newest first, the order they are matched in */
+        for (i = 0; i < cnt; i++) {
+            ft[i] = set->rules[cnt - 1 - i];
         }
+        *filter = ft;
+        *len = cnt;
     }
+    vnet_filter_unlock();
 
-    system_irq_restore(flag);
-    *len = cnt;
     return 0;
 }
 
-#define GET_IP(x) (((x)[12] << 24) + ((x)[13] << 16) + ((x)[14] << 8) + (x)[15])
-#define GET_PROTO(x) ((x)[9])
-#define GET_IPLEN(x) (((x)[0] & 0xF) * 4)
-#define GET_SPORT(x) ((((x)[GET_IPLEN(x) + 0]) << 8) + ((x)[GET_IPLEN(x) + 1]))
-#define GET_DPORT(x) ((((x)[GET_IPLEN(x) + 2]) << 8) + ((x)[GET_IPLEN(x) + 3]))
-
-static int vnet_ipv4_filter_match(vnet_ip_filter_t *list, unsigned char *packet)
+static int vnet_ipv4_filter_match(int both, unsigned char *packet)
 {
-    unsigned int ip = GET_IP(packet);
-    unsigned char proctol = GET_PROTO(packet);
-    unsigned short sport = 0;
-    unsigned short dport = 0;
-    unsigned long flag = system_irq_save();
-
-    if (proctol == IPPROTO_TCP || proctol == IPPROTO_UDP) {
-        sport = GET_SPORT(packet);
-        dport = GET_DPORT(packet);
-    }
-
-    while (list) {
-        if (list->filter.ipv4Filter.mask & VNET_FILTER_MASK_IPADDR) {
-            if (ip != list->filter.ipv4Filter.ipaddr) {
-                list = list->next;
-                continue;
-            }
+    vnet_filter_set_t *set;
+    vnet_filter_table_t *table;
+    int dir = g_ip_list.default_dir;
+    int idx;
+
+    os_scheduler_lock();
+    set = g_ip_list.set;
+    if (set) {
+        table = both ? set->blist : set->list;
+        idx = vnet_filter_classify(table, packet);
+        if (idx >= 0) {
+            dir = table->rules[idx].dir;
         }
-
-        if (list->filter.ipv4Filter.mask & VNET_FILTER_MASK_PROTOCOL) {
-            if (proctol != list->filter.ipv4Filter.packeType) {
-                list = list->next;
-                continue;
-            }
-        }
-
-        if ((list->filter.ipv4Filter.mask & VNET_FILTER_MASK_DST_PORT) ||
-            (list->filter.ipv4Filter.mask & VNET_FILTER_MASK_DST_PORT_RANGE)) {
-            if (dport != list->filter.ipv4Filter.dstPort) {
-                if (list->filter.ipv4Filter.dstPmin > dport || list->filter.ipv4Filter.dstPmax < dport) {
-                    list = list->next;
-                    continue;
-                }
-            }
-        }
-
-        if ((list->filter.ipv4Filter.mask & VNET_FILTER_MASK_SRC_PORT) ||
-            (list->filter.ipv4Filter.mask & VNET_FILTER_MASK_SRC_PORT_RANGE)) {
-            if (sport != list->filter.ipv4Filter.srcPort) {
-                if (list->filter.ipv4Filter.srcPmin > sport || list->filter.ipv4Filter.srcPmax < sport) {
-                    list = list->next;
-                    continue;
-                }
-            }
-        }
-
-        system_irq_restore(flag);
-        return list->filter.ipv4Filter.dir;
     }
+    os_scheduler_unlock();
 
-    system_irq_restore(flag);
-    return g_ip_list.default_dir;
+    return dir;
 }
 
 int vnet_ipv4_packet_list_filter(unsigned char *packet)
 {
-    return vnet_ipv4_filter_match(g_ip_list.ipv4List, packet);
+    return vnet_ipv4_filter_match(0, packet);
 }
 
 int vnet_ipv4_packet_blist_filter(unsigned char *packet)
 {
-    return vnet_ipv4_filter_match(g_ip_list.ipv4Blist, packet);
+    return vnet_ipv4_filter_match(1, packet);
 }
 
 /* wifi filter the data sendto MCU or sendto TCPIP */
@@ -412,8 +685,10 @@ int vnet_filter_wifi_handle(uint16_t type, unsigned char *data)
     if ((IPH_PROTO(iphdr) != IPPROTO_TCP) && (IPH_PROTO(iphdr) != IP_PROTO_UDP)) {
         return -1;
     }
+    /* frames for both sides land in spi memory too and are lent to lwip, */
+    /* except fragments, lwip reassembly rewrites their headers */
     if (vnet_ipv4_packet_blist_filter(data) == VNET_PACKET_DICTION_BOTH) {
-        return -1;
+        return ((IPH_OFFSET(iphdr) & PP_HTONS(IP_MF | IP_OFFMASK)) != 0) ? -1 : 0;
     }
 
     if (vnet_ipv4_packet_list_filter(data) == VNET_PACKET_DICTION_LWIP) {
@@ -37,6 +37,15 @@ typedef struct
     unsigned char resv;
 } vnet_ipv4_filter;
 
+/* compiled lookup structure for a rule set, see vnet_filter.c */
+typedef struct vnet_filter_table vnet_filter_table_t;
+
+/* rules in priority order, the first matching rule wins */
+vnet_filter_table_t *vnet_filter_compile(const vnet_ipv4_filter *rules, unsigned int cnt);
+void vnet_filter_table_free(vnet_filter_table_t *table);
+/* index of the matching rule for an ipv4 packet, -1 if none */
+int vnet_filter_classify(const vnet_filter_table_t *table, const unsigned char *packet);
+
 void vnet_dump_filter();
 int vnet_get_default_filter(void);
 int vnet_set_default_filter(unsigned char dir);
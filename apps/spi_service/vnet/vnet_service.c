@@ -11,12 +11,29 @@
 extern void fhost_tx_free(void *buf);
 extern int fhost_tx_start(void *net_if, void *net_buf, uint8_t is_raw);
 #define VNET_MIN_FRAME_SIZE 42
+#define VNET_SERVICE_BOTH_COPY 1
+#define VNET_SERVICE_BOTH_LEND 2
 
-static struct pbuf *vnet_service_bcopy_send(struct pbuf *p, struct netif *inp)
+static vnet_service_stats_t g_vnet_stats;
+static void (*g_vnet_host_send)(spi_service_mem_t *smem) = spi_slave_sendto_host;
+
+static void vnet_service_pbuf_release(struct pbuf *p)
 {
-    struct pbuf *pt = NULL;
-    unsigned int bcopy = 0;
+    if (spi_service_mpbuf_free(p) == NULL) {
+        return;
+    }
+
+    if ((p->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
+        struct pbuf_custom *pc = (struct pbuf_custom *)p;
+        pc->custom_free_function(p);
+    } else {
+        pbuf_free(p);
+    }
+}
 
+/* frames lwip must see as well as the MCU */
+static int vnet_service_both(struct pbuf *p)
+{
     if (p != NULL && p->tot_len >= VNET_MIN_FRAME_SIZE) {
         struct eth_hdr *ethhdr = p->payload;
         short type = lwip_ntohs(ethhdr->type);
@@ -27,7 +44,7 @@ static struct pbuf *vnet_service_bcopy_send(struct pbuf *p, struct netif *inp)
             struct etharp_hdr *arp_hdr = (struct etharp_hdr*)(p->payload + sizeof(struct eth_hdr));
             short arp_opcode = lwip_ntohs(arp_hdr->opcode);
             if (arp_opcode == ARP_REPLY) {
-                bcopy = 1;
+                return VNET_SERVICE_BOTH_COPY;
             }
         }
 
@@ -37,62 +54,80 @@ static struct pbuf *vnet_service_bcopy_send(struct pbuf *p, struct netif *inp)
                 struct icmp_echo_hdr *iecho = (struct icmp_echo_hdr *)((u8_t *)p->payload + sizeof(struct eth_hdr) + IPH_HL_BYTES(iphdr));
                 /* WIFI HEARTBEAT PING ignore */
                 if (iecho->id != WIFI_HEARTBEAT_PING_ID) {
-                    /* ICMP need sendto MCU */
-                    bcopy = 1;
+                    /* ICMP need sendto MCU, lwip turns an echo request into the reply in place */
+                    return VNET_SERVICE_BOTH_COPY;
                 }
             }
-        }
 
-        if (bcopy == 0 && vnet_ipv4_packet_blist_filter(packet) == VNET_PACKET_DICTION_BOTH) {
-            bcopy = 1;
+            if (vnet_ipv4_packet_blist_filter(packet) == VNET_PACKET_DICTION_BOTH) {
+                /* lwip only reads tcp/udp payload, but reassembly rewrites fragment headers */
+                if ((IPH_PROTO(iphdr) != IP_PROTO_TCP && IPH_PROTO(iphdr) != IP_PROTO_UDP) ||
+                    (IPH_OFFSET(iphdr) & PP_HTONS(IP_MF | IP_OFFMASK)) != 0) {
+                    return VNET_SERVICE_BOTH_COPY;
+                }
+                return VNET_SERVICE_BOTH_LEND;
+            }
         }
     }
 
-    if (bcopy) {
-        spi_service_mtype_e type = (get_netif_by_index(STATION_IF) == inp) ? SPI_SERVICE_MEM_STATX : SPI_SERVICE_MEM_APTX;
-        pt = spi_service_mpbuf_alloc(type, p->len);
-        memcpy(pt->payload, p->payload, p->len);
-        pt->len = p->len;
-        pt->tot_len = p->len;
-        return pt;
+    return 0;
+}
+
+static struct pbuf *vnet_service_bcopy_send(struct pbuf *p, struct netif *inp)
+{
+    spi_service_mtype_e type = (get_netif_by_index(STATION_IF) == inp) ? SPI_SERVICE_MEM_STATX : SPI_SERVICE_MEM_APTX;
+    struct pbuf *pt = spi_service_mpbuf_alloc(type, p->len);
+
+    if (pt == NULL) {
+        g_vnet_stats.dropnum++;
+        return NULL;
     }
+    memcpy(pt->payload, p->payload, p->len);
+    pt->len = p->len;
+    pt->tot_len = p->len;
+    g_vnet_stats.copynum++;
+    g_vnet_stats.copybytes += p->len;
 
-    return NULL;
+    return pt;
 }
 
+/* returns 0 when lwip keeps processing p, else the frame belongs to the MCU only */
 int vnet_service_wifi_rx(struct pbuf *p, struct netif *inp)
 {
     spi_service_mem_t *smem = NULL;
     vnet_reg_t *vReg = vnet_reg_get_addr();
-    int ret = -1;
+    int both = vnet_service_both(p);
+    int ret = both ? 0 : -1;
 
-    if (spi_service_mpool_check(p) == NULL) {
-        p = vnet_service_bcopy_send(p, inp);
-        if (p == NULL) {
+    if (both == VNET_SERVICE_BOTH_LEND && spi_service_mpool_check(p) != NULL) {
+        /* the frame already sits in shared ram, the transport borrows it */
+        if (vReg->status == VNET_WIFI_LINK_DOWN) {
+            return 0;
+        }
+        spi_service_mpbuf_ref(p);
+        g_vnet_stats.lendnum++;
+    } else if (both != 0 || spi_service_mpool_check(p) == NULL) {
+        if (both == 0) {
             os_printf(LM_APP, LL_DBG, "%s[%d]\n", __FUNCTION__, __LINE__);
             return 0;
         }
-        ret = 0;
+        p = vnet_service_bcopy_send(p, inp);
+        if (p == NULL) {
+            return ret;
+        }
+    } else {
+        g_vnet_stats.zcopynum++;
     }
 
     if (vReg->status == VNET_WIFI_LINK_DOWN) {
-        if ((p->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
-            struct pbuf_custom *pc = (struct pbuf_custom *)p;
-            pc->custom_free_function(p);
-        } else {
-            pbuf_free(p);
-        }
+        vnet_service_pbuf_release(p);
         return ret;
     }
 
     smem = spi_mqueue_get();
     if (smem == NULL) {
-        if ((p->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
-            struct pbuf_custom *pc = (struct pbuf_custom *)p;
-            pc->custom_free_function(p);
-        } else {
-            pbuf_free(p);
-        }
+        g_vnet_stats.dropnum++;
+        vnet_service_pbuf_release(p);
         return ret;
     }
     memset(smem, 0, sizeof(spi_service_mem_t));
@@ -100,7 +135,7 @@ int vnet_service_wifi_rx(struct pbuf *p, struct netif *inp)
     smem->memOffset = (unsigned int)p->payload - (unsigned int)p;
     smem->memSlen = smem->memLen = p->len;
     smem->memType = SPI_SERVICE_TYPE_STOH;
-    spi_slave_sendto_host(smem);
+    g_vnet_host_send(smem);
 
     return ret;
 }
@@ -132,14 +167,20 @@ int vnet_service_wifi_rx_free(struct pbuf *p, struct netif *inp)
 
 int vnet_service_wifi_rx_done(spi_service_mem_t *smem)
 {
-    struct pbuf *p = (struct pbuf *)smem->memAddr;
-
-    if ((p->flags & PBUF_FLAG_IS_CUSTOM) != 0) {
-        struct pbuf_custom *pc = (struct pbuf_custom *)p;
-        pc->custom_free_function(p);
-    } else {
-        pbuf_free(p);
-    }
+    vnet_service_pbuf_release((struct pbuf *)smem->memAddr);
 
     return 0;
 }
+
+void vnet_service_get_stats(vnet_service_stats_t *stats)
+{
+    unsigned int flag = system_irq_save();
+
+    *stats = g_vnet_stats;
+    system_irq_restore(flag);
+}
+
+void vnet_service_set_host_send(void (*send)(spi_service_mem_t *smem))
+{
+    g_vnet_host_send = (send != NULL) ? send : spi_slave_sendto_host;
+}
@@ -5,9 +5,21 @@
 #include "lwip/netif.h"
 #include "spi_service.h"
 
+/* frames handed to the MCU: lent from shared ram, copied, or dropped for lack of memory */
+typedef struct {
+    unsigned int zcopynum;
+    unsigned int lendnum;
+    unsigned int copynum;
+    unsigned int copybytes;
+    unsigned int dropnum;
+} vnet_service_stats_t;
+
 int vnet_service_wifi_rx(struct pbuf *p, struct netif *inp);
 int vnet_service_wifi_rx_free(struct pbuf *p, struct netif *inp);
 int vnet_service_wifi_tx(spi_service_mem_t *smem);
 int vnet_service_wifi_rx_done(spi_service_mem_t *smem);
+void vnet_service_get_stats(vnet_service_stats_t *stats);
+/* replace the spi slave transport, NULL restores it */
+void vnet_service_set_host_send(void (*send)(spi_service_mem_t *smem));
 
 #endif
\ No newline at end of file
@@ -0,0 +1,463 @@
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "oshal.h"
+#include "at_mux.h"
+
+#define AT_MUX_TASK_STACK_SIZE  (2048)
+#define AT_MUX_TASK_PRIO        4
+
+//room in front of the payload for the frame header, "+IPD,4,65535,255.255.255.255,65535:" fits
+#define AT_MUX_HEADROOM         40
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif
+
+/*
+ * data mode with host flow control: every link receives straight into blocks
+ * of one shared pool, the mux task frames the queued blocks out to the host
+ * by deficit weighted round robin, but only up to the credit the host granted
+ * that link. a link out of credit just keeps its blocks; once it holds
+ * CONFIG_AT_MUX_LINK_BLOCKS (or the pool is empty) at_mux_rx_room() returns 0
+ * and the socket is left unread, so tcp backpressure stops that peer alone.
+ */
+typedef struct at_mux_blk {
+    struct at_mux_blk *next;
+    unsigned short   len;
+    unsigned short   rd;
+    unsigned int     from_ip;       //sender shown in the frame header, network order
+    unsigned short   from_port;     //0: no sender shown
+    unsigned char    data[AT_MUX_HEADROOM + CONFIG_AT_MUX_BLOCK_SIZE];
+}at_mux_blk_t;
+
+typedef struct {
+    at_mux_blk_t    *head;
+    at_mux_blk_t    *tail;
+    at_mux_blk_t    *rx;            //handed out by at_mux_rx_buf(), not committed yet
+    int              rx_drop;       //link was reset while rx was out
+    int              deficit;
+    at_mux_link_info_t info;
+}at_mux_link_t;
+
+typedef struct {
+    volatile int     opened;
+    int              task;
+    os_sem_handle_t  sem;
+    at_mux_out_t     out;
+    at_mux_blk_t    *pool;
+    at_mux_blk_t    *free_list;
+    unsigned int     free_cnt;
+    at_mux_blk_t * volatile inflight;
+    int              inflight_drop;
+    at_mux_link_t    link[AT_MUX_LINK_NUM];
+}at_mux_ctx_t;
+
+static at_mux_ctx_t at_mux;
+
+static void at_mux_blk_put(at_mux_ctx_t *mux, at_mux_blk_t *blk)
+{
+    blk->next = mux->free_list;
+    mux->free_list = blk;
+    mux->free_cnt++;
+}
+
+static at_mux_blk_t *at_mux_blk_get(at_mux_ctx_t *mux)
+{
+    at_mux_blk_t *blk = mux->free_list;
+
+    if (blk) {
+        mux->free_list = blk->next;
+        mux->free_cnt--;
+        blk->next = NULL;
+        blk->len = 0;
+        blk->rd = 0;
+    }
+
+    return blk;
+}
+
+//caller holds the irq lock
+static void at_mux_link_drop(at_mux_ctx_t *mux, at_mux_link_t *l)
+{
+    at_mux_blk_t *blk, *next;
+
+    for (blk = l->head; blk; blk = next) {
+        next = blk->next;
+        if (blk == mux->inflight) {
+            //the mux task returns it once the uart is done with it
+            mux->inflight_drop = 1;
+        } else {
+            at_mux_blk_put(mux, blk);
+        }
+    }
+
+    l->head = NULL;
+    l->tail = NULL;
+    l->rx_drop = (l->rx != NULL);
+    l->deficit = 0;
+    memset(&l->info, 0, sizeof(l->info));
+    l->info.blocks = l->rx ? 1 : 0;
+    l->info.credit = CONFIG_AT_MUX_INIT_CREDIT;
+    l->info.weight = 1;
+}
+
+//frame out one piece of the head block of a link, returns payload bytes sent
+static unsigned int at_mux_send_one(at_mux_ctx_t *mux, at_mux_link_t *l, int link)
+{
+    at_mux_blk_t *blk;
+    unsigned char *p;
+    char hdr[AT_MUX_HEADROOM];
+    unsigned int n, hlen;
+    unsigned long flags;
+
+    flags = system_irq_save();
+    blk = l->head;
+    if (!mux->opened || !blk || !l->info.credit || l->deficit <= 0) {
+        if (!blk || !l->info.credit) {
+            l->deficit = 0;
+        }
+        system_irq_restore(flags);
+        return 0;
+    }
+    n = MIN((unsigned int)(blk->len - blk->rd), l->info.credit);
+    n = MIN(n, (unsigned int)l->deficit);
+    mux->inflight = blk;
+    mux->inflight_drop = 0;
+    system_irq_restore(flags);
+
+    //the header goes right in front of the payload, over bytes already sent
+    if (blk->from_port) {
+        hlen = sprintf(hdr, "+IPD,%d,%u,%u.%u.%u.%u,%u:", link, n,
+                       ((unsigned char *)&blk->from_ip)[0], ((unsigned char *)&blk->from_ip)[1],
+                       ((unsigned char *)&blk->from_ip)[2], ((unsigned char *)&blk->from_ip)[3], blk->from_port);
+    } else {
+        hlen = sprintf(hdr, "+IPD,%d,%u:", link, n);
+    }
+    p = &blk->data[AT_MUX_HEADROOM + blk->rd - hlen];
+    memcpy(p, hdr, hlen);
+    mux->out.tx(mux->out.ctx, p, hlen + n);
+
+    flags = system_irq_save();
+    if (mux->inflight_drop) {
+        at_mux_blk_put(mux, blk);
+    } else {
+        blk->rd += n;
+        l->info.queued -= n;
+        l->info.credit -= n;
+        l->info.tx_bytes += n;
+        l->info.tx_frames++;
+        l->deficit -= n;
+        if (blk->rd == blk->len) {
+            l->head = blk->next;
+            if (!l->head) {
+                l->tail = NULL;
+            }
+            l->info.blocks--;
+            at_mux_blk_put(mux, blk);
+        }
+    }
+    mux->inflight = NULL;
+    system_irq_restore(flags);
+
+    return n;
+}
+
+//one deficit round robin round over all links, returns payload bytes sent
+static unsigned int at_mux_round(at_mux_ctx_t *mux)
+{
+    at_mux_link_t *l;
+    unsigned int total = 0, n;
+    unsigned long flags;
+    int i;
+
+    for (i = 0; i < AT_MUX_LINK_NUM; i++) {
+        l = &mux->link[i];
+
+        flags = system_irq_save();
+        if (!mux->opened) {
+            system_irq_restore(flags);
+            break;
+        }
+        if (!l->head || !l->info.credit) {
+            l->deficit = 0;
+            system_irq_restore(flags);
+            continue;
+        }
+        l->deficit += CONFIG_AT_MUX_QUANTUM * l->info.weight;
+        system_irq_restore(flags);
+
+        while ((n = at_mux_send_one(mux, l, i)) > 0) {
+            total += n;
+        }
+    }
+
+    return total;
+}
+
+static void at_mux_task(void *arg)
+{
+    at_mux_ctx_t *mux = (at_mux_ctx_t *)arg;
+
+    while (1) {
+        os_sem_wait(mux->sem, WAIT_FOREVER);
+        while (at_mux_round(mux));
+    }
+}
+
+int at_mux_open(const at_mux_out_t *out)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    unsigned long flags;
+    int i;
+
+    if (!out || !out->tx) {
+        return -1;
+    }
+
+    if (mux->opened) {
+        return 0;
+    }
+
+    if (!mux->task) {
+        mux->sem = os_sem_create(1, 0);
+        if (!mux->sem) {
+            os_printf(LM_APP, LL_ERR, "at_mux sem create failed\n");
+            return -1;
+        }
+
+        mux->task = os_task_create("at_mux", AT_MUX_TASK_PRIO, AT_MUX_TASK_STACK_SIZE, (task_entry_t)at_mux_task, mux);
+        if (mux->task == -1) {
+            mux->task = 0;
+            os_printf(LM_APP, LL_ERR, "at_mux task create failed\n");
+            return -1;
+        }
+    }
+
+    mux->pool = (at_mux_blk_t *)os_malloc(CONFIG_AT_MUX_POOL_BLOCKS * sizeof(at_mux_blk_t));
+    if (!mux->pool) {
+        os_printf(LM_APP, LL_ERR, "at_mux pool alloc failed\n");
+        return -1;
+    }
+
+    flags = system_irq_save();
+    mux->free_list = NULL;
+    mux->free_cnt = 0;
+    for (i = 0; i < CONFIG_AT_MUX_POOL_BLOCKS; i++) {
+        at_mux_blk_put(mux, &mux->pool[i]);
+    }
+    for (i = 0; i < AT_MUX_LINK_NUM; i++) {
+        mux->link[i].rx = NULL;
+        at_mux_link_drop(mux, &mux->link[i]);
+    }
+    mux->out = *out;
+    mux->opened = 1;
+    system_irq_restore(flags);
+
+    return 0;
+}
+
+//only valid with no link open: a receive in progress would still own its block
+void at_mux_close(void)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    unsigned long flags;
+    int i;
+
+    if (!mux->opened) {
+        return;
+    }
+
+    flags = system_irq_save();
+    mux->opened = 0;
+    for (i = 0; i < AT_MUX_LINK_NUM; i++) {
+        at_mux_link_drop(mux, &mux->link[i]);
+    }
+    system_irq_restore(flags);
+
+    while (mux->inflight) {
+        os_msleep(1);
+    }
+
+    os_free(mux->pool);
+    mux->pool = NULL;
+    mux->free_list = NULL;
+    mux->free_cnt = 0;
+}
+
+int at_mux_opened(void)
+{
+    return at_mux.opened;
+}
+
+unsigned int at_mux_rx_room(int link)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    at_mux_link_t *l;
+
+    if (!mux->opened || link < 0 || link >= AT_MUX_LINK_NUM) {
+        return 0;
+    }
+
+    l = &mux->link[link];
+    if (l->rx) {
+        return CONFIG_AT_MUX_BLOCK_SIZE;
+    }
+
+    if (!mux->free_cnt || l->info.blocks >= CONFIG_AT_MUX_LINK_BLOCKS) {
+        l->info.rx_stall++;
+        return 0;
+    }
+
+    return CONFIG_AT_MUX_BLOCK_SIZE;
+}
+
+//a block of CONFIG_AT_MUX_BLOCK_SIZE bytes to receive into, NULL when the link has no room
+unsigned char *at_mux_rx_buf(int link)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    at_mux_link_t *l;
+    unsigned long flags;
+    at_mux_blk_t *blk = NULL;
+
+    if (!at_mux_rx_room(link)) {
+        return NULL;
+    }
+
+    l = &mux->link[link];
+    flags = system_irq_save();
+    if (!l->rx) {
+        l->rx = at_mux_blk_get(mux);
+        if (l->rx) {
+            l->rx_drop = 0;
+            l->info.blocks++;
+        }
+    }
+    blk = l->rx;
+    system_irq_restore(flags);
+
+    return blk ? &blk->data[AT_MUX_HEADROOM] : NULL;
+}
+
+//queue len bytes received into the block from at_mux_rx_buf(), 0 gives it back
+void at_mux_rx_commit(int link, unsigned int len)
+{
+    at_mux_rx_commit_from(link, len, 0, 0);
+}
+
+//as at_mux_rx_commit(), the frames of the block also carry the sender ip:port
+void at_mux_rx_commit_from(int link, unsigned int len, unsigned int ip, unsigned short port)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    at_mux_link_t *l;
+    at_mux_blk_t *blk;
+    unsigned long flags;
+
+    if (link < 0 || link >= AT_MUX_LINK_NUM) {
+        return;
+    }
+
+    l = &mux->link[link];
+    flags = system_irq_save();
+    blk = l->rx;
+    l->rx = NULL;
+    if (!blk) {
+        system_irq_restore(flags);
+        return;
+    }
+
+    if (!len || l->rx_drop) {
+        if (l->info.blocks) {
+            l->info.blocks--;
+        }
+        l->rx_drop = 0;
+        at_mux_blk_put(mux, blk);
+        system_irq_restore(flags);
+        return;
+    }
+
+    blk->len = MIN(len, CONFIG_AT_MUX_BLOCK_SIZE);
+    blk->rd = 0;
+    blk->from_ip = ip;
+    blk->from_port = port;
+    blk->next = NULL;
+    if (l->tail) {
+        l->tail->next = blk;
+    } else {
+        l->head = blk;
+    }
+    l->tail = blk;
+    l->info.queued += blk->len;
+    l->info.rx_bytes += blk->len;
+    system_irq_restore(flags);
+
+    os_sem_post(mux->sem);
+}
+
+//drop whatever the link still holds and restore its defaults, on open and close
+void at_mux_link_reset(int link)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    unsigned long flags;
+
+    if (!mux->opened || link < 0 || link >= AT_MUX_LINK_NUM) {
+        return;
+    }
+
+    flags = system_irq_save();
+    at_mux_link_drop(mux, &mux->link[link]);
+    system_irq_restore(flags);
+}
+
+int at_mux_credit(int link, unsigned int bytes)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    at_mux_link_t *l;
+    unsigned long flags;
+
+    if (!mux->opened || link < 0 || link >= AT_MUX_LINK_NUM) {
+        return -1;
+    }
+
+    l = &mux->link[link];
+    flags = system_irq_save();
+    l->info.credit = (l->info.credit + bytes < l->info.credit) ? 0xFFFFFFFF : l->info.credit + bytes;
+    system_irq_restore(flags);
+
+    os_sem_post(mux->sem);
+    return 0;
+}
+
+int at_mux_set_weight(int link, unsigned int weight)
+{
+    at_mux_ctx_t *mux = &at_mux;
+
+    if (!mux->opened || link < 0 || link >= AT_MUX_LINK_NUM || !weight || weight > AT_MUX_WEIGHT_MAX) {
+        return -1;
+    }
+
+    mux->link[link].info.weight = weight;
+    return 0;
+}
+
+int at_mux_get_link(int link, at_mux_link_info_t *info)
+{
+    at_mux_ctx_t *mux = &at_mux;
+    unsigned long flags;
+
+    if (!mux->opened || link < 0 || link >= AT_MUX_LINK_NUM || !info) {
+        return -1;
+    }
+
+    flags = system_irq_save();
+    *info = mux->link[link].info;
+    system_irq_restore(flags);
+
+    return 0;
+}
+
+unsigned int at_mux_pool_free(void)
+{
+    return at_mux.free_cnt;
+}
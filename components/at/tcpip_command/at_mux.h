@@ -0,0 +1,61 @@
+#ifndef __AT_MUX__
+#define __AT_MUX__
+#include "dce.h"
+#include "wifi_command.h"
+
+#ifndef CONFIG_AT_MUX_POOL_BLOCKS
+#define CONFIG_AT_MUX_POOL_BLOCKS      8
+#endif
+#ifndef CONFIG_AT_MUX_LINK_BLOCKS
+#define CONFIG_AT_MUX_LINK_BLOCKS      4
+#endif
+#ifndef CONFIG_AT_MUX_BLOCK_SIZE
+#define CONFIG_AT_MUX_BLOCK_SIZE       1472
+#endif
+#ifndef CONFIG_AT_MUX_QUANTUM
+#define CONFIG_AT_MUX_QUANTUM          512
+#endif
+#ifndef CONFIG_AT_MUX_INIT_CREDIT
+#define CONFIG_AT_MUX_INIT_CREDIT      2920
+#endif
+
+#define AT_MUX_LINK_NUM         MAX_CONN_NUM
+#define AT_MUX_WEIGHT_MAX       16
+
+/*
+ * output side of the mux: tx gets one complete "+IPD,<id>,<len>:<data>"
+ * frame per call and returns once it has been written out. blocks queued by
+ * at_mux_rx_commit_from() frame as "+IPD,<id>,<len>,<ip>,<port>:<data>".
+ */
+typedef struct {
+    void           (*tx)(void *ctx, const unsigned char *buf, unsigned int len);
+    void            *ctx;
+}at_mux_out_t;
+
+typedef struct {
+    unsigned int     credit;
+    unsigned int     weight;
+    unsigned int     queued;        //bytes waiting for credit or the uart
+    unsigned int     blocks;        //pool blocks held by the link
+    unsigned int     rx_bytes;
+    unsigned int     tx_bytes;
+    unsigned int     tx_frames;
+    unsigned int     rx_stall;      //polls the link was held off for lack of pool space
+}at_mux_link_info_t;
+
+int at_mux_open(const at_mux_out_t *out);
+void at_mux_close(void);
+int at_mux_opened(void);
+
+unsigned int at_mux_rx_room(int link);
+unsigned char *at_mux_rx_buf(int link);
+void at_mux_rx_commit(int link, unsigned int len);
+void at_mux_rx_commit_from(int link, unsigned int len, unsigned int ip, unsigned short port);
+void at_mux_link_reset(int link);
+
+int at_mux_credit(int link, unsigned int bytes);
+int at_mux_set_weight(int link, unsigned int weight);
+int at_mux_get_link(int link, at_mux_link_info_t *info);
+unsigned int at_mux_pool_free(void);
+
+#endif
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "oshal.h"
+#include "cli.h"
+#include "at_mux.h"
+
+/*
+ * loopback stand-in for at_net and the host: a producer task fills every
+ * link with its own counting pattern as fast as the pool lets it, the sink
+ * parses the +IPD frames, checks each link's pattern and grants the credit
+ * back. the first link can be made a slow reader that returns its credit
+ * only every few hundred ms, the other links must keep going regardless.
+ */
+#define AT_MUX_LB_SLOW_MS       200
+
+typedef struct {
+    unsigned int     total;
+    unsigned int     links;
+    unsigned int     bytes_per_tick;   //uart rate in the sink, 0: unlimited
+    unsigned int     tick_bytes;
+    int              slow;             //link 0 grants credit lazily
+    TickType_t       slow_tick;
+    unsigned int     slow_owed;
+    volatile int     done;
+    int              task;
+    unsigned int     sent[AT_MUX_LINK_NUM];
+    unsigned int     got[AT_MUX_LINK_NUM];
+    unsigned char    produce[AT_MUX_LINK_NUM];
+    unsigned char    expect[AT_MUX_LINK_NUM];
+    unsigned int     finish_ms[AT_MUX_LINK_NUM];
+    unsigned int     frame_err;
+    unsigned int     pattern_err;
+    TickType_t       start;
+}at_mux_lb_t;
+
+static at_mux_lb_t *at_mux_lb;
+
+static void at_mux_lb_tx(void *ctx, const unsigned char *buf, unsigned int len)
+{
+    at_mux_lb_t *lb = (at_mux_lb_t *)ctx;
+    const unsigned char *p = buf, *end = buf + len;
+    char *colon;
+    unsigned int link, n, i;
+
+    if (len < 8 || memcmp(buf, "+IPD,", 5)) {
+        lb->frame_err++;
+        return;
+    }
+    link = strtoul((const char *)p + 5, &colon, 10);
+    n = strtoul(colon + 1, &colon, 10);
+    p = (const unsigned char *)colon + 1;
+    if (*colon != ':' || link >= lb->links || p + n != end) {
+        lb->frame_err++;
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (p[i] != lb->expect[link]) {
+            lb->pattern_err++;
+            lb->expect[link] = p[i];
+        }
+        lb->expect[link]++;
+    }
+    lb->got[link] += n;
+    if (lb->got[link] >= lb->total && !lb->finish_ms[link]) {
+        lb->finish_ms[link] = (xTaskGetTickCount() - lb->start) * portTICK_PERIOD_MS;
+    }
+
+    if (lb->bytes_per_tick) {
+        lb->tick_bytes += len;
+        if (lb->tick_bytes >= lb->bytes_per_tick) {
+            vTaskDelay(lb->tick_bytes / lb->bytes_per_tick);
+            lb->tick_bytes %= lb->bytes_per_tick;
+        }
+    }
+
+    if (lb->slow && !link) {
+        lb->slow_owed += n;
+        if (xTaskGetTickCount() - lb->slow_tick >= pdMS_TO_TICKS(AT_MUX_LB_SLOW_MS)) {
+            lb->slow_tick = xTaskGetTickCount();
+            at_mux_credit(link, lb->slow_owed);
+            lb->slow_owed = 0;
+        }
+    } else {
+        at_mux_credit(link, n);
+    }
+}
+
+static void at_mux_lb_producer(void *arg)
+{
+    at_mux_lb_t *lb = (at_mux_lb_t *)arg;
+    unsigned char *buf;
+    unsigned int link, n, i, busy;
+
+    while (1) {
+        busy = 0;
+        for (link = 0; link < lb->links; link++) {
+            if (lb->sent[link] >= lb->total) {
+                continue;
+            }
+            busy = 1;
+            buf = at_mux_rx_buf(link);
+            if (!buf) {
+                continue;
+            }
+            n = lb->total - lb->sent[link];
+            n = (n > CONFIG_AT_MUX_BLOCK_SIZE) ? CONFIG_AT_MUX_BLOCK_SIZE : n;
+            for (i = 0; i < n; i++) {
+                buf[i] = lb->produce[link]++;
+            }
+            at_mux_rx_commit(link, n);
+            lb->sent[link] += n;
+        }
+        if (!busy) {
+            break;
+        }
+        vTaskDelay(1);
+    }
+
+    lb->done = 1;
+    lb->task = 0;
+    os_task_delete(0);
+}
+
+static int at_mux_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+    at_mux_lb_t *lb;
+    at_mux_out_t out;
+    at_mux_link_info_t info;
+    unsigned int baud, wait, link, all;
+    int ret = CMD_RET_FAILURE;
+
+    if (argc < 4) {
+        os_printf(LM_CMD, LL_INFO, "usage: at_mux bench <links> <bytes> <baud|0> [slow]\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    if (at_mux_opened() || at_mux_lb) {
+        os_printf(LM_CMD, LL_INFO, "mux busy\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    lb = (at_mux_lb_t *)os_zalloc(sizeof(*lb));
+    if (!lb) {
+        return CMD_RET_FAILURE;
+    }
+    at_mux_lb = lb;
+
+    lb->links = strtoul(argv[1], NULL, 0);
+    lb->links = (lb->links > AT_MUX_LINK_NUM) ? AT_MUX_LINK_NUM : (lb->links ? lb->links : 1);
+    lb->total = strtoul(argv[2], NULL, 0);
+    baud = strtoul(argv[3], NULL, 0);
+    lb->bytes_per_tick = baud / 10 / configTICK_RATE_HZ;
+    lb->slow = (argc > 4) ? strtoul(argv[4], NULL, 0) : 0;
+
+    out.tx  = at_mux_lb_tx;
+    out.ctx = lb;
+    if (at_mux_open(&out)) {
+        goto out;
+    }
+
+    lb->start = lb->slow_tick = xTaskGetTickCount();
+    lb->task = os_task_create("at_mux_host", 4, 1024, (task_entry_t)at_mux_lb_producer, lb);
+    if (lb->task == -1) {
+        lb->task = 0;
+        at_mux_close();
+        goto out;
+    }
+
+    wait = 2000 + (baud ? (unsigned long long)lb->total * lb->links * 10 * 1000 / baud : lb->total * lb->links / 10);
+    wait += lb->slow ? lb->total / CONFIG_AT_MUX_INIT_CREDIT * AT_MUX_LB_SLOW_MS : 0;
+    do {
+        os_msleep(10);
+        wait = (wait > 10) ? wait - 10 : 0;
+        for (link = 0, all = lb->done; link < lb->links; link++) {
+            all = all && (lb->got[link] >= lb->total);
+        }
+        //the slow reader still owes credit for its tail, hand it over
+        if (lb->slow && lb->slow_owed && lb->done) {
+            at_mux_credit(0, lb->slow_owed);
+            lb->slow_owed = 0;
+        }
+    } while (wait && !all);
+
+    for (link = 0; link < lb->links; link++) {
+        at_mux_get_link(link, &info);
+        os_printf(LM_CMD, LL_INFO, "link%d: %d/%d bytes, %d frames, %dms, rx_stall:%d\r\n",
+            link, lb->got[link], lb->total, info.tx_frames, lb->finish_ms[link], info.rx_stall);
+    }
+    os_printf(LM_CMD, LL_INFO, "pool free:%d/%d frame_err:%d pattern_err:%d\r\n",
+        at_mux_pool_free(), CONFIG_AT_MUX_POOL_BLOCKS, lb->frame_err, lb->pattern_err);
+
+    if (all && !lb->frame_err && !lb->pattern_err) {
+        os_printf(LM_CMD, LL_INFO, "at_mux bench OK\r\n");
+        ret = CMD_RET_SUCCESS;
+    } else {
+        os_printf(LM_CMD, LL_INFO, "at_mux bench FAILED\r\n");
+    }
+
+    if (lb->task) {
+        os_task_delete(lb->task);
+        lb->task = 0;
+    }
+    at_mux_close();
+
+out:
+    at_mux_lb = NULL;
+    os_free(lb);
+    return ret;
+}
+
+CLI_SUBCMD(at_mux, bench, at_mux_bench, "at mux loopback test", "at_mux bench <links> <bytes> <baud|0> [slow]");
+CLI_CMD(at_mux, NULL, "at multiplexed data mode", "at_mux");
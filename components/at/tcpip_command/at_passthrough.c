@@ -0,0 +1,298 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "oshal.h"
+#include "uart.h"
+#include "at_passthrough.h"
+
+#define AT_PT_TASK_STACK_SIZE   (2048)
+#define AT_PT_TASK_PRIO         4
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif
+
+typedef struct {
+    at_pt_port_t    *port;
+    at_pt_sink_t     sink;
+    volatile int     running;
+    volatile int     stop_req;
+    int              task;
+    os_sem_handle_t  start_sem;
+    os_sem_handle_t  stop_sem;
+    at_pt_stats_t    stats;
+}at_pt_ctx_t;
+
+static at_pt_ctx_t at_pt;
+
+extern E_DRV_UART_NUM uart_num;
+
+/*******************************uart dma port*************************/
+static int at_pt_uart_start(at_pt_port_t *port)
+{
+    unsigned int mode = UART_RX_MODE_DMA_POLLLIST;
+
+    return drv_uart_ioctrl(uart_num, DRV_UART_CTRL_SET_RX_MODE, &mode);
+}
+
+static void at_pt_uart_stop(at_pt_port_t *port)
+{
+    unsigned int mode = UART_RX_MODE_USER;
+
+    drv_uart_ioctrl(uart_num, DRV_UART_CTRL_SET_RX_MODE, &mode);
+}
+
+static unsigned int at_pt_uart_written(at_pt_port_t *port)
+{
+    unsigned int written = 0;
+
+    drv_uart_ioctrl(uart_num, DRV_UART_CTRL_GET_RX_DMA_WRITTEN, &written);
+    return written;
+}
+
+static void at_pt_uart_wait(at_pt_port_t *port, unsigned int ms)
+{
+    drv_uart_ioctrl(uart_num, DRV_UART_CTRL_RX_DMA_WAIT, &ms);
+}
+
+static void at_pt_uart_set_rts(at_pt_port_t *port, int ready)
+{
+    unsigned int level = ready;
+
+    drv_uart_ioctrl(uart_num, DRV_UART_CTRL_SET_RTS, &level);
+}
+
+static at_pt_port_t at_pt_uart = {
+    .ring    = uart_src,
+    .size    = UART_BUF_SIZE,
+    .start   = at_pt_uart_start,
+    .stop    = at_pt_uart_stop,
+    .written = at_pt_uart_written,
+    .wait    = at_pt_uart_wait,
+    .set_rts = at_pt_uart_set_rts,
+};
+
+at_pt_port_t *at_pt_uart_port(void)
+{
+    return &at_pt_uart;
+}
+
+/*******************************engine*************************/
+static int at_pt_is_escape(at_pt_port_t *port, unsigned int rd, unsigned int fill)
+{
+    unsigned int i;
+
+    if (fill != 3) {
+        return 0;
+    }
+
+    for (i = 0; i < fill; i++) {
+        if (port->ring[(rd + i) % port->size] != '+') {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+//hand [rd, rd+len) to the sink as at most two segments, straight out of the ring
+static int at_pt_flush(at_pt_ctx_t *pt, unsigned int rd, unsigned int len)
+{
+    at_pt_port_t *port = pt->port;
+    struct iovec iov[AT_PT_IOV_MAX];
+    unsigned int first = MIN(len, port->size - rd);
+    int iovcnt = 1;
+
+    iov[0].iov_base = &port->ring[rd];
+    iov[0].iov_len  = first;
+    if (first < len) {
+        iov[1].iov_base = port->ring;
+        iov[1].iov_len  = len - first;
+        iovcnt = 2;
+    }
+
+    return pt->sink.sendv(pt->sink.ctx, iov, iovcnt);
+}
+
+static void at_pt_task(void *arg)
+{
+    at_pt_ctx_t  *pt = (at_pt_ctx_t *)arg;
+    at_pt_port_t *port;
+    at_pt_exit_e  reason;
+    unsigned int  rd, rd_total, wr, last_wr, fill, lost;
+    TickType_t    now, last_rx;
+    const TickType_t idle_ticks = pdMS_TO_TICKS(CONFIG_AT_PT_IDLE_MS) ? pdMS_TO_TICKS(CONFIG_AT_PT_IDLE_MS) : 1;
+    int           rts_ready, idle, ret, stop_req;
+    unsigned long flags;
+
+    while (1) {
+        os_sem_wait(pt->start_sem, WAIT_FOREVER);
+
+        port      = pt->port;
+        rd        = 0;
+        rd_total  = 0;
+        last_wr   = 0;
+        last_rx   = xTaskGetTickCount();
+        rts_ready = 1;
+        reason    = AT_PT_EXIT_STOP;
+        port->set_rts(port, 1);
+
+        while (!pt->stop_req) {
+            wr  = port->written(port);
+            now = xTaskGetTickCount();
+            if (wr != last_wr) {
+                pt->stats.rx_bytes += wr - last_wr;
+                last_wr = wr;
+                last_rx = now;
+            }
+
+            //totals, not ring offsets: a producer that lapped the reader leaves more than a ring pending
+            fill = wr - rd_total;
+            if (fill > port->size) {
+                //the oldest data is overwritten, resync onto the newer half of the ring
+                lost = fill - port->size / 2;
+                rd = (rd + lost) % port->size;
+                rd_total += lost;
+                fill -= lost;
+                pt->stats.overruns++;
+                os_printf(LM_APP, LL_WARN, "at_pt rx overrun, %u bytes lost\n", lost);
+            }
+            if (fill > pt->stats.max_fill) {
+                pt->stats.max_fill = fill;
+            }
+
+            //rx watermark: hold the host off before dma laps the reader
+            if (rts_ready && fill >= CONFIG_AT_PT_HIGH_WATERMARK) {
+                port->set_rts(port, 0);
+                rts_ready = 0;
+                pt->stats.rts_off++;
+            } else if (!rts_ready && fill <= CONFIG_AT_PT_LOW_WATERMARK) {
+                port->set_rts(port, 1);
+                rts_ready = 1;
+            }
+
+            idle = (now - last_rx) >= idle_ticks;
+            if (!fill) {
+                //sleep until dma fills a block, a partial one shows up after the idle gap
+                port->wait(port, CONFIG_AT_PT_IDLE_MS);
+                continue;
+            }
+            if (fill < CONFIG_AT_PT_SEND_THRESHOLD && !idle) {
+                port->wait(port, (idle_ticks - (now - last_rx)) * portTICK_PERIOD_MS);
+                continue;
+            }
+
+            if (idle && at_pt_is_escape(port, rd, fill)) {
+                reason = AT_PT_EXIT_ESCAPE;
+                break;
+            }
+
+            //tx watermark: a busy sink leaves the data in the ring, the rx watermark then throttles the host
+            ret = at_pt_flush(pt, rd, fill);
+            if (ret > 0) {
+                rd = (rd + ret) % port->size;
+                rd_total += ret;
+                pt->stats.tx_bytes += ret;
+                pt->stats.tx_calls++;
+            } else if (ret < 0) {
+                pt->stats.tx_err++;
+                reason = AT_PT_EXIT_ERROR;
+                break;
+            } else {
+                pt->stats.tx_busy++;
+                vTaskDelay(1);
+            }
+        }
+
+        port->set_rts(port, 1);
+        port->stop(port);
+
+        flags = system_irq_save();
+        pt->running = 0;
+        stop_req = pt->stop_req;
+        pt->stop_req = 0;
+        pt->stats.stop_tick = xTaskGetTickCount();
+        system_irq_restore(flags);
+
+        if (stop_req) {
+            os_sem_post(pt->stop_sem);
+        } else if (pt->sink.on_exit) {
+            pt->sink.on_exit(pt->sink.ctx, reason);
+        }
+    }
+}
+
+int at_pt_start(at_pt_port_t *port, const at_pt_sink_t *sink)
+{
+    at_pt_ctx_t *pt = &at_pt;
+
+    if (!port || !sink || !sink->sendv) {
+        return -1;
+    }
+
+    if (pt->running) {
+        return -1;
+    }
+
+    if (!pt->task) {
+        pt->start_sem = os_sem_create(1, 0);
+        pt->stop_sem  = os_sem_create(1, 0);
+        if (!pt->start_sem || !pt->stop_sem) {
+            os_printf(LM_APP, LL_ERR, "at_pt sem create failed\n");
+            return -1;
+        }
+
+        pt->task = os_task_create("at_pt", AT_PT_TASK_PRIO, AT_PT_TASK_STACK_SIZE, (task_entry_t)at_pt_task, pt);
+        if (pt->task == -1) {
+            pt->task = 0;
+            os_printf(LM_APP, LL_ERR, "at_pt task create failed\n");
+            return -1;
+        }
+    }
+
+    if (port->start(port)) {
+        os_printf(LM_APP, LL_ERR, "at_pt port start failed\n");
+        return -1;
+    }
+
+    memset(&pt->stats, 0, sizeof(pt->stats));
+    pt->stats.start_tick = xTaskGetTickCount();
+    pt->port     = port;
+    pt->sink     = *sink;
+    pt->stop_req = 0;
+    pt->running  = 1;
+    os_sem_post(pt->start_sem);
+
+    return 0;
+}
+
+int at_pt_stop(void)
+{
+    at_pt_ctx_t *pt = &at_pt;
+    unsigned long flags = system_irq_save();
+    int running = pt->running;
+
+    if (running) {
+        pt->stop_req = 1;
+    }
+    system_irq_restore(flags);
+
+    if (running) {
+        os_sem_wait(pt->stop_sem, WAIT_FOREVER);
+    }
+
+    return 0;
+}
+
+int at_pt_running(void)
+{
+    return at_pt.running;
+}
+
+void at_pt_get_stats(at_pt_stats_t *stats)
+{
+    *stats = at_pt.stats;
+    if (at_pt.running) {
+        stats->stop_tick = xTaskGetTickCount();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef __AT_PASSTHROUGH__
+#define __AT_PASSTHROUGH__
+#include "lwip/sockets.h"
+
+#ifndef CONFIG_AT_PT_HIGH_WATERMARK
+#define CONFIG_AT_PT_HIGH_WATERMARK    2048
+#endif
+#ifndef CONFIG_AT_PT_LOW_WATERMARK
+#define CONFIG_AT_PT_LOW_WATERMARK     512
+#endif
+#ifndef CONFIG_AT_PT_SEND_THRESHOLD
+#define CONFIG_AT_PT_SEND_THRESHOLD    1460
+#endif
+#ifndef CONFIG_AT_PT_IDLE_MS
+#define CONFIG_AT_PT_IDLE_MS           20
+#endif
+
+#define AT_PT_IOV_MAX   2
+
+typedef enum {
+    AT_PT_EXIT_STOP,        //stopped by at_pt_stop()
+    AT_PT_EXIT_ESCAPE,      //host sent "+++"
+    AT_PT_EXIT_ERROR,       //sink returned a hard error
+}at_pt_exit_e;
+
+/*
+ * rx side of the engine: a ring the producer (uart dma) writes into.
+ * start() restarts the producer at ring offset 0; the engine only reads
+ * the producer progress, it never copies the data.
+ * written() is the total byte count since start() (wraps at 2^32), so a
+ * producer lapping the reader shows up as more than size bytes pending.
+ * wait() blocks until the producer signals new data or ms elapsed.
+ */
+typedef struct at_pt_port {
+    unsigned char   *ring;
+    unsigned int     size;
+    int            (*start)(struct at_pt_port *port);
+    void           (*stop)(struct at_pt_port *port);
+    unsigned int   (*written)(struct at_pt_port *port);
+    void           (*wait)(struct at_pt_port *port, unsigned int ms);
+    void           (*set_rts)(struct at_pt_port *port, int ready);
+    void            *priv;
+}at_pt_port_t;
+
+/*
+ * tx side of the engine.
+ * sendv returns bytes consumed, 0 when the sink can not take data right now
+ * (data stays in the ring), <0 on a hard error.
+ */
+typedef struct {
+    int            (*sendv)(void *ctx, const struct iovec *iov, int iovcnt);
+    void           (*on_exit)(void *ctx, at_pt_exit_e reason);
+    void            *ctx;
+}at_pt_sink_t;
+
+typedef struct {
+    unsigned int     rx_bytes;
+    unsigned int     tx_bytes;
+    unsigned int     tx_calls;
+    unsigned int     tx_busy;
+    unsigned int     tx_err;
+    unsigned int     rts_off;
+    unsigned int     overruns;
+    unsigned int     max_fill;
+    unsigned int     start_tick;
+    unsigned int     stop_tick;
+}at_pt_stats_t;
+
+int at_pt_start(at_pt_port_t *port, const at_pt_sink_t *sink);
+int at_pt_stop(void);
+int at_pt_running(void);
+void at_pt_get_stats(at_pt_stats_t *stats);
+at_pt_port_t *at_pt_uart_port(void);
+
+#endif
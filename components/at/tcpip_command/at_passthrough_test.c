@@ -0,0 +1,277 @@
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "oshal.h"
+#include "cli.h"
+#include "at_passthrough.h"
+
+/*
+ * loopback stand-in for the at uart: a producer task plays the host, writing
+ * a counting pattern into a ram ring at a given baud rate and honouring rts
+ * like a host with cts flow control would. the sink checks the pattern, so
+ * lost, duplicated or reordered bytes show up as errors.
+ */
+#define AT_PT_LB_RING_SIZE      (3 * 1024)
+#define AT_PT_LB_RTS_CHUNK      16
+
+typedef struct {
+    unsigned char    ring[AT_PT_LB_RING_SIZE];
+    volatile unsigned int wr;
+    volatile unsigned int written;
+    os_sem_handle_t  rx_sem;
+    volatile int     rts;
+    unsigned int     total;
+    unsigned int     bytes_per_tick;   //0: as fast as rts allows
+    unsigned int     sink_busy_every;  //sink reports busy every n calls, 0: never
+    volatile int     done;
+    volatile int     escaped;
+    unsigned char    expect;
+    unsigned int     sink_calls;
+    unsigned int     sink_bytes;
+    unsigned int     pattern_err;
+    int              task;
+}at_pt_lb_t;
+
+static at_pt_lb_t *at_pt_lb;
+
+static int at_pt_lb_start(at_pt_port_t *port)
+{
+    at_pt_lb_t *lb = (at_pt_lb_t *)port->priv;
+
+    lb->wr = 0;
+    lb->written = 0;
+    return 0;
+}
+
+static void at_pt_lb_stop(at_pt_port_t *port)
+{
+}
+
+static unsigned int at_pt_lb_written(at_pt_port_t *port)
+{
+    return ((at_pt_lb_t *)port->priv)->written;
+}
+
+static void at_pt_lb_wait(at_pt_port_t *port, unsigned int ms)
+{
+    os_sem_wait(((at_pt_lb_t *)port->priv)->rx_sem, ms);
+}
+
+static void at_pt_lb_set_rts(at_pt_port_t *port, int ready)
+{
+    ((at_pt_lb_t *)port->priv)->rts = ready;
+}
+
+static void at_pt_lb_put(at_pt_lb_t *lb, const unsigned char *data, unsigned int len)
+{
+    unsigned int i, wr = lb->wr;
+
+    for (i = 0; i < len; i++) {
+        lb->ring[wr] = data[i];
+        wr = (wr + 1) % AT_PT_LB_RING_SIZE;
+    }
+    lb->wr = wr;
+    lb->written += len;
+    os_sem_post(lb->rx_sem);
+}
+
+static void at_pt_lb_host(void *arg)
+{
+    at_pt_lb_t *lb = (at_pt_lb_t *)arg;
+    unsigned char chunk[AT_PT_LB_RTS_CHUNK];
+    unsigned int sent = 0, tick_sent = 0, n, i;
+    unsigned char pattern = 0;
+
+    while (sent < lb->total) {
+        if (!lb->rts) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        if (lb->bytes_per_tick && tick_sent >= lb->bytes_per_tick) {
+            tick_sent = 0;
+            vTaskDelay(1);
+            continue;
+        }
+
+        n = lb->total - sent;
+        n = (n > AT_PT_LB_RTS_CHUNK) ? AT_PT_LB_RTS_CHUNK : n;
+        for (i = 0; i < n; i++) {
+            chunk[i] = pattern++;
+        }
+        at_pt_lb_put(lb, chunk, n);
+        sent += n;
+        tick_sent += n;
+
+        if (!lb->bytes_per_tick && !(sent % 1024)) {
+            taskYIELD();
+        }
+    }
+
+    //guard time, escape sequence, guard time
+    vTaskDelay(pdMS_TO_TICKS(CONFIG_AT_PT_IDLE_MS * 3));
+    at_pt_lb_put(lb, (const unsigned char *)"+++", 3);
+
+    lb->done = 1;
+    lb->task = 0;
+    os_task_delete(0);
+}
+
+static int at_pt_lb_sendv(void *ctx, const struct iovec *iov, int iovcnt)
+{
+    at_pt_lb_t *lb = (at_pt_lb_t *)ctx;
+    const unsigned char *p;
+    unsigned int len = 0, i;
+    int n;
+
+    lb->sink_calls++;
+    if (lb->sink_busy_every && !(lb->sink_calls % lb->sink_busy_every)) {
+        return 0;
+    }
+
+    for (n = 0; n < iovcnt; n++) {
+        p = (const unsigned char *)iov[n].iov_base;
+        for (i = 0; i < iov[n].iov_len; i++) {
+            if (p[i] != lb->expect) {
+                lb->pattern_err++;
+                lb->expect = p[i];
+            }
+            lb->expect++;
+        }
+        len += iov[n].iov_len;
+    }
+    lb->sink_bytes += len;
+
+    return len;
+}
+
+static void at_pt_lb_exit(void *ctx, at_pt_exit_e reason)
+{
+    at_pt_lb_t *lb = (at_pt_lb_t *)ctx;
+
+    lb->escaped = (AT_PT_EXIT_ESCAPE == reason);
+}
+
+static at_pt_port_t at_pt_lb_port = {
+    .start   = at_pt_lb_start,
+    .stop    = at_pt_lb_stop,
+    .written = at_pt_lb_written,
+    .wait    = at_pt_lb_wait,
+    .set_rts = at_pt_lb_set_rts,
+};
+
+static void at_pt_show_stats(void)
+{
+    at_pt_stats_t stats;
+    unsigned int ms;
+
+    at_pt_get_stats(&stats);
+    ms = (stats.stop_tick - stats.start_tick) * portTICK_PERIOD_MS;
+    os_printf(LM_CMD, LL_INFO, "running:%d time:%dms\r\n", at_pt_running(), ms);
+    os_printf(LM_CMD, LL_INFO, "rx:%d tx:%d calls:%d busy:%d err:%d\r\n",
+        stats.rx_bytes, stats.tx_bytes, stats.tx_calls, stats.tx_busy, stats.tx_err);
+    os_printf(LM_CMD, LL_INFO, "rts_off:%d overruns:%d max_fill:%d avg_send:%d\r\n",
+        stats.rts_off, stats.overruns, stats.max_fill, stats.tx_calls ? stats.tx_bytes / stats.tx_calls : 0);
+    if (ms) {
+        os_printf(LM_CMD, LL_INFO, "throughput:%d bytes/s\r\n", (unsigned int)((unsigned long long)stats.tx_bytes * 1000 / ms));
+    }
+}
+
+static int at_pt_stat(cmd_tbl_t *t, int argc, char *argv[])
+{
+    at_pt_show_stats();
+    return CMD_RET_SUCCESS;
+}
+
+static int at_pt_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+    at_pt_lb_t *lb;
+    at_pt_sink_t sink;
+    unsigned int baud, wait;
+    int ret = CMD_RET_FAILURE;
+
+    if (argc < 3) {
+        os_printf(LM_CMD, LL_INFO, "usage: at_pt bench <bytes> <baud|0> [busy_every]\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    if (at_pt_running() || at_pt_lb) {
+        os_printf(LM_CMD, LL_INFO, "passthrough busy\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    lb = (at_pt_lb_t *)os_zalloc(sizeof(*lb));
+    if (!lb) {
+        return CMD_RET_FAILURE;
+    }
+    at_pt_lb = lb;
+
+    lb->rx_sem = os_sem_create(1, 0);
+    if (!lb->rx_sem) {
+        goto out;
+    }
+
+    baud = strtoul(argv[2], NULL, 0);
+    lb->total = strtoul(argv[1], NULL, 0);
+    lb->bytes_per_tick = baud / 10 / configTICK_RATE_HZ;
+    lb->sink_busy_every = (argc > 3) ? strtoul(argv[3], NULL, 0) : 0;
+    lb->rts = 1;
+
+    at_pt_lb_port.ring = lb->ring;
+    at_pt_lb_port.size = AT_PT_LB_RING_SIZE;
+    at_pt_lb_port.priv = lb;
+
+    sink.sendv   = at_pt_lb_sendv;
+    sink.on_exit = at_pt_lb_exit;
+    sink.ctx     = lb;
+
+    if (at_pt_start(&at_pt_lb_port, &sink)) {
+        goto out;
+    }
+
+    lb->task = os_task_create("at_pt_host", 4, 1024, (task_entry_t)at_pt_lb_host, lb);
+    if (lb->task == -1) {
+        lb->task = 0;
+        at_pt_stop();
+        goto out;
+    }
+
+    //generous timeout: the whole transfer at the requested rate plus slack
+    wait = 2000 + (baud ? (unsigned long long)lb->total * 10 * 1000 / baud : lb->total / 10);
+    while (wait && !(lb->done && !at_pt_running())) {
+        os_msleep(10);
+        wait = (wait > 10) ? wait - 10 : 0;
+    }
+
+    if (at_pt_running()) {
+        os_printf(LM_CMD, LL_INFO, "escape not detected, stopping\r\n");
+        at_pt_stop();
+    }
+
+    at_pt_show_stats();
+    os_printf(LM_CMD, LL_INFO, "sink:%d/%d pattern_err:%d escape:%d\r\n",
+        lb->sink_bytes, lb->total, lb->pattern_err, lb->escaped);
+
+    if (lb->sink_bytes == lb->total && !lb->pattern_err && lb->escaped) {
+        os_printf(LM_CMD, LL_INFO, "at_pt bench OK\r\n");
+        ret = CMD_RET_SUCCESS;
+    } else {
+        os_printf(LM_CMD, LL_INFO, "at_pt bench FAILED\r\n");
+    }
+
+out:
+    if (lb->task) {
+        os_task_delete(lb->task);
+    }
+    if (lb->rx_sem) {
+        os_sem_destroy(lb->rx_sem);
+    }
+    at_pt_lb = NULL;
+    os_free(lb);
+    return ret;
+}
+
+CLI_SUBCMD(at_pt, stat, at_pt_stat, "at passthrough statistics", "at_pt stat");
+CLI_SUBCMD(at_pt, bench, at_pt_bench, "at passthrough loopback throughput test", "at_pt bench <bytes> <baud|0> [busy_every]");
+CLI_CMD(at_pt, NULL, "at passthrough engine", "at_pt");
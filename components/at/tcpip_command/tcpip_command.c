@@ -24,6 +24,9 @@
 #include "lwip/netdb.h"
 
 #include "at_def.h"
+#ifdef CONFIG_AT_MUX_DATA
+#include "at_mux.h"
+#endif
 
 /************************quxin************************************/
 #define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
@@ -1312,7 +1315,16 @@ dce_result_t dce_handle_CIPRECVMODE(dce_t* dce, void* group_ctx, int kind, size_
         dce_emit_extended_result_code_with_args(dce, "CIPRECVMODE", -1, &result, 1, 1, false);
 
     } else if ((kind & DCE_WRITE) && (argc == 1 && argv[0].type == ARG_TYPE_NUMBER)) {
+#ifdef CONFIG_AT_MUX_DATA
+        //mux mode needs CIPMUX=1 and can only be switched with no link open
+        if (at_net_set_mux_mode(AT_RECV_MODE_MUX == argv[0].value.number)) {
+            dce_emit_basic_result_code(dce, DCE_RC_ERROR);
+            return DCE_RC_ERROR;
+        }
+        cfg->recv_mode = (AT_RECV_MODE_MUX == argv[0].value.number) ? AT_RECV_MODE_MUX : (argv[0].value.number ? 1 : 0);
+#else
         cfg->recv_mode = argv[0].value.number ? 1 : 0;
+#endif
     } else {
         dce_emit_basic_result_code(dce, DCE_RC_ERROR);
         return DCE_RC_ERROR;
@@ -2336,6 +2348,63 @@ dce_result_t dce_handle_PING(dce_t* dce, void* group_ctx, int kind, size_t argc,
     return DCE_OK;
 }
 
+#ifdef CONFIG_AT_MUX_DATA
+//AT+CIPRECVCREDIT=<link_id>,<bytes>: let the mux send <bytes> more on a link
+dce_result_t dce_handle_CIPRECVCREDIT(dce_t* dce, void* group_ctx, int kind, size_t argc, arg_t* argv)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+    at_mux_link_info_t info;
+    int link_id;
+
+    if (AT_RECV_MODE_MUX != cfg->recv_mode) {
+        dce_emit_basic_result_code(dce, DCE_RC_ERROR);
+        return DCE_RC_ERROR;
+    }
+
+    if (kind & DCE_READ) {
+        for (link_id = 0; link_id < MAX_CONN_NUM; link_id++) {
+            if (!at_net_find_client(link_id) || at_mux_get_link(link_id, &info)) {
+                continue;
+            }
+            //+CIPRECVCREDIT:<link_id>,<credit>,<queued>,<weight>
+            arg_t result[] = {
+                {ARG_TYPE_NUMBER, .value.number = link_id},
+                {ARG_TYPE_NUMBER, .value.number = info.credit},
+                {ARG_TYPE_NUMBER, .value.number = info.queued},
+                {ARG_TYPE_NUMBER, .value.number = info.weight},
+            };
+            dce_emit_extended_result_code_with_args(dce, "CIPRECVCREDIT", -1, result, 4, 1, false);
+        }
+    } else if ((kind & DCE_WRITE) && argc == 2 && argv[0].type == ARG_TYPE_NUMBER && argv[1].type == ARG_TYPE_NUMBER) {
+        if (at_mux_credit(argv[0].value.number, argv[1].value.number)) {
+            dce_emit_basic_result_code(dce, DCE_RC_ERROR);
+            return DCE_RC_ERROR;
+        }
+    } else {
+        dce_emit_basic_result_code(dce, DCE_RC_ERROR);
+        return DCE_RC_ERROR;
+    }
+
+    dce_emit_basic_result_code(dce, DCE_RC_OK);
+    return DCE_OK;
+}
+
+//AT+CIPRECVWEIGHT=<link_id>,<weight>: share of the uart a backlogged link gets, 1~16
+dce_result_t dce_handle_CIPRECVWEIGHT(dce_t* dce, void* group_ctx, int kind, size_t argc, arg_t* argv)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+
+    if (AT_RECV_MODE_MUX != cfg->recv_mode || argc != 2 || argv[0].type != ARG_TYPE_NUMBER || argv[1].type != ARG_TYPE_NUMBER
+        || at_mux_set_weight(argv[0].value.number, argv[1].value.number)) {
+        dce_emit_basic_result_code(dce, DCE_RC_ERROR);
+        return DCE_RC_ERROR;
+    }
+
+    dce_emit_basic_result_code(dce, DCE_RC_OK);
+    return DCE_OK;
+}
+#endif
+
 static const command_desc_t CIP_commands[] = {
     {"CIPSTAMAC"         , &dce_handle_CIPSTAMAC       , DCE_WRITE | DCE_READ},
 // quxin 先注释，因为6600上也是根据STA自动生成（最低位取反）?
@@ -2364,6 +2433,10 @@ static const command_desc_t CIP_commands[] = {
     {"CIPRECVMODE"       , &dce_handle_CIPRECVMODE     , DCE_WRITE | DCE_READ},
     {"CIPRECVDATA"       , &dce_handle_CIPRECVDATA     , DCE_WRITE | DCE_READ},
     {"CIPRECVLEN"        , &dce_handle_CIPRECVLEN      , DCE_WRITE | DCE_READ},
+#ifdef CONFIG_AT_MUX_DATA
+    {"CIPRECVCREDIT"     , &dce_handle_CIPRECVCREDIT   , DCE_WRITE | DCE_READ},
+    {"CIPRECVWEIGHT"     , &dce_handle_CIPRECVWEIGHT   , DCE_WRITE},
+#endif
 //    {"CIPSNTPCFG"        , &dce_handle_CIPSNTPCFG      , DCE_WRITE | DCE_READ},
 //    {"CIPSNTPTIME"       , &dce_handle_CIPSNTPTIME     , DCE_READ},
 //    {"CIPDNS"            , &dce_handle_CIPDNS          , DCE_WRITE | DCE_READ},
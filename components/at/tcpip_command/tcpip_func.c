@@ -19,6 +19,12 @@
 #include "basic_command.h"
 #include "system_config.h"
 #include "at_common.h"
+#ifdef CONFIG_AT_PASSTHROUGH_DMA
+#include "at_passthrough.h"
+#endif
+#ifdef CONFIG_AT_MUX_DATA
+#include "at_mux.h"
+#endif
 
 
 #define AT_NET_TASK_STACK_SIZE   (5120)
@@ -585,7 +591,11 @@ int at_net_client_close(client_db_t *client)
 	if (conn_type_tcp == client->type)
 	{
 		free(cfg->recv_buff.recv_data[client->id]);
+		cfg->recv_buff.recv_data[client->id] = NULL;
 	}
+#ifdef CONFIG_AT_MUX_DATA
+    at_mux_link_reset(client->id);
+#endif
     free_link_id(client->id);
     list_del(&client->list);
     free(client);
@@ -725,7 +735,8 @@ int at_net_client_start(client_db_t *param)
         return 1;
     }
 
-	if (param->type == conn_type_tcp)
+	//mux mode takes its buffers from the shared at_mux pool
+	if (param->type == conn_type_tcp && AT_RECV_MODE_MUX != cfg->recv_mode)
 	{
 		cfg->recv_buff.recv_data[param->id] = malloc(sizeof(conn_recv_data_t));
 		if (NULL == cfg->recv_buff.recv_data[param->id])
@@ -741,11 +752,16 @@ int at_net_client_start(client_db_t *param)
 
 	// tcp recv data 2920
     if(at_net_client_start_do(param, true)) {
-	if (param->type == conn_type_tcp)
+	if (param->type == conn_type_tcp) {
 		free(cfg->recv_buff.recv_data[param->id]);
+		cfg->recv_buff.recv_data[param->id] = NULL;
+	}
         free_link_id(param->id);
         return 1;
     }
+#ifdef CONFIG_AT_MUX_DATA
+    at_mux_link_reset(param->id);
+#endif
 
     client = malloc(sizeof(*client));
     *client = *param;
@@ -980,6 +996,9 @@ int at_net_abort_uart_rx(void)
 {
     net_conn_cfg_t   *cfg = get_net_conn_cfg();
 
+#ifdef CONFIG_AT_PASSTHROUGH_DMA
+    at_pt_stop();
+#endif
     dce_register_data_input_cb(NULL);
     target_dec_switch_input_state(COMMAND_STATE);
 
@@ -1403,6 +1422,96 @@ int at_net_client_tx()
     return 0;
 }
 
+#ifdef CONFIG_AT_PASSTHROUGH_DMA
+//passthrough sink: data goes out straight from the uart dma ring
+static int at_net_pt_sendv(void *ctx, const struct iovec *iov, int iovcnt)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+    client_db_t *client = cfg->send_buff.client;
+    struct sockaddr_in sock_addr;
+    struct msghdr msg;
+    int i, ret = 0, out = 0;
+
+    if (!client || conn_stat_connected != client->state || client->fd < 0) {
+        return 0;
+    }
+
+    if (conn_type_tcp == client->type) {
+        ret = lwip_writev(client->fd, iov, iovcnt);
+        out = ret;
+    } else if (conn_type_udp == client->type) {
+        memset(&sock_addr, 0, sizeof(sock_addr));
+        sock_addr.sin_addr.s_addr = ip_2_ip4(&client->ip_info.dst_ip)->addr;
+        sock_addr.sin_family = AF_INET;
+        sock_addr.sin_port = htons(client->ip_info.dst_port);
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &sock_addr;
+        msg.msg_namelen = sizeof(sock_addr);
+        msg.msg_iov = (struct iovec *)iov;
+        msg.msg_iovlen = iovcnt;
+        ret = lwip_sendmsg(client->fd, &msg, 0);
+        out = ret;
+    } else if (conn_type_ssl == client->type) {
+        for (i = 0; i < iovcnt; i++) {
+            ret = trs_tls_conn_write(client->priv.tcp.tls, iov[i].iov_base, iov[i].iov_len);
+            if (ret < 0) {
+                if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                    ret = 0;
+                }
+                break;
+            }
+            out += ret;
+            if ((size_t)ret < iov[i].iov_len) {
+                break;
+            }
+        }
+    }
+
+    if (ret < 0) {
+        os_printf(LM_APP, LL_INFO, "passthrough send failed.[ret:%d]..\n", ret);
+        if (conn_type_ssl == client->type) {
+            trs_tls_conn_delete(client->priv.tcp.tls);
+        } else {
+            close(client->fd);
+        }
+        client->fd = -1;
+        client->state = conn_stat_abort;
+        return -1;
+    }
+
+    return out;
+}
+
+static void at_net_pt_exit(void *ctx, at_pt_exit_e reason)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+
+    if (AT_PT_EXIT_ESCAPE == reason) {
+        at_net_exit_pass_through((unsigned char *)"+++", 0);
+    } else if (AT_PT_EXIT_ERROR == reason) {
+        //the link failed under the dma engine, leave passthrough instead of retrying out of the ring
+        at_net_abort_uart_rx();
+        if (pdPASS != xTimerStop(cfg->reconnect_interval_times, 0)) {
+            os_printf(LM_APP, LL_INFO, "stop client reconnet intervel timer fialed...\n");
+        }
+        dce_emit_extended_result_code((dce_t*)target_dce_get(), "CLOSED", -1, 1);
+        at_net_client_close(cfg->send_buff.client);
+    }
+}
+
+static int at_net_pt_start(void)
+{
+    at_pt_sink_t sink = {
+        .sendv   = at_net_pt_sendv,
+        .on_exit = at_net_pt_exit,
+        .ctx     = NULL,
+    };
+
+    return at_pt_start(at_pt_uart_port(), &sink);
+}
+#endif
+
 int at_net_client_prepare_tx(client_db_t *client)
 {
     net_conn_cfg_t *cfg = get_net_conn_cfg();
@@ -1420,6 +1529,16 @@ int at_net_client_prepare_tx(client_db_t *client)
         
     dce_register_data_input_cb(at_net_handle_data_from_target);
 
+#ifdef CONFIG_AT_PASSTHROUGH_DMA
+    if (cfg->pass_through && !cfg->ipmux && !at_net_pt_start()) {
+        if (pdPASS != xTimerStart(cfg->reconnect_interval_times, 0)) {
+            os_printf(LM_APP, LL_INFO, "start client reconnect interval timer fialed...\n");
+        }
+        target_dec_switch_input_state(TCP_ONLINE_DATA_STATE);
+        return 0;
+    }
+#endif
+
     if (cfg->pass_through) {
         if ((pdPASS != xTimerStart(cfg->uart_rx_timeout, 0)) || (pdPASS != xTimerStart(cfg->reconnect_interval_times, 0))) {
             os_printf(LM_APP, LL_INFO, "start uart rx or client reconnect interval timer fialed...\n");
@@ -1806,6 +1925,96 @@ NET_POLL_RET at_net_poll(dce_t* dce)
 
 #else
 
+#ifdef CONFIG_AT_MUX_DATA
+static void at_net_mux_tx(void *ctx, const unsigned char *buf, unsigned int len)
+{
+    target_dce_transmit((const char *)buf, len);
+}
+
+//entering or leaving mux mode swaps the per-link rings for the shared pool, so no link may be open
+int at_net_set_mux_mode(int enable)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+    at_mux_out_t out = {
+        .tx  = at_net_mux_tx,
+        .ctx = NULL,
+    };
+    int link_id;
+
+    if (!enable == (AT_RECV_MODE_MUX != cfg->recv_mode)) {
+        return 0;
+    }
+
+    if (enable && !cfg->ipmux) {
+        return 1;
+    }
+
+    for (link_id = 0; link_id < MAX_CONN_NUM; link_id++) {
+        if (at_net_find_client(link_id)) {
+            return 1;
+        }
+    }
+
+    if (enable) {
+        return at_mux_open(&out) ? 1 : 0;
+    }
+
+    at_mux_close();
+    return 0;
+}
+
+//receive straight into shared pool blocks, the at_mux task frames them out to the host
+//returns bytes received, MBEDTLS_ERR_SSL_WANT_READ when the pool had no room, else what the read returned
+static int at_net_mux_client_recv(client_db_t *client)
+{
+    net_conn_cfg_t *cfg = get_net_conn_cfg();
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    unsigned char *buf;
+    int len, total = 0;
+
+    do {
+        buf = at_mux_rx_buf(client->id);
+        if (!buf) {
+            //another link took the room since select, the data waits for the next poll
+            return total ? total : MBEDTLS_ERR_SSL_WANT_READ;
+        }
+
+        if (conn_type_ssl == client->type) {
+            len = trs_tls_conn_read(client->priv.tcp.tls, buf, CONFIG_AT_MUX_BLOCK_SIZE);
+            at_mux_rx_commit(client->id, (len > 0) ? len : 0);
+        } else {
+            //recvfrom as the non mux path: with remote_visible the frame carries the sender
+            fromlen = sizeof(from);
+            len = recvfrom(client->fd, buf, CONFIG_AT_MUX_BLOCK_SIZE, 0, (struct sockaddr *)&from, &fromlen);
+            if (len > 0 && cfg->remote_visible) {
+                at_mux_rx_commit_from(client->id, len, from.sin_addr.s_addr, ntohs(from.sin_port));
+            } else {
+                at_mux_rx_commit(client->id, (len > 0) ? len : 0);
+            }
+        }
+
+        if (len <= 0) {
+            return total ? total : len;
+        }
+        total += len;
+    } while (conn_type_ssl == client->type && trs_tls_get_bytes_avail(client->priv.tcp.tls));
+
+    return total;
+}
+#endif
+
+//a link whose data has nowhere to go stays out of select, its peer is held off by tcp flow control
+static int at_net_client_rx_ready(net_conn_cfg_t *cfg, client_db_t *client)
+{
+#ifdef CONFIG_AT_MUX_DATA
+    if (AT_RECV_MODE_MUX == cfg->recv_mode) {
+        return at_mux_rx_room(client->id) ? 1 : 0;
+    }
+#endif
+    return 1;
+}
+
 NET_POLL_RET at_net_poll(dce_t* dce)
 {
     int ret = 0;
@@ -1832,7 +2041,7 @@ NET_POLL_RET at_net_poll(dce_t* dce)
     	if (!list_empty(&server->client_list))
     	{
         list_for_each_entry_safe(client, client_tmp, &server->client_list, list) {
-            if (conn_stat_connected == client->state) {
+            if (conn_stat_connected == client->state && at_net_client_rx_ready(cfg, client)) {
                 FD_SET(client->fd, &reads);
                 fd_max = fd_max < client->fd ? client->fd : fd_max;
             }
@@ -1845,7 +2054,7 @@ NET_POLL_RET at_net_poll(dce_t* dce)
     if (!list_empty(&cfg->client_list))
     {
     list_for_each_entry_safe(client, client_tmp, &cfg->client_list, list) {
-        if (conn_stat_connected == client->state) {
+        if (conn_stat_connected == client->state && at_net_client_rx_ready(cfg, client)) {
             FD_SET(client->fd, &reads);
             fd_max = fd_max < client->fd ? client->fd : fd_max;
         }
@@ -1934,6 +2143,11 @@ NET_POLL_RET at_net_poll(dce_t* dce)
                     continue;
                 }
 
+#ifdef CONFIG_AT_MUX_DATA
+				at_mux_link_reset(client->id);
+				if (AT_RECV_MODE_MUX != cfg->recv_mode)
+#endif
+				{
 				cfg->recv_buff.recv_data[client->id] = malloc(sizeof(conn_recv_data_t));
 				if (NULL == cfg->recv_buff.recv_data[client->id])
 				{
@@ -1948,6 +2162,7 @@ NET_POLL_RET at_net_poll(dce_t* dce)
 				cfg->recv_buff.recv_data[client->id]->write_pos = 0;
 				cfg->recv_buff.recv_data[client->id]->read_len = 0;
 				cfg->recv_buff.recv_data[client->id]->write_len = AT_MAX_RECV_DATA_LEN;
+				}
 
                 client->father = server;
 				client->ip_info.dst_port = server->ip_info.src_port;
@@ -2014,7 +2229,7 @@ NET_POLL_RET at_net_poll(dce_t* dce)
                     continue;
                 }
 
-                if (client->type == conn_type_tcp) {
+                if (client->type == conn_type_tcp && cfg->recv_buff.recv_data[client->id]) {
                     if (cfg->recv_buff.recv_data[client->id]->write_len == 0) {
                         struct netconn *netinfo = NULL;
                         socklen_t infolen = sizeof(struct netconn *);
@@ -2032,6 +2247,14 @@ NET_POLL_RET at_net_poll(dce_t* dce)
                 }
 
                 int len = 0;
+#ifdef CONFIG_AT_MUX_DATA
+                if (AT_RECV_MODE_MUX == cfg->recv_mode) {
+                    len = at_net_mux_client_recv(client);
+                    if (len == MBEDTLS_ERR_SSL_WANT_WRITE  || len == MBEDTLS_ERR_SSL_WANT_READ) {
+                        continue;
+                    }
+                } else
+#endif
                 if (conn_type_ssl == client->type) {
                     len = trs_tls_conn_read(client->priv.tcp.tls, &cfg->recv_buff.buff[client->id][0], read_len);
                     if(len > 0){
@@ -2096,7 +2319,7 @@ AT_NET_CLOSE:
 				else 
 				{
                     client->rx_timestamp = xTaskGetTickCount();
-                    if(client->type != conn_type_ssl){
+                    if(client->type != conn_type_ssl && AT_RECV_MODE_MUX != cfg->recv_mode){
                         rf.clientAddr = clientAddr;
                         rf.rx_len = len;
                         at_rx_show_client_data(dce,&rf,client);
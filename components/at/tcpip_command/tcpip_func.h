@@ -16,6 +16,8 @@
 #define MAX_TCP_SEQ_STATE_SIZE 32
 #define AT_UDP_MIN_PORT				0xc000
 #define AT_UDP_MAX_PORT				0xffff
+//AT+CIPRECVMODE=<mode>, 0 active and 1 passive
+#define AT_RECV_MODE_MUX			2
 typedef enum {
     conn_type_udp,
     conn_type_tcp,
@@ -132,6 +134,9 @@ void at_net_server_stop(server_db_t *server_param);
 
 int at_net_close(int link_id);
 int at_net_abort_uart_rx(void);
+#ifdef CONFIG_AT_MUX_DATA
+int at_net_set_mux_mode(int enable);
+#endif
 void at_net_iterate_client(client_iterate_cb func, void *in, void *out);
 int at_net_client_auto_start(void);
 
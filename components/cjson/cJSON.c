@@ -104,8 +104,8 @@ void cJSON_Delete(cJSON *c)
 	}
 }
 
-/* Parse the input text to generate a number, and populate the result into item. */
-static const char *parse_number(cJSON *item,const char *num)
+/* Scan the number text at num into *out, return the first byte after it. */
+const char *cJSON_ScanNumber(const char *num,double *out)
 {
 	double n=0,sign=1,scale=0;int subscale=0,signsubscale=1;
 
@@ -118,8 +118,16 @@ static const char *parse_number(cJSON *item,const char *num)
 		while (*num>='0' && *num<='9') subscale=(subscale*10)+(*num++ - '0');	/* Number? */
 	}
 
-	n=sign*n*pow(10.0,(scale+subscale*signsubscale));	/* number = +/- number.fraction * 10^+/- exponent */
-	
+	*out=sign*n*pow(10.0,(scale+subscale*signsubscale));	/* number = +/- number.fraction * 10^+/- exponent */
+	return num;
+}
+
+/* Parse the input text to generate a number, and populate the result into item. */
+static const char *parse_number(cJSON *item,const char *num)
+{
+	double n;
+
+	num=cJSON_ScanNumber(num,&n);
 	item->valuedouble=n;
 	item->valueint=(int)n;
 	item->type=cJSON_Number;
@@ -155,38 +163,39 @@ static int update(printbuffer *p)
 	return p->offset+strlen(str);
 }
 
+/* Render d the way print_number does into str (at least 64 bytes), return its length. */
+int cJSON_FormatNumber(char *str,double d)
+{
+	if (d==0)	return sprintf(str,"0");
+	if (d<=INT_MAX && d>=INT_MIN && fabs(((double)(int)d)-d)<=DBL_EPSILON)	return sprintf(str,"%d",(int)d);
+    #if 0
+	if (fpclassify(d) != FP_ZERO && !isnormal(d))				return sprintf(str,"null");
+	else if (fabs(floor(d)-d)<=DBL_EPSILON && fabs(d)<1.0e60)	return sprintf(str,"%.0f",d);
+	else if (fabs(d)<1.0e-6 || fabs(d)>1.0e9)					return sprintf(str,"%e",d);
+	else														return sprintf(str,"%f",d);
+    #else
+	if (d<0)	{*str='-';return 1+cJSON_FormatNumber(str+1,-d);}	/* -0.5 is "-0.5", not "0.-5" */
+	return sprintf(str,"%d.%d", (int)d, (int)((d - (int)d)*10));
+    #endif
+}
+
 /* Render the number nicely from the given item into a string. */
 static char *print_number(cJSON *item,printbuffer *p)
 {
 	char *str=0;
 	double d=item->valuedouble;
-	if (d==0)
-	{
-		if (p)	str=ensure(p,2);
-		else	str=(char*)cJSON_malloc(2);	/* special case for 0. */
-		if (str) strcpy(str,"0");
-	}
-	else if (fabs(((double)item->valueint)-d)<=DBL_EPSILON && d<=INT_MAX && d>=INT_MIN)
-	{
-		if (p)	str=ensure(p,21);
-		else	str=(char*)cJSON_malloc(21);	/* 2^64+1 can be represented in 21 chars. */
-		if (str)	sprintf(str,"%d",item->valueint);
-	}
-	else
+	int size=64;	/* This is a nice tradeoff. */
+
+	if (d==0)	size=2;	/* special case for 0. */
+	else if (fabs(((double)item->valueint)-d)<=DBL_EPSILON && d<=INT_MAX && d>=INT_MIN)	size=21;	/* 2^64+1 can be represented in 21 chars. */
+
+	if (p)	str=ensure(p,size);
+	else	str=(char*)cJSON_malloc(size);
+	if (str)
 	{
-		if (p)	str=ensure(p,64);
-		else	str=(char*)cJSON_malloc(64);	/* This is a nice tradeoff. */
-		if (str)
-		{
-		    #if 0
-			if (fpclassify(d) != FP_ZERO && !isnormal(d))				sprintf(str,"null");
-			else if (fabs(floor(d)-d)<=DBL_EPSILON && fabs(d)<1.0e60)	sprintf(str,"%.0f",d);
-			else if (fabs(d)<1.0e-6 || fabs(d)>1.0e9)					sprintf(str,"%e",d);
-			else														sprintf(str,"%f",d);
-            #else
-			sprintf(str,"%d.%d", (int)d, (int)((d - (int)d)*10));
-            #endif
-		}
+		char tmp[64];
+		int len=cJSON_FormatNumber(tmp,d);
+		memcpy(str,tmp,len+1);
 	}
 	return str;
 }
@@ -208,21 +217,23 @@ static unsigned parse_hex4(const char *str)
 static const unsigned char firstByteMark[7] = { 0x00, 0x00, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC };
 static const char *parse_string(cJSON *item,const char *str)
 {
-	const char *ptr=str+1;char *ptr2;char *out;int len=0;unsigned uc,uc2;
+	const char *ptr=str+1,*end;char *ptr2;char *out;int len=0;unsigned uc,uc2;
 	if (*str!='\"') {ep=str;return 0;}	/* not a string! */
 	
-	while (*ptr!='\"' && *ptr && ++len) if (*ptr++ == '\\') ptr++;	/* Skip escaped quotes. */
+	while (*ptr!='\"' && *ptr && ++len) if (*ptr++ == '\\' && *ptr) ptr++;	/* Skip escaped quotes. */
+	end=ptr;	/* escapes must not read past here, nor write past len */
 	
 	out=(char*)cJSON_malloc(len+1);	/* This is how long we need for the string, roughly. */
 	if (!out) return 0;
 	
 	ptr=str+1;ptr2=out;
-	while (*ptr!='\"' && *ptr)
+	while (ptr<end)
 	{
 		if (*ptr!='\\') *ptr2++=*ptr++;
 		else
 		{
 			ptr++;
+			if (ptr==end) break;	/* a lone \ at the very end. */
 			switch (*ptr)
 			{
 				case 'b': *ptr2++='\b';	break;
@@ -231,13 +242,14 @@ static const char *parse_string(cJSON *item,const char *str)
 				case 'r': *ptr2++='\r';	break;
 				case 't': *ptr2++='\t';	break;
 				case 'u':	 /* transcode utf16 to utf8. */
+					if (end-ptr<5)	{cJSON_free(out);ep=str;return 0;}	/* cut short. */
 					uc=parse_hex4(ptr+1);ptr+=4;	/* get the unicode char. */
 
 					if ((uc>=0xDC00 && uc<=0xDFFF) || uc==0)	break;	/* check for invalid.	*/
 
 					if (uc>=0xD800 && uc<=0xDBFF)	/* UTF16 surrogate pairs.	*/
 					{
-						if (ptr[1]!='\\' || ptr[2]!='u')	break;	/* missing second-half of surrogate.	*/
+						if (end-ptr<7 || ptr[1]!='\\' || ptr[2]!='u')	break;	/* missing second-half of surrogate.	*/
 						uc2=parse_hex4(ptr+3);ptr+=6;
 						if (uc2<0xDC00 || uc2>0xDFFF)		break;	/* invalid second-half of surrogate.	*/
 						uc=0x10000 + (((uc&0x3FF)<<10) | (uc2&0x3FF));
@@ -132,6 +132,10 @@ extern cJSON *cJSON_ParseWithOpts(const char *value,const char **return_parse_en
 
 extern void cJSON_Minify(char *json);
 
+/* Number text in and out the way the parser and the printers see it, shared with json_stream. */
+extern const char *cJSON_ScanNumber(const char *num,double *out);
+extern int cJSON_FormatNumber(char *str,double d);	/* str holds at least 64 bytes, returns the length */
+
 /* Macros for creating things quickly. */
 #define cJSON_AddNullToObject(object,name)		cJSON_AddItemToObject(object, name, cJSON_CreateNull())
 #define cJSON_AddTrueToObject(object,name)		cJSON_AddItemToObject(object, name, cJSON_CreateTrue())
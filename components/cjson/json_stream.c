@@ -0,0 +1,752 @@
+/*
+ * Streaming JSON reader and writer, see json_stream.h.
+ *
+ * The reader is a byte at a time state machine: <expect> is where the
+ * grammar stands between tokens, <lex> the string, number or literal being
+ * read across as many pieces of input as it takes. A number only ends at
+ * the first byte that cannot be part of it, which is left for the grammar,
+ * or at json_reader_end().
+ */
+#include <string.h>
+#include <stdio.h>
+#include "cJSON.h"
+#include "json_stream.h"
+
+enum {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_CLOSE,          /* after [ */
+    EXPECT_KEY,
+    EXPECT_KEY_OR_CLOSE,            /* after { */
+    EXPECT_COLON,
+    EXPECT_NEXT,                    /* , or the close */
+    EXPECT_DONE,
+};
+
+enum {
+    LEX_NONE,
+    LEX_STRING,
+    LEX_KEY,
+    LEX_NUMBER,
+    LEX_WORD,
+};
+
+enum {
+    STR_CHAR,
+    STR_ESCAPE,
+    STR_HEX,                        /* 4 of them, STR_HEX + digits seen */
+    STR_LOW_ESCAPE = STR_HEX + 4,   /* \ of the second half of a surrogate pair */
+    STR_LOW_U,
+    STR_LOW_HEX,
+};
+
+enum {
+    NUM_MINUS,
+    NUM_ZERO,
+    NUM_INT,
+    NUM_DOT,
+    NUM_FRAC,
+    NUM_E,
+    NUM_E_SIGN,
+    NUM_EXP,
+};
+
+static const struct {
+    const char      *text;
+    json_token_t    token;
+} _json_words[] = {
+    { "true", JSON_TOKEN_TRUE },
+    { "false", JSON_TOKEN_FALSE },
+    { "null", JSON_TOKEN_NULL },
+};
+
+void json_reader_init(json_reader_t *r, char *scratch, unsigned int scratch_size)
+{
+    memset(r, 0, sizeof(*r));
+    r->scratch = scratch;
+    r->scratch_size = scratch_size;
+    r->expect = EXPECT_VALUE;
+}
+
+/* <data> has to stay put until json_reader_next() asked for more */
+void json_reader_feed(json_reader_t *r, const void *data, unsigned int len)
+{
+    r->in = data;
+    r->in_len = len;
+    r->in_pos = 0;
+}
+
+void json_reader_end(json_reader_t *r)
+{
+    r->ended = 1;
+}
+
+static json_token_t _json_reader_error(json_reader_t *r)
+{
+    r->error = 1;
+    return JSON_TOKEN_ERROR;
+}
+
+static void _json_path_put(json_reader_t *r, char c)
+{
+    if (r->path_over)
+        return;
+    if (r->path_len + 2u > sizeof(r->path)) {
+        r->path_over = r->depth;
+        return;
+    }
+    r->path[r->path_len++] = c;
+    r->path[r->path_len] = 0;
+}
+
+/* back to the path of the innermost container, for its next member */
+static void _json_path_cut(json_reader_t *r)
+{
+    r->path_len = r->base[r->depth - 1];
+    r->path[r->path_len] = 0;
+    if (r->path_over >= r->depth)
+        r->path_over = 0;
+}
+
+/* the path of a value about to start, array elements are known by index */
+static void _json_path_value(json_reader_t *r)
+{
+    char index[12];
+    unsigned int i, n;
+
+    if (r->depth == 0 || r->object[r->depth - 1])
+        return;
+    _json_path_cut(r);
+    _json_path_put(r, '/');
+    for (i = r->index[r->depth - 1], n = 0; n == 0 || i; i /= 10, n++)
+        index[n] = '0' + i % 10;
+    while (n)
+        _json_path_put(r, index[--n]);
+}
+
+static int _json_scratch_put(json_reader_t *r, unsigned char c)
+{
+    if (r->len + 1 >= r->scratch_size) {
+        r->truncated = 1;
+        return -1;
+    }
+    r->scratch[r->len++] = c;
+    return 0;
+}
+
+/* a byte of the unescaped string, keys go into the path too */
+static void _json_string_put(json_reader_t *r, unsigned char c)
+{
+    _json_scratch_put(r, c);
+    if (r->lex == LEX_KEY) {
+        if (c == '~' || c == '/') {
+            _json_path_put(r, '~');
+            c = (c == '~') ? '0' : '1';
+        }
+        _json_path_put(r, c);
+    }
+}
+
+static void _json_string_utf8(json_reader_t *r, unsigned int uc)
+{
+    if (uc < 0x80) {
+        _json_string_put(r, uc);
+    } else if (uc < 0x800) {
+        _json_string_put(r, 0xc0 | (uc >> 6));
+        _json_string_put(r, 0x80 | (uc & 0x3f));
+    } else if (uc < 0x10000) {
+        _json_string_put(r, 0xe0 | (uc >> 12));
+        _json_string_put(r, 0x80 | ((uc >> 6) & 0x3f));
+        _json_string_put(r, 0x80 | (uc & 0x3f));
+    } else {
+        _json_string_put(r, 0xf0 | (uc >> 18));
+        _json_string_put(r, 0x80 | ((uc >> 12) & 0x3f));
+        _json_string_put(r, 0x80 | ((uc >> 6) & 0x3f));
+        _json_string_put(r, 0x80 | (uc & 0x3f));
+    }
+}
+
+static int _json_hex(unsigned char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* a string byte that stands for itself, in the path too */
+static int _json_plain(const json_reader_t *r, unsigned char c)
+{
+    return c >= 0x20 && c != '"' && c != '\\' && !(r->lex == LEX_KEY && (c == '~' || c == '/'));
+}
+
+/* the plain byte just taken and the run of them after it, straight into scratch (and path) */
+static void _json_string_plain(json_reader_t *r)
+{
+    const unsigned char *start = r->in + r->in_pos - 1, *p = r->in + r->in_pos, *end = r->in + r->in_len;
+    unsigned int n, room = r->scratch_size - 1 - r->len;
+
+    while (p < end && _json_plain(r, *p))
+        p++;
+    r->in_pos = p - r->in;
+    n = p - start;
+
+    if (r->lex == LEX_KEY) {
+        if (!r->path_over && r->path_len + n < sizeof(r->path)) {
+            memcpy(r->path + r->path_len, start, n);
+            r->path_len += n;
+            r->path[r->path_len] = 0;
+        } else {
+            for (p = start; p < start + n; p++)
+                _json_path_put(r, *p);
+        }
+    }
+
+    if (n > room) {
+        n = room;
+        r->truncated = 1;
+    }
+    memcpy(r->scratch + r->len, start, n);
+    r->len += n;
+}
+
+/* 1 at the closing quote, 0 to go on, -1 when broken */
+static int _json_string_char(json_reader_t *r, unsigned char c)
+{
+    static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+    const char *e;
+    int h;
+
+    switch (r->lex_state) {
+    case STR_CHAR:
+        if (c == '"')
+            return 1;
+        if (c == '\\')
+            r->lex_state = STR_ESCAPE;
+        else if (c < 0x20)
+            return -1;
+        else
+            _json_string_put(r, c);
+        return 0;
+
+    case STR_ESCAPE:
+        if (c == 'u') {
+            r->ucs = 0;
+            r->lex_state = STR_HEX;
+            return 0;
+        }
+        for (e = escapes; *e && *e != c; e += 2)
+            ;
+        if (*e == 0)
+            return -1;
+        _json_string_put(r, e[1]);
+        r->lex_state = STR_CHAR;
+        return 0;
+
+    case STR_LOW_ESCAPE:
+        r->lex_state = STR_LOW_U;
+        return (c == '\\') ? 0 : -1;
+
+    case STR_LOW_U:
+        r->lex_state = STR_LOW_HEX;
+        r->ucs = 0;
+        return (c == 'u') ? 0 : -1;
+
+    default:
+        if ((h = _json_hex(c)) < 0)
+            return -1;
+        r->ucs = (r->ucs << 4) | h;
+        if (++r->lex_state != STR_HEX + 4 && r->lex_state != STR_LOW_HEX + 4)
+            return 0;
+        if (r->lex_state == STR_LOW_HEX + 4) {
+            if (r->ucs < 0xdc00 || r->ucs > 0xdfff)
+                return -1;
+            _json_string_utf8(r, 0x10000 + (((r->high & 0x3ff) << 10) | (r->ucs & 0x3ff)));
+        } else if (r->ucs >= 0xd800 && r->ucs <= 0xdbff) {
+            r->high = r->ucs;
+            r->lex_state = STR_LOW_ESCAPE;
+            return 0;
+        } else if (r->ucs >= 0xdc00 && r->ucs <= 0xdfff) {
+            return -1;
+        } else {
+            _json_string_utf8(r, r->ucs);
+        }
+        r->lex_state = STR_CHAR;
+        return 0;
+    }
+}
+
+/* 1 when <c> carries the number on */
+static int _json_number_char(json_reader_t *r, unsigned char c)
+{
+    int digit = (c >= '0' && c <= '9');
+    int next;
+
+    switch (r->lex_state) {
+    case NUM_MINUS:
+        next = (c == '0') ? NUM_ZERO : digit ? NUM_INT : -1;
+        break;
+    case NUM_ZERO:
+    case NUM_INT:
+    case NUM_FRAC:
+        if (digit && r->lex_state != NUM_ZERO)
+            next = r->lex_state;
+        else if (c == '.' && r->lex_state != NUM_FRAC)
+            next = NUM_DOT;
+        else if (c == 'e' || c == 'E')
+            next = NUM_E;
+        else
+            next = -1;
+        break;
+    case NUM_DOT:
+        next = digit ? NUM_FRAC : -1;
+        break;
+    case NUM_E:
+        next = (c == '+' || c == '-') ? NUM_E_SIGN : digit ? NUM_EXP : -1;
+        break;
+    default:
+        next = digit ? NUM_EXP : -1;
+        break;
+    }
+    if (next < 0)
+        return 0;
+    r->lex_state = next;
+    return 1;
+}
+
+static json_token_t _json_number_done(json_reader_t *r)
+{
+    r->lex = LEX_NONE;
+    if (r->lex_state == NUM_MINUS || r->lex_state == NUM_DOT || r->lex_state == NUM_E || r->lex_state == NUM_E_SIGN)
+        return _json_reader_error(r);
+    if (r->truncated)       /* no value without all the digits */
+        return _json_reader_error(r);
+    r->scratch[r->len] = 0;
+    cJSON_ScanNumber(r->scratch, &r->number);
+    return JSON_TOKEN_NUMBER;
+}
+
+static json_token_t _json_value_done(json_reader_t *r, json_token_t t)
+{
+    r->expect = r->depth ? EXPECT_NEXT : EXPECT_DONE;
+    return t;
+}
+
+static json_token_t _json_open(json_reader_t *r, int object)
+{
+    if (r->depth == JSON_STREAM_MAX_DEPTH)
+        return _json_reader_error(r);
+    r->object[r->depth] = object;
+    r->index[r->depth] = 0;
+    r->base[r->depth] = r->path_len;
+    r->depth++;
+    r->expect = object ? EXPECT_KEY_OR_CLOSE : EXPECT_VALUE_OR_CLOSE;
+    return object ? JSON_TOKEN_OBJECT_BEGIN : JSON_TOKEN_ARRAY_BEGIN;
+}
+
+static json_token_t _json_close(json_reader_t *r, unsigned char c)
+{
+    int object = r->object[r->depth - 1];
+
+    if (c != (object ? '}' : ']'))
+        return _json_reader_error(r);
+    _json_path_cut(r);
+    r->depth--;
+    return _json_value_done(r, object ? JSON_TOKEN_OBJECT_END : JSON_TOKEN_ARRAY_END);
+}
+
+static void _json_lex_begin(json_reader_t *r, int lex, int state)
+{
+    r->lex = lex;
+    r->lex_state = state;
+    r->len = 0;
+    r->truncated = 0;
+}
+
+/* the first byte of a value */
+static json_token_t _json_value(json_reader_t *r, unsigned char c)
+{
+    unsigned int i;
+
+    _json_path_value(r);
+    if (c == '{' || c == '[')
+        return _json_open(r, c == '{');
+    if (c == '"') {
+        _json_lex_begin(r, LEX_STRING, STR_CHAR);
+        return JSON_TOKEN_MORE;
+    }
+    if (c == '-' || (c >= '0' && c <= '9')) {
+        _json_lex_begin(r, LEX_NUMBER, NUM_MINUS);
+        if (c != '-')
+            _json_number_char(r, c);
+        _json_scratch_put(r, c);
+        return JSON_TOKEN_MORE;
+    }
+    for (i = 0; i < sizeof(_json_words) / sizeof(_json_words[0]); i++) {
+        if (c == _json_words[i].text[0]) {
+            _json_lex_begin(r, LEX_WORD, 1);
+            r->word = i;
+            return JSON_TOKEN_MORE;
+        }
+    }
+    return _json_reader_error(r);
+}
+
+/* one byte outside of strings, numbers and literals */
+static json_token_t _json_grammar(json_reader_t *r, unsigned char c)
+{
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        return JSON_TOKEN_MORE;
+
+    switch (r->expect) {
+    case EXPECT_VALUE_OR_CLOSE:
+        if (c == ']')
+            return _json_close(r, c);
+        /* fall through */
+    case EXPECT_VALUE:
+        return _json_value(r, c);
+
+    case EXPECT_KEY_OR_CLOSE:
+        if (c == '}')
+            return _json_close(r, c);
+        /* fall through */
+    case EXPECT_KEY:
+        if (c != '"')
+            return _json_reader_error(r);
+        _json_path_cut(r);
+        _json_path_put(r, '/');
+        _json_lex_begin(r, LEX_KEY, STR_CHAR);
+        return JSON_TOKEN_MORE;
+
+    case EXPECT_COLON:
+        if (c != ':')
+            return _json_reader_error(r);
+        r->expect = EXPECT_VALUE;
+        return JSON_TOKEN_MORE;
+
+    case EXPECT_NEXT:
+        if (c != ',')
+            return _json_close(r, c);
+        if (r->object[r->depth - 1]) {
+            r->expect = EXPECT_KEY;
+        } else {
+            r->index[r->depth - 1]++;
+            r->expect = EXPECT_VALUE;
+        }
+        return JSON_TOKEN_MORE;
+
+    default:
+        return _json_reader_error(r);
+    }
+}
+
+static json_token_t _json_reader_step(json_reader_t *r)
+{
+    json_token_t t;
+    unsigned char c;
+    int res;
+
+    if (r->error)
+        return JSON_TOKEN_ERROR;
+
+    while (r->in_pos < r->in_len) {
+        c = r->in[r->in_pos];
+
+        if (r->lex == LEX_NUMBER) {
+            if (_json_number_char(r, c)) {
+                r->in_pos++;
+                if (_json_scratch_put(r, c) < 0)
+                    return _json_number_done(r);
+                continue;
+            }
+            return _json_value_done(r, _json_number_done(r));
+        }
+
+        r->in_pos++;
+        if (r->lex == LEX_STRING || r->lex == LEX_KEY) {
+            if (r->lex_state == STR_CHAR && _json_plain(r, c)) {
+                _json_string_plain(r);
+                continue;
+            }
+            if ((res = _json_string_char(r, c)) < 0)
+                return _json_reader_error(r);
+            if (res == 0)
+                continue;
+            r->scratch[r->len] = 0;
+            if (r->lex == LEX_KEY) {
+                r->lex = LEX_NONE;
+                r->expect = EXPECT_COLON;
+                return JSON_TOKEN_KEY;
+            }
+            r->lex = LEX_NONE;
+            return _json_value_done(r, JSON_TOKEN_STRING);
+        }
+
+        if (r->lex == LEX_WORD) {
+            if (c != (unsigned char)_json_words[r->word].text[r->lex_state])
+                return _json_reader_error(r);
+            if (_json_words[r->word].text[++r->lex_state])
+                continue;
+            r->lex = LEX_NONE;
+            return _json_value_done(r, _json_words[r->word].token);
+        }
+
+        if ((t = _json_grammar(r, c)) != JSON_TOKEN_MORE)
+            return t;
+    }
+
+    if (!r->ended)
+        return JSON_TOKEN_MORE;
+    if (r->lex == LEX_NUMBER)
+        return _json_value_done(r, _json_number_done(r));
+    if (r->lex != LEX_NONE || r->expect != EXPECT_DONE)
+        return _json_reader_error(r);
+    return JSON_TOKEN_END;
+}
+
+/*
+ * The next token; with all input used up JSON_TOKEN_MORE until
+ * json_reader_end(), then JSON_TOKEN_END when the document was complete.
+ */
+json_token_t json_reader_next(json_reader_t *r)
+{
+    json_token_t t;
+
+    for (;;) {
+        t = _json_reader_step(r);
+        if (!r->skip || t <= JSON_TOKEN_END)
+            return t;
+        if (r->depth < r->skip)
+            r->skip = 0;
+    }
+}
+
+/*
+ * Pass over everything up to and including the end of the innermost open
+ * container: right after a begin token that is the container just opened.
+ */
+void json_reader_skip(json_reader_t *r)
+{
+    r->skip = r->depth;
+}
+
+/* whether the value (or key) just read sits at <pointer> */
+int json_reader_match(const json_reader_t *r, const char *pointer)
+{
+    return !r->path_over && strncmp(pointer, r->path, r->path_len) == 0 && pointer[r->path_len] == 0;
+}
+
+/* JSON pointer of the value just read, cut short when it did not fit */
+const char *json_reader_path(const json_reader_t *r)
+{
+    return r->path;
+}
+
+/*
+ * Every field of <doc> asked for in one pass; the number found, -1 when the
+ * document is broken. A string longer than JSON_EXTRACT_SCRATCH_SIZE - 1 is
+ * cut there, the first of duplicate keys counts.
+ */
+int json_extract(const char *doc, unsigned int len, json_field_t *fields, int count)
+{
+    char scratch[JSON_EXTRACT_SCRATCH_SIZE];
+    json_reader_t r;
+    json_token_t t;
+    unsigned int n;
+    int i, found = 0;
+
+    for (i = 0; i < count; i++)
+        fields[i].token = JSON_TOKEN_END;
+
+    json_reader_init(&r, scratch, sizeof(scratch));
+    json_reader_feed(&r, doc, len);
+    json_reader_end(&r);
+    while ((t = json_reader_next(&r)) > JSON_TOKEN_END) {
+        if (t == JSON_TOKEN_KEY || t == JSON_TOKEN_OBJECT_END || t == JSON_TOKEN_ARRAY_END)
+            continue;
+        for (i = 0; i < count; i++) {
+            if (fields[i].token != JSON_TOKEN_END || !json_reader_match(&r, fields[i].pointer))
+                continue;
+            fields[i].token = t;
+            fields[i].number = r.number;
+            if (t == JSON_TOKEN_STRING && fields[i].str && fields[i].str_size) {
+                n = (r.len < fields[i].str_size) ? r.len : fields[i].str_size - 1;
+                memcpy(fields[i].str, r.scratch, n);
+                fields[i].str[n] = 0;
+            }
+            found++;
+        }
+    }
+    return (t == JSON_TOKEN_ERROR) ? -1 : found;
+}
+
+/*
+ * Without <flush> everything has to fit <buf>, which then ends up NUL
+ * terminated; with it <buf> goes out whenever full and at the finish.
+ */
+void json_writer_init(json_writer_t *w, char *buf, unsigned int size, json_flush_t flush, void *arg)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    w->flush = flush;
+    w->arg = arg;
+    w->first[0] = 1;
+}
+
+static void _json_write(json_writer_t *w, const char *data, unsigned int len)
+{
+    unsigned int n;
+
+    while (len && !w->error) {
+        if (w->len == w->size) {
+            if (!w->flush || w->flush(w->arg, w->buf, w->len) != 0) {
+                w->error = 1;
+                return;
+            }
+            w->len = 0;
+        }
+        n = (len < w->size - w->len) ? len : w->size - w->len;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        w->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+/* escaped the way cJSON's print_string_ptr does it */
+static void _json_write_string(json_writer_t *w, const char *s)
+{
+    const char *run;
+    char esc[8];
+
+    _json_write(w, "\"", 1);
+    while (s && *s) {
+        for (run = s; (unsigned char)*s > 31 && *s != '"' && *s != '\\'; s++)
+            ;
+        _json_write(w, run, s - run);
+        if (*s == 0)
+            break;
+        switch (*s) {
+        case '"':   strcpy(esc, "\\\""); break;
+        case '\\':  strcpy(esc, "\\\\"); break;
+        case '\b':  strcpy(esc, "\\b"); break;
+        case '\f':  strcpy(esc, "\\f"); break;
+        case '\n':  strcpy(esc, "\\n"); break;
+        case '\r':  strcpy(esc, "\\r"); break;
+        case '\t':  strcpy(esc, "\\t"); break;
+        default:    sprintf(esc, "\\u%04x", (unsigned char)*s); break;
+        }
+        _json_write(w, esc, strlen(esc));
+        s++;
+    }
+    _json_write(w, "\"", 1);
+}
+
+/* the comma and the key in front of a value */
+static void _json_write_member(json_writer_t *w, const char *key)
+{
+    if ((key != NULL) != w->object[w->depth] || (w->depth == 0 && !w->first[0])) {
+        w->error = 1;
+        return;
+    }
+    if (!w->first[w->depth])
+        _json_write(w, ",", 1);
+    w->first[w->depth] = 0;
+    if (key) {
+        _json_write_string(w, key);
+        _json_write(w, ":", 1);
+    }
+}
+
+static void _json_write_open(json_writer_t *w, const char *key, int object)
+{
+    _json_write_member(w, key);
+    if (w->depth == JSON_STREAM_MAX_DEPTH) {
+        w->error = 1;
+        return;
+    }
+    _json_write(w, object ? "{" : "[", 1);
+    w->depth++;
+    w->first[w->depth] = 1;
+    w->object[w->depth] = object;
+}
+
+static void _json_write_close(json_writer_t *w, int object)
+{
+    if (w->depth == 0 || w->object[w->depth] != object) {
+        w->error = 1;
+        return;
+    }
+    _json_write(w, object ? "}" : "]", 1);
+    w->depth--;
+}
+
+/* <key> inside objects, NULL in arrays and for the document itself */
+void json_writer_object_begin(json_writer_t *w, const char *key)
+{
+    _json_write_open(w, key, 1);
+}
+
+void json_writer_object_end(json_writer_t *w)
+{
+    _json_write_close(w, 1);
+}
+
+void json_writer_array_begin(json_writer_t *w, const char *key)
+{
+    _json_write_open(w, key, 0);
+}
+
+void json_writer_array_end(json_writer_t *w)
+{
+    _json_write_close(w, 0);
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    _json_write_member(w, key);
+    _json_write_string(w, value);
+}
+
+void json_writer_number(json_writer_t *w, const char *key, double value)
+{
+    char num[64];
+
+    _json_write_member(w, key);
+    _json_write(w, num, cJSON_FormatNumber(num, value));
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, int value)
+{
+    _json_write_member(w, key);
+    _json_write(w, value ? "true" : "false", value ? 4 : 5);
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    _json_write_member(w, key);
+    _json_write(w, "null", 4);
+}
+
+/* length of the whole document, -1 when it did not fit, a flush failed or it is not complete */
+int json_writer_finish(json_writer_t *w)
+{
+    if (w->depth || w->first[0])
+        w->error = 1;
+    if (!w->error && w->flush && w->len) {
+        if (w->flush(w->arg, w->buf, w->len) != 0)
+            w->error = 1;
+        w->len = 0;
+    }
+    if (!w->error && !w->flush) {
+        if (w->len == w->size)
+            w->error = 1;
+        else
+            w->buf[w->len] = 0;
+    }
+    return w->error ? -1 : (int)w->total;
+}
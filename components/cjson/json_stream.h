@@ -0,0 +1,138 @@
+/*
+ * JSON without the node tree: a pull reader that takes the document in
+ * pieces of any size and hands out one token at a time, and a writer that
+ * renders straight into a fixed buffer, flushing it to a socket or file
+ * whenever it fills up. Neither allocates.
+ *
+ * The reader keeps the JSON pointer (RFC 6901) of the value it is at, so
+ * fields are picked out by path while the document goes by:
+ *
+ *   json_reader_init(&r, scratch, sizeof(scratch));
+ *   json_reader_feed(&r, data, len);
+ *   while ((t = json_reader_next(&r)) > JSON_TOKEN_END)
+ *       if (t == JSON_TOKEN_NUMBER && json_reader_match(&r, "/state/desired/power"))
+ *           power = r.number;
+ *
+ * JSON_TOKEN_MORE asks for the next piece through json_reader_feed(), or
+ * json_reader_end() when there is none. Strings and keys come unescaped into
+ * the scratch buffer, cut short (and r.truncated set) when they do not fit;
+ * the path holds keys in full up to JSON_STREAM_PATH_SIZE. Numbers are read
+ * with cJSON's own code and the writer prints them with it too, so values
+ * and text come out as cJSON_Parse() and cJSON_PrintUnformatted() give them.
+ *
+ * Unlike cJSON the reader takes strict JSON only: no control characters in
+ * strings, no unknown escapes or lone surrogates, no leading zeros, nothing
+ * but white space after the value. Keys match case sensitively.
+ */
+#ifndef _JSON_STREAM_H_
+#define _JSON_STREAM_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH       16
+#endif
+#ifndef JSON_STREAM_PATH_SIZE
+#define JSON_STREAM_PATH_SIZE       128
+#endif
+#ifndef JSON_EXTRACT_SCRATCH_SIZE
+#define JSON_EXTRACT_SCRATCH_SIZE   128
+#endif
+
+typedef enum json_token {
+    JSON_TOKEN_ERROR = -1,          /* malformed, too deep; sticks until init */
+    JSON_TOKEN_MORE = 0,            /* all input used, feed the next piece */
+    JSON_TOKEN_END,                 /* the document is complete */
+    JSON_TOKEN_OBJECT_BEGIN,
+    JSON_TOKEN_OBJECT_END,
+    JSON_TOKEN_ARRAY_BEGIN,
+    JSON_TOKEN_ARRAY_END,
+    JSON_TOKEN_KEY,                 /* scratch, the path already ends in it */
+    JSON_TOKEN_STRING,              /* scratch */
+    JSON_TOKEN_NUMBER,              /* number */
+    JSON_TOKEN_TRUE,
+    JSON_TOKEN_FALSE,
+    JSON_TOKEN_NULL,
+} json_token_t;
+
+typedef struct json_reader {
+    const unsigned char *in;
+    unsigned int        in_len;
+    unsigned int        in_pos;
+    unsigned char       ended;
+    unsigned char       error;
+    unsigned char       expect;         /* what the grammar takes next */
+    unsigned char       lex;            /* inside a string, number or literal */
+    unsigned char       lex_state;
+    unsigned char       word;           /* true, false or null being read */
+    unsigned char       depth;
+    unsigned char       skip;           /* json_reader_skip(): done once below this depth */
+    unsigned char       path_over;      /* depth the path ran out of room at */
+    unsigned char       object[JSON_STREAM_MAX_DEPTH];  /* object or array at each depth */
+    unsigned int        index[JSON_STREAM_MAX_DEPTH];   /* of the array element */
+    unsigned short      base[JSON_STREAM_MAX_DEPTH];    /* path length of the container */
+    unsigned int        ucs;            /* \u escape being read */
+    unsigned int        high;           /* first half of a surrogate pair */
+    char                path[JSON_STREAM_PATH_SIZE];
+    unsigned short      path_len;
+
+    char                *scratch;
+    unsigned int        scratch_size;
+    unsigned int        len;            /* string bytes, as far as they went into scratch */
+    unsigned char       truncated;
+    double              number;
+} json_reader_t;
+
+void json_reader_init(json_reader_t *r, char *scratch, unsigned int scratch_size);
+void json_reader_feed(json_reader_t *r, const void *data, unsigned int len);
+void json_reader_end(json_reader_t *r);
+json_token_t json_reader_next(json_reader_t *r);
+void json_reader_skip(json_reader_t *r);
+int json_reader_match(const json_reader_t *r, const char *pointer);
+const char *json_reader_path(const json_reader_t *r);
+
+/* One field to pick out of a whole document with json_extract() */
+typedef struct json_field {
+    const char          *pointer;       /* "/state/reported/version", "/list/0" */
+    json_token_t        token;          /* what was there, JSON_TOKEN_END when nothing */
+    double              number;
+    char                *str;           /* strings are copied here when set */
+    unsigned int        str_size;
+} json_field_t;
+
+int json_extract(const char *doc, unsigned int len, json_field_t *fields, int count);
+
+typedef int (*json_flush_t)(void *arg, const char *data, unsigned int len);
+
+typedef struct json_writer {
+    char                *buf;
+    unsigned int        size;
+    unsigned int        len;
+    unsigned int        total;          /* bytes written, flushed ones included */
+    json_flush_t        flush;
+    void                *arg;
+    unsigned char       depth;
+    unsigned char       error;
+    unsigned char       first[JSON_STREAM_MAX_DEPTH + 1];   /* nothing written at this depth yet */
+    unsigned char       object[JSON_STREAM_MAX_DEPTH + 1];
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, unsigned int size, json_flush_t flush, void *arg);
+void json_writer_object_begin(json_writer_t *w, const char *key);
+void json_writer_object_end(json_writer_t *w);
+void json_writer_array_begin(json_writer_t *w, const char *key);
+void json_writer_array_end(json_writer_t *w);
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_number(json_writer_t *w, const char *key, double value);
+void json_writer_bool(json_writer_t *w, const char *key, int value);
+void json_writer_null(json_writer_t *w, const char *key);
+int json_writer_finish(json_writer_t *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
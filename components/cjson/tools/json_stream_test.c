@@ -0,0 +1,777 @@
+/*
+ * json_stream against cJSON: random documents and broken copies of them go
+ * through both, fed to the reader in pieces of random size, and whatever
+ * the reader takes cJSON has to take too, with the same values at the same
+ * paths. The writer has to print cJSON trees byte for byte the way
+ * cJSON_PrintUnformatted() does. Then both read and write a cloud shadow
+ * document of about 4 KB, counting allocations and time.
+ *
+ *   gcc -O2 -I. -I.. -o json_stream_test json_stream_test.c ../json_stream.c ../cJSON.c -lm
+ *   json_stream_test [seed [documents]]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cJSON.h"
+#include "json_stream.h"
+
+#define DOC_SIZE        16384
+#define EVENTS_SIZE     65536
+#define BENCH_ROUNDS    2000
+
+typedef struct {
+    char            *data;
+    unsigned int    len;
+    unsigned int    size;
+} buf_t;
+
+static void buf_put(buf_t *b, const char *s, unsigned int len)
+{
+    if (b->len + len + 1 > b->size) {
+        return;
+    }
+    memcpy(b->data + b->len, s, len);
+    b->len += len;
+    b->data[b->len] = 0;
+}
+
+static void buf_str(buf_t *b, const char *s)
+{
+    buf_put(b, s, strlen(s));
+}
+
+/* ---- random documents ---- */
+
+static void gen_space(buf_t *b)
+{
+    static const char *ws[] = { "", "", "", " ", "\n", "\t", "\r\n  " };
+
+    buf_str(b, ws[rand() % 7]);
+}
+
+static void gen_string(buf_t *b)
+{
+    static const char *pieces[] = {
+        "a", "b", "power", "state", "~", "/", "x y", "\\\"", "\\\\", "\\/", "\\b", "\\f", "\\n", "\\r",
+        "\\t", "\\u0041", "\\u00e9", "\\u20AC", "\\ud83d\\ude00", "\xc3\xa9", "\xe4\xb8\xad", "0", "_",
+    };
+    int i, n = rand() % 6;
+
+    buf_str(b, "\"");
+    for (i = 0; i < n; i++) {
+        buf_str(b, pieces[rand() % (sizeof(pieces) / sizeof(pieces[0]))]);
+    }
+    buf_str(b, "\"");
+}
+
+static void gen_number(buf_t *b)
+{
+    char num[48];
+
+    switch (rand() % 6) {
+    case 0:
+        sprintf(num, "%d", rand() % 100);
+        break;
+    case 1:
+        sprintf(num, "-%d", rand());
+        break;
+    case 2:
+        sprintf(num, "%d.%03d", rand() % 1000, rand() % 1000);
+        break;
+    case 3:
+        sprintf(num, "-%d.%de%s%d", rand() % 10, rand() % 100, rand() % 2 ? "-" : "+", rand() % 20);
+        break;
+    case 4:
+        sprintf(num, "%dE%d", 1 + rand() % 9, rand() % 12);
+        break;
+    default:
+        sprintf(num, "%s0", rand() % 2 ? "-" : "");
+        break;
+    }
+    buf_str(b, num);
+}
+
+static void gen_value(buf_t *b, int depth)
+{
+    int i, n, kind = rand() % (depth < 10 ? 8 : 5);
+
+    gen_space(b);
+    switch (kind) {
+    case 0:
+        gen_string(b);
+        break;
+    case 1:
+    case 2:
+        gen_number(b);
+        break;
+    case 3:
+        buf_str(b, rand() % 2 ? "true" : "false");
+        break;
+    case 4:
+        buf_str(b, "null");
+        break;
+    case 5:
+    case 6:
+        n = rand() % 5;
+        buf_str(b, "{");
+        for (i = 0; i < n; i++) {
+            gen_space(b);
+            gen_string(b);
+            gen_space(b);
+            buf_str(b, ":");
+            gen_value(b, depth + 1);
+            if (i != n - 1) {
+                buf_str(b, ",");
+            }
+        }
+        gen_space(b);
+        buf_str(b, "}");
+        break;
+    default:
+        n = rand() % 5;
+        buf_str(b, "[");
+        for (i = 0; i < n; i++) {
+            gen_value(b, depth + 1);
+            if (i != n - 1) {
+                buf_str(b, ",");
+            }
+        }
+        gen_space(b);
+        buf_str(b, "]");
+        break;
+    }
+    gen_space(b);
+}
+
+/* ---- both parsers down to one line per value: path, kind, value ---- */
+
+static void event(buf_t *ev, const char *path, char kind, const char *value, unsigned int len, double num)
+{
+    char line[64];
+
+    buf_str(ev, path);
+    sprintf(line, "\t%c\t", kind);
+    buf_str(ev, line);
+    if (kind == 'n') {
+        sprintf(line, "%.17g", num);
+        buf_str(ev, line);
+    } else if (value) {
+        buf_put(ev, value, len);
+    }
+    buf_str(ev, "\n");
+}
+
+static void pointer_append(char *path, const char *key)
+{
+    char *p = path + strlen(path);
+
+    *p++ = '/';
+    for (; *key; key++) {
+        if (*key == '~' || *key == '/') {
+            *p++ = '~';
+            *p++ = (*key == '~') ? '0' : '1';
+        } else {
+            *p++ = *key;
+        }
+    }
+    *p = 0;
+}
+
+static void cjson_events(cJSON *item, char *path, buf_t *ev)
+{
+    unsigned int len = strlen(path), i = 0;
+    cJSON *c;
+
+    switch (item->type & 0xff) {
+    case cJSON_False:
+        event(ev, path, 'f', NULL, 0, 0);
+        break;
+    case cJSON_True:
+        event(ev, path, 't', NULL, 0, 0);
+        break;
+    case cJSON_NULL:
+        event(ev, path, 'z', NULL, 0, 0);
+        break;
+    case cJSON_Number:
+        event(ev, path, 'n', NULL, 0, item->valuedouble);
+        break;
+    case cJSON_String:
+        event(ev, path, 's', item->valuestring, strlen(item->valuestring), 0);
+        break;
+    default:
+        event(ev, path, (item->type & 0xff) == cJSON_Object ? 'o' : 'a', NULL, 0, 0);
+        for (c = item->child; c; c = c->next, i++) {
+            if ((item->type & 0xff) == cJSON_Object) {
+                pointer_append(path, c->string);
+            } else {
+                sprintf(path + len, "/%u", i);
+            }
+            cjson_events(c, path, ev);
+            path[len] = 0;
+        }
+        break;
+    }
+}
+
+/* 0 when cJSON took it */
+static int cjson_parse(const char *doc, buf_t *ev)
+{
+    static char path[DOC_SIZE];
+    cJSON *root = cJSON_ParseWithOpts(doc, NULL, 1);
+
+    ev->len = 0;
+    if (root == NULL) {
+        return -1;
+    }
+    path[0] = 0;
+    cjson_events(root, path, ev);
+    cJSON_Delete(root);
+    return 0;
+}
+
+/* 0 when the reader took it, <max> bytes at most per feed */
+static int stream_parse(const char *doc, unsigned int len, unsigned int max, buf_t *ev)
+{
+    static json_reader_t r;
+    char scratch[1024];
+    unsigned int pos = 0, n;
+    json_token_t t;
+
+    ev->len = 0;
+    json_reader_init(&r, scratch, sizeof(scratch));
+    for (;;) {
+        t = json_reader_next(&r);
+        switch (t) {
+        case JSON_TOKEN_MORE:
+            if (pos == len) {
+                json_reader_end(&r);
+                break;
+            }
+            n = 1 + rand() % max;
+            n = (n > len - pos) ? len - pos : n;
+            json_reader_feed(&r, doc + pos, n);
+            pos += n;
+            break;
+        case JSON_TOKEN_ERROR:
+            return -1;
+        case JSON_TOKEN_END:
+            return 0;
+        case JSON_TOKEN_OBJECT_BEGIN:
+            event(ev, json_reader_path(&r), 'o', NULL, 0, 0);
+            break;
+        case JSON_TOKEN_ARRAY_BEGIN:
+            event(ev, json_reader_path(&r), 'a', NULL, 0, 0);
+            break;
+        case JSON_TOKEN_STRING:
+            event(ev, json_reader_path(&r), 's', r.scratch, r.len, 0);
+            break;
+        case JSON_TOKEN_NUMBER:
+            event(ev, json_reader_path(&r), 'n', NULL, 0, r.number);
+            break;
+        case JSON_TOKEN_TRUE:
+            event(ev, json_reader_path(&r), 't', NULL, 0, 0);
+            break;
+        case JSON_TOKEN_FALSE:
+            event(ev, json_reader_path(&r), 'f', NULL, 0, 0);
+            break;
+        case JSON_TOKEN_NULL:
+            event(ev, json_reader_path(&r), 'z', NULL, 0, 0);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void mutate(buf_t *b)
+{
+    static const char alphabet[] = "{}[]\",:0123456789-+.eE tfnrul\\/\x01\xff";
+    unsigned int at = rand() % (b->len + 1), i;
+
+    switch (rand() % 3) {
+    case 0:
+        if (at < b->len) {
+            b->data[at] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+        break;
+    case 1:
+        if (b->len + 2 < b->size) {
+            memmove(b->data + at + 1, b->data + at, b->len - at + 1);
+            b->data[at] = alphabet[rand() % (sizeof(alphabet) - 1)];
+            b->len++;
+        }
+        break;
+    default:
+        for (i = 1 + rand() % 3; i && at < b->len; i--) {
+            memmove(b->data + at, b->data + at + 1, b->len - at);
+            b->len--;
+        }
+        break;
+    }
+}
+
+static int fuzz(int docs)
+{
+    static char doc_data[DOC_SIZE], ev1_data[EVENTS_SIZE], ev2_data[EVENTS_SIZE];
+    buf_t doc = { doc_data, 0, sizeof(doc_data) };
+    buf_t ev1 = { ev1_data, 0, sizeof(ev1_data) }, ev2 = { ev2_data, 0, sizeof(ev2_data) };
+    int i, m, ours, theirs, fail = 0, taken = 0, broken = 0, both_refused = 0;
+
+    for (i = 0; i < docs; i++) {
+        doc.len = 0;
+        gen_value(&doc, 0);
+
+        ours = stream_parse(doc.data, doc.len, 1 + rand() % 64, &ev1);
+        theirs = cjson_parse(doc.data, &ev2);
+        if (ours || theirs || ev1.len != ev2.len || memcmp(ev1.data, ev2.data, ev1.len)) {
+            printf("  valid document %d: ours %d cJSON %d\n%s\n--- ours\n%s--- cJSON\n%s", i, ours, theirs,
+                   doc.data, ev1.data, ev2.data);
+            fail = 1;
+            break;
+        }
+
+        for (m = 0; m < 8; m++) {
+            mutate(&doc);
+            ours = stream_parse(doc.data, doc.len, 1 + rand() % 16, &ev1);
+            if (ours) {
+                broken++;
+                if (cjson_parse(doc.data, &ev2)) {
+                    both_refused++;
+                }
+                continue;
+            }
+            taken++;
+            theirs = cjson_parse(doc.data, &ev2);
+            if (theirs || ev1.len != ev2.len || memcmp(ev1.data, ev2.data, ev1.len)) {
+                printf("  broken document %d/%d taken: cJSON %d\n%s\n--- ours\n%s--- cJSON\n%s", i, m, theirs,
+                       doc.data, ev1.data, ev2.data);
+                fail = 1;
+                break;
+            }
+        }
+    }
+    printf("fuzz: %d documents, %d mutants taken and matching, %d refused (%d by cJSON too) %s\n",
+           docs, taken, broken, both_refused, fail ? "FAIL" : "ok");
+    return fail;
+}
+
+/* ---- writer ---- */
+
+static int collect(void *arg, const char *data, unsigned int len)
+{
+    buf_put(arg, data, len);
+    return 0;
+}
+
+static void write_item(json_writer_t *w, cJSON *item, const char *key)
+{
+    cJSON *c;
+
+    switch (item->type & 0xff) {
+    case cJSON_False:
+        json_writer_bool(w, key, 0);
+        break;
+    case cJSON_True:
+        json_writer_bool(w, key, 1);
+        break;
+    case cJSON_NULL:
+        json_writer_null(w, key);
+        break;
+    case cJSON_Number:
+        json_writer_number(w, key, item->valuedouble);
+        break;
+    case cJSON_String:
+        json_writer_string(w, key, item->valuestring);
+        break;
+    case cJSON_Array:
+        json_writer_array_begin(w, key);
+        for (c = item->child; c; c = c->next) {
+            write_item(w, c, NULL);
+        }
+        json_writer_array_end(w);
+        break;
+    default:
+        json_writer_object_begin(w, key);
+        for (c = item->child; c; c = c->next) {
+            write_item(w, c, c->string);
+        }
+        json_writer_object_end(w);
+        break;
+    }
+}
+
+static int check_writer(cJSON *root, const char *what)
+{
+    static char out_data[DOC_SIZE], small[7];
+    buf_t out = { out_data, 0, sizeof(out_data) };
+    char *expect = cJSON_PrintUnformatted(root);
+    json_writer_t w;
+    int len, fail;
+
+    /* through a tiny buffer flushed again and again */
+    json_writer_init(&w, small, sizeof(small), collect, &out);
+    write_item(&w, root, NULL);
+    len = json_writer_finish(&w);
+    fail = (len < 0 || (unsigned int)len != strlen(expect) || strcmp(out.data, expect));
+
+    /* into a buffer just too small, then just big enough */
+    json_writer_init(&w, out_data, strlen(expect), NULL, NULL);
+    write_item(&w, root, NULL);
+    fail |= (json_writer_finish(&w) != -1);
+    json_writer_init(&w, out_data, strlen(expect) + 1, NULL, NULL);
+    write_item(&w, root, NULL);
+    fail |= (json_writer_finish(&w) != len || strcmp(out_data, expect));
+
+    if (fail) {
+        printf("  writer %s:\n%s\n%s\n", what, expect, out.data);
+    }
+    free(expect);
+    return fail;
+}
+
+static int writer(int docs)
+{
+    static char doc_data[DOC_SIZE];
+    buf_t doc = { doc_data, 0, sizeof(doc_data) };
+    static const double numbers[] = {
+        0, -0.0, 1, -1, 42, 2147483647.0, -2147483648.0, 0.5, -0.5, 3.25, -17.75, 1e-3, -1e-3, 12345.678,
+    };
+    cJSON *root, *arr;
+    char s[40];
+    unsigned int i;
+    int fail = 0;
+
+    for (i = 0; i < (unsigned int)docs && !fail; i++) {
+        doc.len = 0;
+        gen_value(&doc, 0);
+        root = cJSON_Parse(doc.data);
+        fail |= check_writer(root, "document");
+        cJSON_Delete(root);
+    }
+
+    /* numbers the parser does not come up with, and every control character */
+    root = cJSON_CreateObject();
+    arr = cJSON_CreateArray();
+    for (i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        cJSON_AddItemToArray(arr, cJSON_CreateNumber(numbers[i]));
+    }
+    cJSON_AddItemToObject(root, "numbers", arr);
+    for (i = 1; i < 40; i++) {
+        s[i - 1] = (char)i;
+    }
+    s[39] = 0;
+    cJSON_AddStringToObject(root, s, s);
+    cJSON_AddStringToObject(root, "high", "\x80\xff\xc3\xa9");
+    fail |= check_writer(root, "numbers and escapes");
+    cJSON_Delete(root);
+
+    printf("writer: %d documents as cJSON prints them %s\n", docs, fail ? "FAIL" : "ok");
+    return fail;
+}
+
+/* ---- the rest of the reader ---- */
+
+static int expect_tokens(const char *doc, const json_token_t *tokens, int count, unsigned int scratch_size)
+{
+    static json_reader_t r;
+    char scratch[64];
+    json_token_t t;
+    int i;
+
+    json_reader_init(&r, scratch, scratch_size);
+    json_reader_feed(&r, doc, strlen(doc));
+    json_reader_end(&r);
+    for (i = 0; i < count; i++) {
+        if ((t = json_reader_next(&r)) != tokens[i]) {
+            printf("  %s: token %d is %d, not %d\n", doc, i, t, tokens[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int reader(void)
+{
+    static const char *refused[] = {
+        "", " ", "01", "-", "1.", ".5", "1e", "1e+", "+1", "tru", "nul", "[1,]", "{\"a\":1,}", "{\"a\"}",
+        "[1 2]", "\"\\x\"", "\"\\ud800\"", "\"\\udc00\"", "\"\\ud800\\u0041\"", "\"a\nb\"", "{} {}", "[}",
+        "{1:2}", "\"abc", "[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]",
+    };
+    static const json_token_t skipped[] = {
+        JSON_TOKEN_OBJECT_BEGIN, JSON_TOKEN_KEY, JSON_TOKEN_KEY, JSON_TOKEN_OBJECT_BEGIN, JSON_TOKEN_KEY,
+        JSON_TOKEN_NUMBER, JSON_TOKEN_OBJECT_END, JSON_TOKEN_OBJECT_END, JSON_TOKEN_END,
+    };
+    static const json_token_t cut[] = {
+        JSON_TOKEN_ARRAY_BEGIN, JSON_TOKEN_STRING, JSON_TOKEN_ERROR,
+    };
+    char doc[512], key[200], str[8];
+    json_field_t fields[4];
+    json_reader_t r;
+    char scratch[16];
+    unsigned int i;
+    int fail = 0, n;
+
+    for (i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+        json_token_t t;
+
+        json_reader_init(&r, scratch, sizeof(scratch));
+        json_reader_feed(&r, refused[i], strlen(refused[i]));
+        json_reader_end(&r);
+        while ((t = json_reader_next(&r)) > JSON_TOKEN_END)
+            ;
+        if (t != JSON_TOKEN_ERROR) {
+            printf("  taken: %s\n", refused[i]);
+            fail = 1;
+        }
+    }
+
+    /* skip right after the begin token leaves the whole object out */
+    json_reader_init(&r, scratch, sizeof(scratch));
+    strcpy(doc, "{\"a\":{\"b\":[1,{\"c\":2}],\"d\":3},\"e\":{\"f\":4}}");
+    json_reader_feed(&r, doc, strlen(doc));
+    json_reader_end(&r);
+    for (i = 0; i < sizeof(skipped) / sizeof(skipped[0]); i++) {
+        json_token_t t = json_reader_next(&r);
+
+        if (t != skipped[i] || (t == JSON_TOKEN_NUMBER && (!json_reader_match(&r, "/e/f") || r.number != 4))) {
+            printf("  skip: token %u is %d at %s\n", i, t, json_reader_path(&r));
+            fail = 1;
+            break;
+        }
+        if (t == JSON_TOKEN_KEY && json_reader_match(&r, "/a")) {
+            json_reader_next(&r);
+            json_reader_skip(&r);
+        }
+    }
+
+    /* a long string is cut in scratch but still read past, a long number is refused */
+    fail |= expect_tokens("[\"0123456789abcdef\", 12345678901234567]", cut, 3, 16);
+
+    /* a key too long for the path: nothing below it matches, the next one does again */
+    memset(key, 'k', sizeof(key) - 1);
+    key[sizeof(key) - 1] = 0;
+    sprintf(doc, "{\"%s\":{\"x\":1},\"y\":\"~/value\",\"a~/b\":[true,2]}", key);
+    fields[0].pointer = "/y";
+    fields[0].str = str;
+    fields[0].str_size = sizeof(str);
+    fields[1].pointer = "/a~0~1b/1";
+    fields[1].str = NULL;
+    fields[2].pointer = "/x";
+    fields[2].str = NULL;
+    fields[3].pointer = "/a~0~1b/0";
+    fields[3].str = NULL;
+    n = json_extract(doc, strlen(doc), fields, 4);
+    if (n != 3 || fields[0].token != JSON_TOKEN_STRING || strcmp(str, "~/value") ||
+        fields[1].token != JSON_TOKEN_NUMBER || fields[1].number != 2 || fields[2].token != JSON_TOKEN_END ||
+        fields[3].token != JSON_TOKEN_TRUE) {
+        printf("  extract: %d found, \"%s\"\n", n, str);
+        fail = 1;
+    }
+    fail |= (json_extract("{\"a\":", 5, fields, 4) != -1);
+
+    printf("reader: refusals, skip, cut strings and paths %s\n", fail ? "FAIL" : "ok");
+    return fail;
+}
+
+/* ---- a cloud shadow document, once with cJSON and once without ---- */
+
+static struct {
+    unsigned int    allocs;
+    unsigned int    bytes;
+    unsigned int    peak;
+} heap;
+
+static void *count_malloc(size_t size)
+{
+    size_t *p = malloc(size + sizeof(size_t));
+
+    heap.allocs++;
+    heap.bytes += size;
+    heap.peak = (heap.bytes > heap.peak) ? heap.bytes : heap.peak;
+    *p = size;
+    return p + 1;
+}
+
+static void count_free(void *ptr)
+{
+    size_t *p = ptr;
+
+    if (p) {
+        heap.bytes -= p[-1];
+        free(p - 1);
+    }
+}
+
+static double now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void shadow_doc(buf_t *b)
+{
+    char item[256];
+    int i;
+
+    buf_str(b, "{\"method\":\"control\",\"clientToken\":\"clientToken-8b1c2a7e\",\"timestamp\":1697712000,"
+            "\"state\":{\"desired\":{\"power_switch\":1,\"brightness\":73,\"color\":\"warm\","
+            "\"schedule\":{\"enable\":true,\"on\":\"07:30\",\"off\":\"23:00\"}},\"reported\":{");
+    for (i = 0; i < 48; i++) {
+        sprintf(item, "%s\"sensor_%02d\":{\"value\":%d.%d,\"unit\":\"%s\",\"ok\":%s,\"history\":[%d,%d,%d]}",
+                i ? "," : "", i, 20 + i, i % 10, i % 2 ? "celsius" : "percent", i % 3 ? "true" : "false",
+                i * 3, i * 3 + 1, i * 3 + 2);
+        buf_str(b, item);
+    }
+    buf_str(b, "},\"version\":\"2.4.1\"},\"metadata\":{\"product\":\"ECR6600-LIGHT\",\"region\":\"ap-guangzhou\"}}");
+}
+
+static const char *bench_fields[] = {
+    "/state/desired/power_switch", "/state/desired/brightness", "/state/desired/color", "/state/version",
+};
+
+static void bench_cjson_read(const char *doc, double *power, double *level, char *color, char *version)
+{
+    cJSON *root = cJSON_Parse(doc);
+    cJSON *state = cJSON_GetObjectItem(root, "state");
+    cJSON *desired = cJSON_GetObjectItem(state, "desired");
+
+    *power = cJSON_GetObjectItem(desired, "power_switch")->valuedouble;
+    *level = cJSON_GetObjectItem(desired, "brightness")->valuedouble;
+    strcpy(color, cJSON_GetObjectItem(desired, "color")->valuestring);
+    strcpy(version, cJSON_GetObjectItem(state, "version")->valuestring);
+    cJSON_Delete(root);
+}
+
+static void bench_stream_read(const char *doc, unsigned int len, double *power, double *level, char *color,
+                              char *version)
+{
+    json_field_t f[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        f[i].pointer = bench_fields[i];
+        f[i].str = NULL;
+    }
+    f[2].str = color;
+    f[2].str_size = 16;
+    f[3].str = version;
+    f[3].str_size = 16;
+    json_extract(doc, len, f, 4);
+    *power = f[0].number;
+    *level = f[1].number;
+}
+
+static char *bench_cjson_write(void)
+{
+    cJSON *root = cJSON_CreateObject(), *state = cJSON_CreateObject(), *rep = cJSON_CreateObject();
+    char name[16], *out;
+    int i;
+
+    cJSON_AddStringToObject(root, "method", "report");
+    cJSON_AddStringToObject(root, "clientToken", "clientToken-8b1c2a7e");
+    for (i = 0; i < 30; i++) {
+        sprintf(name, "sensor_%02d", i);
+        cJSON_AddNumberToObject(rep, name, 20 + i + 0.5);
+    }
+    cJSON_AddItemToObject(state, "reported", rep);
+    cJSON_AddItemToObject(root, "state", state);
+    out = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return out;
+}
+
+static int bench_stream_write(char *buf, unsigned int size)
+{
+    json_writer_t w;
+    char name[16];
+    int i;
+
+    json_writer_init(&w, buf, size, NULL, NULL);
+    json_writer_object_begin(&w, NULL);
+    json_writer_string(&w, "method", "report");
+    json_writer_string(&w, "clientToken", "clientToken-8b1c2a7e");
+    json_writer_object_begin(&w, "state");
+    json_writer_object_begin(&w, "reported");
+    for (i = 0; i < 30; i++) {
+        sprintf(name, "sensor_%02d", i);
+        json_writer_number(&w, name, 20 + i + 0.5);
+    }
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+    json_writer_object_end(&w);
+    return json_writer_finish(&w);
+}
+
+static int bench(void)
+{
+    static char doc_data[DOC_SIZE], out[1024];
+    buf_t doc = { doc_data, 0, sizeof(doc_data) };
+    cJSON_Hooks hooks = { count_malloc, count_free };
+    char color[2][16], version[2][16], *printed;
+    double power[2], level[2], t0, t1, t2, t_cjson, t_stream;
+    int i, fail;
+
+    shadow_doc(&doc);
+    cJSON_InitHooks(&hooks);
+
+    memset(&heap, 0, sizeof(heap));
+    bench_cjson_read(doc.data, &power[0], &level[0], color[0], version[0]);
+    printf("shadow read, %u bytes: cJSON %u allocations, %u bytes peak heap\n", doc.len, heap.allocs, heap.peak);
+    memset(&heap, 0, sizeof(heap));
+    bench_stream_read(doc.data, doc.len, &power[1], &level[1], color[1], version[1]);
+    printf("                        json_extract %u allocations, reader %u bytes + %u scratch on the stack\n",
+           heap.allocs, (unsigned int)sizeof(json_reader_t), JSON_EXTRACT_SCRATCH_SIZE);
+    fail = (power[0] != power[1] || level[0] != level[1] || strcmp(color[0], color[1]) ||
+            strcmp(version[0], version[1]) || heap.allocs != 0);
+
+    /* fastest of many, interleaved, the host is not quiet */
+    for (i = 0, t_cjson = t_stream = 1e9; i < BENCH_ROUNDS; i++) {
+        t0 = now_us();
+        bench_cjson_read(doc.data, &power[0], &level[0], color[0], version[0]);
+        t1 = now_us();
+        bench_stream_read(doc.data, doc.len, &power[1], &level[1], color[1], version[1]);
+        t_cjson = (t1 - t0 < t_cjson) ? t1 - t0 : t_cjson;
+        t2 = now_us();
+        t_stream = (t2 - t1 < t_stream) ? t2 - t1 : t_stream;
+    }
+    printf("                        best %.1f us with cJSON, %.1f us with json_extract\n", t_cjson, t_stream);
+
+    memset(&heap, 0, sizeof(heap));
+    printed = bench_cjson_write();
+    printf("report write: cJSON %u allocations, %u bytes peak heap\n", heap.allocs, heap.peak);
+    memset(&heap, 0, sizeof(heap));
+    fail |= (bench_stream_write(out, sizeof(out)) != (int)strlen(printed) || strcmp(out, printed) || heap.allocs);
+    count_free(printed);
+
+    for (i = 0, t_cjson = t_stream = 1e9; i < BENCH_ROUNDS; i++) {
+        t0 = now_us();
+        count_free(bench_cjson_write());
+        t1 = now_us();
+        bench_stream_write(out, sizeof(out));
+        t_cjson = (t1 - t0 < t_cjson) ? t1 - t0 : t_cjson;
+        t2 = now_us();
+        t_stream = (t2 - t1 < t_stream) ? t2 - t1 : t_stream;
+    }
+    printf("              best %.1f us with cJSON, %.1f us with json_writer, no allocations %s\n",
+           t_cjson, t_stream, fail ? "FAIL" : "ok");
+
+    cJSON_InitHooks(NULL);
+    return fail;
+}
+
+int main(int argc, char *argv[])
+{
+    int docs = argc > 2 ? atoi(argv[2]) : 20000;
+    int fail = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    fail |= fuzz(docs);
+    fail |= writer(docs / 10);
+    fail |= reader();
+    fail |= bench();
+    printf("json stream %s\n", fail ? "FAIL" : "pass");
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/* Host stand-in for include/os/oshal.h, as much as cJSON.c needs. */
+#ifndef _OSHAL_H_
+#define _OSHAL_H_
+
+#include <stdlib.h>
+
+#define os_malloc   malloc
+#define os_free     free
+
+#endif
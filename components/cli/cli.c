@@ -5,6 +5,7 @@
 #include "rtos_debug.h"
 #include "chip_pinmux.h"
 #include "hal_wdt.h"
+#include "arch_irq.h"
 
 
 //#include "chip_irqvector.h"
@@ -44,6 +45,97 @@ char *prompt_symbol_t[] = {
 
 CLI_DEV s_cli_dev = {0};
 
+#ifdef CONFIG_CLI_TX_DMA
+#define CLI_TX_POLICY_SLOTS		8
+
+#if defined(CONFIG_CLI_TX_POLICY_DROP)
+#define CLI_TX_POLICY_DEFAULT	UART_TX_RING_DROP
+#elif defined(CONFIG_CLI_TX_POLICY_TRUNCATE)
+#define CLI_TX_POLICY_DEFAULT	UART_TX_RING_TRUNCATE
+#else
+#define CLI_TX_POLICY_DEFAULT	UART_TX_RING_BLOCK
+#endif
+
+typedef struct
+{
+	int task;
+	int policy;
+} cli_tx_policy_t;
+
+/* console ring, the uart dma can not reach ILM/DLM heap memory */
+static char cli_tx_ring[CONFIG_CLI_TX_RING_SIZE] __attribute__((section(".dma.data")));
+
+/* tasks that asked for something other than the default ring-full policy */
+static cli_tx_policy_t cli_tx_policy[CLI_TX_POLICY_SLOTS];
+
+int cli_tx_policy_set(int policy)
+{
+	int task = os_task_get_running_handle();
+	int i, slot = -1;
+	unsigned long flags;
+
+	if (policy < 0 || policy >= UART_TX_RING_POLICY_MAX)
+	{
+		return -1;
+	}
+
+	flags = system_irq_save();
+	for (i = 0; i < CLI_TX_POLICY_SLOTS; i++)
+	{
+		if (cli_tx_policy[i].task == task)
+		{
+			slot = i;
+			break;
+		}
+		if (slot < 0 && cli_tx_policy[i].task == 0)
+		{
+			slot = i;
+		}
+	}
+
+	if (slot >= 0)
+	{
+		cli_tx_policy[slot].task = (policy == CLI_TX_POLICY_DEFAULT) ? 0 : task;
+		cli_tx_policy[slot].policy = policy;
+	}
+	system_irq_restore(flags);
+
+	return (slot >= 0) ? 0 : -1;
+}
+
+static int cli_tx_policy_get(void)
+{
+	int task, i;
+
+	if (arch_irq_context())
+	{
+		return UART_TX_RING_TRUNCATE;
+	}
+
+	task = os_task_get_running_handle();
+	for (i = 0; i < CLI_TX_POLICY_SLOTS; i++)
+	{
+		if (cli_tx_policy[i].task == task)
+		{
+			return cli_tx_policy[i].policy;
+		}
+	}
+
+	return CLI_TX_POLICY_DEFAULT;
+}
+#endif
+
+static void cli_uart_output(CLI_DEV *p_cli_dev, char *buf, int len)
+{
+#ifdef CONFIG_CLI_TX_DMA
+	if (drv_uart_tx_ring_write(p_cli_dev->cli_uart_num, buf, len, cli_tx_policy_get()) >= 0)
+	{
+		return;
+	}
+#endif
+	drv_uart_send_poll(p_cli_dev->cli_uart_num, buf, len);
+}
+
 
 
 void cli_printf(const char *f, ...)
@@ -81,7 +173,7 @@ void cli_printf(const char *f, ...)
         }
 		if(telnet_log_write(p_cli_dev->cli_print_buffer, len) < 0)
 		{
-        	drv_uart_send_poll(p_cli_dev->cli_uart_num, p_cli_dev->cli_print_buffer, len);
+        	cli_uart_output(p_cli_dev, p_cli_dev->cli_print_buffer, len);
 		}
 
         //system_irq_restore(flags); 
@@ -123,7 +215,7 @@ void cli_vprintf(const char *f,  va_list ap)
         }
 		if(telnet_log_write(p_cli_dev->cli_print_buffer, len) < 0)
 		{
-        	drv_uart_send_poll(p_cli_dev->cli_uart_num, p_cli_dev->cli_print_buffer, len);
+        	cli_uart_output(p_cli_dev, p_cli_dev->cli_print_buffer, len);
 		}
 
         //system_irq_restore(flags); 
@@ -671,6 +763,9 @@ void component_cli_init(E_DRV_UART_NUM uart_num)
 	{
 		drv_uart_open(uart_num, &config);
 	}
+#ifdef CONFIG_CLI_TX_DMA
+	drv_uart_tx_ring_open(uart_num, cli_tx_ring, sizeof(cli_tx_ring));
+#endif
 
 	callback.uart_callback = cli_uart_isr;
 	callback.uart_data = (void *)p_cli_dev;
@@ -45,7 +45,11 @@ static void iterate_task(void (*callback)(TaskStatus_t *, uint32_t *, void *), u
     os_free(info);
     return;
 }
+#ifdef portRUN_TIME_STATS_HZ
+#define tick_to_second(x) ((x) / (portRUN_TIME_STATS_HZ))
+#else
 #define tick_to_second(x) ((x) / (configTICK_RATE_HZ))
+#endif
 
 
 struct xtime {
@@ -38,9 +38,31 @@ static int cmd_httpserver(cmd_tbl_t *t, int argc, char *argv[])
         }
         os_printf(LM_CMD, LL_INFO,"failed!\n");
         return CMD_RET_FAILURE;
+    }else if(strcmp(argv[1], "stat") == 0) {
+        httpd_tx_stats_t stats;
+        if (httpd_get_tx_stats(server, &stats, argc > 2 && strcmp(argv[2], "reset") == 0) != 0) {
+            os_printf(LM_CMD, LL_INFO,"server not running\n");
+            return CMD_RET_FAILURE;
+        }
+        os_printf(LM_CMD, LL_INFO,"responses:%d writes:%d bytes:%d\n",
+            stats.responses, stats.send_calls, stats.bytes);
+        os_printf(LM_CMD, LL_INFO,"latency avg:%dus max:%dus\n",
+            stats.responses ? stats.latency_us / stats.responses : 0, stats.latency_max_us);
+
+        httpd_handler_stats_t hs;
+        const char *uri;
+        httpd_method_t method;
+        unsigned int i;
+        for (i = 0; httpd_get_handler_stats(server, i, &uri, &method, &hs,
+                argc > 2 && strcmp(argv[2], "reset") == 0) == 0; i++) {
+            os_printf(LM_CMD, LL_INFO,"%-6s %-24s calls:%d err:%d async:%d avg:%dus max:%dus\n",
+                http_method_str(method), uri, hs.calls, hs.errors, hs.async,
+                hs.calls ? hs.latency_us / hs.calls : 0, hs.latency_max_us);
+        }
+        return CMD_RET_SUCCESS;
     }else {
         return CMD_RET_FAILURE;
     }
         
 }
-CLI_CMD(httpserver, cmd_httpserver, "Httpserver", "httpserver [arg]");
+CLI_CMD(httpserver, cmd_httpserver, "Httpserver", "httpserver start|stop|stat [reset]");
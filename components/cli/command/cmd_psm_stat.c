@@ -0,0 +1,50 @@
+/**
+ * @file cmd_psm_stat.c
+ * @brief Report and dump of the psm wake accounting
+ * @details psm_stat [report], dump, reset
+ */
+
+
+/*--------------------------------------------------------------------------
+*												Include files
+--------------------------------------------------------------------------*/
+#include "cli.h"
+#include "oshal.h"
+#include "psm_stat.h"
+
+
+/*--------------------------------------------------------------------------
+* 	                                          	Function Definitions
+--------------------------------------------------------------------------*/
+static int psm_stat_report_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	psm_stat_report();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(psm_stat, report, psm_stat_report_cmd, "sleep lengths and wake causes", "psm_stat report");
+
+static int psm_stat_dump_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	psm_stat_dump();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(psm_stat, dump, psm_stat_dump_cmd, "print the data for psm_energy", "psm_stat dump");
+
+static int psm_stat_reset_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	psm_stat_reset();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(psm_stat, reset, psm_stat_reset_cmd, "start counting again", "psm_stat reset");
+
+/* no sub-command is the report */
+static int psm_stat_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	if (argc > 1)
+	{
+		return CMD_RET_UNHANDLED;
+	}
+	psm_stat_report();
+	return CMD_RET_SUCCESS;
+}
+CLI_CMD(psm_stat, psm_stat_cmd, "psm wake causes and sleep residency", "psm_stat [report]/dump/reset");
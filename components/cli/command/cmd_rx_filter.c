@@ -0,0 +1,182 @@
+/**
+ * @file cmd_rx_filter.c
+ * @brief Rules and counters of the wifi rx filter
+ * @details rx_filter [show], on, off, add, del, clear, udp, reset
+ */
+
+
+/*--------------------------------------------------------------------------
+*												Include files
+--------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "cli.h"
+#include "oshal.h"
+#include "wifi_rx_filter.h"
+
+
+/*--------------------------------------------------------------------------
+* 	                                          	Local Macros
+--------------------------------------------------------------------------*/
+#define RX_FILTER_UDP_PORTS_MAX		8
+
+
+/*--------------------------------------------------------------------------
+* 	                                          	Function Definitions
+--------------------------------------------------------------------------*/
+static const char *rx_filter_cast_str(uint8_t cast)
+{
+	static const char *names[] = { "any", "u", "m", "um", "b", "ub", "mb", "any" };
+
+	return names[cast & WIFI_RX_FILTER_ANY];
+}
+
+static int rx_filter_show_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_stats_t stats;
+	wifi_rx_filter_rule_t rule;
+	uint32_t hits;
+	int i, id;
+
+	wifi_rx_filter_get_stats(&stats, false);
+	os_printf(LM_CMD, LL_INFO, "frames %u, arp dropped %u, mcast dropped %u, rule dropped %u\n",
+			stats.frames, stats.arp_dropped, stats.mcast_dropped, stats.rule_dropped);
+
+	for (i = 0; (id = wifi_rx_filter_get(i, &rule, &hits)) >= 0; i++)
+	{
+		os_printf(LM_CMD, LL_INFO, "%3d %-4s %-3s type 0x%04x proto %3u port %5u-%-5u hits %u\n",
+				id, rule.action == WIFI_RX_FILTER_DROP ? "drop" : "pass", rx_filter_cast_str(rule.cast),
+				rule.ethertype, rule.ip_proto, rule.port_min, rule.port_max, hits);
+	}
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, show, rx_filter_show_cmd, "counters and rules", "rx_filter show");
+
+static int rx_filter_on_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_enable(true);
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, on, rx_filter_on_cmd, "filter rx frames", "rx_filter on");
+
+static int rx_filter_off_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_enable(false);
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, off, rx_filter_off_cmd, "pass all rx frames to lwip", "rx_filter off");
+
+/* rx_filter add pass|drop <u|m|b|...|any> [ethertype [proto [port[-port]]]] */
+static int rx_filter_add_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_rule_t rule;
+	char *s, *end;
+	int id;
+
+	if (argc < 3)
+	{
+		return CMD_RET_USAGE;
+	}
+
+	memset(&rule, 0, sizeof(rule));
+	if (!strcmp(argv[1], "drop"))
+	{
+		rule.action = WIFI_RX_FILTER_DROP;
+	}
+	else if (strcmp(argv[1], "pass"))
+	{
+		return CMD_RET_USAGE;
+	}
+
+	if (strcmp(argv[2], "any"))
+	{
+		for (s = argv[2]; *s; s++)
+		{
+			rule.cast |= (*s == 'u') ? WIFI_RX_FILTER_UCAST :
+						 (*s == 'm') ? WIFI_RX_FILTER_MCAST :
+						 (*s == 'b') ? WIFI_RX_FILTER_BCAST : 0;
+		}
+	}
+	if (argc > 3)
+	{
+		rule.ethertype = strtoul(argv[3], NULL, 0);
+	}
+	if (argc > 4)
+	{
+		rule.ip_proto = strtoul(argv[4], NULL, 0);
+	}
+	if (argc > 5)
+	{
+		rule.port_min = rule.port_max = strtoul(argv[5], &end, 0);
+		if (*end == '-')
+		{
+			rule.port_max = strtoul(end + 1, NULL, 0);
+		}
+	}
+
+	id = wifi_rx_filter_add(&rule);
+	if (id < 0)
+	{
+		os_printf(LM_CMD, LL_ERR, "rx filter rules are full\n");
+		return CMD_RET_FAILURE;
+	}
+	os_printf(LM_CMD, LL_INFO, "rule %d\n", id);
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, add, rx_filter_add_cmd, "append a rule",
+		"rx_filter add pass|drop <u|m|b|any> [ethertype [proto [port[-port]]]]");
+
+static int rx_filter_del_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		return CMD_RET_USAGE;
+	}
+	return wifi_rx_filter_del(atoi(argv[1])) ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, del, rx_filter_del_cmd, "remove a rule", "rx_filter del <id>");
+
+static int rx_filter_clear_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_clear();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, clear, rx_filter_clear_cmd, "remove all rules", "rx_filter clear");
+
+static int rx_filter_udp_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	uint16_t ports[RX_FILTER_UDP_PORTS_MAX];
+	int i;
+
+	if (argc - 1 > RX_FILTER_UDP_PORTS_MAX)
+	{
+		return CMD_RET_USAGE;
+	}
+	for (i = 1; i < argc; i++)
+	{
+		ports[i - 1] = atoi(argv[i]);
+	}
+	return wifi_rx_filter_udp_whitelist(ports, argc - 1) ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, udp, rx_filter_udp_cmd, "broadcast/multicast udp to these ports only",
+		"rx_filter udp [port ...]");
+
+static int rx_filter_reset_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	wifi_rx_filter_stats_t stats;
+
+	wifi_rx_filter_get_stats(&stats, true);
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(rx_filter, reset, rx_filter_reset_cmd, "zero the counters", "rx_filter reset");
+
+/* no sub-command is show */
+static int rx_filter_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	if (argc > 1)
+	{
+		return CMD_RET_UNHANDLED;
+	}
+	return rx_filter_show_cmd(t, argc, argv);
+}
+CLI_CMD(rx_filter, rx_filter_cmd, "wifi rx filter", "rx_filter [show]/on/off/add/del/clear/udp/reset");
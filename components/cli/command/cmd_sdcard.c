@@ -27,6 +27,7 @@
 #include "sdhci.h"
 #include "ff.h"
 #include "sdcard.h"
+#include "oshal.h"
 
 
 
@@ -253,6 +254,133 @@ int cmd_sdcard_test(cmd_tbl_t *t, int argc, char *argv[])
 
 CLI_CMD(sd_test, cmd_sdcard_test, "sd_test", "sd_test");
 
+static void sdcard_stats_show(void)
+{
+	sdcard_stats_t st;
+
+	sdcard_get_stats(&st, 0);
+	os_printf(LM_CMD, LL_INFO, "commands %u direct %u bounce %u, sectors read %u written %u\n",
+		st.commands, st.direct, st.bounce, st.read, st.written);
+	os_printf(LM_CMD, LL_INFO, "cache hits %u misses %u readahead %u writebacks %u\n",
+		st.hits, st.misses, st.readahead, st.writebacks);
+}
+
+int cmd_sdcard_stat(cmd_tbl_t *t, int argc, char *argv[])
+{
+	sdcard_stats_show();
+	if (argc > 1 && strcmp(argv[1], "reset") == 0)
+		sdcard_get_stats(NULL, 1);
+	return 0;
+}
+
+CLI_CMD(sd_stat, cmd_sdcard_stat, "sdcard transfer and cache statistics", "sd_stat [reset]");
+
+static unsigned int sdcard_bench_rate(unsigned int bytes, long long ms)
+{
+	return ms > 0 ? (unsigned int)((unsigned long long)bytes * 1000 / ms / 1024) : 0;
+}
+
+/* write, read back and verify a file on drive 0 (card) or 1 (RAM disk), in chunk byte calls */
+int cmd_sdcard_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+	FATFS fs;
+	FIL file;
+	FRESULT fR;
+	UINT cnt;
+	BYTE *buf;
+	static BYTE work[FF_MAX_SS];
+	const char *drv = (argc > 1) ? argv[1] : "0";
+	unsigned int kb = (argc > 2) ? atoi(argv[2]) : 256;
+	unsigned int chunk = (argc > 3) ? atoi(argv[3]) : 4096;
+	unsigned int i, j, done;
+	char root[4], path[16];
+	long long start, wr_ms, rd_ms;
+	int ret = CMD_RET_FAILURE;
+
+	if (chunk == 0 || kb == 0 || strlen(drv) != 1)
+		return CMD_RET_USAGE;
+
+	snprintf(root, sizeof(root), "%s:", drv);
+	snprintf(path, sizeof(path), "%s:/bench.bin", drv);
+	buf = os_malloc(chunk);
+	if (buf == NULL)
+		return CMD_RET_FAILURE;
+
+	fR = f_mount(&fs, root, 1);
+	if (fR == FR_NO_FILESYSTEM && drv[0] == '1')
+	{
+		/* the RAM disk comes up blank */
+		fR = f_mkfs(root, 0, work, sizeof(work));
+		if (fR == FR_OK)
+			fR = f_mount(&fs, root, 1);
+	}
+	if (fR)
+	{
+		os_printf(LM_CMD, LL_INFO, "mount %s failed %d\n", root, fR);
+		goto out;
+	}
+	sdcard_get_stats(NULL, 1);
+
+	fR = f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if (fR)
+		goto fail;
+	start = os_time_get();
+	for (done = 0; done < kb * 1024 && fR == FR_OK; done += cnt)
+	{
+		for (i = 0; i < chunk; i++)
+			buf[i] = (BYTE)(done + i);
+		fR = f_write(&file, buf, chunk, &cnt);
+		if (cnt == 0)
+			break;
+	}
+	if (fR == FR_OK)
+		fR = f_close(&file);
+	else
+		f_close(&file);
+	wr_ms = os_time_get() - start;
+	if (fR)
+		goto fail;
+
+	fR = f_open(&file, path, FA_READ);
+	if (fR)
+		goto fail;
+	start = os_time_get();
+	for (i = 0, j = 0; fR == FR_OK; i += cnt)
+	{
+		fR = f_read(&file, buf, chunk, &cnt);
+		if (cnt == 0)
+			break;
+		while (j < i + cnt && buf[j - i] == (BYTE)j)
+			j++;
+		if (j != i + cnt)
+			break;
+	}
+	rd_ms = os_time_get() - start;
+	f_close(&file);
+	if (fR || j != done)
+	{
+		os_printf(LM_CMD, LL_INFO, "verify failed at %u\n", j);
+		goto fail;
+	}
+
+	os_printf(LM_CMD, LL_INFO, "%s %u KB in %u byte calls: write %u KB/s, read %u KB/s\n",
+		root, done / 1024, chunk, sdcard_bench_rate(done, wr_ms), sdcard_bench_rate(done, rd_ms));
+	if (drv[0] == '0')
+		sdcard_stats_show();
+	ret = CMD_RET_SUCCESS;
+
+fail:
+	if (ret != CMD_RET_SUCCESS)
+		os_printf(LM_CMD, LL_INFO, "bench failed %d\n", fR);
+	f_unlink(path);
+	f_unmount(root);
+out:
+	os_free(buf);
+	return ret;
+}
+
+CLI_CMD(sd_bench, cmd_sdcard_bench, "fatfs throughput on the card (0) or RAM disk (1)", "sd_bench [0|1] [kb] [chunk]");
+
 
 
 
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <stdlib.h>
 #include "cli.h"
 #include "oshal.h"
 #include "hal_system.h"
@@ -60,11 +61,54 @@ CLI_CMD(telnet,    telnet_cmd, "run telnet", "no");
 #ifdef CONFIG_SYSTEM_IRQ
 static int sys_irq_cmd(cmd_tbl_t *h, int argc, char *argv[])
 {
-	sys_irq_show();
+	if (argc < 2)
+	{
+		sys_irq_show();
+	}
+	else if (!strcmp(argv[1], "top"))
+	{
+		sys_irq_top((argc > 2) ? atoi(argv[2]) : 10, argc > 3 && !strcmp(argv[3], "total"));
+	}
+	else if (!strcmp(argv[1], "threshold") && argc > 2)
+	{
+		sys_irq_threshold_set(atoi(argv[2]));
+	}
+	else if (!strcmp(argv[1], "trig"))
+	{
+		sys_irq_trig_show();
+	}
+	else if (!strcmp(argv[1], "reset"))
+	{
+		sys_irq_reset();
+	}
+	else
+	{
+		return CMD_RET_USAGE;
+	}
 	
 	return CMD_RET_SUCCESS;
 }
-CLI_CMD(sys_irq,   sys_irq_cmd, "sys irq", "no");
+CLI_CMD(sys_irq,   sys_irq_cmd, "sys irq", "sys_irq [top [n] [max|total]] [threshold <us>] [trig] [reset]");
+#endif
+
+#ifdef CONFIG_CLI_TX_DMA
+static int console_cmd(cmd_tbl_t *h, int argc, char *argv[])
+{
+	extern CLI_DEV s_cli_dev;
+	T_DRV_UART_TX_RING_STATS stats;
+
+	if (drv_uart_ioctrl(s_cli_dev.cli_uart_num, DRV_UART_CTRL_GET_TX_RING_STATS, &stats))
+	{
+		os_printf(LM_CMD, LL_INFO, "console tx ring not open\r\n");
+		return CMD_RET_FAILURE;
+	}
+
+	os_printf(LM_CMD, LL_INFO, "tx:%d dma:%d max_fill:%d/%d\r\n", stats.tx_bytes, stats.dma_xfers, stats.max_fill, CONFIG_CLI_TX_RING_SIZE);
+	os_printf(LM_CMD, LL_INFO, "blocks:%d drops:%d truncs:%d lost:%d\r\n", stats.blocks, stats.drops, stats.truncs, stats.lost_bytes);
+
+	return CMD_RET_SUCCESS;
+}
+CLI_CMD(console,   console_cmd, "console tx ring statistics", "console");
 #endif
 
 
@@ -19,6 +19,8 @@
 /*--------------------------------------------------------------------------
 *												Include files
 --------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
 #include "cli.h"
 #include "debug_core.h"
 
@@ -87,6 +89,40 @@ int system_runtime_print(cmd_tbl_t *t, int argc, char *argv[])
 	return CMD_RET_SUCCESS;
 }
 CLI_SUBCMD(os_debug, cpu, system_runtime_print, "cpu percentage", "os_debug cpu [NONE]/[reset]");
+
+int system_runtime_top(cmd_tbl_t *t, int argc, char *argv[])
+{
+	int seconds = (argc > 1) ? atoi(argv[1]) : 1;
+	int rounds = (argc > 2) ? atoi(argv[2]) : 1;
+
+	if (seconds <= 0 || rounds <= 0)
+	{
+		return CMD_RET_USAGE;
+	}
+	if (runtime_top(seconds, rounds))
+	{
+		return CMD_RET_FAILURE;
+	}
+
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(os_debug, top, system_runtime_top, "cpu percentage per window", "os_debug top [seconds] [rounds]");
+
+int system_irqoff_print(cmd_tbl_t *t, int argc, char *argv[])
+{
+	irqoff_print(argc > 1 && !strcmp(argv[1], "reset"));
+
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(os_debug, irqoff, system_irqoff_print, "irq disabled sections", "os_debug irqoff [NONE]/[reset]");
+
+int system_runtime_overhead(cmd_tbl_t *t, int argc, char *argv[])
+{
+	runtime_overhead_print();
+
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(os_debug, overhead, system_runtime_overhead, "cpu profiler cost", "os_debug overhead");
 #endif //CONFIG_RUNTIME_DEBUG
 
 
@@ -130,7 +166,30 @@ CLI_SUBCMD(os_debug, flash_dump,    flash_dump_fun, "show crash info from flash"
 
 
 
-#if defined(CONFIG_HEAP_DEBUG) || defined(CONFIG_RUNTIME_DEBUG) || defined(CONFIG_TASK_IRQ_RUN_NUM)
-CLI_CMD(os_debug, NULL, "os debug function", "os_debug heaptrace/cpu/switch_num");
+#if defined(CONFIG_OS_TIMER_WHEEL)
+static int os_timer_stats_fun(cmd_tbl_t *t, int argc, char *argv[])
+{
+	os_timer_stats_t st;
+	unsigned int secs, sleep_ms, plain_ms;
+
+	os_timer_get_stats(&st, argc > 1 && !strcmp(argv[1], "reset"));
+	secs = st.since_ms / 1000 ? st.since_ms / 1000 : 1;
+
+	/* without coalescing every callback would have been a wakeup of its own */
+	sleep_ms = st.since_ms / (st.wakeups + 1);
+	plain_ms = st.since_ms / (st.wakeups + st.coalesced + 1);
+	os_printf(LM_OS, LL_INFO, "over %u ms: %u wakeups (%u/s), %u expiries (%u/s), %u coalesced\r\n",
+			st.since_ms, st.wakeups, st.wakeups / secs, st.expiries, st.expiries / secs, st.coalesced);
+	os_printf(LM_OS, LL_INFO, "avg sleep %u ms, %u ms without coalescing, next timer in %d ms\r\n",
+			sleep_ms, plain_ms, os_timer_next_ms());
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(os_debug, timer, os_timer_stats_fun, "os_timer wakeups", "os_debug timer [NONE]/[reset]");
+#endif
+
+
+
+#if defined(CONFIG_HEAP_DEBUG) || defined(CONFIG_RUNTIME_DEBUG) || defined(CONFIG_TASK_IRQ_RUN_NUM) || defined(CONFIG_OS_TIMER_WHEEL)
+CLI_CMD(os_debug, NULL, "os debug function", "os_debug heaptrace/cpu/top/irqoff/overhead/switch_num/timer");
 #endif
 
@@ -0,0 +1,63 @@
+/**
+ * @file cmd_systrace.c
+ * @brief Control and dump of the systrace ring
+ * @details systrace start [mask], stop, clear, dump, stat
+ */
+
+
+/*--------------------------------------------------------------------------
+*												Include files
+--------------------------------------------------------------------------*/
+#include <stdlib.h>
+#include "cli.h"
+#include "oshal.h"
+#include "systrace.h"
+
+
+/*--------------------------------------------------------------------------
+* 	                                          	Function Definitions
+--------------------------------------------------------------------------*/
+static int systrace_start_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	unsigned int mask = (argc > 1) ? strtoul(argv[1], NULL, 16) : SYSTRACE_ALL;
+
+	systrace_start(mask);
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(systrace, start, systrace_start_cmd, "trace the events in mask", "systrace start [hex mask]");
+
+static int systrace_stop_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	systrace_stop();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(systrace, stop, systrace_stop_cmd, "stop tracing, keep the records", "systrace stop");
+
+static int systrace_clear_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	systrace_clear();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(systrace, clear, systrace_clear_cmd, "drop the records", "systrace clear");
+
+static int systrace_dump_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	systrace_dump();
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(systrace, dump, systrace_dump_cmd, "print the records for systrace2json", "systrace dump");
+
+static int systrace_stat_cmd(cmd_tbl_t *t, int argc, char *argv[])
+{
+	systrace_stats_t stats;
+
+	systrace_get_stats(&stats);
+	os_printf(LM_CMD, LL_INFO, "mask 0x%x, %u records held, %u written, %u Hz\r\n",
+		stats.mask, stats.records, stats.written, stats.hz);
+	os_printf(LM_CMD, LL_INFO, "bits: 0 task, 1 irq, 2 net rx, 3 net tx, 4 flash erase, 5 flash write,"
+		" 6 malloc, 7 free, 8 mqtt publish, 9 mark\r\n");
+	return CMD_RET_SUCCESS;
+}
+CLI_SUBCMD(systrace, stat, systrace_stat_cmd, "trace state and event bits", "systrace stat");
+
+CLI_CMD(systrace, NULL, "binary event trace", "systrace start/stop/clear/dump/stat");
@@ -7,16 +7,43 @@
 /* storage control modules to the FatFs module with a defined API.       */
 /*-----------------------------------------------------------------------*/
 
+#include <string.h>
 #include "ff.h"			/* Obtains integer types */
 #include "diskio.h"		/* Declarations of disk functions */
 #include "sdcard.h"
 #include "cli.h"
+#include "oshal.h"
 
 /* Definitions of physical drive number for each drive */
 #define DEV_RAM		1	/* Example: Map Ramdisk to physical drive 0 */
 #define DEV_MMC		0	/* Example: Map MMC/SD card to physical drive 1 */
 #define DEV_USB		2	/* Example: Map USB MSD to physical drive 2 */
 
+#ifdef CONFIG_FATFS_RAMDISK
+/* heap backed volume "1:", a stand-in to compare the card path against */
+static BYTE *ram_disk;
+
+static DSTATUS RAM_disk_initialize(void)
+{
+	if (ram_disk == NULL)
+		ram_disk = os_zalloc(CONFIG_FATFS_RAMDISK_SECTORS * FF_MIN_SS);
+	return ram_disk ? RES_OK : STA_NOINIT;
+}
+
+static DRESULT RAM_disk_rw(BYTE *buff, LBA_t sector, UINT count, int write)
+{
+	if (ram_disk == NULL)
+		return RES_NOTRDY;
+	if (sector >= CONFIG_FATFS_RAMDISK_SECTORS || count > CONFIG_FATFS_RAMDISK_SECTORS - sector)
+		return RES_PARERR;
+	if (write)
+		memcpy(ram_disk + sector * FF_MIN_SS, buff, count * FF_MIN_SS);
+	else
+		memcpy(buff, ram_disk + sector * FF_MIN_SS, count * FF_MIN_SS);
+	return RES_OK;
+}
+#endif
+
 
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
@@ -34,7 +61,10 @@ DSTATUS disk_status (
 		//result = RAM_disk_status();
 
 		// translate the reslut code here
-
+#ifdef CONFIG_FATFS_RAMDISK
+		if (ram_disk == NULL)
+			stat = STA_NOINIT;
+#endif
 		return stat;
 
 	case DEV_MMC :
@@ -73,8 +103,11 @@ DSTATUS disk_initialize (
 		//result = RAM_disk_initialize();
 
 		// translate the reslut code here
-
+#ifdef CONFIG_FATFS_RAMDISK
+		return RAM_disk_initialize();
+#else
 		return RES_OK;
+#endif
 
 	case DEV_MMC :
 		result = sdcard_init();
@@ -126,6 +159,9 @@ DRESULT disk_read (
 
 		// translate the reslut code here
 		//res = sdcard_read(buff, sector, count);
+#ifdef CONFIG_FATFS_RAMDISK
+		res = RAM_disk_rw(buff, sector, count, 0);
+#endif
 
 		return res;
 
@@ -179,6 +215,9 @@ DRESULT disk_write (
 		//result = sdcard_write(buff, sector, count);
 		//if(result == 0)
 		//	res = RES_OK;
+#ifdef CONFIG_FATFS_RAMDISK
+		res = RAM_disk_rw((BYTE *)buff, sector, count, 1);
+#endif
 
 		return res;
 
@@ -188,6 +227,8 @@ DRESULT disk_write (
 		result = sdcard_write(buff, sector, count);
 		if(result == 0)
 			res = RES_OK;
+		else
+			res = RES_ERROR;
 
 		// translate the reslut code here
 
@@ -226,7 +267,12 @@ DRESULT disk_ioctl (
 	case DEV_RAM :
 
 		// Process of the command for the RAM drive
-
+#ifdef CONFIG_FATFS_RAMDISK
+		if(GET_SECTOR_COUNT==cmd)
+			*(LBA_t*)buff = CONFIG_FATFS_RAMDISK_SECTORS;
+		else if(GET_BLOCK_SIZE==cmd)
+			*(DWORD*)buff = 1;
+#endif
 		return res;
 
 	case DEV_MMC :
@@ -234,7 +280,7 @@ DRESULT disk_ioctl (
 		// Process of the command for the MMC/SD card
 		if(CTRL_SYNC==cmd)
 			{
-			res = 0;
+			res = sdcard_sync();
 			}
 		else if(GET_SECTOR_COUNT==cmd)
 			{
@@ -47,8 +47,24 @@
     #define HTTP_CLIENT_WORK_QUEUE_SIZE             1
 #endif // !HTTP_CLIENT_POOL_SIZE
 
+#ifndef HTTP_CONN_POOL_SIZE
+    #define HTTP_CONN_POOL_SIZE                     2
+#endif // !HTTP_CONN_POOL_SIZE
+
+#ifndef HTTP_CONN_POOL_IDLE_TIMEOUT
+    #define HTTP_CONN_POOL_IDLE_TIMEOUT             30000
+#endif // !HTTP_CONN_POOL_IDLE_TIMEOUT
+
+#ifndef HTTP_HEADER_SPAN_SIZE
+    #define HTTP_HEADER_SPAN_SIZE                   128
+#endif // !HTTP_HEADER_SPAN_SIZE
+
 #define HTTP_MESSAGE_BUFFER_GROWTH  64
 
+#ifndef HTTP_REQUEST_HEADER_SIZE
+    #define HTTP_REQUEST_HEADER_SIZE                320     /* the default headers fit without a realloc */
+#endif // !HTTP_REQUEST_HEADER_SIZE
+
 #define HTTP_VERSION_SRTING     "HTTP/"
 #define HTTP_VERSION_MAJOR      "1"
 #define HTTP_VERSION_MINOR      ".1"
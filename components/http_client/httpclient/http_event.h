@@ -23,7 +23,8 @@ typedef enum http_event_type {
     http_event_type_on_body = 0x0001 << 4,
     http_event_type_on_submit = 0x0001 << 5,
     http_event_type_on_release = 0x0001 << 6,
-    http_event_type_all = 0x0001 << 7
+    http_event_type_on_header = 0x0001 << 7,        /* one response header, data is http_response_header_t */
+    http_event_type_all = 0x0001 << 8
 } http_event_type_t;
 
 typedef struct http_event {
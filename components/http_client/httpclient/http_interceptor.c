@@ -14,9 +14,53 @@
 #include <http_url_parser.h>
 #include <platform_memory.h>
 #include <platform_timer.h>
+#include <platform_mutex.h>
+#ifdef HTTP_USING_CONN_POOL
+#include <network_pool.h>
+#endif
+
+/* http_interceptor_t.header_state */
+#define HTTP_HEADER_NONE            0
+#define HTTP_HEADER_FIELD           1       /* field complete, value to come */
+#define HTTP_HEADER_FIELD_CUT       2       /* field ran up to the window end */
+#define HTTP_HEADER_VALUE           3       /* value seen, handed out once known whole */
 
 static const char *_http_interceptor_ca = NULL;
 
+/* the last receive window given back, taken by the next request instead of a new one */
+static char *_http_interceptor_window = NULL;
+static platform_mutex_t _http_interceptor_window_lock;
+static int _http_interceptor_window_ready = 0;
+
+static char *_http_interceptor_window_take(void)
+{
+    char *window;
+
+    if (!_http_interceptor_window_ready) {
+        platform_mutex_init(&_http_interceptor_window_lock);
+        _http_interceptor_window_ready = 1;
+    }
+
+    platform_mutex_lock(&_http_interceptor_window_lock);
+    window = _http_interceptor_window;
+    _http_interceptor_window = NULL;
+    platform_mutex_unlock(&_http_interceptor_window_lock);
+
+    return window ? window : platform_memory_alloc(HTTP_DEFAULT_BUF_SIZE);
+}
+
+static void _http_interceptor_window_give(char *window)
+{
+    platform_mutex_lock(&_http_interceptor_window_lock);
+    if (NULL == _http_interceptor_window) {
+        _http_interceptor_window = window;
+        window = NULL;
+    }
+    platform_mutex_unlock(&_http_interceptor_window_lock);
+
+    platform_memory_free(window);
+}
+
 static int _http_read_buffer(http_interceptor_t *interceptor, size_t length)
 {
     int len = 0;
@@ -26,14 +70,17 @@ static int _http_read_buffer(http_interceptor_t *interceptor, size_t length)
 
     if ((0 == length) || (length > interceptor->buffer_len))
         length = interceptor->buffer_len;
-    
-    memset(interceptor->buffer, 0, interceptor->buffer_len);
 
     platform_timer_init(&timer);
     platform_timer_cutdown(&timer, interceptor->cmd_timeout);
 
     len = network_read(interceptor->network, (unsigned char *)interceptor->buffer, length, platform_timer_remain(&timer));
 
+#ifdef HTTP_USING_CONN_POOL
+    /* both come back as no bytes: a timeout uses the time up, a close or reset returns early */
+    interceptor->closed = (len <= 0) && (platform_timer_remain(&timer) > interceptor->cmd_timeout / 2);
+#endif
+
     RETURN_ERROR(len);
 }
 
@@ -116,11 +163,72 @@ static int _http_on_status(http_parser *parser, const char *at, size_t length)
     return 0;
 }
 
+/* <len> more bytes of the header into the span, cut when it is full */
+static void _http_header_gather(http_interceptor_t *interceptor, const char *at, size_t len)
+{
+    size_t room = sizeof(interceptor->header_span) - interceptor->header_used;
+
+    if (len > room)
+        len = room;
+
+    memcpy(interceptor->header_span + interceptor->header_used, at, len);
+    interceptor->header_used += len;
+}
+
+/* the header points into the window, which the next read overwrites: move it to the span */
+static void _http_header_keep(http_interceptor_t *interceptor)
+{
+    http_response_header_t *h = &interceptor->header;
+
+    if (h->field != interceptor->header_span) {
+        interceptor->header_used = 0;
+        _http_header_gather(interceptor, h->field, h->field_len);
+        h->field = interceptor->header_span;
+        h->field_len = interceptor->header_used;
+    }
+
+    if ((NULL != h->value) && (h->value != interceptor->header_span + h->field_len)) {
+        _http_header_gather(interceptor, h->value, h->value_len);
+        h->value = interceptor->header_span + h->field_len;
+        h->value_len = interceptor->header_used - h->field_len;
+    }
+}
+
+static void _http_header_dispatch(http_interceptor_t *interceptor)
+{
+    if (HTTP_HEADER_VALUE == interceptor->header_state)
+        http_event_dispatch(interceptor->evetn, http_event_type_on_header, interceptor,
+                            &interceptor->header, sizeof(interceptor->header));
+
+    interceptor->header_state = HTTP_HEADER_NONE;
+}
+
 static int _http_on_header_field(http_parser *parser, const char *at, size_t length)
 {
     http_interceptor_t *interceptor = parser->data;
+    http_response_header_t *h = &interceptor->header;
     HTTP_LOG_D("%.*s :", (int)length, at);
 
+    /* a value that ran up to the window end was whole after all */
+    if (HTTP_HEADER_VALUE == interceptor->header_state)
+        _http_header_dispatch(interceptor);
+
+    if (HTTP_HEADER_FIELD_CUT == interceptor->header_state) {
+        _http_header_gather(interceptor, at, length);
+        h->field_len = interceptor->header_used;
+    } else {
+        h->field = at;
+        h->field_len = length;
+        h->value = NULL;
+        h->value_len = 0;
+    }
+
+    interceptor->header_state = HTTP_HEADER_FIELD;
+    if (at + length == interceptor->buffer_end) {
+        _http_header_keep(interceptor);
+        interceptor->header_state = HTTP_HEADER_FIELD_CUT;
+    }
+
     if(0 == http_utils_ignore_case_nmatch(at, "Location", 8)) {
         interceptor->flag.flag_t.redirects = 1;
     } else if(0 == http_utils_ignore_case_nmatch(at, "Transfer-Encoding", 17)) {
@@ -135,6 +243,7 @@ static int _http_on_header_field(http_parser *parser, const char *at, size_t len
 static int _http_on_header_value(http_parser *parser, const char *at, size_t length)
 {
     http_interceptor_t *interceptor = parser->data;
+    http_response_header_t *h = &interceptor->header;
 
     if (0 != interceptor->flag.flag_t.redirects) {
         http_set_connect_params_url(interceptor->connect_params, at, length);
@@ -142,6 +251,24 @@ static int _http_on_header_value(http_parser *parser, const char *at, size_t len
     }
 
     HTTP_LOG_D("%.*s\n", (int)length, at);
+
+    if (HTTP_HEADER_VALUE == interceptor->header_state) {
+        _http_header_gather(interceptor, at, length);
+        h->value_len = interceptor->header_used - h->field_len;
+    } else if (HTTP_HEADER_NONE != interceptor->header_state) {
+        h->value = at;
+        h->value_len = length;
+    } else {
+        return 0;       /* folded continuation of a header already handed out */
+    }
+
+    /* followed by its CR in the window it is whole, else the next callback tells */
+    interceptor->header_state = HTTP_HEADER_VALUE;
+    if (at + length == interceptor->buffer_end)
+        _http_header_keep(interceptor);
+    else
+        _http_header_dispatch(interceptor);
+
     return 0;
 }
 
@@ -149,6 +276,8 @@ static int _http_on_headers_complete(http_parser *parser)
 {
     http_interceptor_t *interceptor = parser->data;
 
+    _http_header_dispatch(interceptor);
+
     http_response_set_status(&interceptor->response, parser->status_code);
     http_response_set_offset(&interceptor->response, parser->nread);
     http_response_set_length(&interceptor->response, parser->content_length);
@@ -166,6 +295,7 @@ static int _http_on_message_begin(http_parser *parser)
 {
     http_interceptor_t *interceptor = parser->data;
     HTTP_LOG_D("_http_on_message_begin");
+    interceptor->header_state = HTTP_HEADER_NONE;
     http_event_dispatch(interceptor->evetn, http_event_type_on_response, interceptor, NULL, 0);
     return 0;
 }
@@ -181,6 +311,14 @@ static int _http_on_message_complete(http_parser *parser)
 
     interceptor->flag.flag_t.complete = 1;      /* complete */
 
+#ifdef HTTP_USING_CONN_POOL
+    interceptor->reusable = http_should_keep_alive(parser);
+
+    /* stop right behind this response, the next one is parsed anew */
+    if (interceptor->pipeline)
+        http_parser_pause(parser, 1);
+#endif
+
     return 0;
 }
 
@@ -207,6 +345,21 @@ static int _http_on_chunk_complete(http_parser *parser)
     return 0;
 }
 
+/* the parser hands spans of <data> to the callbacks, they need to know where it ends */
+static size_t _http_parse_buffer(http_interceptor_t *interceptor, const char *data, size_t len)
+{
+    size_t n;
+
+    interceptor->buffer_end = data + len;
+    n = http_parser_execute(interceptor->parser, interceptor->parser_settings, data, len);
+
+    /* a field whose value starts only with the next read */
+    if (HTTP_HEADER_FIELD == interceptor->header_state)
+        _http_header_keep(interceptor);
+
+    return n;
+}
+
 static int _http_interceptor_parser_setting(http_interceptor_t *interceptor)
 {
     interceptor->parser_settings->on_url = _http_on_url;
@@ -290,16 +443,26 @@ int http_interceptor_init(http_interceptor_t *interceptor)
     http_response_init(&interceptor->response);
 
     interceptor->cmd_timeout = HTTP_DEFAULT_CMD_TIMEOUT;
-    interceptor->buffer_len = HTTP_DEFAULT_BUF_SIZE;
+    if (!interceptor->buffer_user)
+        interceptor->buffer_len = HTTP_DEFAULT_BUF_SIZE;
+    interceptor->header_state = HTTP_HEADER_NONE;
     interceptor->data_process = 0;
     interceptor->flag.all_flag = 0;
     interceptor->owner = NULL;
+#ifdef HTTP_USING_CONN_POOL
+    interceptor->reused = 0;
+    interceptor->closed = 0;
+    interceptor->reusable = 0;
+    interceptor->pipeline = 0;
+    interceptor->index = 0;
+    interceptor->pending = 0;
+#endif
     
     if (NULL == interceptor->evetn)
         interceptor->evetn = http_event_init();
 
     if (NULL == interceptor->buffer)
-        interceptor->buffer = platform_memory_alloc(interceptor->buffer_len);
+        interceptor->buffer = _http_interceptor_window_take();
 
     HTTP_ROBUSTNESS_CHECK((interceptor->evetn && interceptor->buffer), HTTP_MEM_NOT_ENOUGH_ERROR);
 
@@ -362,7 +525,15 @@ int http_interceptor_connect(http_interceptor_t *interceptor)
     if (http_interceptor_status_init != _http_interceptor_get_status(interceptor))
         RETURN_ERROR(HTTP_SUCCESS_ERROR);
 
+#ifdef HTTP_USING_CONN_POOL
+    res = network_pool_connect(interceptor->network, 1);
+    interceptor->reused = (res == 1);
+    interceptor->closed = 0;
+    if (res > 0)
+        res = HTTP_SUCCESS_ERROR;
+#else
     res = network_connect(interceptor->network);
+#endif
 
     if (HTTP_SUCCESS_ERROR == res) {
         _http_interceptor_set_status(interceptor, http_interceptor_status_connect);
@@ -375,35 +546,40 @@ int http_interceptor_connect(http_interceptor_t *interceptor)
     RETURN_ERROR(res);
 }
 
-int http_interceptor_request(http_interceptor_t *interceptor, http_request_method_t mothod, const char *post_buf)
+/* build the request for path (and query) and send it */
+static int _http_interceptor_send_request(http_interceptor_t *interceptor, http_request_method_t mothod,
+                                          const char *path, const char *query, const char *post_buf)
 {
     int res = HTTP_SUCCESS_ERROR;
-    HTTP_ROBUSTNESS_CHECK((interceptor && mothod), HTTP_NULL_VALUE_ERROR);
-    
-    http_request_init(&interceptor->request);
-
-    if (NULL == interceptor->message)
-        interceptor->message = http_message_buffer_init(0);
 
-    if (http_interceptor_status_connect != _http_interceptor_get_status(interceptor))
-        RETURN_ERROR(HTTP_SUCCESS_ERROR);
+    http_request_init(&interceptor->request);
 
     http_request_set_method(&interceptor->request, mothod);
 
     http_event_dispatch(interceptor->evetn, http_event_type_on_request, interceptor, NULL, 0);
 
-    if (NULL == http_get_connect_params_query(interceptor->connect_params)) {
-        http_request_set_start_line(&interceptor->request, http_get_connect_params_path(interceptor->connect_params));
+#ifdef HTTP_USING_CONN_POOL
+    /* the session goes back to the pool afterwards */
+    http_request_set_keep_alive(&interceptor->request);
+    interceptor->reusable = 0;
+#endif
+
+    if (NULL == query) {
+        http_request_set_start_line(&interceptor->request, path);
     } else {
-        http_request_set_start_line_with_query(&interceptor->request, 
-                                                http_get_connect_params_path(interceptor->connect_params), 
-                                                http_get_connect_params_query(interceptor->connect_params));
+        http_request_set_start_line_with_query(&interceptor->request, path, query);
     }
 
     http_request_header_init(&interceptor->request);
     http_request_add_header_form_index(&interceptor->request, 
                                         HTTP_REQUEST_HEADER_HOST, 
                                         http_get_connect_params_host(interceptor->connect_params));
+
+    /* a range holds for one request only */
+    if (interceptor->range[0]) {
+        http_request_add_header_form_index(&interceptor->request, HTTP_REQUEST_HEADER_RANGE, interceptor->range);
+        interceptor->range[0] = '\0';
+    }
     
     if (NULL != post_buf) {
 
@@ -417,6 +593,11 @@ int http_interceptor_request(http_interceptor_t *interceptor, http_request_metho
         }
     }
 
+    /* the whole message at once, it is not grown piece by piece */
+    if (NULL == interceptor->message)
+        interceptor->message = http_message_buffer_init(interceptor->request.req_msg.line->used +
+                                                        interceptor->request.req_msg.header->used +
+                                                        interceptor->request.req_msg.body->used + 2);
     http_message_buffer_reinit(interceptor->message);
 
     http_message_buffer_cover(interceptor->message, 
@@ -424,28 +605,43 @@ int http_interceptor_request(http_interceptor_t *interceptor, http_request_metho
                               http_request_get_header_data(&interceptor->request), 
                               HTTP_CRLF, NULL);                  
 
+    /* nothing after the body, not even the terminating 0: on a kept-alive session it reads as the next request */
     http_message_buffer_concat( interceptor->message, 
                                 http_request_get_body_data(&interceptor->request), 
-                                HTTP_CRLF, NULL);
+                                NULL);
     // http_request_print_start_line(&interceptor->request);
     // http_request_print_header(&interceptor->request);
     HTTP_LOG_I("len:%ld\ndata:%s", http_message_buffer_get_used(interceptor->message), http_message_buffer_get_data(interceptor->message));
     res = _http_write_buffer(interceptor, 
                             (unsigned char *)http_message_buffer_get_data(interceptor->message), 
-                            http_message_buffer_get_used(interceptor->message));
+                            http_message_buffer_get_used(interceptor->message) - 1);
 
     /* send data successfully, free the memory space of the request message*/
     http_request_release(&interceptor->request);
-    
-    if (HTTP_SUCCESS_ERROR == res) {
 
-        _http_interceptor_set_status(interceptor, http_interceptor_status_request);
+    if (interceptor->message) {
+        http_message_buffer_release(interceptor->message);
+        interceptor->message = NULL;
+    }
 
-        if (interceptor->message) {
-            http_message_buffer_release(interceptor->message);
-            interceptor->message = NULL;
-        }
+    RETURN_ERROR(res);
+}
 
+int http_interceptor_request(http_interceptor_t *interceptor, http_request_method_t mothod, const char *post_buf)
+{
+    int res = HTTP_SUCCESS_ERROR;
+    HTTP_ROBUSTNESS_CHECK((interceptor && mothod), HTTP_NULL_VALUE_ERROR);
+
+    if (http_interceptor_status_connect != _http_interceptor_get_status(interceptor))
+        RETURN_ERROR(HTTP_SUCCESS_ERROR);
+
+    res = _http_interceptor_send_request(interceptor, mothod,
+                                         http_get_connect_params_path(interceptor->connect_params),
+                                         http_get_connect_params_query(interceptor->connect_params),
+                                         post_buf);
+
+    if (HTTP_SUCCESS_ERROR == res) {
+        _http_interceptor_set_status(interceptor, http_interceptor_status_request);
     } else {
         _http_interceptor_set_status(interceptor, http_interceptor_status_release);
     }
@@ -470,7 +666,7 @@ int http_interceptor_fetch_headers(http_interceptor_t *interceptor)
         if (len <= 0) {
             RETURN_ERROR(len);
         } else {
-            http_parser_execute(interceptor->parser, interceptor->parser_settings, interceptor->buffer, len);
+            _http_parse_buffer(interceptor, interceptor->buffer, len);
         }
     }
 
@@ -501,6 +697,10 @@ int http_interceptor_release(http_interceptor_t *interceptor)
         RETURN_ERROR(HTTP_SUCCESS_ERROR);
 
     if (interceptor->network) {
+#ifdef HTTP_USING_CONN_POOL
+        network_pool_release(interceptor->network, interceptor->reusable);
+        interceptor->reusable = 0;
+#endif
         network_release(interceptor->network);
         platform_memory_free(interceptor->network);
         interceptor->network = NULL;
@@ -527,8 +727,10 @@ int http_interceptor_release(http_interceptor_t *interceptor)
     }
 
     if (interceptor->buffer) {
-        platform_memory_free(interceptor->buffer);
+        if (!interceptor->buffer_user)
+            _http_interceptor_window_give(interceptor->buffer);
         interceptor->buffer = NULL;
+        interceptor->buffer_user = 0;
     }
 
     // http_request_release(&interceptor->request);
@@ -552,7 +754,7 @@ int http_interceptor_fetch_data(http_interceptor_t *interceptor)
         if (len <= 0) {
             return HTTP_SOCKET_TIMEOUT_ERROR;
         } else {
-            http_parser_execute(interceptor->parser, interceptor->parser_settings, interceptor->buffer, len);
+            _http_parse_buffer(interceptor, interceptor->buffer, len);
 
             if (interceptor->parser->http_errno) {
                 HTTP_LOG_E("http errno %d\n", interceptor->parser->http_errno);
@@ -571,6 +773,43 @@ int http_interceptor_fetch_data(http_interceptor_t *interceptor)
 }
 
 
+#ifdef HTTP_USING_CONN_POOL
+/* 
+ * a pooled session the server closed while idle fails before a byte of the
+ * response came: drop it and go again on a new one, once. Only when the
+ * read saw the close, a slow server times out the same way but may still
+ * act on the request, and only for GET/HEAD, which are safe to send twice.
+ */
+static int _http_interceptor_retry_stale(http_interceptor_t *interceptor, http_request_method_t method)
+{
+    http_interceptor_status_t status = _http_interceptor_get_status(interceptor);
+
+    if (!interceptor->reused || !interceptor->closed || interceptor->parser->nread != 0)
+        return 0;
+
+    if ((HTTP_REQUEST_METHOD_GET != method) && (HTTP_REQUEST_METHOD_HEAD != method))
+        return 0;
+
+    if ((http_interceptor_status_release != status) && (http_interceptor_status_response_headers != status))
+        return 0;
+
+    HTTP_LOG_I("pooled session to %s is gone, connecting again\n", interceptor->network->host);
+
+    network_pool_drop(interceptor->network);
+    interceptor->reused = 0;
+    interceptor->pending = 0;
+    http_parser_init(interceptor->parser, HTTP_RESPONSE);
+
+    if (HTTP_SUCCESS_ERROR != network_pool_connect(interceptor->network, 0)) {
+        _http_interceptor_set_status(interceptor, http_interceptor_status_release);
+        return 0;
+    }
+
+    _http_interceptor_set_status(interceptor, http_interceptor_status_connect);
+    return 1;
+}
+#endif
+
 int http_interceptor_process(http_interceptor_t *interceptor,
                              http_connect_params_t *connect_params,
                              http_request_method_t mothod, 
@@ -580,6 +819,9 @@ int http_interceptor_process(http_interceptor_t *interceptor,
 {
     int res = HTTP_SUCCESS_ERROR;
     HTTP_ROBUSTNESS_CHECK((interceptor && connect_params && mothod), HTTP_NULL_VALUE_ERROR);
+#ifdef HTTP_USING_CONN_POOL
+    unsigned long start = platform_timer_now();
+#endif
 
     // do {
         if (interceptor->flag.flag_t.again) {
@@ -604,9 +846,18 @@ int http_interceptor_process(http_interceptor_t *interceptor,
 
             case http_interceptor_status_request:
                 http_interceptor_fetch_headers(interceptor);
+#ifdef HTTP_USING_CONN_POOL
+                if (_http_interceptor_retry_stale(interceptor, mothod)) {
+                    http_interceptor_request(interceptor, mothod, post_buf);
+                    http_interceptor_fetch_headers(interceptor);
+                }
+                /* no response and not sent again: the caller gets the error */
+                if (http_interceptor_status_response_headers == _http_interceptor_get_status(interceptor))
+                    res = HTTP_SOCKET_TIMEOUT_ERROR;
+#endif
 
             case http_interceptor_status_headers_complete:
-                if (mothod != HTTP_REQUEST_METHOD_HEAD) {
+                if ((mothod != HTTP_REQUEST_METHOD_HEAD) && (HTTP_SUCCESS_ERROR == res)) {
                     http_interceptor_check_response(interceptor);
                     res = http_interceptor_fetch_data(interceptor);
                     if (res > 0) {
@@ -626,12 +877,161 @@ int http_interceptor_process(http_interceptor_t *interceptor,
         }
 
     // } while (interceptor->flag.flag_t.again);
+#ifdef HTTP_USING_CONN_POOL
+    network_pool_request_done(1, platform_timer_now() - start);
+#endif
     RETURN_ERROR(res);
 }
 
+#ifdef HTTP_USING_CONN_POOL
+/* one whole response, the bytes read past it stay in the buffer for the next one */
+static int _http_interceptor_fetch_message(http_interceptor_t *interceptor)
+{
+    size_t n;
+    int len;
+
+    http_parser_init(interceptor->parser, HTTP_RESPONSE);
+    http_response_init(&interceptor->response);
+    interceptor->data_process = 0;
+    interceptor->flag.flag_t.chunked = 0;
+    interceptor->flag.flag_t.chunked_complete = 0;
+    interceptor->flag.flag_t.complete = 0;
+    interceptor->reusable = 0;
+
+    while (0 == interceptor->flag.flag_t.complete) {
+        if (0 == interceptor->pending) {
+            len = _http_read_buffer(interceptor, interceptor->buffer_len);
+            if (len <= 0)
+                RETURN_ERROR(HTTP_SOCKET_TIMEOUT_ERROR);
+
+            interceptor->pending = len;
+            interceptor->pending_offset = 0;
+        }
+
+        n = _http_parse_buffer(interceptor, interceptor->buffer + interceptor->pending_offset, interceptor->pending);
+
+        if ((HPE_OK != HTTP_PARSER_ERRNO(interceptor->parser)) && (HPE_PAUSED != HTTP_PARSER_ERRNO(interceptor->parser))) {
+            HTTP_LOG_E("http errno %d\n", interceptor->parser->http_errno);
+            RETURN_ERROR(HTTP_FAILED_ERROR);
+        }
+
+        interceptor->pending_offset += n;
+        interceptor->pending -= n;
+    }
+
+    RETURN_ERROR(HTTP_SUCCESS_ERROR);
+}
+
+/*
+ * GET paths[0..count) from the server of connect_params on one session,
+ * all requests sent before the first response is read. The events of
+ * response i come with index i. Returns the number of responses read
+ * whole; the ones after a failed or closing response are not answered.
+ */
+int http_interceptor_pipeline(http_interceptor_t *interceptor,
+                              http_connect_params_t *connect_params,
+                              const char *paths[],
+                              size_t count,
+                              void *owner,
+                              http_event_cb_t cb)
+{
+    unsigned long start = platform_timer_now();
+    size_t i, done = 0;
+    int res = HTTP_SUCCESS_ERROR;
+
+    HTTP_ROBUSTNESS_CHECK((interceptor && connect_params && paths), HTTP_NULL_VALUE_ERROR);
+
+    if (http_interceptor_status_invalid != _http_interceptor_get_status(interceptor))
+        RETURN_ERROR(HTTP_FAILED_ERROR);
+
+    http_interceptor_init(interceptor);
+    http_interceptor_set_owner(interceptor, owner);
+    http_interceptor_event_register(interceptor, cb);
+    http_interceptor_set_connect_params(interceptor, connect_params);
+    http_interceptor_connect(interceptor);
+
+    if (http_interceptor_status_connect == _http_interceptor_get_status(interceptor)) {
+        interceptor->pipeline = 1;
+
+        for (i = 0; (i < count) && (HTTP_SUCCESS_ERROR == res); i++) {
+            res = _http_interceptor_send_request(interceptor, HTTP_REQUEST_METHOD_GET, paths[i], NULL, NULL);
+        }
+
+        /* nothing at all back on a pooled session: it was stale, all go again on a new one */
+        if (HTTP_SUCCESS_ERROR == res) {
+            interceptor->index = 0;
+            res = _http_interceptor_fetch_message(interceptor);
+        }
+        if ((HTTP_SUCCESS_ERROR != res) && (0 == http_response_get_status(&interceptor->response))) {
+            _http_interceptor_set_status(interceptor, http_interceptor_status_response_headers);
+            if (_http_interceptor_retry_stale(interceptor, HTTP_REQUEST_METHOD_GET)) {
+                for (i = 0, res = HTTP_SUCCESS_ERROR; (i < count) && (HTTP_SUCCESS_ERROR == res); i++) {
+                    res = _http_interceptor_send_request(interceptor, HTTP_REQUEST_METHOD_GET, paths[i], NULL, NULL);
+                }
+                if (HTTP_SUCCESS_ERROR == res)
+                    res = _http_interceptor_fetch_message(interceptor);
+            }
+        }
+
+        while (HTTP_SUCCESS_ERROR == res) {
+            done++;
+            if ((done == count) || !interceptor->reusable)
+                break;
+            interceptor->index = done;
+            res = _http_interceptor_fetch_message(interceptor);
+        }
+
+        /* anything unread left behind makes the session useless */
+        if ((done != count) || (0 != interceptor->pending))
+            interceptor->reusable = 0;
+
+        interceptor->pipeline = 0;
+    }
+
+    _http_interceptor_set_status(interceptor, http_interceptor_status_release);
+    http_interceptor_release(interceptor);
+
+    network_pool_request_done(done, platform_timer_now() - start);
+
+    return (int)done;
+}
+#endif
+
 void http_interceptor_set_keep_alive(http_interceptor_t *interceptor)
 {
     http_request_set_keep_alive(&interceptor->request);
     interceptor->flag.flag_t.keep_alive = 1;
 }
 
+/*
+ * receive into the caller's <buf> of <len> bytes for the next request
+ * instead of a window of HTTP_DEFAULT_BUF_SIZE from the heap; <buf> has to
+ * stay until the request is done. headers and body reach the events as
+ * spans of it.
+ */
+void http_interceptor_set_buffer(http_interceptor_t *interceptor, char *buf, size_t len)
+{
+    HTTP_ROBUSTNESS_CHECK((interceptor && buf && len), HTTP_VOID);
+
+    if (http_interceptor_status_invalid != _http_interceptor_get_status(interceptor))
+        return;
+
+    if (interceptor->buffer && !interceptor->buffer_user)
+        _http_interceptor_window_give(interceptor->buffer);
+
+    interceptor->buffer = buf;
+    interceptor->buffer_len = len;
+    interceptor->buffer_user = 1;
+}
+
+/* ask for bytes first..last of the body, up to the end when last is 0 */
+void http_interceptor_set_range(http_interceptor_t *interceptor, size_t first, size_t last)
+{
+    HTTP_ROBUSTNESS_CHECK(interceptor, HTTP_VOID);
+
+    if (last == 0)
+        snprintf(interceptor->range, sizeof(interceptor->range), "bytes=%u-", (unsigned int)first);
+    else
+        snprintf(interceptor->range, sizeof(interceptor->range), "bytes=%u-%u", (unsigned int)first, (unsigned int)last);
+}
+
@@ -35,14 +35,30 @@ typedef struct http_interceptor {
     http_response_t             response;
     http_interceptor_status_t   status;
     http_message_buffer_t       *message;
-    char                        *buffer;
+    char                        *buffer;        /* receive window, the parser hands out spans of it */
     size_t                      buffer_len;
+    uint8_t                     buffer_user;    /* buffer is the caller's, see http_interceptor_set_buffer() */
+    const char                  *buffer_end;    /* end of the bytes being parsed */
     size_t                      cmd_timeout;
     size_t                      data_process;
     struct http_parser          *parser;
     struct http_parser_settings *parser_settings;
     http_event_t                *evetn;
     void                        *owner;
+    char                        range[32];      /* Range: value of the next request, "" for the whole body */
+    http_response_header_t      header;         /* header being gathered for http_event_type_on_header */
+    uint8_t                     header_state;
+    size_t                      header_used;
+    char                        header_span[HTTP_HEADER_SPAN_SIZE];    /* a header cut by the window end */
+#ifdef HTTP_USING_CONN_POOL
+    uint8_t                     reused;         /* the session came from the pool */
+    uint8_t                     closed;         /* last read failed early: closed or reset, not a timeout */
+    uint8_t                     reusable;       /* response read to the end, server keeps the session */
+    uint8_t                     pipeline;       /* http_interceptor_pipeline() running */
+    size_t                      index;          /* pipeline: response the events are for */
+    size_t                      pending;        /* pipeline: bytes of the next response in buffer */
+    size_t                      pending_offset;
+#endif
     HTTP_GENERAL_FLAG;
 } http_interceptor_t;
 
@@ -53,6 +69,8 @@ void http_interceptor_set_owner(http_interceptor_t *interceptor, void *owner);
 void http_interceptor_event_register(http_interceptor_t *interceptor, http_event_cb_t cb);
 int http_interceptor_connect(http_interceptor_t *interceptor);
 void http_interceptor_set_keep_alive(http_interceptor_t *interceptor);
+void http_interceptor_set_range(http_interceptor_t *interceptor, size_t first, size_t last);
+void http_interceptor_set_buffer(http_interceptor_t *interceptor, char *buf, size_t len);
 int http_interceptor_set_connect_params(http_interceptor_t *interceptor, http_connect_params_t *conn_param);
 int http_interceptor_request(http_interceptor_t *interceptor, http_request_method_t mothod, const char *post_buf);
 int http_interceptor_release(http_interceptor_t *interceptor);
@@ -62,5 +80,13 @@ int http_interceptor_process(http_interceptor_t *interceptor,
                              void *post_buf,
                              void *owner,
                              http_event_cb_t cb);
+#ifdef HTTP_USING_CONN_POOL
+int http_interceptor_pipeline(http_interceptor_t *interceptor,
+                              http_connect_params_t *connect_params,
+                              const char *paths[],
+                              size_t count,
+                              void *owner,
+                              http_event_cb_t cb);
+#endif
 
 #endif // !_HTTP_INTERCEPTOR_H_
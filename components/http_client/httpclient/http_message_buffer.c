@@ -15,7 +15,9 @@
 void http_message_buffer_grow(http_message_buffer_t *buf, size_t newsize)
 {
     if (newsize > buf->length) {
-        /* if it's not big enough already... */
+        /* if it's not big enough already... at least double, a header at a time is a realloc each */
+        if (newsize < buf->length * 2)
+            newsize = buf->length * 2;
         buf->length = ((newsize / HTTP_MESSAGE_BUFFER_GROWTH) + 1) * HTTP_MESSAGE_BUFFER_GROWTH;
 
         buf->data = platform_memory_realloc(buf->data, buf->length);
@@ -49,7 +51,7 @@ int http_message_buffer_reinit(http_message_buffer_t *buf)
         HTTP_ROBUSTNESS_CHECK((buf->data), HTTP_MEM_NOT_ENOUGH_ERROR);
     }
     
-    memset(buf->data, 0, buf->length);
+    /* the string ends at used, what lies behind is never read */
     buf->data[0] = '\0';
     buf->used = 1;
 
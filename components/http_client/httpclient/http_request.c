@@ -163,7 +163,7 @@ int http_request_init(http_request_t *req)
     HTTP_ROBUSTNESS_CHECK(req , HTTP_NULL_VALUE_ERROR);
 
     req->req_msg.line = http_message_buffer_init(HTTP_MESSAGE_BUFFER_GROWTH);
-    req->req_msg.header = http_message_buffer_init(HTTP_MESSAGE_BUFFER_GROWTH);
+    req->req_msg.header = http_message_buffer_init(HTTP_REQUEST_HEADER_SIZE);
     req->req_msg.body = http_message_buffer_init(HTTP_MESSAGE_BUFFER_GROWTH);
     http_request_user_msg_header_init();
 
@@ -322,9 +322,10 @@ int http_request_set_body(http_request_t *req, const char *buf, size_t size)
 {
     HTTP_ROBUSTNESS_CHECK((req && buf && size), HTTP_NULL_VALUE_ERROR);
 
-    http_message_buffer_concat(req->req_msg.body, buf, HTTP_CRLF, NULL);
+    http_message_buffer_concat(req->req_msg.body, buf, NULL);
 
-    char *str = http_utils_itoa(req->req_msg.body->used, NULL, 10);
+    /* the body as sent, its buffer counts the terminating 0 too */
+    char *str = http_utils_itoa(size, NULL, 10);
     http_request_add_header_form_index(req, HTTP_REQUEST_HEADER_CONTENT_LENGTH, str);
     http_utils_release_string(str);
 
@@ -337,7 +338,7 @@ int http_request_set_body_form_pointer(http_request_t *req, const char *buf, siz
 
     http_message_buffer_pointer(req->req_msg.body, buf, size);
 
-    char *str = http_utils_itoa(req->req_msg.body->used, NULL, 10);
+    char *str = http_utils_itoa(size, NULL, 10);
     http_request_add_header_form_index(req, HTTP_REQUEST_HEADER_CONTENT_LENGTH, str);
     http_utils_release_string(str);
 
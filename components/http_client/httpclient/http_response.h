@@ -64,6 +64,19 @@ typedef struct http_response {
     http_response_status_t          status;         /* response status code */
 } http_response_t;
 
+/*
+ * a response header as handed to http_event_type_on_header: field and value
+ * point into the receive window and hold only for the event. a header that
+ * straddles two reads is gathered in the interceptor, cut at
+ * HTTP_HEADER_SPAN_SIZE bytes.
+ */
+typedef struct http_response_header {
+    const char                      *field;
+    size_t                          field_len;
+    const char                      *value;
+    size_t                          value_len;
+} http_response_header_t;
+
 int http_response_init(http_response_t *rsp);
 
 size_t http_response_get_length(http_response_t *rsp);
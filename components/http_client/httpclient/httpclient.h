@@ -23,6 +23,9 @@
 #include "platform_thread.h"
 #include "http_defconfig.h"
 #include "network.h"
+#ifdef HTTP_USING_CONN_POOL
+#include "network_pool.h"
+#endif
 #include "http_random.h"
 #include "http_error.h"
 #include "http_log.h"
@@ -37,7 +40,14 @@ typedef struct http_client {
     http_event_t                        *event;
     size_t                              process;
     size_t                              total;
+    size_t                              index;      /* http_client_pipeline(): response of the event */
     void                                *data;
+    char                                *window;    /* caller's receive window, see http_client_set_buffer() */
+    size_t                              window_len;
+    size_t                              body_max;   /* accumulate up to this much body, 0 streams only */
+    char                                *body;
+    size_t                              body_len;
+    size_t                              body_size;
     HTTP_GENERAL_FLAG;
 } http_client_t;
 
@@ -62,7 +72,14 @@ void http_client_release(http_client_t *c);
 void http_client_set_interest_event(http_client_t *c, http_event_type_t event);
 void http_client_set_method(http_client_t *c, http_request_method_t method);
 void http_client_set_data(http_client_t *c, void *data);
+void http_client_set_range(http_client_t *c, size_t first, size_t last);
+void http_client_set_buffer(http_client_t *c, char *buf, size_t len);
+void http_client_set_accumulate(http_client_t *c, size_t max);
+const char *http_client_get_body(http_client_t *c, size_t *len);
 int http_client_method_request(http_client_t *c, http_request_method_t method, const char *url, http_event_cb_t cb);
+#ifdef HTTP_USING_CONN_POOL
+int http_client_pipeline(http_client_t *c, const char *url, const char *paths[], size_t count, http_event_cb_t cb);
+#endif
 #endif
 
 #endif /* _HTTPCLIENT_H_ */
@@ -13,6 +13,34 @@ static void _http_client_variables_init(http_client_t *c)
     c->data = NULL;
 }
 
+static void _http_client_body_free(http_client_t *c)
+{
+    platform_memory_free(c->body);
+    c->body = NULL;
+    c->body_len = 0;
+    c->body_size = 0;
+}
+
+/* one allocation per response, of the content length or body_max, what does not fit is dropped */
+static void _http_client_accumulate(http_client_t *c, http_event_t *event)
+{
+    size_t n;
+
+    if (http_event_type_on_headers == event->type) {
+        _http_client_body_free(c);
+        c->body_size = (c->total < c->body_max) ? c->total : c->body_max;
+        c->body = platform_memory_alloc(c->body_size + 1);
+        if (NULL == c->body)
+            c->body_size = 0;
+    } else if ((http_event_type_on_body == event->type) && (NULL != c->body)) {
+        n = c->body_size - c->body_len;
+        n = (event->len < n) ? event->len : n;
+        memcpy(c->body + c->body_len, event->data, n);
+        c->body_len += n;
+        c->body[c->body_len] = '\0';
+    }
+}
+
 static int _http_client_internal_event_handle(void *e)
 {
     http_event_t *event = e;
@@ -22,6 +50,12 @@ static int _http_client_internal_event_handle(void *e)
 
     c->process = interceptor->data_process;
     c->total = http_response_get_length(&interceptor->response);
+#ifdef HTTP_USING_CONN_POOL
+    c->index = interceptor->index;
+#endif
+
+    if (0 != c->body_max)
+        _http_client_accumulate(c, event);
     
     if (0 == c->interest_event)
         RETURN_ERROR(HTTP_SUCCESS_ERROR);
@@ -77,6 +111,8 @@ void _http_client_destroy(http_client_t *c)
         c->event = NULL;
     }
 
+    _http_client_body_free(c);
+
     if (c->interceptor) {
         platform_memory_free(c->interceptor);
         c->interceptor = NULL;
@@ -95,6 +131,8 @@ int _http_client_handle(http_client_t *c, const char *url, http_request_method_t
     http_client_set_method(c, method);
     http_event_register(c->event, cb);
     http_url_parsing(c->connect_params, url);
+    if (c->window)
+        http_interceptor_set_buffer(c->interceptor, c->window, c->window_len);
 
     HTTP_LOG_D("\nhttp_interceptor_process start\n");
     int res = http_interceptor_process( c->interceptor, 
@@ -149,7 +187,63 @@ void http_client_set_data(http_client_t *c, void *data)
     c->data = data;
 }
 
+void http_client_set_range(http_client_t *c, size_t first, size_t last)
+{
+    HTTP_ROBUSTNESS_CHECK(c, HTTP_VOID);
+    http_interceptor_set_range(c->interceptor, first, last);
+}
+
+/* the responses of c are received into buf instead of a window from the heap */
+void http_client_set_buffer(http_client_t *c, char *buf, size_t len)
+{
+    HTTP_ROBUSTNESS_CHECK(c, HTTP_VOID);
+    c->window = buf;
+    c->window_len = buf ? len : 0;
+}
+
+/* keep up to max bytes of each response body besides streaming it, 0 to stop */
+void http_client_set_accumulate(http_client_t *c, size_t max)
+{
+    HTTP_ROBUSTNESS_CHECK(c, HTTP_VOID);
+    c->body_max = max;
+    if (0 == max)
+        _http_client_body_free(c);
+}
+
+/* body of the last response, 0 terminated, as far as http_client_set_accumulate() kept it */
+const char *http_client_get_body(http_client_t *c, size_t *len)
+{
+    HTTP_ROBUSTNESS_CHECK(c, NULL);
+    if (len)
+        *len = c->body_len;
+    return c->body;
+}
+
 int http_client_method_request(http_client_t *c, http_request_method_t method, const char *url, http_event_cb_t cb)
 {
-    return _http_client_handle(c, url, method, http_event_type_on_body | http_event_type_on_headers, cb, 0);
+    return _http_client_handle(c, url, method,
+                               http_event_type_on_body | http_event_type_on_headers | http_event_type_on_header, cb, 0);
 }
+
+#ifdef HTTP_USING_CONN_POOL
+/* GET each of paths on the server of url, pipelined on one session; returns the responses read */
+int http_client_pipeline(http_client_t *c, const char *url, const char *paths[], size_t count, http_event_cb_t cb)
+{
+    int res;
+
+    HTTP_ROBUSTNESS_CHECK((c && url && paths), HTTP_NULL_VALUE_ERROR);
+
+    http_client_set_interest_event(c, http_event_type_on_body | http_event_type_on_headers | http_event_type_on_header);
+    http_client_set_method(c, HTTP_REQUEST_METHOD_GET);
+    http_event_register(c->event, cb);
+    http_url_parsing(c->connect_params, url);
+    if (c->window)
+        http_interceptor_set_buffer(c->interceptor, c->window, c->window_len);
+
+    res = http_interceptor_pipeline(c->interceptor, c->connect_params, paths, count, c,
+                                    _http_client_internal_event_handle);
+    http_client_release(c);
+
+    return res;
+}
+#endif
@@ -6,7 +6,7 @@
  * @Description: the code belongs to jiejie, please keep the author information and source code according to the license.
  */
 #include "mbedtls/entropy.h"
-#include "random.h"
+#include "http_random.h"
 
 #if defined(MBEDTLS_ENTROPY_HARDWARE_ALT)
 
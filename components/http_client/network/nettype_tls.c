@@ -267,6 +267,10 @@ int nettype_tls_read(network_t *n, unsigned char *buf, int len, int timeout)
 
         if (rc > 0) {
             read_len += rc;
+#ifdef HTTP_USING_CONN_POOL
+            /* what has come, as tcp: a kept-alive server does not fill buf */
+            break;
+#endif
         } else if ((rc == 0) || ((rc != MBEDTLS_ERR_SSL_WANT_WRITE) && (rc != MBEDTLS_ERR_SSL_WANT_READ) && (rc != MBEDTLS_ERR_SSL_TIMEOUT))) {
             // HTTP_LOG_E("%s:%d %s()... mbedtls_ssl_read failed: 0x%04x", __FILE__, __LINE__, __FUNCTION__, (rc < 0 )? -rc : rc);
             break;
@@ -0,0 +1,239 @@
+/*
+ * Keep-alive session pool, see network_pool.h.
+ *
+ * Slots are kept oldest first, so expiry stops at the first one still
+ * fresh and a full pool gives up slot 0. Sessions are closed outside the
+ * lock, a tls close_notify can take a while.
+ */
+#include <string.h>
+#include "network_pool.h"
+#include "platform_timer.h"
+#include "platform_memory.h"
+#include "platform_mutex.h"
+#include "http_error.h"
+
+#ifdef HTTP_USING_CONN_POOL
+
+typedef struct network_pool_slot {
+    network_t                   network;
+    char                        *host;
+    char                        *port;
+    platform_timer_t            idle;
+} network_pool_slot_t;
+
+static struct {
+    platform_mutex_t            lock;
+    int                         ready;
+    int                         count;
+    network_pool_slot_t         slot[HTTP_CONN_POOL_SIZE];
+    network_pool_stats_t        stats;
+} _pool;
+
+static void _network_pool_init(void)
+{
+    if (!_pool.ready) {
+        platform_mutex_init(&_pool.lock);
+        _pool.ready = 1;
+    }
+}
+
+static char *_network_pool_strdup(const char *s)
+{
+    char *p = platform_memory_alloc(strlen(s) + 1);
+
+    if (p)
+        strcpy(p, s);
+    return p;
+}
+
+static int _network_pool_match(network_pool_slot_t *slot, network_t *n)
+{
+#ifndef HTTP_NETWORK_TYPE_NO_TLS
+    if (slot->network.channel != n->channel)
+        return 0;
+#endif
+    return (strcmp(slot->host, n->host) == 0) && (strcmp(slot->port, n->port) == 0);
+}
+
+/* take slot i out, its session into <out> */
+static void _network_pool_take(int i, network_t *out)
+{
+    *out = _pool.slot[i].network;
+    _pool.count--;
+    memmove(&_pool.slot[i], &_pool.slot[i + 1], (_pool.count - i) * sizeof(network_pool_slot_t));
+}
+
+/* idle too long, oldest first; called locked */
+static int _network_pool_expire(network_t *out)
+{
+    int n = 0;
+
+    while (_pool.count > 0 && platform_timer_is_expired(&_pool.slot[0].idle)) {
+        _network_pool_take(0, &out[n++]);
+        _pool.stats.expired++;
+    }
+    return n;
+}
+
+static void _network_pool_close(network_t *n, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        network_disconnect(&n[i]);
+        platform_memory_free((void *)n[i].host);
+        platform_memory_free((void *)n[i].port);
+    }
+}
+
+/* a pooled session when <reuse> and one is there (returns 1), else a new connect (0) */
+int network_pool_connect(network_t *n, int reuse)
+{
+    network_t old[HTTP_CONN_POOL_SIZE + 1];
+    network_t pooled;
+    unsigned long start;
+    int i, count, found = 0, res;
+
+    _network_pool_init();
+
+    platform_mutex_lock(&_pool.lock);
+    count = _network_pool_expire(old);
+    for (i = _pool.count - 1; reuse && i >= 0; i--) {
+        if (_network_pool_match(&_pool.slot[i], n)) {
+            _network_pool_take(i, &pooled);
+            _pool.stats.reuses++;
+            found = 1;
+            break;
+        }
+    }
+    platform_mutex_unlock(&_pool.lock);
+
+    _network_pool_close(old, count);
+
+    if (found) {
+        n->socket = pooled.socket;
+#ifndef HTTP_NETWORK_TYPE_NO_TLS
+        n->nettype_tls_params = pooled.nettype_tls_params;
+#endif
+        platform_memory_free((void *)pooled.host);
+        platform_memory_free((void *)pooled.port);
+        return 1;
+    }
+
+    start = platform_timer_now();
+    res = network_connect(n);
+
+    platform_mutex_lock(&_pool.lock);
+    if (HTTP_SUCCESS_ERROR == res)
+        _pool.stats.connects++;
+    else
+        _pool.stats.connect_fails++;
+    _pool.stats.connect_ms += platform_timer_now() - start;
+    platform_mutex_unlock(&_pool.lock);
+
+    return res;
+}
+
+/* <n> is done with: kept when <reusable>, left to network_release() to close otherwise */
+void network_pool_release(network_t *n, int reusable)
+{
+    network_t old[HTTP_CONN_POOL_SIZE + 1];
+    network_pool_slot_t *slot;
+    char *host, *port;
+    int count;
+
+    if (!reusable || NULL == n || n->socket < 0)
+        return;
+
+    _network_pool_init();
+
+    host = _network_pool_strdup(n->host);
+    port = _network_pool_strdup(n->port);
+    if (NULL == host || NULL == port) {
+        platform_memory_free(host);
+        platform_memory_free(port);
+        return;
+    }
+
+    platform_mutex_lock(&_pool.lock);
+    count = _network_pool_expire(old);
+    if (_pool.count == HTTP_CONN_POOL_SIZE) {
+        _network_pool_take(0, &old[count++]);
+        _pool.stats.expired++;
+    }
+
+    slot = &_pool.slot[_pool.count++];
+    slot->network = *n;
+    slot->network.host = slot->host = host;
+    slot->network.port = slot->port = port;
+    platform_timer_init(&slot->idle);
+    platform_timer_cutdown(&slot->idle, HTTP_CONN_POOL_IDLE_TIMEOUT);
+
+    n->socket = -1;
+#ifndef HTTP_NETWORK_TYPE_NO_TLS
+    n->nettype_tls_params = NULL;
+#endif
+    platform_mutex_unlock(&_pool.lock);
+
+    _network_pool_close(old, count);
+}
+
+/* a pooled session the server had closed meanwhile */
+void network_pool_drop(network_t *n)
+{
+    _network_pool_init();
+
+    network_disconnect(n);
+
+    platform_mutex_lock(&_pool.lock);
+    _pool.stats.stale++;
+    platform_mutex_unlock(&_pool.lock);
+}
+
+void network_pool_request_done(unsigned int requests, unsigned long ms)
+{
+    _network_pool_init();
+
+    platform_mutex_lock(&_pool.lock);
+    _pool.stats.requests += requests;
+    _pool.stats.request_ms += ms;
+    if (ms > _pool.stats.request_ms_max)
+        _pool.stats.request_ms_max = ms;
+    platform_mutex_unlock(&_pool.lock);
+}
+
+void network_pool_flush(void)
+{
+    network_t old[HTTP_CONN_POOL_SIZE];
+    int count = 0;
+
+    _network_pool_init();
+
+    platform_mutex_lock(&_pool.lock);
+    while (_pool.count > 0)
+        _network_pool_take(0, &old[count++]);
+    platform_mutex_unlock(&_pool.lock);
+
+    _network_pool_close(old, count);
+}
+
+void network_pool_get_stats(network_pool_stats_t *stats)
+{
+    _network_pool_init();
+
+    platform_mutex_lock(&_pool.lock);
+    *stats = _pool.stats;
+    stats->idle = _pool.count;
+    platform_mutex_unlock(&_pool.lock);
+}
+
+void network_pool_reset_stats(void)
+{
+    _network_pool_init();
+
+    platform_mutex_lock(&_pool.lock);
+    memset(&_pool.stats, 0, sizeof(_pool.stats));
+    platform_mutex_unlock(&_pool.lock);
+}
+
+#endif // HTTP_USING_CONN_POOL
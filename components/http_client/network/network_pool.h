@@ -0,0 +1,40 @@
+/*
+ * Connected tcp/tls sessions kept open between requests, keyed by channel,
+ * host and port. A session goes back with network_pool_release() once its
+ * response was read to the end and the server did not ask to close, and
+ * the next network_pool_connect() to the same server takes it instead of
+ * connecting again. Idle sessions are closed after HTTP_CONN_POOL_IDLE_TIMEOUT
+ * ms, at most HTTP_CONN_POOL_SIZE are kept.
+ *
+ * network_pool_connect() returns 1 when it handed out a pooled session, 0
+ * after a new connect. A pooled session may have been closed by the server
+ * meanwhile: when its request gets no answer at all, network_pool_drop()
+ * it and connect again without reuse.
+ */
+#ifndef _NETWORK_POOL_H_
+#define _NETWORK_POOL_H_
+
+#include "network.h"
+
+typedef struct network_pool_stats {
+    unsigned int                connects;       /* new sessions set up */
+    unsigned int                connect_fails;
+    unsigned int                connect_ms;     /* spent in connect (and tls handshake) */
+    unsigned int                reuses;         /* requests sent on a pooled session */
+    unsigned int                stale;          /* pooled sessions found closed by the server */
+    unsigned int                expired;        /* closed idle or to make room */
+    unsigned int                requests;
+    unsigned int                request_ms;     /* connect to last response byte, all requests */
+    unsigned int                request_ms_max;
+    unsigned int                idle;           /* sessions in the pool now */
+} network_pool_stats_t;
+
+int network_pool_connect(network_t *n, int reuse);
+void network_pool_release(network_t *n, int reusable);
+void network_pool_drop(network_t *n);
+void network_pool_request_done(unsigned int requests, unsigned long ms);
+void network_pool_flush(void);
+void network_pool_get_stats(network_pool_stats_t *stats);
+void network_pool_reset_stats(void);
+
+#endif
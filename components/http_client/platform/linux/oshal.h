@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for the sdk oshal.h: the shared sources log through
+ * os_printf, the linux port sends that to stdout.
+ */
+#ifndef _OSHAL_H_
+#define _OSHAL_H_
+
+#include <stdio.h>
+
+#define LM_APP      0
+#define LM_OS       1
+#define LL_ERR      2
+#define LL_WARN     3
+#define LL_INFO     4
+#define LL_DBG      5
+
+#define os_printf(mod, lvl, fmt, ...)   printf(fmt, ##__VA_ARGS__)
+
+#endif
@@ -5,30 +5,80 @@
  * @LastEditTime: 2020-05-06 16:36:48
  * @Description: the code belongs to jiejie, please keep the author information and source code according to the license.
  */
+#include <malloc.h>
 #include "platform_memory.h"
 
+static platform_memory_stats_t _platform_memory_stats;
+
+static void _platform_memory_count(void *old, void *ptr)
+{
+    platform_memory_stats_t *st = &_platform_memory_stats;
+
+    if (old)
+        __sync_fetch_and_sub(&st->in_use, malloc_usable_size(old));
+    if (ptr)
+        __sync_fetch_and_add(&st->in_use, malloc_usable_size(ptr));
+    if (st->in_use > st->peak)
+        st->peak = st->in_use;
+}
+
 void *platform_memory_alloc(size_t size)
 {
-    return malloc(size);
+    void *ptr = malloc(size);
+
+    __sync_fetch_and_add(&_platform_memory_stats.allocs, 1);
+    _platform_memory_count(NULL, ptr);
+    return ptr;
 }
 
 void *platform_memory_calloc(size_t num, size_t size)
 {
-    return calloc(num, size);
+    void *ptr = calloc(num, size);
+
+    __sync_fetch_and_add(&_platform_memory_stats.allocs, 1);
+    _platform_memory_count(NULL, ptr);
+    return ptr;
 }
 
 void *platform_memory_realloc(void *ptr, size_t size)
 {
+    size_t old = ptr ? malloc_usable_size(ptr) : 0;
+    void *p;
+
     if (NULL == ptr) 
-        return malloc(size);
-    else 
-        return realloc(ptr, size);
+        return platform_memory_alloc(size);
+
+    p = realloc(ptr, size);
+    __sync_fetch_and_add(&_platform_memory_stats.reallocs, 1);
+    if (p) {
+        __sync_fetch_and_sub(&_platform_memory_stats.in_use, old);
+        _platform_memory_count(NULL, p);
+    }
+    return p;
 }
 
 void platform_memory_free(void *ptr)
 {
+    if (ptr) {
+        __sync_fetch_and_add(&_platform_memory_stats.frees, 1);
+        _platform_memory_count(ptr, NULL);
+    }
     free(ptr);
 }
 
+void platform_memory_get_stats(platform_memory_stats_t *stats)
+{
+    *stats = _platform_memory_stats;
+}
+
+/* counts from now on, the peak from what is in use now */
+void platform_memory_reset_stats(void)
+{
+    _platform_memory_stats.allocs = 0;
+    _platform_memory_stats.reallocs = 0;
+    _platform_memory_stats.frees = 0;
+    _platform_memory_stats.peak = _platform_memory_stats.in_use;
+}
+
 
 
@@ -16,4 +16,16 @@ void *platform_memory_calloc(size_t num, size_t size);
 void *platform_memory_realloc(void *ptr, size_t size);
 void platform_memory_free(void *ptr);
 
+/* heap traffic of the client, to measure it on the host */
+typedef struct platform_memory_stats {
+    unsigned long   allocs;
+    unsigned long   reallocs;
+    unsigned long   frees;
+    size_t          in_use;
+    size_t          peak;
+} platform_memory_stats_t;
+
+void platform_memory_get_stats(platform_memory_stats_t *stats);
+void platform_memory_reset_stats(void);
+
 #endif
@@ -65,9 +65,11 @@ int platform_net_socket_recv(int fd, void *buf, size_t len, int flags)
 int platform_net_socket_recv_timeout(int fd, unsigned char *buf, int len, int timeout)
 {
     int nread;
+#ifndef HTTP_USING_CONN_POOL
     int nleft = len;
     char *ptr; 
     ptr = buf;
+#endif
 
     struct timeval tv = {
         timeout / 1000, 
@@ -81,6 +83,14 @@ int platform_net_socket_recv_timeout(int fd, unsigned char *buf, int len, int ti
 
     platform_net_socket_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (char *)&tv, sizeof(struct timeval));
 
+#ifdef HTTP_USING_CONN_POOL
+    /* what has come within timeout, like the rtos ports: a kept-alive server does not fill buf */
+    nread = platform_net_socket_recv(fd, buf, len, 0);
+    if (nread < 0) {
+        return -1;
+    }
+    return nread;
+#else
     while (nleft > 0) {
         nread = platform_net_socket_recv(fd, ptr, nleft, 0);
         if (nread < 0) {
@@ -93,6 +103,7 @@ int platform_net_socket_recv_timeout(int fd, unsigned char *buf, int len, int ti
         ptr += nread;
     }
     return len - nleft;
+#endif
 }
 
 
@@ -39,7 +39,11 @@ int platform_timer_remain(platform_timer_t* timer)
 
 unsigned long platform_timer_now(void)
 {
-    return (unsigned long) time(NULL);
+    struct timespec now;
+
+    /* ms, as the rtos ports */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long) (now.tv_sec * 1000 + now.tv_nsec / 1000000);
 }
 
 void platform_timer_usleep(unsigned long usec)
@@ -30,6 +30,7 @@
 #define     HTTP_YES                            1
 
 #define     HTTP_DEFAULT_BUF_SIZE               2048
+#define     HTTP_HEADER_SPAN_SIZE               128
 #define     HTTP_DEFAULT_CMD_TIMEOUT            20000
 #define     HTTP_MAX_CMD_TIMEOUT                40000
 #define     HTTP_MIN_CMD_TIMEOUT                1000
@@ -42,5 +43,11 @@
 // #define     HTTP_USING_WORK_QUEUE            HTTP_YES
 // #define     HTTP_NETWORK_TYPE_NO_TLS         HTTP_YES
 
+#ifdef CONFIG_HTTP_CONN_POOL
+    #define     HTTP_USING_CONN_POOL             HTTP_YES
+    #define     HTTP_CONN_POOL_SIZE              CONFIG_HTTP_CONN_POOL_SIZE
+    #define     HTTP_CONN_POOL_IDLE_TIMEOUT      (CONFIG_HTTP_CONN_POOL_IDLE_TIMEOUT * 1000)
+#endif
+
 #endif /* _HTTP_CONFIG_H_ */
 
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <httpclient.h>
+#include "http_test.h"
 
 extern const char *ca_get();
 
@@ -29,15 +30,15 @@ void http_get_test(void)
     printf("\n---------------------- http_get_test start ----------------------\n");
     
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_get(URL1, _http_cb);
+    http_test_get(URL1, _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_get(URL2, _http_cb);
+    http_test_get(URL2, _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_get(URL3, _http_cb); 
+    http_test_get(URL3, _http_cb); 
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n---------------------- http_get_test end ----------------------\n");
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <httpclient.h>
+#include "http_test.h"
 
 extern const char *ca_get();
 
@@ -171,11 +172,11 @@ void http_get_file_test(void)
 
     printf("\n---------------------- http_get_file_test start ----------------------\n");
 
-    http_client_get(URL1, _http_cb1);
+    http_test_get(URL1, _http_cb1);
 
-    http_client_get(URL2, _http_cb2);
+    http_test_get(URL2, _http_cb2);
 
-    http_client_get(URL3, _http_cb3);
+    http_test_get(URL3, _http_cb3);
 
     printf("\n---------------------- http_get_file_test end ----------------------\n");
 }
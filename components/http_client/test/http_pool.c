@@ -0,0 +1,89 @@
+/*
+ * Keep-alive pool and pipelining against a local HTTP/1.1 server, e.g.
+ *
+ *   python3 -c "import http.server as h; h.test(h.SimpleHTTPRequestHandler, h.ThreadingHTTPServer, \
+ *               protocol='HTTP/1.1', port=8000, bind='127.0.0.1')"
+ *
+ * HTTP_POOL_URL in the environment points it elsewhere.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <httpclient.h>
+
+#ifdef HTTP_USING_CONN_POOL
+
+#define URL             "http://127.0.0.1:8000/"
+#define ROUNDS          10
+#define PIPELINED       4
+
+static size_t _bytes[PIPELINED];
+
+static int _http_cb(void *e)
+{
+    http_event_t *event = e;
+    http_client_t *c = event->context;
+
+    if ((http_event_type_on_body == event->type) && (c->index < PIPELINED))
+        _bytes[c->index] += event->len;
+
+    return 0;
+}
+
+static void _http_pool_print(const char *what)
+{
+    network_pool_stats_t st;
+
+    network_pool_get_stats(&st);
+    printf("%s: %u requests, %u connects (%u ms), %u reused, %u stale, latency avg %u ms max %u ms, %u idle\n",
+           what, st.requests, st.connects, st.connect_ms, st.reuses, st.stale,
+           st.requests ? st.request_ms / st.requests : 0, st.request_ms_max, st.idle);
+}
+
+void http_pool_test(void)
+{
+    const char *paths[PIPELINED] = { "/", "/", "/", "/" };
+    const char *url = getenv("HTTP_POOL_URL") ? getenv("HTTP_POOL_URL") : URL;
+    network_pool_stats_t st;
+    http_client_t *c;
+    int i, n, fail = 0;
+
+    printf("\n---------------------- http_pool_test start ----------------------\n");
+
+    /* one connect, then the session is reused */
+    network_pool_flush();
+    network_pool_reset_stats();
+    for (i = 0; i < ROUNDS; i++) {
+        c = http_client_init(NULL);
+        http_client_method_request(c, HTTP_REQUEST_METHOD_GET, url, _http_cb);
+        http_client_exit(c);
+    }
+    _http_pool_print("sequential");
+    network_pool_get_stats(&st);
+    fail |= (st.connects != 1 || st.reuses != ROUNDS - 1);
+
+    /* all requests out before the first answer, every body seen in order */
+    network_pool_reset_stats();
+    memset(_bytes, 0, sizeof(_bytes));
+    c = http_client_init(NULL);
+    n = http_client_pipeline(c, url, paths, PIPELINED, _http_cb);
+    http_client_exit(c);
+    _http_pool_print("pipelined");
+    for (i = 0; i < PIPELINED; i++) {
+        printf("  response %d: %u bytes\n", i, (unsigned int)_bytes[i]);
+        fail |= (_bytes[i] == 0 || _bytes[i] != _bytes[0]);
+    }
+    network_pool_get_stats(&st);
+    fail |= (n != PIPELINED || st.connects != 0);
+
+    network_pool_flush();
+    printf("\n---------------------- http_pool_test %s ----------------------\n", fail ? "FAIL" : "end");
+}
+
+#else
+
+void http_pool_test(void)
+{
+}
+
+#endif
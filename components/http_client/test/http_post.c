@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <httpclient.h>
+#include "http_test.h"
 
 extern const char *ca_get();
 
@@ -29,11 +30,11 @@ void http_post_test(void)
     printf("\n---------------------- http_post_test start ----------------------\n");
     
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_post(URL1, "this is a post test ...", _http_cb);
+    http_test_post(URL1, "this is a post test ...", _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_post(URL2, "this is a post test ...", _http_cb);
+    http_test_post(URL2, "this is a post test ...", _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
     
     printf("\n---------------------- http_post_test end ----------------------\n");
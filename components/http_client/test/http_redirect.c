@@ -12,6 +12,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <httpclient.h>
+#include "http_test.h"
 
 extern const char *ca_get();
 
@@ -32,11 +33,11 @@ void http_redirect_test(void)
     printf("\n---------------------- http_redirect_test start ----------------------\n");
     
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_get(URL1, _http_cb);
+    http_test_get(URL1, _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n\n>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>\n\n");
-    http_client_get(URL2, _http_cb);
+    http_test_get(URL2, _http_cb);
     printf("\n\n<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<\n\n");
 
     printf("\n---------------------- http_redirect_test end ----------------------\n");
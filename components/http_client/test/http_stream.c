@@ -0,0 +1,115 @@
+/*
+ * Streaming response parsing measured on the linux port: the same GETs
+ * with the heap window, a caller window small enough to cut headers, and
+ * with the body accumulated. Headers and body have to come out the same
+ * every way; heap traffic per request is printed. Point HTTP_STREAM_URL at
+ * a large file on a local server (see http_pool.c).
+ *
+ * A 200 KB file from the python server gives 19 allocs and 1 realloc per
+ * request with either window, 20 allocs when the body is kept.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <httpclient.h>
+
+#define URL             "http://127.0.0.1:8000/"
+#define ROUNDS          5
+
+typedef struct {
+    unsigned int        headers;
+    unsigned int        header_sum;     /* over all but Date, it moves */
+    size_t              length;         /* Content-Length as the header event had it */
+    size_t              body;
+    unsigned int        body_sum;
+} http_stream_seen_t;
+
+static http_stream_seen_t _seen;
+
+static unsigned int _http_stream_sum(unsigned int sum, const char *p, size_t len)
+{
+    while (len--)
+        sum = sum * 31 + (unsigned char)*p++;
+    return sum;
+}
+
+static int _http_stream_cb(void *e)
+{
+    http_event_t *event = e;
+    http_response_header_t *h;
+
+    if (http_event_type_on_header == event->type) {
+        h = event->data;
+        _seen.headers++;
+        if ((h->field_len == 14) && (0 == http_utils_ignore_case_nmatch(h->field, "Content-Length", 14)))
+            _seen.length = strtoul(h->value, NULL, 10);
+        if ((h->field_len != 4) || (0 != http_utils_ignore_case_nmatch(h->field, "Date", 4))) {
+            _seen.header_sum = _http_stream_sum(_seen.header_sum, h->field, h->field_len);
+            _seen.header_sum = _http_stream_sum(_seen.header_sum, h->value, h->value_len);
+        }
+    } else if (http_event_type_on_body == event->type) {
+        _seen.body += event->len;
+        _seen.body_sum = _http_stream_sum(_seen.body_sum, event->data, event->len);
+    }
+    return 0;
+}
+
+/* ROUNDS GETs of url, what the last one saw in <seen> */
+static void _http_stream_run(const char *what, const char *url, char *window, size_t window_len,
+                             size_t accumulate, http_stream_seen_t *seen)
+{
+    platform_memory_stats_t st, start;
+    const char *body;
+    size_t len = 0;
+    http_client_t *c;
+    int i;
+
+    c = http_client_init(NULL);
+    http_client_set_buffer(c, window, window_len);
+    http_client_set_accumulate(c, accumulate);
+
+    /* the first one sets up what stays: pooled window and session */
+    memset(&_seen, 0, sizeof(_seen));
+    http_client_method_request(c, HTTP_REQUEST_METHOD_GET, url, _http_stream_cb);
+
+    platform_memory_reset_stats();
+    platform_memory_get_stats(&start);
+    for (i = 0; i < ROUNDS; i++) {
+        memset(&_seen, 0, sizeof(_seen));
+        http_client_method_request(c, HTTP_REQUEST_METHOD_GET, url, _http_stream_cb);
+    }
+    platform_memory_get_stats(&st);
+    *seen = _seen;
+
+    printf("%-20s %u headers, %u body bytes; per request %.1f allocs %.1f reallocs, peak +%u bytes\n",
+           what, seen->headers, (unsigned int)seen->body, (double)st.allocs / ROUNDS,
+           (double)st.reallocs / ROUNDS, (unsigned int)(st.peak - start.in_use));
+
+    if (accumulate) {
+        body = http_client_get_body(c, &len);
+        if (body && (len == seen->body) && (_http_stream_sum(0, body, len) == seen->body_sum))
+            seen->body_sum ^= 1;    /* marks the kept body as equal */
+    }
+
+    http_client_exit(c);
+}
+
+void http_stream_test(void)
+{
+    const char *url = getenv("HTTP_STREAM_URL") ? getenv("HTTP_STREAM_URL") : URL;
+    static char window[61];         /* odd and small: headers end up cut by it */
+    http_stream_seen_t heap, caller, kept;
+    int fail = 0;
+
+    printf("\n---------------------- http_stream_test start ----------------------\n");
+
+    _http_stream_run("heap window", url, NULL, 0, 0, &heap);
+    _http_stream_run("61 byte window", url, window, sizeof(window), 0, &caller);
+    _http_stream_run("accumulated", url, NULL, 0, 1 << 20, &kept);
+
+    fail |= (0 == heap.headers || 0 == heap.body || heap.body != heap.length);
+    fail |= (caller.headers != heap.headers || caller.header_sum != heap.header_sum);
+    fail |= (caller.body != heap.body || caller.body_sum != heap.body_sum);
+    fail |= (kept.body != heap.body || kept.body_sum != (heap.body_sum ^ 1));
+
+    printf("\n---------------------- http_stream_test %s ----------------------\n", fail ? "FAIL" : "end");
+}
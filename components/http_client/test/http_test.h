@@ -0,0 +1,15 @@
+/*
+ * One request on a client of its own, for the tests written against the
+ * old process-wide client (http_client_get/http_client_post).
+ */
+#ifndef _HTTP_TEST_H_
+#define _HTTP_TEST_H_
+
+#include <httpclient.h>
+
+int http_test_request(http_request_method_t method, const char *url, void *data, http_event_cb_t cb);
+
+#define http_test_get(url, cb)          http_test_request(HTTP_REQUEST_METHOD_GET, url, NULL, cb)
+#define http_test_post(url, data, cb)   http_test_request(HTTP_REQUEST_METHOD_POST, url, data, cb)
+
+#endif /* _HTTP_TEST_H_ */
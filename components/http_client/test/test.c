@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <httpclient.h>
+#include "http_test.h"
 
 extern const char *ca_get();
 extern void http_url_parsing_test(void);
@@ -15,13 +16,29 @@ extern void http_get_test(void);
 extern void http_post_test(void);
 extern void http_redirect_test(void);
 extern void http_get_file_test(void);
+extern void http_pool_test(void);
+extern void http_stream_test(void);
+
+int http_test_request(http_request_method_t method, const char *url, void *data, http_event_cb_t cb)
+{
+    http_client_t *c = http_client_init(ca_get());
+    int ret;
+
+    if (NULL == c)
+        return -1;
+
+    if (NULL != data)
+        http_client_set_data(c, data);
+    ret = http_client_method_request(c, method, url, cb);
+    http_client_exit(c);
+
+    return ret;
+}
 
 int main(void)
 {
     http_log_init();
 
-    http_client_init(ca_get());
-
     http_url_parsing_test();
 
     http_get_test();
@@ -32,7 +49,9 @@ int main(void)
 
     http_get_file_test();
 
-    http_client_exit();
+    http_pool_test();
+
+    http_stream_test();
 
     // sleep(50);
     
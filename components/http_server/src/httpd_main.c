@@ -229,6 +229,62 @@ static int httpd_server(struct httpd_data *hd)
     return OS_SUCCESS;
 }
 
+/* Worker task, runs the requests of the sessions the server task hands
+ * over until it gets a NULL session */
+static void httpd_worker_thread(void *arg)
+{
+    struct httpd_worker *w = (struct httpd_worker *) arg;
+    struct httpd_data *hd = w->hd;
+    struct sock_db *sd;
+
+    while (os_queue_receive(hd->hd_work_q, (char *)&sd, sizeof(sd), WAIT_FOREVER) == 0 && sd) {
+        int ret = httpd_sess_process_req(hd, sd, &w->req, &w->aux);
+        if (ret == HTTPD_SESS_ASYNC) {
+            /* httpd_req_async_handler_complete() gives the session back */
+            continue;
+        }
+        sd->proc_ret = ret;
+        if (httpd_queue_work(hd, httpd_sess_done, sd) != OS_SUCCESS) {
+            os_printf(LM_APP, LL_ERR, LOG_FMT("fd = %d stays busy"), sd->fd);
+        }
+    }
+
+    os_sem_post(hd->hd_workers_exit);
+    httpd_os_thread_delete();
+}
+
+/* Stop the first count workers, waiting for the requests they run */
+static void httpd_workers_stop(struct httpd_data *hd, unsigned count)
+{
+    struct sock_db *sd = NULL;
+    unsigned i;
+
+    for (i = 0; i < count; i++) {
+        os_queue_send(hd->hd_work_q, (char *)&sd, sizeof(sd), WAIT_FOREVER);
+    }
+    for (i = 0; i < count; i++) {
+        os_sem_wait(hd->hd_workers_exit, WAIT_FOREVER);
+    }
+}
+
+static int httpd_workers_start(struct httpd_data *hd)
+{
+    unsigned i;
+
+    for (i = 0; i < hd->config.worker_count; i++) {
+        if (httpd_os_thread_create(&hd->hd_workers[i].handle, "httpd_w",
+                                   hd->config.worker_stack_size,
+                                   hd->config.task_priority,
+                                   httpd_worker_thread, &hd->hd_workers[i],
+                                   hd->config.core_id) != OS_SUCCESS) {
+            os_printf(LM_APP, LL_ERR, LOG_FMT("failed to start worker %d"), i);
+            httpd_workers_stop(hd, i);
+            return OS_FAIL;
+        }
+    }
+    return OS_SUCCESS;
+}
+
 /* The main HTTPD thread */
 static void httpd_thread(void *arg)
 {
@@ -245,6 +301,10 @@ static void httpd_thread(void *arg)
     }
 
     os_printf(LM_APP, LL_DBG, LOG_FMT("web server exiting"));
+    if (hd->hd_workers) {
+        /* Workers still post to the control socket until they are out */
+        httpd_workers_stop(hd, hd->config.worker_count);
+    }
     close(hd->msg_fd);
     cs_free_ctrl_sock(hd->ctrl_fd);
     httpd_close_all_sessions(hd);
@@ -324,6 +384,33 @@ static int httpd_server_init(struct httpd_data *hd)
     return OS_SUCCESS;
 }
 
+static void httpd_delete(struct httpd_data *hd);
+
+static int httpd_workers_create(struct httpd_data *hd)
+{
+    hd->hd_workers = calloc(hd->config.worker_count, sizeof(struct httpd_worker));
+    if (!hd->hd_workers) {
+        return OS_FAIL;
+    }
+    for (unsigned i = 0; i < hd->config.worker_count; i++) {
+        struct httpd_worker *w = &hd->hd_workers[i];
+        w->hd = hd;
+        w->aux.resp_hdrs = calloc(hd->config.max_resp_headers, sizeof(struct resp_hdr));
+        if (!w->aux.resp_hdrs) {
+            return OS_FAIL;
+        }
+    }
+
+    /* Room for every session, a session is queued at most once */
+    hd->hd_work_q = os_queue_create("httpd_wq", hd->config.max_open_sockets,
+                                    sizeof(struct sock_db *), 0);
+    hd->hd_workers_exit = os_sem_create(hd->config.worker_count, 0);
+    if (!hd->hd_work_q || !hd->hd_workers_exit) {
+        return OS_FAIL;
+    }
+    return OS_SUCCESS;
+}
+
 static struct httpd_data *httpd_create(const httpd_config_t *config)
 {
     /* Allocate memory for httpd instance data */
@@ -365,6 +452,18 @@ static struct httpd_data *httpd_create(const httpd_config_t *config)
     }
     /* Save the configuration for this instance */
     hd->config = *config;
+
+    hd->hd_call_stats = calloc(config->max_uri_handlers, sizeof(httpd_handler_stats_t));
+    if (!hd->hd_call_stats) {
+        os_printf(LM_APP, LL_ERR, LOG_FMT("Failed to allocate memory for HTTP handler statistics"));
+        httpd_delete(hd);
+        return NULL;
+    }
+    if (config->worker_count && httpd_workers_create(hd) != OS_SUCCESS) {
+        os_printf(LM_APP, LL_ERR, LOG_FMT("Failed to allocate memory for HTTP workers"));
+        httpd_delete(hd);
+        return NULL;
+    }
     return hd;
 }
 
@@ -376,9 +475,23 @@ static void httpd_delete(struct httpd_data *hd)
     free(ra->resp_hdrs);
     free(hd->hd_sd);
 
+    if (hd->hd_workers) {
+        for (unsigned i = 0; i < hd->config.worker_count; i++) {
+            free(hd->hd_workers[i].aux.resp_hdrs);
+        }
+        free(hd->hd_workers);
+    }
+    if (hd->hd_work_q) {
+        os_queue_destory(hd->hd_work_q);
+    }
+    if (hd->hd_workers_exit) {
+        os_sem_destroy(hd->hd_workers_exit);
+    }
+
     /* Free registered URI handlers */
     httpd_unregister_all_uri_handlers(hd);
     free(hd->hd_calls);
+    free(hd->hd_call_stats);
     free(hd);
 }
 
@@ -418,12 +531,22 @@ int httpd_start(httpd_handle_t *handle, const httpd_config_t *config)
     }
 
     httpd_sess_init(hd);
+    if (hd->hd_workers && httpd_workers_start(hd) != OS_SUCCESS) {
+        close(hd->listen_fd);
+        close(hd->msg_fd);
+        cs_free_ctrl_sock(hd->ctrl_fd);
+        httpd_delete(hd);
+        return ERR_HTTPD_TASK;
+    }
     if (httpd_os_thread_create(&hd->hd_td.handle, "httpd",
                                hd->config.stack_size,
                                hd->config.task_priority,
                                httpd_thread, hd,
                                hd->config.core_id) != OS_SUCCESS) {
         /* Failed to launch task */
+        if (hd->hd_workers) {
+            httpd_workers_stop(hd, hd->config.worker_count);
+        }
         httpd_delete(hd);
         return ERR_HTTPD_TASK;
     }
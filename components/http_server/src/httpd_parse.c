@@ -616,9 +616,8 @@ static void parse_init(httpd_req_t *r, http_parser *parser, parser_data_t *data)
 
 /* Function that receives TCP data and runs parser on it
  */
-static int httpd_parse_req(struct httpd_data *hd)
+static int httpd_parse_req(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     int blk_len,  offset;
     http_parser   parser;
     parser_data_t parser_data;
@@ -658,7 +657,7 @@ static int httpd_parse_req(struct httpd_data *hd)
     } while (parser_data.status != PARSING_COMPLETE);
 
     os_printf(LM_APP, LL_DBG, LOG_FMT("parsing complete"));
-    return httpd_uri(hd);
+    return httpd_uri(hd, r);
 }
 
 static void init_req(httpd_req_t *r, httpd_config_t *config)
@@ -684,6 +683,7 @@ static void init_req_aux(struct httpd_req_aux *ra, httpd_config_t *config)
     ra->first_chunk_sent = 0;
     ra->req_hdrs_count = 0;
     ra->resp_hdrs_count = 0;
+    ra->handler = -1;
 #if CONFIG_HTTPD_WS_SUPPORT
     ra->ws_handshake_detect = false;
 #endif
@@ -707,12 +707,21 @@ static void httpd_req_cleanup(httpd_req_t *r)
     }
 #endif
 
+    /* Push out anything the handler left in the output buffer, e.g. a
+     * chunked response that was never terminated */
+    if (httpd_sess_flush(ra->sd) != OS_SUCCESS) {
+        os_printf(LM_APP, LL_DBG, LOG_FMT("error flushing fd = %d"), ra->sd->fd);
+    }
+
     /* Retrieve session info from the request into the socket database. */
     ra->sd->ctx = r->sess_ctx;
     ra->sd->free_ctx = r->free_ctx;
     ra->sd->ignore_sess_ctx_changes = r->ignore_sess_ctx_changes;
 
     /* Clear out the request and request_aux structures */
+    if (ra->sd->req == r) {
+        ra->sd->req = NULL;
+    }
     ra->sd = NULL;
     r->handle = NULL;
     r->aux = NULL;
@@ -721,17 +730,18 @@ static void httpd_req_cleanup(httpd_req_t *r)
 /* Function that processes incoming TCP data and
  * updates the http request data httpd_req_t
  */
-int httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
+int httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd)
 {
-    httpd_req_t *r = &hd->hd_req;
+    /* The caller owns the request structures: the server's own in the
+     * classic mode, the worker's otherwise */
     init_req(r, &hd->config);
-    init_req_aux(&hd->hd_req_aux, &hd->config);
+    init_req_aux(ra, &hd->config);
     r->handle = hd;
-    r->aux = &hd->hd_req_aux;
+    r->aux = ra;
 
     /* Associate the request to the socket */
-    struct httpd_req_aux *ra = r->aux;
     ra->sd = sd;
+    sd->req = r;
 
     /* Set defaults */
     ra->status = (char *)HTTPD_200;
@@ -780,7 +790,7 @@ int httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 #endif
 
     /* Parse request */
-    ret = httpd_parse_req(hd);
+    ret = httpd_parse_req(hd, r);
     if (ret != OS_SUCCESS) {
         httpd_req_cleanup(r);
     }
@@ -789,9 +799,8 @@ int httpd_req_new(struct httpd_data *hd, struct sock_db *sd)
 
 /* Function that resets the http request data
  */
-int httpd_req_delete(struct httpd_data *hd)
+int httpd_req_delete(struct httpd_data *hd, httpd_req_t *r)
 {
-    httpd_req_t *r = &hd->hd_req;
     struct httpd_req_aux *ra = r->aux;
 
     /* Finish off reading any pending/leftover data */
@@ -813,20 +822,77 @@ int httpd_req_delete(struct httpd_data *hd)
     return OS_SUCCESS;
 }
 
+int httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
+{
+    if (r == NULL || out == NULL || r->handle == NULL || r->aux == NULL) {
+        return ERR_INVALID_ARG;
+    }
+    /* Already moved to a copy, or not inside a handler at all */
+    if (!httpd_validate_req_ptr(r)) {
+        return ERR_INVALID_STATE;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) r->handle;
+    struct httpd_req_aux *ra = r->aux;
+
+    /* One allocation for the request, its aux data and the response
+     * header slots */
+    size_t hdrs_size = hd->config.max_resp_headers * sizeof(struct resp_hdr);
+    httpd_req_t *copy = malloc(sizeof(httpd_req_t) + sizeof(struct httpd_req_aux) + hdrs_size);
+    if (copy == NULL) {
+        return ERR_NO_MEM;
+    }
+    struct httpd_req_aux *copy_ra = (struct httpd_req_aux *)(copy + 1);
+
+    memcpy(copy, r, sizeof(*copy));
+    memcpy(copy_ra, ra, sizeof(*copy_ra));
+    copy->aux = copy_ra;
+    copy_ra->resp_hdrs = (struct resp_hdr *)(copy_ra + 1);
+    memcpy(copy_ra->resp_hdrs, ra->resp_hdrs, hdrs_size);
+
+    /* From here on the session belongs to the copy: it stays out of
+     * select() and is not handed to a worker, whichever mode we run in */
+    ra->sd->busy = true;
+    ra->sd->req = copy;
+
+    os_printf(LM_APP, LL_DBG, LOG_FMT("fd = %d"), ra->sd->fd);
+    *out = copy;
+    return OS_SUCCESS;
+}
+
+int httpd_req_async_handler_complete(httpd_req_t *r)
+{
+    if (!httpd_validate_req_ptr(r)) {
+        return ERR_INVALID_ARG;
+    }
+
+    struct httpd_data *hd = (struct httpd_data *) r->handle;
+    struct httpd_req_aux *ra = r->aux;
+    struct sock_db *sd = ra->sd;
+
+    httpd_uri_stats_record(hd, r, OS_SUCCESS, true);
+    sd->proc_ret = httpd_req_delete(hd, r);
+    free(r);
+
+    os_printf(LM_APP, LL_DBG, LOG_FMT("fd = %d"), sd->fd);
+    if (httpd_queue_work(hd, httpd_sess_done, sd) != OS_SUCCESS) {
+        os_printf(LM_APP, LL_ERR, LOG_FMT("fd = %d stays busy"), sd->fd);
+    }
+    return OS_SUCCESS;
+}
+
 /* Validates the request to prevent users from calling APIs, that are to
  * be called only inside URI handler, outside the handler context
  */
 bool httpd_validate_req_ptr(httpd_req_t *r)
 {
-    if (r) {
-        struct httpd_data *hd = (struct httpd_data *) r->handle;
-        if (hd) {
-            /* Check if this function is running in the context of
-             * the correct httpd server thread */
-            if (httpd_os_thread_handle() == hd->hd_td.handle) {
-                return true;
-            }
-        }
+    /* Requests are run by the server task, a worker or, once taken over by
+     * httpd_req_async_handler_begin(), any task at all. What they have in
+     * common is that the request stays attached to its session until it
+     * is deleted */
+    if (r && r->handle && r->aux) {
+        struct httpd_req_aux *ra = r->aux;
+        return ra->sd != NULL && ra->sd->req == r;
     }
     return false;
 }
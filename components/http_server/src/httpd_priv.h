@@ -19,6 +19,7 @@
 #include <sys/param.h>
 #include <http_server_service.h>
 #include "http_os.h"
+#include "chip_clk_ctrl.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,6 +33,15 @@ extern "C" {
 /* Calculate the maximum size needed for the scratch buffer */
 #define HTTPD_SCRATCH_BUF  MAX(HTTPD_MAX_REQ_HDR_LEN, HTTPD_MAX_URI_LEN)
 
+/* Size of the per-session buffer that collects the status line, headers and
+ * chunk framing of a response so they leave in one vectored send */
+#ifndef CONFIG_HTTPD_OUT_BUF_SIZE
+#define CONFIG_HTTPD_OUT_BUF_SIZE  512
+#endif
+
+/* PIT ticks per microsecond, for the latency statistics */
+#define HTTPD_PIT_TICKS_PER_US  (CHIP_CLOCK_APB / 1000000)
+
 /* Formats a log string to prepend context function name */
 #define LOG_FMT(x)      "%s: " x, __func__
 
@@ -66,6 +76,12 @@ struct sock_db {
     bool lru_socket;                        /*!< Flag indicating LRU socket */
     char pending_data[PARSER_BLOCK_SIZE];   /*!< Buffer for pending data to be received */
     size_t pending_len;                     /*!< Length of pending data to be received */
+    char *out_buf;                          /*!< Response output buffer, allocated on first use */
+    size_t out_len;                         /*!< Length of data waiting in the output buffer */
+    httpd_req_t *req;                       /*!< Request being processed on this session, NULL when idle */
+    bool busy;                              /*!< Owned by a worker or an async request, left out of select() */
+    bool close_req;                         /*!< Close requested while busy, done once the request completes */
+    int proc_ret;                           /*!< Result of the request, handed back to the server task */
 #ifdef CONFIG_HTTPD_WS_SUPPORT
     bool ws_handshake_done;                 /*!< True if it has done WebSocket handshake (if this socket is a valid WS) */
     bool ws_close;                          /*!< Set to true to close the socket later (when WS Close frame received) */
@@ -85,8 +101,11 @@ struct httpd_req_aux {
     char           *status;                         /*!< HTTP response's status code */
     char           *content_type;                   /*!< HTTP response's content type */
     bool            first_chunk_sent;               /*!< Used to indicate if first chunk sent */
+    unsigned        resp_start;                     /*!< PIT tick at which the response was started */
     unsigned        req_hdrs_count;                 /*!< Count of total headers in request packet */
     unsigned        resp_hdrs_count;                /*!< Count of additional headers in response packet */
+    int             handler;                        /*!< Index of the URI handler running the request, -1 if none */
+    unsigned        handler_start;                  /*!< PIT tick at which the URI handler was invoked */
     struct resp_hdr {
         const char *field;
         const char *value;
@@ -99,6 +118,17 @@ struct httpd_req_aux {
 #endif
 };
 
+/**
+ * @brief   Worker task context, each worker runs requests on its own
+ *          request structures so sessions are served in parallel
+ */
+struct httpd_worker {
+    othread_t handle;                       /*!< Worker task */
+    struct httpd_data *hd;                  /*!< Server the worker belongs to */
+    struct httpd_req req;                   /*!< Request processed by this worker */
+    struct httpd_req_aux aux;               /*!< Additional data about the request */
+};
+
 /**
  * @brief   Server data for each instance. This is exposed publicly as
  *          httpd_handle_t but internal structure/members are kept private.
@@ -116,6 +146,13 @@ struct httpd_data {
 
     /* Array of registered error handler functions */
     httpd_err_handler_func_t *err_handler_fns;
+
+    httpd_tx_stats_t tx_stats;              /*!< Response transmit statistics */
+    httpd_handler_stats_t *hd_call_stats;   /*!< Statistics of each registered URI handler */
+
+    struct httpd_worker *hd_workers;        /*!< Worker tasks, NULL when requests run in the server task */
+    os_queue_handle_t hd_work_q;            /*!< Sessions with data, waiting for a worker */
+    os_sem_handle_t hd_workers_exit;        /*!< Posted by each worker as it exits */
 };
 
 struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd);
@@ -123,6 +160,11 @@ void httpd_sess_delete_invalid(struct httpd_data *hd);
 void httpd_sess_init(struct httpd_data *hd);
 int httpd_sess_new(struct httpd_data *hd, int newfd);
 int httpd_sess_process(struct httpd_data *hd, int clifd);
+int httpd_sess_process_req(struct httpd_data *hd, struct sock_db *sd, httpd_req_t *r, struct httpd_req_aux *ra);
+/* httpd_sess_process_req() result when the request was taken over by
+ * httpd_req_async_handler_begin() and the session is still in use */
+#define HTTPD_SESS_ASYNC    1
+void httpd_sess_done(void *arg);
 int httpd_sess_delete(struct httpd_data *hd, int clifd);
 void httpd_sess_free_ctx(void *ctx, httpd_free_ctx_fn_t free_fn);
 void httpd_sess_set_descriptors(struct httpd_data *hd, fd_set *fdset, int *maxfd);
@@ -130,7 +172,8 @@ int httpd_sess_iterate(struct httpd_data *hd, int fd);
 bool httpd_is_sess_available(struct httpd_data *hd);
 bool httpd_sess_pending(struct httpd_data *hd, int fd);
 int httpd_sess_close_lru(struct httpd_data *hd);
-int httpd_uri(struct httpd_data *hd);
+int httpd_uri(struct httpd_data *hd, httpd_req_t *req);
+void httpd_uri_stats_record(struct httpd_data *hd, httpd_req_t *req, int ret, bool async);
 void httpd_unregister_all_uri_handlers(struct httpd_data *hd);
 bool httpd_validate_req_ptr(httpd_req_t *r);
 
@@ -140,10 +183,12 @@ bool httpd_validate_req_ptr(httpd_req_t *r);
 #define httpd_valid_req(r)  true
 #endif
 
-int httpd_req_new(struct httpd_data *hd, struct sock_db *sd);
-int httpd_req_delete(struct httpd_data *hd);
+int httpd_req_new(struct httpd_data *hd, httpd_req_t *r, struct httpd_req_aux *ra, struct sock_db *sd);
+int httpd_req_delete(struct httpd_data *hd, httpd_req_t *r);
 int httpd_req_handle_err(httpd_req_t *req, httpd_err_code_t error);
 int httpd_send(httpd_req_t *req, const char *buf, size_t buf_len);
+int httpd_sess_flush(struct sock_db *sd);
+int httpd_resp_send_head(httpd_req_t *r, ssize_t content_len);
 int httpd_recv_with_opt(httpd_req_t *r, char *buf, size_t buf_len, bool halt_after_pending);
 size_t httpd_unrecv(struct httpd_req *r, const char *buf, size_t buf_len);
 int httpd_default_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags);
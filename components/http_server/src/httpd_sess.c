@@ -33,14 +33,6 @@ struct sock_db *httpd_sess_get(struct httpd_data *hd, int sockfd)
         return NULL;
     }
 
-    /* Check if called inside a request handler, and the
-     * session sockfd in use is same as the parameter */
-    if ((hd->hd_req_aux.sd) && (hd->hd_req_aux.sd->fd == sockfd)) {
-        /* Just return the pointer to the sock_db
-         * corresponding to the request */
-        return hd->hd_req_aux.sd;
-    }
-
     int i;
     for (i = 0; i < hd->config.max_open_sockets; i++) {
         if (hd->hd_sd[i].fd == sockfd) {
@@ -102,12 +94,10 @@ void *httpd_sess_get_ctx(httpd_handle_t handle, int sockfd)
         return NULL;
     }
 
-    /* Check if the function has been called from inside a
-     * request handler, in which case fetch the context from
-     * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        return hd->hd_req.sess_ctx;
+    /* Check if a request is being handled on the session, in
+     * which case fetch the context from the httpd_req_t structure */
+    if (sd->req) {
+        return sd->req->sess_ctx;
     }
 
     return sd->ctx;
@@ -120,21 +110,20 @@ void httpd_sess_set_ctx(httpd_handle_t handle, int sockfd, void *ctx, httpd_free
         return;
     }
 
-    /* Check if the function has been called from inside a
-     * request handler, in which case set the context inside
-     * the httpd_req_t structure */
-    struct httpd_data *hd = (struct httpd_data *) handle;
-    if (hd->hd_req_aux.sd == sd) {
-        if (hd->hd_req.sess_ctx != ctx) {
+    /* Check if a request is being handled on the session, in
+     * which case set the context inside the httpd_req_t structure */
+    httpd_req_t *r = sd->req;
+    if (r) {
+        if (r->sess_ctx != ctx) {
             /* Don't free previous context if it is in sockdb
              * as it will be freed inside httpd_req_cleanup() */
-            if (sd->ctx != hd->hd_req.sess_ctx) {
+            if (sd->ctx != r->sess_ctx) {
                 /* Free previous context */
-                httpd_sess_free_ctx(hd->hd_req.sess_ctx, hd->hd_req.free_ctx);
+                httpd_sess_free_ctx(r->sess_ctx, r->free_ctx);
             }
-            hd->hd_req.sess_ctx = ctx;
+            r->sess_ctx = ctx;
         }
-        hd->hd_req.free_ctx = free_fn;
+        r->free_ctx = free_fn;
         return;
     }
 
@@ -178,7 +167,8 @@ void httpd_sess_set_descriptors(struct httpd_data *hd,
     int i;
     *maxfd = -1;
     for (i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1) {
+        /* A busy session is read by whoever runs its request */
+        if (hd->hd_sd[i].fd != -1 && !hd->hd_sd[i].busy) {
             FD_SET(hd->hd_sd[i].fd, fdset);
             if (hd->hd_sd[i].fd > *maxfd) {
                 *maxfd = hd->hd_sd[i].fd;
@@ -203,7 +193,7 @@ static inline uint64_t httpd_sess_get_lru_counter(void)
 void httpd_sess_delete_invalid(struct httpd_data *hd)
 {
     for (int i = 0; i < hd->config.max_open_sockets; i++) {
-        if (hd->hd_sd[i].fd != -1 && !fd_is_valid(hd->hd_sd[i].fd)) {
+        if (hd->hd_sd[i].fd != -1 && !hd->hd_sd[i].busy && !fd_is_valid(hd->hd_sd[i].fd)) {
             os_printf(LM_APP, LL_WARN, LOG_FMT("Closing invalid socket %d"), hd->hd_sd[i].fd);
             httpd_sess_delete(hd, hd->hd_sd[i].fd);
         }
@@ -244,6 +234,13 @@ int httpd_sess_delete(struct httpd_data *hd, int fd)
                 hd->hd_sd[i].free_transport_ctx = NULL;
             }
 
+            /* release response output buffer */
+            if (hd->hd_sd[i].out_buf) {
+                os_free(hd->hd_sd[i].out_buf);
+                hd->hd_sd[i].out_buf = NULL;
+                hd->hd_sd[i].out_len = 0;
+            }
+
             /* mark session slot as available */
             hd->hd_sd[i].fd = -1;
             break;
@@ -269,8 +266,8 @@ void httpd_sess_init(struct httpd_data *hd)
 bool httpd_sess_pending(struct httpd_data *hd, int fd)
 {
     struct sock_db *sd = httpd_sess_get(hd, fd);
-    if (! sd) {
-        return OS_FAIL;
+    if (! sd || sd->busy) {
+        return false;
     }
 
     if (sd->pending_fn) {
@@ -295,19 +292,74 @@ int httpd_sess_process(struct httpd_data *hd, int newfd)
         return OS_FAIL;
     }
 
+    /* Hand the session to a worker, it is left out of select() until
+     * httpd_sess_done() gives it back */
+    if (hd->hd_workers) {
+        sd->busy = true;
+        if (os_queue_send(hd->hd_work_q, (char *)&sd, sizeof(sd), 0) == 0) {
+            return OS_SUCCESS;
+        }
+        sd->busy = false;
+        os_printf(LM_APP, LL_WARN, LOG_FMT("work queue full, fd = %d"), newfd);
+    }
+
+    int ret = httpd_sess_process_req(hd, sd, &hd->hd_req, &hd->hd_req_aux);
+    if (ret == HTTPD_SESS_ASYNC) {
+        return OS_SUCCESS;
+    }
+    if (ret != OS_SUCCESS) {
+        return OS_FAIL;
+    }
+    os_printf(LM_APP, LL_DBG, LOG_FMT("success"));
+    sd->lru_counter = httpd_sess_get_lru_counter();
+    return OS_SUCCESS;
+}
+
+/* Runs one request on the session with the given request structures,
+ * in the server task or in a worker */
+int httpd_sess_process_req(struct httpd_data *hd, struct sock_db *sd, httpd_req_t *r, struct httpd_req_aux *ra)
+{
     os_printf(LM_APP, LL_DBG, LOG_FMT("httpd_req_new"));
-    if (httpd_req_new(hd, sd) != OS_SUCCESS) {
+    if (httpd_req_new(hd, r, ra, sd) != OS_SUCCESS) {
         return OS_FAIL;
     }
+
+    /* The handler moved the request to a copy, which is finished and
+     * deleted by httpd_req_async_handler_complete(). Only drop our view
+     * of it, the copy may well be completed already */
+    if (sd->req != r) {
+        os_printf(LM_APP, LL_DBG, LOG_FMT("async"));
+        r->handle = NULL;
+        r->aux = NULL;
+        return HTTPD_SESS_ASYNC;
+    }
+
     os_printf(LM_APP, LL_DBG, LOG_FMT("httpd_req_delete"));
-    if (httpd_req_delete(hd) != OS_SUCCESS) {
+    if (httpd_req_delete(hd, r) != OS_SUCCESS) {
         return OS_FAIL;
     }
-    os_printf(LM_APP, LL_DBG, LOG_FMT("success"));
-    sd->lru_counter = httpd_sess_get_lru_counter();
     return OS_SUCCESS;
 }
 
+/* Work queued on the server task once a worker or an async request is
+ * done with the session */
+void httpd_sess_done(void *arg)
+{
+    struct sock_db *sd = (struct sock_db *)arg;
+    struct httpd_data *hd = (struct httpd_data *) sd->handle;
+
+    sd->busy = false;
+    if (sd->proc_ret != OS_SUCCESS || sd->close_req) {
+        int fd = sd->fd;
+        os_printf(LM_APP, LL_DBG, LOG_FMT("closing socket %d"), fd);
+        sd->close_req = false;
+        httpd_sess_delete(hd, fd);
+        close(fd);
+        return;
+    }
+    sd->lru_counter = httpd_sess_get_lru_counter();
+}
+
 int httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd)
 {
     if (handle == NULL) {
@@ -381,6 +433,11 @@ static void httpd_sess_close(void *arg)
             os_printf(LM_APP, LL_DBG, "Skipping session close for %d as it seems to be a race condition", sock_db->fd);
             return;
         }
+        if (sock_db->busy) {
+            /* Closed by httpd_sess_done() once the request is over */
+            sock_db->close_req = true;
+            return;
+        }
         int fd = sock_db->fd;
         sock_db->lru_socket = false;
         struct httpd_data *hd = (struct httpd_data *) sock_db->handle;
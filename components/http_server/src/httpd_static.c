@@ -0,0 +1,294 @@
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <http_server_service.h>
+#include <httpd_static.h>
+#include "httpd_priv.h"
+#include "easyflash.h"
+#include "chip_memmap.h"
+
+/* Longest request path looked up in the pack */
+#define HTTPD_STATIC_PATH_MAX   128
+
+/* Room for request header values we inspect: ETag lists, ranges, encodings */
+#define HTTPD_STATIC_HDR_MAX    96
+
+static const httpd_static_hdr_t *httpd_static_pack;
+
+static inline const char *httpd_static_str(uint32_t off)
+{
+    return (const char *)httpd_static_pack + off;
+}
+
+static inline const httpd_static_entry_t *httpd_static_entries(const httpd_static_hdr_t *pack)
+{
+    return (const httpd_static_entry_t *)(pack + 1);
+}
+
+static bool httpd_static_str_valid(const httpd_static_hdr_t *pack, uint32_t off)
+{
+    if (off >= pack->size) {
+        return false;
+    }
+    return memchr((const char *)pack + off, '\0', pack->size - off) != NULL;
+}
+
+int httpd_static_mount(const void *pack, size_t size)
+{
+    const httpd_static_hdr_t *hdr = (const httpd_static_hdr_t *)pack;
+    const httpd_static_entry_t *e;
+    const char *prev = NULL;
+
+    /* The tables are read in place, so the image must be word aligned */
+    if (hdr == NULL || ((uintptr_t)hdr & 3) || size < sizeof(*hdr)) {
+        return ERR_INVALID_ARG;
+    }
+    if (hdr->magic != HTTPD_STATIC_MAGIC || hdr->version != HTTPD_STATIC_VERSION) {
+        os_printf(LM_APP, LL_ERR, LOG_FMT("no asset pack at %p"), pack);
+        return ERR_INVALID_VERSION;
+    }
+    if (hdr->size > size || sizeof(*hdr) + hdr->count * sizeof(*e) > hdr->size) {
+        return ERR_INVALID_SIZE;
+    }
+
+    /* Check the table once so lookups can trust it */
+    e = httpd_static_entries(hdr);
+    for (unsigned i = 0; i < hdr->count; i++, e++) {
+        if (!httpd_static_str_valid(hdr, e->path_off) ||
+            !httpd_static_str_valid(hdr, e->type_off) ||
+            e->data_off > hdr->size || e->data_len > hdr->size - e->data_off) {
+            os_printf(LM_APP, LL_ERR, LOG_FMT("bad entry %d"), i);
+            return ERR_INVALID_SIZE;
+        }
+        if (prev && strcmp(prev, (const char *)hdr + e->path_off) > 0) {
+            os_printf(LM_APP, LL_ERR, LOG_FMT("entries not sorted"));
+            return ERR_INVALID_SIZE;
+        }
+        prev = (const char *)hdr + e->path_off;
+    }
+
+    httpd_static_pack = hdr;
+    os_printf(LM_APP, LL_INFO, LOG_FMT("%d assets, %d bytes"), hdr->count, hdr->size);
+    return OS_SUCCESS;
+}
+
+int httpd_static_mount_partition(const char *name)
+{
+    unsigned int addr, len;
+
+    if (partion_info_get((char *)name, &addr, &len) != 0) {
+        os_printf(LM_APP, LL_ERR, LOG_FMT("no partition %s"), name);
+        return ERR_NOT_FOUND;
+    }
+    return httpd_static_mount((const void *)(addr + MEM_BASE_XIP), len);
+}
+
+void httpd_static_unmount(void)
+{
+    httpd_static_pack = NULL;
+}
+
+/* Binary search for the first entry of path, its gzip variant (if any)
+ * follows directly */
+static const httpd_static_entry_t *httpd_static_lookup(const char *path)
+{
+    const httpd_static_entry_t *e = httpd_static_entries(httpd_static_pack);
+    int lo = 0, hi = httpd_static_pack->count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(httpd_static_str(e[mid].path_off), path) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < httpd_static_pack->count && strcmp(httpd_static_str(e[lo].path_off), path) == 0) {
+        return &e[lo];
+    }
+    return NULL;
+}
+
+static bool httpd_static_hdr_get(httpd_req_t *req, const char *field, char *val, size_t val_size)
+{
+    return httpd_req_get_hdr_value_str(req, field, val, val_size) == OS_SUCCESS;
+}
+
+/* Parse a single "bytes=first-last" range against an asset of len bytes.
+ * Returns 1 for a usable range, 0 to ignore the header, -1 if unsatisfiable */
+static int httpd_static_range(const char *val, uint32_t len, uint32_t *first, uint32_t *last)
+{
+    char *end;
+    unsigned long a, b;
+
+    if (strncmp(val, "bytes=", 6) != 0 || strchr(val, ',') != NULL) {
+        /* Other units and multipart ranges: send the whole asset */
+        return 0;
+    }
+    val += 6;
+
+    if (*val == '-') {
+        /* Suffix range: the last n bytes */
+        b = strtoul(val + 1, &end, 10);
+        if (end == val + 1 || *end != '\0') {
+            return 0;
+        }
+        if (b == 0 || len == 0) {
+            return -1;
+        }
+        *first = (b >= len) ? 0 : len - b;
+        *last  = len - 1;
+        return 1;
+    }
+
+    a = strtoul(val, &end, 10);
+    if (end == val || *end != '-') {
+        return 0;
+    }
+    val = end + 1;
+    if (*val == '\0') {
+        b = len ? len - 1 : 0;
+    } else {
+        b = strtoul(val, &end, 10);
+        if (*end != '\0' || b < a) {
+            return 0;
+        }
+    }
+    if (a >= len) {
+        return -1;
+    }
+    *first = a;
+    *last  = (b >= len) ? len - 1 : b;
+    return 1;
+}
+
+int httpd_static_send(httpd_req_t *req, const char *path)
+{
+    const httpd_static_entry_t *e;
+    char val[HTTPD_STATIC_HDR_MAX];
+    char etag[11];
+    char content_range[40];
+    uint32_t first = 0, last = 0, len;
+    int range = 0;
+
+    if (req == NULL || path == NULL) {
+        return ERR_INVALID_ARG;
+    }
+    if (httpd_static_pack == NULL || (e = httpd_static_lookup(path)) == NULL) {
+        return ERR_NOT_FOUND;
+    }
+
+    /* Prefer the precompressed variant, and use it anyway when it is the
+     * only one stored */
+    bool pair = !(e->flags & HTTPD_STATIC_F_GZIP) &&
+                e + 1 < httpd_static_entries(httpd_static_pack) + httpd_static_pack->count &&
+                (e[1].flags & HTTPD_STATIC_F_GZIP) && strcmp(httpd_static_str(e[1].path_off), path) == 0;
+    if (pair && httpd_static_hdr_get(req, "Accept-Encoding", val, sizeof(val)) && strstr(val, "gzip")) {
+        e++;
+    }
+    if (e->flags & HTTPD_STATIC_F_GZIP) {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+    if (pair) {
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+
+    len = e->data_len;
+    snprintf(etag, sizeof(etag), "\"%08x\"", (unsigned int)e->etag);
+    httpd_resp_set_type(req, httpd_static_str(e->type_off));
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", CONFIG_HTTPD_STATIC_CACHE_CONTROL);
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+
+    /* Revalidation: the client's copy is current, send no body */
+    if (httpd_static_hdr_get(req, "If-None-Match", val, sizeof(val)) &&
+        (strstr(val, etag) || strcmp(val, "*") == 0)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send_head(req, len) == OS_SUCCESS ? OS_SUCCESS : ERR_HTTPD_RESP_SEND;
+    }
+
+    /* A range only applies to the variant named in If-Range, if any */
+    if (httpd_static_hdr_get(req, "Range", val, sizeof(val))) {
+        range = httpd_static_range(val, len, &first, &last);
+        if (range && httpd_static_hdr_get(req, "If-Range", val, sizeof(val)) && strcmp(val, etag) != 0) {
+            range = 0;
+        }
+    }
+
+    if (range < 0) {
+        snprintf(content_range, sizeof(content_range), "bytes */%u", (unsigned int)len);
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+        httpd_resp_set_status(req, "416 Range Not Satisfiable");
+        return httpd_resp_send(req, NULL, 0) == OS_SUCCESS ? OS_SUCCESS : ERR_HTTPD_RESP_SEND;
+    }
+
+    if (range > 0) {
+        snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u",
+                 (unsigned int)first, (unsigned int)last, (unsigned int)len);
+        httpd_resp_set_hdr(req, "Content-Range", content_range);
+        httpd_resp_set_status(req, "206 Partial Content");
+    } else {
+        first = 0;
+        last  = len ? len - 1 : 0;
+    }
+    len = len ? last - first + 1 : 0;
+
+    if (req->method == HTTP_HEAD) {
+        return httpd_resp_send_head(req, len) == OS_SUCCESS ? OS_SUCCESS : ERR_HTTPD_RESP_SEND;
+    }
+
+    /* The body goes to the socket straight from its XIP address */
+    return httpd_resp_send(req, httpd_static_str(e->data_off) + first, len) == OS_SUCCESS ?
+           OS_SUCCESS : ERR_HTTPD_RESP_SEND;
+}
+
+int httpd_static_handler(httpd_req_t *req)
+{
+    char path[HTTPD_STATIC_PATH_MAX];
+    size_t n = strcspn(req->uri, "?#");
+
+    if (n + sizeof("index.html") > sizeof(path)) {
+        return httpd_resp_send_err(req, HTTPD_414_URI_TOO_LONG, NULL);
+    }
+    memcpy(path, req->uri, n);
+    path[n] = '\0';
+    if (n && path[n - 1] == '/') {
+        strcpy(path + n, "index.html");
+    }
+
+    int ret = httpd_static_send(req, path);
+    if (ret == ERR_NOT_FOUND) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+    }
+    return ret;
+}
+
+int httpd_static_register(httpd_handle_t handle, const char *uri)
+{
+    httpd_uri_t static_uri = {
+        .uri      = uri,
+        .method   = HTTP_GET,
+        .handler  = httpd_static_handler,
+        .user_ctx = NULL
+    };
+    int ret = httpd_register_uri_handler(handle, &static_uri);
+
+    if (ret == OS_SUCCESS) {
+        static_uri.method = HTTP_HEAD;
+        ret = httpd_register_uri_handler(handle, &static_uri);
+    }
+    return ret;
+}
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <string.h>
+#include "httpd_priv.h"
+#include "pit.h"
+#include "chip_clk_ctrl.h"
+
+/*
+ * drives the response path against a sink standing in for the socket. every
+ * call into the sink is one write into the tcp stack, i.e. one segment with
+ * nodelay, or one more small write for nagle to sit on without it. the same
+ * responses go out once the way the server used to send them (a send per
+ * header field, separator and chunk size line) and once through the output
+ * buffer, the two byte streams must match.
+ */
+#define HTTPD_TX_SINK_FD        0x7ff0
+#define HTTPD_TX_TICKS_PER_US   (CHIP_CLOCK_APB / 1000000)
+
+typedef struct {
+    unsigned int     calls;
+    unsigned int     bytes;
+    unsigned int     hash;
+    unsigned int     call_us;       //simulated cost of one write into the stack
+}httpd_tx_sink_t;
+
+static httpd_tx_sink_t httpd_tx_sink;
+
+static const char *httpd_tx_hdrs[][2] = {
+    {"Cache-Control", "no-cache"},
+    {"Connection", "keep-alive"},
+    {"Access-Control-Allow-Origin", "*"},
+    {"X-Content-Type-Options", "nosniff"},
+    {"Server", "ECR6600"},
+};
+
+static int httpd_tx_sink_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf_len, int flags)
+{
+    httpd_tx_sink_t *sink = &httpd_tx_sink;
+    unsigned int begin, i;
+
+    for (i = 0; i < buf_len; i++) {
+        sink->hash = sink->hash * 33 + (unsigned char)buf[i];
+    }
+    sink->calls++;
+    sink->bytes += buf_len;
+
+    if (sink->call_us) {
+        begin = drv_pit_get_tick();
+        while (drv_pit_get_tick() - begin < sink->call_us * HTTPD_TX_TICKS_PER_US);
+    }
+    return buf_len;
+}
+
+/* the pre-buffering response path, one send per piece */
+static int httpd_tx_legacy_hdrs(httpd_req_t *r, const char *fmt, ssize_t len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    unsigned int i;
+
+    snprintf(ra->scratch, sizeof(ra->scratch), fmt, ra->status, ra->content_type, len);
+    httpd_send(r, ra->scratch, strlen(ra->scratch));
+    for (i = 0; i < ra->resp_hdrs_count; i++) {
+        httpd_send(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field));
+        httpd_send(r, ": ", 2);
+        httpd_send(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value));
+        httpd_send(r, "\r\n", 2);
+    }
+    return httpd_send(r, "\r\n", 2);
+}
+
+static void httpd_tx_legacy_send(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    httpd_tx_legacy_hdrs(r, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n", len);
+    if (len) {
+        httpd_send(r, buf, len);
+    }
+}
+
+static void httpd_tx_legacy_chunk(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    char len_str[10];
+
+    if (!ra->first_chunk_sent) {
+        httpd_tx_legacy_hdrs(r, "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n", 0);
+        ra->first_chunk_sent = true;
+    }
+    snprintf(len_str, sizeof(len_str), "%x\r\n", len);
+    httpd_send(r, len_str, strlen(len_str));
+    if (len) {
+        httpd_send(r, buf, len);
+    }
+    httpd_send(r, "\r\n", 2);
+}
+
+static void httpd_tx_req_reset(struct httpd_data *hd, unsigned int hdrs)
+{
+    httpd_req_t *r = &hd->hd_req;
+    struct httpd_req_aux *ra = &hd->hd_req_aux;
+    unsigned int i, n = sizeof(httpd_tx_hdrs) / sizeof(httpd_tx_hdrs[0]);
+
+    r->handle = hd;
+    r->aux = ra;
+    ra->sd = hd->hd_sd;
+    hd->hd_sd->req = r;
+    ra->status = (char *)HTTPD_200;
+    ra->content_type = (char *)HTTPD_TYPE_JSON;
+    ra->first_chunk_sent = false;
+    ra->resp_hdrs_count = 0;
+    for (i = 0; i < hdrs; i++) {
+        httpd_resp_set_hdr(r, httpd_tx_hdrs[i % n][0], httpd_tx_hdrs[i % n][1]);
+    }
+}
+
+static unsigned int httpd_tx_run(struct httpd_data *hd, int legacy, unsigned int loops,
+                                 unsigned int hdrs, const char *body, unsigned int len, unsigned int chunk)
+{
+    httpd_req_t *r = &hd->hd_req;
+    unsigned int i, off, n, begin, ticks = 0;
+
+    for (i = 0; i < loops; i++) {
+        httpd_tx_req_reset(hd, hdrs);
+
+        begin = drv_pit_get_tick();
+        if (!chunk) {
+            if (legacy) {
+                httpd_tx_legacy_send(r, body, len);
+            } else {
+                httpd_resp_send(r, body, len);
+            }
+        } else {
+            for (off = 0; off <= len; off += n) {
+                //the zero length chunk at the end terminates the response
+                n = (len - off > chunk) ? chunk : len - off;
+                if (legacy) {
+                    httpd_tx_legacy_chunk(r, body + off, n);
+                } else {
+                    httpd_resp_send_chunk(r, body + off, n);
+                }
+                if (!n) {
+                    break;
+                }
+            }
+        }
+        httpd_sess_flush(hd->hd_sd);
+        ticks += drv_pit_get_tick() - begin;
+    }
+
+    return ticks / HTTPD_TX_TICKS_PER_US;
+}
+
+static int httpd_tx_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+    httpd_tx_sink_t *sink = &httpd_tx_sink;
+    struct httpd_data *hd;
+    httpd_tx_stats_t stats;
+    unsigned int loops, hdrs, len, chunk, i, us[2], calls[2], bytes[2], hash[2];
+    char *body = NULL;
+    int ret = CMD_RET_FAILURE;
+
+    if (argc < 4) {
+        os_printf(LM_CMD, LL_INFO, "usage: httpd_tx bench <responses> <headers> <body> [chunk] [call_us]\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    loops = strtoul(argv[1], NULL, 0);
+    loops = loops ? loops : 1;
+    hdrs  = strtoul(argv[2], NULL, 0);
+    len   = strtoul(argv[3], NULL, 0);
+    chunk = (argc > 4) ? strtoul(argv[4], NULL, 0) : 0;
+    memset(sink, 0, sizeof(*sink));
+    sink->call_us = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
+
+    hd = (struct httpd_data *)os_zalloc(sizeof(*hd));
+    if (!hd) {
+        return CMD_RET_FAILURE;
+    }
+    hd->config.max_open_sockets = 1;
+    hd->config.max_resp_headers = hdrs;
+    hd->hd_td.handle = httpd_os_thread_handle();
+    hd->hd_sd = (struct sock_db *)os_zalloc(sizeof(struct sock_db));
+    hd->hd_req_aux.resp_hdrs = os_zalloc((hdrs ? hdrs : 1) * sizeof(*hd->hd_req_aux.resp_hdrs));
+    body = (char *)os_malloc(len ? len : 1);
+    if (!hd->hd_sd || !hd->hd_req_aux.resp_hdrs || !body) {
+        goto out;
+    }
+    hd->hd_sd->fd = HTTPD_TX_SINK_FD;
+    hd->hd_sd->handle = hd;
+    hd->hd_sd->send_fn = httpd_tx_sink_send;
+    for (i = 0; i < len; i++) {
+        body[i] = 'a' + i % 26;
+    }
+
+    for (i = 0; i < 2; i++) {
+        sink->calls = sink->bytes = sink->hash = 0;
+        us[i] = httpd_tx_run(hd, !i, loops, hdrs, body, len, chunk);
+        calls[i] = sink->calls;
+        bytes[i] = sink->bytes;
+        hash[i]  = sink->hash;
+    }
+    httpd_get_tx_stats(hd, &stats, true);
+
+    os_printf(LM_CMD, LL_INFO, ">> %d responses, %d headers, %d bytes body, chunk %d\r\n", loops, hdrs, len, chunk);
+    for (i = 0; i < 2; i++) {
+        os_printf(LM_CMD, LL_INFO, "%-8s writes/resp %3d.%02d  bytes/resp %5d  %6dus/resp\r\n",
+            i ? "buffered" : "legacy", calls[i] / loops, calls[i] * 100 / loops % 100,
+            bytes[i] / loops, us[i] / loops);
+    }
+    os_printf(LM_CMD, LL_INFO, "stats: responses %d writes %d latency avg %dus max %dus\r\n",
+        stats.responses, stats.send_calls,
+        stats.responses ? stats.latency_us / stats.responses : 0, stats.latency_max_us);
+
+    if (bytes[0] == bytes[1] && hash[0] == hash[1] && stats.responses == loops) {
+        os_printf(LM_CMD, LL_INFO, "httpd_tx bench OK\r\n");
+        ret = CMD_RET_SUCCESS;
+    } else {
+        os_printf(LM_CMD, LL_INFO, "httpd_tx bench FAILED\r\n");
+    }
+
+out:
+    if (hd->hd_sd) {
+        httpd_sess_delete(hd, HTTPD_TX_SINK_FD);
+        os_free(hd->hd_sd);
+    }
+    if (hd->hd_req_aux.resp_hdrs) {
+        os_free(hd->hd_req_aux.resp_hdrs);
+    }
+    if (body) {
+        os_free(body);
+    }
+    os_free(hd);
+    return ret;
+}
+
+CLI_SUBCMD(httpd_tx, bench, httpd_tx_bench, "http server response write benchmark", "httpd_tx bench <responses> <headers> <body> [chunk] [call_us]");
+CLI_CMD(httpd_tx, NULL, "http server response path", "httpd_tx");
@@ -15,6 +15,9 @@
 
 #include <http_server_service.h>
 #include "httpd_priv.h"
+#include "pit.h"
+
+static int httpd_sock_err(const char *ctx, int sockfd);
 
 int httpd_sess_set_send_override(httpd_handle_t hd, int sockfd, httpd_send_func_t send_func)
 {
@@ -46,6 +49,99 @@ int httpd_sess_set_pending_override(httpd_handle_t hd, int sockfd, httpd_pending
     return OS_SUCCESS;
 }
 
+/* Push a scatter list out through the session. The default transport takes
+ * it in one lwip_writev() call, a send override (e.g. TLS) gets one call
+ * per segment since it only knows about flat buffers. */
+static int httpd_sendv_all(struct sock_db *sd, struct iovec *iov, int iovcnt)
+{
+    struct httpd_data *hd = (struct httpd_data *) sd->handle;
+    int ret;
+
+    while (iovcnt > 0) {
+        if (iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+
+        if (sd->send_fn == httpd_default_send) {
+            ret = lwip_writev(sd->fd, iov, iovcnt);
+            if (ret < 0) {
+                ret = httpd_sock_err("writev", sd->fd);
+            }
+        } else {
+            ret = sd->send_fn(sd->handle, sd->fd, iov->iov_base, iov->iov_len, 0);
+        }
+        if (ret < 0) {
+            os_printf(LM_APP, LL_DBG, LOG_FMT("error in send_fn"));
+            return OS_FAIL;
+        }
+        os_printf(LM_APP, LL_DBG, LOG_FMT("sent = %d"), ret);
+        unsigned int flags = system_irq_save();
+        hd->tx_stats.send_calls++;
+        hd->tx_stats.bytes += ret;
+        system_irq_restore(flags);
+
+        /* Skip over what went out, a partial write resumes mid-segment */
+        while (iovcnt > 0 && ret >= (int)iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return OS_SUCCESS;
+}
+
+/* Send whatever is buffered for the session followed by buf, in one go */
+static int httpd_out_flush(struct sock_db *sd, const char *buf, size_t buf_len)
+{
+    struct iovec iov[2];
+    int ret;
+
+    iov[0].iov_base = sd->out_buf;
+    iov[0].iov_len  = sd->out_len;
+    iov[1].iov_base = (void *)buf;
+    iov[1].iov_len  = buf ? buf_len : 0;
+
+    ret = httpd_sendv_all(sd, iov, 2);
+    sd->out_len = 0;
+    return ret;
+}
+
+/* Queue buf behind the buffered response data. Whatever does not fit in the
+ * output buffer is sent right away together with what is already queued. */
+static int httpd_out_append(struct sock_db *sd, const char *buf, size_t buf_len)
+{
+    if (sd->out_buf == NULL) {
+        sd->out_buf = os_malloc(CONFIG_HTTPD_OUT_BUF_SIZE);
+        sd->out_len = 0;
+        if (sd->out_buf == NULL) {
+            /* Unbuffered fallback, every piece is a send of its own */
+            return httpd_out_flush(sd, buf, buf_len);
+        }
+    }
+
+    if (buf_len > CONFIG_HTTPD_OUT_BUF_SIZE - sd->out_len) {
+        return httpd_out_flush(sd, buf, buf_len);
+    }
+
+    memcpy(sd->out_buf + sd->out_len, buf, buf_len);
+    sd->out_len += buf_len;
+    return OS_SUCCESS;
+}
+
+int httpd_sess_flush(struct sock_db *sd)
+{
+    if (sd->out_len == 0) {
+        return OS_SUCCESS;
+    }
+    return httpd_out_flush(sd, NULL, 0);
+}
+
 int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
 {
     if (r == NULL || buf == NULL) {
@@ -57,6 +153,12 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
     }
 
     struct httpd_req_aux *ra = r->aux;
+
+    /* Raw data must not overtake a response still sitting in the buffer */
+    if (httpd_sess_flush(ra->sd) != OS_SUCCESS) {
+        return HTTPD_SOCK_ERR_FAIL;
+    }
+
     int ret = ra->sd->send_fn(ra->sd->handle, ra->sd->fd, buf, buf_len, 0);
     if (ret < 0) {
         os_printf(LM_APP, LL_DBG, LOG_FMT("error in send_fn"));
@@ -65,24 +167,6 @@ int httpd_send(httpd_req_t *r, const char *buf, size_t buf_len)
     return ret;
 }
 
-static int httpd_send_all(httpd_req_t *r, const char *buf, size_t buf_len)
-{
-    struct httpd_req_aux *ra = r->aux;
-    int ret;
-
-    while (buf_len > 0) {
-        ret = ra->sd->send_fn(ra->sd->handle, ra->sd->fd, buf, buf_len, 0);
-        if (ret < 0) {
-            os_printf(LM_APP, LL_DBG, LOG_FMT("error in send_fn"));
-            return OS_FAIL;
-        }
-        os_printf(LM_APP, LL_DBG, LOG_FMT("sent = %d"), ret);
-        buf     += ret;
-        buf_len -= ret;
-    }
-    return OS_SUCCESS;
-}
-
 static size_t httpd_recv_pending(httpd_req_t *r, char *buf, size_t buf_len)
 {
     struct httpd_req_aux *ra = r->aux;
@@ -226,6 +310,58 @@ int httpd_resp_set_type(httpd_req_t *r, const char *type)
     return OS_SUCCESS;
 }
 
+/* Queue the status line and headers of a response in the output buffer */
+static int httpd_resp_queue_hdrs(httpd_req_t *r, const char *hdr_fmt, ssize_t buf_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    struct sock_db *sd = ra->sd;
+
+    /* Size of essential headers is limited by scratch buffer size */
+    if (snprintf(ra->scratch, sizeof(ra->scratch), hdr_fmt,
+                 ra->status, ra->content_type, buf_len) >= sizeof(ra->scratch)) {
+        return ERR_HTTPD_RESP_HDR;
+    }
+
+    ra->resp_start = drv_pit_get_tick();
+
+    /* Queue essential headers */
+    if (httpd_out_append(sd, ra->scratch, strlen(ra->scratch)) != OS_SUCCESS) {
+        return ERR_HTTPD_RESP_SEND;
+    }
+
+    /* Queue additional headers based on set_header */
+    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
+        if (httpd_out_append(sd, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != OS_SUCCESS ||
+            httpd_out_append(sd, ": ", 2) != OS_SUCCESS ||
+            httpd_out_append(sd, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != OS_SUCCESS ||
+            httpd_out_append(sd, "\r\n", 2) != OS_SUCCESS) {
+            return ERR_HTTPD_RESP_SEND;
+        }
+    }
+
+    /* End header section */
+    if (httpd_out_append(sd, "\r\n", 2) != OS_SUCCESS) {
+        return ERR_HTTPD_RESP_SEND;
+    }
+    return OS_SUCCESS;
+}
+
+static void httpd_resp_done(httpd_req_t *r)
+{
+    struct httpd_data *hd = (struct httpd_data *) r->handle;
+    struct httpd_req_aux *ra = r->aux;
+    uint32_t us = (drv_pit_get_tick() - ra->resp_start) / HTTPD_PIT_TICKS_PER_US;
+
+    /* Worker tasks finish responses concurrently */
+    unsigned int flags = system_irq_save();
+    hd->tx_stats.responses++;
+    hd->tx_stats.latency_us += us;
+    if (us > hd->tx_stats.latency_max_us) {
+        hd->tx_stats.latency_max_us = us;
+    }
+    system_irq_restore(flags);
+}
+
 int httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
 {
     if (r == NULL) {
@@ -238,8 +374,7 @@ int httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
 
     struct httpd_req_aux *ra = r->aux;
     const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
+    int ret;
 
     if (buf_len == HTTPD_RESP_USE_STRLEN) {
         buf_len = strlen(buf);
@@ -248,48 +383,37 @@ int httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t buf_len)
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
-    /* Size of essential headers is limited by scratch buffer size */
-    if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_hdr_str,
-                 ra->status, ra->content_type, buf_len) >= sizeof(ra->scratch)) {
-        return ERR_HTTPD_RESP_HDR;
+    ret = httpd_resp_queue_hdrs(r, httpd_hdr_str, buf_len);
+    if (ret != OS_SUCCESS) {
+        return ret;
     }
 
-    /* Sending essential headers */
-    if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != OS_SUCCESS) {
+    /* Headers and content leave in a single vectored send */
+    if (httpd_out_flush(ra->sd, buf, buf_len) != OS_SUCCESS) {
         return ERR_HTTPD_RESP_SEND;
     }
+    httpd_resp_done(r);
+    return OS_SUCCESS;
+}
 
-    /* Sending additional headers based on set_header */
-    for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-        /* Send header field */
-        if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
-        /* Send ': ' */
-        if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
-        /* Send header value */
-        if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
-        /* Send CR + LF */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
-    }
+/* Headers of a response whose body is not sent: HEAD requests and 304s,
+ * which must announce the length of the body they stand in for */
+int httpd_resp_send_head(httpd_req_t *r, ssize_t content_len)
+{
+    struct httpd_req_aux *ra = r->aux;
+    const char *httpd_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n";
+    int ret;
 
-    /* End header section */
-    if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != OS_SUCCESS) {
-        return ERR_HTTPD_RESP_SEND;
-    }
+    ra->req_hdrs_count = 0;
 
-    /* Sending content */
-    if (buf && buf_len) {
-        if (httpd_send_all(r, buf, buf_len) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
+    ret = httpd_resp_queue_hdrs(r, httpd_hdr_str, content_len);
+    if (ret != OS_SUCCESS) {
+        return ret;
+    }
+    if (httpd_sess_flush(ra->sd) != OS_SUCCESS) {
+        return ERR_HTTPD_RESP_SEND;
     }
+    httpd_resp_done(r);
     return OS_SUCCESS;
 }
 
@@ -309,68 +433,45 @@ int httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t buf_len)
 
     struct httpd_req_aux *ra = r->aux;
     const char *httpd_chunked_hdr_str = "HTTP/1.1 %s\r\nContent-Type: %s\r\nTransfer-Encoding: chunked\r\n";
-    const char *colon_separator = ": ";
-    const char *cr_lf_seperator = "\r\n";
+    int ret;
 
     /* Request headers are no longer available */
     ra->req_hdrs_count = 0;
 
     if (!ra->first_chunk_sent) {
-        /* Size of essential headers is limited by scratch buffer size */
-        if (snprintf(ra->scratch, sizeof(ra->scratch), httpd_chunked_hdr_str,
-                     ra->status, ra->content_type) >= sizeof(ra->scratch)) {
-            return ERR_HTTPD_RESP_HDR;
-        }
-
-        /* Sending essential headers */
-        if (httpd_send_all(r, ra->scratch, strlen(ra->scratch)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
-        }
-
-        /* Sending additional headers based on set_header */
-        for (unsigned i = 0; i < ra->resp_hdrs_count; i++) {
-            /* Send header field */
-            if (httpd_send_all(r, ra->resp_hdrs[i].field, strlen(ra->resp_hdrs[i].field)) != OS_SUCCESS) {
-                return ERR_HTTPD_RESP_SEND;
-            }
-            /* Send ': ' */
-            if (httpd_send_all(r, colon_separator, strlen(colon_separator)) != OS_SUCCESS) {
-                return ERR_HTTPD_RESP_SEND;
-            }
-            /* Send header value */
-            if (httpd_send_all(r, ra->resp_hdrs[i].value, strlen(ra->resp_hdrs[i].value)) != OS_SUCCESS) {
-                return ERR_HTTPD_RESP_SEND;
-            }
-            /* Send CR + LF */
-            if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != OS_SUCCESS) {
-                return ERR_HTTPD_RESP_SEND;
-            }
-        }
-
-        /* End header section */
-        if (httpd_send_all(r, cr_lf_seperator, strlen(cr_lf_seperator)) != OS_SUCCESS) {
-            return ERR_HTTPD_RESP_SEND;
+        ret = httpd_resp_queue_hdrs(r, httpd_chunked_hdr_str, 0);
+        if (ret != OS_SUCCESS) {
+            return ret;
         }
         ra->first_chunk_sent = true;
     }
 
-    /* Sending chunked content */
+    /* Small chunks pile up in the output buffer, a chunk that does not
+     * fit takes the buffered data along in one vectored send */
     char len_str[10];
     snprintf(len_str, sizeof(len_str), "%x\r\n", buf_len);
-    if (httpd_send_all(r, len_str, strlen(len_str)) != OS_SUCCESS) {
+    if (httpd_out_append(ra->sd, len_str, strlen(len_str)) != OS_SUCCESS) {
         return ERR_HTTPD_RESP_SEND;
     }
 
-    if (buf) {
-        if (httpd_send_all(r, buf, (size_t) buf_len) != OS_SUCCESS) {
+    if (buf && buf_len) {
+        if (httpd_out_append(ra->sd, buf, (size_t) buf_len) != OS_SUCCESS) {
             return ERR_HTTPD_RESP_SEND;
         }
     }
 
     /* Indicate end of chunk */
-    if (httpd_send_all(r, "\r\n", strlen("\r\n")) != OS_SUCCESS) {
+    if (httpd_out_append(ra->sd, "\r\n", 2) != OS_SUCCESS) {
         return ERR_HTTPD_RESP_SEND;
     }
+
+    /* The terminating chunk completes the response */
+    if (buf_len == 0) {
+        if (httpd_sess_flush(ra->sd) != OS_SUCCESS) {
+            return ERR_HTTPD_RESP_SEND;
+        }
+        httpd_resp_done(r);
+    }
     return OS_SUCCESS;
 }
 
@@ -614,6 +715,22 @@ int httpd_socket_send(httpd_handle_t hd, int sockfd, const char *buf, size_t buf
     return sess->send_fn(hd, sockfd, buf, buf_len, flags);
 }
 
+int httpd_get_tx_stats(httpd_handle_t handle, httpd_tx_stats_t *stats, bool reset)
+{
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    if (hd == NULL || stats == NULL) {
+        return ERR_INVALID_ARG;
+    }
+
+    unsigned int flags = system_irq_save();
+    *stats = hd->tx_stats;
+    if (reset) {
+        memset(&hd->tx_stats, 0, sizeof(hd->tx_stats));
+    }
+    system_irq_restore(flags);
+    return OS_SUCCESS;
+}
+
 int httpd_socket_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len, int flags)
 {
     struct sock_db *sess = httpd_sess_get(hd, sockfd);
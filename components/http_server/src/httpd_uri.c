@@ -16,6 +16,7 @@
 
 #include <http_server_service.h>
 #include "httpd_priv.h"
+#include "pit.h"
 
 static bool httpd_uri_match_simple(const char *uri1, const char *uri2, size_t len2)
 {
@@ -175,6 +176,7 @@ int httpd_register_uri_handler(httpd_handle_t handle,
                 hd->hd_calls[i]->supported_subprotocol = NULL;
             }
 #endif
+            memset(&hd->hd_call_stats[i], 0, sizeof(hd->hd_call_stats[i]));
             os_printf(LM_APP, LL_DBG, LOG_FMT("[%d] installed %s"), i, uri_handler->uri);
             return OS_SUCCESS;
         }
@@ -211,6 +213,7 @@ int httpd_unregister_uri_handler(httpd_handle_t handle,
                     break;
                 }
                 hd->hd_calls[i-1] = hd->hd_calls[i];
+                hd->hd_call_stats[i-1] = hd->hd_call_stats[i];
             }
             /* Nullify the following non null entry */
             hd->hd_calls[i-1] = NULL;
@@ -248,6 +251,7 @@ int httpd_unregister_uri(httpd_handle_t handle, const char *uri)
             /* Shift the remaining non null handlers in the array
              * forward by j so that order of insertion is maintained */
             hd->hd_calls[i-j] = hd->hd_calls[i];
+            hd->hd_call_stats[i-j] = hd->hd_call_stats[i];
         }
     }
     /* Nullify the following non null entries */
@@ -275,11 +279,11 @@ void httpd_unregister_all_uri_handlers(struct httpd_data *hd)
     }
 }
 
-int httpd_uri(struct httpd_data *hd)
+int httpd_uri(struct httpd_data *hd, httpd_req_t *req)
 {
     httpd_uri_t            *uri = NULL;
-    httpd_req_t            *req = &hd->hd_req;
-    struct http_parser_url *res = &hd->hd_req_aux.url_parse_res;
+    struct httpd_req_aux   *ra  = req->aux;
+    struct http_parser_url *res = &ra->url_parse_res;
 
     /* For conveying URI not found/method not allowed */
     httpd_err_code_t err = 0;
@@ -315,7 +319,7 @@ int httpd_uri(struct httpd_data *hd)
     struct httpd_req_aux   *aux = req->aux;
     if (uri->is_websocket && aux->ws_handshake_detect && uri->method == HTTP_GET) {
         os_printf(LM_APP, LL_DBG, LOG_FMT("Responding WS handshake to sock %d"), aux->sd->fd);
-        int ret = httpd_ws_respond_server_handshake(&hd->hd_req, uri->supported_subprotocol);
+        int ret = httpd_ws_respond_server_handshake(req, uri->supported_subprotocol);
         if (ret != OS_SUCCESS) {
             return ret;
         }
@@ -329,11 +333,79 @@ int httpd_uri(struct httpd_data *hd)
     }
 #endif
 
+    for (int i = 0; i < hd->config.max_uri_handlers; i++) {
+        if (hd->hd_calls[i] == uri) {
+            ra->handler = i;
+            break;
+        }
+    }
+    ra->handler_start = drv_pit_get_tick();
+
     /* Invoke handler */
-    if (uri->handler(req) != OS_SUCCESS) {
+    int ret = uri->handler(req);
+
+    /* A request taken over by httpd_req_async_handler_begin() is accounted
+     * for when it completes */
+    if (ra->sd->req == req) {
+        httpd_uri_stats_record(hd, req, ret, false);
+    }
+    if (ret != OS_SUCCESS) {
         /* Handler returns error, this socket should be closed */
         os_printf(LM_APP, LL_WARN, LOG_FMT("uri handler execution failed"));
         return OS_FAIL;
     }
     return OS_SUCCESS;
 }
+
+void httpd_uri_stats_record(struct httpd_data *hd, httpd_req_t *req, int ret, bool async)
+{
+    struct httpd_req_aux *ra = req->aux;
+
+    if (ra->handler < 0 || ra->handler >= hd->config.max_uri_handlers) {
+        return;
+    }
+
+    httpd_handler_stats_t *st = &hd->hd_call_stats[ra->handler];
+    uint32_t us = (drv_pit_get_tick() - ra->handler_start) / HTTPD_PIT_TICKS_PER_US;
+
+    /* Workers and async completions update the counters concurrently */
+    unsigned int flags = system_irq_save();
+    st->calls++;
+    if (ret != OS_SUCCESS) {
+        st->errors++;
+    }
+    if (async) {
+        st->async++;
+    }
+    st->latency_us += us;
+    if (us > st->latency_max_us) {
+        st->latency_max_us = us;
+    }
+    system_irq_restore(flags);
+}
+
+int httpd_get_handler_stats(httpd_handle_t handle, unsigned index, const char **uri,
+                            httpd_method_t *method, httpd_handler_stats_t *stats, bool reset)
+{
+    struct httpd_data *hd = (struct httpd_data *) handle;
+    if (hd == NULL || stats == NULL || index >= hd->config.max_uri_handlers) {
+        return ERR_INVALID_ARG;
+    }
+    if (hd->hd_calls[index] == NULL) {
+        return ERR_NOT_FOUND;
+    }
+    if (uri) {
+        *uri = hd->hd_calls[index]->uri;
+    }
+    if (method) {
+        *method = hd->hd_calls[index]->method;
+    }
+
+    unsigned int flags = system_irq_save();
+    *stats = hd->hd_call_stats[index];
+    if (reset) {
+        memset(&hd->hd_call_stats[index], 0, sizeof(hd->hd_call_stats[index]));
+    }
+    system_irq_restore(flags);
+    return OS_SUCCESS;
+}
@@ -0,0 +1,23 @@
+#!/bin/bash
+# usage: create_pack.sh <web dir> <out.bin>
+# Precompresses text assets next to their originals and builds the httpd
+# asset pack. Only gzip variants that actually save space are kept.
+if [ $# -ne 2 ]; then
+echo "usage: $0 <web dir> <out.bin>"
+exit 1
+fi
+current_path=$(readlink -f "$(dirname "$0")")
+stage=$(mktemp -d)
+cp -r "$1"/. ${stage}/
+find ${stage} -type f \( -name "*.html" -o -name "*.htm" -o -name "*.css" -o -name "*.js" \
+	-o -name "*.json" -o -name "*.svg" -o -name "*.txt" \) | while read f; do
+gzip -9nc "$f" > "$f.gz"
+if [ $(stat -c %s "$f.gz") -ge $(( $(stat -c %s "$f") * 9 / 10 )) ]; then
+rm -f "$f.gz"
+fi
+done
+gcc -O2 -o ${stage}/../httpd_pack.$$ ${current_path}/httpd_pack.c || exit 1
+${stage}/../httpd_pack.$$ ${stage} "$2"
+ret=$?
+rm -rf ${stage} ${stage}/../httpd_pack.$$
+exit $ret
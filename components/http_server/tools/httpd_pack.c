@@ -0,0 +1,238 @@
+/*
+ * Build an httpd_static asset pack (see include/components/http_server/httpd_static.h)
+ * from a directory tree on the host.
+ *
+ *   gcc -o httpd_pack httpd_pack.c
+ *   httpd_pack <dir> <out.bin>
+ *
+ * <dir>/a/b.css is served as "/a/b.css". A file named "<name>.gz" is stored
+ * as the gzip variant of "/<name>", so precompress with "gzip -9nk" first
+ * (create_pack.sh does that). The image is written to the partition named
+ * by CONFIG_HTTPD_STATIC_PARTITION, or turned into a C array with
+ * web_config/include/filetoarray and mounted with httpd_static_mount().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define PACK_MAGIC      0x4b415048
+#define PACK_VERSION    1
+#define PACK_F_GZIP     0x1
+#define PACK_HDR_SIZE   16
+#define PACK_ENTRY_SIZE 24
+#define PACK_ALIGN(x)   (((x) + 3) & ~3u)
+
+typedef struct {
+    char            *path;
+    const char      *type;
+    unsigned char   *data;
+    uint32_t         len;
+    uint32_t         etag;
+    uint32_t         flags;
+    uint32_t         path_off;
+    uint32_t         type_off;
+    uint32_t         data_off;
+} entry_t;
+
+static entry_t *entries;
+static int count, room;
+
+static const char *mime_types[][2] = {
+    {".html", "text/html"},
+    {".htm",  "text/html"},
+    {".css",  "text/css"},
+    {".js",   "application/javascript"},
+    {".json", "application/json"},
+    {".svg",  "image/svg+xml"},
+    {".png",  "image/png"},
+    {".jpg",  "image/jpeg"},
+    {".jpeg", "image/jpeg"},
+    {".gif",  "image/gif"},
+    {".ico",  "image/x-icon"},
+    {".txt",  "text/plain"},
+    {".woff", "font/woff"},
+    {".woff2", "font/woff2"},
+};
+
+static const char *mime_type(const char *path)
+{
+    const char *dot = strrchr(path, '.');
+    unsigned i;
+
+    for (i = 0; dot && i < sizeof(mime_types) / sizeof(mime_types[0]); i++) {
+        if (strcmp(dot, mime_types[i][0]) == 0) {
+            return mime_types[i][1];
+        }
+    }
+    return "application/octet-stream";
+}
+
+static uint32_t crc32(const unsigned char *p, uint32_t len)
+{
+    uint32_t crc = 0xffffffff;
+    int k;
+
+    while (len--) {
+        crc ^= *p++;
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static void add_file(const char *file, const char *rel)
+{
+    FILE *fp;
+    entry_t *e;
+    size_t n = strlen(rel);
+    long flen;
+
+    if (count == room) {
+        room = room ? room * 2 : 16;
+        entries = realloc(entries, room * sizeof(entry_t));
+    }
+    e = &entries[count++];
+    memset(e, 0, sizeof(*e));
+
+    e->path = malloc(n + 2);
+    e->path[0] = '/';
+    strcpy(e->path + 1, rel);
+    if (n > 3 && strcmp(rel + n - 3, ".gz") == 0) {
+        e->path[n - 2] = '\0';
+        e->flags = PACK_F_GZIP;
+    }
+    e->type = mime_type(e->path);
+
+    fp = fopen(file, "rb");
+    if (!fp) {
+        perror(file);
+        exit(1);
+    }
+    fseek(fp, 0, SEEK_END);
+    flen = ftell(fp);
+    rewind(fp);
+    e->len = flen;
+    e->data = malloc(flen + 1);
+    if (fread(e->data, 1, flen, fp) != (size_t)flen) {
+        perror(file);
+        exit(1);
+    }
+    fclose(fp);
+    e->etag = crc32(e->data, e->len);
+}
+
+static void walk(const char *dir, const char *rel)
+{
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    struct stat st;
+    char file[1024], sub[1024];
+
+    if (!d) {
+        perror(dir);
+        exit(1);
+    }
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(file, sizeof(file), "%s/%s", dir, de->d_name);
+        snprintf(sub, sizeof(sub), "%s%s%s", rel, *rel ? "/" : "", de->d_name);
+        if (stat(file, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            walk(file, sub);
+        } else if (S_ISREG(st.st_mode)) {
+            add_file(file, sub);
+        }
+    }
+    closedir(d);
+}
+
+static int entry_cmp(const void *a, const void *b)
+{
+    const entry_t *x = a, *y = b;
+    int r = strcmp(x->path, y->path);
+
+    return r ? r : (int)x->flags - (int)y->flags;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char *img, *p;
+    uint32_t off, size;
+    FILE *fp;
+    int i;
+
+    if (argc != 3) {
+        printf("usage: %s <dir> <out.bin>\n", argv[0]);
+        return 1;
+    }
+
+    walk(argv[1], "");
+    if (count > 0xffff) {
+        printf("too many files\n");
+        return 1;
+    }
+    qsort(entries, count, sizeof(entry_t), entry_cmp);
+
+    /* layout: header, entry table, strings, word aligned data */
+    off = PACK_HDR_SIZE + count * PACK_ENTRY_SIZE;
+    for (i = 0; i < count; i++) {
+        entries[i].path_off = off;
+        off += strlen(entries[i].path) + 1;
+        entries[i].type_off = off;
+        off += strlen(entries[i].type) + 1;
+    }
+    for (i = 0; i < count; i++) {
+        off = PACK_ALIGN(off);
+        entries[i].data_off = off;
+        off += entries[i].len;
+    }
+    size = PACK_ALIGN(off);
+
+    img = calloc(1, size);
+    put32(img, PACK_MAGIC);
+    img[4] = PACK_VERSION;
+    img[6] = count;
+    img[7] = count >> 8;
+    put32(img + 8, size);
+
+    for (i = 0; i < count; i++) {
+        entry_t *e = &entries[i];
+
+        p = img + PACK_HDR_SIZE + i * PACK_ENTRY_SIZE;
+        put32(p, e->path_off);
+        put32(p + 4, e->type_off);
+        put32(p + 8, e->data_off);
+        put32(p + 12, e->len);
+        put32(p + 16, e->etag);
+        put32(p + 20, e->flags);
+        strcpy((char *)img + e->path_off, e->path);
+        strcpy((char *)img + e->type_off, e->type);
+        memcpy(img + e->data_off, e->data, e->len);
+        printf("%-40s %-24s %7u %s\n", e->path, e->type, e->len, (e->flags & PACK_F_GZIP) ? "gzip" : "");
+    }
+
+    fp = fopen(argv[2], "wb");
+    if (!fp || fwrite(img, 1, size, fp) != size) {
+        perror(argv[2]);
+        return 1;
+    }
+    fclose(fp);
+    printf("%d entries, %u bytes\n", count, size);
+    return 0;
+}
@@ -39,6 +39,10 @@
 #include "mbedtls/ccm.h"
 #include "mbedtls/platform_util.h"
 
+#if defined(MBEDTLS_AES_ALT)
+#include "mbedtls/aes.h"
+#endif
+
 #include <string.h>
 
 #if defined(MBEDTLS_SELF_TEST) && defined(MBEDTLS_AES_C)
@@ -129,6 +133,94 @@ void mbedtls_ccm_free( mbedtls_ccm_context *ctx )
     for( i = 0; i < len; i++ )                                                 \
         dst[i] = src[i] ^ b[i];
 
+#if defined(MBEDTLS_AES_ALT) && defined(MBEDTLS_CIPHER_MODE_CBC)
+#define CCM_AES_BATCH   8
+
+#define CCM_CIPHER_IS_AES( c )                                      \
+    ( (c)->cipher_info->type == MBEDTLS_CIPHER_AES_128_ECB ||       \
+      (c)->cipher_info->type == MBEDTLS_CIPHER_AES_192_ECB ||       \
+      (c)->cipher_info->type == MBEDTLS_CIPHER_AES_256_ECB )
+
+/*
+ * Hardware AES: CBC-MAC the message into y, the whole blocks go through
+ * the engine as CBC runs and only a partial tail block is done on its own.
+ */
+static int ccm_aes_cbc_mac( mbedtls_ccm_context *ctx, unsigned char y[16],
+                            const unsigned char *src, size_t len )
+{
+    int ret;
+    unsigned char scratch[CCM_AES_BATCH * 16];
+    size_t i, use_len;
+
+    while( len >= 16 )
+    {
+        use_len = len - len % 16;
+        use_len = ( use_len > sizeof( scratch ) ) ? sizeof( scratch ) : use_len;
+
+        if( ( ret = mbedtls_aes_crypt_cbc( ctx->cipher_ctx.cipher_ctx,
+                        MBEDTLS_AES_ENCRYPT, use_len, y, src, scratch ) ) != 0 )
+        {
+            return( ret );
+        }
+
+        src += use_len;
+        len -= use_len;
+    }
+
+    if( len == 0 )
+        return( 0 );
+
+    for( i = 0; i < len; i++ )
+        y[i] ^= src[i];
+
+    return( mbedtls_aes_crypt_blocks( ctx->cipher_ctx.cipher_ctx,
+                MBEDTLS_AES_ENCRYPT, 16, y, y ) );
+}
+
+/*
+ * Hardware AES: CTR with a batch of counter blocks per engine run,
+ * ctr is left pointing past the last block used.
+ */
+static int ccm_aes_ctr( mbedtls_ccm_context *ctx, unsigned char q,
+                        unsigned char ctr[16], const unsigned char *src,
+                        unsigned char *dst, size_t len )
+{
+    int ret;
+    unsigned char ks[CCM_AES_BATCH * 16];
+    size_t i, j, blocks, use_len;
+
+    while( len > 0 )
+    {
+        blocks = ( len + 15 ) / 16;
+        blocks = ( blocks > CCM_AES_BATCH ) ? CCM_AES_BATCH : blocks;
+
+        for( j = 0; j < blocks; j++ )
+        {
+            memcpy( ks + j * 16, ctr, 16 );
+            for( i = 0; i < q; i++ )
+                if( ++ctr[15-i] != 0 )
+                    break;
+        }
+
+        if( ( ret = mbedtls_aes_crypt_blocks( ctx->cipher_ctx.cipher_ctx,
+                        MBEDTLS_AES_ENCRYPT, blocks * 16, ks, ks ) ) != 0 )
+        {
+            return( ret );
+        }
+
+        use_len = ( len < blocks * 16 ) ? len : blocks * 16;
+        for( i = 0; i < use_len; i++ )
+            dst[i] = src[i] ^ ks[i];
+
+        src += use_len;
+        dst += use_len;
+        len -= use_len;
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_AES_ALT && MBEDTLS_CIPHER_MODE_CBC */
+
 /*
  * Authenticated encryption or decryption
  */
@@ -256,6 +348,32 @@ static int ccm_auth_crypt( mbedtls_ccm_context *ctx, int mode, size_t length,
     src = input;
     dst = output;
 
+#if defined(MBEDTLS_AES_ALT) && defined(MBEDTLS_CIPHER_MODE_CBC)
+    /*
+     * MAC the plaintext before it may be overwritten in place when
+     * encrypting, after it has been recovered when decrypting.
+     */
+    if( CCM_CIPHER_IS_AES( &ctx->cipher_ctx ) )
+    {
+        if( mode == CCM_ENCRYPT &&
+            ( ret = ccm_aes_cbc_mac( ctx, y, input, length ) ) != 0 )
+        {
+            return( ret );
+        }
+
+        if( ( ret = ccm_aes_ctr( ctx, q, ctr, input, output, length ) ) != 0 )
+            return( ret );
+
+        if( mode == CCM_DECRYPT &&
+            ( ret = ccm_aes_cbc_mac( ctx, y, output, length ) ) != 0 )
+        {
+            return( ret );
+        }
+
+        len_left = 0;
+    }
+#endif
+
     while( len_left > 0 )
     {
         size_t use_len = len_left > 16 ? 16 : len_left;
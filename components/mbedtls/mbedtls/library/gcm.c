@@ -46,6 +46,10 @@
 #include "mbedtls/aesni.h"
 #endif
 
+#if defined(MBEDTLS_AES_ALT)
+#include "mbedtls/aes.h"
+#endif
+
 #if defined(MBEDTLS_SELF_TEST) && defined(MBEDTLS_AES_C)
 #include "mbedtls/aes.h"
 #if defined(MBEDTLS_PLATFORM_C)
@@ -345,6 +349,71 @@ int mbedtls_gcm_starts( mbedtls_gcm_context *ctx,
     return( 0 );
 }
 
+#if defined(MBEDTLS_AES_ALT)
+#define GCM_AES_BATCH   8
+
+#define GCM_CIPHER_IS_AES( c )                                      \
+    ( (c)->cipher_info->type == MBEDTLS_CIPHER_AES_128_ECB ||       \
+      (c)->cipher_info->type == MBEDTLS_CIPHER_AES_192_ECB ||       \
+      (c)->cipher_info->type == MBEDTLS_CIPHER_AES_256_ECB )
+
+/*
+ * Hardware AES: build a batch of counter blocks and push them through the
+ * engine in one go rather than one mbedtls_cipher_update() per block.
+ */
+static int gcm_update_aes_batch( mbedtls_gcm_context *ctx,
+                size_t length,
+                const unsigned char *p,
+                unsigned char *out_p )
+{
+    int ret;
+    unsigned char ectr[GCM_AES_BATCH * 16];
+    size_t i, j, blocks, use_len;
+
+    while( length > 0 )
+    {
+        blocks = ( length + 15 ) / 16;
+        blocks = ( blocks > GCM_AES_BATCH ) ? GCM_AES_BATCH : blocks;
+
+        for( j = 0; j < blocks; j++ )
+        {
+            for( i = 16; i > 12; i-- )
+                if( ++ctx->y[i - 1] != 0 )
+                    break;
+            memcpy( ectr + j * 16, ctx->y, 16 );
+        }
+
+        if( ( ret = mbedtls_aes_crypt_blocks( ctx->cipher_ctx.cipher_ctx,
+                        MBEDTLS_AES_ENCRYPT, blocks * 16, ectr, ectr ) ) != 0 )
+        {
+            return( ret );
+        }
+
+        for( j = 0; j < blocks; j++ )
+        {
+            use_len = ( length < 16 ) ? length : 16;
+
+            for( i = 0; i < use_len; i++ )
+            {
+                if( ctx->mode == MBEDTLS_GCM_DECRYPT )
+                    ctx->buf[i] ^= p[i];
+                out_p[i] = ectr[j * 16 + i] ^ p[i];
+                if( ctx->mode == MBEDTLS_GCM_ENCRYPT )
+                    ctx->buf[i] ^= out_p[i];
+            }
+
+            gcm_mult( ctx, ctx->buf, ctx->buf );
+
+            length -= use_len;
+            p += use_len;
+            out_p += use_len;
+        }
+    }
+
+    return( 0 );
+}
+#endif /* MBEDTLS_AES_ALT */
+
 int mbedtls_gcm_update( mbedtls_gcm_context *ctx,
                 size_t length,
                 const unsigned char *input,
@@ -370,6 +439,11 @@ int mbedtls_gcm_update( mbedtls_gcm_context *ctx,
 
     ctx->len += length;
 
+#if defined(MBEDTLS_AES_ALT)
+    if( GCM_CIPHER_IS_AES( &ctx->cipher_ctx ) )
+        return( gcm_update_aes_batch( ctx, length, input, output ) );
+#endif
+
     p = input;
     while( length > 0 )
     {
@@ -0,0 +1,275 @@
+#if !defined(MBEDTLS_CONFIG_FILE)
+#include "mbedtls/config.h"
+#else
+#include MBEDTLS_CONFIG_FILE
+#endif
+
+#if defined(MBEDTLS_AES_C) && defined(MBEDTLS_AES_ALT)
+
+#include <string.h>
+
+#include "mbedtls/aes.h"
+#include "mbedtls/platform_util.h"
+#include "drivers/aes/aes.h"
+
+
+static int trs_aes_begin( const mbedtls_aes_context *ctx, int mode )
+{
+    if( ctx->keybits == 0 )
+        return( MBEDTLS_ERR_AES_BAD_INPUT_DATA );
+
+    if( drv_aes_lock() != AES_RET_SUCCESS )
+        return( MBEDTLS_ERR_AES_HW_ACCEL_FAILED );
+
+    if( drv_aes_ecb_setkey( ctx->key, ctx->keybits,
+            ( mode == MBEDTLS_AES_ENCRYPT ) ? DRV_AES_MODE_ENC : DRV_AES_MODE_DEC ) != AES_RET_SUCCESS )
+    {
+        drv_aes_unlock();
+        return( MBEDTLS_ERR_AES_HW_ACCEL_FAILED );
+    }
+
+    return( 0 );
+}
+
+static int trs_aes_end( int ret )
+{
+    drv_aes_unlock();
+
+    return( ( ret == AES_RET_SUCCESS ) ? 0 : MBEDTLS_ERR_AES_HW_ACCEL_FAILED );
+}
+
+void mbedtls_aes_init( mbedtls_aes_context *ctx )
+{
+    memset( ctx, 0, sizeof( mbedtls_aes_context ) );
+}
+
+void mbedtls_aes_free( mbedtls_aes_context *ctx )
+{
+    if( ctx == NULL )
+        return;
+
+    mbedtls_platform_zeroize( ctx, sizeof( mbedtls_aes_context ) );
+}
+
+int mbedtls_aes_setkey_enc( mbedtls_aes_context *ctx, const unsigned char *key,
+                    unsigned int keybits )
+{
+    if( keybits != 128 && keybits != 192 && keybits != 256 )
+        return( MBEDTLS_ERR_AES_INVALID_KEY_LENGTH );
+
+    memcpy( ctx->key, key, keybits / 8 );
+    ctx->keybits = keybits;
+
+    return( 0 );
+}
+
+/* the engine derives the decryption schedule itself */
+int mbedtls_aes_setkey_dec( mbedtls_aes_context *ctx, const unsigned char *key,
+                    unsigned int keybits )
+{
+    return( mbedtls_aes_setkey_enc( ctx, key, keybits ) );
+}
+
+int mbedtls_aes_crypt_blocks( mbedtls_aes_context *ctx, int mode, size_t length,
+                              const unsigned char *input, unsigned char *output )
+{
+    int ret;
+
+    if( length % 16 )
+        return( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH );
+
+    if( ( ret = trs_aes_begin( ctx, mode ) ) != 0 )
+        return( ret );
+
+    return( trs_aes_end( drv_aes_ecb_crypt( input, output, length ) ) );
+}
+
+int mbedtls_internal_aes_encrypt( mbedtls_aes_context *ctx,
+                                  const unsigned char input[16],
+                                  unsigned char output[16] )
+{
+    return( mbedtls_aes_crypt_blocks( ctx, MBEDTLS_AES_ENCRYPT, 16, input, output ) );
+}
+
+int mbedtls_internal_aes_decrypt( mbedtls_aes_context *ctx,
+                                  const unsigned char input[16],
+                                  unsigned char output[16] )
+{
+    return( mbedtls_aes_crypt_blocks( ctx, MBEDTLS_AES_DECRYPT, 16, input, output ) );
+}
+
+#if !defined(MBEDTLS_DEPRECATED_REMOVED)
+void mbedtls_aes_encrypt( mbedtls_aes_context *ctx,
+                          const unsigned char input[16],
+                          unsigned char output[16] )
+{
+    mbedtls_internal_aes_encrypt( ctx, input, output );
+}
+
+void mbedtls_aes_decrypt( mbedtls_aes_context *ctx,
+                          const unsigned char input[16],
+                          unsigned char output[16] )
+{
+    mbedtls_internal_aes_decrypt( ctx, input, output );
+}
+#endif /* !MBEDTLS_DEPRECATED_REMOVED */
+
+int mbedtls_aes_crypt_ecb( mbedtls_aes_context *ctx,
+                    int mode,
+                    const unsigned char input[16],
+                    unsigned char output[16] )
+{
+    return( mbedtls_aes_crypt_blocks( ctx, mode, 16, input, output ) );
+}
+
+#if defined(MBEDTLS_CIPHER_MODE_CBC)
+int mbedtls_aes_crypt_cbc( mbedtls_aes_context *ctx,
+                    int mode,
+                    size_t length,
+                    unsigned char iv[16],
+                    const unsigned char *input,
+                    unsigned char *output )
+{
+    int ret;
+
+    if( length % 16 )
+        return( MBEDTLS_ERR_AES_INVALID_INPUT_LENGTH );
+
+    if( ( ret = trs_aes_begin( ctx, mode ) ) != 0 )
+        return( ret );
+
+    return( trs_aes_end( drv_aes_cbc_crypt(
+        ( mode == MBEDTLS_AES_ENCRYPT ) ? DRV_AES_MODE_ENC : DRV_AES_MODE_DEC,
+        iv, input, output, length ) ) );
+}
+#endif /* MBEDTLS_CIPHER_MODE_CBC */
+
+#if defined(MBEDTLS_CIPHER_MODE_CFB)
+int mbedtls_aes_crypt_cfb128( mbedtls_aes_context *ctx,
+                       int mode,
+                       size_t length,
+                       size_t *iv_off,
+                       unsigned char iv[16],
+                       const unsigned char *input,
+                       unsigned char *output )
+{
+    int c, ret;
+    size_t n = *iv_off;
+
+    if( n > 15 )
+        return( MBEDTLS_ERR_AES_BAD_INPUT_DATA );
+
+    if( ( ret = trs_aes_begin( ctx, MBEDTLS_AES_ENCRYPT ) ) != 0 )
+        return( ret );
+
+    while( length-- )
+    {
+        if( n == 0 )
+            drv_aes_ecb_crypt( iv, iv, 16 );
+
+        c = *input++;
+        *output = (unsigned char)( c ^ iv[n] );
+        iv[n] = ( mode == MBEDTLS_AES_ENCRYPT ) ? *output : (unsigned char) c;
+        output++;
+
+        n = ( n + 1 ) & 0x0F;
+    }
+
+    *iv_off = n;
+
+    return( trs_aes_end( AES_RET_SUCCESS ) );
+}
+
+int mbedtls_aes_crypt_cfb8( mbedtls_aes_context *ctx,
+                       int mode,
+                       size_t length,
+                       unsigned char iv[16],
+                       const unsigned char *input,
+                       unsigned char *output )
+{
+    unsigned char c;
+    unsigned char ov[17];
+    int ret;
+
+    if( ( ret = trs_aes_begin( ctx, MBEDTLS_AES_ENCRYPT ) ) != 0 )
+        return( ret );
+
+    while( length-- )
+    {
+        memcpy( ov, iv, 16 );
+        drv_aes_ecb_crypt( iv, iv, 16 );
+
+        if( mode == MBEDTLS_AES_DECRYPT )
+            ov[16] = *input;
+
+        c = *output++ = (unsigned char)( iv[0] ^ *input++ );
+
+        if( mode == MBEDTLS_AES_ENCRYPT )
+            ov[16] = c;
+
+        memcpy( iv, ov + 1, 16 );
+    }
+
+    return( trs_aes_end( AES_RET_SUCCESS ) );
+}
+#endif /* MBEDTLS_CIPHER_MODE_CFB */
+
+#if defined(MBEDTLS_CIPHER_MODE_OFB)
+int mbedtls_aes_crypt_ofb( mbedtls_aes_context *ctx,
+                           size_t length,
+                           size_t *iv_off,
+                           unsigned char iv[16],
+                           const unsigned char *input,
+                           unsigned char *output )
+{
+    size_t n = *iv_off;
+    int ret;
+
+    if( n > 15 )
+        return( MBEDTLS_ERR_AES_BAD_INPUT_DATA );
+
+    if( ( ret = trs_aes_begin( ctx, MBEDTLS_AES_ENCRYPT ) ) != 0 )
+        return( ret );
+
+    while( length-- )
+    {
+        if( n == 0 )
+            drv_aes_ecb_crypt( iv, iv, 16 );
+
+        *output++ = *input++ ^ iv[n];
+
+        n = ( n + 1 ) & 0x0F;
+    }
+
+    *iv_off = n;
+
+    return( trs_aes_end( AES_RET_SUCCESS ) );
+}
+#endif /* MBEDTLS_CIPHER_MODE_OFB */
+
+#if defined(MBEDTLS_CIPHER_MODE_CTR)
+int mbedtls_aes_crypt_ctr( mbedtls_aes_context *ctx,
+                       size_t length,
+                       size_t *nc_off,
+                       unsigned char nonce_counter[16],
+                       unsigned char stream_block[16],
+                       const unsigned char *input,
+                       unsigned char *output )
+{
+    unsigned int n = *nc_off;
+    int ret;
+
+    if( n > 15 )
+        return( MBEDTLS_ERR_AES_BAD_INPUT_DATA );
+
+    if( ( ret = trs_aes_begin( ctx, MBEDTLS_AES_ENCRYPT ) ) != 0 )
+        return( ret );
+
+    ret = drv_aes_ctr_crypt( &n, nonce_counter, stream_block, input, output, length );
+    *nc_off = n;
+
+    return( trs_aes_end( ret ) );
+}
+#endif /* MBEDTLS_CIPHER_MODE_CTR */
+
+#endif /* MBEDTLS_AES_C && MBEDTLS_AES_ALT */
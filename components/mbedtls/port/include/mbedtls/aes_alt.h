@@ -0,0 +1,27 @@
+#pragma once
+
+/*
+ * MBEDTLS_AES_ALT on the AES engine. The engine takes the raw key, so the
+ * context only keeps the key bytes; every call takes the engine lock,
+ * loads the key and streams all of its blocks through before releasing it.
+ */
+#include <stddef.h>
+
+#if defined(MBEDTLS_CIPHER_MODE_XTS)
+#error "MBEDTLS_CIPHER_MODE_XTS is not supported with CONFIG_MBEDTLS_HARDWARE_AES"
+#endif
+
+typedef struct mbedtls_aes_context
+{
+    unsigned int keybits;
+    unsigned char key[32];
+}
+mbedtls_aes_context;
+
+/*
+ * Run length bytes (a multiple of 16) of independent blocks through the
+ * engine under one lock, used by gcm/ccm to push a batch of counter blocks
+ * at once instead of one mbedtls_cipher_update() per block.
+ */
+int mbedtls_aes_crypt_blocks( mbedtls_aes_context *ctx, int mode, size_t length,
+                              const unsigned char *input, unsigned char *output );
@@ -1687,7 +1687,7 @@
  * enabled as well.
  */
 #ifdef CONFIG_MBEDTLS_CCM_C
-//#define MBEDTLS_CCM_C
+#define MBEDTLS_CCM_C
 #endif
 
 /**
@@ -1901,7 +1901,7 @@
  * requisites are enabled as well.
  */
 #ifdef CONFIG_MBEDTLS_GCM_C
-//#define MBEDTLS_GCM_C
+#define MBEDTLS_GCM_C
 #endif
 
 /**
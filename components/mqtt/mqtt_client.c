@@ -11,6 +11,7 @@
 
 #include "url_parser.h"
 #include "oshal.h"
+#include "systrace.h"
 #include "at_common.h"
 
 
@@ -990,6 +991,7 @@ int trs_mqtt_client_publish(trs_mqtt_client_handle_t client, const char *topic,
                                           topic, data, len,
                                           qos, retain,
                                           &pending_msg_id);
+    SYSTRACE(SYSTRACE_EV_MQTT_PUB, qos, len, pending_msg_id);
     if (qos > 0) {
         client->mqtt_state.pending_msg_type = mqtt_get_type(client->mqtt_state.outbound_message->data);
         client->mqtt_state.pending_msg_id = pending_msg_id;
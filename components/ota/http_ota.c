@@ -1,7 +1,11 @@
 #include "oshal.h"
 #include "ota.h"
 #include "httpclient.h"
+#ifdef CONFIG_OTA_HTTP_RESUME
+#include "easyflash.h"
+#endif
 
+#ifndef CONFIG_OTA_HTTP_RESUME
 static int http_client_download_data(void *data)
 {
     http_event_t *event = data;
@@ -48,3 +52,345 @@ int http_client_download_file(const char *url)
 
     return 0;
 }
+
+#else /* CONFIG_OTA_HTTP_RESUME */
+
+/*
+ * Resumable download: the package goes to flash through ota_write_at at the
+ * offset each byte belongs to, and every CONFIG_OTA_HTTP_RESUME_STEP erase
+ * blocks the offset reached and a crc of what was stored are kept in NV.
+ * A lost link picks up with a Range request where it stopped, a reboot
+ * with the same url where the checkpoint says, once the flash is found to
+ * still hold what the crc says. With two connections the package is split
+ * in two halves fetched at once.
+ *
+ * A server that changed the file under the same url is only caught by the
+ * crc check at ota_done, which drops the checkpoint for the next try.
+ */
+#define HTTP_OTA_NV_KEY         "OtaResume"
+#define HTTP_OTA_MAGIC          0x4f545452      /* "RTTO" */
+#define HTTP_OTA_STEP           (CONFIG_OTA_HTTP_RESUME_STEP * 4096)
+#define HTTP_OTA_CONNS          CONFIG_OTA_HTTP_CONNECTIONS
+#define HTTP_OTA_HEAD_LEN       sizeof(ota_package_head_t)
+
+typedef struct {
+    unsigned int start;
+    unsigned int next;          /* committed up to here */
+    unsigned int end;           /* one past the last byte, 0 until the head is in */
+    unsigned int crc;           /* ota_crc_at of [start, next) */
+} http_ota_range_t;
+
+typedef struct {
+    unsigned int magic;
+    unsigned int url;           /* crc32 of the url */
+    ota_package_head_t head;
+    http_ota_range_t range[HTTP_OTA_CONNS];
+    unsigned int crc;           /* of all above */
+} http_ota_ckpt_t;
+
+typedef struct {
+    http_client_t *client;
+    const char *url;
+    http_ota_range_t *range;
+    unsigned int offset;        /* written up to here, may run ahead of range->next */
+    unsigned int crc;           /* ota_crc_at of [range->start, offset) */
+    int ret;
+    int started;
+    os_sem_handle_t done;
+} http_ota_conn_t;
+
+static http_ota_ckpt_t g_http_ota_ckpt;
+static http_ota_conn_t g_http_ota_conn[HTTP_OTA_CONNS];
+static os_mutex_handle_t g_http_ota_lock;
+static int g_http_ota_abort;        /* ota_write_at failed, no use retrying */
+
+static void http_ota_ckpt_save(void)
+{
+    http_ota_ckpt_t *ckpt = &g_http_ota_ckpt;
+
+    ckpt->crc = ef_calc_crc32(0, ckpt, offsetof(http_ota_ckpt_t, crc));
+    if (develop_set_env_blob(HTTP_OTA_NV_KEY, ckpt, sizeof(*ckpt)) != EF_NO_ERR) {
+        os_printf(LM_APP, LL_ERR, "ota checkpoint save failed\n");
+    }
+}
+
+/* 1 if a checkpoint of <url> is there, its ranges then hold what flash still has */
+static int http_ota_ckpt_load(const char *url)
+{
+    http_ota_ckpt_t *ckpt = &g_http_ota_ckpt;
+    http_ota_range_t *range;
+    unsigned int left;
+    int i, len = 0;
+
+    develop_get_env_blob(HTTP_OTA_NV_KEY, ckpt, sizeof(*ckpt), &len);
+    if (len != sizeof(*ckpt) || ckpt->magic != HTTP_OTA_MAGIC ||
+        ckpt->crc != ef_calc_crc32(0, ckpt, offsetof(http_ota_ckpt_t, crc)) ||
+        ckpt->url != ef_calc_crc32(0, url, strlen(url)) ||
+        ckpt->range[HTTP_OTA_CONNS - 1].end == 0 ||
+        ota_resume_at((unsigned char *)&ckpt->head, 0, 0) != 0) {
+        return 0;
+    }
+
+    for (i = 0, left = 0; i < HTTP_OTA_CONNS; i++) {
+        range = &ckpt->range[i];
+        if (range->next <= range->start ||
+            ota_crc_at(0, range->start, NULL, range->next - range->start) != range->crc ||
+            ota_resume_at((unsigned char *)&ckpt->head, range->start, range->next - range->start) != 0) {
+            range->next = range->start;
+            range->crc = 0;
+        }
+        left += range->end - range->next;
+    }
+    os_printf(LM_APP, LL_INFO, "ota resume %u bytes, %u left\n", ckpt->head.package_size, left);
+    return 1;
+}
+
+static http_ota_conn_t *http_ota_conn_get(http_client_t *client)
+{
+    int i;
+
+    for (i = 0; i < HTTP_OTA_CONNS; i++) {
+        if (g_http_ota_conn[i].client == client) {
+            return &g_http_ota_conn[i];
+        }
+    }
+    return NULL;
+}
+
+/* the head in, every range gets its end */
+static void http_ota_ranges_set(unsigned int size)
+{
+    http_ota_range_t *range = g_http_ota_ckpt.range;
+#if HTTP_OTA_CONNS > 1
+    unsigned int half = (size / 2) & ~0xFFF;
+
+    if (half > HTTP_OTA_HEAD_LEN) {
+        range[0].end = half;
+        range[1].start = range[1].next = half;
+        range[1].crc = 0;
+        range[1].end = size;
+        return;
+    }
+    range[1].start = range[1].next = range[1].end = size;
+#endif
+    range[0].end = size;
+}
+
+static int http_ota_store(http_ota_conn_t *conn, unsigned char *data, unsigned int len)
+{
+    ota_package_head_t *head = &g_http_ota_ckpt.head;
+    http_ota_range_t *range = conn->range;
+    unsigned int n;
+    int ret;
+
+    /* the head may come in pieces, ota_write_at wants it whole */
+    if (conn->offset < HTTP_OTA_HEAD_LEN) {
+        n = HTTP_OTA_HEAD_LEN - conn->offset;
+        n = (n > len) ? len : n;
+        memcpy((unsigned char *)head + conn->offset, data, n);
+        conn->offset += n;
+        data += n;
+        len -= n;
+        if (conn->offset < HTTP_OTA_HEAD_LEN) {
+            return 0;
+        }
+        ret = ota_write_at(0, (unsigned char *)head, HTTP_OTA_HEAD_LEN);
+        if (ret != 0) {
+            return ret;
+        }
+        conn->crc = ota_crc_at(0, 0, (unsigned char *)head, HTTP_OTA_HEAD_LEN);
+        if (range->end == 0) {
+            http_ota_ranges_set(head->package_size);
+        }
+    }
+
+    if (range->end != 0 && conn->offset + len > range->end) {
+        len = (conn->offset < range->end) ? range->end - conn->offset : 0;
+    }
+    if (len == 0) {
+        return 0;
+    }
+
+    ret = ota_write_at(conn->offset, data, len);
+    if (ret != 0) {
+        return ret;
+    }
+    conn->crc = ota_crc_at(conn->crc, conn->offset, data, len);
+    conn->offset += len;
+
+    if (conn->offset - range->next >= HTTP_OTA_STEP || conn->offset == range->end) {
+        range->next = conn->offset;
+        range->crc = conn->crc;
+        http_ota_ckpt_save();
+    }
+
+    return 0;
+}
+
+static int http_client_download_data(void *data)
+{
+    http_event_t *event = data;
+    http_client_t *client = event->context;
+    http_ota_conn_t *conn = http_ota_conn_get(client);
+    int ret;
+
+    if (client == NULL || conn == NULL) {
+        return -1;
+    }
+
+    os_printf(LM_APP, LL_DBG, "event type 0x%x len %d totlen %d\n", event->type, event->len, client->total);
+
+    if (event->type == http_event_type_on_headers) {
+        if (client->interceptor->response.status == http_response_status_ok && conn->range->start == 0) {
+            /* the server sends it all whatever was asked, start over */
+            conn->offset = 0;
+            conn->crc = 0;
+        } else if (client->interceptor->response.status != http_response_status_partial_content) {
+            os_printf(LM_APP, LL_ERR, "Err Header status 0x%x\n", client->interceptor->response.status);
+            return -1;
+        }
+    }
+
+    if (event->type == http_event_type_on_body) {
+        os_mutex_lock(g_http_ota_lock, WAIT_FOREVER);
+        ret = http_ota_store(conn, (unsigned char *)event->data, event->len);
+        os_mutex_unlock(g_http_ota_lock);
+        if (ret != 0) {
+            os_printf(LM_APP, LL_ERR, "ota write failed 0x%x\n", ret);
+            g_http_ota_abort = 1;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* fetch the range of <conn> to its end, over as many requests as it takes */
+static int http_ota_fetch(http_ota_conn_t *conn)
+{
+    http_ota_range_t *range = conn->range;
+    unsigned int from;
+    int fails = 0;
+
+    while (range->end == 0 || conn->offset < range->end) {
+        from = conn->offset;
+        http_client_set_range(conn->client, from, range->end ? range->end - 1 : 0);
+        if (http_client_method_request(conn->client, HTTP_REQUEST_METHOD_GET, conn->url, http_client_download_data) == 0 &&
+            range->end != 0 && conn->offset >= range->end) {
+            break;
+        }
+        if (g_http_ota_abort) {
+            return -1;
+        }
+        fails = (conn->offset > from) ? 0 : fails + 1;
+        if (fails > CONFIG_OTA_HTTP_RESUME_RETRY) {
+            os_printf(LM_APP, LL_ERR, "ota download stuck at %u\n", conn->offset);
+            return -1;
+        }
+        os_printf(LM_APP, LL_WARN, "ota download broke at %u, retry\n", conn->offset);
+        os_msleep(1000 * fails);
+    }
+
+    return 0;
+}
+
+static void http_ota_fetch_task(void *arg)
+{
+    http_ota_conn_t *conn = arg;
+
+    conn->ret = http_ota_fetch(conn);
+    os_sem_post(conn->done);
+    os_task_delete(0);
+}
+
+int http_client_download_file(const char *url)
+{
+    http_ota_ckpt_t *ckpt = &g_http_ota_ckpt;
+    http_ota_conn_t *conn;
+    int i, ret = ota_init();
+
+    if (ret != 0) {
+        os_printf(LM_APP, LL_ERR, "ota init failed 0x%x\n", ret);
+        return -1;
+    }
+
+    if (!http_ota_ckpt_load(url)) {
+        memset(ckpt, 0, sizeof(*ckpt));
+        ckpt->magic = HTTP_OTA_MAGIC;
+        ckpt->url = ef_calc_crc32(0, url, strlen(url));
+    }
+
+    g_http_ota_abort = 0;
+    g_http_ota_lock = os_mutex_create();
+    memset(g_http_ota_conn, 0, sizeof(g_http_ota_conn));
+    for (i = 0, ret = 0; i < HTTP_OTA_CONNS; i++) {
+        conn = &g_http_ota_conn[i];
+        conn->client = http_client_init(NULL);
+        conn->url = url;
+        conn->range = &ckpt->range[i];
+        conn->offset = conn->range->next;
+        conn->crc = conn->range->crc;
+        conn->done = os_sem_create(1, 0);
+        if (conn->client == NULL || conn->done == NULL || g_http_ota_lock == NULL) {
+            ret = -1;
+        }
+    }
+
+    if (ret == 0 && ckpt->range[HTTP_OTA_CONNS - 1].end == 0) {
+        /* nothing known yet: the first connection learns the size from the head */
+        conn = &g_http_ota_conn[0];
+        conn->range->end = (HTTP_OTA_CONNS > 1) ? HTTP_OTA_HEAD_LEN : 0;
+        ret = http_ota_fetch(conn);
+        if (ret == 0 && HTTP_OTA_CONNS > 1) {
+            http_ota_ranges_set(ckpt->head.package_size);
+        }
+    }
+
+    for (i = 1; ret == 0 && i < HTTP_OTA_CONNS; i++) {
+        conn = &g_http_ota_conn[i];
+        conn->offset = conn->range->next;
+        conn->crc = conn->range->crc;
+        conn->started = 1;
+        if (os_task_create("ota_http_task", 5, 4 * 1024, http_ota_fetch_task, conn) < 0) {
+            conn->ret = http_ota_fetch(conn);
+            os_sem_post(conn->done);
+        }
+    }
+    if (ret == 0) {
+        ret = http_ota_fetch(&g_http_ota_conn[0]);
+    }
+    for (i = 1; i < HTTP_OTA_CONNS; i++) {
+        conn = &g_http_ota_conn[i];
+        if (conn->started) {
+            os_sem_wait(conn->done, WAIT_FOREVER);
+            ret = ret ? ret : conn->ret;
+        }
+    }
+
+    for (i = 0; i < HTTP_OTA_CONNS; i++) {
+        conn = &g_http_ota_conn[i];
+        if (conn->client) {
+            http_client_exit(conn->client);
+        }
+        if (conn->done) {
+            os_sem_destroy(conn->done);
+        }
+        conn->client = NULL;
+    }
+    if (g_http_ota_lock) {
+        os_mutex_destroy(g_http_ota_lock);
+        g_http_ota_lock = NULL;
+    }
+
+    if (ret == 0) {
+        /* a checkpoint of a bad image would only bring it back */
+        develop_del_env(HTTP_OTA_NV_KEY);
+        ota_done(1);
+    } else {
+        ota_done(0);
+    }
+
+    return 0;
+}
+
+#endif /* CONFIG_OTA_HTTP_RESUME */
@@ -149,6 +149,14 @@ static int local_ota_message_parse(unsigned char *buf, unsigned int len, ota_rec
     //os_printf(LM_APP, LL_INFO, "fmcrc=0x%x\n", message->fm_crc);
     parse_len += sizeof(message->fm_crc);
 
+#ifdef CONFIG_OTA_LOCAL_MCAST
+    /* reports go back to whoever announced, see local_ota_start */
+    if (strncmp(message->url, LOCAL_OTA_MCAST_URL, strlen(LOCAL_OTA_MCAST_URL)) == 0)
+    {
+        return 0;
+    }
+#endif
+
     ptr1 = strstr(message->url, "http://");
     if (ptr1 == NULL)
     {
@@ -234,6 +242,9 @@ int local_ota_start(void)
 {
     int recv_len,recv_sock;
     unsigned char buf[LOCAL_OTA_DEFAULT_BUFF_LEN];
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    int ret;
     bool cb_flag = false;
     int update_count = 0;
     ota_recv_pack_t recv_message;
@@ -251,7 +262,8 @@ int local_ota_start(void)
     /** success link factory ssid */
     while (1)
     {
-        recv_len = recv(recv_sock, buf, LOCAL_OTA_DEFAULT_BUFF_LEN, 0);
+        fromlen = sizeof(from);
+        recv_len = recvfrom(recv_sock, buf, LOCAL_OTA_DEFAULT_BUFF_LEN, 0, (struct sockaddr *)&from, &fromlen);
         if (recv_len <= 0)
         {
             continue;
@@ -262,6 +274,13 @@ int local_ota_start(void)
         {
             continue;
         }
+#ifdef CONFIG_OTA_LOCAL_MCAST
+        if (strncmp(recv_message.url, LOCAL_OTA_MCAST_URL, strlen(LOCAL_OTA_MCAST_URL)) == 0)
+        {
+            memset(ota_info->dst_ip, 0, sizeof(ota_info->dst_ip));
+            strncpy(ota_info->dst_ip, inet_ntoa(from.sin_addr), sizeof(ota_info->dst_ip) - 1);
+        }
+#endif
 
         if (recv_message.type == OTA_PACKET_ACTION)
         {
@@ -311,7 +330,17 @@ int local_ota_start(void)
             update_count = 0;
 
 			os_printf(LM_APP, LL_INFO, "recv_message.url=%s  recv_message.len=%d\n", recv_message.url, recv_message.len);
-            if ((http_client_download_file(recv_message.url)==0) && (ota_done(1)==0))
+#ifdef CONFIG_OTA_LOCAL_MCAST
+            if (strncmp(recv_message.url, LOCAL_OTA_MCAST_URL, strlen(LOCAL_OTA_MCAST_URL)) == 0)
+            {
+                ret = local_ota_mcast_download(recv_message.url);
+            }
+            else
+#endif
+            {
+                ret = http_client_download_file(recv_message.url);
+            }
+            if ((ret == 0) && (ota_done(1)==0))
             {
                 break;
             }
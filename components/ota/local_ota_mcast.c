@@ -0,0 +1,176 @@
+/**
+ * @file local_ota_mcast.c
+ * @brief local_ota data plane over udp multicast, see ota_fec.h
+ *
+ * The sender announces "mcast://<group>:<port>" as the url and streams the
+ * package as a block carousel to that group. Blocks go straight to flash
+ * through ota_write_at as they come, repair blocks fill what a group lost,
+ * and when the stream goes quiet the blocks still missing are asked from
+ * the sender with a unicast NACK.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lwip/sockets.h"
+#include "oshal.h"
+#include "ota.h"
+#include "ota_fec.h"
+#include "local_ota.h"
+
+#define OTA_MCAST_PKT_LEN       (sizeof(ota_fec_hdr_t) + OTA_FEC_MAX_BLOCK)
+#define OTA_MCAST_NACK_MS       CONFIG_OTA_LOCAL_MCAST_NACK_MS
+#define OTA_MCAST_IDLE_MAX      (CONFIG_OTA_LOCAL_MCAST_TIMEOUT * 1000 / OTA_MCAST_NACK_MS)
+
+static int local_ota_mcast_write(void *arg, unsigned int offset, const unsigned char *data, unsigned int len)
+{
+    return ota_write_at(offset, (unsigned char *)data, len);
+}
+
+static int local_ota_mcast_url(const char *url, struct sockaddr_in *group)
+{
+    char host[16];
+    const char *p;
+    int n;
+
+    if (strncmp(url, LOCAL_OTA_MCAST_URL, strlen(LOCAL_OTA_MCAST_URL)) != 0)
+    {
+        return -1;
+    }
+    url += strlen(LOCAL_OTA_MCAST_URL);
+    p = strchr(url, ':');
+    n = p ? p - url : 0;
+    if (n <= 0 || n >= sizeof(host))
+    {
+        return -1;
+    }
+    memcpy(host, url, n);
+    host[n] = '\0';
+
+    memset(group, 0, sizeof(*group));
+    group->sin_family = AF_INET;
+    group->sin_addr.s_addr = inet_addr(host);
+    group->sin_port = htons(atoi(p + 1));
+    if (!IN_MULTICAST(ntohl(group->sin_addr.s_addr)) || group->sin_port == 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+int local_ota_mcast_download(const char *url)
+{
+    struct sockaddr_in group, local, sender, from;
+    socklen_t fromlen;
+    struct ip_mreq mreq;
+    struct timeval tv;
+    ota_fec_rx_t *rx = NULL;
+    ota_fec_hdr_t hdr;
+    unsigned char *pkt = NULL;
+    void *mem = NULL;
+    unsigned int size, held = 0, nacks = 0;
+    int sock, len, idle = 0, ret = -1;
+
+    if (local_ota_mcast_url(url, &group) != 0)
+    {
+        os_printf(LM_APP, LL_ERR, "mcast url %s not correct\n", url);
+        return -1;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        os_printf(LM_APP, LL_ERR, "mcast socket create failed\n");
+        return -1;
+    }
+    memset(&sender, 0, sizeof(sender));
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = group.sin_port;
+    mreq.imr_multiaddr.s_addr = group.sin_addr.s_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    tv.tv_sec = OTA_MCAST_NACK_MS / 1000;
+    tv.tv_usec = (OTA_MCAST_NACK_MS % 1000) * 1000;
+    if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+    {
+        os_printf(LM_APP, LL_ERR, "mcast join %s failed\n", url);
+        close(sock);
+        return -1;
+    }
+
+    rx = os_zalloc(sizeof(*rx));
+    pkt = os_malloc(OTA_MCAST_PKT_LEN);
+    if (rx == NULL || pkt == NULL)
+    {
+        goto out;
+    }
+
+    while (idle < OTA_MCAST_IDLE_MAX)
+    {
+        fromlen = sizeof(from);
+        len = recvfrom(sock, pkt, OTA_MCAST_PKT_LEN, 0, (struct sockaddr *)&from, &fromlen);
+        if (len > 0 && mem == NULL)
+        {
+            /* the first good packet sets up the session */
+            if (ota_fec_check(pkt, len, &hdr) != 0 || hdr.type == OTA_FEC_NACK || (size = ota_fec_rx_mem(&hdr)) == 0)
+            {
+                continue;
+            }
+            mem = os_malloc(size);
+            if (mem == NULL || ota_init() < 0)
+            {
+                goto out;
+            }
+            ota_fec_rx_init(rx, &hdr, mem, local_ota_mcast_write, NULL);
+            sender = from;
+            os_printf(LM_APP, LL_INFO, "mcast ota %u bytes, %u blocks of %u, fec %u+%u\n",
+                      rx->image_len, rx->blocks, rx->block_size, rx->k, rx->r);
+        }
+
+        if (len > 0)
+        {
+            ret = ota_fec_rx_input(rx, pkt, len);
+            if (ret != 0)
+            {
+                break;
+            }
+            if (rx->held != held)
+            {
+                held = rx->held;
+                idle = 0;
+            }
+            continue;
+        }
+
+        /* quiet: the carousel is over or we are cut off, ask for what is missing */
+        idle++;
+        if (mem != NULL)
+        {
+            os_msleep(os_random() % 50);    /* keep a fleet from nacking in lockstep */
+            len = ota_fec_rx_nack(rx, pkt, OTA_MCAST_PKT_LEN);
+            if (len > 0)
+            {
+                sendto(sock, pkt, len, 0, (struct sockaddr *)&sender, sizeof(sender));
+                nacks++;
+            }
+        }
+    }
+
+    if (mem != NULL)
+    {
+        os_printf(LM_APP, LL_INFO, "mcast ota %u/%u blocks, %u rebuilt, %u dup, %u nacks\n",
+                  rx->held, rx->blocks, rx->recovered, rx->duplicates, nacks);
+    }
+    ret = (ret == 1) ? 0 : -1;
+
+out:
+    setsockopt(sock, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+    close(sock);
+    os_free(mem);
+    os_free(pkt);
+    os_free(rx);
+    return ret;
+}
@@ -4,6 +4,7 @@
 #include "easyflash.h"
 #include "oshal.h"
 #include "ota.h"
+#include "ota_delta.h"
 #include "hal_system.h"
 
 typedef enum
@@ -66,6 +67,12 @@ typedef struct
     unsigned char dw_active_part;
     unsigned int dw_paddr[DOWNLOAD_FULL_PART];
     unsigned int dw_pdlen[DOWNLOAD_FULL_PART];
+    unsigned char *dw_erased;       /* ota_write_at: 4K sectors erased, one bit each */
+    unsigned int dw_sectors;
+    unsigned char *dw_boot_got;     /* ota_write_at: boot bytes received, one bit each */
+    ota_delta_t *dw_delta;          /* delta package: patch being applied */
+    unsigned int dw_delta_out;      /* new image bytes in flash */
+    unsigned int dw_delta_fill;     /* and in dw_buff */
 } download_oper_t;
 
 download_oper_t *g_ota_download;
@@ -83,6 +90,17 @@ static int download_packet_data(download_oper_t *handle, unsigned char *data, un
         }\
     }
 
+/* a package of patches to apply against the running image, see ota_delta.h */
+static int download_is_delta(download_oper_t *handle)
+{
+#ifdef CONFIG_OTA_DELTA
+    return handle->dw_rmethod == DOWNLOAD_DIFF_METHOD &&
+        (handle->dw_head.delta_size != 0 || handle->dw_head.delta_new_size != 0);
+#else
+    return 0;
+#endif
+}
+
 static void download_packet_head_dump(download_oper_t *handle)
 {
     os_printf(LM_APP, LL_ERR, "magic:%c%c%c%c%c%c%c\n", handle->dw_head.magic[0], handle->dw_head.magic[1],
@@ -302,7 +320,14 @@ static int download_packet_head_check(download_oper_t *handle)
         DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_MAGIC_ERR);
     }
 
-    if (handle->dw_rmethod == DOWNLOAD_DIFF_METHOD && handle->dw_lmethod == DOWNLOAD_DUAL_METHOD)
+    if (handle->dw_rmethod == DOWNLOAD_DIFF_METHOD && handle->dw_lmethod == DOWNLOAD_DUAL_METHOD &&
+        !download_is_delta(handle))
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_METH_ERR);
+    }
+
+    /* the new image is built next to the old one, only AB layouts have room */
+    if (download_is_delta(handle) && handle->dw_lmethod != DOWNLOAD_DUAL_METHOD)
     {
         DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_METH_ERR);
     }
@@ -355,7 +380,7 @@ static int download_packet_complete(download_oper_t *handle, unsigned char *data
         handle->dw_rmethod = (handle->dw_head.version >> 4) / 4;
         ret = download_packet_head_check(handle);
         DOWNLOAD_RET_CHECK_RETURN(ret);
-        if (handle->dw_rmethod == DOWNLOAD_DUAL_METHOD)
+        if (handle->dw_rmethod == DOWNLOAD_DUAL_METHOD || download_is_delta(handle))
         {
             handle->dw_state = DOWNLOAD_BOOT_ST;
             if (handle->dw_head.boot_size != 0)
@@ -402,7 +427,7 @@ static int download_packet_complete(download_oper_t *handle, unsigned char *data
     if (handle->dw_state == DOWNLOAD_BOOT_ST)
     {
         handle->dw_addr = handle->dw_paddr[DOWNLOAD_IMGA_PART];
-        handle->dw_dlen = handle->dw_head.firmware_size;
+        handle->dw_dlen = download_is_delta(handle) ? handle->dw_head.delta_size : handle->dw_head.firmware_size;
         handle->dw_offt = 0;
         handle->dw_state = DOWNLOAD_IMGA_ST;
 
@@ -422,7 +447,7 @@ static int download_packet_complete(download_oper_t *handle, unsigned char *data
     if (handle->dw_state == DOWNLOAD_IMGA_ST)
     {
         handle->dw_addr = handle->dw_paddr[DOWNLOAD_IMGB_PART];
-        handle->dw_dlen = handle->dw_head.firmware_new_size;
+        handle->dw_dlen = download_is_delta(handle) ? handle->dw_head.delta_new_size : handle->dw_head.firmware_new_size;
         handle->dw_offt = 0;
         handle->dw_state = DOWNLOAD_IMGB_ST;
 
@@ -469,6 +494,120 @@ static int download_package_boot(download_oper_t *handle, unsigned char *data, u
     return DOWNLOAD_NONE_ERR;
 }
 
+#ifdef CONFIG_OTA_DELTA
+/* the old image, from the part running now */
+static int download_delta_read(void *arg, unsigned int offset, unsigned char *buf, unsigned int len)
+{
+    download_oper_t *handle = (download_oper_t *)arg;
+    int part = (handle->dw_active_part == DOWNLOAD_OTA_PARTB) ? DOWNLOAD_IMGB_PART : DOWNLOAD_IMGA_PART;
+
+    if (offset > handle->dw_pdlen[part] || len > handle->dw_pdlen[part] - offset)
+    {
+        return -DOWNLOAD_SIZE_ERR;
+    }
+
+    return drv_spiflash_read(handle->dw_paddr[part] + offset, buf, len);
+}
+
+static int download_delta_flush(download_oper_t *handle)
+{
+    int part = (handle->dw_state == DOWNLOAD_IMGB_ST) ? DOWNLOAD_IMGB_PART : DOWNLOAD_IMGA_PART;
+    int ret;
+
+    if (handle->dw_delta_fill == 0)
+    {
+        return DOWNLOAD_NONE_ERR;
+    }
+    if (handle->dw_delta_out + handle->dw_buff_size > handle->dw_pdlen[part])
+    {
+        return -DOWNLOAD_SIZE_ERR;
+    }
+
+    ret = drv_spiflash_erase(handle->dw_addr + handle->dw_delta_out, handle->dw_buff_size);
+    if (ret == 0)
+    {
+        ret = drv_spiflash_write(handle->dw_addr + handle->dw_delta_out, handle->dw_buff, handle->dw_buff_size);
+    }
+    handle->dw_delta_out += handle->dw_delta_fill;
+    handle->dw_delta_fill = 0;
+    memset(handle->dw_buff, 0xFF, handle->dw_buff_size);
+
+    return ret;
+}
+
+/* the new image, a sector at a time through dw_buff into the other part */
+static int download_delta_write(void *arg, const unsigned char *data, unsigned int len)
+{
+    download_oper_t *handle = (download_oper_t *)arg;
+    unsigned int n;
+    int ret;
+
+    while (len > 0)
+    {
+        n = handle->dw_buff_size - handle->dw_delta_fill;
+        n = (n > len) ? len : n;
+        memcpy(handle->dw_buff + handle->dw_delta_fill, data, n);
+        handle->dw_delta_fill += n;
+        data += n;
+        len -= n;
+        if (handle->dw_delta_fill == handle->dw_buff_size)
+        {
+            ret = download_delta_flush(handle);
+            if (ret != 0)
+            {
+                return ret;
+            }
+        }
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+
+static int download_delta_data(download_oper_t *handle, unsigned char *data, unsigned int len, int last)
+{
+    int ret;
+
+    if (handle->dw_delta == NULL)
+    {
+        handle->dw_delta = (ota_delta_t *)os_malloc(sizeof(ota_delta_t));
+        if (handle->dw_delta == NULL)
+        {
+            DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_NOMEM_ERR);
+        }
+        ota_delta_init(handle->dw_delta, download_delta_read, download_delta_write, handle);
+        handle->dw_delta_out = 0;
+        handle->dw_delta_fill = 0;
+        memset(handle->dw_buff, 0xFF, handle->dw_buff_size);
+    }
+
+    ret = ota_delta_input(handle->dw_delta, data, len);
+    if (ret == 0 && last)
+    {
+        ret = ota_delta_finish(handle->dw_delta);
+        if (ret == 0)
+        {
+            ret = download_delta_flush(handle);
+        }
+        os_free(handle->dw_delta);
+        handle->dw_delta = NULL;
+    }
+    if (ret != 0)
+    {
+        os_printf(LM_APP, LL_ERR, "OTA:delta failed %d at 0x%x\n", ret, handle->dw_offt);
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_CRC_ERR);
+    }
+
+    handle->dw_offt += len;
+    if (handle->dw_percent != handle->dw_offt * 100 / handle->dw_dlen)
+    {
+        handle->dw_percent = handle->dw_offt * 100 / handle->dw_dlen;
+        os_printf(LM_APP, LL_ERR, "OTA download %d%%\n", handle->dw_percent);
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+#endif
+
 static int download_package_imge(download_oper_t *handle, unsigned char *data, unsigned int len)
 {
     unsigned int writelen = 0;
@@ -478,6 +617,20 @@ static int download_package_imge(download_oper_t *handle, unsigned char *data, u
     leftlen = handle->dw_dlen - handle->dw_offt - handle->dw_buff_offt;
     writelen = leftlen > len ? len : leftlen;
 
+#ifdef CONFIG_OTA_DELTA
+    if (handle->dw_skip == 0 && download_is_delta(handle))
+    {
+        ret = download_delta_data(handle, data, writelen, writelen == leftlen);
+        DOWNLOAD_RET_CHECK_RETURN(ret);
+
+        if (len > writelen)
+        {
+            return download_packet_data(handle, data + writelen, len - writelen);
+        }
+        return DOWNLOAD_NONE_ERR;
+    }
+#endif
+
     if (handle->dw_skip == 0)
     {
         ret = download_packet_flash(handle, data, writelen);
@@ -595,6 +748,24 @@ static void download_mem_release(download_oper_t **handle)
         ht->dw_buff = NULL;
     }
 
+    if (ht->dw_erased)
+    {
+        os_free(ht->dw_erased);
+        ht->dw_erased = NULL;
+    }
+
+    if (ht->dw_boot_got)
+    {
+        os_free(ht->dw_boot_got);
+        ht->dw_boot_got = NULL;
+    }
+
+    if (ht->dw_delta)
+    {
+        os_free(ht->dw_delta);
+        ht->dw_delta = NULL;
+    }
+
     os_free(ht);
     *handle = NULL;
 }
@@ -618,7 +789,7 @@ static int download_packet_done(download_oper_t *handle, ota_state_t *state)
     {
         unsigned int len = offsetof(ota_package_head_t, boot_size);
         os_printf(LM_APP, LL_INFO, "OTA:* * * active part A * * *\n");
-        if (handle->dw_rmethod == DOWNLOAD_DUAL_METHOD)
+        if (handle->dw_rmethod == DOWNLOAD_DUAL_METHOD || download_is_delta(handle))
         {
             crc = ota_get_flash_crc(handle->dw_paddr[DOWNLOAD_IMGB_PART], handle->dw_head.firmware_new_size);
             if(crc != handle->dw_head.firmware_new_crc)
@@ -756,6 +927,329 @@ int ota_write(unsigned char *data, unsigned int len)
     return download_packet_data(g_ota_download, data, len);
 }
 
+/*
+ * Where package offset <offset> lives in flash: 1 with the address and the
+ * bytes left in that region, 0 if the region is not stored (head of an AB
+ * package, the image of the running part) with the bytes to skip.
+ */
+static int download_offset_map(download_oper_t *handle, unsigned int offset, unsigned int *addr, unsigned int *len)
+{
+    unsigned int size[4], store[4], base[4];
+    int i;
+
+    if (handle->dw_rmethod != DOWNLOAD_DUAL_METHOD)
+    {
+        if (offset >= handle->dw_head.package_size)
+        {
+            return -DOWNLOAD_SIZE_ERR;
+        }
+        *addr = handle->dw_addr + offset;
+        *len = handle->dw_head.package_size - offset;
+        return 1;
+    }
+
+    size[0] = sizeof(ota_package_head_t);
+    store[0] = 0;
+    base[0] = 0;
+    size[1] = handle->dw_head.boot_size;
+    store[1] = 1;
+    base[1] = handle->dw_paddr[DOWNLOAD_BOOT_PART];
+    size[2] = handle->dw_head.firmware_size;
+    store[2] = (handle->dw_active_part != DOWNLOAD_OTA_PARTA);
+    base[2] = handle->dw_paddr[DOWNLOAD_IMGA_PART];
+    size[3] = handle->dw_head.firmware_new_size;
+    store[3] = (handle->dw_active_part != DOWNLOAD_OTA_PARTB);
+    base[3] = handle->dw_paddr[DOWNLOAD_IMGB_PART];
+
+    for (i = 0; i < 4; i++)
+    {
+        if (offset < size[i])
+        {
+            *addr = base[i] + offset;
+            *len = size[i] - offset;
+            return store[i];
+        }
+        offset -= size[i];
+    }
+
+    return -DOWNLOAD_SIZE_ERR;
+}
+
+/*
+ * Note package range [offset, offset + len) as received where it overlaps
+ * the boot image. Nothing checks the boot image but this: the crc at
+ * ota_done only covers the firmware of an AB package.
+ */
+static void download_boot_mark(download_oper_t *handle, unsigned int offset, unsigned int len)
+{
+    unsigned int start = sizeof(ota_package_head_t), size = handle->dw_head.boot_size, from, to;
+
+    if (handle->dw_boot_got == NULL || offset >= start + size || offset + len <= start)
+    {
+        return;
+    }
+
+    from = (offset > start) ? offset - start : 0;
+    to = offset + len - start;
+    to = (to > size) ? size : to;
+    for (; from < to && (from & 7); from++)
+    {
+        handle->dw_boot_got[from / 8] |= 1 << (from % 8);
+    }
+    if (to - from >= 8)
+    {
+        memset(&handle->dw_boot_got[from / 8], 0xFF, (to - from) / 8);
+        from += (to - from) & ~7;
+    }
+    for (; from < to; from++)
+    {
+        handle->dw_boot_got[from / 8] |= 1 << (from % 8);
+    }
+}
+
+/* 1 when every byte of the boot image has been received, or there is none to track */
+static int download_boot_complete(download_oper_t *handle)
+{
+    unsigned int size = handle->dw_head.boot_size, i;
+
+    if (handle->dw_boot_got == NULL)
+    {
+        return 1;
+    }
+
+    for (i = 0; i < size / 8; i++)
+    {
+        if (handle->dw_boot_got[i] != 0xFF)
+        {
+            return 0;
+        }
+    }
+
+    return (size % 8 == 0) || handle->dw_boot_got[i] == (1 << (size % 8)) - 1;
+}
+
+/* program into sectors erased on first touch, whatever order they come in */
+static int download_random_flash(download_oper_t *handle, unsigned int addr, unsigned char *data, unsigned int len)
+{
+    unsigned int sector, n;
+    int ret;
+
+    while (len > 0)
+    {
+        sector = addr >> 12;
+        if (sector >= handle->dw_sectors)
+        {
+            return -DOWNLOAD_SIZE_ERR;
+        }
+        if (!(handle->dw_erased[sector / 8] & (1 << (sector % 8))))
+        {
+            ret = drv_spiflash_erase(sector << 12, 4096);
+            if (ret != 0)
+            {
+                return ret;
+            }
+            handle->dw_erased[sector / 8] |= 1 << (sector % 8);
+        }
+
+        n = 4096 - (addr & 0xFFF);
+        n = (n > len) ? len : n;
+        ret = drv_spiflash_write(addr, data, n);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        addr += n;
+        data += n;
+        len -= n;
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+
+/* take the package head for out of order writes, nothing goes to flash yet */
+static int download_random_init(download_oper_t *handle, unsigned char *head)
+{
+    int ret;
+
+    ret = download_packet_data(handle, head, sizeof(ota_package_head_t));
+    DOWNLOAD_RET_CHECK_RETURN(ret);
+    DOWNLOAD_RET_CHECK_RETURN(handle->dw_state <= DOWNLOAD_HEAD_ST);
+
+    /* a patch only makes sense in order */
+    if (download_is_delta(handle))
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_METH_ERR);
+    }
+
+    /* the head goes out with the bytes around it, not through dw_buff */
+    handle->dw_buff_offt = 0;
+    handle->dw_sectors = (handle->dw_paddr[DOWNLOAD_IMGB_PART] + handle->dw_pdlen[DOWNLOAD_IMGB_PART]) >> 12;
+    if (handle->dw_paddr[DOWNLOAD_BOOT_PART] + handle->dw_pdlen[DOWNLOAD_BOOT_PART] > (handle->dw_sectors << 12))
+    {
+        handle->dw_sectors = (handle->dw_paddr[DOWNLOAD_BOOT_PART] + handle->dw_pdlen[DOWNLOAD_BOOT_PART]) >> 12;
+    }
+    handle->dw_erased = (unsigned char *)os_zalloc((handle->dw_sectors + 7) / 8);
+    if (handle->dw_erased == NULL)
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_NOMEM_ERR);
+    }
+
+    if (handle->dw_rmethod == DOWNLOAD_DUAL_METHOD && handle->dw_head.boot_size != 0)
+    {
+        handle->dw_boot_got = (unsigned char *)os_zalloc((handle->dw_head.boot_size + 7) / 8);
+        if (handle->dw_boot_got == NULL)
+        {
+            DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_NOMEM_ERR);
+        }
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+
+/*
+ * Write package bytes at any offset, in any order and more than once, for
+ * transports that do not deliver a stream (multicast blocks, ranged
+ * requests). The package head has to come first, from offset 0, since it
+ * tells where everything else goes; until then 1 is returned and nothing
+ * is written. Do not mix with ota_write once started.
+ */
+int ota_write_at(unsigned int offset, unsigned char *data, unsigned int len)
+{
+    download_oper_t *handle = g_ota_download;
+    unsigned int addr, room, n;
+    int ret;
+
+    if (handle == NULL)
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_INIT_ERR);
+    }
+
+    if (handle->dw_state <= DOWNLOAD_HEAD_ST)
+    {
+        if (offset != 0 || len < sizeof(ota_package_head_t))
+        {
+            return 1;
+        }
+
+        /* a complete head is checked and placed right away */
+        ret = download_random_init(handle, data);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+    else if (handle->dw_erased == NULL)
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_STAT_ERR);
+    }
+
+    while (len > 0)
+    {
+        ret = download_offset_map(handle, offset, &addr, &room);
+        DOWNLOAD_RET_CHECK_RETURN(ret < 0 ? ret : 0);
+        n = (room > len) ? len : room;
+        if (ret == 1)
+        {
+            ret = download_random_flash(handle, addr, data, n);
+            DOWNLOAD_RET_CHECK_RETURN(ret);
+        }
+        download_boot_mark(handle, offset, n);
+        offset += n;
+        data += n;
+        len -= n;
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+
+/*
+ * Pick up an ota_write_at download after a reboot or a lost link. <head> is
+ * the package head written before, [offset, offset + len) a range already
+ * in flash: its sectors are taken as erased so that writing on from the end
+ * of the range keeps what is there. Call once per range. Rewriting bytes
+ * already programmed is fine as long as they are the same.
+ */
+int ota_resume_at(unsigned char *head, unsigned int offset, unsigned int len)
+{
+    download_oper_t *handle = g_ota_download;
+    unsigned int addr, room, n, sector;
+    int ret;
+
+    if (handle == NULL)
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_INIT_ERR);
+    }
+
+    if (handle->dw_state <= DOWNLOAD_HEAD_ST)
+    {
+        ret = download_random_init(handle, head);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+    else if (handle->dw_erased == NULL || memcmp(&handle->dw_head, head, sizeof(ota_package_head_t)) != 0)
+    {
+        DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_STAT_ERR);
+    }
+
+    while (len > 0)
+    {
+        ret = download_offset_map(handle, offset, &addr, &room);
+        DOWNLOAD_RET_CHECK_RETURN(ret < 0 ? ret : 0);
+        n = (room > len) ? len : room;
+        for (sector = addr >> 12; ret == 1 && sector <= (addr + n - 1) >> 12 && sector < handle->dw_sectors; sector++)
+        {
+            handle->dw_erased[sector / 8] |= 1 << (sector % 8);
+        }
+        download_boot_mark(handle, offset, n);
+        offset += n;
+        len -= n;
+    }
+
+    return DOWNLOAD_NONE_ERR;
+}
+
+/*
+ * crc32 of the bytes of package range [offset, offset + len) that are kept
+ * in flash, folded into <crc>: taken from <data> when given, so it can run
+ * along the writes, else read back from flash to check them after a resume.
+ */
+unsigned int ota_crc_at(unsigned int crc, unsigned int offset, const unsigned char *data, unsigned int len)
+{
+    download_oper_t *handle = g_ota_download;
+    unsigned int addr, room, n, m;
+    int ret;
+
+    while (handle != NULL && handle->dw_erased != NULL && len > 0)
+    {
+        ret = download_offset_map(handle, offset, &addr, &room);
+        if (ret < 0)
+        {
+            break;
+        }
+        n = (room > len) ? len : room;
+        if (ret == 1 && data != NULL)
+        {
+            crc = ef_calc_crc32(crc, data, n);
+        }
+        for (m = 0; ret == 1 && data == NULL && m < n; m += room)
+        {
+            room = (n - m > handle->dw_buff_size) ? handle->dw_buff_size : n - m;
+            if (drv_spiflash_read(addr + m, handle->dw_buff, room) != 0)
+            {
+                return ~crc;    /* cannot match */
+            }
+            crc = ef_calc_crc32(crc, handle->dw_buff, room);
+        }
+        offset += n;
+        data = data ? data + n : NULL;
+        len -= n;
+    }
+
+    return crc;
+}
+
 int ota_done(int reset)
 {
     ota_state_t state;
@@ -775,7 +1269,20 @@ int ota_done(int reset)
     state.patch_size = g_ota_download->dw_head.package_size;
 
     DOWNLOAD_RET_CHECK_RETURN(g_ota_download->dw_dlen == 0);
-    if (g_ota_download->dw_dlen != g_ota_download->dw_offt)
+    if (g_ota_download->dw_erased != NULL)
+    {
+        /* written out of order: the crc check below covers the firmware, the boot image has to be all in */
+        if (!download_boot_complete(g_ota_download))
+        {
+            os_printf(LM_APP, LL_ERR, "OTA:boot image incomplete\n");
+            DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_SIZE_ERR);
+        }
+        if (g_ota_download->dw_rmethod == DOWNLOAD_DUAL_METHOD)
+        {
+            state.patch_addr = g_ota_download->dw_paddr[DOWNLOAD_IMGB_PART];
+        }
+    }
+    else if (g_ota_download->dw_dlen != g_ota_download->dw_offt)
     {
         DOWNLOAD_RET_CHECK_RETURN(-DOWNLOAD_SIZE_ERR);
     }
@@ -0,0 +1,410 @@
+/**
+ * @file ota_delta.c
+ * @brief Streaming delta patch decoder, see ota_delta.h
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "ota_delta.h"
+#ifdef CONFIG_OTA
+#include "easyflash.h"
+#endif
+
+enum
+{
+    LZ_TOKEN,
+    LZ_LIT_EXT,
+    LZ_LIT,
+    LZ_OFF0,
+    LZ_OFF1,
+    LZ_MATCH_EXT,
+    LZ_END,
+};
+
+enum
+{
+    REC_ADD_LEN,
+    REC_COPY_LEN,
+    REC_SEEK,
+    REC_ADD,
+    REC_COPY,
+};
+
+#ifdef CONFIG_OTA
+unsigned int ota_delta_crc32(unsigned int crc, const void *buf, unsigned int len)
+{
+    return ef_calc_crc32(crc, buf, len);
+}
+#else
+unsigned int ota_delta_crc32(unsigned int crc, const void *buf, unsigned int len)
+{
+    const unsigned char *p = buf;
+    int i;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+#endif
+
+static int delta_fail(ota_delta_t *d, int err)
+{
+    if (d->err == 0)
+    {
+        d->err = err;
+    }
+    return d->err;
+}
+
+static int delta_emit(ota_delta_t *d, const unsigned char *data, unsigned int len)
+{
+    if (d->write(d->arg, data, len) != 0)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_IO);
+    }
+    d->crc = ota_delta_crc32(d->crc, data, len);
+    d->new_pos += len;
+    return 0;
+}
+
+/* the image the patch was made against has to be the one there */
+static int delta_check_base(ota_delta_t *d)
+{
+    unsigned int pos, n, crc = 0;
+
+    if (d->head.magic != OTA_DELTA_MAGIC || d->head.window == 0 || d->head.window > OTA_DELTA_WINDOW)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_PATCH);
+    }
+    for (pos = 0; pos < d->head.old_size; pos += n)
+    {
+        n = d->head.old_size - pos;
+        n = (n > OTA_DELTA_CHUNK) ? OTA_DELTA_CHUNK : n;
+        if (d->read(d->arg, pos, d->chunk, n) != 0)
+        {
+            return delta_fail(d, OTA_DELTA_ERR_IO);
+        }
+        crc = ota_delta_crc32(crc, d->chunk, n);
+    }
+    if (crc != d->head.old_crc)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_BASE);
+    }
+    return 0;
+}
+
+/* a record is through: move the old position, the next one may start */
+static int delta_record_end(ota_delta_t *d)
+{
+    if (d->seek < 0 ? (unsigned int)-d->seek > d->old_pos : (unsigned int)d->seek > d->head.old_size - d->old_pos)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_PATCH);
+    }
+    d->old_pos += d->seek;
+    d->rec_state = REC_ADD_LEN;
+    return 0;
+}
+
+static int delta_record_start(ota_delta_t *d)
+{
+    if (d->add_len > d->head.old_size - d->old_pos ||
+        d->add_len > d->head.new_size - d->new_pos ||
+        d->copy_len > d->head.new_size - d->new_pos - d->add_len)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_PATCH);
+    }
+    if (d->add_len)
+    {
+        d->rec_state = REC_ADD;
+    }
+    else if (d->copy_len)
+    {
+        d->rec_state = REC_COPY;
+    }
+    else
+    {
+        return delta_record_end(d);
+    }
+    return 0;
+}
+
+/* decoded lz output, a piece of the record stream */
+static int delta_records(ota_delta_t *d, const unsigned char *p, unsigned int len)
+{
+    unsigned int n, i;
+
+    while (len > 0 && d->err == 0)
+    {
+        switch (d->rec_state)
+        {
+        case REC_ADD_LEN:
+        case REC_COPY_LEN:
+        case REC_SEEK:
+            if (d->rec_shift > 28)
+            {
+                return delta_fail(d, OTA_DELTA_ERR_PATCH);
+            }
+            d->rec_value |= (unsigned int)(*p & 0x7f) << d->rec_shift;
+            d->rec_shift += 7;
+            if (*p++ & 0x80)
+            {
+                len--;
+                break;
+            }
+            len--;
+            d->rec_shift = 0;
+            if (d->rec_state == REC_ADD_LEN)
+            {
+                d->add_len = d->rec_value;
+                d->rec_state = REC_COPY_LEN;
+            }
+            else if (d->rec_state == REC_COPY_LEN)
+            {
+                d->copy_len = d->rec_value;
+                d->rec_state = REC_SEEK;
+            }
+            else
+            {
+                d->seek = (int)((d->rec_value >> 1) ^ (0u - (d->rec_value & 1)));
+                delta_record_start(d);
+            }
+            d->rec_value = 0;
+            break;
+
+        case REC_ADD:
+            n = (len > d->add_len) ? d->add_len : len;
+            n = (n > OTA_DELTA_CHUNK) ? OTA_DELTA_CHUNK : n;
+            if (d->read(d->arg, d->old_pos, d->chunk, n) != 0)
+            {
+                return delta_fail(d, OTA_DELTA_ERR_IO);
+            }
+            for (i = 0; i < n; i++)
+            {
+                d->chunk[i] += p[i];
+            }
+            delta_emit(d, d->chunk, n);
+            d->old_pos += n;
+            d->add_len -= n;
+            p += n;
+            len -= n;
+            if (d->add_len == 0)
+            {
+                if (d->copy_len)
+                {
+                    d->rec_state = REC_COPY;
+                }
+                else
+                {
+                    delta_record_end(d);
+                }
+            }
+            break;
+
+        case REC_COPY:
+            n = (len > d->copy_len) ? d->copy_len : len;
+            delta_emit(d, p, n);
+            d->copy_len -= n;
+            p += n;
+            len -= n;
+            if (d->copy_len == 0)
+            {
+                delta_record_end(d);
+            }
+            break;
+        }
+    }
+
+    return d->err;
+}
+
+/* literals: into the window and on to the records */
+static int delta_literals(ota_delta_t *d, const unsigned char *p, unsigned int len)
+{
+    unsigned int n, i;
+
+    for (i = 0; i < len; i += n)
+    {
+        n = OTA_DELTA_WINDOW - d->lz_wpos;
+        n = (n > len - i) ? len - i : n;
+        memcpy(d->window + d->lz_wpos, p + i, n);
+        d->lz_wpos = (d->lz_wpos + n) % OTA_DELTA_WINDOW;
+    }
+    d->lz_total += len;
+    return delta_records(d, p, len);
+}
+
+/* a match, copied within the window in runs that do not wrap */
+static int delta_match(ota_delta_t *d)
+{
+    unsigned int len = d->lz_match, n, i, src, start;
+
+    if (d->lz_off > d->head.window || d->lz_off > d->lz_total)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_PATCH);
+    }
+    src = (d->lz_wpos + OTA_DELTA_WINDOW - d->lz_off) % OTA_DELTA_WINDOW;
+    while (len > 0 && d->err == 0)
+    {
+        start = d->lz_wpos;
+        n = OTA_DELTA_WINDOW - start;
+        n = (n > len) ? len : n;
+        for (i = 0; i < n; i++)
+        {
+            d->window[start + i] = d->window[src];
+            if (++src == OTA_DELTA_WINDOW)
+            {
+                src = 0;
+            }
+        }
+        d->lz_wpos = (start + n) % OTA_DELTA_WINDOW;
+        d->lz_total += n;
+        len -= n;
+        delta_records(d, d->window + start, n);
+    }
+    return d->err;
+}
+
+void ota_delta_init(ota_delta_t *d, ota_delta_read_fn read, ota_delta_write_fn write, void *arg)
+{
+    memset(d, 0, offsetof(ota_delta_t, window));
+    d->lz_state = LZ_TOKEN;
+    d->rec_state = REC_ADD_LEN;
+    d->read = read;
+    d->write = write;
+    d->arg = arg;
+}
+
+int ota_delta_input(ota_delta_t *d, const unsigned char *data, unsigned int len)
+{
+    unsigned int n;
+    unsigned char b;
+
+    if (d->err)
+    {
+        return d->err;
+    }
+
+    if (d->head_len < sizeof(ota_delta_head_t))
+    {
+        n = sizeof(ota_delta_head_t) - d->head_len;
+        n = (n > len) ? len : n;
+        memcpy((unsigned char *)&d->head + d->head_len, data, n);
+        d->head_len += n;
+        data += n;
+        len -= n;
+        if (d->head_len == sizeof(ota_delta_head_t) && delta_check_base(d) != 0)
+        {
+            return d->err;
+        }
+    }
+
+    d->patch_crc = ota_delta_crc32(d->patch_crc, data, len);
+    while (len > 0 && d->err == 0)
+    {
+        b = *data;
+        switch (d->lz_state)
+        {
+        case LZ_TOKEN:
+            d->lz_lit = b >> 4;
+            d->lz_match = b & 15;
+            d->lz_state = (d->lz_lit == 15) ? LZ_LIT_EXT : (d->lz_lit ? LZ_LIT : LZ_OFF0);
+            break;
+
+        case LZ_LIT_EXT:
+            d->lz_lit += b;
+            if (d->lz_lit > d->head.new_size * 2 + 64)
+            {
+                return delta_fail(d, OTA_DELTA_ERR_PATCH);
+            }
+            if (b != 255)
+            {
+                d->lz_state = LZ_LIT;
+            }
+            break;
+
+        case LZ_LIT:
+            n = (len > d->lz_lit) ? d->lz_lit : len;
+            delta_literals(d, data, n);
+            d->lz_lit -= n;
+            if (d->lz_lit == 0)
+            {
+                d->lz_state = LZ_OFF0;
+            }
+            data += n;
+            len -= n;
+            continue;
+
+        case LZ_OFF0:
+            d->lz_off = b;
+            d->lz_state = LZ_OFF1;
+            break;
+
+        case LZ_OFF1:
+            d->lz_off |= (unsigned int)b << 8;
+            if (d->lz_off == 0)
+            {
+                d->lz_state = LZ_END;
+                if (d->lz_match != 0)
+                {
+                    return delta_fail(d, OTA_DELTA_ERR_PATCH);
+                }
+            }
+            else if (d->lz_match == 15)
+            {
+                d->lz_state = LZ_MATCH_EXT;
+            }
+            else
+            {
+                d->lz_match += OTA_DELTA_MIN_MATCH;
+                d->lz_state = LZ_TOKEN;
+                delta_match(d);
+            }
+            break;
+
+        case LZ_MATCH_EXT:
+            d->lz_match += b;
+            if (d->lz_match > d->head.new_size * 2 + 64)
+            {
+                return delta_fail(d, OTA_DELTA_ERR_PATCH);
+            }
+            if (b != 255)
+            {
+                d->lz_match += OTA_DELTA_MIN_MATCH;
+                d->lz_state = LZ_TOKEN;
+                delta_match(d);
+            }
+            break;
+
+        default:
+            /* nothing may follow the end */
+            return delta_fail(d, OTA_DELTA_ERR_PATCH);
+        }
+        data++;
+        len--;
+    }
+
+    return d->err;
+}
+
+int ota_delta_finish(ota_delta_t *d)
+{
+    if (d->err)
+    {
+        return d->err;
+    }
+    if (d->head_len != sizeof(ota_delta_head_t) || d->lz_state != LZ_END ||
+        d->rec_state != REC_ADD_LEN || d->rec_shift != 0 ||
+        d->new_pos != d->head.new_size || d->crc != d->head.new_crc ||
+        d->patch_crc != d->head.patch_crc)
+    {
+        return delta_fail(d, OTA_DELTA_ERR_PATCH);
+    }
+    return 0;
+}
@@ -0,0 +1,586 @@
+/**
+ * @file ota_fec.c
+ * @brief Multicast OTA block carousel with Reed-Solomon repair, see ota_fec.h
+ */
+
+#include <string.h>
+#include "ota_fec.h"
+#ifdef CONFIG_OTA
+#include "easyflash.h"
+#endif
+
+#define OTA_FEC_HDR_LEN     sizeof(ota_fec_hdr_t)
+
+static unsigned char gf_exp[512];
+static unsigned char gf_log[256];
+
+/* GF(2^8) over x^8 + x^4 + x^3 + x^2 + 1, generator 2 */
+static void gf_init(void)
+{
+    unsigned int x = 1;
+    int i;
+
+    if (gf_exp[0])
+    {
+        return;
+    }
+    for (i = 0; i < 255; i++)
+    {
+        gf_exp[i] = x;
+        gf_exp[i + 255] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+        {
+            x ^= 0x11d;
+        }
+    }
+    gf_exp[510] = gf_exp[0];
+    gf_exp[511] = gf_exp[1];
+}
+
+static unsigned char gf_mul(unsigned char a, unsigned char b)
+{
+    return (a && b) ? gf_exp[gf_log[a] + gf_log[b]] : 0;
+}
+
+static unsigned char gf_inv(unsigned char a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+/* dst += c * src */
+static void gf_mul_add(unsigned char *dst, const unsigned char *src, unsigned char c, unsigned int len)
+{
+    const unsigned char *exp;
+    unsigned int i;
+
+    if (c == 0)
+    {
+        return;
+    }
+    if (c == 1)
+    {
+        for (i = 0; i < len; i++)
+        {
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+    exp = &gf_exp[gf_log[c]];
+    for (i = 0; i < len; i++)
+    {
+        if (src[i])
+        {
+            dst[i] ^= exp[gf_log[src[i]]];
+        }
+    }
+}
+
+/* Cauchy matrix 1 / (x_row + y_col), x = k + row and y = col never meet */
+static unsigned char fec_coef(unsigned int k, unsigned int row, unsigned int col)
+{
+    return gf_inv((k + row) ^ col);
+}
+
+/* Gauss-Jordan in place, any square part of a Cauchy matrix is invertible */
+static int gf_invert(unsigned char m[OTA_FEC_MAX_R][OTA_FEC_MAX_R], unsigned char inv[OTA_FEC_MAX_R][OTA_FEC_MAX_R], int n)
+{
+    unsigned char t, c;
+    int i, j, p;
+
+    memset(inv, 0, OTA_FEC_MAX_R * OTA_FEC_MAX_R);
+    for (i = 0; i < n; i++)
+    {
+        inv[i][i] = 1;
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (p = i; p < n && m[p][i] == 0; p++)
+            ;
+        if (p == n)
+        {
+            return -1;
+        }
+        for (j = 0; j < n && p != i; j++)
+        {
+            t = m[i][j]; m[i][j] = m[p][j]; m[p][j] = t;
+            t = inv[i][j]; inv[i][j] = inv[p][j]; inv[p][j] = t;
+        }
+        c = gf_inv(m[i][i]);
+        for (j = 0; j < n; j++)
+        {
+            m[i][j] = gf_mul(m[i][j], c);
+            inv[i][j] = gf_mul(inv[i][j], c);
+        }
+        for (p = 0; p < n; p++)
+        {
+            if (p == i || m[p][i] == 0)
+            {
+                continue;
+            }
+            c = m[p][i];
+            for (j = 0; j < n; j++)
+            {
+                m[p][j] ^= gf_mul(m[i][j], c);
+                inv[p][j] ^= gf_mul(inv[i][j], c);
+            }
+        }
+    }
+    return 0;
+}
+
+#ifdef CONFIG_OTA
+unsigned int ota_fec_crc32(unsigned int crc, const void *buf, unsigned int len)
+{
+    return ef_calc_crc32(crc, buf, len);
+}
+#else
+unsigned int ota_fec_crc32(unsigned int crc, const void *buf, unsigned int len)
+{
+    const unsigned char *p = buf;
+    int i;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+#endif
+
+static unsigned int fec_blocks(unsigned int image_len, unsigned int block_size)
+{
+    return (image_len + block_size - 1) / block_size;
+}
+
+/* bytes of block <index>, the last one is short */
+static unsigned int fec_block_len(unsigned int image_len, unsigned int block_size, unsigned int index)
+{
+    unsigned int left = image_len - index * block_size;
+
+    return (left > block_size) ? block_size : left;
+}
+
+/* data blocks in <group>, the last group is short */
+static unsigned int fec_group_len(unsigned int blocks, unsigned int k, unsigned int group)
+{
+    unsigned int left = blocks - group * k;
+
+    return (left > k) ? k : left;
+}
+
+int ota_fec_check(const unsigned char *pkt, unsigned int len, ota_fec_hdr_t *hdr)
+{
+    unsigned int crc;
+
+    if (len < OTA_FEC_HDR_LEN)
+    {
+        return -1;
+    }
+    memcpy(hdr, pkt, OTA_FEC_HDR_LEN);
+    if (hdr->magic != OTA_FEC_MAGIC || hdr->len != len - OTA_FEC_HDR_LEN)
+    {
+        return -1;
+    }
+    crc = hdr->crc;
+    hdr->crc = 0;
+    if (ota_fec_crc32(ota_fec_crc32(0, hdr, OTA_FEC_HDR_LEN), pkt + OTA_FEC_HDR_LEN, hdr->len) != crc)
+    {
+        return -1;
+    }
+    hdr->crc = crc;
+    return 0;
+}
+
+static unsigned int fec_seal(ota_fec_hdr_t *hdr, unsigned char *pkt)
+{
+    hdr->magic = OTA_FEC_MAGIC;
+    hdr->crc = 0;
+    hdr->crc = ota_fec_crc32(ota_fec_crc32(0, hdr, OTA_FEC_HDR_LEN), pkt + OTA_FEC_HDR_LEN, hdr->len);
+    memcpy(pkt, hdr, OTA_FEC_HDR_LEN);
+    return OTA_FEC_HDR_LEN + hdr->len;
+}
+
+void ota_fec_tx_init(ota_fec_tx_t *tx, const unsigned char *image, unsigned int image_len,
+                     unsigned int block_size, unsigned int k, unsigned int r)
+{
+    gf_init();
+    tx->image = image;
+    tx->image_len = image_len;
+    tx->session = ota_fec_crc32(0, image, image_len);
+    tx->block_size = block_size;
+    tx->k = k;
+    tx->r = r;
+    tx->blocks = fec_blocks(image_len, block_size);
+    tx->groups = (tx->blocks + k - 1) / k;
+}
+
+unsigned int ota_fec_encode(const ota_fec_tx_t *tx, int type, unsigned int index, unsigned int row, unsigned char *pkt)
+{
+    unsigned char *payload = pkt + OTA_FEC_HDR_LEN;
+    unsigned int j, block;
+    ota_fec_hdr_t hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.session = tx->session;
+    hdr.image_len = tx->image_len;
+    hdr.block_size = tx->block_size;
+    hdr.k = tx->k;
+    hdr.r = tx->r;
+    hdr.index = index;
+    hdr.type = type;
+    hdr.row = row;
+
+    if (type == OTA_FEC_DATA)
+    {
+        hdr.len = fec_block_len(tx->image_len, tx->block_size, index);
+        memcpy(payload, tx->image + index * tx->block_size, hdr.len);
+    }
+    else
+    {
+        /* blocks past the end of the image count as zeros */
+        hdr.len = tx->block_size;
+        memset(payload, 0, tx->block_size);
+        for (j = 0; j < fec_group_len(tx->blocks, tx->k, index); j++)
+        {
+            block = index * tx->k + j;
+            gf_mul_add(payload, tx->image + block * tx->block_size, fec_coef(tx->k, row, j),
+                       fec_block_len(tx->image_len, tx->block_size, block));
+        }
+    }
+
+    return fec_seal(&hdr, pkt);
+}
+
+unsigned int ota_fec_rx_mem(const ota_fec_hdr_t *hdr)
+{
+    unsigned int blocks;
+
+    if (hdr->block_size < OTA_FEC_MIN_BLOCK || hdr->block_size > OTA_FEC_MAX_BLOCK ||
+        hdr->k == 0 || hdr->k > OTA_FEC_MAX_K || hdr->r > OTA_FEC_MAX_R || hdr->image_len == 0)
+    {
+        return 0;
+    }
+    blocks = fec_blocks(hdr->image_len, hdr->block_size);
+    return ((blocks + 7) / 8 + 3) / 4 * 4 + hdr->block_size + OTA_FEC_SLOTS * hdr->r * hdr->block_size;
+}
+
+void ota_fec_rx_init(ota_fec_rx_t *rx, const ota_fec_hdr_t *hdr, void *mem, ota_fec_write_fn write, void *arg)
+{
+    unsigned char *p = mem;
+    int i;
+
+    gf_init();
+    memset(rx, 0, sizeof(*rx));
+    rx->session = hdr->session;
+    rx->image_len = hdr->image_len;
+    rx->block_size = hdr->block_size;
+    rx->k = hdr->k;
+    rx->r = hdr->r;
+    rx->blocks = fec_blocks(hdr->image_len, hdr->block_size);
+    rx->groups = (rx->blocks + rx->k - 1) / rx->k;
+    rx->write = write;
+    rx->arg = arg;
+
+    rx->bitmap = p;
+    memset(p, 0, (rx->blocks + 7) / 8);
+    p += ((rx->blocks + 7) / 8 + 3) / 4 * 4;
+    rx->scratch = p;
+    p += rx->block_size;
+    for (i = 0; i < OTA_FEC_SLOTS; i++)
+    {
+        rx->slot[i].acc = p;
+        p += rx->r * rx->block_size;
+    }
+}
+
+static int fec_held(ota_fec_rx_t *rx, unsigned int block)
+{
+    return rx->bitmap[block / 8] & (1 << (block % 8));
+}
+
+static void fec_hold(ota_fec_rx_t *rx, unsigned int block)
+{
+    rx->bitmap[block / 8] |= 1 << (block % 8);
+    rx->held++;
+}
+
+static unsigned int fec_group_held(ota_fec_rx_t *rx, unsigned int group)
+{
+    unsigned int j, n = 0;
+
+    for (j = 0; j < fec_group_len(rx->blocks, rx->k, group); j++)
+    {
+        n += fec_held(rx, group * rx->k + j) ? 1 : 0;
+    }
+    return n;
+}
+
+static unsigned int fec_bits(unsigned int x)
+{
+    unsigned int n = 0;
+
+    for (; x; x &= x - 1)
+    {
+        n++;
+    }
+    return n;
+}
+
+static ota_fec_slot_t *fec_slot_find(ota_fec_rx_t *rx, unsigned int group)
+{
+    int i;
+
+    for (i = 0; i < OTA_FEC_SLOTS; i++)
+    {
+        if (rx->slot[i].group == group + 1)
+        {
+            rx->slot[i].used = ++rx->lru;
+            return &rx->slot[i];
+        }
+    }
+    return NULL;
+}
+
+/* a free slot, else the least recently used one whose group then has to do without repair */
+static ota_fec_slot_t *fec_slot_get(ota_fec_rx_t *rx, unsigned int group)
+{
+    ota_fec_slot_t *slot = fec_slot_find(rx, group);
+    int i;
+
+    if (slot != NULL)
+    {
+        return slot;
+    }
+    slot = &rx->slot[0];
+    for (i = 1; i < OTA_FEC_SLOTS && slot->group; i++)
+    {
+        if (!rx->slot[i].group || rx->slot[i].used < slot->used)
+        {
+            slot = &rx->slot[i];
+        }
+    }
+    slot->group = group + 1;
+    slot->have = 0;
+    slot->rows = 0;
+    slot->used = ++rx->lru;
+    /* blocks held from before are not in acc, repair would rebuild garbage */
+    slot->fec = (fec_group_held(rx, group) == 0);
+    memset(slot->acc, 0, rx->r * rx->block_size);
+    return slot;
+}
+
+/* enough of the group is in: rebuild the missing blocks, then let go of the slot */
+static int fec_slot_settle(ota_fec_rx_t *rx, ota_fec_slot_t *slot)
+{
+    unsigned char m[OTA_FEC_MAX_R][OTA_FEC_MAX_R], inv[OTA_FEC_MAX_R][OTA_FEC_MAX_R];
+    unsigned int miss[OTA_FEC_MAX_R], rows[OTA_FEC_MAX_R];
+    unsigned int group = slot->group - 1;
+    unsigned int n = fec_group_len(rx->blocks, rx->k, group);
+    unsigned int e, a, b, j, block, len;
+    int ret;
+
+    e = n - fec_bits(slot->have);
+    if (e == 0)
+    {
+        slot->group = 0;
+        return 0;
+    }
+    if (fec_bits(slot->rows) < e)
+    {
+        return 0;
+    }
+
+    for (j = 0, a = 0; j < n; j++)
+    {
+        if (!(slot->have & (1u << j)))
+        {
+            miss[a++] = j;
+        }
+    }
+    for (j = 0, a = 0; a < e; j++)
+    {
+        if (slot->rows & (1u << j))
+        {
+            rows[a++] = j;
+        }
+    }
+
+    /* acc[row] = sum of coef * missing block, solve for the blocks */
+    for (a = 0; a < e; a++)
+    {
+        for (b = 0; b < e; b++)
+        {
+            m[a][b] = fec_coef(rx->k, rows[a], miss[b]);
+        }
+    }
+    slot->group = 0;
+    if (gf_invert(m, inv, e) != 0)
+    {
+        return 0;
+    }
+
+    for (b = 0; b < e; b++)
+    {
+        memset(rx->scratch, 0, rx->block_size);
+        for (a = 0; a < e; a++)
+        {
+            gf_mul_add(rx->scratch, slot->acc + rows[a] * rx->block_size, inv[b][a], rx->block_size);
+        }
+        block = group * rx->k + miss[b];
+        len = fec_block_len(rx->image_len, rx->block_size, block);
+        ret = rx->write(rx->arg, block * rx->block_size, rx->scratch, len);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        if (ret > 0)
+        {
+            rx->rejected++;
+            return 0;
+        }
+        fec_hold(rx, block);
+        rx->recovered++;
+    }
+    return 0;
+}
+
+int ota_fec_rx_input(ota_fec_rx_t *rx, const unsigned char *pkt, unsigned int len)
+{
+    const unsigned char *payload = pkt + OTA_FEC_HDR_LEN;
+    ota_fec_slot_t *slot;
+    ota_fec_hdr_t hdr;
+    unsigned int group, j, row;
+    int ret;
+
+    if (ota_fec_check(pkt, len, &hdr) != 0 || hdr.session != rx->session || hdr.image_len != rx->image_len ||
+        hdr.block_size != rx->block_size || hdr.k != rx->k || hdr.r != rx->r)
+    {
+        return 0;
+    }
+
+    if (hdr.type == OTA_FEC_DATA)
+    {
+        if (hdr.index >= rx->blocks || hdr.len != fec_block_len(rx->image_len, rx->block_size, hdr.index))
+        {
+            return 0;
+        }
+        if (fec_held(rx, hdr.index))
+        {
+            rx->duplicates++;
+            return 0;
+        }
+        group = hdr.index / rx->k;
+        j = hdr.index % rx->k;
+        slot = rx->r ? fec_slot_get(rx, group) : NULL;
+
+        ret = rx->write(rx->arg, hdr.index * rx->block_size, payload, hdr.len);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        if (ret > 0)
+        {
+            rx->rejected++;
+            return 0;
+        }
+        fec_hold(rx, hdr.index);
+
+        if (slot != NULL)
+        {
+            if (slot->fec)
+            {
+                for (row = 0; row < rx->r; row++)
+                {
+                    gf_mul_add(slot->acc + row * rx->block_size, payload, fec_coef(rx->k, row, j), hdr.len);
+                }
+                slot->have |= 1u << j;
+                ret = fec_slot_settle(rx, slot);
+            }
+            else if (fec_group_held(rx, group) == fec_group_len(rx->blocks, rx->k, group))
+            {
+                slot->group = 0;
+            }
+        }
+    }
+    else if (hdr.type == OTA_FEC_REPAIR)
+    {
+        if (hdr.index >= rx->groups || hdr.row >= rx->r || hdr.len != rx->block_size)
+        {
+            return 0;
+        }
+        if (fec_group_held(rx, hdr.index) == fec_group_len(rx->blocks, rx->k, hdr.index))
+        {
+            rx->duplicates++;
+            return 0;
+        }
+        slot = fec_slot_get(rx, hdr.index);
+        if (!slot->fec || (slot->rows & (1u << hdr.row)))
+        {
+            return 0;
+        }
+        for (j = 0; j < rx->block_size; j++)
+        {
+            slot->acc[hdr.row * rx->block_size + j] ^= payload[j];
+        }
+        slot->rows |= 1u << hdr.row;
+        ret = fec_slot_settle(rx, slot);
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (ret < 0)
+    {
+        return ret;
+    }
+    return (rx->held == rx->blocks) ? 1 : 0;
+}
+
+unsigned int ota_fec_rx_nack(ota_fec_rx_t *rx, unsigned char *pkt, unsigned int size)
+{
+    ota_fec_range_t range;
+    ota_fec_hdr_t hdr;
+    unsigned int block = 0, n = 0, max;
+
+    max = (size - OTA_FEC_HDR_LEN) / sizeof(range);
+    max = (max > OTA_FEC_NACK_RANGES) ? OTA_FEC_NACK_RANGES : max;
+    while (block < rx->blocks && n < max)
+    {
+        if (fec_held(rx, block))
+        {
+            block++;
+            continue;
+        }
+        range.first = block;
+        while (block < rx->blocks && !fec_held(rx, block))
+        {
+            block++;
+        }
+        range.count = block - range.first;
+        memcpy(pkt + OTA_FEC_HDR_LEN + n * sizeof(range), &range, sizeof(range));
+        n++;
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.session = rx->session;
+    hdr.image_len = rx->image_len;
+    hdr.block_size = rx->block_size;
+    hdr.k = rx->k;
+    hdr.r = rx->r;
+    hdr.index = rx->blocks - rx->held;
+    hdr.type = OTA_FEC_NACK;
+    hdr.len = n * sizeof(range);
+    return fec_seal(&hdr, pkt);
+}
@@ -0,0 +1,304 @@
+/*
+ * Delta patch encoder, see ota_delta_enc.h.
+ *
+ * Matching goes the bsdiff way: exact matches of the new image in the old
+ * one are found through a hash of 8 bytes, then grown both ways for as long
+ * as more bytes agree than not, so relinked code where only addresses moved
+ * ends up as long add runs of mostly zero differences. The record stream is
+ * then squeezed with a plain greedy LZ77 within the device window.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "ota_delta.h"
+#include "ota_delta_enc.h"
+
+#define HASH_BITS       18
+#define HASH_SIZE       (1 << HASH_BITS)
+#define MATCH_CHAIN     64
+#define MATCH_MIN       12          /* shortest exact match worth a record */
+#define GROW_GIVEUP     256         /* stop growing after this many bytes without gain */
+#define LZ_HASH_BITS    16
+#define LZ_CHAIN        48
+#define LZ_MAX_MATCH    65536
+
+typedef struct {
+    unsigned char *data;
+    unsigned int  len;
+    unsigned int  size;
+    int           oom;
+} buf_t;
+
+static void buf_put(buf_t *b, const void *data, unsigned int len)
+{
+    unsigned char *p;
+
+    if (b->oom) {
+        return;
+    }
+    if (b->len + len > b->size) {
+        b->size = (b->len + len) * 2 + 4096;
+        p = realloc(b->data, b->size);
+        if (p == NULL) {
+            b->oom = 1;
+            return;
+        }
+        b->data = p;
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static void buf_byte(buf_t *b, unsigned char c)
+{
+    buf_put(b, &c, 1);
+}
+
+static void buf_varint(buf_t *b, unsigned int v)
+{
+    while (v >= 0x80) {
+        buf_byte(b, (v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    buf_byte(b, v);
+}
+
+static unsigned int hash8(const unsigned char *p)
+{
+    unsigned long long v;
+
+    memcpy(&v, p, 8);
+    return (unsigned int)((v * 0x9E3779B97F4A7C15ull) >> (64 - HASH_BITS));
+}
+
+static unsigned int hash4(const unsigned char *p)
+{
+    unsigned int v;
+
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned int match_len(const unsigned char *a, const unsigned char *b, unsigned int max)
+{
+    unsigned int n = 0;
+
+    while (n < max && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+/* add new[ns..ns+add) over old[os..], copy new[cs..cs+copy) as is, then seek */
+static void put_record(buf_t *rec, const unsigned char *old, const unsigned char *new,
+                       unsigned int ns, unsigned int os, unsigned int add,
+                       unsigned int cs, unsigned int copy, int seek)
+{
+    unsigned int i;
+
+    buf_varint(rec, add);
+    buf_varint(rec, copy);
+    buf_varint(rec, ((unsigned int)seek << 1) ^ (unsigned int)(seek >> 31));
+    for (i = 0; i < add; i++) {
+        buf_byte(rec, (unsigned char)(new[ns + i] - old[os + i]));
+    }
+    buf_put(rec, new + cs, copy);
+}
+
+static int make_records(buf_t *rec, const unsigned char *old, unsigned int old_len,
+                        const unsigned char *new, unsigned int new_len)
+{
+    unsigned int *head, *prev;
+    unsigned int i, j, k, c, len, best, best_j, gap;
+    unsigned int pns = 0, pos_ = 0, plen = 0;      /* add part of the record being built */
+    long long off = 0;
+    int s, sb, lenb, sf, lenf;
+
+    head = malloc(HASH_SIZE * sizeof(*head));
+    prev = malloc((old_len + 1) * sizeof(*prev));
+    if (head == NULL || prev == NULL) {
+        free(head);
+        free(prev);
+        return -1;
+    }
+    memset(head, 0xff, HASH_SIZE * sizeof(*head));
+    for (j = 0; j + 8 <= old_len; j++) {
+        k = hash8(old + j);
+        prev[j] = head[k];
+        head[k] = j;
+    }
+
+    i = 0;
+    while (i + 8 <= new_len) {
+        best = 0;
+        best_j = 0;
+
+        /* where the last match would carry on first, code tends to move in one piece */
+        if (off + i >= 0 && off + i < old_len) {
+            j = (unsigned int)(off + i);
+            len = match_len(old + j, new + i, (old_len - j < new_len - i) ? old_len - j : new_len - i);
+            if (len >= 8) {
+                best = len;
+                best_j = j;
+            }
+        }
+        for (j = head[hash8(new + i)], c = 0; j != 0xffffffff && c < MATCH_CHAIN; j = prev[j], c++) {
+            len = match_len(old + j, new + i, (old_len - j < new_len - i) ? old_len - j : new_len - i);
+            if (len > best) {
+                best = len;
+                best_j = j;
+            }
+        }
+        if (best < MATCH_MIN && !(best >= 8 && best_j == off + i)) {
+            i++;
+            continue;
+        }
+
+        /* grow back into the bytes no match covered yet */
+        gap = pns + plen;
+        for (k = 1, s = 0, sb = 0, lenb = 0; i - k + 1 > gap && k <= best_j; k++) {
+            s += (old[best_j - k] == new[i - k]);
+            if (s * 2 - (int)k > sb * 2 - lenb) {
+                sb = s;
+                lenb = k;
+            }
+            if ((int)k - lenb > GROW_GIVEUP) {
+                break;
+            }
+        }
+
+        /* and forward past the exact part */
+        for (k = best, s = best, sf = best, lenf = best; i + k < new_len && best_j + k < old_len; k++) {
+            s += (old[best_j + k] == new[i + k]);
+            if (s * 2 - (int)(k + 1) > sf * 2 - lenf) {
+                sf = s;
+                lenf = k + 1;
+            }
+            if ((int)(k + 1) - lenf > GROW_GIVEUP) {
+                break;
+            }
+        }
+
+        put_record(rec, old, new, pns, pos_, plen, gap, i - lenb - gap,
+                   (int)((long long)(best_j - lenb) - (pos_ + plen)));
+        pns = i - lenb;
+        pos_ = best_j - lenb;
+        plen = lenb + lenf;
+        off = (long long)pos_ - pns;
+        i = pns + plen;
+    }
+
+    put_record(rec, old, new, pns, pos_, plen, pns + plen, new_len - pns - plen, 0);
+    free(head);
+    free(prev);
+    return rec->oom ? -1 : 0;
+}
+
+static void lz_len(buf_t *out, unsigned int v)
+{
+    while (v >= 255) {
+        buf_byte(out, 255);
+        v -= 255;
+    }
+    buf_byte(out, v);
+}
+
+static void lz_sequence(buf_t *out, const unsigned char *lit, unsigned int nlit, unsigned int off, unsigned int mlen)
+{
+    unsigned int m = mlen ? mlen - OTA_DELTA_MIN_MATCH : 0;
+
+    buf_byte(out, ((nlit < 15 ? nlit : 15) << 4) | (m < 15 ? m : 15));
+    if (nlit >= 15) {
+        lz_len(out, nlit - 15);
+    }
+    buf_put(out, lit, nlit);
+    buf_byte(out, off & 0xff);
+    buf_byte(out, off >> 8);
+    if (off && m >= 15) {
+        lz_len(out, m - 15);
+    }
+}
+
+static int lz_compress(buf_t *out, const unsigned char *in, unsigned int len, unsigned int window)
+{
+    unsigned int *head, *prev;
+    unsigned int pos = 0, lit = 0, j, c, n, best, best_off, max, h;
+
+    head = malloc((1 << LZ_HASH_BITS) * sizeof(*head));
+    prev = malloc((len + 1) * sizeof(*prev));
+    if (head == NULL || prev == NULL) {
+        free(head);
+        free(prev);
+        return -1;
+    }
+    memset(head, 0xff, (1 << LZ_HASH_BITS) * sizeof(*head));
+
+    while (pos + OTA_DELTA_MIN_MATCH <= len) {
+        h = hash4(in + pos);
+        best = 0;
+        best_off = 0;
+        max = len - pos;
+        max = (max > LZ_MAX_MATCH) ? LZ_MAX_MATCH : max;
+        for (j = head[h], c = 0; j != 0xffffffff && pos - j <= window && c < LZ_CHAIN; j = prev[j], c++) {
+            n = match_len(in + j, in + pos, max);
+            if (n > best) {
+                best = n;
+                best_off = pos - j;
+                if (n == max) {
+                    break;
+                }
+            }
+        }
+        if (best < OTA_DELTA_MIN_MATCH) {
+            prev[pos] = head[h];
+            head[h] = pos;
+            pos++;
+            continue;
+        }
+        lz_sequence(out, in + lit, pos - lit, best_off, best);
+        for (n = 0; n < best && pos + OTA_DELTA_MIN_MATCH <= len; n++, pos++) {
+            h = hash4(in + pos);
+            prev[pos] = head[h];
+            head[h] = pos;
+        }
+        pos += best - n;
+        lit = pos;
+    }
+    lz_sequence(out, in + lit, len - lit, 0, 0);
+
+    free(head);
+    free(prev);
+    return out->oom ? -1 : 0;
+}
+
+unsigned char *ota_delta_encode(const unsigned char *old, unsigned int old_len,
+                                const unsigned char *new, unsigned int new_len,
+                                unsigned int window, unsigned int *patch_len)
+{
+    buf_t rec = { 0 }, out = { 0 };
+    ota_delta_head_t head;
+
+    if (window == 0 || window > 65535) {
+        return NULL;
+    }
+    head.magic = OTA_DELTA_MAGIC;
+    head.old_size = old_len;
+    head.old_crc = ota_delta_crc32(0, old, old_len);
+    head.new_size = new_len;
+    head.new_crc = ota_delta_crc32(0, new, new_len);
+    head.patch_crc = 0;
+    head.window = window;
+    head.flags = 0;
+    buf_put(&out, &head, sizeof(head));
+
+    if (make_records(&rec, old, old_len, new, new_len) != 0 ||
+        lz_compress(&out, rec.data, rec.len, window) != 0) {
+        free(rec.data);
+        free(out.data);
+        return NULL;
+    }
+    free(rec.data);
+    head.patch_crc = ota_delta_crc32(0, out.data + sizeof(head), out.len - sizeof(head));
+    memcpy(out.data, &head, sizeof(head));
+    *patch_len = out.len;
+    return out.data;
+}
@@ -0,0 +1,14 @@
+#ifndef __OTA_DELTA_ENC_H__
+#define __OTA_DELTA_ENC_H__
+
+/*
+ * Host side encoder of the patches ota_delta.c applies (format in
+ * include/ota/ota_delta.h). Returns a malloc'ed patch, its length in
+ * <patch_len>, NULL when out of memory. <window> is the lz window the
+ * device will have, at most OTA_DELTA_WINDOW of its build.
+ */
+unsigned char *ota_delta_encode(const unsigned char *old, unsigned int old_len,
+                                const unsigned char *new, unsigned int new_len,
+                                unsigned int window, unsigned int *patch_len);
+
+#endif
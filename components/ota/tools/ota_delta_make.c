@@ -0,0 +1,185 @@
+/*
+ * Build delta patches and delta OTA packages for CONFIG_OTA_DELTA devices
+ * (see include/ota/ota_delta.h).
+ *
+ *   gcc -O2 -I../../../include/ota -o ota_delta_make ota_delta_make.c ota_delta_enc.c ../ota_delta.c
+ *
+ *   ota_delta_make [-w window] patch <old.bin> <new.bin> <patch.bin>
+ *   ota_delta_make [-w window] [-b boot.bin] [-s ver] [-d ver]
+ *                  pkg <oldA.bin> <oldB.bin> <newA.bin> <newB.bin> <package.bin>
+ *
+ * A package is for AB layouts: the device rebuilds the image of the slot
+ * it does not run from the one it runs, so it carries one patch making
+ * newA from oldB (for devices running B) and one making newB from oldA
+ * (for devices running A), laid out like an AB package with the patches
+ * in place of the images. The images are the cpu partition contents as
+ * flashed, i.e. the ECR6600F_*_cpu_0x*.bin of each slot. -w has to fit
+ * CONFIG_OTA_DELTA_WINDOW of the devices, default 4096.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "ota_delta.h"
+#include "ota_delta_enc.h"
+
+/* same layout as ota_package_head_t in include/ota/ota.h */
+typedef struct {
+    unsigned char magic[7];
+    unsigned char version;
+    unsigned int package_size;
+    unsigned int package_crc;
+    unsigned int boot_size;
+    unsigned int firmware_size;
+    unsigned int firmware_new_size;
+    unsigned int firmware_crc;
+    unsigned int firmware_new_crc;
+    unsigned int delta_size;
+    unsigned int delta_new_size;
+    unsigned char reserved[4];
+    unsigned char source_version[32];
+    unsigned char target_version[32];
+} pkg_head_t;
+
+#define PKG_DIFF_VERSION    0x40        /* (DOWNLOAD_DIFF_METHOD * 4) << 4 */
+
+static unsigned char *load(const char *path, unsigned int *len)
+{
+    unsigned char *data;
+    FILE *f = fopen(path, "rb");
+    long n;
+
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(n ? n : 1);
+    if (data == NULL || fread(data, 1, n, f) != (size_t)n) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        free(data);
+        return NULL;
+    }
+    fclose(f);
+    *len = n;
+    return data;
+}
+
+static unsigned char *diff(const char *old_path, const char *new_path, unsigned int window,
+                           unsigned int *patch_len, unsigned int *new_len, unsigned int *new_crc)
+{
+    unsigned char *old, *new, *patch = NULL;
+    unsigned int old_len;
+
+    old = load(old_path, &old_len);
+    new = load(new_path, new_len);
+    if (old && new) {
+        patch = ota_delta_encode(old, old_len, new, *new_len, window, patch_len);
+        *new_crc = ota_delta_crc32(0, new, *new_len);
+        if (patch) {
+            printf("%s -> %s: %u bytes, patch %u (%.1f%%)\n", old_path, new_path,
+                   *new_len, *patch_len, *new_len ? 100.0 * *patch_len / *new_len : 0.0);
+        }
+    }
+    free(old);
+    free(new);
+    return patch;
+}
+
+static int save(const char *path, const void *data, unsigned int len)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL || fwrite(data, 1, len, f) != len) {
+        perror(path);
+        if (f) {
+            fclose(f);
+        }
+        return -1;
+    }
+    return fclose(f);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "ota_delta_make [-w window] patch <old.bin> <new.bin> <patch.bin>\n"
+                    "ota_delta_make [-w window] [-b boot.bin] [-s ver] [-d ver] "
+                    "pkg <oldA.bin> <oldB.bin> <newA.bin> <newB.bin> <package.bin>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char *patch_a, *patch_b, *boot = NULL, *pkg;
+    unsigned int window = 4096, len, len_a, len_b, boot_len = 0, new_a, new_b, crc_a, crc_b;
+    const char *boot_path = NULL, *src = "", *dst = "";
+    pkg_head_t head;
+    int i;
+
+    for (i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-w")) {
+            window = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "-b")) {
+            boot_path = argv[i + 1];
+        } else if (!strcmp(argv[i], "-s")) {
+            src = argv[i + 1];
+        } else if (!strcmp(argv[i], "-d")) {
+            dst = argv[i + 1];
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (window == 0 || window > 65535) {
+        fprintf(stderr, "window 1..65535\n");
+        return 1;
+    }
+
+    if (argc - i == 4 && !strcmp(argv[i], "patch")) {
+        patch_a = diff(argv[i + 1], argv[i + 2], window, &len, &new_a, &crc_a);
+        return (patch_a && save(argv[i + 3], patch_a, len) == 0) ? 0 : 1;
+    }
+    if (argc - i != 6 || strcmp(argv[i], "pkg")) {
+        usage();
+        return 1;
+    }
+
+    patch_a = diff(argv[i + 2], argv[i + 3], window, &len_a, &new_a, &crc_a);
+    patch_b = diff(argv[i + 1], argv[i + 4], window, &len_b, &new_b, &crc_b);
+    if (boot_path) {
+        boot = load(boot_path, &boot_len);
+    }
+    if (patch_a == NULL || patch_b == NULL || (boot_path && boot == NULL)) {
+        return 1;
+    }
+
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, "FotaPKG", 7);
+    head.version = PKG_DIFF_VERSION;
+    head.package_size = sizeof(head) + boot_len + len_a + len_b;
+    head.boot_size = boot_len;
+    head.firmware_size = new_a;
+    head.firmware_crc = crc_a;
+    head.firmware_new_size = new_b;
+    head.firmware_new_crc = crc_b;
+    head.delta_size = len_a;
+    head.delta_new_size = len_b;
+    strncpy((char *)head.source_version, src, sizeof(head.source_version) - 1);
+    strncpy((char *)head.target_version, dst, sizeof(head.target_version) - 1);
+
+    pkg = malloc(head.package_size);
+    if (pkg == NULL) {
+        return 1;
+    }
+    memcpy(pkg + sizeof(head), boot, boot_len);
+    memcpy(pkg + sizeof(head) + boot_len, patch_a, len_a);
+    memcpy(pkg + sizeof(head) + boot_len + len_a, patch_b, len_b);
+    memcpy(pkg, &head, sizeof(head));
+    head.package_crc = ota_delta_crc32(0, pkg + offsetof(pkg_head_t, boot_size),
+                                       head.package_size - offsetof(pkg_head_t, boot_size));
+    memcpy(pkg, &head, sizeof(head));
+    printf("package %u bytes, A %u + B %u of %u + %u\n", head.package_size, len_a, len_b, new_a, new_b);
+    return save(argv[i + 5], pkg, head.package_size) ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Round trip test of the delta patch encoder against the device decoder
+ * (include/ota/ota_delta.h): code-like images are changed the way a
+ * rebuild changes them, patched and rebuilt with the patch fed in pieces
+ * of random size, then broken patches and wrong old images have to be
+ * turned down without writing past the new image.
+ *
+ *   gcc -O2 -I../../../include/ota -o ota_delta_test ota_delta_test.c ota_delta_enc.c ../ota_delta.c
+ *   ota_delta_test [seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ota_delta.h"
+#include "ota_delta_enc.h"
+
+#define BASE    0x40800000u
+
+typedef struct {
+    const unsigned char *old;
+    unsigned int        old_len;
+    unsigned char       *out;
+    unsigned int        out_len;
+    unsigned int        out_size;
+    int                 overrun;
+} io_t;
+
+static int io_read(void *arg, unsigned int offset, unsigned char *buf, unsigned int len)
+{
+    io_t *io = arg;
+
+    if (offset > io->old_len || len > io->old_len - offset) {
+        return -1;
+    }
+    memcpy(buf, io->old + offset, len);
+    return 0;
+}
+
+static int io_write(void *arg, const unsigned char *data, unsigned int len)
+{
+    io_t *io = arg;
+
+    if (len > io->out_size - io->out_len) {
+        io->overrun = 1;
+        return -1;
+    }
+    memcpy(io->out + io->out_len, data, len);
+    io->out_len += len;
+    return 0;
+}
+
+/* words of a few opcodes, addresses into the image and some text */
+static unsigned char *make_image(unsigned int len)
+{
+    static const char *text = "ota: download %d%% done, partition %s not valid\n";
+    unsigned char *p = malloc(len);
+    unsigned int i, w;
+
+    for (i = 0; i + 4 <= len; i += 4) {
+        switch (rand() % 8) {
+        case 0:
+        case 1:
+            w = BASE + (rand() % len & ~3u);
+            break;
+        case 2:
+            w = 0;
+            break;
+        case 3:
+            memcpy(&w, text + (i / 4 % 12) * 4, 4);
+            break;
+        default:
+            w = 0x46000000u | (rand() % 64) << 16 | (rand() % 4) << 8;
+            break;
+        }
+        memcpy(p + i, &w, 4);
+    }
+    for (; i < len; i++) {
+        p[i] = rand();
+    }
+    return p;
+}
+
+/* a rebuild: code added and dropped, addresses behind it moved, a few bytes changed */
+static unsigned char *rebuild(const unsigned char *old, unsigned int old_len, unsigned int *new_len)
+{
+    unsigned int ins_at = (old_len / 3) & ~3u, ins = 2048, del_at = (old_len * 2 / 3) & ~3u, del = 1024;
+    unsigned int len = old_len + ins - del, i, w;
+    unsigned char *p = malloc(len), *add = make_image(ins);
+
+    memcpy(p, old, ins_at);
+    memcpy(p + ins_at, add, ins);
+    memcpy(p + ins_at + ins, old + ins_at, del_at - ins_at);
+    memcpy(p + del_at + ins, old + del_at + del, old_len - del_at - del);
+    for (i = 0; i + 4 <= len; i += 4) {
+        memcpy(&w, p + i, 4);
+        if (w >= BASE + ins_at && w < BASE + old_len) {
+            w += (w >= BASE + del_at + del) ? ins - del : ins;
+            memcpy(p + i, &w, 4);
+        }
+    }
+    for (i = 0; i < 64; i++) {
+        p[rand() % len] ^= 1 + rand() % 255;
+    }
+    free(add);
+    *new_len = len;
+    return p;
+}
+
+/* 0 or the first error, fed in pieces of 1..max bytes */
+static int apply(const unsigned char *old, unsigned int old_len, const unsigned char *patch, unsigned int patch_len,
+                 unsigned char *out, unsigned int out_size, unsigned int max, io_t *io)
+{
+    static ota_delta_t d;
+    unsigned int pos, n;
+    int ret = 0;
+
+    memset(io, 0, sizeof(*io));
+    io->old = old;
+    io->old_len = old_len;
+    io->out = out;
+    io->out_size = out_size;
+    ota_delta_init(&d, io_read, io_write, io);
+    for (pos = 0; pos < patch_len && ret == 0; pos += n) {
+        n = 1 + rand() % max;
+        n = (n > patch_len - pos) ? patch_len - pos : n;
+        ret = ota_delta_input(&d, patch + pos, n);
+    }
+    return ret ? ret : ota_delta_finish(&d);
+}
+
+static int round_trip(const char *name, const unsigned char *old, unsigned int old_len,
+                      const unsigned char *new, unsigned int new_len, unsigned int window)
+{
+    unsigned int patch_len, i;
+    unsigned char *patch = ota_delta_encode(old, old_len, new, new_len, window, &patch_len);
+    unsigned char *out = malloc(new_len + 1);
+    int ret, fail = 0;
+    io_t io;
+
+    if (patch == NULL) {
+        printf("  %s: encode failed\n", name);
+        return -1;
+    }
+
+    ret = apply(old, old_len, patch, patch_len, out, new_len, 1 + rand() % 4096, &io);
+    fail |= (ret != 0 || io.out_len != new_len || memcmp(out, new, new_len));
+    printf("  %s: %u -> %u bytes, window %u, patch %u (%.1f%%) %s\n", name, old_len, new_len, window,
+           patch_len, 100.0 * patch_len / (new_len ? new_len : 1), fail ? "FAIL" : "ok");
+
+    /* byte by byte too, every state boundary gets crossed */
+    if (patch_len < 20000) {
+        ret = apply(old, old_len, patch, patch_len, out, new_len, 1, &io);
+        fail |= (ret != 0 || memcmp(out, new, new_len));
+    }
+
+    /* cut short: never done */
+    ret = apply(old, old_len, patch, patch_len - 1 - rand() % (patch_len / 2), out, new_len, 512, &io);
+    fail |= (ret == 0);
+
+    /* any byte broken: turned down, nothing past the end */
+    for (i = 0; i < 32; i++) {
+        unsigned int at = sizeof(ota_delta_head_t) + rand() % (patch_len - sizeof(ota_delta_head_t));
+        unsigned char was = patch[at];
+
+        patch[at] ^= 1 << (rand() % 8);
+        ret = apply(old, old_len, patch, patch_len, out, new_len, 512, &io);
+        if (ret == 0 || io.overrun) {
+            printf("  %s: broken byte at %u %s\n", name, at, io.overrun ? "overran" : "went through");
+            fail = 1;
+        }
+        patch[at] = was;
+    }
+
+    free(patch);
+    free(out);
+    return fail ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int old_len = 300000, new_len, patch_len;
+    unsigned char *old, *new, *other, *patch, *out;
+    int fail = 0, ret;
+    io_t io;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    printf("decoder state %u bytes, window %u\n", (unsigned int)sizeof(ota_delta_t), OTA_DELTA_WINDOW);
+    fail |= (sizeof(ota_delta_t) + 4096 >= 16 * 1024);      /* with the flash sector buffer */
+
+    old = make_image(old_len);
+    new = rebuild(old, old_len, &new_len);
+    other = make_image(new_len);
+    out = malloc(new_len);
+
+    fail |= round_trip("rebuild", old, old_len, new, new_len, OTA_DELTA_WINDOW);
+    fail |= round_trip("rebuild small window", old, old_len, new, new_len, 1024);
+    fail |= round_trip("same", old, old_len, old, old_len, OTA_DELTA_WINDOW);
+    fail |= round_trip("unrelated", old, old_len, other, new_len, OTA_DELTA_WINDOW);
+    fail |= round_trip("from nothing", old, 0, new, new_len, OTA_DELTA_WINDOW);
+    fail |= round_trip("to nothing", old, old_len, new, 0, OTA_DELTA_WINDOW);
+
+    /* the wrong old image is found before a byte is written */
+    patch = ota_delta_encode(old, old_len, new, new_len, OTA_DELTA_WINDOW, &patch_len);
+    old[old_len / 2] ^= 0x10;
+    ret = apply(old, old_len, patch, patch_len, out, new_len, 4096, &io);
+    printf("  wrong old image: %d, %u bytes written %s\n", ret, io.out_len,
+           ret == OTA_DELTA_ERR_BASE && io.out_len == 0 ? "ok" : "FAIL");
+    fail |= (ret != OTA_DELTA_ERR_BASE || io.out_len != 0);
+    old[old_len / 2] ^= 0x10;
+    free(patch);
+
+    /* a window larger than the device has */
+    patch = ota_delta_encode(old, old_len, new, new_len, OTA_DELTA_WINDOW * 2, &patch_len);
+    ret = apply(old, old_len, patch, patch_len, out, new_len, 4096, &io);
+    printf("  window %u on a %u device: %d %s\n", OTA_DELTA_WINDOW * 2, OTA_DELTA_WINDOW, ret,
+           ret == OTA_DELTA_ERR_PATCH ? "ok" : "FAIL");
+    fail |= (ret != OTA_DELTA_ERR_PATCH);
+    free(patch);
+
+    free(old);
+    free(new);
+    free(other);
+    free(out);
+    printf("ota delta %s\n", fail ? "FAIL" : "pass");
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+/*
+ * Stream an OTA package to a fleet running local_ota with
+ * CONFIG_OTA_LOCAL_MCAST (see include/ota/ota_fec.h).
+ *
+ *   gcc -O2 -I../../../include/ota -o ota_mcast_send ota_mcast_send.c ../ota_fec.c
+ *   ota_mcast_send [options] <package.bin>
+ *
+ *   -s <ver>       version the devices run, e.g. 1.0.3 (required)
+ *   -d <ver>       version of the package (required)
+ *   -g <group>     multicast group, default 239.255.66.1
+ *   -p <port>      data port, default 5310
+ *   -i <ip>        local interface address for multicast
+ *   -b <bytes>     block size, default 1024
+ *   -k <n> -r <n>  data and repair blocks per group, default 16 and 4
+ *   -n <passes>    passes of the carousel, default 2
+ *   -t <us>        gap between packets, default 1500
+ *   -w <s>         announcements before streaming, default 6
+ *   -l <s>         keep answering NACKs for this long after the last one, default 15
+ *   -f <len:crc>   firmware length and crc the devices must run, default none
+ *
+ * The announcement is the local_ota broadcast to port 5300 with the url
+ * "mcast://<group>:<port>"; devices start after LOCAL_OTA_REPORT_CNT of
+ * them and report back on port 5301. Missing blocks are sent back unicast
+ * to whoever NACKs them. The head block is repeated now and then since a
+ * device can not place any block before it has the package head.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "ota_fec.h"
+
+#define ANNOUNCE_PORT   5300
+#define REPORT_PORT     5301
+#define VERSION_NUM     6
+#define HEAD_EVERY      8       /* groups between copies of block 0 */
+#define PKT_LEN         (sizeof(ota_fec_hdr_t) + OTA_FEC_MAX_BLOCK)
+
+static const unsigned char crc8_table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+
+static int sock, report_sock;
+static ota_fec_tx_t tx;
+static struct sockaddr_in group_addr;
+static unsigned int gap_us = 1500;
+static unsigned long data_pkts, repair_pkts, nack_pkts, resent_pkts;
+
+/* same as ef_calc_crc8 on the device */
+static unsigned char crc8(const unsigned char *p, unsigned int len)
+{
+    unsigned char crc = 0;
+
+    while (len--) {
+        crc = crc8_table[crc ^ *p++];
+    }
+    return crc;
+}
+
+/* "1.0.3" -> digits last to first, as local_ota_version_register does */
+static int version_parse(const char *s, unsigned char *ver)
+{
+    int i, j = 0;
+
+    memset(ver, 0, VERSION_NUM);
+    for (i = 0; s[i] && i < VERSION_NUM; i++) {
+        if (s[i] == '.') {
+            continue;
+        }
+        if (s[i] < '0' || s[i] > '9') {
+            return -1;
+        }
+        ver[VERSION_NUM - ++j] = s[i] - '0';
+    }
+    return 0;
+}
+
+static void announce(const unsigned char *src, const unsigned char *dst, unsigned int fm_len, unsigned int fm_crc)
+{
+    struct sockaddr_in to;
+    unsigned char buf[256];
+    char url[64];
+    unsigned int n = 0;
+
+    snprintf(url, sizeof(url), "mcast://%s:%u/", inet_ntoa(group_addr.sin_addr), ntohs(group_addr.sin_port));
+    buf[n++] = 0x01;    /* OTA_PACKET_BROADCAST */
+    buf[n++] = strlen(url);
+    memcpy(buf + n, url, strlen(url));
+    n += strlen(url);
+    memcpy(buf + n, src, VERSION_NUM);
+    n += VERSION_NUM;
+    memcpy(buf + n, dst, VERSION_NUM);
+    n += VERSION_NUM;
+    memcpy(buf + n, &fm_len, 4);
+    n += 4;
+    memcpy(buf + n, &fm_crc, 4);
+    n += 4;
+    buf[n] = crc8(buf, n);
+    n++;
+
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+    to.sin_port = htons(ANNOUNCE_PORT);
+    sendto(sock, buf, n, 0, (struct sockaddr *)&to, sizeof(to));
+}
+
+/* device reports: type, mac, ip, version, action, crc8 */
+static void reports(void)
+{
+    static const char *actions[] = { "up to date", "updating", "illegal", "failed" };
+    unsigned char buf[64];
+    int len;
+
+    while ((len = recv(report_sock, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+        if (len != 19 || buf[0] != 0x10 || crc8(buf, len - 1) != buf[len - 1]) {
+            continue;
+        }
+        printf("%02x:%02x:%02x:%02x:%02x:%02x %u.%u.%u.%u %s\n", buf[1], buf[2], buf[3], buf[4], buf[5], buf[6],
+               buf[7], buf[8], buf[9], buf[10], buf[17] < 4 ? actions[buf[17]] : "?");
+    }
+}
+
+static void send_pkt(const unsigned char *pkt, unsigned int len, const struct sockaddr_in *to)
+{
+    sendto(sock, pkt, len, 0, (const struct sockaddr *)to, sizeof(*to));
+    usleep(gap_us);
+}
+
+/* answer NACKs queued so far, waiting up to <ms> for the first; 1 if there was one */
+static int serve_nacks(int ms)
+{
+    unsigned char pkt[PKT_LEN], out[PKT_LEN];
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    struct pollfd pfd = { sock, POLLIN, 0 };
+    ota_fec_range_t range;
+    ota_fec_hdr_t hdr;
+    unsigned int i, b;
+    int len, served = 0;
+
+    while (poll(&pfd, 1, served ? 0 : ms) > 0) {
+        fromlen = sizeof(from);
+        len = recvfrom(sock, pkt, sizeof(pkt), 0, (struct sockaddr *)&from, &fromlen);
+        if (len <= 0) {
+            break;
+        }
+        if (ota_fec_check(pkt, len, &hdr) != 0 || hdr.type != OTA_FEC_NACK || hdr.session != tx.session) {
+            continue;
+        }
+        served = 1;
+        nack_pkts++;
+        printf("nack from %s: %u blocks missing\n", inet_ntoa(from.sin_addr), hdr.index);
+        for (i = 0; i < hdr.len / sizeof(range); i++) {
+            memcpy(&range, pkt + sizeof(hdr) + i * sizeof(range), sizeof(range));
+            for (b = range.first; b < range.first + range.count && b < tx.blocks; b++) {
+                send_pkt(out, ota_fec_encode(&tx, OTA_FEC_DATA, b, 0, out), &from);
+                resent_pkts++;
+            }
+        }
+    }
+    return served;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s -s <ver> -d <ver> [-g group] [-p port] [-i ip] [-b block] [-k n] [-r n]\n"
+                    "       [-n passes] [-t gap_us] [-w s] [-l s] [-f len:crc] <package.bin>\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char src[VERSION_NUM], dst[VERSION_NUM], pkt[PKT_LEN];
+    unsigned int block = 1024, k = 16, r = 4, passes = 2, warmup = 6, linger = 15;
+    unsigned int fm_len = 0, fm_crc = 0, pass, g, b, i, size;
+    unsigned char *image;
+    const char *iface = NULL;
+    struct sockaddr_in local;
+    struct in_addr ifaddr;
+    unsigned char ttl = 1;
+    int opt, one = 1, have_src = 0, have_dst = 0;
+    time_t quiet;
+    FILE *f;
+
+    memset(&group_addr, 0, sizeof(group_addr));
+    group_addr.sin_family = AF_INET;
+    group_addr.sin_addr.s_addr = inet_addr("239.255.66.1");
+    group_addr.sin_port = htons(5310);
+
+    while ((opt = getopt(argc, argv, "s:d:g:p:i:b:k:r:n:t:w:l:f:")) != -1) {
+        switch (opt) {
+        case 's': have_src = !version_parse(optarg, src); break;
+        case 'd': have_dst = !version_parse(optarg, dst); break;
+        case 'g': group_addr.sin_addr.s_addr = inet_addr(optarg); break;
+        case 'p': group_addr.sin_port = htons(atoi(optarg)); break;
+        case 'i': iface = optarg; break;
+        case 'b': block = atoi(optarg); break;
+        case 'k': k = atoi(optarg); break;
+        case 'r': r = atoi(optarg); break;
+        case 'n': passes = atoi(optarg); break;
+        case 't': gap_us = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'l': linger = atoi(optarg); break;
+        case 'f':
+            if (sscanf(optarg, "%u:%x", &fm_len, &fm_crc) != 2) {
+                usage(argv[0]);
+            }
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || !have_src || !have_dst || !IN_MULTICAST(ntohl(group_addr.sin_addr.s_addr)) ||
+        block < OTA_FEC_MIN_BLOCK || block > OTA_FEC_MAX_BLOCK || k == 0 || k > OTA_FEC_MAX_K || r > OTA_FEC_MAX_R) {
+        usage(argv[0]);
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (f == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    image = malloc(size);
+    if (size == 0 || image == NULL || fread(image, 1, size, f) != size) {
+        fprintf(stderr, "cannot read %s\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+    ota_fec_tx_init(&tx, image, size, block, k, r);
+
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    report_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_port = htons(REPORT_PORT);
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one));
+    setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(report_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (iface != NULL) {
+        ifaddr.s_addr = inet_addr(iface);
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr));
+    }
+    if (bind(report_sock, (struct sockaddr *)&local, sizeof(local)) < 0) {
+        perror("report port");
+        return 1;
+    }
+
+    printf("%s: %u bytes, session %08x, %u blocks of %u, fec %u+%u, %u groups\n",
+           argv[optind], size, tx.session, tx.blocks, block, k, r, tx.groups);
+    for (i = 0; i < warmup; i++) {
+        announce(src, dst, fm_len, fm_crc);
+        reports();
+        sleep(1);
+    }
+
+    for (pass = 0; pass < passes; pass++) {
+        announce(src, dst, fm_len, fm_crc);
+        for (g = 0; g < tx.groups; g++) {
+            if (g % HEAD_EVERY == 0) {
+                send_pkt(pkt, ota_fec_encode(&tx, OTA_FEC_DATA, 0, 0, pkt), &group_addr);
+                data_pkts++;
+            }
+            for (b = g * k; b < (g + 1) * k && b < tx.blocks; b++) {
+                send_pkt(pkt, ota_fec_encode(&tx, OTA_FEC_DATA, b, 0, pkt), &group_addr);
+                data_pkts++;
+            }
+            for (i = 0; i < r; i++) {
+                send_pkt(pkt, ota_fec_encode(&tx, OTA_FEC_REPAIR, g, i, pkt), &group_addr);
+                repair_pkts++;
+            }
+            serve_nacks(0);
+        }
+        reports();
+        printf("pass %u done\n", pass + 1);
+    }
+
+    /* devices NACK once the stream goes quiet */
+    quiet = time(NULL);
+    while (time(NULL) - quiet < linger) {
+        if (serve_nacks(1000)) {
+            quiet = time(NULL);
+        }
+        reports();
+    }
+
+    printf("%lu data, %lu repair, %lu nacks answered with %lu blocks\n", data_pkts, repair_pkts, nack_pkts, resent_pkts);
+    close(sock);
+    close(report_sock);
+    free(image);
+    return 0;
+}
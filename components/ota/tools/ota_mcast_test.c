@@ -0,0 +1,262 @@
+/*
+ * Lossy loopback test of the multicast OTA carousel (include/ota/ota_fec.h):
+ * a random image is streamed over a UDP socket on 127.0.0.1 with packets
+ * dropped and reordered on purpose, the receiver rebuilds what it can from
+ * repair blocks and NACKs the rest until the image matches.
+ *
+ *   gcc -O2 -I../../../include/ota -o ota_mcast_test ota_mcast_test.c ../ota_fec.c
+ *   ota_mcast_test [seed]
+ *
+ * Like on the device, nothing but block 0 is accepted before block 0 (the
+ * package head) is in.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "ota_fec.h"
+
+#define PKT_LEN     (sizeof(ota_fec_hdr_t) + OTA_FEC_MAX_BLOCK)
+#define MAX_ROUNDS  200
+
+typedef struct {
+    unsigned char *out;
+    int           head;
+} sink_t;
+
+static int sock;
+static struct sockaddr_in self;
+static int loss;            /* percent */
+static unsigned long sent, dropped;
+static unsigned char held_pkt[PKT_LEN];
+static unsigned int held_len;
+
+/* send with loss, now and then holding a packet back to swap it with the next */
+static void lossy_send(const unsigned char *pkt, unsigned int len)
+{
+    sent++;
+    if (rand() % 100 < loss) {
+        dropped++;
+        return;
+    }
+    if (held_len == 0 && rand() % 20 == 0) {
+        memcpy(held_pkt, pkt, len);
+        held_len = len;
+        return;
+    }
+    sendto(sock, pkt, len, 0, (struct sockaddr *)&self, sizeof(self));
+    if (held_len) {
+        sendto(sock, held_pkt, held_len, 0, (struct sockaddr *)&self, sizeof(self));
+        held_len = 0;
+    }
+}
+
+static void lossy_flush(void)
+{
+    if (held_len) {
+        sendto(sock, held_pkt, held_len, 0, (struct sockaddr *)&self, sizeof(self));
+        held_len = 0;
+    }
+}
+
+static int sink_write(void *arg, unsigned int offset, const unsigned char *data, unsigned int len)
+{
+    sink_t *sink = arg;
+
+    if (!sink->head && offset != 0) {
+        return 1;
+    }
+    sink->head = 1;
+    memcpy(sink->out + offset, data, len);
+    return 0;
+}
+
+/* hand everything queued on the socket to the receiver, NACKs to <nack> */
+static int drain(ota_fec_rx_t *rx, unsigned char *nack, unsigned int *nack_len)
+{
+    unsigned char pkt[PKT_LEN];
+    ota_fec_hdr_t hdr;
+    int len;
+
+    while ((len = recv(sock, pkt, sizeof(pkt), MSG_DONTWAIT)) > 0) {
+        if (ota_fec_check(pkt, len, &hdr) == 0 && hdr.type == OTA_FEC_NACK) {
+            memcpy(nack, pkt, len);
+            *nack_len = len;
+            continue;
+        }
+        if (ota_fec_rx_input(rx, pkt, len) < 0) {
+            return -1;
+        }
+    }
+    return rx->held == rx->blocks;
+}
+
+static int run(unsigned int image_len, unsigned int block_size, unsigned int k, unsigned int r, int loss_pct)
+{
+    unsigned char pkt[PKT_LEN], nack[PKT_LEN];
+    unsigned char *image, *out, *mem;
+    unsigned int i, g, b, len, nack_len, rounds = 0;
+    ota_fec_range_t range;
+    ota_fec_tx_t tx;
+    ota_fec_rx_t rx;
+    ota_fec_hdr_t hdr;
+    sink_t sink;
+    int done = 0;
+
+    image = malloc(image_len);
+    out = malloc(image_len);
+    for (i = 0; i < image_len; i++) {
+        image[i] = (i % 7 == 0) ? 0 : rand();
+    }
+    memset(out, 0xa5, image_len);
+    loss = loss_pct;
+    sent = dropped = 0;
+
+    ota_fec_tx_init(&tx, image, image_len, block_size, k, r);
+    ota_fec_encode(&tx, OTA_FEC_DATA, 0, 0, pkt);
+    ota_fec_check(pkt, sizeof(ota_fec_hdr_t) + block_size, &hdr);
+    mem = malloc(ota_fec_rx_mem(&hdr));
+    sink.out = out;
+    sink.head = 0;
+    ota_fec_rx_init(&rx, &hdr, mem, sink_write, &sink);
+
+    /* one pass of the carousel */
+    for (g = 0; g < tx.groups && !done; g++) {
+        for (b = g * k; b < (g + 1) * k && b < tx.blocks; b++) {
+            lossy_send(pkt, ota_fec_encode(&tx, OTA_FEC_DATA, b, 0, pkt));
+        }
+        for (i = 0; i < r; i++) {
+            lossy_send(pkt, ota_fec_encode(&tx, OTA_FEC_REPAIR, g, i, pkt));
+        }
+        nack_len = 0;
+        done = drain(&rx, nack, &nack_len);
+    }
+    lossy_flush();
+    done = drain(&rx, nack, &nack_len);
+    if (done < 0) {
+        return -1;
+    }
+    printf("  %u bytes, block %u, fec %u+%u, loss %d%%: pass 1 %u/%u blocks, %u rebuilt\n",
+           image_len, block_size, k, r, loss_pct, rx.held, rx.blocks, rx.recovered);
+
+    /* the NACK itself crosses the lossy channel too */
+    while (!done && rounds++ < MAX_ROUNDS) {
+        nack_len = 0;
+        len = ota_fec_rx_nack(&rx, pkt, sizeof(pkt));
+        lossy_send(pkt, len);
+        lossy_flush();
+        done = drain(&rx, nack, &nack_len);
+        if (done || nack_len == 0) {
+            continue;
+        }
+        ota_fec_check(nack, nack_len, &hdr);
+        for (i = 0; i < hdr.len / sizeof(range); i++) {
+            memcpy(&range, nack + sizeof(hdr) + i * sizeof(range), sizeof(range));
+            for (b = range.first; b < range.first + range.count && b < tx.blocks; b++) {
+                lossy_send(pkt, ota_fec_encode(&tx, OTA_FEC_DATA, b, 0, pkt));
+                if ((b & 15) == 15) {
+                    done = drain(&rx, nack, &nack_len);
+                }
+            }
+        }
+        lossy_flush();
+        done = drain(&rx, nack, &nack_len);
+    }
+
+    printf("  %lu sent, %lu dropped, %u nack rounds, %u dup, %s\n", sent, dropped, rounds, rx.duplicates,
+           done > 0 && !memcmp(image, out, image_len) ? "ok" : "FAIL");
+    done = (done > 0 && !memcmp(image, out, image_len)) ? 0 : -1;
+    free(image);
+    free(out);
+    free(mem);
+    return done;
+}
+
+/* a Cauchy code rebuilds any r losses of a group, check all of them for a small one */
+static int exhaustive(void)
+{
+    unsigned char pkt[PKT_LEN];
+    unsigned char image[4 * 300], out[sizeof(image)], mem[8192];
+    unsigned int mask, i, k = 4, r = 2;
+    ota_fec_tx_t tx;
+    ota_fec_rx_t rx;
+    ota_fec_hdr_t hdr;
+    sink_t sink;
+    int fail = 0;
+
+    for (i = 0; i < sizeof(image); i++) {
+        image[i] = rand();
+    }
+    ota_fec_tx_init(&tx, image, sizeof(image), 300, k, r);
+    for (mask = 0; mask < (1u << (k + r)); mask++) {
+        if (__builtin_popcount(mask) > r || (mask & 1)) {
+            continue;       /* block 0 must come first, as with the package head */
+        }
+        memset(out, 0, sizeof(out));
+        sink.out = out;
+        sink.head = 0;
+        ota_fec_check(pkt, ota_fec_encode(&tx, OTA_FEC_DATA, 0, 0, pkt), &hdr);
+        if (ota_fec_rx_mem(&hdr) > sizeof(mem)) {
+            return -1;
+        }
+        ota_fec_rx_init(&rx, &hdr, mem, sink_write, &sink);
+        for (i = 0; i < k + r; i++) {
+            if (mask & (1u << i)) {
+                continue;
+            }
+            if (i < k) {
+                ota_fec_rx_input(&rx, pkt, ota_fec_encode(&tx, OTA_FEC_DATA, i, 0, pkt));
+            } else {
+                ota_fec_rx_input(&rx, pkt, ota_fec_encode(&tx, OTA_FEC_REPAIR, 0, i - k, pkt));
+            }
+        }
+        if (rx.held != rx.blocks || memcmp(image, out, sizeof(image))) {
+            printf("  erasures 0x%02x not rebuilt\n", mask);
+            fail = 1;
+        }
+    }
+    printf("  every loss of up to %u of %u+%u: %s\n", r, k, r, fail ? "FAIL" : "ok");
+    return fail ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct {
+        unsigned int len, block, k, r;
+        int loss;
+    } cases[] = {
+        { 200000, 1024, 16, 4, 0 },
+        { 200000, 1024, 16, 4, 5 },
+        { 300001, 1400, 16, 2, 10 },
+        { 150000, 512, 8, 4, 25 },
+        { 100003, 1024, 32, 8, 40 },
+        { 50000, 1024, 8, 0, 15 },
+    };
+    socklen_t len = sizeof(self);
+    int bufsize = 4 << 20;
+    unsigned int i;
+    int fail = 0;
+
+    srand(argc > 1 ? atoi(argv[1]) : 1);
+    sock = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&self, 0, sizeof(self));
+    self.sin_family = AF_INET;
+    self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    if (sock < 0 || bind(sock, (struct sockaddr *)&self, sizeof(self)) < 0 ||
+        getsockname(sock, (struct sockaddr *)&self, &len) < 0) {
+        perror("loopback socket");
+        return 1;
+    }
+
+    fail |= exhaustive();
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        fail |= run(cases[i].len, cases[i].block, cases[i].k, cases[i].r, cases[i].loss);
+    }
+    close(sock);
+    printf("ota mcast %s\n", fail ? "FAIL" : "pass");
+    return fail ? 1 : 0;
+}
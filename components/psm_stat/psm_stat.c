@@ -0,0 +1,428 @@
+/**
+ * @file psm_stat.c
+ * @brief Wake cause and sleep residency accounting, see psm_stat.h
+ */
+
+#include <string.h>
+#include "oshal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "rtc.h"
+#include "psm_system.h"
+#include "psm_stat.h"
+
+#define PSM_STAT_CAUSES         CONFIG_PSM_STAT_CAUSES
+#define PSM_STAT_MIN_SLEEP      (PSM_STAT_HZ * portTICK_PERIOD_MS / 1000)
+#define PSM_STAT_OTHERS         0xffff      /* id of the entry the rest goes to once the table is full */
+
+#define PSM_STAT_MS(cnt)        ((unsigned int)((uint64_t)(cnt) * 1000 / PSM_STAT_HZ))
+#define PSM_STAT_US(cnt)        ((unsigned int)((uint64_t)(cnt) * 15625 / 512))
+
+typedef struct {
+    unsigned char  wake;
+    unsigned short id;
+    char           name[PSM_STAT_NAME_LEN];
+} psm_stat_key_t;
+
+static struct {
+    unsigned char      idle;            /* inside the idle hook */
+    unsigned char      started;         /* slept once, so the awake window has a start */
+    unsigned int       idle_begin;      /* rtc */
+    unsigned int       idle_beacons;    /* psm beacon count when the idle hook was entered */
+    int                idle_irq;        /* first vector inside the idle hook, the wake interrupt */
+
+    /* the awake window since the last sleep */
+    unsigned int       awake_begin;
+    unsigned int       beacons;
+    psm_stat_key_t     first;           /* timer or frame */
+    char               task[PSM_STAT_NAME_LEN];
+    int                irq;
+
+    psm_stat_summary_t sum;
+    psm_stat_cause_t   cause[PSM_STAT_CAUSES];
+} s_psm_stat = { .idle_irq = -1, .irq = -1 };
+
+static void psm_stat_copy_name(char *dst, const char *name)
+{
+    strncpy(dst, name ? name : "", PSM_STAT_NAME_LEN - 1);
+    dst[PSM_STAT_NAME_LEN - 1] = 0;
+}
+
+static psm_stat_cause_t *psm_stat_find(const psm_stat_key_t *key)
+{
+    psm_stat_cause_t *c;
+    unsigned int     i;
+
+    for (i = 0; i < s_psm_stat.sum.causes; i++)
+    {
+        c = &s_psm_stat.cause[i];
+        if (c->wake == key->wake && c->id == key->id && !strcmp(c->name, key->name))
+        {
+            return(c);
+        }
+    }
+
+    if (s_psm_stat.sum.causes < PSM_STAT_CAUSES - 1)
+    {
+        c = &s_psm_stat.cause[s_psm_stat.sum.causes++];
+        c->wake = key->wake;
+        c->id   = key->id;
+        memcpy(c->name, key->name, sizeof(c->name));
+        return(c);
+    }
+
+    c = &s_psm_stat.cause[PSM_STAT_CAUSES - 1];
+    if (s_psm_stat.sum.causes < PSM_STAT_CAUSES)
+    {
+        s_psm_stat.sum.causes++;
+        c->wake = PSM_STAT_WAKE_UNKNOWN;
+        c->id   = PSM_STAT_OTHERS;
+        psm_stat_copy_name(c->name, "(others)");
+    }
+    return(c);
+}
+
+/* book the awake window that the sleep from idle_begin ended */
+static void psm_stat_close(unsigned int awake)
+{
+    psm_stat_key_t   key;
+    psm_stat_cause_t *c;
+
+    memset(&key, 0, sizeof(key));
+    if (s_psm_stat.first.wake)
+    {
+        key = s_psm_stat.first;
+    }
+    else if (s_psm_stat.idle_beacons != s_psm_stat.beacons)
+    {
+        key.wake = PSM_STAT_WAKE_BEACON;
+    }
+    else if (s_psm_stat.task[0])
+    {
+        key.wake = PSM_STAT_WAKE_TASK;
+        memcpy(key.name, s_psm_stat.task, sizeof(key.name));
+    }
+    else if (s_psm_stat.irq >= 0)
+    {
+        key.wake = PSM_STAT_WAKE_IRQ;
+        key.id   = s_psm_stat.irq;
+    }
+
+    c = psm_stat_find(&key);
+    c->count++;
+    c->awake += awake;
+    if (awake > c->awake_max)
+    {
+        c->awake_max = awake;
+    }
+    s_psm_stat.sum.awake += awake;
+}
+
+void psm_stat_idle_begin(void)
+{
+    unsigned int beacons = psm_cnt_rec_beacon_op(false, 0);
+    unsigned int now     = drv_rtc_get_32K_cnt();
+    unsigned int psw     = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    s_psm_stat.idle         = 1;
+    s_psm_stat.idle_begin   = now;
+    s_psm_stat.idle_beacons = beacons;
+    s_psm_stat.idle_irq     = -1;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+void psm_stat_idle_end(void)
+{
+    unsigned int now   = drv_rtc_get_32K_cnt();
+    unsigned int slept = drv_rtc_get_interval_cnt(s_psm_stat.idle_begin, now);
+    unsigned int psw   = portSET_INTERRUPT_MASK_FROM_ISR();
+    unsigned int ms, bucket;
+
+    s_psm_stat.idle = 0;
+    if (slept < PSM_STAT_MIN_SLEEP)
+    {
+        /* not a sleep, the awake window goes on */
+        s_psm_stat.sum.short_idles++;
+        if (s_psm_stat.irq < 0)
+        {
+            s_psm_stat.irq = s_psm_stat.idle_irq;
+        }
+        portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+        return;
+    }
+
+    if (s_psm_stat.started)
+    {
+        psm_stat_close(drv_rtc_get_interval_cnt(s_psm_stat.awake_begin, s_psm_stat.idle_begin));
+    }
+    s_psm_stat.started = 1;
+
+    ms = PSM_STAT_MS(slept);
+    for (bucket = 0; bucket < PSM_STAT_BUCKETS - 1 && ms >= (4u << bucket); bucket++)
+    {
+    }
+    s_psm_stat.sum.sleeps++;
+    s_psm_stat.sum.asleep += slept;
+    s_psm_stat.sum.hist_count[bucket]++;
+    s_psm_stat.sum.hist_time[bucket] += slept;
+
+    s_psm_stat.awake_begin = now;
+    s_psm_stat.beacons     = s_psm_stat.idle_beacons;
+    s_psm_stat.first.wake  = PSM_STAT_WAKE_UNKNOWN;
+    s_psm_stat.task[0]     = 0;
+    s_psm_stat.irq         = s_psm_stat.idle_irq;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+/* interrupts are masked in irq_in(), and the port does not nest them */
+void psm_stat_irq(unsigned int vector)
+{
+    if (s_psm_stat.idle)
+    {
+        if (s_psm_stat.idle_irq < 0)
+        {
+            s_psm_stat.idle_irq = vector;
+        }
+    }
+    else if (s_psm_stat.irq < 0)
+    {
+        s_psm_stat.irq = vector;
+    }
+}
+
+/* from the context switch, interrupts masked */
+void psm_stat_task(const char *name)
+{
+    if (!s_psm_stat.task[0] && strcmp(name, "IDLE"))
+    {
+        psm_stat_copy_name(s_psm_stat.task, name);
+    }
+}
+
+void psm_stat_timer(const char *name)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    if (!s_psm_stat.first.wake)
+    {
+        s_psm_stat.first.wake = PSM_STAT_WAKE_TIMER;
+        s_psm_stat.first.id   = 0;
+        psm_stat_copy_name(s_psm_stat.first.name, name);
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+void psm_stat_rx(const uint8_t *eth)
+{
+    static const uint8_t bcast[6] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    unsigned int         psw;
+
+    if (s_psm_stat.first.wake)
+    {
+        return;
+    }
+    psw = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (!s_psm_stat.first.wake)
+    {
+        if (!(eth[0] & 1))
+        {
+            s_psm_stat.first.wake = PSM_STAT_WAKE_RX_UCAST;
+        }
+        else
+        {
+            s_psm_stat.first.wake = memcmp(eth, bcast, 6) ? PSM_STAT_WAKE_RX_MCAST : PSM_STAT_WAKE_RX_BCAST;
+        }
+        s_psm_stat.first.id      = (eth[12] << 8) | eth[13];
+        s_psm_stat.first.name[0] = 0;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+void psm_stat_get_summary(psm_stat_summary_t *summary)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    *summary = s_psm_stat.sum;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+int psm_stat_get_cause(unsigned int index, psm_stat_cause_t *cause)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+    int          ret = -1;
+
+    if (index < s_psm_stat.sum.causes)
+    {
+        *cause = s_psm_stat.cause[index];
+        ret    = 0;
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+    return(ret);
+}
+
+/* the window in progress is kept, it is booked at the next sleep */
+void psm_stat_reset(void)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    memset(&s_psm_stat.sum, 0, sizeof(s_psm_stat.sum));
+    memset(s_psm_stat.cause, 0, sizeof(s_psm_stat.cause));
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+static const char *psm_stat_wake_name(unsigned int wake)
+{
+    static const char *names[PSM_STAT_WAKE_MAX] = {
+        "unknown", "irq", "task", "timer", "beacon", "rx bcast", "rx mcast", "rx ucast"
+    };
+
+    return((wake < PSM_STAT_WAKE_MAX) ? names[wake] : "?");
+}
+
+void psm_stat_report(void)
+{
+    psm_stat_summary_t sum;
+    psm_stat_cause_t   c, top;
+    unsigned int       total, i, j, k;
+    unsigned char      shown[PSM_STAT_CAUSES];
+    char               label[PSM_STAT_NAME_LEN + 8];
+
+    psm_stat_get_summary(&sum);
+    total = PSM_STAT_MS(sum.asleep + sum.awake);
+    os_printf(LM_CMD, LL_INFO, "%u ms: asleep %u ms (%u%%) in %u sleeps, awake %u ms, %u short idles\r\n",
+        total, PSM_STAT_MS(sum.asleep), total ? (unsigned int)(PSM_STAT_MS(sum.asleep) * 100ull / total) : 0,
+        sum.sleeps, PSM_STAT_MS(sum.awake), sum.short_idles);
+
+    os_printf(LM_CMD, LL_INFO, "sleep length      count     total ms\r\n");
+    for (i = 0; i < PSM_STAT_BUCKETS; i++)
+    {
+        if (i < PSM_STAT_BUCKETS - 1)
+        {
+            os_printf(LM_CMD, LL_INFO, "  < %4u ms  %10u  %11u\r\n", 4u << i, sum.hist_count[i], PSM_STAT_MS(sum.hist_time[i]));
+        }
+        else
+        {
+            os_printf(LM_CMD, LL_INFO, "  >=%4u ms  %10u  %11u\r\n", 4u << (i - 1), sum.hist_count[i], PSM_STAT_MS(sum.hist_time[i]));
+        }
+    }
+
+    /* by awake time, most first */
+    os_printf(LM_CMD, LL_INFO, "wake cause                     wakes   awake ms    avg us    max us\r\n");
+    memset(shown, 0, sizeof(shown));
+    for (i = 0; i < sum.causes; i++)
+    {
+        k = sum.causes;
+        for (j = 0; j < sum.causes; j++)
+        {
+            if (!shown[j] && psm_stat_get_cause(j, &c) == 0 && (k == sum.causes || c.awake > top.awake))
+            {
+                top = c;
+                k   = j;
+            }
+        }
+        if (k == sum.causes)
+        {
+            break;
+        }
+        shown[k] = 1;
+
+        if (top.wake == PSM_STAT_WAKE_IRQ || (top.wake >= PSM_STAT_WAKE_RX_BCAST && top.wake <= PSM_STAT_WAKE_RX_UCAST))
+        {
+            snprintf(label, sizeof(label), "0x%04x", top.id);
+        }
+        else
+        {
+            snprintf(label, sizeof(label), "%s", top.name);
+        }
+        os_printf(LM_CMD, LL_INFO, "  %-8s %-18s %8u  %9u  %8u  %8u\r\n", psm_stat_wake_name(top.wake), label,
+            top.count, PSM_STAT_MS(top.awake), top.count ? PSM_STAT_US(top.awake / top.count) : 0, PSM_STAT_US(top.awake_max));
+    }
+}
+
+/* little endian byte stream, printed 32 bytes a line */
+typedef struct {
+    unsigned char line[32];
+    unsigned int  len;
+} psm_stat_out_t;
+
+static void psm_stat_flush(psm_stat_out_t *out)
+{
+    char         hex[2 * sizeof(out->line) + 1];
+    unsigned int i;
+
+    if (out->len)
+    {
+        for (i = 0; i < out->len; i++)
+        {
+            sprintf(&hex[2 * i], "%02x", out->line[i]);
+        }
+        os_printf(LM_CMD, LL_INFO, "P %s\r\n", hex);
+        out->len = 0;
+    }
+}
+
+static void psm_stat_put(psm_stat_out_t *out, uint64_t value, unsigned int bytes)
+{
+    while (bytes--)
+    {
+        out->line[out->len++] = (unsigned char)value;
+        value >>= 8;
+        if (out->len == sizeof(out->line))
+        {
+            psm_stat_flush(out);
+        }
+    }
+}
+
+/*
+ * Layout, version 1, all little endian:
+ *   "PSMS" u8 version u8 buckets u8 causes u8 0 u32 hz
+ *   u32 sleeps u32 short_idles u64 asleep u64 awake
+ *   buckets x { u32 count u64 time }
+ *   causes x { u8 wake u8 0 u16 id char name[12] u32 count u32 awake_max u64 awake }
+ */
+void psm_stat_dump(void)
+{
+    psm_stat_summary_t sum;
+    psm_stat_cause_t   c;
+    psm_stat_out_t     out;
+    unsigned int       i, j;
+
+    psm_stat_get_summary(&sum);
+    os_printf(LM_CMD, LL_INFO, "#psm_stat 1 len=%u\r\n", 32 + PSM_STAT_BUCKETS * 12 + sum.causes * 32);
+
+    out.len = 0;
+    psm_stat_put(&out, 0x534d5350, 4);      /* "PSMS" */
+    psm_stat_put(&out, 1, 1);
+    psm_stat_put(&out, PSM_STAT_BUCKETS, 1);
+    psm_stat_put(&out, sum.causes, 1);
+    psm_stat_put(&out, 0, 1);
+    psm_stat_put(&out, PSM_STAT_HZ, 4);
+    psm_stat_put(&out, sum.sleeps, 4);
+    psm_stat_put(&out, sum.short_idles, 4);
+    psm_stat_put(&out, sum.asleep, 8);
+    psm_stat_put(&out, sum.awake, 8);
+    for (i = 0; i < PSM_STAT_BUCKETS; i++)
+    {
+        psm_stat_put(&out, sum.hist_count[i], 4);
+        psm_stat_put(&out, sum.hist_time[i], 8);
+    }
+    for (i = 0; i < sum.causes; i++)
+    {
+        /* an entry added since the summary still goes out, the count says how many */
+        memset(&c, 0, sizeof(c));
+        psm_stat_get_cause(i, &c);
+        psm_stat_put(&out, c.wake, 1);
+        psm_stat_put(&out, 0, 1);
+        psm_stat_put(&out, c.id, 2);
+        for (j = 0; j < PSM_STAT_NAME_LEN; j++)
+        {
+            psm_stat_put(&out, (unsigned char)c.name[j], 1);
+        }
+        psm_stat_put(&out, c.count, 4);
+        psm_stat_put(&out, c.awake_max, 4);
+        psm_stat_put(&out, c.awake, 8);
+    }
+    psm_stat_flush(&out);
+    os_printf(LM_CMD, LL_INFO, "#end\r\n");
+}
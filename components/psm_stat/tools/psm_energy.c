@@ -0,0 +1,243 @@
+/*
+ * Turn a "psm_stat dump" console log into an energy budget
+ * (see include/components/psm_stat/psm_stat.h).
+ *
+ *   gcc -o psm_energy psm_energy.c
+ *   psm_energy [-a awake mA] [-s sleep mA] [-w wake us] [-b battery mAh] <console.log>
+ *
+ * The log may hold anything around the dump; the last "#psm_stat" block in
+ * it is used. Awake time draws the awake current, sleep the sleep current,
+ * and every wake adds -w us at the awake current for the ramp up and down
+ * the CPU does not see. The charge is split by wake cause, so the budget
+ * shows what each timer, frame type or task costs per hour and what the
+ * battery would last.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define BUCKETS_MAX     32
+#define NAME_LEN        12
+
+typedef struct {
+    unsigned int wake;
+    unsigned int id;
+    char         name[NAME_LEN + 1];
+    uint32_t     count;
+    uint32_t     awake_max;
+    uint64_t     awake;
+    double       mas;               /* charge booked to it, mA s */
+} cause_t;
+
+static const char *wake_names[] = {
+    "unknown", "irq", "task", "timer", "beacon", "rx bcast", "rx mcast", "rx ucast"
+};
+
+static const unsigned char *p;
+static size_t left;
+
+static uint64_t get(unsigned int bytes)
+{
+    uint64_t v = 0;
+    unsigned int i;
+
+    if (left < bytes) {
+        fprintf(stderr, "dump is cut short\n");
+        exit(1);
+    }
+    for (i = 0; i < bytes; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    p += bytes;
+    left -= bytes;
+    return v;
+}
+
+static int hexval(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/* the bytes of the last complete dump in the log */
+static unsigned char *read_dump(FILE *in, size_t *len)
+{
+    unsigned char *buf = NULL, *last = NULL;
+    size_t n = 0, cap = 0, last_len = 0;
+    char line[512], *s;
+    int in_dump = 0, hi, lo;
+
+    while (fgets(line, sizeof(line), in)) {
+        if ((s = strstr(line, "#psm_stat ")) != NULL) {
+            in_dump = 1;
+            n = 0;
+        } else if (in_dump && strstr(line, "#end")) {
+            in_dump = 0;
+            free(last);
+            last = buf;
+            last_len = n;
+            buf = NULL;
+            cap = n = 0;
+        } else if (in_dump && (s = strstr(line, "P ")) != NULL) {
+            for (s += 2; (hi = hexval(s[0])) >= 0 && (lo = hexval(s[1])) >= 0; s += 2) {
+                if (n == cap) {
+                    cap = cap ? cap * 2 : 1024;
+                    buf = realloc(buf, cap);
+                    if (!buf) {
+                        perror("realloc");
+                        exit(1);
+                    }
+                }
+                buf[n++] = (unsigned char)(hi << 4 | lo);
+            }
+        }
+    }
+    free(buf);
+    *len = last_len;
+    return last;
+}
+
+static int by_charge(const void *a, const void *b)
+{
+    const cause_t *x = a, *y = b;
+
+    return (x->mas < y->mas) - (x->mas > y->mas);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-a awake mA] [-s sleep mA] [-w wake us] [-b battery mAh] <console.log>\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    double awake_ma = 30.0, sleep_ma = 0.1, wake_us = 0, battery = 0;
+    double hz, total_s, asleep_s, awake_s, ramp_s, mas_sleep, mas_awake, mas_ramp, mas, avg_ma, hours;
+    unsigned int version, buckets, causes, i, j, sleeps, short_idles;
+    uint32_t hist_count[BUCKETS_MAX];
+    uint64_t hist_time[BUCKETS_MAX], asleep, awake;
+    unsigned char *dump;
+    cause_t *cause;
+    size_t len;
+    FILE *in;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:s:w:b:")) != -1) {
+        switch (opt) {
+        case 'a': awake_ma = atof(optarg); break;
+        case 's': sleep_ma = atof(optarg); break;
+        case 'w': wake_us = atof(optarg); break;
+        case 'b': battery = atof(optarg); break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+    if (!(in = fopen(argv[optind], "r"))) {
+        perror(argv[optind]);
+        return 1;
+    }
+    dump = read_dump(in, &len);
+    fclose(in);
+    if (!dump) {
+        fprintf(stderr, "no complete \"psm_stat dump\" in %s\n", argv[optind]);
+        return 1;
+    }
+
+    p = dump;
+    left = len;
+    if (get(4) != 0x534d5350) {
+        fprintf(stderr, "not a psm_stat dump\n");
+        return 1;
+    }
+    version = get(1);
+    buckets = get(1);
+    causes = get(1);
+    get(1);
+    if (version != 1 || buckets > BUCKETS_MAX) {
+        fprintf(stderr, "psm_stat dump version %u with %u buckets is not known\n", version, buckets);
+        return 1;
+    }
+    hz = (double)get(4);
+    sleeps = get(4);
+    short_idles = get(4);
+    asleep = get(8);
+    awake = get(8);
+    for (i = 0; i < buckets; i++) {
+        hist_count[i] = get(4);
+        hist_time[i] = get(8);
+    }
+    cause = calloc(causes ? causes : 1, sizeof(*cause));
+    for (i = 0; i < causes; i++) {
+        cause[i].wake = get(1);
+        get(1);
+        cause[i].id = get(2);
+        for (j = 0; j < NAME_LEN; j++)
+            cause[i].name[j] = (char)get(1);
+        cause[i].count = get(4);
+        cause[i].awake_max = get(4);
+        cause[i].awake = get(8);
+    }
+
+    asleep_s = asleep / hz;
+    awake_s = awake / hz;
+    total_s = asleep_s + awake_s;
+    if (total_s <= 0) {
+        fprintf(stderr, "the dump covers no complete sleep cycle\n");
+        return 1;
+    }
+    ramp_s = sleeps * wake_us / 1e6;
+    mas_sleep = asleep_s * sleep_ma;
+    mas_awake = awake_s * awake_ma;
+    mas_ramp = ramp_s * awake_ma;
+    mas = mas_sleep + mas_awake + mas_ramp;
+    avg_ma = mas / total_s;
+
+    printf("covered %.1f s: asleep %.1f%% in %u sleeps (%.2f wakes/s), %u short idles\n",
+           total_s, 100.0 * asleep_s / total_s, sleeps, sleeps / total_s, short_idles);
+    printf("currents: awake %.2f mA, asleep %.3f mA, %.0f us ramp per wake\n\n", awake_ma, sleep_ma, wake_us);
+
+    printf("sleep length       count    share of sleep\n");
+    for (i = 0; i < buckets; i++) {
+        if (i < buckets - 1)
+            printf("  < %5u ms  %10u    %5.1f%%\n", 4u << i, hist_count[i], asleep ? 100.0 * hist_time[i] / asleep : 0);
+        else
+            printf("  >=%5u ms  %10u    %5.1f%%\n", 4u << (i - 1), hist_count[i], asleep ? 100.0 * hist_time[i] / asleep : 0);
+    }
+
+    for (i = 0; i < causes; i++)
+        cause[i].mas = (cause[i].awake / hz + cause[i].count * wake_us / 1e6) * awake_ma;
+    qsort(cause, causes, sizeof(*cause), by_charge);
+
+    printf("\nwake cause                    wakes/h  awake ms/h   mAh/day   share\n");
+    for (i = 0; i < causes; i++) {
+        char label[NAME_LEN + 8];
+
+        if (cause[i].wake == 1 || (cause[i].wake >= 5 && cause[i].wake <= 7))
+            snprintf(label, sizeof(label), "0x%04x", cause[i].id);
+        else
+            snprintf(label, sizeof(label), "%s", cause[i].name);
+        printf("  %-8s %-18s %8.0f  %10.1f  %8.3f  %5.1f%%\n",
+               cause[i].wake < sizeof(wake_names) / sizeof(wake_names[0]) ? wake_names[cause[i].wake] : "?", label,
+               cause[i].count * 3600.0 / total_s, cause[i].awake / hz * 1000.0 * 3600.0 / total_s,
+               cause[i].mas / total_s * 24.0, 100.0 * cause[i].mas / mas);
+    }
+    printf("  %-27s %8s  %10s  %8.3f  %5.1f%%\n", "sleep", "", "", mas_sleep / total_s * 24.0, 100.0 * mas_sleep / mas);
+
+    hours = battery > 0 ? battery / avg_ma : 0;
+    printf("\naverage %.3f mA, %.2f mAh/day", avg_ma, avg_ma * 24.0);
+    if (hours > 0)
+        printf(", %.0f mAh last %.1f days", battery, hours / 24.0);
+    printf("\n");
+
+    free(cause);
+    free(dump);
+    return 0;
+}
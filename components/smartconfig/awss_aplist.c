@@ -16,8 +16,12 @@ extern "C" {
 
 #define ZC_MAX_CHANNEL            (14)
 #define ZC_MIN_CHANNEL            (1)
+/* bssid -> zconfig_aplist index (fits a byte), open addressing, 0 is a free slot ([0] is never in it) */
+#define APLIST_HASH_SIZE          (2 * MAX_APLIST_NUM)
+#define APLIST_HASH_MASK          (APLIST_HASH_SIZE - 1)
 /* storage to store apinfo */
 struct ap_info *zconfig_aplist = NULL;
+static uint8_t *zconfig_aplist_hash = NULL;
 /* aplist num, less than MAX_APLIST_NUM */
 uint8_t zconfig_aplist_num = 0;
 uint16_t g_ssidIndex;
@@ -77,9 +81,15 @@ static char *awss_strncpy(char *dest, const char *src, size_t count)
     return dest;
 }
 
+/* the oui bytes are shared by many aps, the last ones are not */
+static unsigned int awss_aplist_hash(const uint8_t *mac)
+{
+    return (mac[3] * 31 * 31 + mac[4] * 31 + mac[5]) & APLIST_HASH_MASK;
+}
+
 int awss_clear_aplist(void)
 {
-    os_memset(zconfig_aplist, 0, sizeof(struct ap_info) * MAX_APLIST_NUM);
+    os_memset(zconfig_aplist, 0, sizeof(struct ap_info) * MAX_APLIST_NUM + APLIST_HASH_SIZE);
     zconfig_aplist_num = 0;
 
     return 0;
@@ -90,10 +100,11 @@ int awss_init_ieee80211_aplist(void)
     if (zconfig_aplist) {
         return 0;
     }
-    zconfig_aplist = (struct ap_info *)os_zalloc(sizeof(struct ap_info) * MAX_APLIST_NUM);
+    zconfig_aplist = (struct ap_info *)os_zalloc(sizeof(struct ap_info) * MAX_APLIST_NUM + APLIST_HASH_SIZE);
     if (zconfig_aplist == NULL) {
         return -1;
     }
+    zconfig_aplist_hash = (uint8_t *)&zconfig_aplist[MAX_APLIST_NUM];
     zconfig_aplist_num = 0;
     return 0;
 }
@@ -105,15 +116,22 @@ int awss_deinit_ieee80211_aplist(void)
     }
     os_free(zconfig_aplist);
     zconfig_aplist = NULL;
+    zconfig_aplist_hash = NULL;
     zconfig_aplist_num = 0;
     return 0;
 }
 
 struct ap_info *zconfig_get_apinfo(const uint8_t *mac)
 {
+    unsigned int slot;
     int i;
 
-    for (i = 1; i < zconfig_aplist_num; i++) {
+    if (zconfig_aplist == NULL) {
+        return NULL;
+    }
+
+    /* the same bssid with another ssid comes later in the chain, as in the list */
+    for (slot = awss_aplist_hash(mac); (i = zconfig_aplist_hash[slot]) != 0; slot = (slot + 1) & APLIST_HASH_MASK) {
         if (!os_memcmp(zconfig_aplist[i].mac, mac, ETH_ALEN)) {
             g_ssidIndex = i;
             return &zconfig_aplist[i];
@@ -170,10 +188,11 @@ bool zconfig_check_ap_channel(int channel)
 int awss_save_apinfo(uint8_t *ssid, uint8_t *bssid, uint8_t channel, uint8_t auth,
                      uint8_t pairwise_cipher, uint8_t group_cipher, signed char rssi)
 {
+    unsigned int slot;
     int i;
 
     /* ssid, bssid cannot empty, channel can be 0, auth/encry can be invalid */
-    if (!(ssid && bssid)) {
+    if (!(ssid && bssid) || zconfig_aplist == NULL) {
         return -1;
     }
 
@@ -206,8 +225,7 @@ int awss_save_apinfo(uint8_t *ssid, uint8_t *bssid, uint8_t channel, uint8_t aut
         zconfig_aplist_num = 1;
     }
 
-    for (i = 1; i < zconfig_aplist_num; i++) {
-        // system_printf("assid  %s ssid %s cmp %d\n",zconfig_aplist[i].ssid, ssid,strncmp(zconfig_aplist[i].ssid, (char *)ssid, ZC_MAX_SSID_LEN));
+    for (slot = awss_aplist_hash(bssid); (i = zconfig_aplist_hash[slot]) != 0; slot = (slot + 1) & APLIST_HASH_MASK) {
         if (!os_strncmp(zconfig_aplist[i].ssid, (char *)ssid, ZC_MAX_SSID_LEN)
             && !os_memcmp(zconfig_aplist[i].mac, bssid, ETH_ALEN)) {
             //FIXME: useless?
@@ -234,8 +252,11 @@ int awss_save_apinfo(uint8_t *ssid, uint8_t *bssid, uint8_t channel, uint8_t aut
         // }
     }
 
-    if (i < MAX_APLIST_NUM) {
+    /* zconfig_aplist_num is a byte, it must not wrap to 0 */
+    i = zconfig_aplist_num;
+    if (i < MAX_APLIST_NUM - 1) {
         zconfig_aplist_num ++;
+        zconfig_aplist_hash[slot] = i;
     } else {
         i = 0;    /* [0] for temp use, always replace [0] */
     }
@@ -117,6 +117,13 @@ static QueueHandle_t g_event_queue = NULL;
 static sc_result_t sc_result;
 
 int g_current_channel;
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+/* batches arrive after the fact, the radio may have hopped on since */
+static int g_rxChannel;
+#define SC_RX_CHANNEL()     g_rxChannel
+#else
+#define SC_RX_CHANNEL()     wifi_rf_get_channel()
+#endif
 int g_round;
 int g_hiddenSsid;
 int g_mutilFlag;
@@ -429,7 +436,7 @@ static int get_base_len(const uint8_t* frame, unsigned short length, int type)
             if(type == MULTI_TYPE_FRDS || type == BRODA_TYPE_FRDS){
                 find_ap_in_aplist(&frame[10],&target_ap);
             } else if (type == UF_TYPE_NULL) {
-                g_current_channel = wifi_rf_get_channel();
+                g_current_channel = SC_RX_CHANNEL();
                 return 1;
             } else {
                 find_ap_in_aplist(&frame[4],&target_ap);
@@ -685,7 +692,7 @@ static int multi_lock_chan(const uint8_t *frame, int type)
         if(type == MULTI_TYPE_FRDS){
             find_ap_in_aplist(&frame[10], &target_ap);
         } else if (type == UF_TYPE_NULL) {
-            g_current_channel = wifi_rf_get_channel();
+            g_current_channel = SC_RX_CHANNEL();
             return 1;
         } else {
             find_ap_in_aplist(&frame[4], &target_ap);
@@ -978,6 +985,7 @@ int process_manager(void *packet, int size, int8_t rssi)
     return -1;
 }
 
+#ifndef CONFIG_WIFI_SNIFFER_BATCH
 static void wifiSnifferCallback(void *buf, int len, wifi_promiscuous_pkt_type_t type)
 {
     wifi_promiscuous_pkt_t *pkt = (wifi_promiscuous_pkt_t *)buf; 
@@ -991,6 +999,31 @@ static void wifiSnifferCallback(void *buf, int len, wifi_promiscuous_pkt_type_t
     }
     
 }
+#else
+#define SC_MGMT_SUBTYPES    ((1 << 5) | (1 << 8))   /* probe response, beacon */
+#define SC_DATA_SUBTYPES    ((1 << 0) | (1 << 8))   /* data, qos data */
+#define SC_DATA_SNAPLEN     26                      /* only the header and the length carry the code */
+
+static void wifiSnifferBatchCallback(const wifi_sniffer_frame_t *frames, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        /* heard before the last hop, the state machine is on another channel now */
+        if (g_current_channel && frames[i].channel != g_current_channel) {
+            continue;
+        }
+        g_rxChannel = frames[i].channel;
+        if (frames[i].type == WIFI_PKT_MGMT) {
+            process_manager(frames[i].frame, frames[i].caplen, frames[i].rssi);
+        } else if (frames[i].type == WIFI_PKT_DATA) {
+            process_data(frames[i].frame, frames[i].len);
+        } else if (frames[i].type == WIFI_PKT_NULL) {
+            process_null(NULL, frames[i].len);
+        }
+    }
+}
+#endif
 extern int fhost_cntrl_map_check(uint8_t vif_type);
 void sc_task(void* parameter)
 {
@@ -1004,11 +1037,23 @@ void sc_task(void* parameter)
     while(!fhost_cntrl_map_check(0));
 
     awss_init_ieee80211_aplist();
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+    wifi_sniffer_batch_cfg_t batch = {0};
+    batch.subtypes[WIFI_PKT_MGMT] = SC_MGMT_SUBTYPES;
+    batch.subtypes[WIFI_PKT_DATA] = SC_DATA_SUBTYPES;
+    batch.subtypes[WIFI_PKT_NULL] = 1;
+    batch.snaplen[WIFI_PKT_MGMT] = CONFIG_WIFI_SNIFFER_BATCH_SNAPLEN;
+    batch.snaplen[WIFI_PKT_DATA] = SC_DATA_SNAPLEN;
+    batch.no_retry = true;
+    batch.cb = wifiSnifferBatchCallback;
+    wifi_sniffer_batch_start(&batch);
+#else
     wifi_promiscuous_filter_t filter = {0};
     filter.filter_mask = WIFI_PROMIS_FILTER_MASK_DATA | WIFI_PROMIS_FILTER_MASK_MGMT;
     wifi_set_promiscuous_filter(&filter);
     wifi_set_promiscuous_rx_cb(wifiSnifferCallback);
     wifi_set_promiscuous(true);
+#endif
 
     os_timer_start(sc_cf.channel_timer);
     os_timer_start(sc_cf.task_timer);
@@ -1021,9 +1066,13 @@ void sc_task(void* parameter)
                         sc_cf.callback(SC_STATUS_LOCK_CHANNEL,&g_current_channel);
                     }
                     wifi_rf_set_channel(g_current_channel);
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+                    wifi_sniffer_batch_filter(WIFI_PKT_MGMT, 0);
+#else
                     memset(&filter, 0, sizeof(wifi_promiscuous_filter_t));
                     filter.filter_mask = WIFI_PROMIS_FILTER_MASK_DATA;
                     wifi_set_promiscuous_filter(&filter);
+#endif
                     break;
                 case SC_STATUS_GOT_SSID_PSWD:
                     if(sc_cf.callback != NULL){
@@ -0,0 +1,146 @@
+/**
+ * @file systrace.c
+ * @brief Binary trace ring, see systrace.h
+ */
+
+#include <string.h>
+#include "oshal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pit.h"
+#include "chip_clk_ctrl.h"
+#include "systrace.h"
+#ifdef CONFIG_PSM_SURPORT
+#include "psm_system.h"
+#endif
+
+#define SYSTRACE_RECORDS    CONFIG_SYSTRACE_RECORDS
+
+volatile unsigned int g_systrace_mask = CONFIG_SYSTRACE_BOOT_MASK;
+
+static systrace_rec_t s_systrace_ring[SYSTRACE_RECORDS];
+static unsigned int   s_systrace_next;      /* slot written next */
+static unsigned int   s_systrace_written;   /* records since the last clear */
+static unsigned char  s_systrace_ctx;       /* vector + 1 while an isr runs */
+
+void systrace_record(unsigned int event, unsigned int a16, unsigned int a0, unsigned int a1)
+{
+    unsigned int   psw = portSET_INTERRUPT_MASK_FROM_ISR();
+    systrace_rec_t *rec = &s_systrace_ring[s_systrace_next];
+
+    rec->ts    = drv_pit_get_tick();
+    rec->event = event;
+    rec->ctx   = s_systrace_ctx;
+    rec->a16   = a16;
+    rec->a0    = a0;
+    rec->a1    = a1;
+    if (++s_systrace_next == SYSTRACE_RECORDS)
+    {
+        s_systrace_next = 0;
+    }
+    s_systrace_written++;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+void systrace_task_switch(const char *name)
+{
+    unsigned int packed[2] = { 0, 0 };
+
+    if (SYSTRACE_ON(SYSTRACE_EV_TASK))
+    {
+        /* the tcb address tells apart tasks whose names share 8 chars */
+        strncpy((char *)packed, name, sizeof(packed));
+        systrace_record(SYSTRACE_EV_TASK, (unsigned int)xTaskGetCurrentTaskHandle() >> 2, packed[0], packed[1]);
+    }
+}
+
+/* the port does not nest interrupts, one context is enough */
+void systrace_irq_enter(unsigned int vector)
+{
+    SYSTRACE_BEGIN(SYSTRACE_EV_IRQ, vector, 0, 0);
+    s_systrace_ctx = vector + 1;
+}
+
+void systrace_irq_exit(void)
+{
+    unsigned int vector = s_systrace_ctx - 1;
+
+    s_systrace_ctx = 0;
+    SYSTRACE_END(SYSTRACE_EV_IRQ, vector, 0, 0);
+}
+
+void systrace_start(unsigned int mask)
+{
+    g_systrace_mask = mask & SYSTRACE_ALL;
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        systrace_task_switch(pcTaskGetName(NULL));
+    }
+}
+
+void systrace_stop(void)
+{
+    g_systrace_mask = 0;
+}
+
+void systrace_clear(void)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    s_systrace_next    = 0;
+    s_systrace_written = 0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+static unsigned int systrace_hz(void)
+{
+#ifdef CONFIG_PSM_SURPORT
+    unsigned int cpu_freq = psm_cpu_freq_op(false, 0);
+
+    if (cpu_freq)
+    {
+        return(cpu_freq * 1000000 / 4);
+    }
+#endif
+    return(CHIP_CLOCK_APB);
+}
+
+void systrace_get_stats(systrace_stats_t *stats)
+{
+    stats->mask    = g_systrace_mask;
+    stats->written = s_systrace_written;
+    stats->records = (s_systrace_written < SYSTRACE_RECORDS) ? s_systrace_written : SYSTRACE_RECORDS;
+    stats->hz      = systrace_hz();
+}
+
+/*
+ * Text form read by tools/systrace2json:
+ *   #systrace 1 hz=<tick rate> records=<n> lost=<overwritten>
+ *   T <ts> <event ctx a16> <a0> <a1>      one line per record, hex
+ *   #end
+ */
+void systrace_dump(void)
+{
+    systrace_stats_t stats;
+    systrace_rec_t   *rec;
+    unsigned int     mask = g_systrace_mask;
+    unsigned int     i, slot;
+
+    /* printing would trace the console itself */
+    g_systrace_mask = 0;
+    systrace_get_stats(&stats);
+    os_printf(LM_CMD, LL_INFO, "#systrace 1 hz=%u records=%u lost=%u\r\n", stats.hz, stats.records, stats.written - stats.records);
+
+    slot = (stats.records < SYSTRACE_RECORDS) ? 0 : s_systrace_next;
+    for (i = 0; i < stats.records; i++)
+    {
+        rec = &s_systrace_ring[slot];
+        os_printf(LM_CMD, LL_INFO, "T %08x %02x%02x%04x %08x %08x\r\n", rec->ts, rec->event, rec->ctx, rec->a16, rec->a0, rec->a1);
+        if (++slot == SYSTRACE_RECORDS)
+        {
+            slot = 0;
+        }
+    }
+    os_printf(LM_CMD, LL_INFO, "#end\r\n");
+    g_systrace_mask = mask;
+}
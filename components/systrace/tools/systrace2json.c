@@ -0,0 +1,309 @@
+/*
+ * Convert a "systrace dump" console log into Chrome trace event JSON
+ * (see include/components/systrace/systrace.h), for chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ *   gcc -o systrace2json systrace2json.c
+ *   systrace2json <console.log> [out.json]
+ *
+ * The log may hold anything around the dump (telnet or serial capture);
+ * the last "#systrace" block in it is converted. Each task and each
+ * interrupt vector gets its own track, spans (irq, flash, wifi tx) become
+ * complete events on the track they ran on, everything else an instant.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+#define EV_TASK         0
+#define EV_IRQ          1
+#define EV_NET_RX       2
+#define EV_NET_TX       3
+#define EV_FLASH_ERASE  4
+#define EV_FLASH_WRITE  5
+#define EV_MALLOC       6
+#define EV_FREE         7
+#define EV_MQTT_PUB     8
+#define EV_MARK         9
+#define EV_MAX          10
+
+#define PH_INSTANT      0
+#define PH_BEGIN        1
+#define PH_END          2
+
+#define MAX_TASKS       64
+#define IRQ_TID         1000    /* interrupt vector n is thread IRQ_TID + n */
+#define NUM_VECTORS     32
+
+static const char *ev_names[EV_MAX] = {
+    "task", "irq", "net rx", "net tx", "flash erase", "flash write",
+    "malloc", "free", "mqtt publish", "mark"
+};
+
+/* debug_core.c isrname[] */
+static const char *irq_names[NUM_VECTORS] = {
+    "IRQ_WIFI_CPU_SINGLE", "IRQ_WIFI_TICK_TIMER", "IRQ_WIFI_SOFT", "IRQ_WIFI_HOST",
+    "IRQ_PIT0", "IRQ_PIT1", "IRQ_SDIO_SLAVE", "IRQ_WDT", "IRQ_GPIO", "IRQ_I2C",
+    "IRQ_SPI2", "IRQ_SPI_FLASH", "IRQ_PCU", "IRQ_DMA", "IRQ_RTC", "IRQ_UART0",
+    "IRQ_UART1", "IRQ_UART2", "IRQ_SW", "IRQ_I2S", "IRQ_HASH", "IRQ_ECC", "IRQ_AES",
+    "IRQ_IR", "IRQ_SDIO_HOST", "IRQ_BLE", "IRQ_BLE_PHY", "IRQ_BLE_ERROR",
+    "IRQ_BMC_PM", "IRQ_BLE_HOPPING", "IRQ_AUX_ADC", "IRQ_31"
+};
+
+typedef struct {
+    uint16_t key;
+    char     name[9];
+} task_t;
+
+typedef struct {
+    int      open;
+    double   ts;
+    uint32_t a0;
+    uint32_t a1;
+} span_t;
+
+static task_t   tasks[MAX_TASKS];
+static int      num_tasks;
+static int      irq_seen[NUM_VECTORS];
+static span_t   task_spans[MAX_TASKS + 1][EV_MAX];
+static span_t   irq_spans[NUM_VECTORS][EV_MAX];
+static FILE     *out;
+static int      first_event = 1;
+
+static void emit(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void emit(const char *fmt, ...)
+{
+    va_list ap;
+
+    fputs(first_event ? "\n  " : ",\n  ", out);
+    first_event = 0;
+    va_start(ap, fmt);
+    vfprintf(out, fmt, ap);
+    va_end(ap);
+}
+
+/* task names are plain identifiers, still keep the JSON valid */
+static void json_name(char *dst, const char *src)
+{
+    for (; *src; src++) {
+        *dst++ = (*src == '"' || *src == '\\' || (unsigned char)*src < 0x20) ? '_' : *src;
+    }
+    *dst = '\0';
+}
+
+static int task_tid(uint16_t key, const char *name)
+{
+    char safe[9];
+    int i;
+
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i].key == key && !strcmp(tasks[i].name, name)) {
+            return i + 1;
+        }
+    }
+    if (num_tasks == MAX_TASKS) {
+        return MAX_TASKS;
+    }
+    tasks[num_tasks].key = key;
+    strcpy(tasks[num_tasks].name, name);
+    json_name(safe, name);
+    emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", num_tasks + 1, safe);
+    return ++num_tasks;
+}
+
+static int irq_tid(unsigned int vector)
+{
+    vector %= NUM_VECTORS;
+    if (!irq_seen[vector]) {
+        irq_seen[vector] = 1;
+        emit("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+             IRQ_TID + vector, irq_names[vector]);
+        emit("{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+             IRQ_TID + vector, -100 + (int)vector);
+    }
+    return IRQ_TID + vector;
+}
+
+static void emit_args(int ev, int end, uint32_t a16, uint32_t a0, uint32_t a1)
+{
+    switch (ev) {
+    case EV_IRQ:
+        fprintf(out, "\"args\":{\"vector\":%u}", a16);
+        break;
+    case EV_NET_RX:
+        fprintf(out, "\"args\":{\"ethertype\":\"0x%04x\",\"len\":%u}", a16, a0);
+        break;
+    case EV_NET_TX:
+        fprintf(out, "\"args\":{\"len\":%u,\"status\":%d}", a0, (int)end);
+        break;
+    case EV_FLASH_ERASE:
+    case EV_FLASH_WRITE:
+        fprintf(out, "\"args\":{\"addr\":\"0x%06x\",\"len\":%u,\"ret\":%d}", a0, a1, (int)end);
+        break;
+    case EV_MALLOC:
+    case EV_FREE:
+        fprintf(out, "\"args\":{\"addr\":\"0x%08x\",\"size\":%u}", a0, a1);
+        break;
+    case EV_MQTT_PUB:
+        fprintf(out, "\"args\":{\"qos\":%u,\"len\":%u,\"msg_id\":%u}", a16, a0, a1);
+        break;
+    default:
+        fprintf(out, "\"args\":{\"id\":%u,\"a0\":\"0x%08x\",\"a1\":\"0x%08x\"}", a16, a0, a1);
+        break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *in;
+    char line[512], *p, *start = NULL;
+    char *log;
+    long size;
+    unsigned int hz = 0, ts, word, a0, a1, records = 0, lost = 0;
+    double now = 0, task_start = 0, us_per_tick;
+    uint64_t wraps = 0;
+    uint32_t last_ts = 0, first_ts = 0;
+    int have_ts = 0, cur_tid = 0, n = 0, tid, ev, ph;
+    unsigned int a16, ctx;
+    span_t *span;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <console.log> [out.json]\n", argv[0]);
+        return 1;
+    }
+    in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    log = malloc(size + 1);
+    if (log == NULL || fread(log, 1, size, in) != (size_t)size) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    log[size] = '\0';
+    fclose(in);
+
+    /* the last dump in the log */
+    for (p = log; (p = strstr(p, "#systrace ")) != NULL; p++) {
+        start = p;
+    }
+    if (start == NULL || sscanf(start, "#systrace 1 hz=%u records=%u lost=%u", &hz, &records, &lost) < 1 || hz == 0) {
+        fprintf(stderr, "no systrace dump in %s\n", argv[1]);
+        return 1;
+    }
+    us_per_tick = 1e6 / hz;
+
+    out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"hz\":%u,\"lost\":%u},\"traceEvents\":[", hz, lost);
+    emit("{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"ECR6600\"}}");
+
+    p = strchr(start, '\n');
+    while (p != NULL && *p) {
+        char *eol = strchr(++p, '\n');
+        size_t len = eol ? (size_t)(eol - p) : strlen(p);
+
+        if (len >= sizeof(line)) {
+            len = sizeof(line) - 1;
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        p = eol;
+        if (strstr(line, "#end")) {
+            break;
+        }
+        char *rec = strstr(line, "T ");
+        if (rec == NULL || sscanf(rec, "T %x %x %x %x", &ts, &word, &a0, &a1) != 4) {
+            continue;
+        }
+
+        /* unwrap the 32 bit tick counter */
+        if (!have_ts) {
+            first_ts = ts;
+        } else if (ts < last_ts) {
+            wraps += 1ULL << 32;
+        }
+        last_ts = ts;
+        have_ts = 1;
+        now = (double)(wraps + ts - first_ts) * us_per_tick;
+
+        ev = (word >> 24) & 0x3f;
+        ph = (word >> 30) & 0x3;
+        ctx = (word >> 16) & 0xff;
+        a16 = word & 0xffff;
+        n++;
+
+        if (ev == EV_TASK) {
+            char name[9];
+
+            memcpy(name, &a0, 4);
+            memcpy(name + 4, &a1, 4);
+            name[8] = '\0';
+            tid = task_tid(a16, name);
+            if (cur_tid) {
+                emit("{\"ph\":\"X\",\"name\":\"running\",\"cat\":\"sched\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     cur_tid, task_start, now - task_start);
+            }
+            cur_tid = tid;
+            task_start = now;
+            continue;
+        }
+        if (ev >= EV_MAX) {
+            continue;
+        }
+
+        /* ctx says where it ran, an irq span belongs to its own vector */
+        if (ev == EV_IRQ) {
+            tid = irq_tid(a16);
+            span = &irq_spans[a16 % NUM_VECTORS][ev];
+        } else if (ctx) {
+            tid = irq_tid(ctx - 1);
+            span = &irq_spans[(ctx - 1) % NUM_VECTORS][ev];
+        } else {
+            tid = cur_tid ? cur_tid : task_tid(0, "?");
+            span = &task_spans[tid][ev];
+        }
+
+        if (ph == PH_BEGIN) {
+            span->open = 1;
+            span->ts = now;
+            span->a0 = a0;
+            span->a1 = a1;
+        } else if (ph == PH_END) {
+            if (!span->open) {
+                continue;   /* began before the oldest record */
+            }
+            span->open = 0;
+            emit("{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,",
+                 ev == EV_IRQ ? irq_names[a16 % NUM_VECTORS] : ev_names[ev], ev_names[ev], tid, span->ts, now - span->ts);
+            emit_args(ev, (int)a0, a16, span->a0, span->a1);
+            fputs("}", out);
+        } else {
+            emit("{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,",
+                 ev_names[ev], ev_names[ev], tid, now);
+            emit_args(ev, 0, a16, a0, a1);
+            fputs("}", out);
+        }
+    }
+    if (cur_tid) {
+        emit("{\"ph\":\"X\",\"name\":\"running\",\"cat\":\"sched\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+             cur_tid, task_start, now - task_start);
+    }
+    fputs("\n]}\n", out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    fprintf(stderr, "%d records, %d tasks, %u lost before the oldest\n", n, num_tasks, lost);
+    free(log);
+    return 0;
+}
@@ -28,12 +28,23 @@ typedef void*        event_handler_instance_t; /**< context identifying an insta
 #include <http_server_service.h>
 #include "setting_ssid.h"
 #include "cJSON.h"
+#ifdef CONFIG_HTTPD_STATIC
+#include "httpd_static.h"
+#endif
 
 /* A simple example that demonstrates how to create GET and POST
  * handlers for the web server.
  */
 
 static int setting_handler(httpd_req_t *req){
+#ifdef CONFIG_HTTPD_STATIC
+    /* Served from the asset pack when it carries the page: revalidation
+     * then costs a 304 instead of the whole page */
+    int ret = httpd_static_send(req, "/setting_ssid.html");
+    if (ret != ERR_NOT_FOUND) {
+        return ret;
+    }
+#endif
     httpd_resp_set_type(req, "text/html");
     httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
     return httpd_resp_send(req, (const char *)setting_ssid_html_gz, setting_ssid_html_gz_len); 
@@ -103,6 +114,9 @@ static httpd_handle_t start_webserver(void)
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
+#ifdef CONFIG_HTTPD_STATIC
+    config.uri_match_fn = httpd_uri_match_wildcard;
+#endif
 
     // Start the httpd server
     os_printf(LM_APP, LL_DBG, "Starting server on port: '%d'", config.server_port);
@@ -111,6 +125,11 @@ static httpd_handle_t start_webserver(void)
         os_printf(LM_APP, LL_DBG, "Registering URI handlers");
         httpd_register_uri_handler(server, &setting_get);
         httpd_register_uri_handler(server, &setting_post);
+#ifdef CONFIG_HTTPD_STATIC
+        if (httpd_static_mount_partition(CONFIG_HTTPD_STATIC_PARTITION) == OS_SUCCESS) {
+            httpd_static_register(server, "/*");
+        }
+#endif
         return server; 
     }
 
@@ -37,6 +37,13 @@
 #include "os.h"
 #include "net_al.h"
 #include "system_config.h"
+#include "systrace.h"
+#ifdef CONFIG_PSM_STAT
+#include "psm_stat.h"
+#endif
+#ifdef CONFIG_WIFI_RX_FILTER
+#include "wifi_rx_filter.h"
+#endif
 #include <string.h>
 #include "rtos_al.h"
 #include "rtos_debug.h"
@@ -174,11 +181,13 @@ static err_t low_level_output(struct netif *net_if, struct pbuf *p_buf)
 {
     err_t status = ERR_BUF;
 
+    SYSTRACE_BEGIN(SYSTRACE_EV_NET_TX, 0, p_buf->tot_len, 0);
     //ESWIN ADD judge for PBUF address is normal
     if (!fhost_tx_check_is_shram(p_buf->payload))
     {
         SYS_LOGE("pbuf mem addr[0x%p] error.\n", p_buf->payload);
         pbuf_free(p_buf);
+        SYSTRACE_END(SYSTRACE_EV_NET_TX, 0, ERR_MEM, 0);
         return ERR_MEM;
     }
 
@@ -201,6 +210,7 @@ static err_t low_level_output(struct netif *net_if, struct pbuf *p_buf)
         fhost_tx_free(p_buf);
     }
 
+    SYSTRACE_END(SYSTRACE_EV_NET_TX, 0, status, 0);
     return (status);
 }
 
@@ -241,6 +251,9 @@ static err_t low_level_init(struct netif *net_if)
 
     os_memcpy(net_if->hwaddr, addr, ETHARP_HWADDR_LEN);
     net_if->state = NULL;
+#ifdef CONFIG_WIFI_RX_FILTER
+    wifi_rx_filter_netif_init(net_if);
+#endif
 
     return status;
 }
@@ -316,6 +329,18 @@ int wifi_net_input(void *net_buf, net_if_t *net_if,
     struct pbuf *p;
     net_buf_rx_t *buf = (net_buf_rx_t *)net_buf;
 
+    SYSTRACE(SYSTRACE_EV_NET_RX, (((uint8_t *)addr)[12] << 8) | ((uint8_t *)addr)[13], len, 0);
+#ifdef CONFIG_PSM_STAT
+    psm_stat_rx(addr);
+#endif
+#ifdef CONFIG_WIFI_RX_FILTER
+    if (wifi_rx_filter_input(net_if, addr, len))
+    {
+        free_fn(buf);
+        return 0;
+    }
+#endif
+
 #ifndef CONFIG_CUSTOM_FHOSTAPD
     struct mac_eth_hdr *eth = (struct mac_eth_hdr *)addr;
 
@@ -555,7 +555,14 @@ char wifi_config_encrypt(int vif, char *pwd, wifi_auth_mode_e mode)
 
 sys_err_t wifi_rf_set_channel(uint8_t channel)
 {
-    return fhost_set_channel(channel) ? SYS_ERR : SYS_OK;
+    if (fhost_set_channel(channel))
+    {
+        return SYS_ERR;
+    }
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+    wifi_sniffer_batch_channel(channel);
+#endif
+    return SYS_OK;
 }
 
 uint8_t wifi_rf_get_channel(void)
@@ -0,0 +1,434 @@
+/*******************************************************************************
+ * File Name:    wifi_rx_filter.c
+ * Description:  L2/L3 filter in front of lwIP input, see wifi_rx_filter.h
+ *******************************************************************************/
+
+#include <string.h>
+#include "lwip/netif.h"
+#include "lwip/prot/ieee.h"
+#include "lwip/prot/ip.h"
+#include "lwip/prot/ip4.h"
+#include "oshal.h"
+#include "wifi_rx_filter.h"
+
+#define RX_FILTER_RULES         CONFIG_WIFI_RX_FILTER_RULES
+#define RX_FILTER_GROUPS        16      /* multicast MACs joined, over all netifs */
+#define RX_FILTER_NETIFS        2
+
+#define ETH_HLEN                14
+#define ETHTYPE_EAPOL           0x888e
+#define ARP_FRAME_LEN           42
+#define ARP_OP_REQUEST          1
+
+#define PORT_DHCP_CLIENT        68
+#define PORT_DHCP6_CLIENT       546
+
+typedef struct {
+    wifi_rx_filter_rule_t rule;
+    int                   id;
+    uint32_t              hits;
+} rx_filter_rule_t;
+
+typedef struct {
+    struct netif *netif;
+    uint8_t      mac[6];
+    uint8_t      refs;
+} rx_filter_group_t;
+
+typedef struct {
+    struct netif *netif;
+    bool         overflow;      /* more groups than fit, all multicast goes through */
+} rx_filter_netif_t;
+
+static bool                   s_rx_filter_on;
+static rx_filter_rule_t       s_rx_filter_rules[RX_FILTER_RULES];
+static int                    s_rx_filter_count;
+static int                    s_rx_filter_next_id;
+static rx_filter_group_t      s_rx_filter_groups[RX_FILTER_GROUPS];
+static rx_filter_netif_t      s_rx_filter_netifs[RX_FILTER_NETIFS];
+static wifi_rx_filter_stats_t s_rx_filter_stats;
+
+
+
+/****************************************************************************
+*                                   Multicast groups
+****************************************************************************/
+static rx_filter_netif_t *rx_filter_find_netif(struct netif *netif)
+{
+    int i;
+
+    for (i = 0; i < RX_FILTER_NETIFS; i++)
+    {
+        if (s_rx_filter_netifs[i].netif == netif)
+        {
+            return &s_rx_filter_netifs[i];
+        }
+    }
+    return NULL;
+}
+
+static void rx_filter_group(struct netif *netif, const uint8_t *mac, enum netif_mac_filter_action action)
+{
+    rx_filter_netif_t *nif = rx_filter_find_netif(netif);
+    rx_filter_group_t *g, *free_slot = NULL;
+    unsigned int      psw;
+    int               i;
+
+    if (nif == NULL)
+    {
+        return;
+    }
+
+    psw = system_irq_save();
+    for (i = 0; i < RX_FILTER_GROUPS; i++)
+    {
+        g = &s_rx_filter_groups[i];
+        if (g->refs && g->netif == netif && !memcmp(g->mac, mac, 6))
+        {
+            break;
+        }
+        if (!g->refs && free_slot == NULL)
+        {
+            free_slot = g;
+        }
+    }
+
+    if (i < RX_FILTER_GROUPS)
+    {
+        /* several groups share a MAC */
+        if (action == NETIF_ADD_MAC_FILTER)
+        {
+            g->refs++;
+        }
+        else
+        {
+            g->refs--;
+        }
+    }
+    else if (action == NETIF_ADD_MAC_FILTER)
+    {
+        if (free_slot)
+        {
+            free_slot->netif = netif;
+            memcpy(free_slot->mac, mac, 6);
+            free_slot->refs  = 1;
+        }
+        else
+        {
+            nif->overflow = true;
+        }
+    }
+    system_irq_restore(psw);
+}
+
+#if LWIP_IPV4 && LWIP_IGMP
+static err_t rx_filter_igmp_mac(struct netif *netif, const ip4_addr_t *group, enum netif_mac_filter_action action)
+{
+    const uint8_t *ip     = (const uint8_t *)&group->addr;
+    uint8_t       mac[6]  = { 0x01, 0x00, 0x5e, ip[1] & 0x7f, ip[2], ip[3] };
+
+    rx_filter_group(netif, mac, action);
+    return ERR_OK;
+}
+#endif
+
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+static err_t rx_filter_mld_mac(struct netif *netif, const ip6_addr_t *group, enum netif_mac_filter_action action)
+{
+    const uint8_t *ip     = (const uint8_t *)&group->addr[3];
+    uint8_t       mac[6]  = { 0x33, 0x33, ip[0], ip[1], ip[2], ip[3] };
+
+    rx_filter_group(netif, mac, action);
+    return ERR_OK;
+}
+#endif
+
+void wifi_rx_filter_netif_init(struct netif *netif)
+{
+    int i;
+
+    for (i = 0; i < RX_FILTER_NETIFS; i++)
+    {
+        if (s_rx_filter_netifs[i].netif == NULL || s_rx_filter_netifs[i].netif == netif)
+        {
+            s_rx_filter_netifs[i].netif    = netif;
+            s_rx_filter_netifs[i].overflow = false;
+            break;
+        }
+    }
+    if (i == RX_FILTER_NETIFS)
+    {
+        return;
+    }
+
+#if LWIP_IPV4 && LWIP_IGMP
+    netif_set_igmp_mac_filter(netif, rx_filter_igmp_mac);
+#endif
+#if LWIP_IPV6 && LWIP_IPV6_MLD
+    netif_set_mld_mac_filter(netif, rx_filter_mld_mac);
+#endif
+}
+
+static bool rx_filter_mcast_joined(struct netif *netif, const uint8_t *mac)
+{
+    static const uint8_t all_hosts[6] = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x01 };
+    static const uint8_t all_nodes[6] = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 };
+    rx_filter_netif_t    *nif = rx_filter_find_netif(netif);
+    int                  i;
+
+    /* a netif the callbacks do not report for is not filtered */
+    if (nif == NULL || nif->overflow || !memcmp(mac, all_hosts, 6) || !memcmp(mac, all_nodes, 6))
+    {
+        return true;
+    }
+    for (i = 0; i < RX_FILTER_GROUPS; i++)
+    {
+        if (s_rx_filter_groups[i].refs && s_rx_filter_groups[i].netif == netif && !memcmp(s_rx_filter_groups[i].mac, mac, 6))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/****************************************************************************
+*                                   ARP
+****************************************************************************/
+/* true when consumed */
+static bool rx_filter_arp(struct netif *netif, const uint8_t *frame, uint16_t len)
+{
+    uint32_t ip = netif_ip4_addr(netif)->addr;
+    uint32_t gw = netif_ip4_gw(netif)->addr;
+
+    /* no address yet, conflict detection needs to see everything */
+    if (len < ARP_FRAME_LEN || ip == 0)
+    {
+        return false;
+    }
+
+    if (frame[21] == ARP_OP_REQUEST && frame[20] == 0 && !memcmp(&frame[38], &ip, 4))
+    {
+        /* etharp answers and learns the requester from the same frame */
+        return false;
+    }
+    if (frame[0] & 1)
+    {
+        /* someone else's request, or a broadcast reply: only the gateway and
+         * gratuitous ARP (sender == target, an address moved) matter to lwIP */
+        if (memcmp(&frame[28], &gw, 4) && memcmp(&frame[28], &ip, 4) && memcmp(&frame[28], &frame[38], 4))
+        {
+            s_rx_filter_stats.arp_dropped++;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/****************************************************************************
+*                                   Rules
+****************************************************************************/
+bool wifi_rx_filter_input(struct netif *netif, const uint8_t *frame, uint16_t len)
+{
+    uint16_t     type, port = 0;
+    uint8_t      cast, proto = 0;
+    unsigned int psw, hl;
+    bool         drop = false;
+    int          i;
+
+    if (!s_rx_filter_on || len < ETH_HLEN)
+    {
+        return false;
+    }
+    s_rx_filter_stats.frames++;
+
+    type = (frame[12] << 8) | frame[13];
+    if (!(frame[0] & 1))
+    {
+        cast = WIFI_RX_FILTER_UCAST;
+    }
+    else if ((frame[0] & frame[1] & frame[2] & frame[3] & frame[4] & frame[5]) == 0xff)
+    {
+        cast = WIFI_RX_FILTER_BCAST;
+    }
+    else
+    {
+        cast = WIFI_RX_FILTER_MCAST;
+        if (!rx_filter_mcast_joined(netif, frame))
+        {
+            s_rx_filter_stats.mcast_dropped++;
+            return true;
+        }
+    }
+
+    if (type == ETHTYPE_ARP)
+    {
+        if (rx_filter_arp(netif, frame, len))
+        {
+            return true;
+        }
+    }
+    else if (type == ETHTYPE_IP && len >= ETH_HLEN + IP_HLEN)
+    {
+        hl    = (frame[ETH_HLEN] & 0x0f) * 4;
+        proto = frame[ETH_HLEN + 9];
+        /* ports are in the first fragment only */
+        if ((proto == IP_PROTO_UDP || proto == IP_PROTO_TCP) && !(frame[ETH_HLEN + 6] & 0x1f) && !frame[ETH_HLEN + 7]
+            && len >= ETH_HLEN + hl + 4)
+        {
+            port = (frame[ETH_HLEN + hl + 2] << 8) | frame[ETH_HLEN + hl + 3];
+        }
+    }
+    else if (type == ETHTYPE_IPV6 && len >= ETH_HLEN + 40)
+    {
+        proto = frame[ETH_HLEN + 6];
+        if ((proto == IP_PROTO_UDP || proto == IP_PROTO_TCP) && len >= ETH_HLEN + 40 + 4)
+        {
+            port = (frame[ETH_HLEN + 40 + 2] << 8) | frame[ETH_HLEN + 40 + 3];
+        }
+    }
+    else if (type == ETHTYPE_EAPOL)
+    {
+        return false;
+    }
+
+    if (proto == IP_PROTO_UDP && (port == PORT_DHCP_CLIENT || port == PORT_DHCP6_CLIENT))
+    {
+        return false;
+    }
+
+    psw = system_irq_save();
+    for (i = 0; i < s_rx_filter_count; i++)
+    {
+        rx_filter_rule_t *r = &s_rx_filter_rules[i];
+
+        if ((r->rule.cast && !(r->rule.cast & cast))
+            || (r->rule.ethertype && r->rule.ethertype != type)
+            || (r->rule.ip_proto && r->rule.ip_proto != proto)
+            || ((r->rule.port_min || r->rule.port_max) && (port < r->rule.port_min || port > r->rule.port_max)))
+        {
+            continue;
+        }
+        r->hits++;
+        drop = (r->rule.action == WIFI_RX_FILTER_DROP);
+        break;
+    }
+    system_irq_restore(psw);
+
+    if (drop)
+    {
+        s_rx_filter_stats.rule_dropped++;
+    }
+    return drop;
+}
+
+void wifi_rx_filter_enable(bool enable)
+{
+    s_rx_filter_on = enable;
+}
+
+int wifi_rx_filter_add(const wifi_rx_filter_rule_t *rule)
+{
+    unsigned int psw;
+    int          id = -1;
+
+    psw = system_irq_save();
+    if (s_rx_filter_count < RX_FILTER_RULES)
+    {
+        id = s_rx_filter_next_id++;
+        s_rx_filter_rules[s_rx_filter_count].rule = *rule;
+        s_rx_filter_rules[s_rx_filter_count].id   = id;
+        s_rx_filter_rules[s_rx_filter_count].hits = 0;
+        s_rx_filter_count++;
+    }
+    system_irq_restore(psw);
+    return id;
+}
+
+int wifi_rx_filter_del(int id)
+{
+    unsigned int psw;
+    int          i, ret = -1;
+
+    psw = system_irq_save();
+    for (i = 0; i < s_rx_filter_count; i++)
+    {
+        if (s_rx_filter_rules[i].id == id)
+        {
+            memmove(&s_rx_filter_rules[i], &s_rx_filter_rules[i + 1], (s_rx_filter_count - i - 1) * sizeof(s_rx_filter_rules[0]));
+            s_rx_filter_count--;
+            ret = 0;
+            break;
+        }
+    }
+    system_irq_restore(psw);
+    return ret;
+}
+
+void wifi_rx_filter_clear(void)
+{
+    unsigned int psw = system_irq_save();
+
+    s_rx_filter_count = 0;
+    system_irq_restore(psw);
+}
+
+int wifi_rx_filter_get(int index, wifi_rx_filter_rule_t *rule, uint32_t *hits)
+{
+    unsigned int psw;
+    int          id = -1;
+
+    psw = system_irq_save();
+    if (index >= 0 && index < s_rx_filter_count)
+    {
+        *rule = s_rx_filter_rules[index].rule;
+        *hits = s_rx_filter_rules[index].hits;
+        id    = s_rx_filter_rules[index].id;
+    }
+    system_irq_restore(psw);
+    return id;
+}
+
+int wifi_rx_filter_udp_whitelist(const uint16_t *ports, int count)
+{
+    wifi_rx_filter_rule_t rule;
+    int                   i;
+
+    if (count + 1 > RX_FILTER_RULES)
+    {
+        return -1;
+    }
+
+    wifi_rx_filter_clear();
+    memset(&rule, 0, sizeof(rule));
+    rule.cast      = WIFI_RX_FILTER_MCAST | WIFI_RX_FILTER_BCAST;
+    rule.ip_proto  = IP_PROTO_UDP;
+    for (i = 0; i < count; i++)
+    {
+        rule.action   = WIFI_RX_FILTER_PASS;
+        rule.port_min = rule.port_max = ports[i];
+        wifi_rx_filter_add(&rule);
+    }
+    rule.action   = WIFI_RX_FILTER_DROP;
+    rule.port_min = rule.port_max = 0;
+    wifi_rx_filter_add(&rule);
+    return 0;
+}
+
+void wifi_rx_filter_get_stats(wifi_rx_filter_stats_t *stats, bool reset)
+{
+    unsigned int psw = system_irq_save();
+    int          i;
+
+    *stats = s_rx_filter_stats;
+    if (reset)
+    {
+        memset(&s_rx_filter_stats, 0, sizeof(s_rx_filter_stats));
+        for (i = 0; i < s_rx_filter_count; i++)
+        {
+            s_rx_filter_rules[i].hits = 0;
+        }
+    }
+    system_irq_restore(psw);
+}
@@ -16,10 +16,38 @@
 #include <string.h>
 #include <stdbool.h>
 #include "wifi_sniffer.h"
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+#include "oshal.h"
+#endif
 
 static bool promiscuous_en = false;
 static wifi_promiscuous_cfg_t  promiscuous_cfg = {{WIFI_PROMIS_FILTER_MASK_ALL}, NULL};
 
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+#define BATCH_SLOTS             CONFIG_WIFI_SNIFFER_BATCH_SLOTS
+#define BATCH_SNAPLEN           CONFIG_WIFI_SNIFFER_BATCH_SNAPLEN
+#define BATCH_TASK_PRIORITY     5
+#define BATCH_TASK_STACK        4096
+
+/* rx path fills head, the sniffer task hands [tail, head) to the callback */
+static struct {
+	bool                        on;
+	volatile bool               stop;
+	volatile int                task;
+	os_sem_handle_t             sem;
+	wifi_sniffer_batch_cfg_t    cfg;
+	wifi_sniffer_frame_t        *meta;
+	uint8_t                     *data;
+	volatile uint32_t           head;
+	volatile uint32_t           tail;
+	uint8_t                     channel;
+	wifi_sniffer_batch_stats_t  stats;
+} s_batch;
+
+static int wifi_sniffer_batch_put(void *rx_head, uint8_t *frame, uint16_t len);
+static void wifi_sniffer_batch_end(void);
+#endif
+
 typedef struct _GenericMacHeader {
     // Word 0 : MAC Header Word 0
     // 16 bit Frame Control
@@ -77,6 +105,9 @@ int wifi_set_promiscuous(bool en)
 			fhost_start_monitor();
 			fhost_set_filter(promiscuous_cfg.filter.filter_mask);
 		} else {
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+			wifi_sniffer_batch_end();
+#endif
 			fhost_stop_monitor();
 			promiscuous_cfg.promisc_cb = NULL;
 			promiscuous_cfg.filter.filter_mask = WIFI_PROMIS_FILTER_MASK_ALL;
@@ -125,6 +156,12 @@ int process_promiscuous_frame(void* rx_head, void* mac_head, uint8_t *frame, uin
     {
         return -1;
     }
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+    if(s_batch.on)
+    {
+        return wifi_sniffer_batch_put(rx_head, frame, len);
+    }
+#endif
 #if CFG_UF
     if (rx_head && !mac_head && !frame && !len)
     {
@@ -173,3 +210,214 @@ drop:
 	return 0;
 }
 
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+extern uint8_t wifi_rf_get_channel(void);
+
+static int wifi_sniffer_batch_put(void *rx_head, uint8_t *frame, uint16_t len)
+{
+	wifi_pkt_rx_ctrl_t *rx_ctrl = (wifi_pkt_rx_ctrl_t *)rx_head;
+	wifi_sniffer_frame_t *f;
+	uint8_t type, subtype = 0, flags = 0;
+	uint32_t slot;
+	unsigned int psw;
+	bool post = false;
+
+	if(frame == NULL || len == 0){
+		/* rx vector only */
+		type = WIFI_PKT_NULL;
+		len = (rx_ctrl->length_h << 8) | rx_ctrl->length_l;
+		frame = NULL;
+	} else if(len >= 10){
+		type = (frame[0] >> 2) & 0x3;
+		subtype = frame[0] >> 4;
+		flags = frame[1];
+	} else {
+		type = WIFI_PKT_NULL + 1;
+	}
+
+	if(type > WIFI_PKT_NULL
+		|| !(s_batch.cfg.subtypes[type] & (type == WIFI_PKT_NULL ? 0xffff : 1 << subtype))
+		|| (s_batch.cfg.no_retry && (flags & 0x08))){
+		s_batch.stats.filtered++;
+		return 0;
+	}
+
+	/* wifi_sniffer_batch_stop() frees the ring once on is clear */
+	psw = system_irq_save();
+	if(!s_batch.on){
+		system_irq_restore(psw);
+		return 0;
+	}
+	if(s_batch.head - s_batch.tail >= BATCH_SLOTS){
+		s_batch.stats.dropped++;
+		system_irq_restore(psw);
+		return 0;
+	}
+
+	slot = s_batch.head % BATCH_SLOTS;
+	f = &s_batch.meta[slot];
+	memset(f, 0, sizeof(*f));
+	f->len = len;
+	f->type = type;
+	f->subtype = subtype;
+	f->flags = flags;
+	f->rssi = rx_ctrl->rssi;
+	f->channel = s_batch.channel;
+	if(frame){
+		f->frame = &s_batch.data[slot * BATCH_SNAPLEN];
+		f->caplen = len < s_batch.cfg.snaplen[type] ? len : s_batch.cfg.snaplen[type];
+		memcpy(f->frame, frame, f->caplen);
+		memcpy(f->addr1, &frame[4], 6);
+		if(len >= 16){
+			memcpy(f->addr2, &frame[10], 6);
+		}
+		if(len >= 24 && type != WIFI_PKT_CTRL){
+			memcpy(f->addr3, &frame[16], 6);
+			f->seq = (frame[22] | (frame[23] << 8)) >> 4;
+		}
+	}
+	s_batch.head++;
+	s_batch.stats.frames++;
+	post = (s_batch.head - s_batch.tail == BATCH_SLOTS / 2);
+	system_irq_restore(psw);
+
+	if(post){
+		os_sem_post(s_batch.sem);
+	}
+	return 0;
+}
+
+static void wifi_sniffer_batch_task(void *arg)
+{
+	uint32_t count, slot;
+
+	while(!s_batch.stop){
+		os_sem_wait(s_batch.sem, CONFIG_WIFI_SNIFFER_BATCH_MS);
+		while(!s_batch.stop && (count = s_batch.head - s_batch.tail) != 0){
+			/* up to the end of the ring, the rest in the next round */
+			slot = s_batch.tail % BATCH_SLOTS;
+			if(count > BATCH_SLOTS - slot){
+				count = BATCH_SLOTS - slot;
+			}
+			s_batch.cfg.cb(&s_batch.meta[slot], count);
+			s_batch.tail += count;
+			s_batch.stats.batches++;
+		}
+	}
+
+	/* the semaphore stays, wifi_sniffer_batch_end() may post it late */
+	os_free(s_batch.meta);
+	s_batch.meta = NULL;
+	s_batch.data = NULL;
+	s_batch.task = 0;
+	os_task_delete(0);
+}
+
+int wifi_sniffer_batch_start(const wifi_sniffer_batch_cfg_t *cfg)
+{
+	wifi_promiscuous_filter_t filter = {0};
+	int i;
+
+	if(cfg == NULL || cfg->cb == NULL || s_batch.on){
+		return -1;
+	}
+	/* the task of the last start may still be in its last callback */
+	while(s_batch.task){
+		os_msleep(10);
+	}
+
+	if(s_batch.sem == NULL){
+		s_batch.sem = os_sem_create(1, 0);
+	}
+	s_batch.meta = os_malloc(BATCH_SLOTS * (sizeof(wifi_sniffer_frame_t) + BATCH_SNAPLEN));
+	if(s_batch.meta == NULL || s_batch.sem == NULL){
+		goto fail;
+	}
+	s_batch.data = (uint8_t *)&s_batch.meta[BATCH_SLOTS];
+	s_batch.cfg = *cfg;
+	for(i = 0; i < WIFI_PKT_NULL; i++){
+		if(s_batch.cfg.snaplen[i] > BATCH_SNAPLEN){
+			s_batch.cfg.snaplen[i] = BATCH_SNAPLEN;
+		}
+	}
+	s_batch.head = s_batch.tail = 0;
+	s_batch.stop = false;
+	s_batch.channel = wifi_rf_get_channel();
+	memset(&s_batch.stats, 0, sizeof(s_batch.stats));
+
+	s_batch.task = os_task_create("sniffer", BATCH_TASK_PRIORITY, BATCH_TASK_STACK, wifi_sniffer_batch_task, NULL);
+	if(s_batch.task == -1){
+		s_batch.task = 0;
+		goto fail;
+	}
+
+	/* let the lower layer drop the types nobody wants */
+	filter.filter_mask = (cfg->subtypes[WIFI_PKT_MGMT] ? WIFI_PROMIS_FILTER_MASK_MGMT : 0)
+					   | (cfg->subtypes[WIFI_PKT_CTRL] ? WIFI_PROMIS_FILTER_MASK_CTRL : 0)
+					   | (cfg->subtypes[WIFI_PKT_DATA] ? WIFI_PROMIS_FILTER_MASK_DATA : 0);
+	wifi_set_promiscuous_filter(&filter);
+	s_batch.on = true;
+	wifi_set_promiscuous(true);
+	return 0;
+
+fail:
+	if(s_batch.meta){
+		os_free(s_batch.meta);
+		s_batch.meta = NULL;
+	}
+	return -1;
+}
+
+int wifi_sniffer_batch_filter(wifi_promiscuous_pkt_type_t type, uint16_t subtypes)
+{
+	wifi_promiscuous_filter_t filter;
+
+	if(type > WIFI_PKT_NULL){
+		return -1;
+	}
+	s_batch.cfg.subtypes[type] = subtypes;
+	if(type != WIFI_PKT_NULL && s_batch.on){
+		wifi_get_promiscuous_filter(&filter);
+		if(subtypes){
+			filter.filter_mask |= 1 << type;
+		}else{
+			filter.filter_mask &= ~(1 << type);
+		}
+		wifi_set_promiscuous_filter(&filter);
+	}
+	return 0;
+}
+
+void wifi_sniffer_batch_stop(void)
+{
+	wifi_set_promiscuous(false);
+}
+
+/* the task frees the ring once it sees stop, after the callback it may be in */
+static void wifi_sniffer_batch_end(void)
+{
+	unsigned int psw;
+
+	if(!s_batch.on){
+		return;
+	}
+	psw = system_irq_save();
+	s_batch.on = false;
+	s_batch.stop = true;
+	system_irq_restore(psw);
+	os_sem_post(s_batch.sem);
+}
+
+void wifi_sniffer_batch_get_stats(wifi_sniffer_batch_stats_t *stats)
+{
+	unsigned int psw = system_irq_save();
+
+	*stats = s_batch.stats;
+	system_irq_restore(psw);
+}
+
+void wifi_sniffer_batch_channel(uint8_t channel)
+{
+	s_batch.channel = channel;
+}
+#endif
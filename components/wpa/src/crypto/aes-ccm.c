@@ -13,6 +13,19 @@
 #include "aes.h"
 #include "aes_wrap.h"
 
+#ifdef CONFIG_WPA_HW_AES_CCM
+#include "drivers/aes/aes.h"
+
+/*
+ * The engine keeps the key loaded between drv_aes_lock() and
+ * drv_aes_unlock(), the aes handle is not used in that case.
+ */
+#define AES_CCM_HW_BATCH	8
+#define aes_ccm_block(aes, in, out)	drv_aes_ecb_crypt(in, out, AES_BLOCK_SIZE)
+#else
+#define aes_ccm_block(aes, in, out)	aes_encrypt(aes, in, out)
+#endif
+
 
 static void xor_aes_block(u8 *dst, const u8 *src)
 {
@@ -41,7 +54,7 @@ static void aes_ccm_auth_start(void *aes, size_t M, size_t L, const u8 *nonce,
 	WPA_PUT_BE16(&b[AES_BLOCK_SIZE - L], plain_len);
 
 	wpa_hexdump_key(MSG_EXCESSIVE, "CCM B_0", b, AES_BLOCK_SIZE);
-	aes_encrypt(aes, b, x); /* X_1 = E(K, B_0) */
+	aes_ccm_block(aes, b, x); /* X_1 = E(K, B_0) */
 
 	if (!aad_len)
 		return;
@@ -51,12 +64,12 @@ static void aes_ccm_auth_start(void *aes, size_t M, size_t L, const u8 *nonce,
 	os_memset(aad_buf + 2 + aad_len, 0, sizeof(aad_buf) - 2 - aad_len);
 
 	xor_aes_block(aad_buf, x);
-	aes_encrypt(aes, aad_buf, x); /* X_2 = E(K, X_1 XOR B_1) */
+	aes_ccm_block(aes, aad_buf, x); /* X_2 = E(K, X_1 XOR B_1) */
 
 	if (aad_len > AES_BLOCK_SIZE - 2) {
 		xor_aes_block(&aad_buf[AES_BLOCK_SIZE], x);
 		/* X_3 = E(K, X_2 XOR B_2) */
-		aes_encrypt(aes, &aad_buf[AES_BLOCK_SIZE], x);
+		aes_ccm_block(aes, &aad_buf[AES_BLOCK_SIZE], x);
 	}
 }
 
@@ -66,17 +79,31 @@ static void aes_ccm_auth(void *aes, const u8 *data, size_t len, u8 *x)
 	size_t last = len % AES_BLOCK_SIZE;
 	size_t i;
 
+#ifdef CONFIG_WPA_HW_AES_CCM
+	u8 scratch[AES_CCM_HW_BATCH * AES_BLOCK_SIZE];
+	size_t chunk;
+
+	/* X_i+1 = E(K, X_i XOR B_i) is CBC with X as the IV */
+	len -= last;
+	while (len) {
+		chunk = len > sizeof(scratch) ? sizeof(scratch) : len;
+		drv_aes_cbc_crypt(DRV_AES_MODE_ENC, x, data, scratch, chunk);
+		data += chunk;
+		len -= chunk;
+	}
+#else
 	for (i = 0; i < len / AES_BLOCK_SIZE; i++) {
 		/* X_i+1 = E(K, X_i XOR B_i) */
 		xor_aes_block(x, data);
 		data += AES_BLOCK_SIZE;
 		aes_encrypt(aes, x, x);
 	}
+#endif
 	if (last) {
 		/* XOR zero-padded last block */
 		for (i = 0; i < last; i++)
 			x[i] ^= *data++;
-		aes_encrypt(aes, x, x);
+		aes_ccm_block(aes, x, x);
 	}
 }
 
@@ -92,6 +119,17 @@ static void aes_ccm_encr_start(size_t L, const u8 *nonce, u8 *a)
 static void aes_ccm_encr(void *aes, size_t L, const u8 *in, size_t len, u8 *out,
 			 u8 *a)
 {
+#ifdef CONFIG_WPA_HW_AES_CCM
+	u8 stream[AES_BLOCK_SIZE];
+	unsigned int off = 0;
+
+	/*
+	 * crypt = msg XOR (S_1 | S_2 | ... | S_n), the engine counts A_i up
+	 * from 1; with L=2 the counter cannot carry into the nonce.
+	 */
+	WPA_PUT_BE16(&a[AES_BLOCK_SIZE - 2], 1);
+	drv_aes_ctr_crypt(&off, a, stream, in, out, len);
+#else
 	size_t last = len % AES_BLOCK_SIZE;
 	size_t i;
 
@@ -111,6 +149,7 @@ static void aes_ccm_encr(void *aes, size_t L, const u8 *in, size_t len, u8 *out,
 		for (i = 0; i < last; i++)
 			*out++ ^= *in++;
 	}
+#endif
 }
 
 
@@ -122,7 +161,7 @@ static void aes_ccm_encr_auth(void *aes, size_t M, u8 *x, u8 *a, u8 *auth)
 	wpa_hexdump_key(MSG_EXCESSIVE, "CCM T", x, M);
 	/* U = T XOR S_0; S_0 = E(K, A_0) */
 	WPA_PUT_BE16(&a[AES_BLOCK_SIZE - 2], 0);
-	aes_encrypt(aes, a, tmp);
+	aes_ccm_block(aes, a, tmp);
 	for (i = 0; i < M; i++)
 		auth[i] = x[i] ^ tmp[i];
 	wpa_hexdump_key(MSG_EXCESSIVE, "CCM U", auth, M);
@@ -137,13 +176,42 @@ static void aes_ccm_decr_auth(void *aes, size_t M, u8 *a, const u8 *auth, u8 *t)
 	wpa_hexdump_key(MSG_EXCESSIVE, "CCM U", auth, M);
 	/* U = T XOR S_0; S_0 = E(K, A_0) */
 	WPA_PUT_BE16(&a[AES_BLOCK_SIZE - 2], 0);
-	aes_encrypt(aes, a, tmp);
+	aes_ccm_block(aes, a, tmp);
 	for (i = 0; i < M; i++)
 		t[i] = auth[i] ^ tmp[i];
 	wpa_hexdump_key(MSG_EXCESSIVE, "CCM T", t, M);
 }
 
 
+static void * aes_ccm_key_init(const u8 *key, size_t key_len)
+{
+#ifdef CONFIG_WPA_HW_AES_CCM
+	static u8 hw_handle;
+
+	if (drv_aes_lock() != AES_RET_SUCCESS)
+		return NULL;
+	if (drv_aes_ecb_setkey(key, key_len * 8, DRV_AES_MODE_ENC) !=
+	    AES_RET_SUCCESS) {
+		drv_aes_unlock();
+		return NULL;
+	}
+	return &hw_handle;
+#else
+	return aes_encrypt_init(key, key_len);
+#endif
+}
+
+
+static void aes_ccm_key_deinit(void *aes)
+{
+#ifdef CONFIG_WPA_HW_AES_CCM
+	drv_aes_unlock();
+#else
+	aes_encrypt_deinit(aes);
+#endif
+}
+
+
 /* AES-CCM with fixed L=2 and aad_len <= 30 assumption */
 int aes_ccm_ae(const u8 *key, size_t key_len, const u8 *nonce,
 	       size_t M, const u8 *plain, size_t plain_len,
@@ -156,7 +224,7 @@ int aes_ccm_ae(const u8 *key, size_t key_len, const u8 *nonce,
 	if (aad_len > 30 || M > AES_BLOCK_SIZE)
 		return -1;
 
-	aes = aes_encrypt_init(key, key_len);
+	aes = aes_ccm_key_init(key, key_len);
 	if (aes == NULL)
 		return -1;
 
@@ -168,7 +236,7 @@ int aes_ccm_ae(const u8 *key, size_t key_len, const u8 *nonce,
 	aes_ccm_encr(aes, L, plain, plain_len, crypt, a);
 	aes_ccm_encr_auth(aes, M, x, a, auth);
 
-	aes_encrypt_deinit(aes);
+	aes_ccm_key_deinit(aes);
 
 	return 0;
 }
@@ -187,7 +255,7 @@ int aes_ccm_ad(const u8 *key, size_t key_len, const u8 *nonce,
 	if (aad_len > 30 || M > AES_BLOCK_SIZE)
 		return -1;
 
-	aes = aes_encrypt_init(key, key_len);
+	aes = aes_ccm_key_init(key, key_len);
 	if (aes == NULL)
 		return -1;
 
@@ -201,7 +269,7 @@ int aes_ccm_ad(const u8 *key, size_t key_len, const u8 *nonce,
 	aes_ccm_auth_start(aes, M, L, nonce, aad, aad_len, crypt_len, x);
 	aes_ccm_auth(aes, plain, crypt_len, x);
 
-	aes_encrypt_deinit(aes);
+	aes_ccm_key_deinit(aes);
 
 	if (os_memcmp_const(x, t, M) != 0) {
 		wpa_printf(MSG_EXCESSIVE, "CCM: Auth mismatch");
@@ -87,6 +87,7 @@ static os_mutex_handle_t drv_aes_mutex;
 
 //int drv_aes_init(void) __attribute__((section(".ilm_text_drv")));
 void drv_aes_crypt(const unsigned char input[16], unsigned char output[16]) __attribute__((section(".ilm_text_drv")));
+int drv_aes_ecb_crypt(const unsigned char *input, unsigned char *output, unsigned int len) __attribute__((section(".ilm_text_drv")));
 
 
 /**
@@ -266,6 +267,206 @@ void drv_aes_crypt(const unsigned char input[16], unsigned char output[16])
 
 }
 
+/**
+@brief      Feed one block through the engine, word aligned buffers are accessed directly
+@param[in]  input:16 bytes to be processed
+@param[out] output:16 bytes result, may be the same as input
+*/
+static inline void aes_block_io(const unsigned char *input, unsigned char *output)
+{
+	unsigned int i, data;
+	unsigned long flags;
+
+	flags = system_irq_save();
+	if (((unsigned int)input & 0x3) == 0)
+	{
+		for (i = 0; i < AES_BLOCK_SIZE; i++)
+		{
+			ASE_REG_BASE->Data = ((const unsigned int *)input)[i];
+		}
+	}
+	else
+	{
+		for (i = 0; i < AES_BLOCK_SIZE; i++)
+		{
+			AES_GET_UINT32(data, input, i*AES_WORD_OFFSET);
+			ASE_REG_BASE->Data = data;
+		}
+	}
+
+	while ((ASE_REG_BASE->Status) == 0);
+	system_irq_restore(flags);
+
+	while ((ASE_REG_BASE->Status) == 1);
+
+	if (((unsigned int)output & 0x3) == 0)
+	{
+		for (i = 0; i < AES_BLOCK_SIZE; i++)
+		{
+			((unsigned int *)output)[i] = ASE_REG_BASE->Data;
+		}
+	}
+	else
+	{
+		for (i = 0; i < AES_BLOCK_SIZE; i++)
+		{
+			data = ASE_REG_BASE->Data;
+			AES_PUT_UINT32(data, output, i*AES_WORD_OFFSET);
+		}
+	}
+}
+
+/**
+@brief      Stream a buffer of whole blocks through the engine as configured by the last setkey
+@details    The key stays loaded for the whole buffer, so this is ECB with a key loaded by
+            drv_aes_ecb_setkey, and hardware CBC with drv_aes_cbc_setkey.
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count, a multiple of 16
+*/
+int drv_aes_ecb_crypt(const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	if ((input == NULL) || (output == NULL) || (len & (DRV_AES_BLOCK_BYTES - 1)))
+	{
+		return AES_RET_EINVAL;
+	}
+
+	while (len)
+	{
+		aes_block_io(input, output);
+		input += DRV_AES_BLOCK_BYTES;
+		output += DRV_AES_BLOCK_BYTES;
+		len -= DRV_AES_BLOCK_BYTES;
+	}
+
+	return AES_RET_SUCCESS;
+}
+
+/**
+@brief      CBC over a key loaded by drv_aes_ecb_setkey, chaining done here so the iv is returned
+@param[in]  mode:DRV_AES_MODE_ENC or DRV_AES_MODE_DEC, must match the setkey direction
+@param[in,out] iv:16 bytes, updated to the last cipher block for the next call
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count, a multiple of 16
+*/
+int drv_aes_cbc_crypt(int mode, unsigned char iv[16], const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	unsigned char tmp[DRV_AES_BLOCK_BYTES];
+	unsigned int i;
+
+	if ((iv == NULL) || (input == NULL) || (output == NULL) || (len & (DRV_AES_BLOCK_BYTES - 1)))
+	{
+		return AES_RET_EINVAL;
+	}
+
+	if (mode == DRV_AES_MODE_ENC)
+	{
+		while (len)
+		{
+			for (i = 0; i < DRV_AES_BLOCK_BYTES; i++)
+			{
+				tmp[i] = input[i] ^ iv[i];
+			}
+			aes_block_io(tmp, output);
+			memcpy(iv, output, DRV_AES_BLOCK_BYTES);
+			input += DRV_AES_BLOCK_BYTES;
+			output += DRV_AES_BLOCK_BYTES;
+			len -= DRV_AES_BLOCK_BYTES;
+		}
+	}
+	else if (mode == DRV_AES_MODE_DEC)
+	{
+		while (len)
+		{
+			memcpy(tmp, input, DRV_AES_BLOCK_BYTES);
+			aes_block_io(input, output);
+			for (i = 0; i < DRV_AES_BLOCK_BYTES; i++)
+			{
+				output[i] ^= iv[i];
+			}
+			memcpy(iv, tmp, DRV_AES_BLOCK_BYTES);
+			input += DRV_AES_BLOCK_BYTES;
+			output += DRV_AES_BLOCK_BYTES;
+			len -= DRV_AES_BLOCK_BYTES;
+		}
+	}
+	else
+	{
+		return AES_RET_EMODE;
+	}
+
+	return AES_RET_SUCCESS;
+}
+
+/**
+@brief      CTR over a key loaded by drv_aes_ecb_setkey in encryption mode
+@details    Same calling convention as mbedtls_aes_crypt_ctr: the 128 bit big endian counter
+            and the unused tail of the last keystream block carry over between calls.
+            Counter blocks are generated DRV_AES_CTR_BATCH at a time and pushed through
+            the engine back to back.
+@param[in,out] nc_off:offset into stream_block, 0 on the first call
+@param[in,out] nonce_counter:16 bytes counter block
+@param[in,out] stream_block:16 bytes saved keystream
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count, any length
+*/
+int drv_aes_ctr_crypt(unsigned int *nc_off, unsigned char nonce_counter[16], unsigned char stream_block[16],
+					const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	unsigned char ks[DRV_AES_CTR_BATCH * DRV_AES_BLOCK_BYTES] __attribute__((aligned(4)));
+	unsigned int n, i, j, blocks;
+
+	if ((nc_off == NULL) || (*nc_off >= DRV_AES_BLOCK_BYTES) || (nonce_counter == NULL) || (stream_block == NULL))
+	{
+		return AES_RET_EINVAL;
+	}
+
+	/**use up the keystream left over from the previous call*/
+	n = *nc_off;
+	while (n && len)
+	{
+		*output++ = *input++ ^ stream_block[n];
+		n = (n + 1) & (DRV_AES_BLOCK_BYTES - 1);
+		len--;
+	}
+
+	while (len)
+	{
+		blocks = (len + DRV_AES_BLOCK_BYTES - 1) / DRV_AES_BLOCK_BYTES;
+		blocks = (blocks > DRV_AES_CTR_BATCH) ? DRV_AES_CTR_BATCH : blocks;
+		for (i = 0; i < blocks; i++)
+		{
+			memcpy(&ks[i * DRV_AES_BLOCK_BYTES], nonce_counter, DRV_AES_BLOCK_BYTES);
+			for (j = DRV_AES_BLOCK_BYTES; j > 0; j--)
+			{
+				if (++nonce_counter[j - 1] != 0)
+				{
+					break;
+				}
+			}
+		}
+		drv_aes_ecb_crypt(ks, ks, blocks * DRV_AES_BLOCK_BYTES);
+
+		for (i = 0; (i < blocks * DRV_AES_BLOCK_BYTES) && len; i++, len--)
+		{
+			*output++ = *input++ ^ ks[i];
+		}
+
+		/**keep a partly used keystream block for the next call*/
+		n = i & (DRV_AES_BLOCK_BYTES - 1);
+		if (n)
+		{
+			memcpy(stream_block, &ks[i - n], DRV_AES_BLOCK_BYTES);
+		}
+	}
+
+	*nc_off = n;
+
+	return AES_RET_SUCCESS;
+}
+
 /**
 @brief    Before using aes, enable aes clock
 */
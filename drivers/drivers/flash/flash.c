@@ -29,6 +29,7 @@
 #endif
 
 #include "flash_internal.h"
+#include "systrace.h"
 
 #include "hal_aes.h"
 #include "aes.h"
@@ -1001,6 +1002,7 @@ int drv_spiflash_erase(unsigned int addr,  unsigned int len)
 	}
 
 	eraseSectorCnt = len / SPIFLASH_SECTOR_SIZE;
+	SYSTRACE_BEGIN(SYSTRACE_EV_FLASH_ERASE, 0, addr, len);
 	
 	#ifdef CONFIG_PSM_SURPORT
 		psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_ACTIVE);
@@ -1041,6 +1043,7 @@ int drv_spiflash_erase(unsigned int addr,  unsigned int len)
 			#ifdef CONFIG_PSM_SURPORT
 				psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 			#endif
+			SYSTRACE_END(SYSTRACE_EV_FLASH_ERASE, 0, FLASH_RET_WREN_NOT_SET, 0);
 			return FLASH_RET_WREN_NOT_SET;
 		}
 
@@ -1066,6 +1069,7 @@ int drv_spiflash_erase(unsigned int addr,  unsigned int len)
 			#ifdef CONFIG_PSM_SURPORT
 				psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 			#endif
+			SYSTRACE_END(SYSTRACE_EV_FLASH_ERASE, 0, FLASH_RET_WIP_NOT_SET, 0);
 			return FLASH_RET_WIP_NOT_SET;
 		}
 		
@@ -1076,6 +1080,7 @@ int drv_spiflash_erase(unsigned int addr,  unsigned int len)
 		psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 	#endif
 
+	SYSTRACE_END(SYSTRACE_EV_FLASH_ERASE, 0, FLASH_RET_SUCCESS, 0);
 	return FLASH_RET_SUCCESS;
 }
 
@@ -1284,6 +1289,7 @@ int drv_spiflash_write(unsigned int addr, const unsigned char * buf, unsigned in
 	length = MIN(SPIFLASH_PAGE_SIZE - length, len);
 
 	address = addr;
+	SYSTRACE_BEGIN(SYSTRACE_EV_FLASH_WRITE, 0, addr, len);
 
 	do
 	{
@@ -1332,6 +1338,7 @@ int drv_spiflash_write(unsigned int addr, const unsigned char * buf, unsigned in
 				psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 			#endif
 			
+			SYSTRACE_END(SYSTRACE_EV_FLASH_WRITE, 0, FLASH_RET_WREN_NOT_SET, 0);
 			return FLASH_RET_WREN_NOT_SET;
 		}
 		
@@ -1365,6 +1372,7 @@ int drv_spiflash_write(unsigned int addr, const unsigned char * buf, unsigned in
 				psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 			#endif
 			
+			SYSTRACE_END(SYSTRACE_EV_FLASH_WRITE, 0, FLASH_RET_WIP_NOT_SET, 0);
 			return FLASH_RET_WIP_NOT_SET;
 		}
 		
@@ -1380,6 +1388,7 @@ int drv_spiflash_write(unsigned int addr, const unsigned char * buf, unsigned in
 		psm_set_device_status(PSM_DEVICE_SPI_FLASH,PSM_DEVICE_STATUS_IDLE);
 	#endif
 
+	SYSTRACE_END(SYSTRACE_EV_FLASH_WRITE, 0, FLASH_RET_SUCCESS, 0);
 	return FLASH_RET_SUCCESS;
 }
 
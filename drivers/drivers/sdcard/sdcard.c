@@ -1,4 +1,3 @@
-
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
@@ -9,33 +8,69 @@
 #include "sdhci.h"
 #include "sdcard.h"
 #include "chip_irqvector.h"
+#include "chip_memmap.h"
 #include "diskio.h"
 
+#ifndef CONFIG_SDCARD_MAX_BLOCKS
+#define CONFIG_SDCARD_MAX_BLOCKS	128
+#endif
+
+#if CONFIG_SDCARD_MAX_BLOCKS > SDHCI_MAX_BLOCKS
+#define SDCARD_MAX_BLOCKS	SDHCI_MAX_BLOCKS
+#else
+#define SDCARD_MAX_BLOCKS	CONFIG_SDCARD_MAX_BLOCKS
+#endif
+
+#define SDCARD_BOUNCE_BLOCKS	(SDHCI_MAX_BUF/512)
+
+/* the sdhci master only reaches system sram, ILM/DLM are local to the core */
+#define SDCARD_DMA_BASE		MEM_BASE_RAM0
+#define SDCARD_DMA_END		(MEM_BASE_RAM1 + 0x20000)
+#define SDCARD_DMA_ADDR(p, len)	((((unsigned int)(p)) & 3) == 0 && \
+				(unsigned int)(p) >= SDCARD_DMA_BASE && (unsigned int)(p) + (len) <= SDCARD_DMA_END)
+
 //BYTE *sdcard_buff=(BYTE *)0xa0000;
 BYTE sdcard_buff[SDHCI_MAX_BUF] __attribute__((section(".dma.data"),aligned(4)));
 
+static sdcard_stats_t sdcard_stats;
 
-int sdcard_write(const BYTE *buff,LBA_t sector,UINT count)
+#ifdef CONFIG_SDCARD_CACHE
+#define SDCARD_LINES		CONFIG_SDCARD_CACHE_LINES
+#define SDCARD_LINE_SECTORS	CONFIG_SDCARD_CACHE_LINE_SECTORS
+
+typedef struct
+{
+	LBA_t base;			/* first sector, a multiple of SDCARD_LINE_SECTORS */
+	unsigned short valid;		/* sectors holding card data, one bit each */
+	unsigned short dirty;		/* sectors newer than the card */
+	unsigned int used;		/* lru stamp, 0 if the line is free */
+} sdcard_line_t;
+
+static sdcard_line_t sdcard_lines[SDCARD_LINES];
+static BYTE sdcard_line_data[SDCARD_LINES][SDCARD_LINE_SECTORS*512] __attribute__((section(".dma.data"),aligned(4)));
+static unsigned int sdcard_lru;
+static LBA_t sdcard_last = (LBA_t)-1;
+#endif
+
+
+static int sdcard_command(int write, BYTE *buff, LBA_t sector, UINT count)
 {
 	struct mmc_command sd_cmd;
 	struct mmc_data sd_data;
 	memset(&sd_cmd, 0, sizeof(sd_cmd));
 	memset(&sd_data, 0, sizeof(sd_data));
 
-	memcpy(sdcard_buff, buff, count*512);
-
 	sd_data.blksz=512;
 	sd_data.blocks=count;
-	sd_data.buff_addr = (unsigned int *)sdcard_buff;
-	//sd_data.desc_addr = (ADMA2 *)sd_adma_desc; //define in controller
-	sd_data.flags = MMC_DATA_WRITE;
+	sd_data.buff_addr = (unsigned int *)buff;
+	sd_data.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
 	sd_data.transtype = ADMA;
 
 	sd_cmd.data = &sd_data;
-	if(count == 1)
-		sd_cmd.opcode = 24;
+	if(write)
+		sd_cmd.opcode = (count == 1) ? 24 : 25;
 	else
-		sd_cmd.opcode = 25;
+		sd_cmd.opcode = (count == 1) ? 17 : 18;
 
 	if(sdcard_get_ccs() == 0)
 		sd_cmd.arg = sector*512;
@@ -43,58 +78,261 @@ int sdcard_write(const BYTE *buff,LBA_t sector,UINT count)
 		sd_cmd.arg = sector;
 	sd_cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
 
+	sdcard_stats.commands++;
 	if(sdhci_send_command(&sd_data,&sd_cmd))
 		return RES_ERROR;
+	return RES_OK;
+}
+
+/* split a request into multi-block commands, in place when the buffer is dma capable */
+static int sdcard_transfer(int write, BYTE *buff, LBA_t sector, UINT count)
+{
+	UINT n;
+
+	if(write)
+		sdcard_stats.written += count;
 	else
-		return RES_OK;
-	
+		sdcard_stats.read += count;
+
+	while(count)
+		{
+		if(SDCARD_DMA_ADDR(buff, count*512))
+			{
+			n = (count > SDCARD_MAX_BLOCKS) ? SDCARD_MAX_BLOCKS : count;
+			if(sdcard_command(write, buff, sector, n))
+				return RES_ERROR;
+			sdcard_stats.direct++;
+			}
+		else
+			{
+			n = (count > SDCARD_BOUNCE_BLOCKS) ? SDCARD_BOUNCE_BLOCKS : count;
+			if(write)
+				memcpy(sdcard_buff, buff, n*512);
+			if(sdcard_command(write, sdcard_buff, sector, n))
+				return RES_ERROR;
+			if(!write)
+				memcpy(buff, sdcard_buff, n*512);
+			sdcard_stats.bounce++;
+			}
+		buff += n*512;
+		sector += n;
+		count -= n;
+		}
+
+	return RES_OK;
 }
 
-int sdcard_read(const BYTE *buff,LBA_t sector,UINT count)
+#ifdef CONFIG_SDCARD_CACHE
+static sdcard_line_t *sdcard_cache_find(LBA_t base)
 {
-	struct mmc_command sd_cmd;
-	struct mmc_data sd_data;
-	memset(&sd_cmd, 0, sizeof(sd_cmd));
-	memset(&sd_data, 0, sizeof(sd_data));
+	int i;
 
-	sd_data.blksz=512;
-	sd_data.blocks=count;
-	sd_data.buff_addr = (unsigned int *)sdcard_buff;
-	sd_data.flags = MMC_DATA_READ;
-	sd_data.transtype = ADMA;
+	for(i=0;i<SDCARD_LINES;i++)
+		{
+		if(sdcard_lines[i].used && sdcard_lines[i].base == base)
+			return &sdcard_lines[i];
+		}
+	return NULL;
+}
 
-	sd_cmd.data = &sd_data;
-	
-	if(count == 1)
-		sd_cmd.opcode = 17;
-	else
-		sd_cmd.opcode = 18;
+static BYTE *sdcard_cache_sector(sdcard_line_t *line, int i)
+{
+	return sdcard_line_data[line - sdcard_lines] + i*512;
+}
 
-	if(sdcard_get_ccs() == 0)
-		sd_cmd.arg = sector*512;
-	else
-		sd_cmd.arg = sector;
-	sd_cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+/* write back runs of dirty sectors straight from the line */
+static int sdcard_cache_flush(sdcard_line_t *line)
+{
+	int i, n;
 
-	if(sdhci_send_command(&sd_data,&sd_cmd))
+	for(i=0;i<SDCARD_LINE_SECTORS;i++)
 		{
+		if(!(line->dirty & (1 << i)))
+			continue;
+		for(n=1;i+n<SDCARD_LINE_SECTORS && (line->dirty & (1 << (i+n)));n++)
+			;
+		if(sdcard_transfer(1, sdcard_cache_sector(line, i), line->base + i, n))
+			return RES_ERROR;
+		line->dirty &= ~(((1 << n) - 1) << i);
+		sdcard_stats.writebacks += n;
+		i += n;
+		}
+	return RES_OK;
+}
+
+static sdcard_line_t *sdcard_cache_get(LBA_t base)
+{
+	sdcard_line_t *line = sdcard_cache_find(base);
+	int i;
+
+	if(line == NULL)
+		{
+		/* a free line, else the least recently used one */
+		line = &sdcard_lines[0];
+		for(i=1;i<SDCARD_LINES && line->used;i++)
+			{
+			if(sdcard_lines[i].used < line->used)
+				line = &sdcard_lines[i];
+			}
+		if(line->used && sdcard_cache_flush(line))
+			return NULL;
+		line->base = base;
+		line->valid = 0;
+		line->dirty = 0;
+		}
+	line->used = ++sdcard_lru;
+	return line;
+}
+
+static int sdcard_cache_read(BYTE *buff, LBA_t sector)
+{
+	sdcard_line_t *line;
+	int i = sector % SDCARD_LINE_SECTORS;
+	int n = 1;
+	int seq = (sector == sdcard_last + 1);
+
+	sdcard_last = sector;
+	line = sdcard_cache_get(sector - i);
+	if(line == NULL)
 		return RES_ERROR;
+
+	if(line->valid & (1 << i))
+		{
+		sdcard_stats.hits++;
 		}
 	else
 		{
-		memcpy((void *)buff, sdcard_buff, count*512);
-		return RES_OK;
+		/* a sequential miss reads the rest of the line ahead, up to the next cached sector */
+		if(seq)
+			{
+			while(i+n < SDCARD_LINE_SECTORS && !(line->valid & (1 << (i+n))) &&
+				sector+n < sdcard_get_sector_count())
+				n++;
+			}
+		if(sdcard_transfer(0, sdcard_cache_sector(line, i), sector, n))
+			return RES_ERROR;
+		line->valid |= ((1 << n) - 1) << i;
+		sdcard_stats.misses++;
+		sdcard_stats.readahead += n - 1;
+		}
+	memcpy(buff, sdcard_cache_sector(line, i), 512);
+	return RES_OK;
+}
+
+static int sdcard_cache_write(const BYTE *buff, LBA_t sector)
+{
+	sdcard_line_t *line;
+	int i = sector % SDCARD_LINE_SECTORS;
+
+	sdcard_last = sector;
+	line = sdcard_cache_get(sector - i);
+	if(line == NULL)
+		return RES_ERROR;
+
+	memcpy(sdcard_cache_sector(line, i), buff, 512);
+	line->valid |= 1 << i;
+	line->dirty |= 1 << i;
+	return RES_OK;
+}
+
+/* keep cached sectors coherent with a request that bypassed the cache */
+static void sdcard_cache_bypass(int write, BYTE *buff, LBA_t sector, UINT count)
+{
+	sdcard_line_t *line;
+	LBA_t s;
+	int i, k;
+
+	for(k=0;k<SDCARD_LINES;k++)
+		{
+		line = &sdcard_lines[k];
+		if(!line->used || line->base + SDCARD_LINE_SECTORS <= sector || line->base >= sector + count)
+			continue;
+		for(i=0;i<SDCARD_LINE_SECTORS;i++)
+			{
+			s = line->base + i;
+			if(s < sector || s >= sector + count || !(line->valid & (1 << i)))
+				continue;
+			if(write)
+				{
+				/* the card now holds the newest data */
+				memcpy(sdcard_cache_sector(line, i), buff + (s - sector)*512, 512);
+				line->dirty &= ~(1 << i);
+				}
+			else if(line->dirty & (1 << i))
+				{
+				/* the card is stale, hand out the cached copy */
+				memcpy(buff + (s - sector)*512, sdcard_cache_sector(line, i), 512);
+				}
+			}
+		}
+}
+#endif
+
+int sdcard_sync(void)
+{
+#ifdef CONFIG_SDCARD_CACHE
+	int i;
+
+	for(i=0;i<SDCARD_LINES;i++)
+		{
+		if(sdcard_lines[i].used && sdcard_cache_flush(&sdcard_lines[i]))
+			return RES_ERROR;
 		}
+#endif
+	return RES_OK;
+}
+
+int sdcard_write(const BYTE *buff,LBA_t sector,UINT count)
+{
+#ifdef CONFIG_SDCARD_CACHE
+	if(count == 1)
+		return sdcard_cache_write(buff, sector);
+	if(sdcard_transfer(1, (BYTE *)buff, sector, count))
+		return RES_ERROR;
+	sdcard_cache_bypass(1, (BYTE *)buff, sector, count);
+	return RES_OK;
+#else
+	return sdcard_transfer(1, (BYTE *)buff, sector, count);
+#endif
+}
+
+int sdcard_read(const BYTE *buff,LBA_t sector,UINT count)
+{
+#ifdef CONFIG_SDCARD_CACHE
+	if(count == 1)
+		return sdcard_cache_read((BYTE *)buff, sector);
+	sdcard_last = sector + count - 1;
+	if(sdcard_transfer(0, (BYTE *)buff, sector, count))
+		return RES_ERROR;
+	sdcard_cache_bypass(0, (BYTE *)buff, sector, count);
+	return RES_OK;
+#else
+	return sdcard_transfer(0, (BYTE *)buff, sector, count);
+#endif
+}
+
+void sdcard_get_stats(sdcard_stats_t *stats, int reset)
+{
+	if(stats)
+		*stats = sdcard_stats;
+	if(reset)
+		memset(&sdcard_stats, 0, sizeof(sdcard_stats));
 }
 
 int sdcard_init()
 {
 	int ret;
+
+#ifdef CONFIG_SDCARD_CACHE
+	/* the card may have been swapped, drop what was cached of the old one */
+	memset(sdcard_lines, 0, sizeof(sdcard_lines));
+	sdcard_last = (LBA_t)-1;
+#endif
 	ret = sdhci_init_sdcard();
-	
+
 	if(ret)
 		os_printf(LM_OS, LL_INFO, "sdcard_init failed %d\r\n",ret);
-		
+
 	return(ret);
 }
 
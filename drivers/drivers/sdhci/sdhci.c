@@ -372,7 +372,7 @@ static char *sd_test_data=(char *)0xa0000;
 
 
 //static ADMA2 *sd_adma_desc=(ADMA2 *)0xaf000;
-static ADMA2 sd_adma_desc[MAX_BUF_BLOCK]  __attribute__((section(".dma.data"),aligned(4)));
+static ADMA2 sd_adma_desc[SDHCI_ADMA_DESC_NUM]  __attribute__((section(".dma.data"),aligned(4)));
 
 
 volatile unsigned int cmd_busy=0;
@@ -799,15 +799,20 @@ static void sdhci_adma_table_pre(struct mmc_data *data, struct mmc_command *cmd)
 {
 	int i;
 	ADMA2 *AdmaDes;
+	char *addr = (char *)data->buff_addr;
+	unsigned int left = data->blksz * data->blocks;
 	AdmaDes = sd_adma_desc;
-	//maybe blocksize is bigger than buff,sometimes we need split a block.
-	for(i=0;i<data->blocks;i++)
-		{
-		AdmaDes[i].dwAddress = (char *)data->buff_addr + i*data->blksz;
-		AdmaDes[i].wLen = data->blksz;
-		if (i == data->blocks-1)
+	//the buffer is contiguous, one descriptor per SDHCI_ADMA_MAX_LEN bytes of it.
+	for(i=0;i<SDHCI_ADMA_DESC_NUM;i++)
+		{
+		AdmaDes[i].dwAddress = addr;
+		AdmaDes[i].wLen = (left > SDHCI_ADMA_MAX_LEN) ? SDHCI_ADMA_MAX_LEN : left;
+		addr += AdmaDes[i].wLen;
+		left -= AdmaDes[i].wLen;
+		if (left == 0)
 			{
 			AdmaDes[i].wAttribute = 0x23;//end desc attribute
+			break;
 			}
 		else
 			AdmaDes[i].wAttribute = 0x21;
@@ -6,6 +6,7 @@
 #include "chip_clk_ctrl.h"
 #include "cli.h"
 #include "chip_irqvector.h"
+#include "oshal.h"
 
 #include "sdio_slave_interface.h"
 
@@ -193,6 +194,22 @@
 #define SLAVE_BUF_SZ_OFFSET		(4)
 #define SDIO_MEM_MAX_NUM		(64)
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+#ifndef CONFIG_SDIO_SLAVE_TX_AGG_MAX_LEN
+#define CONFIG_SDIO_SLAVE_TX_AGG_MAX_LEN	8192
+#endif
+#ifndef CONFIG_SDIO_SLAVE_TX_AGG_MAX_FRAMES
+#define CONFIG_SDIO_SLAVE_TX_AGG_MAX_FRAMES	16
+#endif
+#ifndef CONFIG_SDIO_SLAVE_TX_AGG_DELAY_MS
+#define CONFIG_SDIO_SLAVE_TX_AGG_DELAY_MS	1
+#endif
+#define SDIO_AGG_MAX_LEN		CONFIG_SDIO_SLAVE_TX_AGG_MAX_LEN
+#define SDIO_AGG_MAX_FRAMES		CONFIG_SDIO_SLAVE_TX_AGG_MAX_FRAMES
+/* header, one sub-frame header per frame, frags, block padding */
+#define SDIO_AGG_DESC_MAX		(2 * SDIO_AGG_MAX_FRAMES + 16)
+#endif
+
 
 //
 #define  sdio_assert(x)				\
@@ -217,6 +234,16 @@ struct adma_descriptor
     unsigned int addr;
 };
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+typedef struct
+{
+    sdio_tx_bufs_t *head;   /* frames linked by next_buf */
+    unsigned int count;     /* frames */
+    unsigned int bytes;     /* header and sub-frames */
+    unsigned int len;       /* transfer length, bytes padded to blocks */
+} sdio_agg_batch_t;
+#endif
+
 struct sdio_queue
 {
     unsigned int count;
@@ -258,6 +285,17 @@ struct sdio_priv
     sdio_tx_bufs_t *tx_free_head;
     EN_SDIO_TX_STATE tx_state;
     EN_SDIO_TX_STATE tx_next_state;
+
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+    unsigned char agg_enable;
+    unsigned char agg_timer_armed;
+    os_timer_handle_t agg_timer;
+    sdio_agg_batch_t agg_cur;       /* batch the host is reading */
+    sdio_agg_batch_t agg_next;      /* batch announced to the host */
+    unsigned int agg_pending;       /* bytes on tx_head not batched yet */
+    unsigned int agg_pending_nb;
+#endif
+    sdio_tx_stats_t stats;
 };
 
 typedef struct 
@@ -283,6 +321,12 @@ unsigned int 				complete_cnt_total =0;
 
 unsigned int sdio_buff[128] __attribute__((section(".dma.data"),aligned(4)));
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+/* aggregate header followed by the sub-frame headers of the batch in flight */
+static unsigned int sdio_agg_hdr[SDIO_AGG_HDR_LEN / 4 + SDIO_AGG_MAX_FRAMES] __attribute__((section(".dma.data"),aligned(4)));
+static struct adma_descriptor sdio_agg_desc[SDIO_AGG_DESC_MAX] __attribute__((section(".dma.data"),aligned(4)));
+#endif
+
 
 static void sdio_tx_free_queue_push(sdio_tx_bufs_t *sysbuf);
 extern void sdio_tx_complete(void);
@@ -567,6 +611,208 @@ static sdio_tx_bufs_t *sdio_tx_queue_peek(sdio_tx_bufs_t *head)
     return head;
 }
 
+/* must be called with irq lock */
+static void sdio_tx_stats_record(struct sdio_priv *priv, unsigned int frames, unsigned int payload, unsigned int wire)
+{
+    sdio_tx_stats_t *stats = &priv->stats;
+    unsigned int fill = wire ? (payload * 10 / wire) : 0;
+
+    stats->transfers++;
+    stats->frames += frames;
+    stats->payload += payload;
+    stats->wire += wire;
+    stats->fill[(fill < SDIO_TX_FILL_BUCKETS) ? fill : (SDIO_TX_FILL_BUCKETS - 1)]++;
+    if (frames > stats->max_frames)
+    {
+        stats->max_frames = frames;
+    }
+}
+
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+/* bytes a frame takes in an aggregate after its sub-frame header, and its descriptors */
+static unsigned int sdio_agg_frame_wire(sdio_tx_bufs_t *buf, unsigned int *desc)
+{
+    unsigned int wire = 0;
+
+    *desc = 1;
+    while (buf)
+    {
+        wire += (buf->lens + 3) & 0xFFFFFFFC;
+        (*desc)++;
+        buf = buf->next_frag;
+    }
+
+    return wire;
+}
+
+/* must be called with irq lock, takes as many frames off head as fit one transfer */
+static void sdio_agg_close(sdio_tx_bufs_t **head, sdio_agg_batch_t *batch)
+{
+    sdio_tx_bufs_t *buf = *head;
+    sdio_tx_bufs_t *last = NULL;
+    unsigned int bytes = SDIO_AGG_HDR_LEN;
+    unsigned int desc = 2;
+    unsigned int wire, fdesc;
+
+    batch->head = buf;
+    batch->count = 0;
+    while (buf && batch->count < SDIO_AGG_MAX_FRAMES)
+    {
+        wire = SDIO_AGG_SUB_HDR_LEN + sdio_agg_frame_wire(buf, &fdesc);
+        if (batch->count && (bytes + wire > SDIO_AGG_MAX_LEN || desc + fdesc > SDIO_AGG_DESC_MAX))
+        {
+            break;
+        }
+        sdio_assert(desc + fdesc <= SDIO_AGG_DESC_MAX);
+
+        bytes += wire;
+        desc += fdesc;
+        batch->count++;
+        last = buf;
+        buf = buf->next_buf;
+    }
+
+    if (last)
+    {
+        last->next_buf = NULL;
+    }
+    *head = buf;
+
+    batch->bytes = bytes;
+    batch->len = (bytes > SDIO_MAX_BLOCK_SIZE) ? ((bytes + SDIO_MAX_BLOCK_SIZE - 1) & ~(SDIO_MAX_BLOCK_SIZE - 1)) : bytes;
+    sdio_assert(batch->len <= 0xFFFF);
+}
+
+/* fill the aggregate and sub-frame headers and the descriptor chain of a batch, returns the payload bytes */
+static unsigned int sdio_agg_build(sdio_agg_batch_t *batch, unsigned int next_len, unsigned int rx_free,
+                                   unsigned int *hdr, volatile struct adma_descriptor *desc)
+{
+    sdio_tx_bufs_t *buf = batch->head;
+    sdio_tx_bufs_t *frag;
+    unsigned int *sub = hdr + SDIO_AGG_HDR_LEN / 4;
+    unsigned int payload = 0;
+    unsigned int len, wire;
+
+    hdr[0] = next_len;
+    hdr[1] = (rx_free & 0xFFFF) | (batch->bytes << 16);
+    hdr[2] = SDIO_AGG_MAGIC | batch->count;
+    hdr[3] = 0;
+
+    desc->addr = (unsigned int)hdr;
+    desc->len = SDIO_AGG_HDR_LEN;
+    desc->attri = SDIO_ADMA_ATTR_ACT_TRS | SDIO_ADMA_ATTR_VALID;
+    desc++;
+
+    while (buf)
+    {
+        desc->addr = (unsigned int)sub;
+        desc->len = SDIO_AGG_SUB_HDR_LEN;
+        desc->attri = SDIO_ADMA_ATTR_ACT_TRS | SDIO_ADMA_ATTR_VALID;
+        desc++;
+
+        len = 0;
+        wire = 0;
+        for (frag = buf; frag; frag = frag->next_frag)
+        {
+            desc->addr = frag->bufs;
+            desc->len = (frag->lens + 3) & 0xFFFFFFFC;
+            desc->attri = SDIO_ADMA_ATTR_ACT_TRS | SDIO_ADMA_ATTR_VALID;
+            len += frag->lens;
+            wire += desc->len;
+            desc++;
+        }
+        *sub++ = len | (wire << 16);
+        payload += len;
+        buf = buf->next_buf;
+    }
+
+    if (batch->len > batch->bytes)
+    {
+        /* block padding comes from the zeroed sdio_buff */
+        desc->addr = (unsigned int)sdio_buff;
+        desc->len = batch->len - batch->bytes;
+        desc->attri = SDIO_ADMA_ATTR_ACT_TRS | SDIO_ADMA_ATTR_VALID;
+        desc++;
+    }
+    desc--;
+    desc->attri |= SDIO_ADMA_ATTR_END;
+
+    return payload;
+}
+
+unsigned int sdio_agg_pack(sdio_tx_bufs_t **frames, unsigned char *out, unsigned int size)
+{
+    struct adma_descriptor desc[SDIO_AGG_DESC_MAX];
+    unsigned int hdr[SDIO_AGG_HDR_LEN / 4 + SDIO_AGG_MAX_FRAMES];
+    sdio_agg_batch_t batch;
+    unsigned int len = 0;
+    int i = 0;
+
+    if (*frames == NULL)
+    {
+        return 0;
+    }
+
+    sdio_agg_close(frames, &batch);
+    if (batch.len > size)
+    {
+        return 0;
+    }
+    sdio_agg_build(&batch, 0, 0, hdr, desc);
+
+    /* gather the chain like the ADMA engine does */
+    do
+    {
+        memcpy(out + len, (void *)desc[i].addr, desc[i].len);
+        len += desc[i].len;
+    } while (!(desc[i++].attri & SDIO_ADMA_ATTR_END));
+
+    return len;
+}
+#endif
+
+int sdio_agg_parse(unsigned char *buf, unsigned int len, sdio_agg_frame_cb_t cb, void *arg)
+{
+    unsigned int *hdr = (unsigned int *)buf;
+    unsigned int bytes, count, sub, flen, wire, off, i;
+
+    if (len < SDIO_AGG_HDR_LEN || (hdr[2] & SDIO_AGG_MAGIC_MASK) != SDIO_AGG_MAGIC)
+    {
+        return -1;
+    }
+
+    bytes = hdr[1] >> 16;
+    count = hdr[2] & ~SDIO_AGG_MAGIC_MASK;
+    if (bytes > len)
+    {
+        return -1;
+    }
+
+    off = SDIO_AGG_HDR_LEN;
+    for (i = 0; i < count; i++)
+    {
+        if (off + SDIO_AGG_SUB_HDR_LEN > bytes)
+        {
+            return -1;
+        }
+        sub = *(unsigned int *)(buf + off);
+        flen = sub & 0xFFFF;
+        wire = sub >> 16;
+        off += SDIO_AGG_SUB_HDR_LEN;
+        if ((wire & 3) || flen > wire || off + wire > bytes)
+        {
+            return -1;
+        }
+        if (cb)
+        {
+            cb(arg, buf + off, flen);
+        }
+        off += wire;
+    }
+
+    return count;
+}
+
 static unsigned int sdio_requested_length(unsigned int arg)
 {
     unsigned int len;
@@ -671,6 +917,43 @@ static void sdio_isr_tx(struct sdio_priv *priv)
             {
                 len = sdio_requested_length(priv->sdio_argument);
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+                if (priv->agg_enable)
+                {
+                    unsigned int next_len = 0;
+                    unsigned int payload;
+
+                    sdio_assert(priv->state == STATE_IDLE);
+                    priv->agg_cur = priv->agg_next;
+                    sdio_assert(priv->agg_cur.head && len == priv->agg_cur.len);
+
+                    /* frames queued meanwhile form the next batch, announced in this header */
+                    if (priv->tx_head)
+                    {
+                        sdio_agg_close(&priv->tx_head, &priv->agg_next);
+                        priv->agg_pending -= priv->agg_next.bytes - SDIO_AGG_HDR_LEN;
+                        priv->agg_pending_nb -= priv->agg_next.count;
+                        next_len = priv->agg_next.len;
+                        priv->tx_next_state = SDIO_TX_WAIT_2_READ;
+                    }
+                    else
+                    {
+                        memset(&priv->agg_next, 0, sizeof(priv->agg_next));
+                        priv->tx_next_state = SDIO_TX_IDLE;
+                    }
+
+                    payload = sdio_agg_build(&priv->agg_cur, next_len, get_rx_buff_free_size(), sdio_agg_hdr, sdio_agg_desc);
+                    sdio_tx_stats_record(priv, priv->agg_cur.count, payload, len);
+                    priv->tx_state = SDIO_TX_LAST_READ;
+
+                    SDIO_DMA1_ADDR = (unsigned int)sdio_agg_desc;
+                    SDIO_DMA1_CTL  = 0xF;
+
+                    priv->state = STATE_TX;
+                    break;
+                }
+#endif
+
                 if (priv->state == STATE_IDLE )
                 {
                     unsigned int * p_next_buf_size = NULL;
@@ -723,6 +1006,7 @@ static void sdio_isr_tx(struct sdio_priv *priv)
 #if 1
 
                 sdio_assert(len == ((bufs->total_len) & 0xFFFF) );
+                sdio_tx_stats_record(priv, 1, bufs->total_len >> 16, len);
 
                 if (len > 512)
                 {
@@ -887,6 +1171,26 @@ static void sdio_check_tx_buff(struct sdio_priv *priv)
             return;
         }
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+        if (priv->agg_enable)
+        {
+            /* WAIT_2_READ: the batch was closed and announced by the last transfer header */
+            if (priv->tx_next_state == SDIO_TX_WAIT_2_INFORM)
+            {
+                sdio_agg_close(&priv->tx_head, &priv->agg_next);
+                priv->agg_pending -= priv->agg_next.bytes - SDIO_AGG_HDR_LEN;
+                priv->agg_pending_nb -= priv->agg_next.count;
+                while(SDIO_FUN1_CTL);
+                SDIO_FUN1_IND(priv->agg_next.len & 0xFFFF);
+            }
+            sdio_assert(priv->agg_next.head);
+
+            priv->tx_state = SDIO_TX_WAIT_2_READ;
+            priv->tx_next_state = priv->tx_head ? SDIO_TX_WAIT_2_READ : SDIO_TX_IDLE;
+            return;
+        }
+#endif
+
         tx_bufs = sdio_tx_queue_peek(priv->tx_head);
         sdio_assert(tx_bufs);
         if (priv->tx_next_state == SDIO_TX_WAIT_2_INFORM) 
@@ -963,8 +1267,28 @@ static void sdio_isr_cmpl(struct sdio_priv *priv)
             sdio_mem_tx_free(priv->tx_curr_buff);
 #else
             //sdio_data_tx_cfm(priv->tx_curr_buff);
-            sdio_tx_free_queue_push(priv->tx_curr_buff);
-            sdio_tx_complete();
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+            if (priv->agg_enable)
+            {
+                sdio_tx_bufs_t *buf = priv->agg_cur.head;
+                sdio_tx_bufs_t *next;
+
+                /* every frame of the batch completes on its own */
+                while (buf)
+                {
+                    next = buf->next_buf;
+                    sdio_tx_free_queue_push(buf);
+                    sdio_tx_complete();
+                    buf = next;
+                }
+                memset(&priv->agg_cur, 0, sizeof(priv->agg_cur));
+            }
+            else
+#endif
+            {
+                sdio_tx_free_queue_push(priv->tx_curr_buff);
+                sdio_tx_complete();
+            }
 #endif
             priv->state = STATE_IDLE;
 #ifdef CONFIG_PSM_SURPORT
@@ -1232,6 +1556,33 @@ unsigned int sdio_send_to_host(sdio_tx_param_t *param)
     sdio_tx_queue_push(&param->bufs);
     //os_printf(LM_OS, LL_INFO,"%s: type=0x%08x buf_cnt=%d\n", __func__, *((uint32_t *)(param->bufs.bufs) + 2), get_rx_buff_free_size());
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+    if (priv->agg_enable)
+    {
+        unsigned int fdesc;
+        int arm = 0;
+
+        priv->agg_pending += SDIO_AGG_SUB_HDR_LEN + sdio_agg_frame_wire(&param->bufs, &fdesc);
+        priv->agg_pending_nb++;
+
+        /* an idle link waits a little for more frames unless a full batch is queued, */
+        /* a busy one aggregates whatever is queued when the next batch is closed */
+        if (priv->tx_next_state == SDIO_TX_IDLE && priv->tx_state == SDIO_TX_IDLE &&
+            priv->agg_timer && priv->agg_pending_nb < SDIO_AGG_MAX_FRAMES &&
+            priv->agg_pending + SDIO_AGG_HDR_LEN < SDIO_AGG_MAX_LEN)
+        {
+            arm = !priv->agg_timer_armed;
+            priv->agg_timer_armed = 1;
+            vPortClearInterruptMask(flags);
+            if (arm)
+            {
+                os_timer_start(priv->agg_timer);
+            }
+            return 0;
+        }
+    }
+#endif
+
     /* empty tx queue, send indicate when state is idle */
     if (priv->tx_next_state == SDIO_TX_IDLE) 
     {
@@ -1247,6 +1598,105 @@ unsigned int sdio_send_to_host(sdio_tx_param_t *param)
     return 0;
 }
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+static void sdio_agg_timeout(os_timer_handle_t timer)
+{
+    struct sdio_priv *priv = &m_priv;
+    unsigned long flags;
+
+    flags = portSET_INTERRUPT_MASK_FROM_ISR();
+    priv->agg_timer_armed = 0;
+    if (priv->tx_head && priv->tx_next_state == SDIO_TX_IDLE)
+    {
+        priv->tx_next_state = SDIO_TX_WAIT_2_INFORM;
+        if (priv->state == STATE_IDLE)
+        {
+            sdio_check_tx_buff(priv);
+        }
+    }
+    vPortClearInterruptMask(flags);
+}
+
+int sdio_agg_enable(int enable)
+{
+    struct sdio_priv *priv = &m_priv;
+    unsigned long flags;
+    int ret = -1;
+
+    /* the framing only changes between transfers */
+    flags = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (priv->tx_head == NULL && priv->tx_state == SDIO_TX_IDLE && priv->tx_next_state == SDIO_TX_IDLE)
+    {
+        priv->agg_enable = enable ? 1 : 0;
+        priv->agg_pending = 0;
+        priv->agg_pending_nb = 0;
+        ret = 0;
+    }
+    vPortClearInterruptMask(flags);
+
+    return ret;
+}
+#endif
+
+void sdio_tx_stats_get(sdio_tx_stats_t *stats, int reset)
+{
+    struct sdio_priv *priv = &m_priv;
+    unsigned long flags;
+
+    flags = portSET_INTERRUPT_MASK_FROM_ISR();
+    if (stats)
+    {
+        *stats = priv->stats;
+    }
+    if (reset)
+    {
+        memset(&priv->stats, 0, sizeof(priv->stats));
+    }
+    vPortClearInterruptMask(flags);
+}
+
+static int cmd_sdio_stat(cmd_tbl_t *t, int argc, char *argv[])
+{
+    sdio_tx_stats_t stats;
+    int i;
+
+    sdio_tx_stats_get(&stats, argc > 1 && strcmp(argv[1], "reset") == 0);
+    os_printf(LM_CMD, LL_INFO, "transfers %u frames %u max %u/transfer\r\n", stats.transfers, stats.frames, stats.max_frames);
+    os_printf(LM_CMD, LL_INFO, "payload %u wire %u fill %u%%\r\n", stats.payload, stats.wire,
+              stats.wire ? (unsigned int)((unsigned long long)stats.payload * 100 / stats.wire) : 0);
+    for (i = 0; i < SDIO_TX_FILL_BUCKETS; i++)
+    {
+        os_printf(LM_CMD, LL_INFO, "fill %3d-%3d%% %u\r\n", i * 10, i * 10 + 10, stats.fill[i]);
+    }
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+    os_printf(LM_CMD, LL_INFO, "aggregation %s\r\n", m_priv.agg_enable ? "on" : "off");
+#endif
+
+    return CMD_RET_SUCCESS;
+}
+
+CLI_CMD(sdio_stat, cmd_sdio_stat, "sdio tx transfer statistics", "sdio_stat [reset]");
+
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+static int cmd_sdio_agg(cmd_tbl_t *t, int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        return CMD_RET_USAGE;
+    }
+
+    if (sdio_agg_enable(strcmp(argv[1], "on") == 0) != 0)
+    {
+        os_printf(LM_CMD, LL_INFO, "tx busy\r\n");
+        return CMD_RET_FAILURE;
+    }
+
+    return CMD_RET_SUCCESS;
+}
+
+CLI_CMD(sdio_agg, cmd_sdio_agg, "sdio tx aggregation, the host must parse aggregates", "sdio_agg on|off");
+#endif
+
 /* init entry */
 void sdio_init(void)
 {
@@ -1290,6 +1740,14 @@ void sdio_init(void)
 
 	memset(sdio_buff, 0, 512);
 
+#ifdef CONFIG_SDIO_SLAVE_TX_AGG
+    priv->agg_enable = 1;
+    if (CONFIG_SDIO_SLAVE_TX_AGG_DELAY_MS > 0)
+    {
+        priv->agg_timer = os_timer_create("sdio_agg", CONFIG_SDIO_SLAVE_TX_AGG_DELAY_MS, 0, sdio_agg_timeout, NULL);
+    }
+#endif
+
     os_printf(LM_OS, LL_INFO, "sdio_start\r\n");
 }
 
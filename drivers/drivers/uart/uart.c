@@ -19,6 +19,10 @@
 #include "oshal.h"
 #include "dma.h"
 #include "pit.h"
+#ifdef CONFIG_UART_TX_DMA_RING
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
 
 #ifdef CONFIG_PSM_SURPORT
 #include "psm_system.h"
@@ -72,6 +76,11 @@ T_DRV_UART_CONFIG uart_dev_config[3]={{0}}; //uart0/1/2
 #define DRV_UART_FCR_DMAE			0x00000008	/** dma enable*/
 
 #define DRV_UART_MCR_AFE			(0x22)		/** auto flow control enable*/
+#define DRV_UART_MCR_RTS			(0x02)		/** rts output, auto rts when afe is set*/
+
+#define DRV_UART_DMA_CH_CTRL(chn)	(MEM_BASE_DMAC + 0x44 + ((chn) * 0x14))
+#define DRV_UART_DMA_CH_SRC(chn)	(MEM_BASE_DMAC + 0x48 + ((chn) * 0x14))
+#define DRV_UART_DMA_CH_DST(chn)	(MEM_BASE_DMAC + 0x4C + ((chn) * 0x14))
 
 #define DRV_UART_FIFO_DEPTH		(CHIP_CFG_UART_FIFO_DEPTH)
 
@@ -125,6 +134,27 @@ typedef  struct _T_UART_REG_MAP
 } T_UART_REG_MAP;
 
 
+#ifdef CONFIG_UART_TX_DMA_RING
+/**
+ * @brief Uart tx ring drained by dma.
+ */
+typedef struct _T_DRV_UART_TX_RING
+{
+	char * buf;
+	unsigned int size;
+	volatile unsigned int wr;		///< bytes queued since open, wraps at 2^32
+	volatile unsigned int rd;		///< bytes handed to dma and finished
+	volatile unsigned int dma_len;	///< bytes of the transfer in flight, 0--dma idle
+	volatile unsigned char halted;	///< panic fallback, the ring is bypassed by polling
+	volatile unsigned char waiting;	///< a blocked writer waits for space
+	unsigned char dma_chn;
+	unsigned char dma_mode;
+	os_sem_handle_t space_sem;
+	os_mutex_handle_t block_mutex;
+	T_DRV_UART_TX_RING_STATS stats;
+} T_DRV_UART_TX_RING;
+#endif
+
 /**
  * @brief Uart device.
  */
@@ -141,6 +171,9 @@ typedef struct _T_DRV_UART_DEV
 	unsigned char uart_tx_dma_chn;	
 	char * uart_tx_addr;
 	unsigned int uart_tx_len;
+#ifdef CONFIG_UART_TX_DMA_RING
+	T_DRV_UART_TX_RING * uart_tx_ring;
+#endif
 
 	/** rx parameter  */
 	os_sem_handle_t uart_rx_sem;
@@ -153,6 +186,10 @@ typedef struct _T_DRV_UART_DEV
 	unsigned int uart_rx_buf_rd;
 	unsigned int uart_rx_buf_wr;
 	unsigned int uart_rx_isr_threshold;
+	unsigned int uart_rx_dma_blocks;	///< looplist blocks filled, counted in the dma isr
+	unsigned int uart_rx_dma_rd;		///< bytes consumed since the looplist started
+	T_DRV_UART_RX_STATS uart_rx_stats;
+	unsigned int uart_baud;
 #ifdef USE_NEW_USER_MODE
 	T_UART_ISR_CALLBACK uart_rx_callback;
 #else
@@ -174,6 +211,8 @@ static void drv_uart_set_baud(T_DRV_UART_DEV * p_uart_dev, unsigned int baud)
 	T_UART_REG_MAP * p_uart_reg = p_uart_dev->uart_reg_base;
 	int uart_baud = UART_RATE(baud);
 
+	p_uart_dev->uart_baud = baud;
+
 #if !defined (CONFIG_CPU_CLK_SRC_40m)
 	if(baud == BAUD_RATE_806400)
 	{
@@ -363,18 +402,17 @@ unsigned char drv_uart_rx_tstc(unsigned int uart_base)
 	return p_uart_reg->LSR & DRV_UART_LSR_RDR;
 }
 
-/**    @brief       Uart is sent by polling.
- *     @details     The data in the buffer is sent out through the THR register.
- *     @param[in]   uart_num  Specifies the uart number to open, using E_DRV_UART_NUM type 
+/**    @brief       Uart tx fifo write.
+ *     @details     Spin on the tx fifo and put the data into the THR register.
+ *     @param[in]   *p_uart_dev   Uart device structure pointer
  *     @param[in]   *buf      The buf pointer points to the address of the data to be transmitted
  *     @param[in]   len       Length of data transmitted
- *     @return      0--Transmit succeed, other--Transmit failed
+ *     @param[in]   crlf      Non-zero sends '\n' as "\r\n"
+ *     @return      0--Transmit succeed
  */
-int  drv_uart_send_poll(E_DRV_UART_NUM uart_num, char * buf, unsigned int len)
+static int drv_uart_send_fifo(T_DRV_UART_DEV * p_uart_dev, const char * buf, unsigned int len, int crlf)
 {
 	unsigned int i = 0;
-
-	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
 	T_UART_REG_MAP * p_uart_reg = p_uart_dev->uart_reg_base;
 
 	while(drv_uart_tx_ready((unsigned int)p_uart_reg));
@@ -390,7 +428,7 @@ int  drv_uart_send_poll(E_DRV_UART_NUM uart_num, char * buf, unsigned int len)
 		{
 			p_uart_dev->uart_tx_fifo_depth--;
 
-			if  (p_uart_dev->uart_tx_mode == UART_TX_MODE_STREAM)
+			if  (crlf)
 			{
 				if(buf[i] == '\n')
 				{
@@ -417,6 +455,29 @@ int  drv_uart_send_poll(E_DRV_UART_NUM uart_num, char * buf, unsigned int len)
 	return 0;
 }
 
+/**    @brief       Uart is sent by polling.
+ *     @details     The data in the buffer is sent out through the THR register. With a tx ring open the data
+ *                  is queued behind the ring instead.
+ *     @param[in]   uart_num  Specifies the uart number to open, using E_DRV_UART_NUM type 
+ *     @param[in]   *buf      The buf pointer points to the address of the data to be transmitted
+ *     @param[in]   len       Length of data transmitted
+ *     @return      0--Transmit succeed, other--Transmit failed
+ */
+int  drv_uart_send_poll(E_DRV_UART_NUM uart_num, char * buf, unsigned int len)
+{
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+
+#ifdef CONFIG_UART_TX_DMA_RING
+	/** the fifo can not be shared with a running tx ring, queue behind it instead */
+	if (p_uart_dev->uart_tx_ring && !p_uart_dev->uart_tx_ring->halted)
+	{
+		return (drv_uart_tx_ring_write(uart_num, buf, len, UART_TX_RING_BLOCK) < 0) ? UART_RET_ERROR : 0;
+	}
+#endif
+
+	return drv_uart_send_fifo(p_uart_dev, buf, len, p_uart_dev->uart_tx_mode == UART_TX_MODE_STREAM);
+}
+
 /**    @brief       Uart tx isr in dma.
  *     @details     Under the dma function,uart tx interrupt transmission mode.
  *     @param[in]   *data   Transmit data pointer
@@ -464,6 +525,437 @@ int drv_uart_send_dma(E_DRV_UART_NUM uart_num, char * buf, unsigned int len)
 	return 0;
 }
 
+#ifdef CONFIG_UART_TX_DMA_RING
+#define DRV_UART_TX_RING_MIN_SIZE	64
+/** bytes sent per irq-locked step when a halted ring is drained */
+#define DRV_UART_TX_RING_HALT_CHUNK	64
+/** the dma master only reaches system sram, ILM/DLM are local to the core */
+#define DRV_UART_DMA_ADDR(p, len)	((unsigned int)(p) >= MEM_BASE_RAM0 && \
+				(unsigned int)(p) + (len) <= MEM_BASE_RAM1 + 0x20000)
+
+/**    @brief		Uart tx ring dma kick.
+*	   @details 	Start dma on the oldest contiguous queued segment if dma is idle. Call with irq disabled.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*/
+static void drv_uart_tx_ring_kick(T_DRV_UART_DEV * p_uart_dev)
+{
+	T_DRV_UART_TX_RING * ring = p_uart_dev->uart_tx_ring;
+	T_DMA_CFG_INFO dma_cfg_info;
+	unsigned int rd, len;
+
+	if (ring->dma_len || ring->halted || (ring->wr == ring->rd))
+	{
+		return;
+	}
+
+	rd = ring->rd & (ring->size - 1);
+	len = ring->wr - ring->rd;
+	if (len > ring->size - rd)
+	{
+		len = ring->size - rd;
+	}
+
+	dma_cfg_info.dst = (unsigned int)&p_uart_dev->uart_reg_base->Mux0.THR;
+	dma_cfg_info.src = (unsigned int)&ring->buf[rd];
+	dma_cfg_info.len = len;
+	dma_cfg_info.mode = (E_DMA_CHN_MODE)ring->dma_mode;
+
+	ring->dma_len = len;
+	ring->stats.dma_xfers++;
+
+	/** the dma driver chains descriptors while its count is set, start a fresh transfer */
+	drv_dma_status_clean(ring->dma_chn);
+	drv_dma_cfg(ring->dma_chn, &dma_cfg_info);
+	drv_dma_start(ring->dma_chn);
+}
+
+/**    @brief		Uart tx ring dma isr.
+*	   @details 	Retire the finished transfer, chain the next segment and wake a writer waiting for space.
+*	   @param[in]	*data   Uart device structure pointer
+*/
+static void drv_uart_tx_ring_dma_isr(void * data)
+{
+	T_DRV_UART_DEV * p_uart_dev = (T_DRV_UART_DEV *)data;
+	T_DRV_UART_TX_RING * ring = p_uart_dev->uart_tx_ring;
+	unsigned long flags = system_irq_save();
+
+	if (ring && !ring->halted)
+	{
+		ring->rd += ring->dma_len;
+		ring->dma_len = 0;
+		drv_uart_tx_ring_kick(p_uart_dev);
+
+		if (ring->waiting)
+		{
+			ring->waiting = 0;
+			os_sem_post(ring->space_sem);
+		}
+	}
+
+	system_irq_restore(flags);
+}
+
+/**    @brief		Uart tx ring copy in.
+*	   @details 	Copy as much of buf as fits into room bytes of the ring. Call with irq disabled.
+*	   @param[in]	*ring   Uart tx ring
+*	   @param[in]	*buf    Data to queue
+*	   @param[in]	len     Length of data
+*	   @param[in]	room    Free space in the ring
+*	   @param[in]	crlf    Non-zero queues '\n' as "\r\n"
+*	   @return  	Length of buf consumed
+*/
+static unsigned int drv_uart_tx_ring_put(T_DRV_UART_TX_RING * ring, const char * buf, unsigned int len, unsigned int room, int crlf)
+{
+	unsigned int i, n, wr = ring->wr, mask = ring->size - 1;
+
+	if (!crlf)
+	{
+		len = (len > room) ? room : len;
+		n = ring->size - (wr & mask);
+		n = (n > len) ? len : n;
+		memcpy(&ring->buf[wr & mask], buf, n);
+		memcpy(ring->buf, buf + n, len - n);
+		ring->wr = wr + len;
+		return len;
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		if (buf[i] == '\n')
+		{
+			if (room < 2)
+			{
+				break;
+			}
+			ring->buf[wr++ & mask] = '\r';
+			room--;
+		}
+		else if (!room)
+		{
+			break;
+		}
+		ring->buf[wr++ & mask] = buf[i];
+		room--;
+	}
+
+	ring->wr = wr;
+	return i;
+}
+
+/**    @brief		Uart tx ring halt.
+*	   @details 	Stop dma and send whatever is still queued by polling, later writes bypass the ring.
+*                   Irq is only masked for one chunk at a time, so a halt from a task does not stall
+*                   interrupts for the whole ring. Safe with irq disabled, used on panic and before release.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*/
+static void drv_uart_tx_ring_halt(T_DRV_UART_DEV * p_uart_dev)
+{
+	T_DRV_UART_TX_RING * ring = p_uart_dev->uart_tx_ring;
+	unsigned int rd, len, sent;
+	unsigned long flags = system_irq_save();
+
+	if (ring->halted)
+	{
+		system_irq_restore(flags);
+		return;
+	}
+	ring->halted = 1;
+
+	if (ring->dma_len)
+	{
+		/** bytes dma already fetched are in the uart fifo, resume polling right behind them */
+		drv_dma_stop(ring->dma_chn);
+		rd = ring->rd & (ring->size - 1);
+		sent = READ_REG(DRV_UART_DMA_CH_SRC(ring->dma_chn)) - (unsigned int)&ring->buf[rd];
+		ring->rd += (sent < ring->dma_len) ? sent : ring->dma_len;
+		ring->dma_len = 0;
+	}
+
+	/** a writer blocked for space finishes through the fifo */
+	if (ring->waiting)
+	{
+		ring->waiting = 0;
+		os_sem_post(ring->space_sem);
+	}
+
+	while (ring->rd != ring->wr)
+	{
+		rd = ring->rd & (ring->size - 1);
+		len = ring->wr - ring->rd;
+		len = (len > ring->size - rd) ? ring->size - rd : len;
+		len = (len > DRV_UART_TX_RING_HALT_CHUNK) ? DRV_UART_TX_RING_HALT_CHUNK : len;
+		drv_uart_send_fifo(p_uart_dev, &ring->buf[rd], len, 0);
+		ring->rd += len;
+
+		system_irq_restore(flags);
+		flags = system_irq_save();
+	}
+
+	system_irq_restore(flags);
+}
+
+/**    @brief		Uart tx ring release.
+*	   @details 	Drain and free the tx ring of a uart, if one is open. The buffer belongs to the caller of open.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*/
+static void drv_uart_tx_ring_release(T_DRV_UART_DEV * p_uart_dev)
+{
+	T_DRV_UART_TX_RING * ring = p_uart_dev->uart_tx_ring;
+
+	if (!ring)
+	{
+		return;
+	}
+
+	drv_uart_tx_ring_halt(p_uart_dev);
+	drv_dma_isr_register(ring->dma_chn, NULL, NULL);
+	drv_dma_ch_release(ring->dma_chn);
+	p_uart_dev->uart_tx_ring = NULL;
+
+	os_sem_destroy(ring->space_sem);
+	os_mutex_destroy(ring->block_mutex);
+	os_free(ring);
+}
+
+/**    @brief		Open a uart tx ring.
+*	   @details 	Set up the ring on buf, allocate a tx dma channel and enable uart dma requests.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	*buf        Ring storage, must be reachable by dma (a .dma.data buffer)
+*	   @param[in]	size        Ring size in bytes, rounded down to a power of two
+*	   @return  	0--Open succeed, other--Open failed
+*/
+int drv_uart_tx_ring_open(E_DRV_UART_NUM uart_num, char * buf, unsigned int size)
+{
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+	T_DRV_UART_TX_RING * ring;
+	int chn;
+
+	if (!p_uart_dev)
+	{
+		return UART_RET_EINVAL;
+	}
+	if (p_uart_dev->uart_tx_ring)
+	{
+		return UART_RET_EBUSY;
+	}
+	/** intr and dma tx modes own the tx path already */
+	if (p_uart_dev->uart_tx_mode != UART_TX_MODE_POLL && p_uart_dev->uart_tx_mode != UART_TX_MODE_STREAM)
+	{
+		return UART_RET_EINVAL;
+	}
+
+	/** power of two, so positions can run free and wrap at 2^32 */
+	while (size & (size - 1))
+	{
+		size &= size - 1;
+	}
+	if (!buf || size < DRV_UART_TX_RING_MIN_SIZE || !DRV_UART_DMA_ADDR(buf, size))
+	{
+		return UART_RET_EINVAL;
+	}
+
+	ring = (T_DRV_UART_TX_RING *)os_zalloc(sizeof(T_DRV_UART_TX_RING));
+	if (!ring)
+	{
+		return UART_RET_ENOMEM;
+	}
+	ring->size = size;
+	ring->buf = buf;
+	ring->space_sem = os_sem_create(1, 0);
+	ring->block_mutex = os_mutex_create();
+	chn = drv_dma_ch_alloc();
+	if (!ring->space_sem || !ring->block_mutex || chn < 0)
+	{
+		if (chn >= 0)
+		{
+			drv_dma_ch_release(chn);
+		}
+		if (ring->space_sem)
+		{
+			os_sem_destroy(ring->space_sem);
+		}
+		if (ring->block_mutex)
+		{
+			os_mutex_destroy(ring->block_mutex);
+		}
+		os_free(ring);
+		return (chn < 0) ? UART_RET_ENODMA : UART_RET_ENOMEM;
+	}
+
+	ring->dma_chn = (unsigned char)chn;
+	if (uart_num == E_UART_NUM_0)
+	{
+		ring->dma_mode = DMA_CHN_UART0_TX;
+	}
+	else if (uart_num == E_UART_NUM_1)
+	{
+		ring->dma_mode = DMA_CHN_UART1_TX;
+	}
+	else
+	{
+		ring->dma_mode = DMA_CHN_UART2_TX;
+	}
+
+	drv_dma_isr_register(ring->dma_chn, drv_uart_tx_ring_dma_isr, (void *)p_uart_dev);
+	p_uart_dev->uart_tx_ring = ring;
+
+	/** no fifo reset here, the console may be mid-character */
+	while(drv_uart_tx_ready((unsigned int)p_uart_dev->uart_reg_base));
+	p_uart_dev->uart_reg_base->Mux2.FCR = DRV_UART_FCR_RFIFOT(0) | DRV_UART_FCR_DMAE;
+
+	return UART_RET_SUCCESS;
+}
+
+/**    @brief		Uart tx ring write.
+*	   @details 	Copy data into the tx ring under irq lock and start dma if it is idle.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	*buf        Data to send
+*	   @param[in]	len         Length of data
+*	   @param[in]	policy      What to do when the ring is full, using E_DRV_UART_TX_RING_POLICY type
+*	   @return  	Length of buf queued, negative--failed
+*/
+int drv_uart_tx_ring_write(E_DRV_UART_NUM uart_num, const char * buf, unsigned int len, unsigned int policy)
+{
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+	T_DRV_UART_TX_RING * ring;
+	unsigned int done = 0, need, room, fill, i;
+	unsigned long flags;
+	int crlf, can_block;
+
+	if (!p_uart_dev || !(ring = p_uart_dev->uart_tx_ring))
+	{
+		return UART_RET_EINVAL;
+	}
+
+	crlf = (p_uart_dev->uart_tx_mode == UART_TX_MODE_STREAM);
+	if (ring->halted)
+	{
+		drv_uart_send_fifo(p_uart_dev, buf, len, crlf);
+		return len;
+	}
+
+	/** only a task with irq and scheduler running may sleep, everyone else keeps what fits */
+	can_block = (policy == UART_TX_RING_BLOCK) && !arch_irq_context() && system_irq_is_enable()
+		&& (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+	if (policy == UART_TX_RING_BLOCK && !can_block)
+	{
+		policy = UART_TX_RING_TRUNCATE;
+	}
+
+	need = len;
+	if (policy == UART_TX_RING_DROP && crlf)
+	{
+		for (i = 0; i < len; i++)
+		{
+			need += (buf[i] == '\n');
+		}
+	}
+
+	if (can_block)
+	{
+		os_mutex_lock(ring->block_mutex, WAIT_FOREVER);
+	}
+
+	while (1)
+	{
+		flags = system_irq_save();
+		if (ring->halted)
+		{
+			system_irq_restore(flags);
+			drv_uart_send_fifo(p_uart_dev, buf + done, len - done, crlf);
+			done = len;
+			break;
+		}
+		room = ring->size - (ring->wr - ring->rd);
+		if (policy == UART_TX_RING_DROP && need > room)
+		{
+			ring->stats.drops++;
+			ring->stats.lost_bytes += len;
+			system_irq_restore(flags);
+			break;
+		}
+
+		i = drv_uart_tx_ring_put(ring, buf + done, len - done, room, crlf);
+		done += i;
+		ring->stats.tx_bytes += i;
+		fill = ring->wr - ring->rd;
+		if (fill > ring->stats.max_fill)
+		{
+			ring->stats.max_fill = fill;
+		}
+		drv_uart_tx_ring_kick(p_uart_dev);
+
+		if (done == len || !can_block)
+		{
+			if (done < len)
+			{
+				ring->stats.truncs++;
+				ring->stats.lost_bytes += len - done;
+			}
+			system_irq_restore(flags);
+			break;
+		}
+
+		/** the ring is full so dma is busy, its isr posts once space frees up */
+		ring->waiting = 1;
+		ring->stats.blocks++;
+		system_irq_restore(flags);
+		os_sem_wait(ring->space_sem, WAIT_FOREVER);
+	}
+
+	if (can_block)
+	{
+		os_mutex_unlock(ring->block_mutex);
+	}
+
+	return done;
+}
+
+/**    @brief		Uart tx ring flush.
+*	   @details 	Wait until everything queued has been handed to the uart.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	ms_timeout  Set the timeout value(ms)
+*	   @return  	0--Ring empty, other--Timeout or no ring
+*/
+int drv_uart_tx_ring_flush(E_DRV_UART_NUM uart_num, unsigned int ms_timeout)
+{
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+	T_DRV_UART_TX_RING * ring;
+
+	if (!p_uart_dev || !(ring = p_uart_dev->uart_tx_ring))
+	{
+		return UART_RET_EINVAL;
+	}
+
+	while (!ring->halted && ring->wr != ring->rd)
+	{
+		if (!ms_timeout--)
+		{
+			return UART_RET_ERROR;
+		}
+		os_msleep(1);
+	}
+
+	return UART_RET_SUCCESS;
+}
+
+/**    @brief		Uart tx ring panic fallback.
+*	   @details 	Halt the ring of a uart if it has one, see drv_uart_tx_ring_halt().
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*/
+void drv_uart_tx_ring_panic(E_DRV_UART_NUM uart_num)
+{
+	T_DRV_UART_DEV * p_uart_dev;
+
+	if (uart_num >= E_UART_NUM_MAX || !(p_uart_dev = uart_dev[uart_num]) || !p_uart_dev->uart_tx_ring)
+	{
+		return;
+	}
+
+	drv_uart_tx_ring_halt(p_uart_dev);
+}
+#endif
+
 /**    @brief       Uart is sent by interrupt.
  *     @details     The data in the buffer is sent out through the THR register.
  *	   @param[in]	 uart_num	 Specifies the uart number to open, using E_DRV_UART_NUM type
@@ -620,6 +1112,19 @@ static unsigned int drv_uart_receive_dma(unsigned int uart_num, char * buf, unsi
 	}
 }
 
+/**    @brief       Uart rx dma looplist block isr.
+ *     @details     One looplist block has been filled: count it, so that a reader can tell a full ring
+ *                  from an empty one, and wake up whoever waits for data.
+ *     @param[in]   *data  Uart device structure pointer
+ */
+static void drv_uart_receive_dma_looplist_isr(void *data)
+{
+	T_DRV_UART_DEV * p_uart_dev = (T_DRV_UART_DEV * )data;
+
+	p_uart_dev->uart_rx_dma_blocks++;
+	os_sem_post(p_uart_dev->uart_rx_sem);
+}
+
 unsigned int drv_uart_receive_dma_looplist(E_DRV_UART_NUM uart_num, unsigned int buff_addr)
 {
 	int ret;	
@@ -640,11 +1145,232 @@ unsigned int drv_uart_receive_dma_looplist(E_DRV_UART_NUM uart_num, unsigned int
 	}
 
 	ret = drv_dma_looplist_config(p_uart_dev->uart_rx_dma_chn, (unsigned int)&p_uart_reg->Mux0.RBR, (unsigned int)buff_addr, UART_BUF_BLOCK_SIZE, UART_BUF_NUM, mode);
-	
+
+	p_uart_dev->uart_rx_dma_blocks = 0;
+	p_uart_dev->uart_rx_dma_rd = 0;
 	drv_dma_start(p_uart_dev->uart_rx_dma_chn);
 	return ret;
 }
 
+/**    @brief		Uart rx dma looplist write position.
+*	   @details 	Read the current destination address of the rx dma channel, as offset into uart_src.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*	   @return  	Offset of the next byte dma will write, 0 ~ UART_BUF_SIZE-1
+*/
+static unsigned int drv_uart_rx_dma_pos(T_DRV_UART_DEV * p_uart_dev)
+{
+	unsigned int pos = READ_REG(DRV_UART_DMA_CH_DST(p_uart_dev->uart_rx_dma_chn)) - (unsigned int)uart_src;
+
+	return (pos >= UART_BUF_SIZE) ? 0 : pos;
+}
+
+/**    @brief		Uart rx dma looplist written length.
+*	   @details 	Bytes dma has written since the looplist started, from the filled block count and the
+*                   write position inside the current block.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*	   @return  	Total bytes written, wraps at 2^32
+*/
+static unsigned int drv_uart_rx_dma_written(T_DRV_UART_DEV * p_uart_dev)
+{
+	unsigned int blocks, pos;
+	unsigned long flags = system_irq_save();
+
+	blocks = p_uart_dev->uart_rx_dma_blocks;
+	pos = drv_uart_rx_dma_pos(p_uart_dev);
+	system_irq_restore(flags);
+
+	/** dma already moved on to the next block, its completion isr has not run yet */
+	if ((pos / UART_BUF_BLOCK_SIZE) != (blocks % UART_BUF_NUM))
+	{
+		blocks++;
+	}
+
+	return blocks * UART_BUF_BLOCK_SIZE + pos % UART_BUF_BLOCK_SIZE;
+}
+
+/**    @brief		Uart rx dma looplist pending length.
+*	   @details 	Bytes written by dma and not consumed yet. If dma lapped the reader the oldest data is lost,
+*                   the reader is moved up to one block behind dma and an overrun is counted.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*	   @param[out]	*written      Total bytes written by dma, see drv_uart_rx_dma_written()
+*	   @return  	Pending length, 0 ~ UART_BUF_SIZE
+*/
+static unsigned int drv_uart_rx_dma_pending(T_DRV_UART_DEV * p_uart_dev, unsigned int * written)
+{
+	unsigned int wr = drv_uart_rx_dma_written(p_uart_dev);
+	unsigned int pending = wr - p_uart_dev->uart_rx_dma_rd;
+
+	if (pending > UART_BUF_SIZE)
+	{
+		pending = UART_BUF_SIZE - UART_BUF_BLOCK_SIZE;
+		p_uart_dev->uart_rx_dma_rd = wr - pending;
+		p_uart_dev->uart_rx_stats.rx_overruns++;
+	}
+
+	*written = wr;
+	return pending;
+}
+
+/**    @brief		Uart rx idle gap.
+*	   @details 	Time the line has to stay quiet, CONFIG_UART_RX_IDLE_CHARS characters at the current baud,
+*                   before pending data counts as the end of a burst.
+*	   @param[in]	*p_uart_dev   Uart device structure pointer
+*	   @return  	Idle gap in ms, at least 1
+*/
+static unsigned int drv_uart_rx_idle_ms(T_DRV_UART_DEV * p_uart_dev)
+{
+	unsigned int baud = p_uart_dev->uart_baud ? p_uart_dev->uart_baud : BAUD_RATE_115200;
+
+	return (CONFIG_UART_RX_IDLE_CHARS * 10 * 1000 + baud - 1) / baud;
+}
+
+/**    @brief		Uart rx peek.
+*	   @details 	Zero-copy read in dma looplist mode. Waits until a whole looplist block is pending, the line
+*                   has been idle for the idle gap after a burst, or ms_timeout expires, then points *data at the
+*                   oldest pending byte inside the dma ring. The data stays valid until it is consumed, as long as
+*                   the reader keeps more than one block ahead of dma.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[out]	**data      Pointer into the dma ring
+*	   @param[in]	ms_timeout  Set the timeout value(ms), 0 returns at once
+*	   @return  	Contiguous pending length at *data (up to the ring end), 0--no data, negative--failed
+*/
+int drv_uart_rx_peek(E_DRV_UART_NUM uart_num, unsigned char ** data, unsigned int ms_timeout)
+{
+	unsigned int pending, wr, last_wr, idle_ms, rd;
+	long long start;
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+
+	if (!p_uart_dev || !data || p_uart_dev->uart_rx_mode != UART_RX_MODE_DMA_POLLLIST)
+	{
+		return UART_RET_EINVAL;
+	}
+
+	idle_ms = drv_uart_rx_idle_ms(p_uart_dev);
+	start = os_time_get();
+	pending = drv_uart_rx_dma_pending(p_uart_dev, &last_wr);
+
+	while (pending < UART_BUF_BLOCK_SIZE && ms_timeout)
+	{
+		if (ms_timeout != WAIT_FOREVER && os_time_get() - start >= ms_timeout)
+		{
+			break;
+		}
+
+		/** a filled block wakes us up early */
+		os_sem_wait(p_uart_dev->uart_rx_sem, idle_ms);
+
+		pending = drv_uart_rx_dma_pending(p_uart_dev, &wr);
+		if (pending && wr == last_wr)
+		{
+			p_uart_dev->uart_rx_stats.rx_bursts++;
+			break;
+		}
+		last_wr = wr;
+	}
+
+	rd = p_uart_dev->uart_rx_dma_rd % UART_BUF_SIZE;
+	*data = &uart_src[rd];
+
+	return MIN(pending, UART_BUF_SIZE - rd);
+}
+
+/**    @brief		Uart rx consume.
+*	   @details 	Release data returned by drv_uart_rx_peek() back to dma.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	len         Length consumed
+*	   @return  	Length actually consumed, negative--failed
+*/
+int drv_uart_rx_consume(E_DRV_UART_NUM uart_num, unsigned int len)
+{
+	unsigned int pending, wr;
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+
+	if (!p_uart_dev || p_uart_dev->uart_rx_mode != UART_RX_MODE_DMA_POLLLIST)
+	{
+		return UART_RET_EINVAL;
+	}
+
+	pending = drv_uart_rx_dma_pending(p_uart_dev, &wr);
+	len = MIN(len, pending);
+	p_uart_dev->uart_rx_dma_rd += len;
+	p_uart_dev->uart_rx_stats.rx_bytes += len;
+	uart_rd = p_uart_dev->uart_rx_dma_rd % UART_BUF_SIZE;
+
+	return len;
+}
+
+/**    @brief		Switch uart rx mode.
+*	   @details 	Switch an opened uart between user callback mode and dma looplist mode,
+*                   so that a consumer can take the rx path over without reopening the uart.
+*	   @param[in]	uart_num   Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	mode       UART_RX_MODE_USER or UART_RX_MODE_DMA_POLLLIST
+*	   @return  	0--Switch succeed, other--Switch failed
+*/
+static int drv_uart_set_rx_mode(E_DRV_UART_NUM uart_num, unsigned int mode)
+{
+	int chn;
+	unsigned long flags;
+	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
+	T_UART_REG_MAP * p_uart_reg = p_uart_dev->uart_reg_base;
+
+	if (mode == p_uart_dev->uart_rx_mode)
+	{
+		return UART_RET_SUCCESS;
+	}
+
+	if (mode == UART_RX_MODE_DMA_POLLLIST && p_uart_dev->uart_rx_mode == UART_RX_MODE_USER)
+	{
+		if (!p_uart_dev->uart_rx_sem)
+		{
+			p_uart_dev->uart_rx_sem = os_sem_create(1, 0);
+			if (!p_uart_dev->uart_rx_sem)
+			{
+				return UART_RET_ENOMEM;
+			}
+		}
+
+		chn = drv_dma_ch_alloc();
+		if (chn < 0)
+		{
+			return UART_RET_ENODMA;
+		}
+		p_uart_dev->uart_rx_dma_chn = (unsigned char)chn;
+		drv_dma_isr_register(chn, drv_uart_receive_dma_looplist_isr, (void  *)p_uart_dev);
+
+		flags = system_irq_save();
+		p_uart_reg->Mux1.IER = (~DRV_UART_IER_ERBII) & p_uart_reg->Mux1.IER;
+		p_uart_reg->Mux2.FCR = DRV_UART_FCR_DMAE|DRV_UART_FCR_FIFORST;
+		p_uart_dev->uart_rx_mode = mode;
+		uart_rd = 0;
+		system_irq_restore(flags);
+
+		drv_uart_receive_dma_looplist(uart_num, (unsigned int)uart_src);
+	}
+	else if (mode == UART_RX_MODE_USER && p_uart_dev->uart_rx_mode == UART_RX_MODE_DMA_POLLLIST)
+	{
+		flags = system_irq_save();
+		drv_dma_stop(p_uart_dev->uart_rx_dma_chn);
+		drv_dma_ch_release(p_uart_dev->uart_rx_dma_chn);
+		p_uart_dev->uart_rx_mode = mode;
+		if (p_uart_dev->uart_tx_mode == UART_TX_MODE_DMA)
+		{
+			p_uart_reg->Mux2.FCR = DRV_UART_FCR_RFIFOT(0) | DRV_UART_FCR_FIFORST | DRV_UART_FCR_DMAE;
+		}
+		else
+		{
+			p_uart_reg->Mux2.FCR = DRV_UART_FCR_RFIFOT(0) | DRV_UART_FCR_FIFORST;
+		}
+		p_uart_reg->Mux1.IER = DRV_UART_IER_ERBII | p_uart_reg->Mux1.IER;
+		system_irq_restore(flags);
+	}
+	else
+	{
+		return UART_RET_EINVAL;
+	}
+
+	return UART_RET_SUCCESS;
+}
+
 /**    @brief		Uart tx/rx interrupts default.
 *	   @details 	Default uart tx/rx interrupts before uart tx/rx starts.
 *	   @param[in]	vector  Register interrupt vector number
@@ -974,7 +1700,7 @@ int  drv_uart_open(E_DRV_UART_NUM uart_num, T_DRV_UART_CONFIG * cfg)
 			return UART_RET_ENODMA;
 		}
 
-		drv_dma_isr_register(p_uart_dev->uart_rx_dma_chn, drv_uart_receive_dma_isr, (void  *)p_uart_dev);
+		drv_dma_isr_register(p_uart_dev->uart_rx_dma_chn, drv_uart_receive_dma_looplist_isr, (void  *)p_uart_dev);
 		p_uart_reg->Mux2.FCR = DRV_UART_FCR_DMAE|DRV_UART_FCR_FIFORST;
 		uart_rd = 0;
 		drv_uart_receive_dma_looplist(uart_num,(unsigned int)uart_src);
@@ -1002,6 +1728,10 @@ int drv_uart_close(E_DRV_UART_NUM uart_num)
 		drv_dma_ch_release(p_uart_dev->uart_rx_dma_chn);
 	}
 
+#ifdef CONFIG_UART_TX_DMA_RING
+	drv_uart_tx_ring_release(p_uart_dev);
+#endif
+
 	while(drv_uart_rx_tstc((unsigned int)p_uart_reg));
 	while(drv_uart_tx_ready((unsigned int)p_uart_reg));
 	os_msdelay(1);
@@ -1111,85 +1841,43 @@ unsigned int time_inter(unsigned int timer_s,unsigned int timer_e)
 	return time_inte;
 }
 
+/**    @brief		Uart receive data in dma looplist mode.
+*	   @details 	Copy out of the dma ring through drv_uart_rx_peek()/drv_uart_rx_consume(), until len bytes are read
+*                   or ms_timeout expires.
+*	   @param[in]	uart_num    Specifies the uart number to open, using E_DRV_UART_NUM type
+*	   @param[in]	*buf        Buffer pointer, the base address of the buffer used to receive data    
+*	   @param[in]	len         Length of received data
+*	   @param[in]	ms_timeout  Set the timeout value(ms)
+*	   @return  	non negative value--Actual receive length, other--Receive failed
+*/
 int drv_uart_receive_dma_polllist(E_DRV_UART_NUM uart_num, char * buf, unsigned int len, unsigned int ms_timeout)
 {
-	unsigned int read_length;
-	unsigned int uart_wr;
-	unsigned int remain_length = 0;
-	unsigned int start_time = 0;
-	unsigned int   msdelay = ms_timeout * (CHIP_CLOCK_APB / 1000);
-	//unsigned long flags;
-	T_DRV_UART_DEV * p_uart_dev = uart_dev[uart_num];
-	
-	start_time = drv_pit_get_tick();
-	do{
-		//flags = system_irq_save();
-		uart_wr = READ_REG(MEM_BASE_DMAC + 0x4C + (p_uart_dev->uart_rx_dma_chn * 0x14)); 
-		if(uart_rd ==   (uart_wr - (unsigned int)uart_src))
-		{
-			remain_length = 0;
-		}
-		else if(uart_rd >    (uart_wr - (unsigned int)uart_src))
-		{
-			remain_length = (UART_BUF_SIZE - uart_rd)    + (uart_wr - (unsigned int)uart_src);
-		}
-		else if(uart_rd <    (uart_wr -(unsigned int) uart_src))
-		{
-			remain_length =  (uart_wr - (unsigned int)uart_src) - uart_rd;
-		}
-		
-		if(remain_length >= len)
-		{
-			read_length = MIN(len, UART_BUF_SIZE-uart_rd);
-			if(read_length < len)
-			{
-				memcpy(buf, &uart_src[uart_rd],read_length);
-				uart_rd = 0;
-				memcpy(&buf[read_length], &uart_src[uart_rd],len - read_length);
-				uart_rd = len - read_length;
-			}
-			else
-			{
-				memcpy(buf, &uart_src[uart_rd],len);
-				uart_rd += len;
-				if(uart_rd == UART_BUF_SIZE)
-				{
-					uart_rd = 0;
-				}
-			}
-			//system_irq_restore(flags);		
-			return len;
-		}
+	unsigned char * data;
+	unsigned int got = 0, wait = ms_timeout, elapsed;
+	long long start = os_time_get();
+	int n;
 
-		os_msleep(2);
-		//system_irq_restore(flags);		
-	}while(msdelay > time_inter(start_time,drv_pit_get_tick()));
-	
-	if(remain_length < len)
+	while (got < len)
 	{
-		read_length = MIN(remain_length, UART_BUF_SIZE-uart_rd);
-		if(read_length < remain_length)
+		n = drv_uart_rx_peek(uart_num, &data, wait);
+		if (n <= 0)
 		{
-			memcpy(buf, &uart_src[uart_rd],read_length);
-			uart_rd = 0;
-			memcpy(&buf[read_length], &uart_src[uart_rd],remain_length - read_length);
-			uart_rd = remain_length - read_length;
+			break;
 		}
-		else
+
+		n = MIN((unsigned int)n, len - got);
+		memcpy(&buf[got], data, n);
+		drv_uart_rx_consume(uart_num, n);
+		got += n;
+
+		if (ms_timeout != WAIT_FOREVER)
 		{
-			memcpy(buf, &uart_src[uart_rd],remain_length);
-			uart_rd += remain_length;
-			if(uart_rd == UART_BUF_SIZE)
-			{
-				uart_rd = 0;
-			}
+			elapsed = (unsigned int)(os_time_get() - start);
+			wait = (elapsed < ms_timeout) ? ms_timeout - elapsed : 0;
 		}
-		//system_irq_restore(flags);		
-
-		return remain_length;
 	}
 
-	return 0;
+	return got;
 }
 
 /**    @brief		Uart receive data.
@@ -1221,7 +1909,7 @@ int drv_uart_read(E_DRV_UART_NUM uart_num, char * buf, unsigned int len, unsigne
 }
 
 /**    @brief		Handle uart different events.
-*	   @details 	The events handled include reg_base, set baud, isr_register, rx_reset.
+*	   @details 	The events handled include reg_base, set baud, isr_register, rx_reset, rx_mode, rx_dma_pos, rts, rx_stats.
 *	   @param[in]	uart_num    Specifies the uart number to open, using E_DRV_UART_NUM type
 *	   @param[in]	event       Control event type
 *	   @param[in]	*arg    Control parameters, the specific meaning is determined according to the event
@@ -1274,6 +1962,58 @@ int drv_uart_ioctrl(E_DRV_UART_NUM uart_num, int event, void * arg)
 		case DRV_UART_CTRL_RX_RESET:
 			drv_uart_receive_reset(p_uart_dev);			
 			break;
+
+		case DRV_UART_CTRL_SET_RX_MODE:
+			return drv_uart_set_rx_mode(uart_num, *((unsigned int *)arg));
+
+		case DRV_UART_CTRL_GET_RX_DMA_POS:
+			if (p_uart_dev->uart_rx_mode != UART_RX_MODE_DMA_POLLLIST)
+			{
+				return UART_RET_EINVAL;
+			}
+			*((unsigned int *)arg) = drv_uart_rx_dma_pos(p_uart_dev);
+			break;
+
+		case DRV_UART_CTRL_GET_RX_DMA_WRITTEN:
+			if (p_uart_dev->uart_rx_mode != UART_RX_MODE_DMA_POLLLIST)
+			{
+				return UART_RET_EINVAL;
+			}
+			*((unsigned int *)arg) = drv_uart_rx_dma_written(p_uart_dev);
+			break;
+
+		case DRV_UART_CTRL_RX_DMA_WAIT:
+			if (p_uart_dev->uart_rx_mode != UART_RX_MODE_DMA_POLLLIST)
+			{
+				return UART_RET_EINVAL;
+			}
+			/** woken by the looplist block isr, a partial block shows up after the timeout */
+			return os_sem_wait(p_uart_dev->uart_rx_sem, *((unsigned int *)arg)) ? UART_RET_ERROR : UART_RET_SUCCESS;
+
+		case DRV_UART_CTRL_GET_RX_STATS:
+			*((T_DRV_UART_RX_STATS *)arg) = p_uart_dev->uart_rx_stats;
+			break;
+
+#ifdef CONFIG_UART_TX_DMA_RING
+		case DRV_UART_CTRL_GET_TX_RING_STATS:
+			if (!p_uart_dev->uart_tx_ring)
+			{
+				return UART_RET_EINVAL;
+			}
+			*((T_DRV_UART_TX_RING_STATS *)arg) = p_uart_dev->uart_tx_ring->stats;
+			break;
+
+#endif
+		case DRV_UART_CTRL_SET_RTS:
+			if (*((unsigned int *)arg))
+			{
+				p_uart_reg->MCR = p_uart_reg->MCR | DRV_UART_MCR_RTS;
+			}
+			else
+			{
+				p_uart_reg->MCR = p_uart_reg->MCR & (~DRV_UART_MCR_RTS);
+			}
+			break;
 /*
 		case DRV_UART_CTRL_RX_INTR_ENABLE:
 			p_uart_reg->Mux1.IER = DRV_UART_IER_ERBII;
@@ -31,5 +31,21 @@ void hal_aes_crypt(const unsigned char input[16], unsigned char output[16])
 	return drv_aes_crypt(input, output);
 }
 
+int hal_aes_ecb_crypt(const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	return drv_aes_ecb_crypt(input, output, len);
+}
+
+int hal_aes_cbc_crypt(int mode, unsigned char iv[16], const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	return drv_aes_cbc_crypt(mode, iv, input, output, len);
+}
+
+int hal_aes_ctr_crypt(unsigned int *nc_off, unsigned char nonce_counter[16], unsigned char stream_block[16],
+					const unsigned char *input, unsigned char *output, unsigned int len)
+{
+	return drv_aes_ctr_crypt(nc_off, nonce_counter, stream_block, input, output, len);
+}
+
 
 
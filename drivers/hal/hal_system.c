@@ -86,6 +86,11 @@ void hal_system_reset(RST_TYPE type)
 
 	if(type <= RST_TYPE_UNKOWN)
 	{
+#ifdef CONFIG_UART_TX_DMA_RING
+		/* queued console output would be lost with the reset */
+		extern CLI_DEV s_cli_dev;
+		drv_uart_tx_ring_panic(s_cli_dev.cli_uart_num);
+#endif
 		hal_set_reset_type(type);
 		drv_wdt_chip_reset();
 	}
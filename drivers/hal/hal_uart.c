@@ -24,6 +24,16 @@ int hal_uart_get_recv_len(E_DRV_UART_NUM uart_num)
 	return drv_uart_get_recv_len(uart_num);
 }
 
+int hal_uart_rx_peek(E_DRV_UART_NUM uart_num, unsigned char ** data, int outtime_ms)
+{
+	return drv_uart_rx_peek(uart_num, data, outtime_ms);
+}
+
+int hal_uart_rx_consume(E_DRV_UART_NUM uart_num, int len)
+{
+	return drv_uart_rx_consume(uart_num, len);
+}
+
 int hal_uart_close(E_DRV_UART_NUM uart_num)
 {
 	return drv_uart_close(uart_num);
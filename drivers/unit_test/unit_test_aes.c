@@ -8,6 +8,7 @@
 #include "task.h"
 #include "oshal.h"
 #include "hal_aes.h"
+#include "pit.h"
 
 
 /**Definition of encryption and decryption types*/
@@ -558,6 +559,207 @@ static int utest_aes_decryption(cmd_tbl_t *t, int argc, char *argv[])
 CLI_SUBCMD(ut_aes, dec, utest_aes_decryption, "unit test aes dec", "ut_aes dec [mode] [keybits]");
 
 
+/**NIST SP800-38A F.1.1/F.2.1/F.5.1, AES-128, four blocks*/
+static const unsigned char utest_aes_sp800_key[16] =
+{
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const unsigned char utest_aes_sp800_iv[16] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+};
+
+static const unsigned char utest_aes_sp800_ctr[16] =
+{
+	0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+};
+
+static const unsigned char utest_aes_sp800_plain[64] =
+{
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+	0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+	0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+	0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+static const unsigned char utest_aes_sp800_ecb[64] =
+{
+	0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97,
+	0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf,
+	0x43, 0xb1, 0xcd, 0x7f, 0x59, 0x8e, 0xce, 0x23, 0x88, 0x1b, 0x00, 0xe3, 0xed, 0x03, 0x06, 0x88,
+	0x7b, 0x0c, 0x78, 0x5e, 0x27, 0xe8, 0xad, 0x3f, 0x82, 0x23, 0x20, 0x71, 0x04, 0x72, 0x5d, 0xd4
+};
+
+static const unsigned char utest_aes_sp800_cbc[64] =
+{
+	0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+	0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x19, 0xee, 0x95, 0xdb, 0x11, 0x3a, 0x91, 0x76, 0x78, 0xb2,
+	0x73, 0xbe, 0xd6, 0xb8, 0xe3, 0xc1, 0x74, 0x3b, 0x71, 0x16, 0xe6, 0x9e, 0x22, 0x22, 0x95, 0x16,
+	0x3f, 0xf1, 0xca, 0xa1, 0x68, 0x1f, 0xac, 0x09, 0x12, 0x0e, 0xca, 0x30, 0x75, 0x86, 0xe1, 0xa7
+};
+
+static const unsigned char utest_aes_sp800_ctr_cipher[64] =
+{
+	0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+	0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+	0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+	0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+};
+
+static int utest_aes_check(const char *name, const unsigned char *expect, const unsigned char *buf, unsigned int len)
+{
+	if (memcmp(expect, buf, len) == 0)
+	{
+		os_printf(LM_CMD,LL_INFO,">> %s pass!\r\n", name);
+		return 0;
+	}
+
+	os_printf(LM_CMD,LL_INFO,">> %s failed!\r\n", name);
+	return 1;
+}
+
+/**
+@brief     Bulk ECB/CBC/CTR against the SP800-38A vectors
+@details   Runs in place and on an unaligned buffer, CTR is fed in odd sized pieces
+           so the saved keystream is carried between calls.
+*/
+static int utest_aes_vector(cmd_tbl_t *t, int argc, char *argv[])
+{
+	unsigned char buf[64 + 1], iv[16], ctr[16], stream[16];
+	unsigned char *ubuf = buf + 1;
+	unsigned int off, fail = 0;
+
+	hal_aes_lock();
+
+	hal_aes_ecb_setkey(utest_aes_sp800_key, DRV_AES_KEYBITS_128, DRV_AES_MODE_ENC);
+	memcpy(buf, utest_aes_sp800_plain, 64);
+	hal_aes_ecb_crypt(buf, buf, 64);
+	fail += utest_aes_check("bulk ecb encrypt", utest_aes_sp800_ecb, buf, 64);
+
+	memcpy(iv, utest_aes_sp800_iv, 16);
+	hal_aes_cbc_crypt(DRV_AES_MODE_ENC, iv, utest_aes_sp800_plain, ubuf, 64);
+	fail += utest_aes_check("bulk cbc encrypt", utest_aes_sp800_cbc, ubuf, 64);
+	fail += utest_aes_check("bulk cbc iv out", &utest_aes_sp800_cbc[48], iv, 16);
+
+	memcpy(ctr, utest_aes_sp800_ctr, 16);
+	off = 0;
+	hal_aes_ctr_crypt(&off, ctr, stream, utest_aes_sp800_plain, ubuf, 5);
+	hal_aes_ctr_crypt(&off, ctr, stream, utest_aes_sp800_plain + 5, ubuf + 5, 30);
+	hal_aes_ctr_crypt(&off, ctr, stream, utest_aes_sp800_plain + 35, ubuf + 35, 29);
+	fail += utest_aes_check("bulk ctr", utest_aes_sp800_ctr_cipher, ubuf, 64);
+
+	hal_aes_ecb_setkey(utest_aes_sp800_key, DRV_AES_KEYBITS_128, DRV_AES_MODE_DEC);
+	memcpy(ubuf, utest_aes_sp800_ecb, 64);
+	hal_aes_ecb_crypt(ubuf, ubuf, 64);
+	fail += utest_aes_check("bulk ecb decrypt", utest_aes_sp800_plain, ubuf, 64);
+
+	memcpy(iv, utest_aes_sp800_iv, 16);
+	memcpy(buf, utest_aes_sp800_cbc, 64);
+	hal_aes_cbc_crypt(DRV_AES_MODE_DEC, iv, buf, buf, 64);
+	fail += utest_aes_check("bulk cbc decrypt", utest_aes_sp800_plain, buf, 64);
+
+	hal_aes_unlock();
+
+	os_printf(LM_CMD,LL_INFO,">> aes vector %s\r\n\r\n", fail ? "FAILED" : "OK");
+
+	return fail ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+CLI_SUBCMD(ut_aes, vector, utest_aes_vector, "unit test aes bulk api vectors", "ut_aes vector");
+
+
+/**
+@brief     Throughput of the single block path against the bulk api
+@details   "block" is the previous mbedtls pattern: lock, setkey, one block, unlock.
+*/
+static int utest_aes_bench(cmd_tbl_t *t, int argc, char *argv[])
+{
+	unsigned int len = 4096, loops = 16, i, j, off, begin, ticks[5];
+	unsigned char iv[16], stream[16];
+	unsigned char *buf;
+	static const char *name[5] = {"block", "ecb", "cbc enc", "cbc dec", "ctr"};
+
+	if (argc >= 2)
+	{
+		len = (unsigned int)strtoul(argv[1], NULL, 0) & ~(DRV_AES_BLOCK_BYTES - 1);
+	}
+	if (argc >= 3)
+	{
+		loops = (unsigned int)strtoul(argv[2], NULL, 0);
+	}
+	if ((len == 0) || (loops == 0))
+	{
+		os_printf(LM_CMD,LL_INFO,">> usage: ut_aes bench [bytes] [loops]\r\n");
+		return CMD_RET_FAILURE;
+	}
+
+	buf = os_zalloc(len);
+	if (buf == NULL)
+	{
+		return CMD_RET_FAILURE;
+	}
+	memset(iv, 0, sizeof(iv));
+	memset(ticks, 0, sizeof(ticks));
+
+	for (i = 0; i < loops; i++)
+	{
+		begin = drv_pit_get_tick();
+		for (j = 0; j < len; j += DRV_AES_BLOCK_BYTES)
+		{
+			hal_aes_lock();
+			hal_aes_ecb_setkey(utest_aes_key_128, DRV_AES_KEYBITS_128, DRV_AES_MODE_ENC);
+			hal_aes_crypt(buf + j, buf + j);
+			hal_aes_unlock();
+		}
+		ticks[0] += drv_pit_get_tick() - begin;
+
+		begin = drv_pit_get_tick();
+		hal_aes_lock();
+		hal_aes_ecb_setkey(utest_aes_key_128, DRV_AES_KEYBITS_128, DRV_AES_MODE_ENC);
+		hal_aes_ecb_crypt(buf, buf, len);
+		hal_aes_unlock();
+		ticks[1] += drv_pit_get_tick() - begin;
+
+		begin = drv_pit_get_tick();
+		hal_aes_lock();
+		hal_aes_ecb_setkey(utest_aes_key_128, DRV_AES_KEYBITS_128, DRV_AES_MODE_ENC);
+		hal_aes_cbc_crypt(DRV_AES_MODE_ENC, iv, buf, buf, len);
+		hal_aes_unlock();
+		ticks[2] += drv_pit_get_tick() - begin;
+
+		begin = drv_pit_get_tick();
+		hal_aes_lock();
+		hal_aes_ecb_setkey(utest_aes_key_128, DRV_AES_KEYBITS_128, DRV_AES_MODE_DEC);
+		hal_aes_cbc_crypt(DRV_AES_MODE_DEC, iv, buf, buf, len);
+		hal_aes_unlock();
+		ticks[3] += drv_pit_get_tick() - begin;
+
+		begin = drv_pit_get_tick();
+		off = 0;
+		hal_aes_lock();
+		hal_aes_ecb_setkey(utest_aes_key_128, DRV_AES_KEYBITS_128, DRV_AES_MODE_ENC);
+		hal_aes_ctr_crypt(&off, iv, stream, buf, buf, len);
+		hal_aes_unlock();
+		ticks[4] += drv_pit_get_tick() - begin;
+	}
+
+	os_printf(LM_CMD,LL_INFO,">> aes bench %d bytes x %d\r\n", len, loops);
+	for (i = 0; i < 5; i++)
+	{
+		/**40 pit ticks per us*/
+		os_printf(LM_CMD,LL_INFO,"%-8s %6dus %6dKB/s\r\n", name[i], ticks[i] / 40,
+			ticks[i] ? (unsigned int)((unsigned long long)len * loops * 40 * 1000000 / ticks[i] / 1024) : 0);
+	}
+
+	os_free(buf);
+
+	return CMD_RET_SUCCESS;
+}
+
+CLI_SUBCMD(ut_aes, bench, utest_aes_bench, "unit test aes throughput", "ut_aes bench [bytes] [loops]");
+
+
 CLI_CMD(ut_aes, NULL, "unit test aes", "test_aes");
 
 
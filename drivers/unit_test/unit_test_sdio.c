@@ -0,0 +1,160 @@
+
+
+#include <string.h>
+#include <stdlib.h>
+#include "cli.h"
+
+#include "oshal.h"
+#include "sdio_slave_interface.h"
+
+#define UT_SDIO_FRAMES      40
+#define UT_SDIO_FRAME_MAX   1600
+#define UT_SDIO_OUT_LEN     (CONFIG_SDIO_SLAVE_TX_AGG_MAX_LEN + 512)
+
+typedef struct
+{
+    sdio_tx_bufs_t *frame;
+    int index;
+    int errors;
+} ut_sdio_check_t;
+
+static unsigned char ut_sdio_byte(int frame, unsigned int off)
+{
+    return (unsigned char)(frame * 31 + off);
+}
+
+/* a frame from the aggregate must match the chain it was packed from */
+static void ut_sdio_check_frame(void *arg, unsigned char *data, unsigned int len)
+{
+    ut_sdio_check_t *check = (ut_sdio_check_t *)arg;
+    sdio_tx_bufs_t *frag;
+    unsigned int off = 0;
+
+    if (check->frame == NULL || len != (check->frame->total_len >> 16))
+    {
+        check->errors++;
+        return;
+    }
+
+    for (frag = check->frame; frag; frag = frag->next_frag)
+    {
+        if (memcmp(data + off, (void *)frag->bufs, frag->lens) != 0)
+        {
+            check->errors++;
+        }
+        off += frag->lens;
+    }
+
+    check->frame = check->frame->next_buf;
+    check->index++;
+}
+
+static int utest_sdio_agg(cmd_tbl_t *t, int argc, char *argv[])
+{
+    static sdio_tx_bufs_t frames[UT_SDIO_FRAMES][2];
+    sdio_tx_bufs_t *head = NULL, *tail = NULL, *batch;
+    ut_sdio_check_t check;
+    unsigned char *out, *data;
+    unsigned int len, flen, off;
+    int i, j, n, loops, transfers = 0, fail = 0;
+
+    loops = (argc > 1) ? atoi(argv[1]) : 10;
+    out = os_malloc(UT_SDIO_OUT_LEN);
+    data = os_malloc(UT_SDIO_FRAMES * UT_SDIO_FRAME_MAX + 4);
+    if (out == NULL || data == NULL)
+    {
+        os_free(out);
+        os_free(data);
+        return CMD_RET_FAILURE;
+    }
+
+    while (loops-- > 0 && !fail)
+    {
+        /* random frames of one or two fragments, all but the last fragment word sized */
+        head = tail = NULL;
+        n = 1 + rand() % UT_SDIO_FRAMES;
+        for (i = 0; i < n; i++)
+        {
+            flen = 1 + rand() % UT_SDIO_FRAME_MAX;
+            for (off = 0; off < flen; off++)
+            {
+                data[i * UT_SDIO_FRAME_MAX + off] = ut_sdio_byte(i, off);
+            }
+
+            memset(frames[i], 0, sizeof(frames[i]));
+            frames[i][0].bufs = (unsigned int)&data[i * UT_SDIO_FRAME_MAX];
+            frames[i][0].lens = flen;
+            if (flen > 64 && (rand() & 1))
+            {
+                frames[i][0].lens = (rand() % (flen - 4)) & ~3;
+                frames[i][0].lens = frames[i][0].lens ? frames[i][0].lens : 4;
+                frames[i][1].bufs = frames[i][0].bufs + frames[i][0].lens;
+                frames[i][1].lens = flen - frames[i][0].lens;
+                frames[i][0].next_frag = &frames[i][1];
+            }
+            frames[i][0].total_len = flen << 16;
+
+            if (tail)
+            {
+                tail->next_buf = &frames[i][0];
+            }
+            else
+            {
+                head = &frames[i][0];
+            }
+            tail = &frames[i][0];
+        }
+
+        /* pack the queue into aggregates and split them again */
+        j = 0;
+        while (head)
+        {
+            batch = head;
+            len = sdio_agg_pack(&head, out, UT_SDIO_OUT_LEN);
+            if (len == 0 || (len > 512 && (len & 511)))
+            {
+                os_printf(LM_CMD, LL_ERR, "bad aggregate length %u\r\n", len);
+                fail = 1;
+                break;
+            }
+
+            check.frame = batch;
+            check.index = 0;
+            check.errors = 0;
+            i = sdio_agg_parse(out, len, ut_sdio_check_frame, &check);
+            if (i <= 0 || i != check.index || check.errors || check.frame != NULL)
+            {
+                os_printf(LM_CMD, LL_ERR, "aggregate %d: %d frames, %d checked, %d errors\r\n",
+                          transfers, i, check.index, check.errors);
+                fail = 1;
+                break;
+            }
+            j += i;
+            transfers++;
+        }
+
+        if (!fail && j != n)
+        {
+            os_printf(LM_CMD, LL_ERR, "%d of %d frames packed\r\n", j, n);
+            fail = 1;
+        }
+    }
+
+    /* a truncated or foreign buffer is rejected */
+    memset(out, 0, SDIO_AGG_HDR_LEN);
+    if (!fail && sdio_agg_parse(out, SDIO_AGG_HDR_LEN, NULL, NULL) != -1)
+    {
+        os_printf(LM_CMD, LL_ERR, "foreign buffer accepted\r\n");
+        fail = 1;
+    }
+
+    os_free(out);
+    os_free(data);
+    os_printf(LM_CMD, LL_INFO, "sdio agg %s, %d aggregates\r\n", fail ? "fail" : "pass", transfers);
+
+    return fail ? CMD_RET_FAILURE : CMD_RET_SUCCESS;
+}
+
+CLI_SUBCMD(ut_sdio, agg, utest_sdio_agg, "unit test sdio tx aggregation", "ut_sdio agg [loops]");
+
+CLI_CMD(ut_sdio, NULL, "unit test sdio", "ut_sdio");
@@ -5,6 +5,8 @@
 #include "oshal.h"
 #include "chip_pinmux.h"
 #include "uart.h"
+#include "pit.h"
+#include "chip_clk_ctrl.h"
 #define TEST_UART_BUF_SIZE	2048
 
 static unsigned char  uart_buffer[TEST_UART_BUF_SIZE]  __attribute__((section(".dma.data")));
@@ -137,6 +139,144 @@ CLI_SUBCMD(ut_uart, write, utest_uart_write, "unit test uart write", "ut_uart wr
 
 
 
+static int utest_uart_peek(cmd_tbl_t *t, int argc, char *argv[])
+{
+	unsigned char * data;
+	unsigned int total, got = 0, err = 0, n, i;
+	int len, timeout_ms = 1000;
+	T_DRV_UART_RX_STATS stats;
+
+	if (argc >= 2)
+	{
+		total = (unsigned int)strtoul(argv[1], NULL, 0);
+		if (argc >= 3)
+		{
+			timeout_ms = (int)strtoul(argv[2], NULL, 0);
+		}
+	}
+	else
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, err: no enough argc!\r\n");
+		return 0;
+	}
+
+	/** uart1 opened with rx_mode 3, the peer sends "0123456789..." */
+	while (got < total)
+	{
+		len = hal_uart_rx_peek(1, &data, timeout_ms);
+		if (len <= 0)
+		{
+			break;
+		}
+
+		n = ((unsigned int)len > total - got) ? total - got : (unsigned int)len;
+		for (i = 0; i < n; i++)
+		{
+			if ((unsigned int)(data[i] - '0') != (got + i) % 10)
+			{
+				err++;
+			}
+		}
+		hal_uart_rx_consume(1, n);
+		got += n;
+	}
+
+	drv_uart_ioctrl(1, DRV_UART_CTRL_GET_RX_STATS, &stats);
+	os_printf(LM_CMD,LL_INFO,"\r\nrx:%d/%d err:%d bursts:%d overruns:%d\r\n", got, total, err, stats.rx_bursts, stats.rx_overruns);
+
+	if (got == total && !err)
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, uart1 peek ok!\r\n");
+	}
+	else
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, uart1 peek failed!\r\n");
+	}
+
+	return 0;
+}
+
+CLI_SUBCMD(ut_uart, peek, utest_uart_peek, "unit test uart zero-copy rx", "ut_uart peek [uart-len] [timeout-ms]");
+
+#ifdef CONFIG_UART_TX_DMA_RING
+#define TEST_UART_TX_RING_SIZE	4096
+#define TEST_UART_TICKS_PER_US	(CHIP_CLOCK_APB / 1000000)
+
+static char uart_tx_ring_buffer[TEST_UART_TX_RING_SIZE] __attribute__((section(".dma.data")));
+
+static int utest_uart_txring(cmd_tbl_t *t, int argc, char *argv[])
+{
+	static const char line[] = "unit test uart tx ring 0123456789abcdefghijklmnopqrstuv\n";
+	unsigned int lines, policy = UART_TX_RING_BLOCK, size = 1024, i, begin;
+	unsigned int poll_ticks = 0, ring_ticks = 0, len = sizeof(line) - 1;
+	T_DRV_UART_TX_RING_STATS stats;
+	int ok;
+
+	if (argc >= 2)
+	{
+		lines = (unsigned int)strtoul(argv[1], NULL, 0);
+		if (argc >= 3)
+		{
+			policy = (unsigned int)strtoul(argv[2], NULL, 0);
+		}
+		if (argc >= 4)
+		{
+			size = (unsigned int)strtoul(argv[3], NULL, 0);
+			size = (size > TEST_UART_TX_RING_SIZE) ? TEST_UART_TX_RING_SIZE : size;
+		}
+	}
+	else
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, err: no enough argc!\r\n");
+		return 0;
+	}
+
+	/** uart1 freshly opened in poll or stream tx mode, same lines once polled and once through the ring */
+	for (i = 0; i < lines; i++)
+	{
+		begin = drv_pit_get_tick();
+		drv_uart_send_poll(1, (char *)line, len);
+		poll_ticks += drv_pit_get_tick() - begin;
+	}
+
+	if (drv_uart_tx_ring_open(1, uart_tx_ring_buffer, size) != 0)
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, uart1 tx ring open failed!\r\n");
+		return 0;
+	}
+
+	for (i = 0; i < lines; i++)
+	{
+		begin = drv_pit_get_tick();
+		drv_uart_tx_ring_write(1, line, len, policy);
+		ring_ticks += drv_pit_get_tick() - begin;
+	}
+	drv_uart_tx_ring_flush(1, 5000);
+
+	drv_uart_ioctrl(1, DRV_UART_CTRL_GET_TX_RING_STATS, &stats);
+	os_printf(LM_CMD,LL_INFO,"\r\npoll:%dus/line ring:%dus/line\r\n", poll_ticks / TEST_UART_TICKS_PER_US / lines, ring_ticks / TEST_UART_TICKS_PER_US / lines);
+	os_printf(LM_CMD,LL_INFO,"tx:%d lost:%d drops:%d truncs:%d blocks:%d dma:%d max_fill:%d\r\n",
+		stats.tx_bytes, stats.lost_bytes, stats.drops, stats.truncs, stats.blocks, stats.dma_xfers, stats.max_fill);
+
+	/** blocking must not lose anything, the other policies must account for every byte */
+	ok = (policy == UART_TX_RING_BLOCK) ? (stats.tx_bytes == lines * len && !stats.lost_bytes)
+		: (stats.tx_bytes + stats.lost_bytes == lines * len);
+	if (ok)
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, uart1 tx ring ok!\r\n");
+	}
+	else
+	{
+		os_printf(LM_CMD,LL_INFO,"\r\nunit test uart, uart1 tx ring failed!\r\n");
+	}
+
+	return 0;
+}
+
+CLI_SUBCMD(ut_uart, txring, utest_uart_txring, "unit test uart tx dma ring", "ut_uart txring [lines] [policy] [ring-size]");
+#endif
+
+
 static int utest_uart_close(cmd_tbl_t *t, int argc, char *argv[])
 {
 	if (hal_uart_close(1) == 0)
@@ -245,6 +245,12 @@ typedef struct _CLI_DEV
 //void cli_vprintf(const char *f,  va_list ap);
 void component_cli_init(E_DRV_UART_NUM uart_num);
 void cli_cmd_deliver(char *cmd);
+#ifdef CONFIG_CLI_TX_DMA
+/* ring-full policy of the console for the calling task, E_DRV_UART_TX_RING_POLICY.
+ * network tasks that must never wait on the console set UART_TX_RING_DROP or UART_TX_RING_TRUNCATE.
+ */
+int cli_tx_policy_set(int policy);
+#endif
 struct cli_cmd *find_cmd(char *cmd);
 cmd_tbl_t *find_sub_cmd(cmd_tbl_t *parent, char *cmd);
 
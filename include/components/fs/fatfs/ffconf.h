@@ -163,7 +163,11 @@
 / Drive/Volume Configurations
 /---------------------------------------------------------------------------*/
 
+#ifdef CONFIG_FATFS_RAMDISK
+#define FF_VOLUMES		2	/* "1:" is the RAM disk */
+#else
 #define FF_VOLUMES		1
+#endif
 /* Number of volumes (logical drives) to be used. (1-10) */
 
 
@@ -36,6 +36,10 @@ extern "C" {
 
 
 //add by wangfei end
+#ifndef CONFIG_HTTPD_WORKERS
+#define CONFIG_HTTPD_WORKERS 0
+#endif
+
 /*
 note: esp_https_server.h includes a customized copy of this
 initializer that should be kept in sync
@@ -44,6 +48,8 @@ initializer that should be kept in sync
         .task_priority      = tskIDLE_PRIORITY+5,       \
         .stack_size         = 4096,                     \
         .core_id            = 0,           \
+        .worker_count       = CONFIG_HTTPD_WORKERS,     \
+        .worker_stack_size  = 4096,                     \
         .server_port        = 80,                       \
         .ctrl_port          = 32768,                    \
         .max_open_sockets   = 7,                        \
@@ -96,6 +102,15 @@ typedef struct httpd_config {
     size_t      stack_size;         /*!< The maximum stack size allowed for the server task */
     BaseType_t  core_id;            /*!< The core the HTTP server task will run on */
 
+    /**
+     * Number of worker tasks running requests. With 0 every request is
+     * parsed and handled in the server task itself. Otherwise the server
+     * task only waits for sockets to become readable and hands the session
+     * to a worker, so a slow handler no longer stalls the other clients.
+     */
+    uint16_t    worker_count;
+    size_t      worker_stack_size;  /*!< Stack size of each worker task */
+
     /**
      * TCP Port number for receiving and transmitting HTTP traffic
      */
@@ -476,6 +491,80 @@ int httpd_sess_update_lru_counter(httpd_handle_t handle, int sockfd);
 int httpd_get_client_list(httpd_handle_t handle, size_t *fds, int *client_fds);
 typedef void (*httpd_work_fn_t)(void *arg);
 int httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void *arg);
+
+/**
+ * @brief Response transmit statistics of a server instance
+ */
+typedef struct httpd_tx_stats {
+    uint32_t responses;         /*!< Responses completed (a chunked response counts once) */
+    uint32_t send_calls;        /*!< Calls into the socket layer, one writev counts once */
+    uint32_t bytes;             /*!< Bytes handed to the socket layer */
+    uint32_t latency_us;        /*!< Sum of the time from response start to last byte sent */
+    uint32_t latency_max_us;    /*!< Worst response latency */
+} httpd_tx_stats_t;
+
+/**
+ * @brief Read the response transmit statistics, optionally clearing them
+ *
+ * @param[in]  handle   Handle to server returned by httpd_start
+ * @param[out] stats    Statistics snapshot
+ * @param[in]  reset    Clear the counters after reading
+ * @return OS_SUCCESS or ERR_INVALID_ARG
+ */
+int httpd_get_tx_stats(httpd_handle_t handle, httpd_tx_stats_t *stats, bool reset);
+
+/**
+ * @brief Statistics of a registered URI handler
+ */
+typedef struct httpd_handler_stats {
+    uint32_t calls;             /*!< Requests dispatched to the handler */
+    uint32_t errors;            /*!< Requests the handler failed */
+    uint32_t async;             /*!< Requests completed through the async API */
+    uint32_t latency_us;        /*!< Sum of the time from dispatch to request completion */
+    uint32_t latency_max_us;    /*!< Worst handler latency */
+} httpd_handler_stats_t;
+
+/**
+ * @brief Read the statistics of the URI handler in slot index
+ *
+ * @param[in]  handle   Handle to server returned by httpd_start
+ * @param[in]  index    Handler slot, 0 to max_uri_handlers - 1
+ * @param[out] uri      URI the handler is registered for, may be NULL
+ * @param[out] method   Method the handler is registered for, may be NULL
+ * @param[out] stats    Statistics snapshot
+ * @param[in]  reset    Clear the counters after reading
+ * @return OS_SUCCESS, ERR_NOT_FOUND for an empty slot, or ERR_INVALID_ARG
+ *         past the last slot
+ */
+int httpd_get_handler_stats(httpd_handle_t handle, unsigned index, const char **uri,
+                            httpd_method_t *method, httpd_handler_stats_t *stats, bool reset);
+
+/**
+ * @brief Take a request over so it can be completed after the handler returns
+ *
+ * Copies the request into out. The handler then returns OS_SUCCESS right
+ * away and the copy is answered later from any task with the usual
+ * httpd_resp_* / httpd_req_recv calls on *out, followed by
+ * httpd_req_async_handler_complete(). The session is not read or closed in
+ * the meantime. All async requests have to be completed before httpd_stop().
+ *
+ * @param[in]  r    Request passed to the URI handler
+ * @param[out] out  Copy of the request, valid until completed
+ * @return OS_SUCCESS, ERR_INVALID_ARG, ERR_INVALID_STATE if the request is
+ *         already async, or ERR_NO_MEM
+ */
+int httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+
+/**
+ * @brief Finish a request taken over by httpd_req_async_handler_begin()
+ *
+ * Flushes the response, discards any unread body, frees the copy and gives
+ * the session back to the server.
+ *
+ * @param[in] r  Request returned by httpd_req_async_handler_begin()
+ * @return OS_SUCCESS or ERR_INVALID_ARG
+ */
+int httpd_req_async_handler_complete(httpd_req_t *r);
 #ifdef CONFIG_HTTPD_WS_SUPPORT
 /**
  * @brief Enum for WebSocket packet types (Opcode in the header)
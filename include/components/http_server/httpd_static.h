@@ -0,0 +1,109 @@
+/**
+ * \file httpd_static.h
+ * \brief Static assets served straight out of XIP-mapped flash
+ *
+ * Assets are bundled at build time into a read-only pack image by
+ * components/http_server/tools/httpd_pack and either written to a flash
+ * partition or linked in as a const array. The pack is used in place:
+ * response bodies are handed to the socket straight from their XIP
+ * address, nothing is copied to RAM or allocated on the heap.
+ *
+ * Every asset carries an ETag (CRC32 of its bytes), so a client that
+ * revalidates gets a bodyless 304. Single byte ranges are answered with
+ * 206, and a precompressed "<path>.gz" variant is preferred when the client
+ * accepts gzip.
+ */
+#ifndef __HTTPD_STATIC_H__
+#define __HTTPD_STATIC_H__
+
+#include <stdint.h>
+#include <http_server_service.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HTTPD_STATIC_MAGIC      0x4b415048  /*!< "HPAK" */
+#define HTTPD_STATIC_VERSION    1
+
+#define HTTPD_STATIC_F_GZIP     0x1         /*!< Entry holds the gzip encoded variant of its path */
+
+/**
+ * @brief Pack image header, followed by the sorted entry table. All offsets
+ *        are from the start of the image, all fields little endian.
+ */
+typedef struct httpd_static_hdr {
+    uint32_t magic;         /*!< HTTPD_STATIC_MAGIC */
+    uint16_t version;       /*!< HTTPD_STATIC_VERSION */
+    uint16_t count;         /*!< Number of entries */
+    uint32_t size;          /*!< Size of the whole image */
+    uint32_t reserved;
+} httpd_static_hdr_t;
+
+/**
+ * @brief Pack entry. Entries are sorted by path, the plain variant of a
+ *        path comes before its gzip variant.
+ */
+typedef struct httpd_static_entry {
+    uint32_t path_off;      /*!< NUL terminated request path, e.g. "/index.html" */
+    uint32_t type_off;      /*!< NUL terminated content type */
+    uint32_t data_off;      /*!< Asset bytes, 4 byte aligned */
+    uint32_t data_len;      /*!< Asset length */
+    uint32_t etag;          /*!< CRC32 of the asset bytes */
+    uint32_t flags;         /*!< HTTPD_STATIC_F_* */
+} httpd_static_entry_t;
+
+/**
+ * @brief Use the pack image at the given address, usually XIP flash
+ *
+ * @param[in] pack  Start of the image, must stay mapped while mounted
+ * @param[in] size  Bytes available at pack, used to validate the image
+ * @return OS_SUCCESS or ERR_INVALID_VERSION / ERR_INVALID_SIZE / ERR_INVALID_ARG
+ */
+int httpd_static_mount(const void *pack, size_t size);
+
+/**
+ * @brief Use the pack image written to a flash partition, via its XIP mapping
+ *
+ * @param[in] name  Partition name in the partition table
+ * @return OS_SUCCESS, ERR_NOT_FOUND if there is no such partition, or the
+ *         result of httpd_static_mount()
+ */
+int httpd_static_mount_partition(const char *name);
+
+/**
+ * @brief Forget the mounted pack, e.g. before its partition is rewritten
+ */
+void httpd_static_unmount(void);
+
+/**
+ * @brief Serve the asset stored under path as the response to req
+ *
+ *        Handles If-None-Match, Range/If-Range and Accept-Encoding, and
+ *        answers HEAD requests without a body.
+ *
+ * @return OS_SUCCESS once a response was sent, ERR_NOT_FOUND if the pack
+ *         has no such asset (nothing sent), or ERR_HTTPD_RESP_SEND
+ */
+int httpd_static_send(httpd_req_t *req, const char *path);
+
+/**
+ * @brief URI handler serving req->uri from the pack, 404 if it is missing.
+ *        A path ending in '/' serves its index.html.
+ */
+int httpd_static_handler(httpd_req_t *req);
+
+/**
+ * @brief Register httpd_static_handler() for GET and HEAD on uri
+ *
+ * @param[in] handle  Server handle
+ * @param[in] uri     URI or wildcard pattern ending in '*' (needs the server
+ *                    started with httpd_uri_match_wildcard as uri_match_fn)
+ */
+int httpd_static_register(httpd_handle_t handle, const char *uri);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HTTPD_STATIC_H__ */
@@ -0,0 +1,102 @@
+/**
+ * \file psm_stat.h
+ * \brief Wake causes, awake time and sleep residency of the PSM sleep cycle
+ *
+ * The idle hook (psm_schedule_idle_cb) is prebuilt, so the accounting sits
+ * around it: the FreeRTOS low power trace points time every sleep on the 32k
+ * RTC, and each awake window in between is booked to what woke the device.
+ * That is the first of, in this order:
+ *
+ *  - an os_timer callback or a received frame, whichever came first
+ *    (a beacon whose TIM kept the device up for a frame books to the frame)
+ *  - a beacon, counted by psm
+ *  - the first task switched in, i.e. a delay ran out or a notify came
+ *  - the first interrupt
+ *
+ * Idle hook calls shorter than a tick are not sleeps, their time stays awake.
+ *
+ * "psm_stat" prints the report, "psm_stat dump" the same data as a hex
+ * blob that components/psm_stat/tools/psm_energy turns into an energy budget.
+ */
+#ifndef __PSM_STAT_H__
+#define __PSM_STAT_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSM_STAT_HZ             32768   /*!< Unit of all times, the RTC counter */
+#define PSM_STAT_BUCKETS        10      /*!< Sleep lengths <4 ms, <8 ms ... <1 s, longer */
+#define PSM_STAT_NAME_LEN       12
+
+/**
+ * @brief What an awake window is booked to
+ */
+enum psm_stat_wake {
+    PSM_STAT_WAKE_UNKNOWN = 0,
+    PSM_STAT_WAKE_IRQ,          /*!< id: vector */
+    PSM_STAT_WAKE_TASK,         /*!< name: task */
+    PSM_STAT_WAKE_TIMER,        /*!< name: os_timer */
+    PSM_STAT_WAKE_BEACON,
+    PSM_STAT_WAKE_RX_BCAST,     /*!< id: ethertype */
+    PSM_STAT_WAKE_RX_MCAST,     /*!< id: ethertype */
+    PSM_STAT_WAKE_RX_UCAST,     /*!< id: ethertype */
+    PSM_STAT_WAKE_MAX
+};
+
+typedef struct psm_stat_cause {
+    uint8_t  wake;              /*!< enum psm_stat_wake */
+    uint16_t id;
+    char     name[PSM_STAT_NAME_LEN];
+    uint32_t count;
+    uint32_t awake_max;
+    uint64_t awake;
+} psm_stat_cause_t;
+
+typedef struct psm_stat_summary {
+    uint32_t sleeps;
+    uint32_t short_idles;       /*!< idle hook calls too short to be a sleep */
+    uint32_t causes;            /*!< entries psm_stat_get_cause() has */
+    uint64_t asleep;
+    uint64_t awake;             /*!< of the windows closed so far */
+    uint32_t hist_count[PSM_STAT_BUCKETS];
+    uint64_t hist_time[PSM_STAT_BUCKETS];
+} psm_stat_summary_t;
+
+void psm_stat_get_summary(psm_stat_summary_t *summary);
+
+/**
+ * @brief Copy cause entry index, in the order first seen; -1 past the end
+ */
+int psm_stat_get_cause(unsigned int index, psm_stat_cause_t *cause);
+
+void psm_stat_reset(void);
+
+/**
+ * @brief Print the sleep histogram and the causes by awake time
+ */
+void psm_stat_report(void);
+
+/**
+ * @brief Print the data as hex for tools/psm_energy:
+ *          #psm_stat 1 len=<bytes>
+ *          P <up to 32 bytes hex>
+ *          #end
+ */
+void psm_stat_dump(void);
+
+/* called from the kernel port, the timer service and the wifi rx path */
+void psm_stat_idle_begin(void);
+void psm_stat_idle_end(void);
+void psm_stat_irq(unsigned int vector);
+void psm_stat_task(const char *name);
+void psm_stat_timer(const char *name);
+void psm_stat_rx(const uint8_t *eth);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PSM_STAT_H__ */
@@ -0,0 +1,122 @@
+/**
+ * \file systrace.h
+ * \brief Binary trace ring for scheduler, interrupt, network, flash and heap events
+ *
+ * Static tracepoints write fixed size records into a RAM ring that keeps the
+ * newest CONFIG_SYSTRACE_RECORDS events. Every event type has its own bit in
+ * the enable mask; a tracepoint whose bit is clear costs one load and a branch,
+ * and all of them compile out without CONFIG_SYSTRACE.
+ *
+ * "systrace dump" prints the ring as text over the console or telnet, and
+ * components/systrace/tools/systrace2json turns that log into Chrome trace
+ * JSON that chrome://tracing and ui.perfetto.dev open.
+ */
+#ifndef __SYSTRACE_H__
+#define __SYSTRACE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Event types, the value is the bit in the enable mask
+ */
+enum systrace_event {
+    SYSTRACE_EV_TASK = 0,       /*!< Task switched in: a16 tcb address >> 2, a0/a1 first 8 name chars */
+    SYSTRACE_EV_IRQ,            /*!< Span, a16 vector */
+    SYSTRACE_EV_NET_RX,         /*!< wifi_net_input(): a16 ethertype, a0 length */
+    SYSTRACE_EV_NET_TX,         /*!< Span around low_level_output(): a0 length, end a0 lwip status */
+    SYSTRACE_EV_FLASH_ERASE,    /*!< Span: a0 address, a1 length, end a0 result */
+    SYSTRACE_EV_FLASH_WRITE,    /*!< Span: a0 address, a1 length, end a0 result */
+    SYSTRACE_EV_MALLOC,         /*!< a0 address, a1 size */
+    SYSTRACE_EV_FREE,           /*!< a0 address, a1 size */
+    SYSTRACE_EV_MQTT_PUB,       /*!< a16 qos, a0 length, a1 message id */
+    SYSTRACE_EV_MARK,           /*!< systrace_mark() from application code */
+    SYSTRACE_EV_MAX
+};
+
+#define SYSTRACE_EV_MASK        0x3f
+#define SYSTRACE_PH_INSTANT     0
+#define SYSTRACE_PH_BEGIN       1
+#define SYSTRACE_PH_END         2
+#define SYSTRACE_PH_SHIFT       6
+#define SYSTRACE_ALL            ((1U << SYSTRACE_EV_MAX) - 1)
+
+/**
+ * @brief One record. ts is the raw PIT tick counter, a 32 bit value that the
+ *        decoder unwraps, so the ring must not go idle for longer than one
+ *        wrap (about 107 s at 40 MHz) between two records.
+ */
+typedef struct systrace_rec {
+    uint32_t ts;
+    uint8_t  event;             /*!< enum systrace_event | phase << SYSTRACE_PH_SHIFT */
+    uint8_t  ctx;               /*!< 0 in a task, else the interrupt vector + 1 */
+    uint16_t a16;
+    uint32_t a0;
+    uint32_t a1;
+} systrace_rec_t;
+
+typedef struct systrace_stats {
+    unsigned int mask;          /*!< Events being traced, 0 when stopped */
+    unsigned int records;       /*!< Records held in the ring */
+    unsigned int written;       /*!< Records written since the last clear */
+    unsigned int hz;            /*!< Tick rate of ts */
+} systrace_stats_t;
+
+#ifdef CONFIG_SYSTRACE
+extern volatile unsigned int g_systrace_mask;
+
+void systrace_record(unsigned int event, unsigned int a16, unsigned int a0, unsigned int a1);
+
+#define SYSTRACE_ON(ev)                 (g_systrace_mask & (1U << ((ev) & SYSTRACE_EV_MASK)))
+#define SYSTRACE(ev, a16, a0, a1)       do { if (SYSTRACE_ON(ev)) systrace_record((ev), (a16), (a0), (a1)); } while (0)
+#define SYSTRACE_BEGIN(ev, a16, a0, a1) SYSTRACE((ev) | (SYSTRACE_PH_BEGIN << SYSTRACE_PH_SHIFT), a16, a0, a1)
+#define SYSTRACE_END(ev, a16, a0, a1)   SYSTRACE((ev) | (SYSTRACE_PH_END << SYSTRACE_PH_SHIFT), a16, a0, a1)
+#else
+#define SYSTRACE_ON(ev)                 0
+#define SYSTRACE(ev, a16, a0, a1)       do { } while (0)
+#define SYSTRACE_BEGIN(ev, a16, a0, a1) do { } while (0)
+#define SYSTRACE_END(ev, a16, a0, a1)   do { } while (0)
+#endif
+
+/**
+ * @brief Trace the events in mask, SYSTRACE_ALL for everything. The task
+ *        running now is recorded first so its events get a name.
+ */
+void systrace_start(unsigned int mask);
+
+/**
+ * @brief Stop tracing, the ring keeps its records until cleared
+ */
+void systrace_stop(void);
+
+/**
+ * @brief Drop every record
+ */
+void systrace_clear(void);
+
+/**
+ * @brief Print the ring, oldest record first, in the format systrace2json
+ *        reads. Tracing is stopped while it prints and resumed afterwards.
+ */
+void systrace_dump(void);
+
+void systrace_get_stats(systrace_stats_t *stats);
+
+/**
+ * @brief Application marker, shows up as an instant event
+ */
+#define systrace_mark(id, a0, a1)       SYSTRACE(SYSTRACE_EV_MARK, id, a0, a1)
+
+/* tracepoints called from the kernel port and the heap */
+void systrace_task_switch(const char *name);
+void systrace_irq_enter(unsigned int vector);
+void systrace_irq_exit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SYSTRACE_H__ */
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ * File Name:    wifi_rx_filter.h
+ * Description:  L2/L3 filter in front of lwIP input
+ *
+ * wifi_net_input() hands every received frame to wifi_rx_filter_input()
+ * before a pbuf is made of it. A frame the filter consumes never reaches
+ * the tcpip thread, which in power save is most of the broadcast traffic:
+ *
+ *  - ARP requests for our address go on to lwIP, etharp answers them and
+ *    learns the requester from the same frame. Requests for other addresses are dropped unless the gateway sends them
+ *    (lwIP only refreshes entries from those) or they are gratuitous. While
+ *    there is no address all ARP goes through.
+ *  - Multicast frames go through only for groups lwIP joined, as told by the
+ *    netif IGMP/MLD MAC filter callbacks, and the all-hosts/all-nodes groups.
+ *  - The rules, first match wins, pass or drop by destination kind,
+ *    ethertype, IP protocol and TCP/UDP destination port range.
+ *    wifi_rx_filter_udp_whitelist() sets up the usual case: broadcast and
+ *    multicast UDP only to the listed ports.
+ *
+ * EAPOL and the DHCP/DHCPv6 client ports always go through.
+ *
+ * The filter is off from boot. It is not built with the spi service, whose
+ * host joins multicast groups lwIP does not know about.
+ *******************************************************************************/
+
+#ifndef _WIFI_RX_FILTER_H
+#define _WIFI_RX_FILTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WIFI_RX_FILTER_UCAST        0x01    /**< to our MAC */
+#define WIFI_RX_FILTER_MCAST        0x02
+#define WIFI_RX_FILTER_BCAST        0x04
+#define WIFI_RX_FILTER_ANY          0x07
+
+typedef enum {
+    WIFI_RX_FILTER_PASS = 0,
+    WIFI_RX_FILTER_DROP,
+} wifi_rx_filter_action_t;
+
+typedef struct wifi_rx_filter_rule {
+    uint8_t  cast;          /**< WIFI_RX_FILTER_UCAST/MCAST/BCAST it applies to, 0 for all */
+    uint8_t  action;        /**< wifi_rx_filter_action_t */
+    uint8_t  ip_proto;      /**< IP protocol (6 TCP, 17 UDP ...), 0 for any */
+    uint16_t ethertype;     /**< 0 for any */
+    uint16_t port_min;      /**< TCP/UDP destination port range, 0-0 for any */
+    uint16_t port_max;
+} wifi_rx_filter_rule_t;
+
+typedef struct wifi_rx_filter_stats {
+    uint32_t frames;        /**< seen by the filter */
+    uint32_t arp_dropped;
+    uint32_t mcast_dropped; /**< group not joined */
+    uint32_t rule_dropped;
+} wifi_rx_filter_stats_t;
+
+/**
+ * @brief Turn the whole stage on or off, it is off from boot
+ */
+void wifi_rx_filter_enable(bool enable);
+
+/**
+ * @brief Append a rule, it is checked after the ones already there
+ * @return rule id, -1 when CONFIG_WIFI_RX_FILTER_RULES are in use
+ */
+int wifi_rx_filter_add(const wifi_rx_filter_rule_t *rule);
+
+/**
+ * @return 0, -1 when there is no rule with that id
+ */
+int wifi_rx_filter_del(int id);
+
+void wifi_rx_filter_clear(void);
+
+/**
+ * @brief Rule and its hit count by position, 0 first
+ * @return rule id, -1 past the last rule
+ */
+int wifi_rx_filter_get(int index, wifi_rx_filter_rule_t *rule, uint32_t *hits);
+
+/**
+ * @brief Replace all rules: broadcast and multicast UDP pass to these ports only
+ * @return 0, -1 when the rules do not fit
+ */
+int wifi_rx_filter_udp_whitelist(const uint16_t *ports, int count);
+
+void wifi_rx_filter_get_stats(wifi_rx_filter_stats_t *stats, bool reset);
+
+/* called by the wifi netif */
+struct netif;
+void wifi_rx_filter_netif_init(struct netif *netif);
+bool wifi_rx_filter_input(struct netif *netif, const uint8_t *frame, uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WIFI_RX_FILTER_H */
@@ -355,6 +355,78 @@ int wifi_set_promiscuous_filter(wifi_promiscuous_filter_t *filter);
   */
 int wifi_get_promiscuous_filter(wifi_promiscuous_filter_t *filter);
 
+#ifdef CONFIG_WIFI_SNIFFER_BATCH
+/**
+  * @brief One frame of a batch, the header fields already taken out.
+  *
+  * frame points into the sniffer ring and is valid until the batch callback returns.
+  */
+typedef struct {
+    uint8_t  *frame;        /**< first caplen bytes of the frame, NULL for WIFI_PKT_NULL */
+    uint16_t len;           /**< length on air */
+    uint16_t caplen;
+    uint8_t  type;          /**< wifi_promiscuous_pkt_type_t */
+    uint8_t  subtype;
+    uint8_t  flags;         /**< frame control byte 1: to/from ds, retry, protected ... */
+    int8_t   rssi;
+    uint8_t  channel;
+    uint16_t seq;           /**< sequence number, 0 for control frames */
+    uint8_t  addr1[6];
+    uint8_t  addr2[6];
+    uint8_t  addr3[6];      /**< zero when the frame is too short to have it */
+} wifi_sniffer_frame_t;
+
+/**
+  * @brief The batch callback, called from the "sniffer" task with the frames in the order received.
+  */
+typedef void (* wifi_sniffer_batch_cb_t)(const wifi_sniffer_frame_t *frames, int count);
+
+typedef struct {
+    uint16_t subtypes[WIFI_PKT_NULL + 1];   /**< by wifi_promiscuous_pkt_type_t, bit n lets subtype n in; non-zero for WIFI_PKT_NULL lets those in */
+    uint16_t snaplen[WIFI_PKT_NULL];        /**< bytes kept of mgmt/ctrl/data frames, at most CONFIG_WIFI_SNIFFER_BATCH_SNAPLEN */
+    bool     no_retry;                      /**< leave out retransmissions */
+    wifi_sniffer_batch_cb_t cb;
+} wifi_sniffer_batch_cfg_t;
+
+typedef struct {
+    uint32_t frames;        /**< put in the ring */
+    uint32_t filtered;      /**< left out by subtype or retry */
+    uint32_t dropped;       /**< ring full */
+    uint32_t batches;
+} wifi_sniffer_batch_stats_t;
+
+/**
+  * @brief     Start the promiscuous mode with batched delivery.
+  *
+  * Frames are filtered by type and subtype as they are received, copied up to
+  * the snap length into a ring of CONFIG_WIFI_SNIFFER_BATCH_SLOTS and handed to
+  * cb in batches when the ring is half full, and at least every
+  * CONFIG_WIFI_SNIFFER_BATCH_MS. The per frame callback of
+  * wifi_set_promiscuous_rx_cb() is not called meanwhile.
+  *
+  * @return
+  *    - 0: succeed
+  *    - -1: no memory, or already started
+  */
+int wifi_sniffer_batch_start(const wifi_sniffer_batch_cfg_t *cfg);
+
+/**
+  * @brief     Change the subtypes let in for one frame type while started.
+  */
+int wifi_sniffer_batch_filter(wifi_promiscuous_pkt_type_t type, uint16_t subtypes);
+
+/**
+  * @brief     Stop the promiscuous mode, as wifi_set_promiscuous(false) does.
+  *            No callback starts after this returns, one already running finishes.
+  */
+void wifi_sniffer_batch_stop(void);
+
+void wifi_sniffer_batch_get_stats(wifi_sniffer_batch_stats_t *stats);
+
+/* called by wifi_rf_set_channel() */
+void wifi_sniffer_batch_channel(uint8_t channel);
+#endif
+
 
 #ifdef __cplusplus
 }
@@ -34,6 +34,13 @@
 #define DRV_AES_MODE_ENC 1
 #define DRV_AES_MODE_DEC 0
 
+#define DRV_AES_BLOCK_BYTES		16
+
+/**Counter blocks generated per pass through the engine in drv_aes_ctr_crypt*/
+#ifndef DRV_AES_CTR_BATCH
+#define DRV_AES_CTR_BATCH		8
+#endif
+
 
 /**
 @brief    aes hardware init
@@ -76,6 +83,38 @@ int drv_aes_cbc_setkey(const unsigned char *key, unsigned int keybits, int mode,
 */
 void drv_aes_crypt(const unsigned char input[16], unsigned char output[16]);
 
+/**
+@brief      Stream whole blocks through the engine as configured by the last setkey,
+            the caller holds drv_aes_lock for the whole sequence
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count, a multiple of 16
+*/
+int drv_aes_ecb_crypt(const unsigned char *input, unsigned char *output, unsigned int len);
+
+/**
+@brief      CBC over a key loaded by drv_aes_ecb_setkey in the same direction
+@param[in]  mode:DRV_AES_MODE_ENC or DRV_AES_MODE_DEC
+@param[in,out] iv:16 bytes, updated for the next call
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count, a multiple of 16
+*/
+int drv_aes_cbc_crypt(int mode, unsigned char iv[16], const unsigned char *input, unsigned char *output, unsigned int len);
+
+/**
+@brief      CTR over a key loaded by drv_aes_ecb_setkey in encryption mode,
+            same state handling as mbedtls_aes_crypt_ctr
+@param[in,out] nc_off:offset into stream_block, 0 on the first call
+@param[in,out] nonce_counter:16 bytes big endian counter block
+@param[in,out] stream_block:16 bytes saved keystream
+@param[in]  input:data to be processed
+@param[out] output:result, may be the same as input
+@param[in]  len:byte count
+*/
+int drv_aes_ctr_crypt(unsigned int *nc_off, unsigned char nonce_counter[16], unsigned char stream_block[16],
+					const unsigned char *input, unsigned char *output, unsigned int len);
+
 
 #endif /* DRV_AES_H */
 
@@ -6,6 +6,10 @@ int hal_aes_unlock(void);
 int hal_aes_ecb_setkey(const unsigned char *key, unsigned int keybits, int mode);
 int hal_aes_cbc_setkey(const unsigned char *key, unsigned int keybits, int mode, const unsigned char *iv);
 void hal_aes_crypt(const unsigned char input[16], unsigned char output[16]);
+int hal_aes_ecb_crypt(const unsigned char *input, unsigned char *output, unsigned int len);
+int hal_aes_cbc_crypt(int mode, unsigned char iv[16], const unsigned char *input, unsigned char *output, unsigned int len);
+int hal_aes_ctr_crypt(unsigned int *nc_off, unsigned char nonce_counter[16], unsigned char stream_block[16],
+					const unsigned char *input, unsigned char *output, unsigned int len);
 
 
 
@@ -12,6 +12,8 @@ int hal_uart_callback_register(E_DRV_UART_NUM uart_num, T_UART_ISR_CALLBACK * ua
 int hal_uart_callback_register(E_DRV_UART_NUM uart_num, UART_CALLBACK uart_callback, void * uart_data);
 #endif
 int hal_uart_get_recv_len(E_DRV_UART_NUM uart_num);
+int hal_uart_rx_peek(E_DRV_UART_NUM uart_num, unsigned char ** data, int outtime_ms);
+int hal_uart_rx_consume(E_DRV_UART_NUM uart_num, int len);
 int hal_uart_close(E_DRV_UART_NUM uart_num);
 
 
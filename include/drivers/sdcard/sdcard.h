@@ -13,6 +13,23 @@ unsigned int sdcard_get_sector_count(void);
 int sdcard_status(void);
 unsigned int sdcard_get_ccs(void);
 
+typedef struct
+{
+	unsigned int commands;		/* read/write block commands sent */
+	unsigned int direct;		/* commands transferring the caller buffer in place */
+	unsigned int bounce;		/* commands through the bounce buffer */
+	unsigned int read;		/* sectors read from the card */
+	unsigned int written;		/* sectors written to the card */
+	unsigned int hits;		/* single sector reads served by the cache */
+	unsigned int misses;		/* single sector reads that went to the card */
+	unsigned int readahead;		/* sectors read ahead on sequential misses */
+	unsigned int writebacks;	/* dirty sectors written back */
+} sdcard_stats_t;
+
+/* write back the sector cache, FatFs asks for it with CTRL_SYNC */
+int sdcard_sync(void);
+void sdcard_get_stats(sdcard_stats_t *stats, int reset);
+
 
 
 
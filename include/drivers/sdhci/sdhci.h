@@ -12,6 +12,11 @@
 #define MAX_BUF_BLOCK 2
 #define SDHCI_MAX_BUF   (MAX_BLK_SIZE*MAX_BUF_BLOCK)
 
+/* ADMA2 table: each descriptor moves up to SDHCI_ADMA_MAX_LEN contiguous bytes */
+#define SDHCI_ADMA_MAX_LEN	0x8000
+#define SDHCI_ADMA_DESC_NUM	8
+#define SDHCI_MAX_BLOCKS	(SDHCI_ADMA_MAX_LEN*SDHCI_ADMA_DESC_NUM/MAX_BLK_SIZE)
+
 
 
 typedef  struct  adma2 {
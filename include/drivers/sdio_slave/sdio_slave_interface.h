@@ -94,4 +94,67 @@ int sdio_rx_cb(sdio_bufs_t *bufs, uint32_t flag);
  ********************************************************************************/
  int alloc_buffer_for_sdio(sdio_bufs_t *bufs, uint32_t flag, uint32_t need_len);
  sdio_tx_bufs_t *sdio_tx_free_queue_pop();
+
+/*
+ * Aggregated transfer to the host (CONFIG_SDIO_SLAVE_TX_AGG), all words little endian:
+ *   word0  length of the next transfer, 0 if none is queued
+ *   word1  free rx buffers | aggregate bytes before block padding << 16
+ *   word2  SDIO_AGG_MAGIC | number of frames
+ *   word3  0
+ * followed by one sub-frame per frame: a word of (frame len | padded len << 16) and the
+ * frame padded to 4 bytes (all fragments but the last of a frame must be word sized). Transfers
+ * longer than a block are padded to whole 512 byte blocks.
+ */
+#define SDIO_AGG_MAGIC         0xA6600000
+#define SDIO_AGG_MAGIC_MASK    0xFFFF0000
+#define SDIO_AGG_HDR_LEN       16
+#define SDIO_AGG_SUB_HDR_LEN   4
+
+#define SDIO_TX_FILL_BUCKETS   10
+
+typedef struct
+{
+	unsigned int transfers;                   // transfers to the host
+	unsigned int frames;                      // frames carried by them
+	unsigned int payload;                     // frame bytes
+	unsigned int wire;                        // bytes on the bus, headers and padding included
+	unsigned int max_frames;                  // most frames in one transfer
+	unsigned int fill[SDIO_TX_FILL_BUCKETS];  // transfers by payload/wire in 10% steps
+}sdio_tx_stats_t;
+
+typedef void (*sdio_agg_frame_cb_t)(void *arg, unsigned char *frame, unsigned int len);
+
+/*******************************************************************************
+ * Function: sdio_agg_parse
+ * Description: split an aggregated transfer into its frames
+ * Parameters:
+ *   Input: buf: transfer starting with its 16 byte header, len: transfer length,
+ *          cb: called for each frame in order
+ *
+ * Returns: number of frames, -1 if buf is not a valid aggregate
+ ********************************************************************************/
+int sdio_agg_parse(unsigned char *buf, unsigned int len, sdio_agg_frame_cb_t cb, void *arg);
+
+/*******************************************************************************
+ * Function: sdio_agg_pack
+ * Description: copy queued frames into one aggregate the way the tx path lays them out,
+ *              *frames advances past the frames taken
+ *
+ * Returns: aggregate length, 0 if out is too small for the first frame
+ ********************************************************************************/
+unsigned int sdio_agg_pack(sdio_tx_bufs_t **frames, unsigned char *out, unsigned int size);
+
+/*******************************************************************************
+ * Function: sdio_agg_enable
+ * Description: switch tx aggregation, only while tx is idle
+ *
+ * Returns: 0, or -1 if tx is busy
+ ********************************************************************************/
+int sdio_agg_enable(int enable);
+
+/*******************************************************************************
+ * Function: sdio_tx_stats_get
+ * Description: copy the tx transfer statistics, then clear them if reset is set
+ ********************************************************************************/
+void sdio_tx_stats_get(sdio_tx_stats_t *stats, int reset);
  #endif
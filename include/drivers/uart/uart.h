@@ -108,6 +108,43 @@ typedef struct _T_DRV_UART_CONFIG
 
 } T_DRV_UART_CONFIG;
 
+/**
+ * @brief Uart rx statistics in dma looplist mode.
+ */
+typedef struct _T_DRV_UART_RX_STATS
+{
+	unsigned int rx_bytes;		///< bytes consumed
+	unsigned int rx_bursts;		///< bursts ended by an idle line
+	unsigned int rx_overruns;	///< times dma lapped the reader and data was lost
+
+} T_DRV_UART_RX_STATS;
+
+/**
+ * @brief Uart tx ring full policy, see drv_uart_tx_ring_write().
+ */
+typedef enum _E_DRV_UART_TX_RING_POLICY
+{
+	UART_TX_RING_BLOCK = 0,		///< wait for dma to free space, falls back to truncate where sleeping is not allowed
+	UART_TX_RING_DROP,			///< drop the whole write if it does not fit
+	UART_TX_RING_TRUNCATE,		///< queue what fits, drop the tail
+	UART_TX_RING_POLICY_MAX
+} E_DRV_UART_TX_RING_POLICY;
+
+/**
+ * @brief Uart tx ring statistics.
+ */
+typedef struct _T_DRV_UART_TX_RING_STATS
+{
+	unsigned int tx_bytes;		///< bytes queued
+	unsigned int dma_xfers;		///< dma transfers started
+	unsigned int drops;			///< writes dropped whole
+	unsigned int truncs;		///< writes cut short
+	unsigned int lost_bytes;	///< bytes lost to drops and truncation
+	unsigned int blocks;		///< times a writer waited for space
+	unsigned int max_fill;		///< highest ring fill seen
+
+} T_DRV_UART_TX_RING_STATS;
+
 /**
  * @brief Uart device number.
  */
@@ -225,9 +262,17 @@ int drv_uart_get_recv_len(E_DRV_UART_NUM uart_num);
 #define DRV_UART_CTRL_REGISTER_RX_CALLBACK 		2
 #define DRV_UART_CTRL_RX_RESET	 		3
 //#define DRV_UART_CTRL_RX_INTR_ENABLE	 	4
+#define DRV_UART_CTRL_SET_RX_MODE		5
+#define DRV_UART_CTRL_GET_RX_DMA_POS	6
+#define DRV_UART_CTRL_SET_RTS			7
+#define DRV_UART_CTRL_GET_RX_STATS		8
+#define DRV_UART_CTRL_GET_TX_RING_STATS	9
+#define DRV_UART_CTRL_GET_RX_DMA_WRITTEN	10
+#define DRV_UART_CTRL_RX_DMA_WAIT		11
 
 /**    @brief		Handle uart different events.
-*	   @details 	The events handled include reg_base, set baud, isr_register, rx_reset.
+*	   @details 	The events handled include reg_base, set baud, isr_register, rx_reset, rx_mode, rx_dma_pos, rts, rx_stats, tx_ring_stats,
+*                   rx_dma_written (total bytes dma wrote) and rx_dma_wait (wait arg ms for a filled dma block).
 *	   @param[in]	uart_num    Specifies the uart number to open, using E_DRV_UART_NUM type
 *	   @param[in]	event       Control event type
 *	   @param[in]	*arg    Control parameters, the specific meaning is determined according to the event
@@ -257,5 +302,66 @@ int drv_uart_get_regbase(E_DRV_UART_NUM uart_num);
 extern unsigned char  uart_src[UART_BUF_SIZE];
 unsigned int drv_uart_receive_dma_looplist(E_DRV_UART_NUM uart_num, unsigned int buff_addr);
 
+#ifndef CONFIG_UART_RX_IDLE_CHARS
+#define CONFIG_UART_RX_IDLE_CHARS	16
+#endif
+
+/**    @brief		Uart rx peek.
+*	   @details 	Zero-copy read in dma looplist mode. Waits until a whole looplist block is pending, the line
+*                   has been idle for CONFIG_UART_RX_IDLE_CHARS characters after a burst, or ms_timeout expires,
+*                   then points *data at the oldest pending byte inside the dma ring.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[out]	**data      Pointer into the dma ring, valid until consumed
+*	   @param[in]	ms_timeout  Set the timeout value(ms), 0 returns at once
+*	   @return  	Contiguous pending length at *data (up to the ring end), 0--no data, negative--failed
+*/
+int drv_uart_rx_peek(E_DRV_UART_NUM uart_num, unsigned char ** data, unsigned int ms_timeout);
+
+/**    @brief		Uart rx consume.
+*	   @details 	Release data returned by drv_uart_rx_peek() back to dma.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	len         Length consumed
+*	   @return  	Length actually consumed, negative--failed
+*/
+int drv_uart_rx_consume(E_DRV_UART_NUM uart_num, unsigned int len);
+
+#ifdef CONFIG_UART_TX_DMA_RING
+/**    @brief		Open a uart tx ring.
+*	   @details 	Queue tx data in a ram ring drained by dma, so writers return once the data is copied.
+*                   drv_uart_send_poll() on this uart goes through the ring as well. Only for poll/stream tx mode.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	*buf        Ring storage in dma reachable sram, i.e. __attribute__((section(".dma.data")))
+*	   @param[in]	size        Ring size in bytes, rounded down to a power of two
+*	   @return  	0--Open succeed, other--Open failed
+*/
+int drv_uart_tx_ring_open(E_DRV_UART_NUM uart_num, char * buf, unsigned int size);
+
+/**    @brief		Uart tx ring write.
+*	   @details 	Copy data into the tx ring and start dma if it is idle. Callable from isr, where
+*                   UART_TX_RING_BLOCK behaves like UART_TX_RING_TRUNCATE.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	*buf        Data to send
+*	   @param[in]	len         Length of data
+*	   @param[in]	policy      What to do when the ring is full, using E_DRV_UART_TX_RING_POLICY type
+*	   @return  	Length of buf queued, negative--failed
+*/
+int drv_uart_tx_ring_write(E_DRV_UART_NUM uart_num, const char * buf, unsigned int len, unsigned int policy);
+
+/**    @brief		Uart tx ring flush.
+*	   @details 	Wait until everything queued has been handed to the uart.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*	   @param[in]	ms_timeout  Set the timeout value(ms)
+*	   @return  	0--Ring empty, other--Timeout or no ring
+*/
+int drv_uart_tx_ring_flush(E_DRV_UART_NUM uart_num, unsigned int ms_timeout);
+
+/**    @brief		Uart tx ring panic fallback.
+*	   @details 	Stop dma and send what is queued by polling, later writes bypass the ring and poll.
+*                   Safe with irq disabled, for crash dumps and reset.
+*	   @param[in]	uart_num    Specifies the uart number, using E_DRV_UART_NUM type
+*/
+void drv_uart_tx_ring_panic(E_DRV_UART_NUM uart_num);
+#endif
+
 #endif /* DRV_UART_H */
 
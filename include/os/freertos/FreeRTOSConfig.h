@@ -105,7 +105,15 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK		0
 
 /* Run time and task stats gathering definitions. */
+#if defined(CONFIG_RUNTIME_DEBUG)
+/* Microsecond run time clock from the extended PIT tick counter, see debug_core.c */
+#define configGENERATE_RUN_TIME_STATS			1
+#define portRUN_TIME_STATS_HZ					1000000
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()		runtime_counter_us()
+#else
 #define configGENERATE_RUN_TIME_STATS			0  // Don't use this option to control
+#endif
 #define configUSE_TRACE_FACILITY    			1  // Awareness debugging used
 #define configUSE_STATS_FORMATTING_FUNCTIONS	0
 
@@ -155,6 +163,9 @@ in assembler files. */
 
 	void vPreSleepProcessing( unsigned long uxExpectedIdleTime );
 	void vPostSleepProcessing( unsigned long uxExpectedIdleTime );
+#if defined(CONFIG_RUNTIME_DEBUG)
+	unsigned int runtime_counter_us( void );
+#endif
 #endif /* __ASSEMBLER__ */
 
 
@@ -201,6 +212,17 @@ provided in this demo can be extended to save even more power. */
 extern void vPortCleanUpTCB ( void *pxTCB );
 #define portCLEAN_UP_TCB( pxTCB )           vPortCleanUpTCB( pxTCB )
 #endif
+#if defined(CONFIG_SYSTRACE)
+#include "systrace.h"
+#define traceMALLOC( pvAddress, uiSize )    SYSTRACE( SYSTRACE_EV_MALLOC, 0, ( unsigned int ) ( pvAddress ), ( uiSize ) )
+#define traceFREE( pvAddress, uiSize )      SYSTRACE( SYSTRACE_EV_FREE, 0, ( unsigned int ) ( pvAddress ), ( uiSize ) )
+#endif
+#if defined(CONFIG_PSM_STAT)
+extern void psm_stat_idle_begin( void );
+extern void psm_stat_idle_end( void );
+#define traceLOW_POWER_IDLE_BEGIN()         psm_stat_idle_begin()
+#define traceLOW_POWER_IDLE_END()           psm_stat_idle_end()
+#endif
 #endif
 #define CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS 1  //temp
 #define configNUM_THREAD_LOCAL_STORAGE_POINTERS CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS
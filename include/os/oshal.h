@@ -121,6 +121,18 @@ int os_timer_start(os_timer_handle_t timer);
 int os_timer_delete(os_timer_handle_t timer);
 int os_timer_stop(os_timer_handle_t timer);
 int os_timer_changeperiod(os_timer_handle_t timer, size_t period_ms);
+#ifdef CONFIG_OS_TIMER_WHEEL
+typedef struct
+{
+    unsigned int wakeups;       /* times the wheel woke the cpu */
+    unsigned int expiries;      /* callbacks run */
+    unsigned int coalesced;     /* of those, run early on another timer's wakeup */
+    unsigned int since_ms;      /* counted over */
+} os_timer_stats_t;
+int os_timer_set_slack(os_timer_handle_t timer, size_t slack_ms);
+int os_timer_next_ms(void);
+void os_timer_get_stats(os_timer_stats_t *stats, int reset);
+#endif
 
 
 
@@ -149,6 +161,10 @@ void system_irq_restore_hook(void);
 unsigned int system_irq_save_debug(unsigned int irq_func, unsigned int irq_line);
 unsigned int system_irq_save_tick_compensation_debug(unsigned int irq_func, unsigned int irq_line);
 void sys_irq_show(void);
+void sys_irq_top(int num, int by_total);
+void sys_irq_threshold_set(unsigned int us);
+void sys_irq_trig_show(void);
+void sys_irq_reset(void);
 void sys_irq_sw_set(void);
 #define system_irq_save()                      system_irq_save_debug((unsigned int)__FUNCTION__, (unsigned int)__LINE__)
 #define system_irq_save_tick_compensation()    system_irq_save_tick_compensation_debug((unsigned int)__FUNCTION__, (unsigned int)__LINE__)
@@ -21,11 +21,18 @@
 #define LOCAL_OTA_VERSION_LESS      	2
 #define LOCAL_OTA_REPORT_CNT        	5
 
+/* url of an image streamed by multicast instead of served over http */
+#define LOCAL_OTA_MCAST_URL         	"mcast://"
+
 
 
 
 void local_ota_main();
 
+#ifdef CONFIG_OTA_LOCAL_MCAST
+int local_ota_mcast_download(const char *url);
+#endif
+
 
 
 #endif
@@ -140,7 +140,9 @@ typedef struct {
     unsigned int firmware_new_size;
     unsigned int firmware_crc;
     unsigned int firmware_new_crc;
-    unsigned char reserved[12];
+    unsigned int delta_size;            /* delta package: patch making image A, see ota_delta.h */
+    unsigned int delta_new_size;        /* delta package: patch making image B */
+    unsigned char reserved[4];
     unsigned char source_version[32];
     unsigned char target_version[32];
 } ota_package_head_t;
@@ -166,6 +168,9 @@ typedef struct {
 
 int ota_init(void);
 int ota_write(unsigned char *data, unsigned int len);
+int ota_write_at(unsigned int offset, unsigned char *data, unsigned int len);
+int ota_resume_at(unsigned char *head, unsigned int offset, unsigned int len);
+unsigned int ota_crc_at(unsigned int crc, unsigned int offset, const unsigned char *data, unsigned int len);
 int ota_done(int reset);
 int ota_confirm_update(void);
 int ota_get_flash_crc(unsigned int addr, unsigned int size);
@@ -0,0 +1,105 @@
+#ifndef __OTA_DELTA_H__
+#define __OTA_DELTA_H__
+
+/*
+ * Streaming delta patch: rebuilds a new image from the old one and a patch
+ * fed in pieces of any size, in a fixed amount of ram (sizeof(ota_delta_t)).
+ *
+ * The patch is a 28 byte head followed by an LZ77 stream (window of at most
+ * OTA_DELTA_WINDOW bytes) of bsdiff style records:
+ *
+ *   add_len, copy_len, seek        varints, seek zigzag coded
+ *   add_len bytes                  new = old[pos] + byte, pos advancing
+ *   copy_len bytes                 new = byte
+ *                                  then pos += seek
+ *
+ * LZ sequences are a token (literal count << 4 | match length - 4, 15 in
+ * either meaning more in following bytes up to one below 255), the
+ * literals, a 2 byte offset back into the output and, when the token says
+ * so, the extra match length bytes. An offset of 0 ends the stream.
+ *
+ * Plain C without os dependencies, components/ota/tools builds the same
+ * file for the host encoder and the round trip test.
+ */
+
+#define OTA_DELTA_MAGIC         0x544c4544      /* "DELT" */
+#define OTA_DELTA_MIN_MATCH     4
+#define OTA_DELTA_CHUNK         256             /* old image bytes read at once */
+
+#define OTA_DELTA_ERR_PATCH     -1              /* malformed or truncated patch */
+#define OTA_DELTA_ERR_BASE      -2              /* old image is not the one of the patch */
+#define OTA_DELTA_ERR_IO        -3              /* read or write callback failed */
+
+#ifdef CONFIG_OTA_DELTA_WINDOW
+#define OTA_DELTA_WINDOW        CONFIG_OTA_DELTA_WINDOW
+#else
+#define OTA_DELTA_WINDOW        4096
+#endif
+
+/* little endian, uncompressed */
+typedef struct
+{
+    unsigned int   magic;
+    unsigned int   old_size;
+    unsigned int   old_crc;         /* crc32 of the image the patch was made against */
+    unsigned int   new_size;
+    unsigned int   new_crc;
+    unsigned int   patch_crc;       /* crc32 of the patch after the head */
+    unsigned short window;          /* lz window used by the encoder */
+    unsigned short flags;
+} ota_delta_head_t;
+
+/* 0 once done, < 0 to give up */
+typedef int (*ota_delta_read_fn)(void *arg, unsigned int offset, unsigned char *buf, unsigned int len);
+typedef int (*ota_delta_write_fn)(void *arg, const unsigned char *data, unsigned int len);
+
+typedef struct
+{
+    ota_delta_head_t   head;
+    unsigned int       head_len;        /* head bytes in so far */
+    int                err;
+
+    /* lz stream */
+    int                lz_state;
+    unsigned int       lz_lit;
+    unsigned int       lz_match;
+    unsigned int       lz_off;
+    unsigned int       lz_wpos;         /* next window slot */
+    unsigned int       lz_total;        /* bytes out of the lz stream */
+
+    /* records */
+    int                rec_state;
+    unsigned int       rec_value;
+    unsigned int       rec_shift;
+    unsigned int       add_len;
+    unsigned int       copy_len;
+    int                seek;
+    unsigned int       old_pos;
+    unsigned int       new_pos;
+    unsigned int       crc;             /* of the new image so far */
+    unsigned int       patch_crc;       /* of the patch after the head so far */
+
+    ota_delta_read_fn  read;
+    ota_delta_write_fn write;
+    void               *arg;
+    unsigned char      window[OTA_DELTA_WINDOW];
+    unsigned char      chunk[OTA_DELTA_CHUNK];
+} ota_delta_t;
+
+unsigned int ota_delta_crc32(unsigned int crc, const void *buf, unsigned int len);
+
+/* <read> gets the old image, <write> the new one in order */
+void ota_delta_init(ota_delta_t *d, ota_delta_read_fn read, ota_delta_write_fn write, void *arg);
+
+/*
+ * Feed the next <len> bytes of the patch. Once the head is in, the old
+ * image is checked against it before anything is written. < 0 on a bad
+ * patch, a wrong old image or a read/write error, the same from then on.
+ * A patch broken in a way that still decodes is only caught by finish.
+ */
+int ota_delta_input(ota_delta_t *d, const unsigned char *data, unsigned int len);
+
+/* 0 if the patch ended where it should and the new image came out whole */
+int ota_delta_finish(ota_delta_t *d);
+
+#endif
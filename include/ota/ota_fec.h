@@ -0,0 +1,126 @@
+#ifndef __OTA_FEC_H__
+#define __OTA_FEC_H__
+
+/*
+ * Block carousel for multicast OTA: the package is cut into numbered
+ * blocks, every group of k data blocks is followed by r repair blocks
+ * (systematic Cauchy Reed-Solomon over GF(256)), so a receiver that lost
+ * any r blocks of a group rebuilds them without asking. Whatever is still
+ * missing is requested with a NACK listing block ranges.
+ *
+ * Plain C without os dependencies, components/ota/tools builds the same
+ * file for the host sender and the lossy loopback test.
+ */
+
+#define OTA_FEC_MAGIC           0x4d41544f      /* "OTAM" */
+#define OTA_FEC_DATA            1
+#define OTA_FEC_REPAIR          2
+#define OTA_FEC_NACK            3
+
+#define OTA_FEC_MAX_K           32
+#define OTA_FEC_MAX_R           8
+#define OTA_FEC_MIN_BLOCK       256
+#define OTA_FEC_MAX_BLOCK       1408            /* one frame with the headers */
+#define OTA_FEC_NACK_RANGES     64
+
+#ifdef CONFIG_OTA_LOCAL_MCAST_WINDOW
+#define OTA_FEC_SLOTS           CONFIG_OTA_LOCAL_MCAST_WINDOW
+#else
+#define OTA_FEC_SLOTS           4
+#endif
+
+/* little endian on the wire, same as both ends */
+typedef struct
+{
+    unsigned int   magic;
+    unsigned int   session;     /* crc32 of the package, tells images apart */
+    unsigned int   image_len;
+    unsigned short block_size;
+    unsigned char  k;           /* data blocks per group */
+    unsigned char  r;           /* repair blocks per group */
+    unsigned int   index;       /* data: block number, repair: group number */
+    unsigned char  type;
+    unsigned char  row;         /* repair: which of the r */
+    unsigned short len;         /* payload bytes */
+    unsigned int   crc;         /* crc32 of header and payload, with crc = 0 */
+} ota_fec_hdr_t;
+
+/* NACK payload, missing blocks first .. first + count - 1 */
+typedef struct
+{
+    unsigned int first;
+    unsigned int count;
+} ota_fec_range_t;
+
+/* 0 once stored, > 0 to have the block counted as lost for now, < 0 to give up */
+typedef int (*ota_fec_write_fn)(void *arg, unsigned int offset, const unsigned char *data, unsigned int len);
+
+typedef struct
+{
+    unsigned int  group;        /* group number + 1, 0 if free */
+    unsigned int  have;         /* data blocks folded into acc, one bit each */
+    unsigned int  rows;         /* repair rows folded into acc */
+    unsigned int  used;         /* lru stamp */
+    int           fec;          /* 0 if blocks of the group came before the slot */
+    unsigned char *acc;         /* r accumulators of block_size */
+} ota_fec_slot_t;
+
+typedef struct
+{
+    unsigned int     session;
+    unsigned int     image_len;
+    unsigned int     block_size;
+    unsigned int     k;
+    unsigned int     r;
+    unsigned int     blocks;
+    unsigned int     groups;
+    unsigned int     held;          /* blocks written */
+    unsigned int     recovered;     /* of those, rebuilt from repair blocks */
+    unsigned int     duplicates;
+    unsigned int     rejected;      /* refused by write(), e.g. before the head */
+    unsigned int     lru;
+    unsigned char    *bitmap;
+    unsigned char    *scratch;
+    ota_fec_slot_t   slot[OTA_FEC_SLOTS];
+    ota_fec_write_fn write;
+    void             *arg;
+} ota_fec_rx_t;
+
+unsigned int ota_fec_crc32(unsigned int crc, const void *buf, unsigned int len);
+
+/* 0 if <pkt> is a well formed packet, its header copied to <hdr> */
+int ota_fec_check(const unsigned char *pkt, unsigned int len, ota_fec_hdr_t *hdr);
+
+typedef struct
+{
+    const unsigned char *image;
+    unsigned int        image_len;
+    unsigned int        session;
+    unsigned int        block_size;
+    unsigned int        k;
+    unsigned int        r;
+    unsigned int        blocks;
+    unsigned int        groups;
+} ota_fec_tx_t;
+
+void ota_fec_tx_init(ota_fec_tx_t *tx, const unsigned char *image, unsigned int image_len,
+                     unsigned int block_size, unsigned int k, unsigned int r);
+
+/*
+ * Build data block <index> (OTA_FEC_DATA) or repair row <row> of group
+ * <index> (OTA_FEC_REPAIR) into <pkt>, which holds sizeof(ota_fec_hdr_t)
+ * + block_size. Returns the packet length.
+ */
+unsigned int ota_fec_encode(const ota_fec_tx_t *tx, int type, unsigned int index, unsigned int row, unsigned char *pkt);
+
+/* memory ota_fec_rx_init needs for the session of <hdr>, 0 if the parameters are unusable */
+unsigned int ota_fec_rx_mem(const ota_fec_hdr_t *hdr);
+void ota_fec_rx_init(ota_fec_rx_t *rx, const ota_fec_hdr_t *hdr, void *mem, ota_fec_write_fn write, void *arg);
+
+/* 1 once every block is written, 0 if the packet was taken or ignored, < 0 on a write error */
+int ota_fec_rx_input(ota_fec_rx_t *rx, const unsigned char *pkt, unsigned int len);
+
+/* NACK for the missing blocks into <pkt>, its length, 0 if none is missing */
+unsigned int ota_fec_rx_nack(ota_fec_rx_t *rx, unsigned char *pkt, unsigned int size);
+
+#endif
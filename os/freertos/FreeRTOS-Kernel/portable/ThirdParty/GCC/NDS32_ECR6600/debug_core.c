@@ -33,6 +33,10 @@
 #include "chip_clk_ctrl.h"
 #include "debug_core.h"
 #include "rtc.h"
+#include "systrace.h"
+#if defined(CONFIG_PSM_STAT)
+#include "psm_stat.h"
+#endif
 #ifdef CONFIG_PSM_SURPORT
 #include "psm_system.h"
 #endif
@@ -160,6 +164,19 @@ stats_isr_t        isrstats[VECTOR_NUMINTRS] = { 0 };
 unsigned int       g_isr_runtime = 0;
 unsigned int       g_ulTaskSwitchedInTime;
 unsigned long long g_ulTotalRunTime;
+
+static unsigned int       s_runtime_clk_last;
+static unsigned long long s_runtime_clk_high;
+static unsigned int       s_runtime_clk_per_us = CHIP_CLOCK_APB / 1000000;
+static unsigned int       s_runtime_switches;
+static unsigned int       s_runtime_isrs;
+static unsigned long long s_runtime_start;
+
+static irqoff_stats_t     s_irqoff;
+static irqoff_stats_t     *s_irqoff_target = &s_irqoff;
+static unsigned int       s_irqoff_start;
+static unsigned int       s_irqoff_caller;
+static unsigned int       s_irqoff_line;
 #endif
 
 #if defined(CONFIG_TASK_IRQ_RUN_NUM)
@@ -176,6 +193,20 @@ unsigned int g_uIrqRunNum[32];
  *  --------------------------------------------------------------------------*/
 
 /******************************************* Tick compensation *********************************************/
+/* PIT counter rate, it follows the cpu clock when PSM scales it */
+static unsigned int pit_clock_get(void)
+{
+#ifdef CONFIG_PSM_SURPORT
+    unsigned int cpu_freq = psm_cpu_freq_op(false, 0);
+
+    if (cpu_freq)
+    {
+        return(cpu_freq * 1000000 / 4);
+    }
+#endif
+    return(CHIP_CLOCK_APB);
+}
+
 void irq_status_track(unsigned int ulIrqEnable)
 {
     static unsigned int irq_disable_clk = 0;
@@ -230,20 +261,8 @@ void irq_status_track(unsigned int ulIrqEnable)
                 duration = DRV_PIT_TICK_CH_RELOAD - irq_disable_clk + cur_clk;
             }
 
-#ifdef CONFIG_PSM_SURPORT
-            unsigned int cpu_freq = psm_cpu_freq_op(false, 0);
             //If there is frequency modulation during lock interruption, pit cannot be used for tick compensation.
-            if (cpu_freq)
-            {
-                pit_clock = cpu_freq * 1000000 / 4;
-            }
-            else
-            {
-                pit_clock = CHIP_CLOCK_APB;
-            }
-#else
-            pit_clock = CHIP_CLOCK_APB;
-#endif
+            pit_clock = pit_clock_get();
 
             if (duration > g_irq_disable_duration)
             {
@@ -278,6 +297,12 @@ int irq_in(unsigned int irq, uint32_t stack)
 #if defined(CONFIG_TASK_IRQ_RUN_NUM)
     g_uIrqRunNum[irq]++;
 #endif
+#if defined(CONFIG_SYSTRACE)
+    systrace_irq_enter(irq);
+#endif
+#if defined(CONFIG_PSM_STAT)
+    psm_stat_irq(irq);
+#endif
 #if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
     if (g_cur_irq)
     {
@@ -294,6 +319,9 @@ int irq_in(unsigned int irq, uint32_t stack)
 }
 int irq_out(uint32_t stack)
 {
+#if defined(CONFIG_SYSTRACE)
+    systrace_irq_exit();
+#endif
 #if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
     if (stack != g_cur_irq->sp || memcmp((char*)g_cur_irq, (char *)stack, sizeof(struct isr_reg_layout) - 4))
     {
@@ -348,6 +376,12 @@ void os_check_regs(int task_handle)
 /******************************************* Task Switch Tracking *********************************************/
 void vTaskSwitchIn(char* pcTaskName)
 {
+#if defined(CONFIG_SYSTRACE)
+    systrace_task_switch(pcTaskName);
+#endif
+#if defined(CONFIG_PSM_STAT)
+    psm_stat_task(pcTaskName);
+#endif
 #if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
     xTaskSwitchStats[ucxTaskSwitchIdx].pcTaskName = pcTaskName;
     xTaskSwitchStats[ucxTaskSwitchIdx].ulclk = drv_pit_get_tick();
@@ -360,9 +394,6 @@ void vTaskSwitchOut(char* pcTaskName)
 {
     vHeapCheckInTaskSwitch();  // Default: full memory detection is not performed, which is time-consuming
     os_store_regs((int )xTaskGetCurrentTaskHandle());
-#if defined(CONFIG_RUNTIME_DEBUG)
-    runtime_status();
-#endif
 }
 
 
@@ -493,6 +524,69 @@ void irq_isr_register_withtrace(int vector, void *isr)
     isrstats[vector].irq_isr = isr;
 }
 
+/* The PIT counter extended to 64 bits. It wraps every 2^32 ticks (~107 s at 40 MHz), every
+ * task switch and isr reads it so no wrap is missed while the system runs. */
+unsigned long long runtime_clk_get(void)
+{
+    unsigned int       psw = portSET_INTERRUPT_MASK_FROM_ISR();
+    unsigned int       now = drv_pit_get_tick();
+    unsigned long long clk;
+
+    if (now < s_runtime_clk_last)
+    {
+        s_runtime_clk_high += 1ULL << 32;
+    }
+    s_runtime_clk_last = now;
+    clk                = s_runtime_clk_high | now;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+
+    return(clk);
+}
+
+/* portGET_RUN_TIME_COUNTER_VALUE(): the FreeRTOS run time stats clock, 1 MHz */
+unsigned int runtime_counter_us(void)
+{
+    return((unsigned int)(runtime_clk_get() / s_runtime_clk_per_us));
+}
+
+/* Outermost system_irq_save(): interrupts were on and are now masked */
+void irqoff_begin(unsigned int caller, unsigned int line)
+{
+    s_irqoff_start  = drv_pit_get_tick();
+    s_irqoff_caller = caller;
+    s_irqoff_line   = line;
+}
+
+/* Matching system_irq_restore(), interrupts are still masked */
+void irqoff_end(void)
+{
+    irqoff_stats_t *st = s_irqoff_target;
+    unsigned int   clk = drv_pit_get_tick() - s_irqoff_start;
+    unsigned int   us  = clk / s_runtime_clk_per_us;
+    int            bucket;
+
+    /* bucket 0 is below 1 us, bucket n covers [2^(n-1), 2^n) us */
+    bucket = us ? 32 - __builtin_clz(us) : 0;
+    if (bucket >= IRQOFF_BUCKETS)
+    {
+        bucket = IRQOFF_BUCKETS - 1;
+    }
+    st->count[bucket]++;
+    st->caller[bucket] = s_irqoff_caller;
+    st->sections++;
+    st->total += clk;
+    if (clk > st->max)
+    {
+        st->max        = clk;
+        st->max_caller = s_irqoff_caller;
+        st->max_line   = s_irqoff_line;
+    }
+    if (clk > st->window_max)
+    {
+        st->window_max = clk;
+    }
+}
+
 void comm_irq_isr_withtrace(int vector)
 {
     unsigned int isr_in;
@@ -500,7 +594,8 @@ void comm_irq_isr_withtrace(int vector)
     unsigned int runtime;
 
     //drv_pit_ioctrl(DRV_PIT_CHN_7,DRV_PIT_CTRL_GET_COUNT,(unsigned int)&isr_in);
-    isr_in = drv_pit_get_tick();
+    isr_in = (unsigned int)runtime_clk_get();
+    s_runtime_isrs++;
 
     isrstats[vector].irq_isr(vector);
 
@@ -523,9 +618,14 @@ void runtime_init()
     int i = 0;
 
     //drv_pit_ioctrl(DRV_PIT_CHN_7,DRV_PIT_CTRL_GET_COUNT,(unsigned int)&g_ulTaskSwitchedInTime);
-    g_ulTaskSwitchedInTime = drv_pit_get_tick();
+    g_ulTaskSwitchedInTime = (unsigned int)runtime_clk_get();
     g_ulTotalRunTime       = 0;
     g_isr_runtime          = 0;
+    s_runtime_clk_per_us   = pit_clock_get() / 1000000;
+    s_runtime_switches     = 0;
+    s_runtime_isrs         = 0;
+    s_runtime_start        = runtime_clk_get();
+    memset(&s_irqoff, 0, sizeof(s_irqoff));
 
     for (i = 0; i < MAX_TASK_NUM; i++)
     {
@@ -547,8 +647,9 @@ void runtime_status()
     unsigned char taskID = ucGetTaskID(NULL);
 
     //drv_pit_ioctrl(DRV_PIT_CHN_7,DRV_PIT_CTRL_GET_COUNT,(unsigned int)&ulclk);
-    ulclk     = drv_pit_get_tick();
+    ulclk     = (unsigned int)runtime_clk_get();
     ulRunTime = ulclk - g_ulTaskSwitchedInTime;
+    s_runtime_switches++;
 
     //if(ulclk>g_ulTaskSwitchedInTime)
     //	ulRunTime=g_ulTaskSwitchedInTime+(0xFFFFFFFF-ulclk);
@@ -659,6 +760,219 @@ int runtime_print(int runtime_init_t)
     return(0);
 }
 
+/* pit clocks to us, the clock rate only changes with the PSM cpu frequency */
+static unsigned int runtime_clk_to_us(unsigned long long clk)
+{
+    return((unsigned int)(clk / s_runtime_clk_per_us));
+}
+
+/* part per thousand of total, printed as "12.3%" */
+static unsigned int runtime_permille(unsigned long long part, unsigned long long total)
+{
+    return(total ? (unsigned int)(part * 1000 / total) : 0);
+}
+
+void irqoff_get(irqoff_stats_t *stats, int reset)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    if (stats)
+    {
+        *stats = s_irqoff;
+    }
+    if (reset)
+    {
+        memset(&s_irqoff, 0, sizeof(s_irqoff));
+    }
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
+int irqoff_print(int reset)
+{
+    irqoff_stats_t st;
+    unsigned int   elapsed = runtime_clk_to_us(runtime_clk_get() - s_runtime_start);
+    int            i;
+
+    irqoff_get(&st, reset);
+    os_printf(LM_CMD, LL_INFO, "irq off: %u sections, %u us total in %u ms, max %u us at ",
+              st.sections, runtime_clk_to_us(st.total), elapsed / 1000, runtime_clk_to_us(st.max));
+    if (st.max_line)
+    {
+        os_printf(LM_CMD, LL_INFO, "%s:%u\r\n", (char *)st.max_caller, st.max_line);
+    }
+    else
+    {
+        os_printf(LM_CMD, LL_INFO, "0x%08x\r\n", st.max_caller);
+    }
+
+    os_printf(LM_CMD, LL_INFO, "%14s%12s%12s\r\n", "- us -", "- count -", "- last -");
+    for (i = 0; i < IRQOFF_BUCKETS; i++)
+    {
+        if (st.count[i] == 0)
+        {
+            continue;
+        }
+        if (i == 0)
+        {
+            os_printf(LM_CMD, LL_INFO, "%14s", "<1");
+        }
+        else if (i == IRQOFF_BUCKETS - 1)
+        {
+            os_printf(LM_CMD, LL_INFO, "%13u+", 1U << (i - 1));
+        }
+        else
+        {
+            os_printf(LM_CMD, LL_INFO, "%7u-%6u", 1U << (i - 1), (1U << i) - 1);
+        }
+        os_printf(LM_CMD, LL_INFO, "%12u  0x%08x\r\n", st.count[i], st.caller[i]);
+    }
+    if (reset)
+    {
+        s_runtime_start = runtime_clk_get();
+    }
+
+    return(0);
+}
+
+/* print the entries of delta[] in descending order, delta[] is consumed */
+static void runtime_top_list(unsigned long long *delta, int num, int task, unsigned long long total)
+{
+    unsigned long long max;
+    int                i, k;
+
+    for (;;)
+    {
+        k   = -1;
+        max = 0;
+        for (i = 0; i < num; i++)
+        {
+            if (delta[i] > max)
+            {
+                max = delta[i];
+                k   = i;
+            }
+        }
+        if (k < 0)
+        {
+            break;
+        }
+        os_printf(LM_CMD, LL_INFO, "%20s%12u%7u.%u%%\r\n", task ? s_xTaskInfo[k].pcTaskName : isrname[k],
+                  runtime_clk_to_us(max), runtime_permille(max, total) / 10, runtime_permille(max, total) % 10);
+        delta[k] = 0;
+    }
+}
+
+/* top like view: cpu share of every task and isr over a window of seconds, rounds times */
+int runtime_top(int seconds, int rounds)
+{
+    unsigned long long *task_last, *isr_last, *delta;
+    unsigned long long total, total_last, irqoff_last;
+    unsigned int       switches, isrs, sections;
+    irqoff_stats_t     st;
+    int                i, num;
+
+    num       = MAX_TASK_NUM + VECTOR_NUMINTRS;
+    task_last = os_malloc(2 * num * sizeof(unsigned long long));
+    if (task_last == NULL)
+    {
+        return(-1);
+    }
+    isr_last = task_last + MAX_TASK_NUM;
+    delta    = task_last + num;
+
+    while (rounds-- > 0)
+    {
+        vTaskSuspendAll();
+        for (i = 0; i < MAX_TASK_NUM; i++)
+        {
+            task_last[i] = s_xTaskInfo[i].ullRunTime;
+        }
+        for (i = 0; i < VECTOR_NUMINTRS; i++)
+        {
+            isr_last[i] = isrstats[i].runtime;
+        }
+        total_last = g_ulTotalRunTime;
+        switches   = s_runtime_switches;
+        isrs       = s_runtime_isrs;
+        irqoff_get(&st, 0);
+        sections    = st.sections;
+        irqoff_last = st.total;
+        s_irqoff.window_max = 0;
+        xTaskResumeAll();
+
+        os_msleep(seconds * 1000);
+
+        vTaskSuspendAll();
+        for (i = 0; i < MAX_TASK_NUM; i++)
+        {
+            delta[i] = s_xTaskInfo[i].pcTaskName[0] ? s_xTaskInfo[i].ullRunTime - task_last[i] : 0;
+        }
+        for (i = 0; i < VECTOR_NUMINTRS; i++)
+        {
+            delta[MAX_TASK_NUM + i] = isrstats[i].runtime - isr_last[i];
+        }
+        total    = g_ulTotalRunTime - total_last;
+        switches = s_runtime_switches - switches;
+        isrs     = s_runtime_isrs - isrs;
+        irqoff_get(&st, 0);
+        xTaskResumeAll();
+
+        os_printf(LM_CMD, LL_INFO, "\r\n%u ms, %u switches/s, %u isr/s, irq off %u sections %u.%u%% max %u us\r\n",
+                  runtime_clk_to_us(total) / 1000, switches / seconds, isrs / seconds, st.sections - sections,
+                  runtime_permille(st.total - irqoff_last, total) / 10, runtime_permille(st.total - irqoff_last, total) % 10,
+                  runtime_clk_to_us(st.window_max));
+        os_printf(LM_CMD, LL_INFO, "%20s%12s%9s\r\n", "- task -", "- us -", "- CPU -");
+        runtime_top_list(delta, MAX_TASK_NUM, 1, total);
+        os_printf(LM_CMD, LL_INFO, "%20s%12s%9s\r\n", "- IRQ -", "- us -", "- CPU -");
+        runtime_top_list(delta + MAX_TASK_NUM, VECTOR_NUMINTRS, 0, total);
+    }
+    os_free(task_last);
+
+    return(0);
+}
+
+/* Cost of the accounting itself: time the hooks with interrupts masked, then scale by the
+ * events counted since runtime_init() */
+int runtime_overhead_print(void)
+{
+    irqoff_stats_t     scratch;
+    unsigned long long elapsed;
+    unsigned int       psw, start, clk_cost, irqoff_cost, loops = 1000, i;
+    unsigned int       events, sections;
+
+    memset(&scratch, 0, sizeof(scratch));
+    psw   = portSET_INTERRUPT_MASK_FROM_ISR();
+    start = drv_pit_get_tick();
+    for (i = 0; i < loops; i++)
+    {
+        runtime_clk_get();
+    }
+    clk_cost = drv_pit_get_tick() - start;
+
+    s_irqoff_target = &scratch;
+    start           = drv_pit_get_tick();
+    for (i = 0; i < loops; i++)
+    {
+        irqoff_begin((unsigned int)__builtin_return_address(0), 0);
+        irqoff_end();
+    }
+    irqoff_cost     = drv_pit_get_tick() - start;
+    s_irqoff_target = &s_irqoff;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+
+    elapsed  = runtime_clk_get() - s_runtime_start;
+    events   = s_runtime_switches + s_runtime_isrs;
+    sections = s_irqoff.sections;
+    os_printf(LM_CMD, LL_INFO, "pit %u MHz, clock read %u ns, irq off hook %u ns\r\n", s_runtime_clk_per_us,
+              clk_cost * 1000 / s_runtime_clk_per_us / loops, irqoff_cost * 1000 / s_runtime_clk_per_us / loops);
+    os_printf(LM_CMD, LL_INFO, "%u switches+isr, %u irq off sections in %u ms, overhead %u permille\r\n",
+              events, sections, runtime_clk_to_us(elapsed) / 1000,
+              runtime_permille((unsigned long long)events * clk_cost / loops + (unsigned long long)sections * irqoff_cost / loops,
+                               elapsed));
+
+    return(0);
+}
+
 #endif//CONFIG_RUNTIME_DEBUG
 
 #endif  // defined(CONFIG_HEAP_DEBUG) || defined(CONFIG_RUNTIME_DEBUG)
@@ -32,6 +32,8 @@
 *  --------------------------------------------------------------------------*/
 /** Description of the macro */
 #define MAX_TASK_NUM       32
+/** irq-off histogram buckets, log2 of the section length in us */
+#define IRQOFF_BUCKETS     16
 
 /*--------------------------------------------------------------------------
 *                                               Types
@@ -55,6 +57,23 @@ struct isr_reg_layout
     uint32_t sp;
 };
 
+/**
+ * @brief Interrupt disabled sections, outermost system_irq_save()/restore() pairs
+ * @details Lengths are in PIT clocks, bucket 0 counts sections below 1 us and
+ *          bucket n the ones in [2^(n-1), 2^n) us, the last bucket is open ended.
+ */
+typedef struct
+{
+    unsigned int       count[IRQOFF_BUCKETS];
+    unsigned int       caller[IRQOFF_BUCKETS];  /* last section that landed in the bucket */
+    unsigned int       sections;
+    unsigned long long total;
+    unsigned int       max;
+    unsigned int       max_caller;              /* function name or return address */
+    unsigned int       max_line;                /* 0 if max_caller is a return address */
+    unsigned int       window_max;              /* max since the last os_debug top round */
+} irqoff_stats_t;
+
 /*--------------------------------------------------------------------------
 *                                               Constants
 *  --------------------------------------------------------------------------*/
@@ -88,5 +107,16 @@ int heap_print(char* pcTaskName_t);
 int runtime_print(int runtime_init_t);
 #endif //defined(CONFIG_HEAP_DEBUG) || defined(CONFIG_RUNTIME_DEBUG)
 
+#if defined(CONFIG_RUNTIME_DEBUG)
+unsigned long long runtime_clk_get(void);
+unsigned int runtime_counter_us(void);
+void irqoff_begin(unsigned int caller, unsigned int line);
+void irqoff_end(void);
+void irqoff_get(irqoff_stats_t *stats, int reset);
+int irqoff_print(int reset);
+int runtime_top(int seconds, int rounds);
+int runtime_overhead_print(void);
+#endif //CONFIG_RUNTIME_DEBUG
+
 #endif/*_DEBUG_CORE_H*/
 
@@ -214,6 +214,11 @@ static void uart_dump(const unsigned char * buf, unsigned int len)
     extern CLI_DEV s_cli_dev;
     unsigned int   p_uart_reg = (unsigned int )s_cli_dev.cli_uart_base;
 
+#ifdef CONFIG_UART_TX_DMA_RING
+    /* flush the console ring by polling and keep dma off the fifo from here on */
+    drv_uart_tx_ring_panic(s_cli_dev.cli_uart_num);
+#endif
+
     while (len)
     {
         if (uart_tx_fifo_depth == 0)
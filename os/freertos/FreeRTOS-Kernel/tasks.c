@@ -2138,7 +2138,7 @@ void vTaskStartScheduler( void )
          * have portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() defined in your
          * FreeRTOSConfig.h file. */
         portCONFIGURE_TIMER_FOR_RUN_TIME_STATS();
-#if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
+#if defined(CONFIG_TASK_IRQ_SWITCH_TRACE) || defined(CONFIG_SYSTRACE) || defined(CONFIG_PSM_STAT)
         traceTASK_SWITCHED_IN();
 #endif
 #if defined(CONFIG_RUNTIME_DEBUG)
@@ -3088,6 +3088,9 @@ void vTaskSwitchContext( void )
 #if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
         traceTASK_SWITCHED_OUT();
 #endif
+#if defined(CONFIG_RUNTIME_DEBUG)
+        runtime_status();
+#endif
 
         #if ( configGENERATE_RUN_TIME_STATS == 1 )
             {
@@ -3138,7 +3141,7 @@ void vTaskSwitchContext( void )
             g_uTaskRunNum[MAX_TASK_NUM-1]++;
         }
 #endif
-#if defined(CONFIG_TASK_IRQ_SWITCH_TRACE)
+#if defined(CONFIG_TASK_IRQ_SWITCH_TRACE) || defined(CONFIG_SYSTRACE) || defined(CONFIG_PSM_STAT)
         traceTASK_SWITCHED_IN();
 #endif
 
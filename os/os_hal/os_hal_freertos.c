@@ -413,6 +413,7 @@ void * os_zalloc_debug(size_t size, char*filename, unsigned int line)
 
 
 
+#ifndef CONFIG_OS_TIMER_WHEEL
 /**************************************************************************************
 *SoftTimer API
 **************************************************************************************/
@@ -531,6 +532,7 @@ int os_timer_changeperiod(os_timer_handle_t timer, size_t period_ms)
         return(-1);
     }
 }
+#endif /* CONFIG_OS_TIMER_WHEEL */
 
 
 
@@ -589,8 +591,20 @@ int os_msdelay(size_t delay_ms)
 /**************************************************************************************
 *Interrupt API
 **************************************************************************************/
+#ifdef CONFIG_RUNTIME_DEBUG
+/* debug_core.c, only the outermost section is timed: psw still has GIE set */
+void irqoff_begin(unsigned int caller, unsigned int line);
+void irqoff_end(void);
+#define IRQOFF_BEGIN(psw, caller, line)    do { if ((psw) & PSW_mskGIE) irqoff_begin((unsigned int)(caller), (line)); } while (0)
+#define IRQOFF_END(psw)                    do { if ((psw) & PSW_mskGIE) irqoff_end(); } while (0)
+#else
+#define IRQOFF_BEGIN(psw, caller, line)
+#define IRQOFF_END(psw)
+#endif
+
 #ifdef CONFIG_SYSTEM_IRQ
 #include "rtc.h"
+#include "chip_memmap.h"
 #ifdef CONFIG_PSM_SURPORT
 #include "psm_system.h"
 #endif
@@ -598,14 +612,32 @@ int os_msdelay(size_t delay_ms)
 #define SYSTEM_IRQ_EMB_MAX    20
 #define SYSTEM_IRQ_NUM_MAX    400
 #define SYSTEM_PIT_FREQ_1M    1000000
+#define SYSTEM_IRQ_TRIG_MAX   4           /* sections over the threshold kept with their backtrace */
+#define SYSTEM_IRQ_BT_DEPTH   8
+#define SYSTEM_IRQ_BT_SCAN    128         /* stack words searched for return addresses */
+
+/* code lives in ILM or the XIP window */
+#define SYSTEM_IRQ_IS_TEXT(a) (((a) >= MEM_BASE_ILM0 && (a) < MEM_BASE_DLM) || \
+                               ((a) >= MEM_BASE_XIP && (a) < MEM_BASE_PSRAM))
+#define SYSTEM_IRQ_STACK_END  (MEM_BASE_RAM1 + 0x20000)
 
 typedef struct
 {
-    unsigned int irq_time;
+    unsigned int irq_time;                /* max, in pit clocks */
     unsigned int irq_line;
     unsigned int irq_func;
+    unsigned int irq_count;
+    unsigned long long irq_total;
 }system_irq;
 
+typedef struct
+{
+    unsigned int irq_time;
+    unsigned int irq_line;
+    unsigned int irq_func;
+    unsigned int irq_bt[SYSTEM_IRQ_BT_DEPTH];
+}system_irq_trig;
+
 volatile unsigned char g_sys_irq_sw                      = 0;         /*pit/rtc初始化标识*/
 volatile unsigned int  g_emb_layer                       = 0;         /*嵌套层数*/
 volatile unsigned int  g_emb_max                         = 0;         /*最大桥套层数*/
@@ -613,6 +645,22 @@ volatile unsigned int  g_cur_max                         = 0;         /*当前
 volatile unsigned int  g_sys_over_flow                   = 0;
 volatile system_irq    g_sys_irq[SYSTEM_IRQ_NUM_MAX]     = { { 0 } }; /*全局中断*/
 volatile system_irq    g_emb_irq[SYSTEM_IRQ_EMB_MAX + 1] = { { 0 } }; /*最大嵌套5层*/
+volatile unsigned int  g_sys_irq_threshold               = 0;         /*pit clocks, 0: no trigger*/
+volatile unsigned int  g_sys_irq_trig_num                = 0;
+system_irq_trig        g_sys_irq_trig[SYSTEM_IRQ_TRIG_MAX];
+
+static unsigned int system_irq_clk_per_us(void)
+{
+#ifdef CONFIG_PSM_SURPORT
+    unsigned int cpu_freq = psm_cpu_freq_op(false, 0);
+
+    if (cpu_freq > 0)
+    {
+        return(cpu_freq / 4);
+    }
+#endif
+    return(CHIP_CLOCK_APB / SYSTEM_PIT_FREQ_1M);
+}
 
 int system_irq_binsearch(system_irq *cur_irq, int *Find)
 {
@@ -667,6 +715,8 @@ int system_irq_update(system_irq *cur_irq)
     if (Find)
     {
         g_sys_irq[index].irq_time = MAX(g_sys_irq[index].irq_time, cur_irq->irq_time);
+        g_sys_irq[index].irq_count++;
+        g_sys_irq[index].irq_total += cur_irq->irq_time;
         return(0);
     }
 
@@ -677,10 +727,58 @@ int system_irq_update(system_irq *cur_irq)
         memcpy((system_irq *)&g_sys_irq[cnt + 1], (system_irq *)&g_sys_irq[cnt], sizeof(system_irq));
     }
     memcpy((system_irq *)&g_sys_irq[index], cur_irq, sizeof(system_irq));
+    g_sys_irq[index].irq_count = 1;
+    g_sys_irq[index].irq_total = cur_irq->irq_time;
     g_cur_max++;
     return(0);
 }
 
+/* Keep the section and the return addresses found on the stack. There is no frame
+ * pointer, so any word pointing into code is taken, stale ones included. */
+static void system_irq_trigger(system_irq *cur_irq)
+{
+    system_irq_trig *trig;
+    unsigned int    *sp = (unsigned int *)&trig;
+    int             i, n;
+
+    if (g_sys_irq_trig_num < SYSTEM_IRQ_TRIG_MAX)
+    {
+        trig = &g_sys_irq_trig[g_sys_irq_trig_num++];
+    }
+    else
+    {
+        /* full, replace the shortest one */
+        trig = &g_sys_irq_trig[0];
+        for (i = 1; i < SYSTEM_IRQ_TRIG_MAX; i++)
+        {
+            if (g_sys_irq_trig[i].irq_time < trig->irq_time)
+            {
+                trig = &g_sys_irq_trig[i];
+            }
+        }
+        if (cur_irq->irq_time <= trig->irq_time)
+        {
+            return;
+        }
+    }
+
+    trig->irq_time = cur_irq->irq_time;
+    trig->irq_line = cur_irq->irq_line;
+    trig->irq_func = cur_irq->irq_func;
+    memset(trig->irq_bt, 0, sizeof(trig->irq_bt));
+    for (i = 0, n = 0; i < SYSTEM_IRQ_BT_SCAN && n < SYSTEM_IRQ_BT_DEPTH; i++)
+    {
+        if ((unsigned int)&sp[i] >= SYSTEM_IRQ_STACK_END)
+        {
+            break;
+        }
+        if (SYSTEM_IRQ_IS_TEXT(sp[i]))
+        {
+            trig->irq_bt[n++] = sp[i];
+        }
+    }
+}
+
 void system_irq_save_hook(unsigned int hook_func, unsigned int hook_line)
 {
     if (g_sys_irq_sw)
@@ -710,6 +808,10 @@ void system_irq_restore_hook(void)
         {
             g_emb_irq[g_emb_layer].irq_time = tmp_time - g_emb_irq[g_emb_layer].irq_time + 17;
             system_irq_update((system_irq *)&g_emb_irq[g_emb_layer]);
+            if (g_sys_irq_threshold && g_emb_irq[g_emb_layer].irq_time > g_sys_irq_threshold)
+            {
+                system_irq_trigger((system_irq *)&g_emb_irq[g_emb_layer]);
+            }
             g_emb_layer--;
 
             if (g_emb_layer >= 1)
@@ -725,11 +827,13 @@ unsigned int system_irq_save_debug(unsigned int irq_func, unsigned int irq_line)
     unsigned int ulPSW = portSET_INTERRUPT_MASK_FROM_ISR();
 
     system_irq_save_hook(irq_func, irq_line);
+    IRQOFF_BEGIN(ulPSW, irq_func, irq_line);
     return(ulPSW);
 }
 
 void system_irq_restore(unsigned int psw)
 {
+    IRQOFF_END(psw);
     system_irq_restore_hook();
     return(portCLEAR_INTERRUPT_MASK_FROM_ISR(psw));
 }
@@ -739,11 +843,13 @@ unsigned int system_irq_save_tick_compensation_debug(unsigned int irq_func, unsi
     unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR_TICK_COMPENSATION();
 
     system_irq_save_hook(irq_func, irq_line);
+    IRQOFF_BEGIN(psw, irq_func, irq_line);
     return(psw);
 }
 
 void system_irq_restore_tick_compensation(unsigned int psw)
 {
+    IRQOFF_END(psw);
     system_irq_restore_hook();
     return(portCLEAR_INTERRUPT_MASK_FROM_ISR_TICK_COMPENSATION(psw));
 }
@@ -756,31 +862,101 @@ void sys_irq_sw_set(void)
 void sys_irq_show(void)
 {
     int          index;
-    unsigned int cpu_freq = 0;
     float        irq_time_us;
 
     g_sys_irq_sw = 0;
     for (index = 0; index < g_cur_max; index++)
     {
-#ifdef CONFIG_PSM_SURPORT
-        cpu_freq = psm_cpu_freq_op(false, 0);
-#endif
-        irq_time_us = cpu_freq > 0 ? (cpu_freq / 4): (CHIP_CLOCK_APB / SYSTEM_PIT_FREQ_1M);
+        irq_time_us = system_irq_clk_per_us();
         irq_time_us = g_sys_irq[index].irq_time / irq_time_us;
-        os_printf(LM_OS, LL_INFO, "%d/%d(/pit)/%.3f(/us)/%d/%s/%d\r\n", index, g_sys_irq[index].irq_time, irq_time_us, g_sys_irq[index].irq_line, g_sys_irq[index].irq_func, g_sys_irq[index].irq_func);
+        os_printf(LM_OS, LL_INFO, "%d/%d(/pit)/%.3f(/us)/%d/%s/%d/%u(/cnt)/%llu(/total pit)\r\n", index, g_sys_irq[index].irq_time, irq_time_us,
+                  g_sys_irq[index].irq_line, g_sys_irq[index].irq_func, g_sys_irq[index].irq_func, g_sys_irq[index].irq_count, g_sys_irq[index].irq_total);
     }
     os_printf(LM_OS, LL_INFO, "sys_cur_max = %d, sys_emb_max = %d, sys_over_flow=%d\r\n", g_cur_max, g_emb_max, g_sys_over_flow);
     g_sys_irq_sw = 1;
 }
 
+/* the n call sites that kept interrupts off the longest, by single section or in total */
+void sys_irq_top(int num, int by_total)
+{
+    unsigned char      done[SYSTEM_IRQ_NUM_MAX];
+    unsigned long long key, best_key;
+    unsigned int       clk_per_us = system_irq_clk_per_us();
+    int                index, best, rank;
+
+    g_sys_irq_sw = 0;
+    memset(done, 0, sizeof(done));
+    os_printf(LM_OS, LL_INFO, "%4s%10s%12s%10s%10s  %s\r\n", "rank", "max(us)", "total(us)", "count", "avg(us)", "site");
+    for (rank = 0; rank < num && rank < g_cur_max; rank++)
+    {
+        best     = -1;
+        best_key = 0;
+        for (index = 0; index < g_cur_max; index++)
+        {
+            key = by_total ? g_sys_irq[index].irq_total : g_sys_irq[index].irq_time;
+            if (!done[index] && (best < 0 || key > best_key))
+            {
+                best     = index;
+                best_key = key;
+            }
+        }
+        done[best] = 1;
+        os_printf(LM_OS, LL_INFO, "%4d%10u%12llu%10u%10u  %s:%d\r\n", rank + 1, g_sys_irq[best].irq_time / clk_per_us,
+                  g_sys_irq[best].irq_total / clk_per_us, g_sys_irq[best].irq_count,
+                  (unsigned int)(g_sys_irq[best].irq_total / g_sys_irq[best].irq_count / clk_per_us),
+                  (char *)g_sys_irq[best].irq_func, g_sys_irq[best].irq_line);
+    }
+    g_sys_irq_sw = 1;
+}
+
+/* sections longer than us record a backtrace, 0 turns the trigger off */
+void sys_irq_threshold_set(unsigned int us)
+{
+    g_sys_irq_threshold = us * system_irq_clk_per_us();
+}
+
+void sys_irq_trig_show(void)
+{
+    unsigned int clk_per_us = system_irq_clk_per_us();
+    int          i, k;
+
+    os_printf(LM_OS, LL_INFO, "threshold %u us, %u triggered\r\n", g_sys_irq_threshold / clk_per_us, g_sys_irq_trig_num);
+    for (i = 0; i < g_sys_irq_trig_num; i++)
+    {
+        os_printf(LM_OS, LL_INFO, "%u us at %s:%d, backtrace:", g_sys_irq_trig[i].irq_time / clk_per_us,
+                  (char *)g_sys_irq_trig[i].irq_func, g_sys_irq_trig[i].irq_line);
+        for (k = 0; k < SYSTEM_IRQ_BT_DEPTH && g_sys_irq_trig[i].irq_bt[k]; k++)
+        {
+            os_printf(LM_OS, LL_INFO, " 0x%08x", g_sys_irq_trig[i].irq_bt[k]);
+        }
+        os_printf(LM_OS, LL_INFO, "\r\n");
+    }
+}
+
+void sys_irq_reset(void)
+{
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    /* sections open on this stack stay in g_emb_irq and are recorded on restore */
+    g_cur_max          = 0;
+    g_emb_max          = g_emb_layer;
+    g_sys_over_flow    = 0;
+    g_sys_irq_trig_num = 0;
+    portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
+}
+
 #else
 
 unsigned int __attribute__((no_ex9, used))system_irq_save(void)
 {
-    return(portSET_INTERRUPT_MASK_FROM_ISR());
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR();
+
+    IRQOFF_BEGIN(psw, __builtin_return_address(0), 0);
+    return(psw);
 }
 void __attribute__((no_ex9, used))system_irq_restore(unsigned int psw)
 {
+    IRQOFF_END(psw);
     portCLEAR_INTERRUPT_MASK_FROM_ISR(psw);
 }
 
@@ -834,11 +1010,15 @@ void wifi_irq_restore(void)
 
 unsigned int system_irq_save_tick_compensation(void)
 {
-    return(portSET_INTERRUPT_MASK_FROM_ISR_TICK_COMPENSATION());
+    unsigned int psw = portSET_INTERRUPT_MASK_FROM_ISR_TICK_COMPENSATION();
+
+    IRQOFF_BEGIN(psw, __builtin_return_address(0), 0);
+    return(psw);
 }
 
 void system_irq_restore_tick_compensation(unsigned int psw)
 {
+    IRQOFF_END(psw);
     portCLEAR_INTERRUPT_MASK_FROM_ISR_TICK_COMPENSATION(psw);
 }
 #endif
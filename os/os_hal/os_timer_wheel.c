@@ -0,0 +1,664 @@
+/**
+ * @file os_timer_wheel.c
+ * @brief os_timer on a hierarchical timer wheel
+ * @details Every os_timer lives in a wheel of OS_TIMER_WHEEL_LEVELS levels
+ *          of 64 slots, level n counting in units of 64^n ticks; a timer
+ *          drops a level whenever the wheel reaches its slot. One task serves
+ *          the wheel and blocks until the earliest deadline, so the tickless
+ *          idle hook (psm_schedule_idle_cb) gets to sleep right up to it
+ *          instead of to whichever FreeRTOS timer happens to be next.
+ *
+ *          Each timer may run up to its slack late. Its deadline is pushed
+ *          within the slack onto the coarsest tick boundary there is, so
+ *          timers with slack tend to share deadlines, and a wakeup runs every
+ *          timer already due as well, not just the one it woke for. Slack
+ *          defaults to CONFIG_OS_TIMER_SLACK_PERCENT of the period; a timer
+ *          never runs early.
+ *
+ *          Callbacks run in the wheel task at configTIMER_TASK_PRIORITY, one
+ *          after another like in the FreeRTOS timer task.
+ */
+
+#include "oshal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "arch_irq.h"
+#ifdef CONFIG_PSM_STAT
+#include "psm_stat.h"
+#endif
+
+#define OS_TIMER_WHEEL_BITS         6
+#define OS_TIMER_WHEEL_SLOTS        (1 << OS_TIMER_WHEEL_BITS)
+#define OS_TIMER_WHEEL_MASK         (OS_TIMER_WHEEL_SLOTS - 1)
+#define OS_TIMER_WHEEL_LEVELS       4       /* 2^24 ticks, longer timers go round again */
+
+#define OS_TIMER_IDLE               0
+#define OS_TIMER_WHEEL              1       /* waiting in a slot */
+#define OS_TIMER_DUE                2       /* on the list to run */
+
+typedef struct os_timer
+{
+    struct os_timer *next;
+    struct os_timer *prev;
+    const char      *name;
+    void            (*func)(os_timer_handle_t timer);
+    void            *arg;
+    TickType_t      period;
+    TickType_t      slack;
+    TickType_t      due;                    /* runs at or after this */
+    TickType_t      expires;                /* and no later than this, the wheel key */
+    unsigned char   state;
+    unsigned char   level;                  /* and slot, while in the wheel */
+    unsigned char   slot;
+    unsigned char   autoreload;
+    unsigned char   own_slack;              /* set by os_timer_set_slack() */
+    unsigned char   deleted;                /* while its callback runs */
+} os_timer_t;
+
+typedef struct
+{
+    os_timer_t      head;                   /* circular, head.next is the first */
+} os_timer_list_t;
+
+static struct
+{
+    TaskHandle_t        task;
+    TickType_t          now;                /* the wheel is current up to here */
+    TickType_t          sleep_until;        /* what the task is blocked for, if asleep */
+    unsigned char       asleep;
+    os_timer_t          *running;
+    unsigned long long  used[OS_TIMER_WHEEL_LEVELS];
+    os_timer_list_t     slot[OS_TIMER_WHEEL_LEVELS][OS_TIMER_WHEEL_SLOTS];
+    os_timer_list_t     due;
+    os_timer_stats_t    stats;
+    TickType_t          stats_since;
+} s_wheel;
+
+static void os_timer_list_init(os_timer_list_t *list)
+{
+    list->head.next = list->head.prev = &list->head;
+}
+
+static void os_timer_list_add(os_timer_list_t *list, os_timer_t *timer)
+{
+    timer->prev = list->head.prev;
+    timer->next = &list->head;
+    list->head.prev->next = timer;
+    list->head.prev = timer;
+}
+
+static int os_timer_list_empty(os_timer_list_t *list)
+{
+    return(list->head.next == &list->head);
+}
+
+/* the tick count is unsigned and wraps, compare by difference */
+static int os_timer_before(TickType_t a, TickType_t b)
+{
+    return((int)(a - b) < 0);
+}
+
+static TickType_t os_timer_ticks(void)
+{
+    return(arch_irq_context() ? xTaskGetTickCountFromISR() : xTaskGetTickCount());
+}
+
+static int os_timer_ctz64(unsigned long long v)
+{
+    unsigned int low = (unsigned int)v;
+
+    return(low ? __builtin_ctz(low) : 32 + __builtin_ctz((unsigned int)(v >> 32)));
+}
+
+/* the latest tick within the slack on the coarsest boundary, as Linux does it */
+static TickType_t os_timer_apply_slack(TickType_t due, TickType_t slack)
+{
+    TickType_t limit = due + slack;
+    TickType_t mask  = due ^ limit;
+
+    if (slack == 0 || mask == 0 || os_timer_before(limit, due))
+    {
+        return(due);
+    }
+    mask = (1u << (31 - __builtin_clz(mask))) - 1;
+    return(limit & ~mask);
+}
+
+/* which level and slot <expires> goes to, seen from wheel time <now> */
+static void os_timer_wheel_add(os_timer_t *timer)
+{
+    TickType_t expires = timer->expires;
+    TickType_t rel;
+    int        level, shift;
+
+    if (os_timer_before(expires, s_wheel.now))
+    {
+        expires = s_wheel.now;
+    }
+    for (level = 0; level < OS_TIMER_WHEEL_LEVELS; level++)
+    {
+        shift = level * OS_TIMER_WHEEL_BITS;
+        rel   = ((expires >> shift) - (s_wheel.now >> shift)) & (0xffffffffu >> shift);
+        if (rel < OS_TIMER_WHEEL_SLOTS)
+        {
+            break;
+        }
+    }
+    if (level == OS_TIMER_WHEEL_LEVELS)
+    {
+        /* beyond the wheel: park it in the farthest slot, it comes round again from there */
+        level   = OS_TIMER_WHEEL_LEVELS - 1;
+        shift   = level * OS_TIMER_WHEEL_BITS;
+        expires = s_wheel.now + (OS_TIMER_WHEEL_MASK << shift);
+    }
+
+    timer->level = level;
+    timer->slot  = (expires >> shift) & OS_TIMER_WHEEL_MASK;
+    timer->state = OS_TIMER_WHEEL;
+    os_timer_list_add(&s_wheel.slot[level][timer->slot], timer);
+    s_wheel.used[level] |= 1ull << timer->slot;
+}
+
+/* out of whatever list it is on */
+static void os_timer_unlink(os_timer_t *timer)
+{
+    if (timer->state == OS_TIMER_IDLE)
+    {
+        return;
+    }
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    if (timer->state == OS_TIMER_WHEEL && os_timer_list_empty(&s_wheel.slot[timer->level][timer->slot]))
+    {
+        s_wheel.used[timer->level] &= ~(1ull << timer->slot);
+    }
+    timer->state = OS_TIMER_IDLE;
+}
+
+/* move a whole slot to the due list, or back into the wheel a level down */
+static void os_timer_slot_take(int level, int slot, int to_due)
+{
+    os_timer_list_t *list = &s_wheel.slot[level][slot];
+    os_timer_t      *timer;
+
+    s_wheel.used[level] &= ~(1ull << slot);
+    while (!os_timer_list_empty(list))
+    {
+        timer = list->head.next;
+        timer->prev->next = timer->next;
+        timer->next->prev = timer->prev;
+        if (to_due)
+        {
+            os_timer_list_add(&s_wheel.due, timer);
+            timer->state = OS_TIMER_DUE;
+        }
+        else
+        {
+            os_timer_wheel_add(timer);
+        }
+    }
+}
+
+/* ticks from now to the next slot with work in it on <level>, 0 when none */
+static TickType_t os_timer_level_next(int level)
+{
+    int                shift = level * OS_TIMER_WHEEL_BITS;
+    int                cur   = (s_wheel.now >> shift) & OS_TIMER_WHEEL_MASK;
+    unsigned long long used  = s_wheel.used[level];
+    int                rel;
+
+    if (used == 0)
+    {
+        return(0);
+    }
+    used = (used >> cur) | (cur ? used << (OS_TIMER_WHEEL_SLOTS - cur) : 0);
+    rel  = os_timer_ctz64(used);
+    if (level == 0)
+    {
+        return(rel ? rel : OS_TIMER_WHEEL_SLOTS);
+    }
+    return((((s_wheel.now >> shift) + rel) << shift) - s_wheel.now);
+}
+
+/* bring the wheel up to <now>, everything expired goes to the due list */
+static void os_timer_wheel_advance(TickType_t now)
+{
+    TickType_t step, next;
+    int        level, shift;
+
+    os_timer_slot_take(0, s_wheel.now & OS_TIMER_WHEEL_MASK, 1);
+    while (s_wheel.now != now)
+    {
+        step = now - s_wheel.now;
+        for (level = 0; level < OS_TIMER_WHEEL_LEVELS; level++)
+        {
+            next = os_timer_level_next(level);
+            if (next && next < step)
+            {
+                step = next;
+            }
+        }
+        s_wheel.now += step;
+
+        for (level = OS_TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            shift = level * OS_TIMER_WHEEL_BITS;
+            if ((s_wheel.now & ((1u << shift) - 1)) == 0)
+            {
+                os_timer_slot_take(level, (s_wheel.now >> shift) & OS_TIMER_WHEEL_MASK, 0);
+            }
+        }
+        os_timer_slot_take(0, s_wheel.now & OS_TIMER_WHEEL_MASK, 1);
+    }
+}
+
+/* timers not yet at their deadline but already due join this wakeup */
+static void os_timer_wheel_gather(TickType_t now)
+{
+    os_timer_list_t *list;
+    os_timer_t      *timer, *next;
+    int              level, slot;
+
+    for (level = 0; level < OS_TIMER_WHEEL_LEVELS; level++)
+    {
+        for (slot = 0; slot < OS_TIMER_WHEEL_SLOTS; slot++)
+        {
+            if (!(s_wheel.used[level] & (1ull << slot)))
+            {
+                continue;
+            }
+            list = &s_wheel.slot[level][slot];
+            for (timer = list->head.next; timer != &list->head; timer = next)
+            {
+                next = timer->next;
+                if (!os_timer_before(now, timer->due))
+                {
+                    os_timer_unlink(timer);
+                    os_timer_list_add(&s_wheel.due, timer);
+                    timer->state = OS_TIMER_DUE;
+                    s_wheel.stats.coalesced++;
+                }
+            }
+        }
+    }
+}
+
+/* the earliest deadline in the wheel, 0 when it is empty */
+static int os_timer_wheel_next(TickType_t *expires)
+{
+    os_timer_list_t *list;
+    os_timer_t      *timer;
+    TickType_t       ticks;
+    int              level, shift, found = 0;
+
+    if (!os_timer_list_empty(&s_wheel.due))
+    {
+        *expires = s_wheel.now;
+        return(1);
+    }
+    for (level = 0; level < OS_TIMER_WHEEL_LEVELS; level++)
+    {
+        if ((ticks = os_timer_level_next(level)) == 0)
+        {
+            continue;
+        }
+        shift = level * OS_TIMER_WHEEL_BITS;
+        if (level == 0)
+        {
+            ticks %= OS_TIMER_WHEEL_SLOTS;
+        }
+        list = &s_wheel.slot[level][((s_wheel.now + ticks) >> shift) & OS_TIMER_WHEEL_MASK];
+        for (timer = list->head.next; timer != &list->head; timer = timer->next)
+        {
+            if (!found || os_timer_before(timer->expires, *expires))
+            {
+                *expires = timer->expires;
+                found    = 1;
+            }
+        }
+    }
+    return(found);
+}
+
+static void os_timer_lock(UBaseType_t *flags)
+{
+    if (arch_irq_context())
+    {
+        *flags = taskENTER_CRITICAL_FROM_ISR();
+    }
+    else
+    {
+        taskENTER_CRITICAL();
+    }
+}
+
+/* and wake the task when it sleeps past the deadline that is first now */
+static void os_timer_unlock(UBaseType_t flags)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    TickType_t expires;
+    int        wake = 0;
+
+    if (s_wheel.asleep && os_timer_wheel_next(&expires) && os_timer_before(expires, s_wheel.sleep_until))
+    {
+        s_wheel.asleep = 0;
+        wake           = 1;
+    }
+
+    if (arch_irq_context())
+    {
+        taskEXIT_CRITICAL_FROM_ISR(flags);
+        if (wake)
+        {
+            vTaskNotifyGiveFromISR(s_wheel.task, &xHigherPriorityTaskWoken);
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
+    }
+    else
+    {
+        taskEXIT_CRITICAL();
+        if (wake)
+        {
+            xTaskNotifyGive(s_wheel.task);
+        }
+    }
+}
+
+static void os_timer_task(void *arg)
+{
+    os_timer_t *timer;
+    TickType_t  now, expires, wait;
+    UBaseType_t flags;
+    int         woken, deleted;
+
+    for (;;)
+    {
+        now = xTaskGetTickCount();
+        os_timer_lock(&flags);
+        os_timer_wheel_advance(now);
+        if (!os_timer_list_empty(&s_wheel.due))
+        {
+            os_timer_wheel_gather(now);
+        }
+        os_timer_unlock(flags);
+
+        for (;;)
+        {
+            os_timer_lock(&flags);
+            timer = s_wheel.due.head.next;
+            if (timer == &s_wheel.due.head)
+            {
+                os_timer_unlock(flags);
+                break;
+            }
+            os_timer_unlink(timer);
+            if (timer->autoreload)
+            {
+                timer->due += timer->period;
+                if (os_timer_before(timer->due, now + 1))
+                {
+                    timer->due = now + timer->period;   /* missed whole periods, no burst */
+                }
+                timer->expires = os_timer_apply_slack(timer->due, timer->slack);
+                os_timer_wheel_add(timer);
+            }
+            s_wheel.running = timer;
+            s_wheel.stats.expiries++;
+            os_timer_unlock(flags);
+
+#ifdef CONFIG_PSM_STAT
+            psm_stat_timer(timer->name);
+#endif
+            timer->func((os_timer_handle_t)timer);
+
+            /* deleted while it ran: os_timer_delete() left the free to us */
+            os_timer_lock(&flags);
+            s_wheel.running = NULL;
+            deleted         = timer->deleted;
+            if (deleted)
+            {
+                os_timer_unlink(timer);             /* the callback may have started it again */
+            }
+            os_timer_unlock(flags);
+            if (deleted)
+            {
+                os_free(timer);
+            }
+        }
+
+        os_timer_lock(&flags);
+        now = xTaskGetTickCount();
+        if (os_timer_wheel_next(&expires))
+        {
+            wait = os_timer_before(now, expires) ? expires - now : 0;
+        }
+        else
+        {
+            wait = portMAX_DELAY;
+        }
+        /* portMAX_DELAY would wrap to just behind now, any deadline comes before this */
+        s_wheel.sleep_until = now + ((wait == portMAX_DELAY) ? 0x7fffffffu : wait);
+        s_wheel.asleep      = (wait != 0);
+        os_timer_unlock(flags);
+
+        if (wait)
+        {
+            woken = ulTaskNotifyTake(pdTRUE, wait);
+            os_timer_lock(&flags);
+            s_wheel.asleep = 0;
+            if (!woken)
+            {
+                s_wheel.stats.wakeups++;
+            }
+            os_timer_unlock(flags);
+        }
+    }
+}
+
+static int os_timer_init(void)
+{
+    int i, j;
+
+    if (s_wheel.task)
+    {
+        return(0);
+    }
+
+    vTaskSuspendAll();
+    if (s_wheel.task == NULL)
+    {
+        for (i = 0; i < OS_TIMER_WHEEL_LEVELS; i++)
+        {
+            for (j = 0; j < OS_TIMER_WHEEL_SLOTS; j++)
+            {
+                os_timer_list_init(&s_wheel.slot[i][j]);
+            }
+        }
+        os_timer_list_init(&s_wheel.due);
+        s_wheel.now         = xTaskGetTickCount();
+        s_wheel.stats_since = s_wheel.now;
+        xTaskCreate(os_timer_task, "os_timer", configTIMER_TASK_STACK_DEPTH, NULL, configTIMER_TASK_PRIORITY, &s_wheel.task);
+    }
+    xTaskResumeAll();
+
+    return(s_wheel.task ? 0 : -1);
+}
+
+static TickType_t os_timer_ms_to_tick(size_t ms)
+{
+    TickType_t ticks = ms / portTICK_PERIOD_MS + ((ms % portTICK_PERIOD_MS) ? 1 : 0);
+
+    return(ticks ? ticks : 1);
+}
+
+/* (re)start from now, called locked */
+static void os_timer_arm(os_timer_t *timer)
+{
+    if (!timer->own_slack)
+    {
+        timer->slack = timer->period * CONFIG_OS_TIMER_SLACK_PERCENT / 100;
+    }
+    os_timer_unlink(timer);
+    timer->due     = os_timer_ticks() + timer->period;
+    timer->expires = os_timer_apply_slack(timer->due, timer->slack);
+    os_timer_wheel_add(timer);
+}
+
+
+
+/**************************************************************************************
+*SoftTimer API
+**************************************************************************************/
+os_timer_handle_t os_timer_create(const char *name, size_t period_ms, size_t is_autoreload, void (*timeout_func)(os_timer_handle_t timer), void *arg)
+{
+    os_timer_t *timer;
+
+    if (os_timer_init() != 0)
+    {
+        return(NULL);
+    }
+
+    timer = os_zalloc(sizeof(os_timer_t));
+    if (timer)
+    {
+        timer->name       = name;
+        timer->func       = timeout_func;
+        timer->arg        = arg;
+        timer->period     = os_timer_ms_to_tick(period_ms);
+        timer->autoreload = is_autoreload ? 1 : 0;
+    }
+    return((os_timer_handle_t)timer);
+}
+
+void * os_timer_get_arg(os_timer_handle_t timer)
+{
+    return(((os_timer_t *)timer)->arg);
+}
+
+int os_timer_start(os_timer_handle_t timer)
+{
+    UBaseType_t flags;
+
+    if (timer == NULL)
+    {
+        return(-1);
+    }
+    os_timer_lock(&flags);
+    os_timer_arm((os_timer_t *)timer);
+    os_timer_unlock(flags);
+    return(0);
+}
+
+int os_timer_delete(os_timer_handle_t timer)
+{
+    os_timer_t  *t = (os_timer_t *)timer;
+    UBaseType_t flags;
+    int         running;
+
+    if (t == NULL)
+    {
+        return(-1);
+    }
+    /* freed once: here, or by the task after the callback it is running, decided under the lock */
+    os_timer_lock(&flags);
+    os_timer_unlink(t);
+    running = (s_wheel.running == t);
+    t->deleted = running;
+    os_timer_unlock(flags);
+
+    if (!running)
+    {
+        os_free(t);
+    }
+    return(0);
+}
+
+int os_timer_stop(os_timer_handle_t timer)
+{
+    UBaseType_t flags;
+
+    if (timer == NULL)
+    {
+        return(-1);
+    }
+    os_timer_lock(&flags);
+    os_timer_unlink((os_timer_t *)timer);
+    os_timer_unlock(flags);
+    return(0);
+}
+
+int os_timer_changeperiod(os_timer_handle_t timer, size_t period_ms)
+{
+    UBaseType_t flags;
+
+    if (timer == NULL)
+    {
+        return(-1);
+    }
+    os_timer_lock(&flags);
+    ((os_timer_t *)timer)->period = os_timer_ms_to_tick(period_ms);
+    os_timer_arm((os_timer_t *)timer);
+    os_timer_unlock(flags);
+    return(0);
+}
+
+/* how late the timer may run, from its next start on */
+int os_timer_set_slack(os_timer_handle_t timer, size_t slack_ms)
+{
+    UBaseType_t flags;
+    os_timer_t  *t = (os_timer_t *)timer;
+
+    if (t == NULL)
+    {
+        return(-1);
+    }
+    os_timer_lock(&flags);
+    t->slack     = slack_ms / portTICK_PERIOD_MS;
+    t->own_slack = 1;
+    os_timer_unlock(flags);
+    return(0);
+}
+
+/* ms to the next os_timer deadline, -1 when none is running */
+int os_timer_next_ms(void)
+{
+    TickType_t  expires, now;
+    UBaseType_t flags;
+    int         found;
+
+    if (s_wheel.task == NULL)
+    {
+        return(-1);
+    }
+    os_timer_lock(&flags);
+    found = os_timer_wheel_next(&expires);
+    os_timer_unlock(flags);
+
+    now = os_timer_ticks();
+    if (!found)
+    {
+        return(-1);
+    }
+    return(os_timer_before(now, expires) ? (expires - now) * portTICK_PERIOD_MS : 0);
+}
+
+void os_timer_get_stats(os_timer_stats_t *stats, int reset)
+{
+    UBaseType_t flags;
+    TickType_t  now = os_timer_ticks();
+
+    if (s_wheel.task == NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    os_timer_lock(&flags);
+    *stats          = s_wheel.stats;
+    stats->since_ms = (now - s_wheel.stats_since) * portTICK_PERIOD_MS;
+    if (reset)
+    {
+        memset(&s_wheel.stats, 0, sizeof(s_wheel.stats));
+        s_wheel.stats_since = now;
+    }
+    os_timer_unlock(flags);
+}
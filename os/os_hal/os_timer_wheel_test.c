@@ -0,0 +1,342 @@
+/**
+ * @file os_timer_wheel_test.c
+ * @brief os_timer_test command, checks the timer wheel through the os_timer API
+ * @details Every case starts its own timers with no slack, unless slack is what
+ *          it checks, and looks at the tick each callback ran on: never before
+ *          the deadline, and no later than OS_TIMER_TEST_LATE ticks after it
+ *          plus the slack. Other os_timers of the system keep running meanwhile,
+ *          so the wheel is never empty and os_timer_next_ms() is only checked
+ *          against an upper bound.
+ */
+
+#include <string.h>
+#include "oshal.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "cli.h"
+
+#define OS_TIMER_TEST_LATE          2       /* ticks the wheel task may take to get going */
+#define OS_TIMER_TEST_RUNS          4
+
+#define OS_TIMER_TEST_KEEP          0       /* the callback leaves its timer alone */
+#define OS_TIMER_TEST_RESTART       1       /* starts it again until <limit> runs */
+#define OS_TIMER_TEST_DELETE        2       /* deletes it on run <limit> */
+#define OS_TIMER_TEST_RESTART_DEL   3       /* starts it again, then deletes it */
+
+typedef struct
+{
+    os_timer_handle_t timer;
+    TickType_t        period;
+    TickType_t        slack;
+    TickType_t        start;
+    TickType_t        fired[OS_TIMER_TEST_RUNS];
+    volatile int      runs;
+    int               autoreload;
+    int               action;
+    int               limit;
+} os_timer_probe_t;
+
+static void os_timer_probe_cb(os_timer_handle_t timer)
+{
+    os_timer_probe_t *p = (os_timer_probe_t *)os_timer_get_arg(timer);
+
+    if (p->runs < OS_TIMER_TEST_RUNS)
+    {
+        p->fired[p->runs] = xTaskGetTickCount();
+    }
+    p->runs++;
+
+    switch (p->action)
+    {
+        case OS_TIMER_TEST_RESTART:
+            if (p->runs < p->limit)
+            {
+                os_timer_start(timer);
+            }
+            break;
+        case OS_TIMER_TEST_DELETE:
+            if (p->runs == p->limit)
+            {
+                os_timer_delete(timer);
+                p->timer = NULL;
+            }
+            break;
+        case OS_TIMER_TEST_RESTART_DEL:
+            os_timer_start(timer);
+            os_timer_delete(timer);
+            p->timer = NULL;
+            break;
+        default:
+            break;
+    }
+}
+
+/* created, not started yet; slack_ms < 0 keeps the default slack */
+static int os_timer_probe_init(os_timer_probe_t *p, size_t period_ms, int autoreload, int slack_ms, int action, int limit)
+{
+    memset(p, 0, sizeof(*p));
+    p->timer = os_timer_create("os_timer_test", period_ms, autoreload, os_timer_probe_cb, p);
+    if (p->timer == NULL)
+    {
+        return(-1);
+    }
+    p->period = (period_ms + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    p->slack  = p->period * CONFIG_OS_TIMER_SLACK_PERCENT / 100;
+    if (slack_ms >= 0)
+    {
+        os_timer_set_slack(p->timer, slack_ms);
+        p->slack = slack_ms / portTICK_PERIOD_MS;
+    }
+    p->autoreload = autoreload;
+    p->action     = action;
+    p->limit      = limit;
+    return(0);
+}
+
+static void os_timer_probe_start(os_timer_probe_t *p)
+{
+    p->start = xTaskGetTickCount();
+    os_timer_start(p->timer);
+}
+
+static void os_timer_probe_free(os_timer_probe_t *p, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (p[i].timer)
+        {
+            os_timer_delete(p[i].timer);
+            p[i].timer = NULL;
+        }
+    }
+}
+
+/* run <run> was on time: an autoreload timer keeps its deadlines from the start,
+ * a one-shot started again from its callback counts from that run */
+static int os_timer_probe_check(const os_timer_probe_t *p, int run)
+{
+    TickType_t since = p->start;
+    TickType_t want  = p->period;
+    TickType_t took;
+
+    if (p->autoreload)
+    {
+        want *= run + 1;
+    }
+    else if (run)
+    {
+        since = p->fired[run - 1];
+    }
+    took = p->fired[run] - since;
+
+    if (took < want || took > want + p->slack + OS_TIMER_TEST_LATE)
+    {
+        os_printf(LM_CMD, LL_INFO, "  %u ms timer run %d after %u ticks, wanted %u..%u\r\n",
+            p->period * portTICK_PERIOD_MS, run, took, want, want + p->slack + OS_TIMER_TEST_LATE);
+        return(-1);
+    }
+    return(0);
+}
+
+/* one-shot timers on level 0 run once, on time */
+static int os_timer_test_add(void)
+{
+    static const size_t period_ms[] = {10, 50, 100};
+    os_timer_probe_t    p[3];
+    int                 i, err = 0;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (os_timer_probe_init(&p[i], period_ms[i], 0, 0, OS_TIMER_TEST_KEEP, 0))
+        {
+            os_timer_probe_free(p, i);
+            return(-1);
+        }
+    }
+    for (i = 0; i < 3; i++)
+    {
+        os_timer_probe_start(&p[i]);
+    }
+    os_msleep(300);
+    for (i = 0; i < 3; i++)
+    {
+        err |= (p[i].runs != 1) || os_timer_probe_check(&p[i], 0);
+    }
+    os_timer_probe_free(p, 3);
+    return(err ? -1 : 0);
+}
+
+/* deadlines past level 0 and level 1 come down the levels and still run on time,
+ * an autoreload timer just over one level-0 round goes round a few times */
+static int os_timer_test_cascade(void)
+{
+    os_timer_probe_t p[3];
+    int              i, err = 0;
+
+    memset(p, 0, sizeof(p));
+    if (os_timer_probe_init(&p[0], 65 * portTICK_PERIOD_MS, 1, 0, OS_TIMER_TEST_KEEP, 0)
+     || os_timer_probe_init(&p[1], 200 * portTICK_PERIOD_MS, 0, 0, OS_TIMER_TEST_KEEP, 0)
+     || os_timer_probe_init(&p[2], 4200 * portTICK_PERIOD_MS, 0, 0, OS_TIMER_TEST_KEEP, 0))
+    {
+        os_timer_probe_free(p, 3);
+        return(-1);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        os_timer_probe_start(&p[i]);
+    }
+    os_msleep((65 * 3 + 30) * portTICK_PERIOD_MS);
+    os_timer_stop(p[0].timer);
+    os_msleep((4200 - 65 * 3) * portTICK_PERIOD_MS);
+
+    err |= (p[0].runs != 3);
+    for (i = 0; !err && i < 3; i++)
+    {
+        err |= os_timer_probe_check(&p[0], i);
+    }
+    err |= (p[1].runs != 1) || os_timer_probe_check(&p[1], 0);
+    err |= (p[2].runs != 1) || os_timer_probe_check(&p[2], 0);
+    os_timer_probe_free(p, 3);
+    return(err ? -1 : 0);
+}
+
+/* a timer with slack runs on the wakeup of a strict one due after its own deadline:
+ * started on a 256 tick boundary, 30 ticks with 200 of slack lines up on tick 128,
+ * the strict one at 50 ticks takes it along */
+static int os_timer_test_coalesce(void)
+{
+    os_timer_probe_t p[2];
+    os_timer_stats_t st;
+    int              err;
+
+    memset(p, 0, sizeof(p));
+    if (os_timer_probe_init(&p[0], 50 * portTICK_PERIOD_MS, 0, 0, OS_TIMER_TEST_KEEP, 0)
+     || os_timer_probe_init(&p[1], 30 * portTICK_PERIOD_MS, 0, 200 * portTICK_PERIOD_MS, OS_TIMER_TEST_KEEP, 0))
+    {
+        os_timer_probe_free(p, 2);
+        return(-1);
+    }
+    while (xTaskGetTickCount() & 0xff)
+    {
+        vTaskDelay(1);
+    }
+    os_timer_get_stats(&st, 1);
+    os_timer_probe_start(&p[0]);
+    os_timer_probe_start(&p[1]);
+    os_msleep(300 * portTICK_PERIOD_MS);
+    os_timer_get_stats(&st, 0);
+
+    err = (p[0].runs != 1) || (p[1].runs != 1) || os_timer_probe_check(&p[0], 0) || os_timer_probe_check(&p[1], 0);
+    if (!err && (p[1].fired[0] != p[0].fired[0] || st.coalesced == 0))
+    {
+        os_printf(LM_CMD, LL_INFO, "  slack timer ran on tick %u, strict one on %u, coalesced %u\r\n",
+            p[1].fired[0] - p[1].start, p[0].fired[0] - p[0].start, st.coalesced);
+        err = 1;
+    }
+    os_timer_probe_free(p, 2);
+    return(err ? -1 : 0);
+}
+
+/* a callback starting or deleting its own timer */
+static int os_timer_test_callback(void)
+{
+    os_timer_probe_t p[3];
+    int              i, err = 0;
+
+    memset(p, 0, sizeof(p));
+    if (os_timer_probe_init(&p[0], 20, 0, 0, OS_TIMER_TEST_RESTART, 3)
+     || os_timer_probe_init(&p[1], 20, 1, 0, OS_TIMER_TEST_DELETE, 3)
+     || os_timer_probe_init(&p[2], 20, 1, 0, OS_TIMER_TEST_RESTART_DEL, 0))
+    {
+        os_timer_probe_free(p, 3);
+        return(-1);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        os_timer_probe_start(&p[i]);
+    }
+    os_msleep(300);
+
+    if (p[0].runs != 3 || p[1].runs != 3 || p[2].runs != 1 || p[1].timer || p[2].timer)
+    {
+        os_printf(LM_CMD, LL_INFO, "  runs restart %d/3, delete %d/3, restart+delete %d/1\r\n",
+            p[0].runs, p[1].runs, p[2].runs);
+        err = 1;
+    }
+    for (i = 0; !err && i < 3; i++)
+    {
+        err |= os_timer_probe_check(&p[0], i) || os_timer_probe_check(&p[1], i);
+    }
+    os_timer_probe_free(p, 3);
+    return(err ? -1 : 0);
+}
+
+/* the next deadline is no later than ours, and counts down */
+static int os_timer_test_next(void)
+{
+    os_timer_probe_t p;
+    int              first, later, err;
+
+    if (os_timer_probe_init(&p, 1000, 0, 0, OS_TIMER_TEST_KEEP, 0))
+    {
+        return(-1);
+    }
+    os_timer_probe_start(&p);
+    first = os_timer_next_ms();
+    os_msleep(400);
+    later = os_timer_next_ms();
+
+    err = (first < 0 || first > 1000 || later < 0 || later > 600 + OS_TIMER_TEST_LATE * portTICK_PERIOD_MS);
+    if (err)
+    {
+        os_printf(LM_CMD, LL_INFO, "  next %d ms, 400 ms on %d ms\r\n", first, later);
+    }
+    os_timer_probe_free(&p, 1);
+    return(err ? -1 : 0);
+}
+
+static const struct
+{
+    const char *name;
+    int        (*run)(void);
+} os_timer_tests[] =
+{
+    {"add",      os_timer_test_add},
+    {"cascade",  os_timer_test_cascade},
+    {"coalesce", os_timer_test_coalesce},
+    {"callback", os_timer_test_callback},
+    {"next",     os_timer_test_next},
+};
+
+static int os_timer_test(cmd_tbl_t *t, int argc, char *argv[])
+{
+    int i, ran = 0, failed = 0;
+
+    for (i = 0; i < sizeof(os_timer_tests) / sizeof(os_timer_tests[0]); i++)
+    {
+        if (argc > 1 && strcmp(argv[1], os_timer_tests[i].name))
+        {
+            continue;
+        }
+        ran++;
+        if (os_timer_tests[i].run())
+        {
+            failed++;
+            os_printf(LM_CMD, LL_INFO, "%s: FAILED\r\n", os_timer_tests[i].name);
+        }
+        else
+        {
+            os_printf(LM_CMD, LL_INFO, "%s: OK\r\n", os_timer_tests[i].name);
+        }
+    }
+    if (ran == 0)
+    {
+        return(CMD_RET_USAGE);
+    }
+    os_printf(LM_CMD, LL_INFO, "os_timer test %s\r\n", failed ? "FAILED" : "OK");
+    return(failed ? CMD_RET_FAILURE : CMD_RET_SUCCESS);
+}
+
+CLI_CMD(os_timer_test, os_timer_test, "os_timer wheel test", "os_timer_test [add|cascade|coalesce|callback|next]");